@@ -0,0 +1,26 @@
+// Scalar loops: 0 sums an int array, 1 sums it with a stride, 2 multiplies
+// 128x128 matrices of longs
+int printf(const char *, ...);
+static int a[4096];
+static long m1[128][128], m2[128][128], m3[128][128];
+long sum(int *p, int n) { long s = 0; for (int i = 0; i < n; i++) s += p[i]; return s; }
+long strided(int *p, int n, int stride) { long s = 0; for (int i = 0; i < n; i++) s += p[(i * stride) & 4095] * (stride + 3); return s; }
+void matmul(int n) {
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++) {
+      long t = 0;
+      for (int k = 0; k < n; k++) t += m1[i][k] * m2[k][j];
+      m3[i][j] = t;
+    }
+}
+int main(int argc, char **argv) {
+  int which = argv[1][0] - '0';
+  for (int i = 0; i < 4096; i++) a[i] = i * 7 % 13;
+  for (int i = 0; i < 128; i++) for (int j = 0; j < 128; j++) m1[i][j] = m2[j][i] = i ^ j;
+  long r = 0;
+  if (which == 0) for (int k = 0; k < 100000; k++) r += sum(a, 4096);
+  if (which == 1) for (int k = 0; k < 100000; k++) r += strided(a, 4096, k & 15);
+  if (which == 2) { for (int k = 0; k < 20; k++) matmul(128); r = m3[5][7]; }
+  printf("%ld\n", r);
+  return 0;
+}
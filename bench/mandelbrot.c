@@ -0,0 +1,38 @@
+// Mandelbrot over a local complex struct, then a histogram in a local array
+int printf(const char *, ...);
+typedef struct { double re, im; } cplx;
+static void mul(cplx *r, const cplx *a, const cplx *b) {
+  cplx t = { a->re * b->re - a->im * b->im, a->re * b->im + a->im * b->re };
+  *r = t;
+}
+static void add(cplx *r, const cplx *a) { r->re += a->re; r->im += a->im; }
+static int escape(double x, double y) {
+  cplx c = { x, y }, z = { 0 };
+  int i;
+  for (i = 0; i < 200; i++) {
+    cplx s;
+    s.re = z.re * z.re - z.im * z.im;
+    s.im = 2 * z.re * z.im;
+    z.re = s.re; z.im = s.im;
+    add(&z, &c);
+    if (z.re * z.re + z.im * z.im > 4) break;
+  }
+  return i;
+}
+static long hist(int n) {
+  int bins[4] = { 0 };
+  for (int i = 0; i < n; i++) {
+    int v = (i * 2654435761u) >> 30;
+    if (v == 0) bins[0]++; else if (v == 1) bins[1]++; else if (v == 2) bins[2]++; else bins[3]++;
+  }
+  return bins[0] * 3 + bins[1] * 5 + bins[2] * 7 + bins[3];
+}
+int main(void) {
+  long total = 0;
+  for (int y = 0; y < 600; y++)
+    for (int x = 0; x < 600; x++)
+      total += escape(-2.0 + x * 3.0 / 600, -1.5 + y * 3.0 / 600);
+  for (int k = 0; k < 40; k++) total += hist(1000000);
+  printf("%ld\n", total);
+  return 0;
+}
@@ -0,0 +1,66 @@
+#!/bin/sh
+# Build each kernel with dcc -S, link it with the system compiler and time
+# it, taking the best of several runs. With BASE set to another dcc, each
+# kernel is timed under both, so that a change can be measured against the
+# compiler before it.
+#
+# usage: bench/run.sh [runs]
+
+DCC=${DCC:-./dcc}
+LINK=${LINK:-cc}
+runs=${1:-3}
+bench=$(dirname "$0")
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT INT TERM
+
+# name, program and argument of each kernel
+kernels="sum kernels 0
+strided kernels 1
+matmul kernels 2
+iadd vectors 0
+fmula vectors 1
+daxpy vectors 2
+stencil stencil -
+mandelbrot mandelbrot -"
+
+# Build $bench/$2.c with the dcc $1 into $tmp/$3
+build() {
+  $1 -S "$bench/$2.c" -o "$tmp/$3.s" && $LINK "$tmp/$3.s" -o "$tmp/$3"
+}
+
+# The best time of $runs runs of $1 with the argument $2, in milliseconds
+best() {
+  min=
+  i=0
+  while [ $i -lt "$runs" ]; do
+    start=$(date +%s%N)
+    if [ "$2" = - ]; then "$1" > /dev/null; else "$1" "$2" > /dev/null; fi
+    ms=$((($(date +%s%N) - start) / 1000000))
+    if [ -z "$min" ] || [ $ms -lt "$min" ]; then
+      min=$ms
+    fi
+    i=$((i + 1))
+  done
+  echo "$min"
+}
+
+for program in kernels vectors stencil mandelbrot; do
+  build "$DCC" $program $program || exit 1
+  if [ -n "$BASE" ]; then
+    build "$BASE" $program $program.base || exit 1
+  fi
+done
+
+if [ -n "$BASE" ]; then
+  printf '%-12s %10s %10s\n' kernel base/ms dcc/ms
+else
+  printf '%-12s %10s\n' kernel dcc/ms
+fi
+echo "$kernels" | while read -r name program arg; do
+  if [ -n "$BASE" ]; then
+    printf '%-12s %10s %10s\n' $name "$(best "$tmp/$program.base" $arg)" \
+      "$(best "$tmp/$program" $arg)"
+  else
+    printf '%-12s %10s\n' $name "$(best "$tmp/$program" $arg)"
+  fi
+done
@@ -0,0 +1,24 @@
+// A 512x512 stencil over a grid held in a struct
+int printf(const char *, ...);
+struct grid { int w, h; double scale; double *cells; };
+static void step(struct grid *g, double *out) {
+  for (int y = 1; y < g->h - 1; y++) {
+    for (int x = 1; x < g->w - 1; x++) {
+      double *c = g->cells;
+      out[y * g->w + x] = g->scale * (c[y * g->w + x - 1] + c[y * g->w + x + 1]
+                                      + c[(y - 1) * g->w + x] + c[(y + 1) * g->w + x]);
+    }
+  }
+}
+static double cells[512 * 512], out[512 * 512];
+int main(void) {
+  struct grid g = { 512, 512, 0.25, cells };
+  for (int i = 0; i < 512 * 512; i++) cells[i] = i % 17;
+  double s = 0;
+  for (int r = 0; r < 200; r++) {
+    step(&g, out);
+    s += out[513 + r];
+  }
+  printf("%f\n", s);
+  return 0;
+}
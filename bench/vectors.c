@@ -0,0 +1,21 @@
+// Vectorizable loops: 0 adds int arrays, 1 scales and subtracts floats, 2 is
+// daxpy on doubles
+int printf(const char *, ...);
+#define N 4096
+static int ia[N], ib[N], ic[N];
+static float fa[N], fb[N], fc[N];
+static double da[N], db[N], dc[N];
+void iadd(int *restrict c, const int *restrict a, const int *restrict b, int n) { for (int i = 0; i < n; i++) c[i] = a[i] + b[i]; }
+void fmula(float *c, const float *a, const float *b, int n, float s) { for (int i = 0; i < n; i++) c[i] = a[i] * s - b[i]; }
+void daxpy(double *restrict y, const double *restrict x, int n, double a) { for (int i = 0; i < n; i++) y[i] = a * x[i] + y[i]; }
+int main(int argc, char **argv) {
+  int which = argv[1][0] - '0';
+  for (int i = 0; i < N; i++) { ia[i] = i; ib[i] = 3 * i; fa[i] = i; fb[i] = 1; da[i] = i; db[i] = 0; }
+  for (int k = 0; k < 100000; k++) {
+    if (which == 0) iadd(ic, ia, ib, N);
+    if (which == 1) fmula(fc, fa, fb, N, 0.5f);
+    if (which == 2) daxpy(db, da, N, 1e-9);
+  }
+  printf("%d %f %f\n", ic[N - 1], fc[N - 1], db[N - 1]);
+  return 0;
+}
@@ -0,0 +1,18 @@
+// stdspec.7.9 Alternative spellings, shipped with dcc
+
+#ifndef __DCC_ISO646_H
+#define __DCC_ISO646_H
+
+#define and &&
+#define and_eq &=
+#define bitand &
+#define bitor |
+#define compl ~
+#define not !
+#define not_eq !=
+#define or ||
+#define or_eq |=
+#define xor ^
+#define xor_eq ^=
+
+#endif
@@ -0,0 +1,45 @@
+// stdspec.7.10 Sizes of integer types, shipped with dcc
+//
+// The limits of the C library's own <limits.h> that POSIX adds are included
+// after the ones of the language.
+
+#ifndef __DCC_LIMITS_H
+#define __DCC_LIMITS_H
+
+#define CHAR_BIT 8
+#define MB_LEN_MAX 16
+
+#define SCHAR_MIN (-128)
+#define SCHAR_MAX 127
+#define UCHAR_MAX 255
+#define CHAR_MIN SCHAR_MIN
+#define CHAR_MAX SCHAR_MAX
+
+#define SHRT_MIN (-32768)
+#define SHRT_MAX 32767
+#define USHRT_MAX 65535
+
+#define INT_MIN (-INT_MAX - 1)
+#define INT_MAX 2147483647
+#define UINT_MAX 4294967295U
+
+#define LONG_MIN (-LONG_MAX - 1L)
+#define LONG_MAX 9223372036854775807L
+#define ULONG_MAX 18446744073709551615UL
+
+#define LLONG_MIN (-LLONG_MAX - 1LL)
+#define LLONG_MAX 9223372036854775807LL
+#define ULLONG_MAX 18446744073709551615ULL
+
+#include <features.h>
+#ifdef __USE_POSIX
+#include <bits/posix1_lim.h>
+#endif
+#ifdef __USE_POSIX2
+#include <bits/posix2_lim.h>
+#endif
+#ifdef __USE_XOPEN
+#include <bits/xopen_lim.h>
+#endif
+
+#endif
@@ -0,0 +1,31 @@
+// stdspec.7.15 Variable arguments, shipped with dcc
+//
+// A va_list follows the System V x86-64 ABI, whose layout the __builtin_va_*
+// builtins and the back ends agree on. The C library includes this header
+// with __need___va_list for __gnuc_va_list alone.
+
+#ifndef __DCC_VA_LIST
+#define __DCC_VA_LIST
+struct __va_list_tag {
+  unsigned int gp_offset;
+  unsigned int fp_offset;
+  void *overflow_arg_area;
+  void *reg_save_area;
+};
+typedef struct __va_list_tag __builtin_va_list[1];
+typedef __builtin_va_list __gnuc_va_list;
+#endif
+
+#ifdef __need___va_list
+#undef __need___va_list
+#elif !defined(__DCC_STDARG_H)
+#define __DCC_STDARG_H
+
+typedef __builtin_va_list va_list;
+
+#define va_start(ap, param) __builtin_va_start(ap, param)
+#define va_arg(ap, type) __builtin_va_arg(ap, type)
+#define va_copy(dest, src) __builtin_va_copy(dest, src)
+#define va_end(ap) __builtin_va_end(ap)
+
+#endif
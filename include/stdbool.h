@@ -0,0 +1,11 @@
+// stdspec.7.16 Boolean type and values, shipped with dcc
+
+#ifndef __DCC_STDBOOL_H
+#define __DCC_STDBOOL_H
+
+#define bool _Bool
+#define true 1
+#define false 0
+#define __bool_true_false_are_defined 1
+
+#endif
@@ -0,0 +1,22 @@
+// stdspec.7.17 Common definitions, shipped with dcc
+//
+// The C library asks for parts of this header with __need_size_t and the
+// like; they are all defined on the first inclusion whatever was asked for.
+
+#ifndef __DCC_STDDEF_H
+#define __DCC_STDDEF_H
+
+typedef long ptrdiff_t;
+typedef unsigned long size_t;
+typedef int wchar_t;
+
+#define NULL ((void*)0)
+#define offsetof(type, member) ((size_t)&((type*)0)->member)
+
+#endif
+
+#undef __need_ptrdiff_t
+#undef __need_size_t
+#undef __need_wchar_t
+#undef __need_NULL
+#undef __need_offsetof
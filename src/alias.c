@@ -0,0 +1,755 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "alias.h"
+#include "parse.h"
+#include "ssa.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Analysis
+////////////////////////////////////////////////////////////////////////////////
+
+static bool is_object(const ir_func_t *func, ir_ref_t ref) {
+  enum ir_op op = func->instrs.data[ref].op;
+  return op == IR_SLOT || op == IR_GLOBAL || op == IR_STRING;
+}
+
+bool dcc_ir_same_root(const ir_func_t *func, ir_ref_t a, ir_ref_t b) {
+  const ir_instr_t *x = &func->instrs.data[a], *y = &func->instrs.data[b];
+  if (a == b) {
+    return true;
+  } else if (x->op != y->op) {
+    return false;
+  }
+  switch (x->op) {
+  case IR_PARAM:
+  case IR_SLOT:
+    return x->imm == y->imm;
+  case IR_GLOBAL:
+    return x->symbol == y->symbol;
+  case IR_STRING:
+    return x->string == y->string;
+  default:
+    return false;
+  }
+}
+
+// Whether a root is an address that other values are added to, rather than
+// an index into one
+static bool is_base(const ir_func_t *func, ir_ref_t ref) {
+  if (ref == IR_NONE) {
+    return false;
+  }
+  const ir_instr_t *instr = &func->instrs.data[ref];
+  if (instr->op == IR_PARAM) {
+    const type_t *type = func->params[instr->imm];
+    return type->tag == TYPE_POINTER || !dcc_type_is_scalar(type);
+  }
+  return is_object(func, ref);
+}
+
+static bool is_restrict(const ir_func_t *func, ir_ref_t ref) {
+  const ir_instr_t *instr = &func->instrs.data[ref];
+  return instr->op == IR_PARAM && func->params[instr->imm]->tag == TYPE_POINTER
+    && (func->params[instr->imm]->qual & TYPE_QUAL_RESTRICT);
+}
+
+static void set_root(ir_alias_t *alias, ir_ref_t ref, ir_ref_t root, int64_t offset,
+                     bool is_exact, bool *changed) {
+  if (alias->roots[ref] != root || alias->offsets[ref] != offset
+      || alias->is_exact[ref] != is_exact) {
+    alias->roots[ref] = root;
+    alias->offsets[ref] = offset;
+    alias->is_exact[ref] = is_exact;
+    *changed = true;
+  }
+}
+
+// Trace an offset from the roots of its operands, where IR_NONE is the root of
+// a phi that is not known yet
+static void trace_offset(ir_alias_t *alias, const bool *is_constant, ir_ref_t ref,
+                         bool *changed) {
+  const ir_func_t *func = alias->func;
+  const ir_instr_t *instr = &func->instrs.data[ref];
+  ir_ref_t a = instr->args[0], b = instr->args[1];
+  int64_t value;
+  if (alias->roots[a] == IR_NONE || alias->roots[b] == IR_NONE) {
+    set_root(alias, ref, IR_NONE, 0, false, changed);
+  } else if (is_constant[b] && dcc_ir_constant_value(func, b, &value)) {
+    value = instr->op == IR_ADD ? value : -(uint64_t)value;
+    set_root(alias, ref, alias->roots[a], alias->offsets[a] + value, alias->is_exact[a],
+             changed);
+  } else if (instr->op == IR_ADD && is_constant[a] && dcc_ir_constant_value(func, a, &value)) {
+    set_root(alias, ref, alias->roots[b], alias->offsets[b] + value, alias->is_exact[b],
+             changed);
+  } else if (is_base(func, alias->roots[a]) && !is_base(func, alias->roots[b])) {
+    set_root(alias, ref, alias->roots[a], 0, false, changed);
+  } else if (instr->op == IR_ADD && is_base(func, alias->roots[b])
+             && !is_base(func, alias->roots[a])) {
+    set_root(alias, ref, alias->roots[b], 0, false, changed);
+  } else {
+    set_root(alias, ref, ref, 0, true, changed);
+  }
+}
+
+// A phi has the root all its operands share, other than those that loop back
+// through it or are not known yet, or else is its own root. It only ever goes
+// from unknown to one root to its own, so tracing settles.
+static void trace_phi(ir_alias_t *alias, ir_ref_t ref, bool *changed) {
+  const ir_func_t *func = alias->func;
+  const ir_instr_t *instr = &func->instrs.data[ref];
+  ir_ref_t root = IR_NONE;
+  for (uint32_t k = 0; k < instr->count; k++) {
+    ir_ref_t arg = alias->roots[instr->args[k]];
+    if (arg == IR_NONE || arg == ref) {
+      continue;
+    } else if (root == IR_NONE) {
+      root = arg;
+    } else if (!dcc_ir_same_root(func, root, arg)) {
+      root = ref;
+      break;
+    }
+  }
+  ir_ref_t old = alias->roots[ref];
+  if (old != IR_NONE && old != root) {
+    root = ref;
+  }
+  set_root(alias, ref, root, 0, false, changed);
+}
+
+// Whether a use of an address derived from `root` keeps it from escaping
+static bool is_contained(const ir_alias_t *alias, ir_ref_t user, uint32_t index,
+                         ir_ref_t root) {
+  const ir_func_t *func = alias->func;
+  const ir_instr_t *instr = &func->instrs.data[user];
+  switch (instr->op) {
+  case IR_LOAD:
+  case IR_STORE:
+  case IR_MEMZERO:
+    return index == 0;
+  case IR_MEMCPY:
+    return true;
+  case IR_ADD:
+  case IR_PHI:
+    return dcc_ir_same_root(func, alias->roots[user], root);
+  case IR_SUB:
+    // the distance between two addresses in the object is only an index
+    return dcc_ir_same_root(func, alias->roots[user], root)
+      || (dcc_ir_same_root(func, alias->roots[instr->args[0]], root)
+          && dcc_ir_same_root(func, alias->roots[instr->args[1]], root));
+  default:
+    return instr->op >= IR_EQ && instr->op <= IR_UGE;
+  }
+}
+
+ir_alias_t dcc_ir_alias(const ir_func_t *func) {
+  uint32_t n = func->instrs.size;
+  ir_alias_t alias = { func, n };
+  alias.roots = dcc_malloc(n * sizeof(ir_ref_t));
+  alias.offsets = dcc_calloc(n, sizeof(int64_t));
+  alias.is_exact = dcc_malloc(n * sizeof(bool));
+  alias.slot_escapes = dcc_calloc(func->slots.size, sizeof(bool));
+  alias.param_escapes = dcc_calloc(func->param_count, sizeof(bool));
+  // arithmetic on constants, such as the offset of a[0], is folded as it is
+  // traced, and operands come first except for those of phis
+  bool *is_constant = dcc_malloc(n * sizeof(bool));
+  for (ir_ref_t ref = 0; ref < n; ref++) {
+    const ir_instr_t *instr = &func->instrs.data[ref];
+    bool is_phi = instr->op == IR_PHI && instr->kind == IR_I64;
+    alias.roots[ref] = is_phi ? IR_NONE : ref;
+    alias.is_exact[ref] = !is_phi;
+    is_constant[ref] = instr->op == IR_CONST
+      || (instr->op >= IR_ADD && instr->op <= IR_FCONV && instr->count > 0);
+    for (uint32_t k = 0; k < instr->count && is_constant[ref]; k++) {
+      is_constant[ref] = instr->args[k] < ref && is_constant[instr->args[k]];
+    }
+  }
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (ir_ref_t ref = 0; ref < n; ref++) {
+      const ir_instr_t *instr = &func->instrs.data[ref];
+      if (instr->kind != IR_I64) {
+        continue;
+      } else if (instr->op == IR_ADD || instr->op == IR_SUB) {
+        trace_offset(&alias, is_constant, ref, &changed);
+      } else if (instr->op == IR_PHI) {
+        trace_phi(&alias, ref, &changed);
+      }
+    }
+  }
+  // what is left unknown only ever loops back on itself
+  for (ir_ref_t ref = 0; ref < n; ref++) {
+    if (alias.roots[ref] == IR_NONE) {
+      alias.roots[ref] = ref;
+    }
+  }
+  free(is_constant);
+
+  for (ir_ref_t ref = 0; ref < n; ref++) {
+    const ir_instr_t *instr = &func->instrs.data[ref];
+    if (instr->op == IR_NOP) {
+      continue;
+    }
+    for (uint32_t k = 0; k < instr->count; k++) {
+      ir_ref_t root = alias.roots[instr->args[k]];
+      const ir_instr_t *object = &func->instrs.data[root];
+      if ((object->op == IR_SLOT || object->op == IR_PARAM)
+          && !is_contained(&alias, ref, k, root)) {
+        bool *escapes = object->op == IR_SLOT ? alias.slot_escapes : alias.param_escapes;
+        escapes[object->imm] = true;
+      }
+    }
+  }
+  return alias;
+}
+
+void dcc_ir_alias_free(ir_alias_t *alias) {
+  free(alias->roots);
+  free(alias->offsets);
+  free(alias->is_exact);
+  free(alias->slot_escapes);
+  free(alias->param_escapes);
+}
+
+bool dcc_ir_alias_root(const ir_alias_t *alias, ir_ref_t address, ir_ref_t *root,
+                       int64_t *offset) {
+  if (address >= alias->count) {
+    *root = address;
+    *offset = 0;
+    return true;
+  }
+  *root = alias->roots[address];
+  *offset = alias->offsets[address];
+  return alias->is_exact[address];
+}
+
+// Whether only its own root reaches a slot
+static bool is_private(const ir_alias_t *alias, ir_ref_t root) {
+  const ir_instr_t *instr = &alias->func->instrs.data[root];
+  return instr->op == IR_SLOT && !alias->slot_escapes[instr->imm];
+}
+
+// Whether the object of a `restrict` parameter is kept from `other`
+static bool is_restricted(const ir_alias_t *alias, ir_ref_t root, ir_ref_t other) {
+  const ir_func_t *func = alias->func;
+  if (!is_restrict(func, root)) {
+    return false;
+  }
+  bool is_named = is_object(func, other) || func->instrs.data[other].op == IR_PARAM;
+  return is_named || !alias->param_escapes[func->instrs.data[root].imm];
+}
+
+static bool roots_may_share(const ir_alias_t *alias, ir_ref_t a, ir_ref_t b) {
+  const ir_func_t *func = alias->func;
+  if (dcc_ir_same_root(func, a, b)) {
+    return true;
+  }
+  return !(is_object(func, a) && is_object(func, b)) && !is_private(alias, a)
+    && !is_private(alias, b) && !is_restricted(alias, a, b) && !is_restricted(alias, b, a);
+}
+
+bool dcc_ir_may_share(const ir_alias_t *alias, ir_ref_t a, ir_ref_t b) {
+  int64_t offset;
+  ir_ref_t x, y;
+  dcc_ir_alias_root(alias, a, &x, &offset);
+  dcc_ir_alias_root(alias, b, &y, &offset);
+  return roots_may_share(alias, x, y);
+}
+
+static ir_kind_t scalar_kind(ir_kind_t kind) {
+  return dcc_ir_is_vector(kind) ? dcc_ir_lane(kind) : kind;
+}
+
+// Whether the types of two accesses keep them apart
+static bool types_differ(ir_access_t a, ir_access_t b) {
+  ir_kind_t x = scalar_kind(a.kind), y = scalar_kind(b.kind);
+  return x != y && x != IR_VOID && y != IR_VOID && x != IR_I8 && y != IR_I8
+    && !a.is_any_type && !b.is_any_type;
+}
+
+bool dcc_ir_may_alias(const ir_alias_t *alias, ir_access_t a, ir_access_t b) {
+  ir_ref_t x, y;
+  int64_t x_offset, y_offset;
+  bool is_exact = dcc_ir_alias_root(alias, a.address, &x, &x_offset);
+  is_exact &= dcc_ir_alias_root(alias, b.address, &y, &y_offset);
+  if (dcc_ir_same_root(alias->func, x, y) && is_exact) {
+    return x_offset < y_offset + (int64_t)b.size && y_offset < x_offset + (int64_t)a.size;
+  }
+  return roots_may_share(alias, x, y) && !types_differ(a, b);
+}
+
+static uint64_t kind_size(ir_kind_t kind) {
+  static const uint8_t SIZES[] = { 0, 1, 2, 4, 8, 4, 8 };
+  return dcc_ir_is_vector(kind) ? 16 : SIZES[kind];
+}
+
+ir_access_t dcc_ir_access(const ir_func_t *func, ir_ref_t ref) {
+  const ir_instr_t *instr = &func->instrs.data[ref];
+  ir_kind_t kind = instr->op == IR_STORE ? func->instrs.data[instr->args[1]].kind : instr->kind;
+  ir_access_t access = { instr->args[0], kind_size(kind), kind,
+                         (instr->flags & IR_ANY_TYPE) != 0 };
+  return access;
+}
+
+// Whether a call may write the object at `address`
+static bool call_may_write(const ir_alias_t *alias, ir_ref_t address) {
+  ir_ref_t root;
+  int64_t offset;
+  dcc_ir_alias_root(alias, address, &root, &offset);
+  const ir_func_t *func = alias->func;
+  // writing a string literal is undefined
+  return func->instrs.data[root].op != IR_STRING && !is_private(alias, root)
+    && !(is_restrict(func, root) && !alias->param_escapes[func->instrs.data[root].imm]);
+}
+
+bool dcc_ir_may_write(const ir_alias_t *alias, ir_ref_t writer, ir_access_t access) {
+  const ir_func_t *func = alias->func;
+  const ir_instr_t *instr = &func->instrs.data[writer];
+  switch (instr->op) {
+  case IR_STORE:
+    return dcc_ir_may_alias(alias, dcc_ir_access(func, writer), access);
+  case IR_MEMCPY:
+  case IR_MEMZERO: {
+    ir_access_t bytes = { instr->args[0], instr->imm, IR_VOID, true };
+    return dcc_ir_may_alias(alias, bytes, access);
+  }
+  case IR_CALL:
+    return call_may_write(alias, access.address);
+  default:
+    return false;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Redundant loads
+////////////////////////////////////////////////////////////////////////////////
+
+#define MAX_KNOWN 32 // values remembered at once, dropping the oldest
+
+// A value that memory is known to hold
+typedef struct {
+  ir_access_t access;
+  ir_ref_t value;
+} known_t;
+DECLARE_VEC(known_t, known_vec);
+DEFINE_VEC2(known_t, known_vec);
+
+typedef struct {
+  ir_func_t *func;
+  ir_alias_t alias;
+  known_vec_t *known; // at the end of each block
+  uint32_t *visited; // the block whose start was last worked out through this one
+  uint32_vec_t work;
+  bool changed;
+} forward_t;
+
+static bool same_address(const ir_alias_t *alias, ir_ref_t a, ir_ref_t b) {
+  ir_ref_t x, y;
+  int64_t x_offset, y_offset;
+  bool is_exact = dcc_ir_alias_root(alias, a, &x, &x_offset);
+  is_exact &= dcc_ir_alias_root(alias, b, &y, &y_offset);
+  return a == b || (is_exact && x_offset == y_offset && dcc_ir_same_root(alias->func, x, y));
+}
+
+static void remember(known_vec_t *known, ir_access_t access, ir_ref_t value) {
+  if (known->size == MAX_KNOWN) {
+    memmove(&known->data[0], &known->data[1], (MAX_KNOWN - 1) * sizeof(known_t));
+    known->size--;
+  }
+  known_t entry = { access, value };
+  known_vec_push(known, entry);
+}
+
+// Forget what an instruction may write
+static void clobber(const forward_t *fwd, known_vec_t *known, ir_ref_t ref) {
+  size_t kept = 0;
+  for (size_t i = 0; i < known->size; i++) {
+    if (!dcc_ir_may_write(&fwd->alias, ref, known->data[i].access)) {
+      known->data[kept++] = known->data[i];
+    }
+  }
+  known->size = kept;
+}
+
+// What memory holds at the start of a block, which is what it held at the end
+// of its immediate dominator less what the blocks on paths between them write
+static known_vec_t block_start(forward_t *fwd, uint32_t b) {
+  ir_func_t *func = fwd->func;
+  uint32_t idom = func->blocks.data[b].idom;
+  known_vec_t known = known_vec_new();
+  for (size_t i = 0; i < fwd->known[idom].size; i++) {
+    known_vec_push(&known, fwd->known[idom].data[i]);
+  }
+  const uint32_vec_t *preds = &func->blocks.data[b].preds;
+  for (size_t p = 0; p < preds->size; p++) {
+    if (preds->data[p] != idom && fwd->visited[preds->data[p]] != b) {
+      fwd->visited[preds->data[p]] = b;
+      uint32_vec_push(&fwd->work, preds->data[p]);
+    }
+  }
+  while (fwd->work.size) {
+    uint32_t x = uint32_vec_pop(&fwd->work);
+    const ir_block_t *block = &func->blocks.data[x];
+    for (size_t k = 0; k < block->instrs.size && known.size; k++) {
+      clobber(fwd, &known, block->instrs.data[k]);
+    }
+    for (size_t p = 0; p < block->preds.size; p++) {
+      uint32_t pred = block->preds.data[p];
+      if (pred != idom && fwd->visited[pred] != b) {
+        fwd->visited[pred] = b;
+        uint32_vec_push(&fwd->work, pred);
+      }
+    }
+  }
+  return known;
+}
+
+static void forward_block(forward_t *fwd, uint32_t b, known_vec_t *known) {
+  ir_func_t *func = fwd->func;
+  const uint32_vec_t *instrs = &func->blocks.data[b].instrs;
+  for (size_t k = 0; k < instrs->size; k++) {
+    ir_ref_t ref = instrs->data[k];
+    ir_instr_t *instr = &func->instrs.data[ref];
+    if (instr->op != IR_LOAD) {
+      clobber(fwd, known, ref);
+      if (instr->op == IR_STORE && !(instr->flags & IR_VOLATILE)) {
+        remember(known, dcc_ir_access(func, ref), instr->args[1]);
+      }
+      continue;
+    } else if (instr->flags & IR_VOLATILE) {
+      continue;
+    }
+    ir_access_t access = dcc_ir_access(func, ref);
+    ir_ref_t value = IR_NONE;
+    for (size_t i = known->size; i-- > 0 && value == IR_NONE;) {
+      const known_t *entry = &known->data[i];
+      if (entry->access.kind == access.kind
+          && same_address(&fwd->alias, entry->access.address, access.address)) {
+        value = entry->value;
+      }
+    }
+    if (value == IR_NONE) {
+      remember(known, access, ref);
+      continue;
+    }
+    dcc_ir_replace(func, ref, value);
+    instr->op = IR_NOP;
+    instr->count = 0;
+    fwd->changed = true;
+  }
+}
+
+void dcc_eliminate_loads(ir_func_t *func) {
+  uint32_t n = func->blocks.size;
+  forward_t fwd = { func, dcc_ir_alias(func) };
+  fwd.known = dcc_malloc(n * sizeof(known_vec_t));
+  fwd.visited = dcc_malloc(n * sizeof(uint32_t));
+  memset(fwd.visited, 0xff, n * sizeof(uint32_t));
+  fwd.work = uint32_vec_new();
+  dcc_ir_uses(func);
+
+  // blocks are in reverse postorder, so each comes after its dominator
+  for (uint32_t b = 0; b < n; b++) {
+    fwd.known[b] = b ? block_start(&fwd, b) : known_vec_new();
+    forward_block(&fwd, b, &fwd.known[b]);
+  }
+
+  for (uint32_t b = 0; b < n; b++) {
+    known_vec_free(&fwd.known[b]);
+  }
+  free(fwd.known);
+  free(fwd.visited);
+  uint32_vec_free(&fwd.work);
+  dcc_ir_alias_free(&fwd.alias);
+  if (fwd.changed) {
+    dcc_ir_compact(func);
+    dcc_ir_dominators(func);
+    dcc_ir_verify(func);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Promotion
+////////////////////////////////////////////////////////////////////////////////
+
+#define MAX_FIELDS 16 // variables a slot is split into, beyond which it stays in memory
+
+// A scalar at a constant offset into a promoted slot
+typedef struct {
+  uint32_t slot;
+  int64_t offset;
+  uint64_t size;
+  ir_kind_t kind;
+  uint32_t var;
+} field_t;
+DECLARE_VEC(field_t, field_vec);
+DEFINE_VEC2(field_t, field_vec);
+
+typedef struct {
+  ir_func_t *func;
+  ir_alias_t alias;
+  bool *is_promoted; // by slot
+  uint32_t *field_counts; // by slot
+  field_vec_t fields;
+  uint32_t *field_of; // the field each load or store accesses
+} promote_t;
+
+// The slot an address points into, or UINT32_MAX if it is not known to point
+// into one
+static uint32_t slot_of(const promote_t *p, ir_ref_t address, int64_t *offset,
+                        bool *is_exact) {
+  ir_ref_t root;
+  *is_exact = dcc_ir_alias_root(&p->alias, address, &root, offset);
+  const ir_instr_t *instr = &p->func->instrs.data[root];
+  return instr->op == IR_SLOT ? (uint32_t)instr->imm : UINT32_MAX;
+}
+
+static bool overlaps(int64_t a, uint64_t a_size, int64_t b, uint64_t b_size) {
+  return a < b + (int64_t)b_size && b < a + (int64_t)a_size;
+}
+
+// The field a load or store accesses, or UINT32_MAX if its slot has to stay
+// in memory
+static uint32_t access_field(promote_t *p, ir_ref_t ref) {
+  const ir_instr_t *instr = &p->func->instrs.data[ref];
+  ir_access_t access = dcc_ir_access(p->func, ref);
+  int64_t offset;
+  bool is_exact;
+  uint32_t s = slot_of(p, access.address, &offset, &is_exact);
+  if (s == UINT32_MAX || !p->is_promoted[s]) {
+    return UINT32_MAX;
+  }
+  const ir_slot_t *slot = &p->func->slots.data[s];
+  if (!is_exact || (instr->flags & IR_VOLATILE) || dcc_ir_is_vector(access.kind)
+      || offset < 0 || offset + access.size > slot->size) {
+    p->is_promoted[s] = false;
+    return UINT32_MAX;
+  }
+  for (size_t i = 0; i < p->fields.size; i++) {
+    const field_t *field = &p->fields.data[i];
+    if (field->slot != s || !overlaps(offset, access.size, field->offset, field->size)) {
+      continue;
+    } else if (field->offset == offset && field->kind == access.kind) {
+      return i;
+    }
+    // a union, or a type pun through a cast pointer
+    p->is_promoted[s] = false;
+    return UINT32_MAX;
+  }
+  if (p->field_counts[s]++ == MAX_FIELDS) {
+    p->is_promoted[s] = false;
+    return UINT32_MAX;
+  }
+  field_t field = { s, offset, access.size, access.kind, 0 };
+  field_vec_push(&p->fields, field);
+  return p->fields.size - 1;
+}
+
+// Keep a slot in memory unless a zeroing of it covers each field in whole or
+// not at all
+static void check_zero(promote_t *p, ir_ref_t ref) {
+  const ir_instr_t *instr = &p->func->instrs.data[ref];
+  int64_t offset;
+  bool is_exact;
+  uint32_t s = slot_of(p, instr->args[0], &offset, &is_exact);
+  if (s == UINT32_MAX || !p->is_promoted[s]) {
+    return;
+  } else if (!is_exact) {
+    p->is_promoted[s] = false;
+    return;
+  }
+  for (size_t i = 0; i < p->fields.size; i++) {
+    const field_t *field = &p->fields.data[i];
+    if (field->slot == s && overlaps(offset, instr->imm, field->offset, field->size)
+        && (field->offset < offset
+            || field->offset + field->size > offset + (uint64_t)instr->imm)) {
+      p->is_promoted[s] = false;
+    }
+  }
+}
+
+// Replace a zeroing of a promoted slot by setting the fields it covers to
+// zero, before position `k` of block `b`, and return the zeroing's new
+// position
+static uint32_t zero_fields(promote_t *p, uint32_t b, uint32_t k, ir_ref_t ref) {
+  ir_func_t *func = p->func;
+  int64_t offset;
+  bool is_exact;
+  uint32_t s = slot_of(p, func->instrs.data[ref].args[0], &offset, &is_exact);
+  uint64_t size = func->instrs.data[ref].imm;
+  for (size_t i = 0; i < p->fields.size; i++) {
+    const field_t *field = &p->fields.data[i];
+    if (field->slot != s || !overlaps(offset, size, field->offset, field->size)) {
+      continue;
+    }
+    bool is_float = field->kind == IR_F32 || field->kind == IR_F64;
+    ir_ref_t zero = dcc_ir_insert(func, b, k++, is_float ? IR_FCONST : IR_CONST,
+                                  field->kind, 0, 0);
+    ir_ref_t set = dcc_ir_insert(func, b, k++, IR_SET, IR_VOID, 1, &zero);
+    func->instrs.data[set].imm = field->var;
+  }
+  return k;
+}
+
+// Whether an instruction is an address into a slot
+static bool is_derived(const promote_t *p, ir_ref_t ref, uint32_t s) {
+  const ir_instr_t *instr = &p->func->instrs.data[ref];
+  const ir_instr_t *root = &p->func->instrs.data[p->alias.roots[ref]];
+  return (instr->op == IR_SLOT || instr->op == IR_ADD || instr->op == IR_SUB
+          || instr->op == IR_PHI)
+    && root->op == IR_SLOT && root->imm == s;
+}
+
+// Drop the addresses into promoted slots that nothing reads any more, and the
+// slots themselves when none is left
+static void drop_addresses(promote_t *p) {
+  ir_func_t *func = p->func;
+  uint32_t n = p->alias.count, slot_count = func->slots.size;
+  bool *is_used = dcc_calloc(slot_count, sizeof(bool));
+  dcc_ir_uses(func);
+  for (ir_ref_t ref = 0; ref < n; ref++) {
+    ir_ref_t root = p->alias.roots[ref];
+    uint32_t s = func->instrs.data[root].imm;
+    if (func->instrs.data[root].op != IR_SLOT || !p->is_promoted[s] || !is_derived(p, ref, s)) {
+      continue;
+    }
+    for (uint32_t u = func->use_start[ref]; u < func->use_start[ref + 1]; u++) {
+      ir_ref_t user = func->uses[u].user;
+      is_used[s] |= user >= n || !is_derived(p, user, s);
+    }
+  }
+  // backwards, so that the roots go last
+  for (ir_ref_t ref = n; ref-- > 0;) {
+    ir_ref_t root = p->alias.roots[ref];
+    uint32_t s = func->instrs.data[root].imm;
+    if (func->instrs.data[root].op == IR_SLOT && p->is_promoted[s] && !is_used[s]
+        && is_derived(p, ref, s)) {
+      func->instrs.data[ref].op = IR_NOP;
+      func->instrs.data[ref].count = 0;
+    }
+  }
+  for (uint32_t s = 0; s < slot_count; s++) {
+    if (p->is_promoted[s] && !is_used[s]) {
+      func->slots.data[s].size = 0;
+      func->slots.data[s].align = 1;
+    }
+  }
+  free(is_used);
+}
+
+void dcc_promote_slots(ir_func_t *func) {
+  uint32_t n = func->instrs.size, slot_count = func->slots.size;
+  if (!slot_count) {
+    return;
+  }
+  promote_t p = { func, dcc_ir_alias(func) };
+  p.is_promoted = dcc_malloc(slot_count * sizeof(bool));
+  for (uint32_t s = 0; s < slot_count; s++) {
+    p.is_promoted[s] = !p.alias.slot_escapes[s];
+  }
+  p.field_counts = dcc_calloc(slot_count, sizeof(uint32_t));
+  p.fields = field_vec_new();
+  p.field_of = dcc_malloc(n * sizeof(uint32_t));
+
+  // fields come from loads and stores, and copies keep a slot in memory
+  for (ir_ref_t ref = 0; ref < n; ref++) {
+    const ir_instr_t *instr = &func->instrs.data[ref];
+    p.field_of[ref] = UINT32_MAX;
+    if (instr->op == IR_LOAD || instr->op == IR_STORE) {
+      p.field_of[ref] = access_field(&p, ref);
+    } else if (instr->op == IR_MEMCPY) {
+      for (uint32_t k = 0; k < 2; k++) {
+        int64_t offset;
+        bool is_exact;
+        uint32_t s = slot_of(&p, instr->args[k], &offset, &is_exact);
+        if (s != UINT32_MAX) {
+          p.is_promoted[s] = false;
+        }
+      }
+    }
+  }
+  for (ir_ref_t ref = 0; ref < n; ref++) {
+    if (func->instrs.data[ref].op == IR_MEMZERO) {
+      check_zero(&p, ref);
+    }
+  }
+
+  bool is_any = false;
+  for (size_t i = 0; i < p.fields.size; i++) {
+    field_t *field = &p.fields.data[i];
+    if (p.is_promoted[field->slot]) {
+      field->var = func->vars.size;
+      ir_var_t var = { field->kind, 0 };
+      ir_var_vec_push(&func->vars, var);
+      is_any = true;
+    }
+  }
+
+  // loads become reads of their field's variable and stores writes of it
+  for (uint32_t b = 0; b < func->blocks.size && is_any; b++) {
+    for (uint32_t k = 0; k < func->blocks.data[b].instrs.size; k++) {
+      ir_ref_t ref = func->blocks.data[b].instrs.data[k];
+      if (ref >= n) {
+        continue;
+      }
+      ir_instr_t *instr = &func->instrs.data[ref];
+      int64_t offset;
+      bool is_exact;
+      if (instr->op == IR_MEMZERO) {
+        uint32_t s = slot_of(&p, instr->args[0], &offset, &is_exact);
+        if (s != UINT32_MAX && p.is_promoted[s]) {
+          k = zero_fields(&p, b, k, ref);
+          func->instrs.data[ref].op = IR_NOP;
+          func->instrs.data[ref].count = 0;
+        }
+        continue;
+      }
+      uint32_t f = p.field_of[ref];
+      if (f == UINT32_MAX || !p.is_promoted[p.fields.data[f].slot]) {
+        continue;
+      } else if (instr->op == IR_LOAD) {
+        instr->op = IR_GET;
+        instr->count = 0;
+      } else {
+        instr->op = IR_SET;
+        instr->args++;
+        instr->count = 1;
+      }
+      instr->flags = 0;
+      instr->imm = p.fields.data[f].var;
+    }
+  }
+  if (is_any) {
+    drop_addresses(&p);
+  }
+
+  dcc_ir_alias_free(&p.alias);
+  free(p.is_promoted);
+  free(p.field_counts);
+  field_vec_free(&p.fields);
+  free(p.field_of);
+  if (is_any) {
+    dcc_ir_ssa(func);
+    dcc_ir_verify(func);
+  }
+}
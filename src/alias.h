@@ -0,0 +1,101 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Alias analysis. Every address is traced back through offsets and phis to its
+  root: a slot, a global, a string, a parameter, or some other value such as a
+  loaded pointer, together with its constant offset from the root when there
+  is one. Accesses through the same root overlap unless their offsets keep
+  them apart, and accesses through different roots overlap unless one of
+  three rules says otherwise:
+
+  - Distinct slots, globals and strings are distinct objects, and a slot whose
+    address never escapes, by being stored, passed, returned or mixed into
+    arithmetic other than offsets, is only reached through its own root.
+  - The object a `restrict` parameter points to is only reached through that
+    parameter while it is written, so no other parameter or object reaches
+    it, nor any other pointer unless the parameter escapes.
+  - An object is only accessed through its own type or a character type. The
+    IR knows kinds rather than types, so accesses of two different kinds do
+    not overlap unless one is a byte, or is marked IR_ANY_TYPE because it goes
+    through a union or a bit-field, where C lets types share memory. This
+    tells apart int, long and double but not int and unsigned, or long and a
+    pointer, which is looser than C's rule but never stricter.
+
+  Promotion moves the scalars of a slot that never escapes into variables,
+  and so into SSA values, when it is only reached through loads and stores at
+  constant offsets that do not partly overlap, and zeroings that cover each
+  of them whole. Lowering already keeps a local whose address is never taken
+  in a variable; this catches the members of a local struct, the elements of
+  a local array indexed by constants, and locals whose address only reaches
+  callees that were inlined.
+
+  Redundant load elimination then walks the dominator tree with the values
+  memory is known to hold, from loads and stores, and replaces loads of them.
+*/
+
+#pragma once
+
+#include "ir.h"
+
+typedef struct {
+  const ir_func_t *func;
+  uint32_t count; // of the instructions analysed, whose roots are known
+  ir_ref_t *roots;
+  int64_t *offsets;
+  bool *is_exact; // whether the offset from the root is constant
+  bool *slot_escapes, *param_escapes; // by index
+} ir_alias_t;
+
+// An access to `size` bytes of memory of `kind`, which is IR_VOID for bytes
+// of any type
+typedef struct {
+  ir_ref_t address;
+  uint64_t size;
+  ir_kind_t kind;
+  bool is_any_type;
+} ir_access_t;
+
+// Analyse the addresses of a function in SSA form, whose instructions must not
+// change until the analysis is freed, though more may be added as long as no
+// address escapes through them
+ir_alias_t dcc_ir_alias(const ir_func_t *func);
+void dcc_ir_alias_free(ir_alias_t *alias);
+
+// The root of an address, setting `offset` and returning true if the address
+// is a constant offset from it
+bool dcc_ir_alias_root(const ir_alias_t *alias, ir_ref_t address, ir_ref_t *root,
+                       int64_t *offset);
+// Whether two roots are the same object or parameter, though the instructions
+// naming them differ
+bool dcc_ir_same_root(const ir_func_t *func, ir_ref_t a, ir_ref_t b);
+// Whether two addresses may point into the same object
+bool dcc_ir_may_share(const ir_alias_t *alias, ir_ref_t a, ir_ref_t b);
+bool dcc_ir_may_alias(const ir_alias_t *alias, ir_access_t a, ir_access_t b);
+
+// The memory a load or store accesses
+ir_access_t dcc_ir_access(const ir_func_t *func, ir_ref_t ref);
+// Whether an instruction may write memory that an access touches
+bool dcc_ir_may_write(const ir_alias_t *alias, ir_ref_t writer, ir_access_t access);
+
+// Replace loads of values that an earlier load or store of the same address
+// left in memory, when nothing in between may have written it
+void dcc_eliminate_loads(ir_func_t *func);
+
+// Move the scalars of slots that never escape into SSA values
+void dcc_promote_slots(ir_func_t *func);
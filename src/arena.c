@@ -0,0 +1,67 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "arena.h"
+#include "dcc.h"
+
+#define CHUNK_SIZE (64 * 1024)
+
+// The strictest alignment of any object, as C11's max_align_t has it
+typedef union {
+  long double ld;
+  long long ll;
+  void *p;
+  void (*f)(void);
+} arena_align_t;
+
+struct arena_chunk {
+  arena_chunk_t *next;
+  size_t size;
+  arena_align_t data[];
+};
+
+arena_t dcc_arena_new() {
+  arena_t arena = { 0, 0 };
+  return arena;
+}
+
+void dcc_arena_free(arena_t *arena) {
+  while (arena->chunks) {
+    arena_chunk_t *next = arena->chunks->next;
+    free(arena->chunks);
+    arena->chunks = next;
+  }
+  arena->used = 0;
+}
+
+void* dcc_arena_alloc(arena_t *arena, size_t size) {
+  size = (size + sizeof(arena_align_t) - 1) / sizeof(arena_align_t) * sizeof(arena_align_t);
+  if (!arena->chunks || arena->used + size > arena->chunks->size) {
+    // an oversized request gets a chunk of its own
+    size_t chunk_size = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+    arena_chunk_t *chunk = dcc_malloc(sizeof *chunk + chunk_size);
+    chunk->next = arena->chunks;
+    chunk->size = chunk_size;
+    arena->chunks = chunk;
+    arena->used = 0;
+  }
+  void *result = (char*)arena->chunks->data + arena->used;
+  arena->used += size;
+  return memset(result, 0, size);
+}
@@ -0,0 +1,38 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+  Arena allocation. Many small objects that die together are bumped out of
+  large chunks and released at once, with no per-object bookkeeping.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+typedef struct arena_chunk arena_chunk_t;
+
+typedef struct {
+  arena_chunk_t *chunks; // the newest first
+  size_t used; // bytes of the newest chunk handed out
+} arena_t;
+
+arena_t dcc_arena_new();
+void dcc_arena_free(arena_t *arena);
+
+// Zeroed memory, aligned for any object, which lives until the arena is freed
+void* dcc_arena_alloc(arena_t *arena, size_t size);
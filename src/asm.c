@@ -0,0 +1,402 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "asm.h"
+
+DEFINE_VEC2(asm_item_t, asm_item_vec);
+
+static void free_symbol(asm_symbol_t *symbol) {
+  free(symbol->name);
+}
+DEFINE_VEC3(asm_symbol_t, asm_symbol_vec, free_symbol);
+
+const asm_operand_t ASM_NO_OPERAND = { ASM_NONE };
+
+asm_t* dcc_asm_new() {
+  asm_t *as = dcc_malloc(sizeof *as);
+  as->items = asm_item_vec_new();
+  as->symbols = asm_symbol_vec_new();
+  as->arena = dcc_arena_new();
+  as->temps = 0;
+  return as;
+}
+
+void dcc_asm_free(asm_t *as) {
+  asm_item_vec_free(&as->items);
+  asm_symbol_vec_free(&as->symbols);
+  dcc_arena_free(&as->arena);
+  free(as);
+}
+
+uint32_t dcc_asm_symbol(asm_t *as, const char *name, enum asm_symbol_type type,
+                        bool is_global) {
+  size_t len = strlen(name);
+  asm_symbol_t symbol = { dcc_malloc(len + 1), type, is_global };
+  memcpy(symbol.name, name, len + 1);
+  asm_symbol_vec_push(&as->symbols, symbol);
+  return as->symbols.size - 1;
+}
+
+uint32_t dcc_asm_temp(asm_t *as) {
+  char name[16];
+  sprintf(name, ".L%" PRIu32, as->temps++);
+  return dcc_asm_symbol(as, name, ASM_TEMP, false);
+}
+
+static void push(asm_t *as, asm_item_t item) {
+  asm_item_vec_push(&as->items, item);
+}
+
+void dcc_asm_section(asm_t *as, asm_section_t section) {
+  asm_item_t item = { ASM_SECTION };
+  item.section = section;
+  push(as, item);
+}
+
+void dcc_asm_label(asm_t *as, uint32_t symbol) {
+  asm_item_t item = { ASM_LABEL };
+  item.symbol = symbol;
+  push(as, item);
+}
+
+void dcc_asm_end(asm_t *as, uint32_t symbol) {
+  asm_item_t item = { ASM_END };
+  item.symbol = symbol;
+  push(as, item);
+}
+
+void dcc_asm_align(asm_t *as, uint64_t align) {
+  asm_item_t item = { ASM_ALIGN };
+  item.size = align;
+  push(as, item);
+}
+
+void dcc_asm_bytes(asm_t *as, const void *data, size_t size) {
+  if (!size) {
+    return;
+  }
+  uint8_t *copy = dcc_arena_alloc(&as->arena, size);
+  memcpy(copy, data, size);
+  asm_item_t item = { ASM_BYTES };
+  item.bytes.data = copy;
+  item.bytes.size = size;
+  push(as, item);
+}
+
+void dcc_asm_zero(asm_t *as, uint64_t size) {
+  if (!size) {
+    return;
+  }
+  asm_item_t item = { ASM_ZERO };
+  item.size = size;
+  push(as, item);
+}
+
+void dcc_asm_address(asm_t *as, uint32_t symbol, int64_t addend) {
+  asm_item_t item = { ASM_ADDRESS };
+  item.address.symbol = symbol;
+  item.address.addend = addend;
+  push(as, item);
+}
+
+void dcc_asm_offset(asm_t *as, uint32_t symbol, int64_t addend) {
+  asm_item_t item = { ASM_OFFSET };
+  item.address.symbol = symbol;
+  item.address.addend = addend;
+  push(as, item);
+}
+
+void dcc_asm_instr(asm_t *as, enum asm_op op, uint8_t size, asm_operand_t src,
+                   asm_operand_t dst) {
+  asm_item_t item = { ASM_INSTR };
+  item.instr.op = op;
+  item.instr.size = size;
+  item.instr.cond = 0;
+  item.instr.src = src;
+  item.instr.dst = dst;
+  push(as, item);
+}
+
+void dcc_asm_cond(asm_t *as, enum asm_op op, asm_cond_t cond, asm_operand_t dst) {
+  dcc_asm_instr(as, op, 1, ASM_NO_OPERAND, dst);
+  as->items.data[as->items.size - 1].instr.cond = cond;
+}
+
+asm_operand_t dcc_asm_reg(asm_reg_t reg, uint8_t size) {
+  asm_operand_t operand = { ASM_REG };
+  operand.reg = reg;
+  operand.size = size;
+  return operand;
+}
+
+asm_operand_t dcc_asm_imm(int64_t value) {
+  asm_operand_t operand = { ASM_IMM };
+  operand.value = value;
+  return operand;
+}
+
+asm_operand_t dcc_asm_mem(asm_reg_t base, int64_t disp) {
+  asm_operand_t operand = { ASM_MEM };
+  operand.reg = base;
+  operand.value = disp;
+  return operand;
+}
+
+asm_operand_t dcc_asm_rip(uint32_t symbol, int64_t addend, enum asm_reloc reloc) {
+  asm_operand_t operand = { ASM_RIP };
+  operand.symbol = symbol;
+  operand.value = addend;
+  operand.reloc = reloc;
+  return operand;
+}
+
+asm_operand_t dcc_asm_target(uint32_t symbol, enum asm_reloc reloc) {
+  asm_operand_t operand = { ASM_TARGET };
+  operand.symbol = symbol;
+  operand.reloc = reloc;
+  return operand;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Printing
+
+static const char *const REGS[4][16] = {
+  { "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+    "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b" },
+  { "ax", "cx", "dx", "bx", "sp", "bp", "si", "di",
+    "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w" },
+  { "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+    "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d" },
+  { "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15" },
+};
+
+static const char *const CONDS[16] = {
+  "o", "no", "b", "ae", "e", "ne", "be", "a",
+  "s", "ns", "p", "np", "l", "ge", "le", "g",
+};
+
+static const char* suffix(uint8_t size) {
+  switch (size) {
+  case 1: return "b";
+  case 2: return "w";
+  case 4: return "l";
+  default: return "q";
+  }
+}
+
+static void print_operand(FILE *file, const asm_t *as, const asm_operand_t *operand) {
+  const char *name = operand->tag == ASM_RIP || operand->tag == ASM_TARGET ?
+    as->symbols.data[operand->symbol].name : 0;
+  switch (operand->tag) {
+  case ASM_NONE:
+    break;
+  case ASM_REG:
+    if (operand->reg >= ASM_XMM0) {
+      fprintf(file, "%%xmm%d", operand->reg - ASM_XMM0);
+    } else {
+      int index = operand->size == 1 ? 0 : operand->size == 2 ? 1 : operand->size == 4 ? 2 : 3;
+      fprintf(file, "%%%s", REGS[index][operand->reg]);
+    }
+    break;
+  case ASM_IMM:
+    fprintf(file, "$%" PRId64, operand->value);
+    break;
+  case ASM_MEM:
+    if (operand->value) {
+      fprintf(file, "%" PRId64, operand->value);
+    }
+    fprintf(file, "(%%%s)", REGS[3][operand->reg]);
+    break;
+  case ASM_RIP:
+    fprintf(file, "%s", name);
+    if (operand->reloc == ASM_GOT) {
+      fprintf(file, "@GOTPCREL");
+    } else if (operand->value) {
+      fprintf(file, "%+" PRId64, operand->value);
+    }
+    fprintf(file, "(%%rip)");
+    break;
+  case ASM_TARGET:
+    fprintf(file, "%s%s", name, operand->reloc == ASM_PLT ? "@PLT" : "");
+    break;
+  }
+}
+
+static const char* mnemonic(const asm_instr_t *instr, char *buffer) {
+  const char *s = suffix(instr->size);
+  const char *f = instr->size == 4 ? "s" : "d";
+  // lanes of packed integers
+  static const char *const UNPACKS[] = { "bw", "wd", "dq", "", "qdq" };
+  const char *p = instr->size == 1 ? "b" : instr->size == 2 ? "w" : instr->size == 4 ? "d" : "q";
+  switch ((enum asm_op)instr->op) {
+  case ASM_MOV: sprintf(buffer, "mov%s", s); break;
+  case ASM_MOVABS: return "movabsq";
+  case ASM_MOVZB: sprintf(buffer, "movzb%s", s); break;
+  case ASM_MOVZW: sprintf(buffer, "movzw%s", s); break;
+  case ASM_MOVSB: sprintf(buffer, "movsb%s", s); break;
+  case ASM_MOVSW: sprintf(buffer, "movsw%s", s); break;
+  case ASM_MOVSL: return "movslq";
+  case ASM_LEA: return "leaq";
+  case ASM_ADD: sprintf(buffer, "add%s", s); break;
+  case ASM_SUB: sprintf(buffer, "sub%s", s); break;
+  case ASM_IMUL: sprintf(buffer, "imul%s", s); break;
+  case ASM_AND: sprintf(buffer, "and%s", s); break;
+  case ASM_OR: sprintf(buffer, "or%s", s); break;
+  case ASM_XOR: sprintf(buffer, "xor%s", s); break;
+  case ASM_CMP: sprintf(buffer, "cmp%s", s); break;
+  case ASM_TEST: sprintf(buffer, "test%s", s); break;
+  case ASM_SHL: sprintf(buffer, "shl%s", s); break;
+  case ASM_SAR: sprintf(buffer, "sar%s", s); break;
+  case ASM_SHR: sprintf(buffer, "shr%s", s); break;
+  case ASM_NEG: sprintf(buffer, "neg%s", s); break;
+  case ASM_NOT: sprintf(buffer, "not%s", s); break;
+  case ASM_IDIV: sprintf(buffer, "idiv%s", s); break;
+  case ASM_DIV: sprintf(buffer, "div%s", s); break;
+  case ASM_CQO: return instr->size == 8 ? "cqto" : "cltd";
+  case ASM_BTC: sprintf(buffer, "btc%s", s); break;
+  case ASM_SETCC: sprintf(buffer, "set%s", CONDS[instr->cond]); break;
+  case ASM_JCC: sprintf(buffer, "j%s", CONDS[instr->cond]); break;
+  case ASM_JMP: return "jmp";
+  case ASM_CALL: return "call";
+  case ASM_RET: return "ret";
+  case ASM_LEAVE: return "leave";
+  case ASM_PUSH: return "pushq";
+  case ASM_POP: return "popq";
+  case ASM_REP_MOVSB: return "rep movsb";
+  case ASM_REP_STOSB: return "rep stosb";
+  case ASM_MOVSS: return "movss";
+  case ASM_MOVSD: return "movsd";
+  case ASM_MOVQ: return instr->size == 8 ? "movq" : "movd";
+  case ASM_ADDS: sprintf(buffer, "adds%s", f); break;
+  case ASM_SUBS: sprintf(buffer, "subs%s", f); break;
+  case ASM_MULS: sprintf(buffer, "muls%s", f); break;
+  case ASM_DIVS: sprintf(buffer, "divs%s", f); break;
+  case ASM_UCOMIS: sprintf(buffer, "ucomis%s", f); break;
+  case ASM_CVTSI2SS: sprintf(buffer, "cvtsi2ss%s", s); break;
+  case ASM_CVTSI2SD: sprintf(buffer, "cvtsi2sd%s", s); break;
+  case ASM_CVTTSS2SI: sprintf(buffer, "cvttss2si%s", s); break;
+  case ASM_CVTTSD2SI: sprintf(buffer, "cvttsd2si%s", s); break;
+  case ASM_CVTSS2SD: return "cvtss2sd";
+  case ASM_CVTSD2SS: return "cvtsd2ss";
+  case ASM_MOVUPS: return "movups";
+  case ASM_PADD: sprintf(buffer, "padd%s", p); break;
+  case ASM_PSUB: sprintf(buffer, "psub%s", p); break;
+  case ASM_PMULLW: return "pmullw";
+  case ASM_PMULUDQ: return "pmuludq";
+  case ASM_PAND: return "pand";
+  case ASM_POR: return "por";
+  case ASM_PXOR: return "pxor";
+  case ASM_PSLL: sprintf(buffer, "psll%s", p); break;
+  case ASM_PSRL: sprintf(buffer, "psrl%s", p); break;
+  case ASM_PSRA: sprintf(buffer, "psra%s", p); break;
+  case ASM_ADDP: sprintf(buffer, "addp%s", f); break;
+  case ASM_SUBP: sprintf(buffer, "subp%s", f); break;
+  case ASM_MULP: sprintf(buffer, "mulp%s", f); break;
+  case ASM_DIVP: sprintf(buffer, "divp%s", f); break;
+  case ASM_PUNPCKL: sprintf(buffer, "punpckl%s", UNPACKS[instr->size / 2]); break;
+  case ASM_PSHUFD: return "pshufd";
+  }
+  return buffer;
+}
+
+static void print_instr(FILE *file, const asm_t *as, const asm_instr_t *instr) {
+  char buffer[16];
+  fprintf(file, "\t%s", mnemonic(instr, buffer));
+  const char *separator = "\t";
+  if (instr->src.tag != ASM_NONE) {
+    fputs(separator, file);
+    print_operand(file, as, &instr->src);
+    separator = ", ";
+  }
+  if (instr->op == ASM_PSHUFD) {
+    // the register is both source and destination
+    fputs(separator, file);
+    print_operand(file, as, &instr->dst);
+  }
+  if (instr->dst.tag != ASM_NONE) {
+    fputs(separator, file);
+    bool indirect = (instr->op == ASM_JMP || instr->op == ASM_CALL) &&
+      instr->dst.tag != ASM_TARGET;
+    fputs(indirect ? "*" : "", file);
+    print_operand(file, as, &instr->dst);
+  }
+  fputc('\n', file);
+}
+
+void dcc_asm_print(FILE *file, const asm_t *as) {
+  static const char *const SECTIONS[] = {
+    [ASM_TEXT] = ".text",
+    [ASM_DATA] = ".data",
+    [ASM_RODATA] = ".section .rodata",
+    [ASM_BSS] = ".bss",
+  };
+  for (size_t i = 0; i < as->items.size; i++) {
+    const asm_item_t *item = &as->items.data[i];
+    const asm_symbol_t *symbol = &as->symbols.data[item->symbol];
+    switch (item->tag) {
+    case ASM_INSTR:
+      print_instr(file, as, &item->instr);
+      break;
+    case ASM_LABEL:
+      if (symbol->is_global) {
+        fprintf(file, "\t.globl %s\n", symbol->name);
+      }
+      if (symbol->type == ASM_FUNC || symbol->type == ASM_OBJECT) {
+        fprintf(file, "\t.type %s, @%s\n", symbol->name,
+                symbol->type == ASM_FUNC ? "function" : "object");
+      }
+      fprintf(file, "%s:\n", symbol->name);
+      break;
+    case ASM_END:
+      fprintf(file, "\t.size %s, .-%s\n", symbol->name, symbol->name);
+      break;
+    case ASM_SECTION:
+      fprintf(file, "\t%s\n", SECTIONS[item->section]);
+      break;
+    case ASM_ALIGN:
+      fprintf(file, "\t.balign %" PRIu64 "\n", item->size);
+      break;
+    case ASM_ZERO:
+      fprintf(file, "\t.zero %" PRIu64 "\n", item->size);
+      break;
+    case ASM_ADDRESS:
+      fprintf(file, "\t.quad %s%+" PRId64 "\n",
+              as->symbols.data[item->address.symbol].name, item->address.addend);
+      break;
+    case ASM_OFFSET:
+      fprintf(file, "\t.long %s%+" PRId64 "-.\n",
+              as->symbols.data[item->address.symbol].name, item->address.addend);
+      break;
+    case ASM_BYTES:
+      for (size_t j = 0; j < item->bytes.size; j++) {
+        if (j % 16) {
+          fprintf(file, ",%u", item->bytes.data[j]);
+        } else {
+          fprintf(file, "%s\t.byte %u", j ? "\n" : "", item->bytes.data[j]);
+        }
+      }
+      fputc('\n', file);
+      break;
+    }
+  }
+  // the stack need not be executable
+  fprintf(file, "\t.section .note.GNU-stack,\"\",@progbits\n");
+}
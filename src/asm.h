@@ -0,0 +1,258 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+  An x86-64 assembler stream. Code generation appends instructions, labels and
+  data to an asm_t as structured items rather than text, so the same stream can
+  be printed for the GNU assembler or encoded to machine code. Symbols, from
+  functions and objects down to the labels of blocks, live in one table and
+  are referred to by index.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "arena.h"
+#include "vec.h"
+
+typedef enum asm_reg {
+  ASM_RAX,
+  ASM_RCX,
+  ASM_RDX,
+  ASM_RBX,
+  ASM_RSP,
+  ASM_RBP,
+  ASM_RSI,
+  ASM_RDI,
+  ASM_R8,
+  ASM_R9,
+  ASM_R10,
+  ASM_R11,
+  ASM_R12,
+  ASM_R13,
+  ASM_R14,
+  ASM_R15,
+  ASM_XMM0,
+  ASM_XMM15 = ASM_XMM0 + 15,
+} asm_reg_t;
+
+// Condition codes, numbered as in the encodings of jcc and setcc
+typedef enum asm_cond {
+  ASM_CC_B = 2,
+  ASM_CC_AE = 3,
+  ASM_CC_E = 4,
+  ASM_CC_NE = 5,
+  ASM_CC_BE = 6,
+  ASM_CC_A = 7,
+  ASM_CC_S = 8,
+  ASM_CC_NS = 9,
+  ASM_CC_P = 10,
+  ASM_CC_NP = 11,
+  ASM_CC_L = 12,
+  ASM_CC_GE = 13,
+  ASM_CC_LE = 14,
+  ASM_CC_G = 15,
+} asm_cond_t;
+
+enum asm_op {
+  ASM_MOV,
+  ASM_MOVABS, // a 64-bit immediate to a register
+  ASM_MOVZB, // zero extend a byte to the instruction's size
+  ASM_MOVZW,
+  ASM_MOVSB, // sign extend
+  ASM_MOVSW,
+  ASM_MOVSL,
+  ASM_LEA,
+  ASM_ADD,
+  ASM_SUB,
+  ASM_IMUL,
+  ASM_AND,
+  ASM_OR,
+  ASM_XOR,
+  ASM_CMP,
+  ASM_TEST,
+  ASM_SHL, // by %cl or an immediate
+  ASM_SAR,
+  ASM_SHR,
+  ASM_NEG,
+  ASM_NOT,
+  ASM_IDIV,
+  ASM_DIV,
+  ASM_CQO, // sign extend into rdx:rax, or edx:eax at size 4
+  ASM_BTC,
+  ASM_SETCC,
+  ASM_JCC,
+  ASM_JMP,
+  ASM_CALL,
+  ASM_RET,
+  ASM_LEAVE,
+  ASM_PUSH,
+  ASM_POP,
+  ASM_REP_MOVSB,
+  ASM_REP_STOSB,
+  // SSE, where the size is that of the floating operands, or of the integer
+  // one for conversions and moves between register files
+  ASM_MOVSS,
+  ASM_MOVSD,
+  ASM_MOVQ, // between a general and an xmm register; size 4 is movd
+  ASM_ADDS,
+  ASM_SUBS,
+  ASM_MULS,
+  ASM_DIVS,
+  ASM_UCOMIS,
+  ASM_CVTSI2SS,
+  ASM_CVTSI2SD,
+  ASM_CVTTSS2SI,
+  ASM_CVTTSD2SI,
+  ASM_CVTSS2SD,
+  ASM_CVTSD2SS,
+  // packed SSE2 on 16-byte vectors, where the size is that of the lanes
+  ASM_MOVUPS,
+  ASM_PADD,
+  ASM_PSUB,
+  ASM_PMULLW,
+  ASM_PMULUDQ, // the even 32-bit lanes to 64-bit products
+  ASM_PAND,
+  ASM_POR,
+  ASM_PXOR,
+  ASM_PSLL, // by an immediate
+  ASM_PSRL,
+  ASM_PSRA,
+  ASM_ADDP,
+  ASM_SUBP,
+  ASM_MULP,
+  ASM_DIVP,
+  ASM_PUNPCKL, // interleave the lanes of the low halves
+  ASM_PSHUFD, // rearrange the 32-bit lanes of dst in place, as the immediate says
+};
+
+typedef struct {
+  enum asm_operand_tag {
+    ASM_NONE,
+    ASM_REG,
+    ASM_IMM,
+    ASM_MEM, // value(reg)
+    ASM_RIP, // symbol + value relative to the instruction pointer
+    ASM_TARGET, // a symbol to jump or call to
+  } tag;
+  uint8_t reg;
+  uint8_t size; // of a register
+  enum asm_reloc {
+    ASM_DIRECT,
+    ASM_GOT, // the symbol's entry in the global offset table
+    ASM_PLT, // the symbol's procedure linkage table entry
+  } reloc;
+  uint32_t symbol;
+  int64_t value;
+} asm_operand_t;
+
+typedef struct {
+  uint8_t op; // enum asm_op
+  uint8_t size; // 1, 2, 4 or 8
+  uint8_t cond; // of ASM_JCC and ASM_SETCC
+  asm_operand_t src, dst; // in AT&T order; a lone operand is dst
+} asm_instr_t;
+
+typedef enum asm_section {
+  ASM_TEXT,
+  ASM_DATA,
+  ASM_RODATA,
+  ASM_BSS,
+
+  ASM_SECTION_COUNT,
+} asm_section_t;
+
+typedef struct {
+  enum asm_item_tag {
+    ASM_INSTR,
+    ASM_LABEL,
+    ASM_SECTION,
+    ASM_ALIGN,
+    ASM_BYTES,
+    ASM_ZERO,
+    ASM_ADDRESS, // the 8-byte absolute address of symbol + addend
+    ASM_OFFSET, // the 4-byte offset of symbol + addend from the item itself
+    ASM_END, // of the function or object a symbol labels
+  } tag;
+  union {
+    asm_instr_t instr;
+    uint32_t symbol; // ASM_LABEL and ASM_END
+    asm_section_t section;
+    uint64_t size; // ASM_ALIGN and ASM_ZERO
+    struct {
+      const uint8_t *data;
+      size_t size;
+    } bytes;
+    struct {
+      uint32_t symbol;
+      int64_t addend;
+    } address; // ASM_ADDRESS and ASM_OFFSET
+  };
+} asm_item_t;
+DECLARE_VEC(asm_item_t, asm_item_vec);
+
+typedef struct {
+  char *name;
+  enum asm_symbol_type {
+    ASM_TEMP, // a local label, left out of object files
+    ASM_FUNC,
+    ASM_OBJECT,
+    ASM_NOTYPE,
+  } type;
+  bool is_global;
+} asm_symbol_t;
+DECLARE_VEC(asm_symbol_t, asm_symbol_vec);
+
+typedef struct {
+  asm_item_vec_t items;
+  asm_symbol_vec_t symbols;
+  arena_t arena; // the contents of ASM_BYTES
+  uint32_t temps;
+} asm_t;
+
+asm_t* dcc_asm_new();
+void dcc_asm_free(asm_t *as);
+
+uint32_t dcc_asm_symbol(asm_t *as, const char *name, enum asm_symbol_type type,
+                        bool is_global);
+// A fresh local label
+uint32_t dcc_asm_temp(asm_t *as);
+
+void dcc_asm_section(asm_t *as, asm_section_t section);
+void dcc_asm_label(asm_t *as, uint32_t symbol);
+void dcc_asm_end(asm_t *as, uint32_t symbol);
+void dcc_asm_align(asm_t *as, uint64_t align);
+// Copies `data`
+void dcc_asm_bytes(asm_t *as, const void *data, size_t size);
+void dcc_asm_zero(asm_t *as, uint64_t size);
+void dcc_asm_address(asm_t *as, uint32_t symbol, int64_t addend);
+void dcc_asm_offset(asm_t *as, uint32_t symbol, int64_t addend);
+void dcc_asm_instr(asm_t *as, enum asm_op op, uint8_t size, asm_operand_t src,
+                   asm_operand_t dst);
+void dcc_asm_cond(asm_t *as, enum asm_op op, asm_cond_t cond, asm_operand_t dst);
+
+asm_operand_t dcc_asm_reg(asm_reg_t reg, uint8_t size);
+asm_operand_t dcc_asm_imm(int64_t value);
+asm_operand_t dcc_asm_mem(asm_reg_t base, int64_t disp);
+asm_operand_t dcc_asm_rip(uint32_t symbol, int64_t addend, enum asm_reloc reloc);
+asm_operand_t dcc_asm_target(uint32_t symbol, enum asm_reloc reloc);
+extern const asm_operand_t ASM_NO_OPERAND;
+
+// Print the stream for the GNU assembler
+void dcc_asm_print(FILE *file, const asm_t *as);
@@ -0,0 +1,408 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdarg.h>
+#include <stdint.h>
+
+#include "consteval.h"
+#include "dcc.h"
+#include "ptrmap.h"
+#include "sema.h"
+
+typedef struct {
+  intval_t value;
+  bool ok;
+} result_t;
+DECLARE_VEC(result_t, result_vec);
+DEFINE_VEC2(result_t, result_vec);
+
+struct consteval {
+  diag_vec_t *diags;
+  ptrmap_t memo; // exp_t -> index + 1 into results
+  result_vec_t results;
+  int unevaluated; // inside the skipped operand of &&, || or ?:
+};
+
+consteval_t* dcc_consteval_new(diag_vec_t *diags) {
+  consteval_t *eval = dcc_malloc(sizeof *eval);
+  eval->diags = diags;
+  eval->memo = dcc_ptrmap_new();
+  eval->results = result_vec_new();
+  eval->unevaluated = 0;
+  return eval;
+}
+
+void dcc_consteval_free(consteval_t *eval) {
+  dcc_ptrmap_free(&eval->memo);
+  result_vec_free(&eval->results);
+  free(eval);
+}
+
+static bool error(consteval_t *eval, exp_t *exp, const char *format, ...) {
+  va_list vlist;
+  va_start(vlist, format);
+  dcc_vdiag(eval->diags, DIAG_ERROR, exp->loc, 1, format, vlist);
+  va_end(vlist);
+  return false;
+}
+
+static bool not_constant(consteval_t *eval, exp_t *exp) {
+  return error(eval, exp, "expression is not an integer constant expression");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Arithmetic
+////////////////////////////////////////////////////////////////////////////////
+
+static int width(const type_t *type) {
+  return dcc_type_size(type) * 8;
+}
+
+// Wrap `bits` to the width of the integer type `type`
+static intval_t make(const type_t *type, uint64_t bits) {
+  type = type->unqual;
+  int n = width(type);
+  if (type->tag == TYPE_BOOL) {
+    bits = bits != 0;
+  } else if (n < 64) {
+    bits &= (UINT64_C(1) << n) - 1;
+    if (dcc_type_is_signed(type) && bits >> (n - 1)) {
+      bits |= ~UINT64_C(0) << n;
+    }
+  }
+  intval_t value = { type, bits };
+  return value;
+}
+
+static intval_t convert(intval_t value, const type_t *type) {
+  // conversion to _Bool compares the whole value with zero
+  return make(type, value.bits);
+}
+
+// Whether `type` can represent the nonnegative `bits`
+static bool fits(const type_t *type, uint64_t bits) {
+  int n = width(type) - dcc_type_is_signed(type);
+  return n >= 64 || bits >> n == 0;
+}
+
+const type_t* dcc_constant_type(const constant_t *constant) {
+  if (constant->tag == CONSTANT_FLOAT) {
+    return dcc_type_basic(TYPE_DOUBLE);
+  } else if (constant->tag == CONSTANT_CHAR && constant->prefix == LITERAL_UTF16) {
+    return dcc_type_basic(TYPE_USHORT); // char16_t
+  } else if (constant->tag == CONSTANT_CHAR && constant->prefix == LITERAL_UTF32) {
+    return dcc_type_basic(TYPE_UINT); // char32_t
+  } else if (constant->tag != CONSTANT_INTEGER) {
+    return dcc_type_basic(TYPE_INT); // also wchar_t
+  }
+
+  // stdspec.6.4.4.1: the first type that can represent the value, where only
+  // octal and hexadecimal constants without a `u` may become unsigned
+  static const enum type_tag CANDIDATES[] = {
+    TYPE_INT, TYPE_UINT, TYPE_LONG, TYPE_ULONG, TYPE_LLONG, TYPE_ULLONG,
+  };
+  for (int i = constant->longs * 2; i < 6; i++) {
+    const type_t *type = dcc_type_basic(CANDIDATES[i]);
+    bool is_signed = dcc_type_is_signed(type);
+    if ((is_signed && constant->is_unsigned)
+        || (!is_signed && constant->is_decimal && !constant->is_unsigned)) {
+      continue;
+    }
+    if (fits(type, constant->integer)) {
+      return type;
+    }
+  }
+  return dcc_type_basic(TYPE_ULLONG); // too large for any type, as GCC has it
+}
+
+// Whether `op` on signed operands of `type` leaves its range
+static bool overflows(enum exp_tag op, const type_t *type, int64_t x, int64_t y) {
+  if (width(type) < 64) {
+    // the operands are no wider than 32 bits, so the exact result fits
+    int64_t result = op == EXP_ADD ? x + y : op == EXP_SUBTRACT ? x - y : x * y;
+    return make(type, result).bits != (uint64_t)result;
+  }
+  switch (op) {
+  case EXP_ADD:
+    return (y > 0 && x > INT64_MAX - y) || (y < 0 && x < INT64_MIN - y);
+  case EXP_SUBTRACT:
+    return (y < 0 && x > INT64_MAX + y) || (y > 0 && x < INT64_MIN + y);
+  default:
+    if (x == 0 || y == 0) {
+      return false;
+    } else if (x == -1 || y == -1) {
+      return x == INT64_MIN || y == INT64_MIN;
+    }
+    return (int64_t)((uint64_t)x * (uint64_t)y) / y != x;
+  }
+}
+
+intval_t dcc_intval_convert(intval_t value, const type_t *type) {
+  return convert(value, type);
+}
+
+intval_status_t dcc_intval_binary(enum exp_tag op, intval_t a, intval_t b, intval_t *value) {
+  const type_t *type = op == EXP_SHIFTLEFT || op == EXP_SHIFTRIGHT
+    ? dcc_type_promote(a.type) : dcc_type_common(a.type, b.type);
+  bool is_signed = dcc_type_is_signed(type);
+  a = convert(a, type);
+  if (op != EXP_SHIFTLEFT && op != EXP_SHIFTRIGHT) {
+    b = convert(b, type);
+  }
+  int64_t x = a.bits, y = b.bits;
+
+  switch (op) {
+  case EXP_ADD:
+  case EXP_SUBTRACT:
+  case EXP_MULTIPLY:
+    *value = make(type, op == EXP_ADD ? a.bits + b.bits
+                  : op == EXP_SUBTRACT ? a.bits - b.bits : a.bits * b.bits);
+    return is_signed && overflows(op, type, x, y) ? INTVAL_OVERFLOW : INTVAL_OK;
+  case EXP_DIVIDE:
+  case EXP_MODULO:
+    if (b.bits == 0) {
+      *value = make(type, 0);
+      return INTVAL_DIVIDE_BY_ZERO;
+    } else if (!is_signed) {
+      *value = make(type, op == EXP_DIVIDE ? a.bits / b.bits : a.bits % b.bits);
+    } else if (y == -1) {
+      // INT64_MIN / -1 would trap
+      *value = make(type, op == EXP_DIVIDE ? -a.bits : 0);
+      return op == EXP_DIVIDE && make(type, -a.bits).bits == a.bits && x != 0
+        ? INTVAL_OVERFLOW : INTVAL_OK;
+    } else {
+      *value = make(type, op == EXP_DIVIDE ? x / y : x % y);
+    }
+    return INTVAL_OK;
+  case EXP_SHIFTLEFT:
+  case EXP_SHIFTRIGHT:
+    *value = make(type, 0);
+    if (dcc_type_is_signed(b.type) && y < 0) {
+      return INTVAL_NEGATIVE_SHIFT;
+    } else if (b.bits >= (uint64_t)width(type)) {
+      return INTVAL_WIDE_SHIFT;
+    }
+    *value = make(type, op == EXP_SHIFTLEFT ? a.bits << b.bits
+                  : is_signed ? (uint64_t)(x >> b.bits) : a.bits >> b.bits);
+    return INTVAL_OK;
+  case EXP_BITAND:
+    *value = make(type, a.bits & b.bits);
+    return INTVAL_OK;
+  case EXP_BITXOR:
+    *value = make(type, a.bits ^ b.bits);
+    return INTVAL_OK;
+  case EXP_BITOR:
+    *value = make(type, a.bits | b.bits);
+    return INTVAL_OK;
+  default:
+    break;
+  }
+
+  bool result = false;
+  switch (op) {
+  case EXP_LESS: result = is_signed ? x < y : a.bits < b.bits; break;
+  case EXP_MORE: result = is_signed ? x > y : a.bits > b.bits; break;
+  case EXP_LESSEQ: result = is_signed ? x <= y : a.bits <= b.bits; break;
+  case EXP_MOREEQ: result = is_signed ? x >= y : a.bits >= b.bits; break;
+  case EXP_EQUAL: result = a.bits == b.bits; break;
+  case EXP_NOTEQUAL: result = a.bits != b.bits; break;
+  default:
+    dcc_ice("not an integer operator: %d", op);
+  }
+  *value = make(dcc_type_basic(TYPE_INT), result);
+  return INTVAL_OK;
+}
+
+intval_status_t dcc_intval_unary(enum exp_tag op, intval_t a, intval_t *value) {
+  if (op == EXP_LOGICNOT) {
+    *value = make(dcc_type_basic(TYPE_INT), !a.bits);
+    return INTVAL_OK;
+  }
+  const type_t *type = dcc_type_promote(a.type);
+  a = convert(a, type);
+  *value = make(type, op == EXP_NEGATE ? -a.bits : ~a.bits);
+  return op == EXP_NEGATE && dcc_type_is_signed(type) && a.bits != 0 && value->bits == a.bits
+    ? INTVAL_OVERFLOW : INTVAL_OK;
+}
+
+static bool eval_exp(consteval_t *eval, exp_t *exp, intval_t *value);
+
+// Diagnose an undefined result, which is only an error where it is evaluated
+static bool check_status(consteval_t *eval, exp_t *exp, intval_status_t status) {
+  if (eval->unevaluated) {
+    return true;
+  }
+  switch (status) {
+  case INTVAL_OK:
+    return true;
+  case INTVAL_OVERFLOW:
+    dcc_diag(eval->diags, DIAG_WARNING, exp->loc, 1, "overflow in constant expression");
+    return true;
+  case INTVAL_DIVIDE_BY_ZERO:
+    return error(eval, exp, "division by zero in constant expression");
+  case INTVAL_NEGATIVE_SHIFT:
+    return error(eval, exp, "shift count is negative");
+  case INTVAL_WIDE_SHIFT:
+    return error(eval, exp, "shift count >= width of type");
+  }
+  return true;
+}
+
+static bool eval_sizeof(const type_t *type, intval_t *value) {
+  // an invalid operand has already been reported by dcc_sema()
+  *value = make(dcc_type_basic(TYPE_ULONG), 0);
+  if (type->tag == TYPE_FUNCTION || !dcc_type_is_complete(type)) {
+    return false;
+  }
+  value->bits = dcc_type_size(type);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Expressions
+////////////////////////////////////////////////////////////////////////////////
+
+static bool eval_node(consteval_t *eval, exp_t *exp, intval_t *value) {
+  *value = make(dcc_type_basic(TYPE_INT), 0);
+  switch (exp->tag) {
+  case EXP_CONSTANT:
+    if (exp->constant->tag == CONSTANT_FLOAT) {
+      return error(eval, exp, "floating constant is only allowed as the operand of a cast");
+    }
+    *value = make(dcc_constant_type(exp->constant), exp->constant->integer);
+    return true;
+  case EXP_IDENT: {
+    symbol_t *symbol = exp->ident.symbol;
+    if (!symbol) {
+      return false; // already reported as undeclared
+    } else if (symbol->tag != SYM_ENUM_CONST) {
+      return not_constant(eval, exp);
+    }
+    *value = make(dcc_type_basic(TYPE_INT), symbol->enumtor->value);
+    return true;
+  }
+  case EXP_SIZEOFTYPE:
+    return eval_sizeof(exp->cast.type->type, value);
+  case EXP_SIZEOFEXP:
+    return eval_sizeof(exp->unary->type, value);
+  case EXP_CAST: {
+    const type_t *type = exp->cast.type->type;
+    exp_t *operand = exp->cast.value;
+    if (!dcc_type_is_integer(type)) {
+      return error(eval, exp, "cast to a non-integer type in an integer constant expression");
+    } else if (operand->tag == EXP_CONSTANT && operand->constant->tag == CONSTANT_FLOAT) {
+      double floating = operand->constant->floating;
+      *value = type->unqual->tag == TYPE_BOOL ? make(type, floating != 0)
+        : make(type, dcc_type_is_signed(type) || floating < 0
+               ? (uint64_t)(int64_t)floating : (uint64_t)floating);
+      return true;
+    }
+    intval_t operand_value;
+    if (!eval_exp(eval, operand, &operand_value)) {
+      return false;
+    }
+    *value = convert(operand_value, type);
+    return true;
+  }
+  case EXP_NEGATE:
+  case EXP_BITNOT:
+  case EXP_LOGICNOT: {
+    intval_t operand;
+    if (!eval_exp(eval, exp->unary, &operand)) {
+      return false;
+    }
+    return check_status(eval, exp, dcc_intval_unary(exp->tag, operand, value));
+  }
+  case EXP_LOGICAND:
+  case EXP_LOGICOR: {
+    intval_t lhs, rhs;
+    if (!eval_exp(eval, exp->binary.lhs, &lhs)) {
+      return false;
+    }
+    // the right operand may not be evaluated, and then it may divide by zero
+    bool skip = exp->tag == EXP_LOGICAND ? !lhs.bits : lhs.bits;
+    eval->unevaluated += skip;
+    bool ok = eval_exp(eval, exp->binary.rhs, &rhs);
+    eval->unevaluated -= skip;
+    *value = make(dcc_type_basic(TYPE_INT), skip ? !!lhs.bits : !!rhs.bits);
+    return ok;
+  }
+  case EXP_TERNARY: {
+    intval_t cond, then, otherwise;
+    if (!eval_exp(eval, exp->ternary.cond, &cond)) {
+      return false;
+    }
+    // only the chosen operand is evaluated
+    bool chosen = cond.bits != 0;
+    eval->unevaluated += !chosen;
+    bool ok = eval_exp(eval, exp->ternary.true_exp, &then);
+    eval->unevaluated -= !chosen;
+    eval->unevaluated += chosen;
+    ok = eval_exp(eval, exp->ternary.false_exp, &otherwise) && ok;
+    eval->unevaluated -= chosen;
+    if (!ok) {
+      return false;
+    }
+    *value = convert(chosen ? then : otherwise, dcc_type_common(then.type, otherwise.type));
+    return true;
+  }
+  case EXP_ADD:
+  case EXP_SUBTRACT:
+  case EXP_MULTIPLY:
+  case EXP_DIVIDE:
+  case EXP_MODULO:
+  case EXP_SHIFTLEFT:
+  case EXP_SHIFTRIGHT:
+  case EXP_BITAND:
+  case EXP_BITXOR:
+  case EXP_BITOR:
+  case EXP_LESS:
+  case EXP_MORE:
+  case EXP_LESSEQ:
+  case EXP_MOREEQ:
+  case EXP_EQUAL:
+  case EXP_NOTEQUAL: {
+    intval_t lhs, rhs;
+    if (!eval_exp(eval, exp->binary.lhs, &lhs) | !eval_exp(eval, exp->binary.rhs, &rhs)) {
+      return false;
+    }
+    return check_status(eval, exp, dcc_intval_binary(exp->tag, lhs, rhs, value));
+  }
+  default:
+    return not_constant(eval, exp);
+  }
+}
+
+static bool eval_exp(consteval_t *eval, exp_t *exp, intval_t *value) {
+  uintptr_t index = (uintptr_t)dcc_ptrmap_get(&eval->memo, exp);
+  if (index) {
+    result_t *result = &eval->results.data[index - 1];
+    *value = result->value;
+    return result->ok;
+  }
+
+  result_t result;
+  result.ok = eval_node(eval, exp, &result.value);
+  result_vec_push(&eval->results, result);
+  dcc_ptrmap_put(&eval->memo, exp, (void*)(uintptr_t)eval->results.size);
+  *value = result.value;
+  return result.ok;
+}
+
+bool dcc_consteval(consteval_t *eval, exp_t *exp, intval_t *value) {
+  return eval_exp(eval, exp, value);
+}
@@ -0,0 +1,64 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+  Integer constant expressions (stdspec.6.6). Case labels, enumerator values,
+  bit-field widths and array sizes are evaluated here with C's arithmetic: the
+  integer promotions and usual arithmetic conversions apply, and every result
+  wraps to the width of its type. Results are memoized per node, so each
+  constant is folded once however often it is asked for.
+*/
+
+#pragma once
+
+#include "diag.h"
+#include "parse.h"
+#include "type.h"
+
+typedef struct {
+  const type_t *type; // an unqualified integer type
+  uint64_t bits; // sign or zero extended from the width of `type`
+} intval_t;
+
+typedef enum {
+  INTVAL_OK,
+  INTVAL_OVERFLOW, // of a signed result, which wraps
+  INTVAL_DIVIDE_BY_ZERO,
+  INTVAL_NEGATIVE_SHIFT,
+  INTVAL_WIDE_SHIFT, // by at least the width of the promoted operand
+} intval_status_t;
+
+// Convert `value` to the integer type `type`, as a cast does
+intval_t dcc_intval_convert(intval_t value, const type_t *type);
+// Apply an arithmetic, bitwise, shift or comparison operator to `a` and `b`,
+// converting them as C does. An undefined result is still set, wrapped or
+// zero, but flagged by the status.
+intval_status_t dcc_intval_binary(enum exp_tag op, intval_t a, intval_t b, intval_t *value);
+// Likewise for EXP_NEGATE, EXP_BITNOT and EXP_LOGICNOT
+intval_status_t dcc_intval_unary(enum exp_tag op, intval_t a, intval_t *value);
+
+typedef struct consteval consteval_t;
+
+consteval_t* dcc_consteval_new(diag_vec_t *diags);
+void dcc_consteval_free(consteval_t *eval);
+
+// Evaluate `exp`, which must already be resolved and typed. Reports an error and
+// returns false if it is not an integer constant expression.
+bool dcc_consteval(consteval_t *eval, exp_t *exp, intval_t *value);
+
+// The type of an integer or floating constant, which depends on its spelling
+const type_t* dcc_constant_type(const constant_t *constant);
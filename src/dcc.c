@@ -62,8 +62,6 @@ void dcc_nyi(const char* feature) {
   }
 }
 
-extern log_level active_log_level;
-
 void dcc_log(log_level level, const char* format, ...) {
   if (level >= LOG_COUNT) {
     dcc_ice("invalid log level: %d\n", level);
@@ -36,6 +36,8 @@ typedef enum  {
 
   LOG_COUNT,
 } log_level;
+// Messages below this level are not logged
+extern log_level active_log_level;
 void dcc_log(log_level level, const char* format, ...);
 
 #define TRACE(...) dcc_log(LOG_TRACE, __VA_ARGS__)
@@ -0,0 +1,85 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "dcc.h"
+#include "diag.h"
+
+static void free_diag(diag_t *diag) {
+  free(diag->message);
+}
+DEFINE_VEC3(diag_t, diag_vec, free_diag);
+
+void dcc_vdiag(diag_vec_t *diags, diag_level_t level, srcloc_t loc, uint32_t len,
+               const char *format, va_list vlist) {
+  va_list copy;
+  va_copy(copy, vlist);
+  int size = vsnprintf(0, 0, format, copy);
+  va_end(copy);
+  dcc_assert(size >= 0);
+
+  diag_t diag = { level, loc, len, dcc_malloc(size + 1) };
+  vsnprintf(diag.message, size + 1, format, vlist);
+  diag_vec_push(diags, diag);
+}
+
+void dcc_diag(diag_vec_t *diags, diag_level_t level, srcloc_t loc, uint32_t len,
+              const char *format, ...) {
+  va_list vlist;
+  va_start(vlist, format);
+  dcc_vdiag(diags, level, loc, len, format, vlist);
+  va_end(vlist);
+}
+
+size_t dcc_diag_error_count(const diag_vec_t *diags) {
+  size_t count = 0;
+  for (size_t i = 0; i < diags->size; i++) {
+    count += diags->data[i].level == DIAG_ERROR;
+  }
+  return count;
+}
+
+void dcc_log_diags(const diag_vec_t *diags) {
+  static const char *LEVEL_STRINGS[] = {
+    "warning",
+    "error",
+  };
+
+  for (size_t i = 0; i < diags->size; i++) {
+    diag_t *diag = &diags->data[i];
+    srcpos_t pos = dcc_source_pos(diag->loc);
+    fprintf(stderr, "%s:%u:%u: %s: %s\n",
+            pos.file->path, pos.line, pos.column,
+            LEVEL_STRINGS[diag->level],
+            diag->message);
+
+    // quote the line and underline the offending token
+    size_t len;
+    const char *line = dcc_source_line(diag->loc, &len);
+    fprintf(stderr, "  %.*s\n  ", (int)len, line);
+    for (uint32_t col = 1; col < pos.column; col++) {
+      fputc(line[col - 1] == '\t' ? '\t' : ' ', stderr);
+    }
+    fputc('^', stderr);
+    for (uint32_t n = 1; n < diag->len && pos.column + n <= len; n++) {
+      fputc('~', stderr);
+    }
+    fputc('\n', stderr);
+  }
+}
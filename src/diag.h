@@ -0,0 +1,48 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+  Diagnostics. User-facing errors are recorded here instead of aborting via
+  dcc_ice(), which remains reserved for internal compiler errors.
+*/
+
+#pragma once
+
+#include <stdarg.h>
+
+#include "source_map.h"
+#include "vec.h"
+
+typedef enum diag_level {
+  DIAG_WARNING,
+  DIAG_ERROR,
+} diag_level_t;
+
+typedef struct {
+  diag_level_t level;
+  srcloc_t loc;
+  uint32_t len;
+  char *message;
+} diag_t;
+DECLARE_VEC(diag_t, diag_vec);
+
+void dcc_diag(diag_vec_t *diags, diag_level_t level, srcloc_t loc, uint32_t len,
+              const char *format, ...);
+void dcc_vdiag(diag_vec_t *diags, diag_level_t level, srcloc_t loc, uint32_t len,
+               const char *format, va_list vlist);
+size_t dcc_diag_error_count(const diag_vec_t *diags);
+void dcc_log_diags(const diag_vec_t *diags);
@@ -0,0 +1,280 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "elf.h"
+
+// Section header indices: the null section, the sections of an asm_t, their
+// relocations, and the tables
+enum {
+  SEC_NULL,
+  SEC_TEXT,
+  SEC_DATA,
+  SEC_RODATA,
+  SEC_BSS,
+  SEC_RELA_TEXT,
+  SEC_RELA_DATA,
+  SEC_RELA_RODATA,
+  SEC_SYMTAB,
+  SEC_STRTAB,
+  SEC_SHSTRTAB,
+  SEC_NOTE_STACK,
+  SEC_COUNT,
+};
+
+#define SHT_PROGBITS 1
+#define SHT_SYMTAB 2
+#define SHT_STRTAB 3
+#define SHT_RELA 4
+#define SHT_NOBITS 8
+
+#define SHF_WRITE 1
+#define SHF_ALLOC 2
+#define SHF_EXECINSTR 4
+#define SHF_INFO_LINK 0x40
+
+#define STB_LOCAL 0
+#define STB_GLOBAL 1
+#define STT_NOTYPE 0
+#define STT_OBJECT 1
+#define STT_FUNC 2
+#define STT_SECTION 3
+
+typedef struct {
+  uint32_t name;
+  uint32_t type;
+  uint64_t flags;
+  uint64_t offset;
+  uint64_t size;
+  uint32_t link;
+  uint32_t info;
+  uint64_t align;
+  uint64_t entsize;
+} section_header_t;
+
+static void put(uint8_vec_t *out, uint64_t value, int size) {
+  for (int i = 0; i < size; i++) {
+    uint8_vec_push(out, value >> (8 * i));
+  }
+}
+
+static void put_bytes(uint8_vec_t *out, const void *data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    uint8_vec_push(out, ((const uint8_t*)data)[i]);
+  }
+}
+
+static void align_to(uint8_vec_t *out, uint64_t align) {
+  while (out->size % align) {
+    uint8_vec_push(out, 0);
+  }
+}
+
+// Append a null terminated string to a string table, returning its offset
+static uint32_t add_string(uint8_vec_t *table, const char *str) {
+  uint32_t offset = table->size;
+  put_bytes(table, str, strlen(str) + 1);
+  return offset;
+}
+
+static void put_symbol(uint8_vec_t *symtab, uint32_t name, int bind, int type,
+                       uint16_t shndx, uint64_t value, uint64_t size) {
+  put(symtab, name, 4);
+  put(symtab, bind << 4 | type, 1);
+  put(symtab, 0, 1);
+  put(symtab, shndx, 2);
+  put(symtab, value, 8);
+  put(symtab, size, 8);
+}
+
+bool dcc_elf_write(FILE *file, const obj_t *obj) {
+  static const int SECTIONS[] = {
+    [ASM_TEXT] = SEC_TEXT,
+    [ASM_DATA] = SEC_DATA,
+    [ASM_RODATA] = SEC_RODATA,
+    [ASM_BSS] = SEC_BSS,
+  };
+  const asm_symbol_vec_t *symbols = &obj->as->symbols;
+  section_header_t headers[SEC_COUNT];
+  memset(headers, 0, sizeof headers);
+
+  // the symbol table lists locals before globals; labels are left out, and
+  // relocations against them use their section's symbol instead
+  uint8_vec_t strtab = uint8_vec_new(), symtab = uint8_vec_new();
+  uint32_t *indices = dcc_malloc((symbols->size + 1) * sizeof(uint32_t));
+  uint32_t count = 0;
+  put_symbol(&symtab, 0, STB_LOCAL, STT_NOTYPE, 0, 0, 0);
+  uint8_vec_push(&strtab, 0);
+  count++;
+  uint32_t section_symbols[ASM_SECTION_COUNT];
+  for (int i = 0; i < ASM_SECTION_COUNT; i++) {
+    section_symbols[i] = count++;
+    put_symbol(&symtab, 0, STB_LOCAL, STT_SECTION, SECTIONS[i], 0, 0);
+  }
+  uint32_t first_global = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    if (pass) {
+      first_global = count;
+    }
+    for (size_t i = 0; i < symbols->size; i++) {
+      const asm_symbol_t *symbol = &symbols->data[i];
+      const obj_symbol_t *value = &obj->symbols[i];
+      if (symbol->type == ASM_TEMP || symbol->is_global != pass) {
+        continue;
+      }
+      int type = symbol->type == ASM_FUNC ? STT_FUNC
+        : symbol->type == ASM_OBJECT ? STT_OBJECT : STT_NOTYPE;
+      indices[i] = count++;
+      put_symbol(&symtab, add_string(&strtab, symbol->name), pass ? STB_GLOBAL : STB_LOCAL,
+                 type, value->section < 0 ? 0 : SECTIONS[value->section], value->value,
+                 value->size);
+    }
+  }
+
+  uint8_vec_t out = uint8_vec_new();
+  put_bytes(&out, "\x7f" "ELF", 4);
+  // 64-bit, little endian, version 1, System V, relocatable, x86-64
+  put(&out, 2, 1);
+  put(&out, 1, 1);
+  put(&out, 1, 1);
+  put(&out, 0, 1);
+  put(&out, 0, 8); // ABI version and padding
+  put(&out, 1, 2);
+  put(&out, 62, 2);
+  put(&out, 1, 4);
+  put(&out, 0, 8); // entry
+  put(&out, 0, 8); // program headers
+  size_t shoff_at = out.size;
+  put(&out, 0, 8);
+  put(&out, 0, 4); // flags
+  put(&out, 64, 2); // header size
+  put(&out, 0, 2);
+  put(&out, 0, 2);
+  put(&out, 64, 2); // section header size
+  put(&out, SEC_COUNT, 2);
+  put(&out, SEC_SHSTRTAB, 2);
+
+  uint8_vec_t shstrtab = uint8_vec_new();
+  uint8_vec_push(&shstrtab, 0);
+  static const char *const NAMES[] = {
+    [SEC_TEXT] = ".text",
+    [SEC_DATA] = ".data",
+    [SEC_RODATA] = ".rodata",
+    [SEC_BSS] = ".bss",
+    [SEC_RELA_TEXT] = ".rela.text",
+    [SEC_RELA_DATA] = ".rela.data",
+    [SEC_RELA_RODATA] = ".rela.rodata",
+    [SEC_SYMTAB] = ".symtab",
+    [SEC_STRTAB] = ".strtab",
+    [SEC_SHSTRTAB] = ".shstrtab",
+    [SEC_NOTE_STACK] = ".note.GNU-stack",
+  };
+  for (int i = 1; i < SEC_COUNT; i++) {
+    headers[i].name = add_string(&shstrtab, NAMES[i]);
+    headers[i].align = 1;
+  }
+
+  for (int i = 0; i < ASM_SECTION_COUNT; i++) {
+    const obj_section_t *section = &obj->sections[i];
+    section_header_t *header = &headers[SECTIONS[i]];
+    header->type = i == ASM_BSS ? SHT_NOBITS : SHT_PROGBITS;
+    header->flags = SHF_ALLOC | (i == ASM_TEXT ? SHF_EXECINSTR : 0)
+      | (i == ASM_DATA || i == ASM_BSS ? SHF_WRITE : 0);
+    header->align = section->align;
+    header->size = section->size;
+    align_to(&out, section->align);
+    header->offset = out.size;
+    put_bytes(&out, section->bytes.data, section->bytes.size);
+    if (i == ASM_BSS) {
+      continue;
+    }
+
+    // the relocation section follows its own in the header table
+    section_header_t *rela = &headers[SECTIONS[i] + SEC_RELA_TEXT - SEC_TEXT];
+    align_to(&out, 8);
+    rela->type = SHT_RELA;
+    rela->flags = SHF_INFO_LINK;
+    rela->offset = out.size;
+    rela->link = SEC_SYMTAB;
+    rela->info = SECTIONS[i];
+    rela->align = 8;
+    rela->entsize = 24;
+    for (size_t j = 0; j < section->relocs.size; j++) {
+      const obj_reloc_t *reloc = &section->relocs.data[j];
+      const obj_symbol_t *target = &obj->symbols[reloc->symbol];
+      uint64_t symbol = indices[reloc->symbol];
+      int64_t addend = reloc->addend;
+      if (symbols->data[reloc->symbol].type == ASM_TEMP) {
+        symbol = section_symbols[target->section];
+        addend += target->value;
+      }
+      put(&out, reloc->offset, 8);
+      put(&out, symbol << 32 | reloc->type, 8);
+      put(&out, addend, 8);
+    }
+    rela->size = out.size - rela->offset;
+  }
+  free(indices);
+
+  section_header_t *header = &headers[SEC_SYMTAB];
+  align_to(&out, 8);
+  header->type = SHT_SYMTAB;
+  header->offset = out.size;
+  header->size = symtab.size;
+  header->link = SEC_STRTAB;
+  header->info = first_global;
+  header->align = 8;
+  header->entsize = 24;
+  put_bytes(&out, symtab.data, symtab.size);
+
+  const uint8_vec_t *tables[] = { &strtab, &shstrtab };
+  for (int i = 0; i < 2; i++) {
+    header = &headers[SEC_STRTAB + i];
+    header->type = SHT_STRTAB;
+    header->offset = out.size;
+    header->size = tables[i]->size;
+    put_bytes(&out, tables[i]->data, tables[i]->size);
+  }
+  headers[SEC_NOTE_STACK].type = SHT_PROGBITS;
+  headers[SEC_NOTE_STACK].offset = out.size;
+
+  align_to(&out, 8);
+  for (int i = 0; i < 8; i++) {
+    out.data[shoff_at + i] = (uint64_t)out.size >> (8 * i);
+  }
+  for (int i = 0; i < SEC_COUNT; i++) {
+    header = &headers[i];
+    put(&out, header->name, 4);
+    put(&out, header->type, 4);
+    put(&out, header->flags, 8);
+    put(&out, 0, 8); // address
+    put(&out, header->offset, 8);
+    put(&out, header->size, 8);
+    put(&out, header->link, 4);
+    put(&out, header->info, 4);
+    put(&out, header->align, 8);
+    put(&out, header->entsize, 8);
+  }
+
+  bool ok = fwrite(out.data, 1, out.size, file) == out.size;
+  uint8_vec_free(&out);
+  uint8_vec_free(&symtab);
+  uint8_vec_free(&strtab);
+  uint8_vec_free(&shstrtab);
+  return ok;
+}
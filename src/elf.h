@@ -0,0 +1,29 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+  ELF64 relocatable object files for x86-64, as the system linker reads them.
+*/
+
+#pragma once
+
+#include <stdio.h>
+
+#include "encode.h"
+
+// Write `obj` as an ELF object file, returning false if writing fails
+bool dcc_elf_write(FILE *file, const obj_t *obj);
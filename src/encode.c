@@ -0,0 +1,474 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "encode.h"
+
+DEFINE_VEC2(obj_reloc_t, obj_reloc_vec);
+
+// A reference to a symbol, resolved once every label has a value
+typedef struct {
+  asm_section_t section;
+  obj_reloc_t reloc;
+} fixup_t;
+DECLARE_VEC(fixup_t, fixup_vec);
+DEFINE_VEC2(fixup_t, fixup_vec);
+
+typedef struct {
+  obj_t *obj;
+  asm_section_t index;
+  obj_section_t *section;
+  fixup_vec_t fixups;
+} encoder_t;
+
+// Which registers of an instruction are byte registers, which need a REX
+// prefix to reach spl, bpl, sil and dil
+#define REG_BYTE 1
+#define RM_BYTE 2
+
+static void byte(encoder_t *e, uint8_t b) {
+  uint8_vec_push(&e->section->bytes, b);
+}
+
+static void word(encoder_t *e, uint64_t value, int size) {
+  for (int i = 0; i < size; i++) {
+    byte(e, value >> (8 * i));
+  }
+}
+
+static uint64_t here(encoder_t *e) {
+  return e->section->bytes.size;
+}
+
+static void fixup(encoder_t *e, uint32_t symbol, uint32_t type, int64_t addend) {
+  fixup_t fixup = { e->index, { here(e), symbol, type, addend } };
+  fixup_vec_push(&e->fixups, fixup);
+}
+
+static int regno(uint8_t reg) {
+  return reg >= ASM_XMM0 ? reg - ASM_XMM0 : reg;
+}
+
+static bool fits8(int64_t value) {
+  return value == (int8_t)value;
+}
+
+// Encode an instruction whose ModRM byte has `reg` in its reg field and `rm`
+// as its r/m operand, followed by an immediate of `imm_size` bytes. `opcode`
+// is written from its most significant nonzero byte, after `prefix` if any.
+static void modrm(encoder_t *e, uint8_t prefix, bool w, uint32_t opcode, int reg,
+                  const asm_operand_t *rm, int imm_size, int64_t imm, int bytes) {
+  int base = rm->tag == ASM_REG || rm->tag == ASM_MEM ? regno(rm->reg) : 0;
+  uint8_t rex = (w ? 8 : 0) | (reg >= 8 ? 4 : 0) | (base >= 8 ? 1 : 0);
+  if (((bytes & REG_BYTE) && reg >= 4) || ((bytes & RM_BYTE) && rm->tag == ASM_REG && base >= 4)) {
+    rex |= 0x40;
+  }
+  if (prefix) {
+    byte(e, prefix);
+  }
+  if (rex) {
+    byte(e, 0x40 | rex);
+  }
+  for (int shift = opcode > 0xffff ? 16 : opcode > 0xff ? 8 : 0; shift >= 0; shift -= 8) {
+    byte(e, opcode >> shift);
+  }
+
+  reg &= 7;
+  switch (rm->tag) {
+  case ASM_REG:
+    byte(e, 0xc0 | reg << 3 | (base & 7));
+    break;
+  case ASM_MEM: {
+    // rbp and r13 as a base always take a displacement, and rsp and r12 a SIB
+    int mod = rm->value == 0 && (base & 7) != 5 ? 0 : fits8(rm->value) ? 1 : 2;
+    byte(e, mod << 6 | reg << 3 | (base & 7));
+    if ((base & 7) == 4) {
+      byte(e, 0x24);
+    }
+    word(e, rm->value, mod == 0 ? 0 : mod == 1 ? 1 : 4);
+    break;
+  }
+  case ASM_RIP:
+    byte(e, reg << 3 | 5);
+    // relative to the end of the instruction
+    fixup(e, rm->symbol, rm->reloc == ASM_GOT ? R_X86_64_GOTPCREL : R_X86_64_PC32,
+          rm->value - 4 - imm_size);
+    word(e, 0, 4);
+    break;
+  default:
+    dcc_ice("bad r/m operand");
+  }
+  word(e, imm, imm_size);
+}
+
+static void branch(encoder_t *e, const asm_operand_t *target) {
+  fixup(e, target->symbol, target->reloc == ASM_PLT ? R_X86_64_PLT32 : R_X86_64_PC32, -4);
+  word(e, 0, 4);
+}
+
+// The /digit of the group 1 arithmetic instructions
+static int alu_digit(enum asm_op op) {
+  switch (op) {
+  case ASM_ADD: return 0;
+  case ASM_OR: return 1;
+  case ASM_AND: return 4;
+  case ASM_SUB: return 5;
+  case ASM_XOR: return 6;
+  default: return 7;
+  }
+}
+
+static void encode(encoder_t *e, const asm_instr_t *instr) {
+  const asm_operand_t *src = &instr->src, *dst = &instr->dst;
+  uint8_t size = instr->size;
+  bool w = size == 8, is_byte = size == 1;
+  uint8_t p16 = size == 2 ? 0x66 : 0;
+  int imm_size = is_byte ? 1 : size == 2 ? 2 : 4;
+  uint8_t sse = size == 4 ? 0xf3 : 0xf2;
+  switch ((enum asm_op)instr->op) {
+  case ASM_MOV:
+    if (src->tag == ASM_IMM) {
+      modrm(e, p16, w, is_byte ? 0xc6 : 0xc7, 0, dst, imm_size, src->value, RM_BYTE * is_byte);
+    } else if (src->tag == ASM_REG) {
+      modrm(e, p16, w, is_byte ? 0x88 : 0x89, regno(src->reg), dst, 0, 0,
+            (REG_BYTE | RM_BYTE) * is_byte);
+    } else {
+      modrm(e, p16, w, is_byte ? 0x8a : 0x8b, regno(dst->reg), src, 0, 0, REG_BYTE * is_byte);
+    }
+    break;
+  case ASM_MOVABS:
+    byte(e, 0x48 | (dst->reg >= 8));
+    byte(e, 0xb8 + (dst->reg & 7));
+    word(e, src->value, 8);
+    break;
+  case ASM_MOVZB:
+  case ASM_MOVZW:
+  case ASM_MOVSB:
+  case ASM_MOVSW: {
+    static const uint32_t OPS[] = { 0x0fb6, 0x0fb7, 0x0fbe, 0x0fbf };
+    bool from_byte = instr->op == ASM_MOVZB || instr->op == ASM_MOVSB;
+    modrm(e, p16, w, OPS[instr->op - ASM_MOVZB], regno(dst->reg), src, 0, 0,
+          RM_BYTE * from_byte);
+    break;
+  }
+  case ASM_MOVSL:
+    modrm(e, 0, true, 0x63, regno(dst->reg), src, 0, 0, 0);
+    break;
+  case ASM_LEA:
+    modrm(e, 0, true, 0x8d, regno(dst->reg), src, 0, 0, 0);
+    break;
+  case ASM_ADD:
+  case ASM_SUB:
+  case ASM_AND:
+  case ASM_OR:
+  case ASM_XOR:
+  case ASM_CMP: {
+    int digit = alu_digit(instr->op);
+    if (src->tag == ASM_IMM) {
+      bool short_imm = !is_byte && fits8(src->value);
+      modrm(e, p16, w, is_byte ? 0x80 : short_imm ? 0x83 : 0x81, digit, dst,
+            short_imm ? 1 : imm_size, src->value, RM_BYTE * is_byte);
+    } else if (src->tag == ASM_REG) {
+      modrm(e, p16, w, digit * 8 + !is_byte, regno(src->reg), dst, 0, 0,
+            (REG_BYTE | RM_BYTE) * is_byte);
+    } else {
+      modrm(e, p16, w, digit * 8 + 2 + !is_byte, regno(dst->reg), src, 0, 0,
+            REG_BYTE * is_byte);
+    }
+    break;
+  }
+  case ASM_TEST:
+    modrm(e, p16, w, is_byte ? 0x84 : 0x85, regno(src->reg), dst, 0, 0,
+          (REG_BYTE | RM_BYTE) * is_byte);
+    break;
+  case ASM_IMUL:
+    modrm(e, p16, w, 0x0faf, regno(dst->reg), src, 0, 0, 0);
+    break;
+  case ASM_SHL:
+  case ASM_SAR:
+  case ASM_SHR: {
+    int digit = instr->op == ASM_SHL ? 4 : instr->op == ASM_SHR ? 5 : 7;
+    if (src->tag == ASM_IMM && src->value == 1) {
+      modrm(e, p16, w, is_byte ? 0xd0 : 0xd1, digit, dst, 0, 0, RM_BYTE * is_byte);
+    } else if (src->tag == ASM_IMM) {
+      modrm(e, p16, w, is_byte ? 0xc0 : 0xc1, digit, dst, 1, src->value, RM_BYTE * is_byte);
+    } else {
+      modrm(e, p16, w, is_byte ? 0xd2 : 0xd3, digit, dst, 0, 0, RM_BYTE * is_byte);
+    }
+    break;
+  }
+  case ASM_NEG:
+  case ASM_NOT:
+  case ASM_IDIV:
+  case ASM_DIV: {
+    int digit = instr->op == ASM_NEG ? 3 : instr->op == ASM_NOT ? 2
+      : instr->op == ASM_IDIV ? 7 : 6;
+    modrm(e, p16, w, is_byte ? 0xf6 : 0xf7, digit, dst, 0, 0, RM_BYTE * is_byte);
+    break;
+  }
+  case ASM_CQO:
+    if (w) {
+      byte(e, 0x48);
+    }
+    byte(e, 0x99);
+    break;
+  case ASM_BTC:
+    modrm(e, p16, w, 0x0fba, 7, dst, 1, src->value, 0);
+    break;
+  case ASM_SETCC:
+    modrm(e, 0, false, 0x0f90 + instr->cond, 0, dst, 0, 0, RM_BYTE);
+    break;
+  case ASM_JCC:
+    byte(e, 0x0f);
+    byte(e, 0x80 + instr->cond);
+    branch(e, dst);
+    break;
+  case ASM_JMP:
+  case ASM_CALL:
+    if (dst->tag == ASM_TARGET) {
+      byte(e, instr->op == ASM_JMP ? 0xe9 : 0xe8);
+      branch(e, dst);
+    } else {
+      modrm(e, 0, false, 0xff, instr->op == ASM_JMP ? 4 : 2, dst, 0, 0, 0);
+    }
+    break;
+  case ASM_RET:
+    byte(e, 0xc3);
+    break;
+  case ASM_LEAVE:
+    byte(e, 0xc9);
+    break;
+  case ASM_PUSH:
+  case ASM_POP:
+    if (dst->reg >= 8) {
+      byte(e, 0x41);
+    }
+    byte(e, (instr->op == ASM_PUSH ? 0x50 : 0x58) + (dst->reg & 7));
+    break;
+  case ASM_REP_MOVSB:
+    byte(e, 0xf3);
+    byte(e, 0xa4);
+    break;
+  case ASM_REP_STOSB:
+    byte(e, 0xf3);
+    byte(e, 0xaa);
+    break;
+  case ASM_MOVSS:
+  case ASM_MOVSD: {
+    uint8_t prefix = instr->op == ASM_MOVSS ? 0xf3 : 0xf2;
+    if (dst->tag == ASM_REG) {
+      modrm(e, prefix, false, 0x0f10, regno(dst->reg), src, 0, 0, 0);
+    } else {
+      modrm(e, prefix, false, 0x0f11, regno(src->reg), dst, 0, 0, 0);
+    }
+    break;
+  }
+  case ASM_MOVQ:
+    if (dst->reg >= ASM_XMM0) {
+      modrm(e, 0x66, w, 0x0f6e, regno(dst->reg), src, 0, 0, 0);
+    } else {
+      modrm(e, 0x66, w, 0x0f7e, regno(src->reg), dst, 0, 0, 0);
+    }
+    break;
+  case ASM_ADDS:
+  case ASM_SUBS:
+  case ASM_MULS:
+  case ASM_DIVS: {
+    static const uint32_t OPS[] = { 0x0f58, 0x0f5c, 0x0f59, 0x0f5e };
+    modrm(e, sse, false, OPS[instr->op - ASM_ADDS], regno(dst->reg), src, 0, 0, 0);
+    break;
+  }
+  case ASM_UCOMIS:
+    modrm(e, w ? 0x66 : 0, false, 0x0f2e, regno(dst->reg), src, 0, 0, 0);
+    break;
+  case ASM_CVTSI2SS:
+  case ASM_CVTSI2SD:
+    modrm(e, instr->op == ASM_CVTSI2SS ? 0xf3 : 0xf2, w, 0x0f2a, regno(dst->reg), src,
+          0, 0, 0);
+    break;
+  case ASM_CVTTSS2SI:
+  case ASM_CVTTSD2SI:
+    modrm(e, instr->op == ASM_CVTTSS2SI ? 0xf3 : 0xf2, w, 0x0f2c, regno(dst->reg), src,
+          0, 0, 0);
+    break;
+  case ASM_CVTSS2SD:
+  case ASM_CVTSD2SS:
+    modrm(e, instr->op == ASM_CVTSS2SD ? 0xf3 : 0xf2, false, 0x0f5a, regno(dst->reg),
+          src, 0, 0, 0);
+    break;
+  case ASM_MOVUPS:
+    if (dst->tag == ASM_REG) {
+      modrm(e, 0, false, 0x0f10, regno(dst->reg), src, 0, 0, 0);
+    } else {
+      modrm(e, 0, false, 0x0f11, regno(src->reg), dst, 0, 0, 0);
+    }
+    break;
+  case ASM_PADD:
+  case ASM_PSUB:
+  case ASM_PUNPCKL: {
+    // by the size of the lanes
+    static const uint8_t ADDS[] = { 0xfc, 0xfd, 0, 0xfe, 0, 0, 0, 0xd4 };
+    static const uint8_t SUBS[] = { 0xf8, 0xf9, 0, 0xfa, 0, 0, 0, 0xfb };
+    static const uint8_t UNPACKS[] = { 0x60, 0x61, 0, 0x62, 0, 0, 0, 0x6c };
+    const uint8_t *ops = instr->op == ASM_PADD ? ADDS : instr->op == ASM_PSUB ? SUBS : UNPACKS;
+    modrm(e, 0x66, false, 0x0f00 | ops[size - 1], regno(dst->reg), src, 0, 0, 0);
+    break;
+  }
+  case ASM_PMULLW:
+  case ASM_PMULUDQ:
+  case ASM_PAND:
+  case ASM_POR:
+  case ASM_PXOR: {
+    static const uint32_t OPS[] = { 0x0fd5, 0x0ff4, 0x0fdb, 0x0feb, 0x0fef };
+    modrm(e, 0x66, false, OPS[instr->op - ASM_PMULLW], regno(dst->reg), src, 0, 0, 0);
+    break;
+  }
+  case ASM_PSLL:
+  case ASM_PSRL:
+  case ASM_PSRA: {
+    int digit = instr->op == ASM_PSLL ? 6 : instr->op == ASM_PSRL ? 2 : 4;
+    uint32_t opcode = size == 2 ? 0x0f71 : size == 4 ? 0x0f72 : 0x0f73;
+    modrm(e, 0x66, false, opcode, digit, dst, 1, src->value, 0);
+    break;
+  }
+  case ASM_ADDP:
+  case ASM_SUBP:
+  case ASM_MULP:
+  case ASM_DIVP: {
+    static const uint32_t OPS[] = { 0x0f58, 0x0f5c, 0x0f59, 0x0f5e };
+    modrm(e, size == 8 ? 0x66 : 0, false, OPS[instr->op - ASM_ADDP], regno(dst->reg),
+          src, 0, 0, 0);
+    break;
+  }
+  case ASM_PSHUFD:
+    modrm(e, 0x66, false, 0x0f70, regno(dst->reg), dst, 1, src->value, 0);
+    break;
+  }
+}
+
+static void pad(encoder_t *e, uint64_t align) {
+  if (align > e->section->align) {
+    e->section->align = align;
+  }
+  if (e->index == ASM_BSS) {
+    e->section->size = (e->section->size + align - 1) / align * align;
+    return;
+  }
+  while (here(e) % align) {
+    // filler in code is never reached, but may as well be a nop
+    byte(e, e->index == ASM_TEXT ? 0x90 : 0);
+  }
+}
+
+static uint64_t offset(encoder_t *e) {
+  return e->index == ASM_BSS ? e->section->size : here(e);
+}
+
+obj_t* dcc_x86_encode(const asm_t *as) {
+  obj_t *obj = dcc_calloc(1, sizeof(obj_t));
+  obj->as = as;
+  obj->symbols = dcc_malloc((as->symbols.size + 1) * sizeof(obj_symbol_t));
+  for (size_t i = 0; i < as->symbols.size; i++) {
+    obj->symbols[i].section = -1;
+    obj->symbols[i].value = obj->symbols[i].size = 0;
+  }
+  for (int i = 0; i < ASM_SECTION_COUNT; i++) {
+    obj->sections[i].bytes = uint8_vec_new();
+    obj->sections[i].relocs = obj_reloc_vec_new();
+    obj->sections[i].align = 1;
+  }
+
+  encoder_t e = { obj, ASM_TEXT, &obj->sections[ASM_TEXT], fixup_vec_new() };
+  for (size_t i = 0; i < as->items.size; i++) {
+    const asm_item_t *item = &as->items.data[i];
+    switch (item->tag) {
+    case ASM_INSTR:
+      encode(&e, &item->instr);
+      break;
+    case ASM_LABEL:
+      obj->symbols[item->symbol].section = e.index;
+      obj->symbols[item->symbol].value = offset(&e);
+      break;
+    case ASM_END:
+      obj->symbols[item->symbol].size = offset(&e) - obj->symbols[item->symbol].value;
+      break;
+    case ASM_SECTION:
+      e.index = item->section;
+      e.section = &obj->sections[item->section];
+      break;
+    case ASM_ALIGN:
+      pad(&e, item->size);
+      break;
+    case ASM_BYTES:
+      for (size_t j = 0; j < item->bytes.size; j++) {
+        byte(&e, item->bytes.data[j]);
+      }
+      break;
+    case ASM_ZERO:
+      if (e.index == ASM_BSS) {
+        e.section->size += item->size;
+      } else {
+        word(&e, 0, item->size);
+      }
+      break;
+    case ASM_ADDRESS:
+      fixup(&e, item->address.symbol, R_X86_64_64, item->address.addend);
+      word(&e, 0, 8);
+      break;
+    case ASM_OFFSET:
+      fixup(&e, item->address.symbol, R_X86_64_PC32, item->address.addend);
+      word(&e, 0, 4);
+      break;
+    }
+  }
+  for (int i = 0; i < ASM_SECTION_COUNT; i++) {
+    if (i != ASM_BSS) {
+      obj->sections[i].size = obj->sections[i].bytes.size;
+    }
+  }
+
+  // references within a section to labels that cannot be interposed are
+  // known now; everything else is left to the linker
+  for (size_t i = 0; i < e.fixups.size; i++) {
+    fixup_t *fixup = &e.fixups.data[i];
+    obj_reloc_t *reloc = &fixup->reloc;
+    obj_symbol_t *symbol = &obj->symbols[reloc->symbol];
+    obj_section_t *section = &obj->sections[fixup->section];
+    bool relative = reloc->type == R_X86_64_PC32 || reloc->type == R_X86_64_PLT32;
+    if (relative && symbol->section == (int)fixup->section
+        && !as->symbols.data[reloc->symbol].is_global) {
+      uint32_t value = symbol->value + reloc->addend - reloc->offset;
+      for (int j = 0; j < 4; j++) {
+        section->bytes.data[reloc->offset + j] = value >> (8 * j);
+      }
+    } else {
+      obj_reloc_vec_push(&section->relocs, *reloc);
+    }
+  }
+  fixup_vec_free(&e.fixups);
+  return obj;
+}
+
+void dcc_obj_free(obj_t *obj) {
+  for (int i = 0; i < ASM_SECTION_COUNT; i++) {
+    uint8_vec_free(&obj->sections[i].bytes);
+    obj_reloc_vec_free(&obj->sections[i].relocs);
+  }
+  free(obj->symbols);
+  free(obj);
+}
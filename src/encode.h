@@ -0,0 +1,66 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+  x86-64 machine code. Encodes an asm_t into the contents of its sections,
+  resolving jumps and calls to labels within a section and recording a
+  relocation for every other reference to a symbol, in the terms of the
+  System V ABI. The result is what an assembler would put in an object file,
+  before any particular file format.
+*/
+
+#pragma once
+
+#include "asm.h"
+#include "vec_types.h"
+
+// Relocation types, numbered as in the ABI
+#define R_X86_64_64 1
+#define R_X86_64_PC32 2
+#define R_X86_64_PLT32 4
+#define R_X86_64_GOTPCREL 9
+
+typedef struct {
+  uint64_t offset;
+  uint32_t symbol;
+  uint32_t type;
+  int64_t addend;
+} obj_reloc_t;
+DECLARE_VEC(obj_reloc_t, obj_reloc_vec);
+
+typedef struct {
+  uint8_vec_t bytes; // empty for ASM_BSS
+  uint64_t size;
+  uint32_t align;
+  obj_reloc_vec_t relocs;
+} obj_section_t;
+
+typedef struct {
+  int section; // -1 if undefined
+  uint64_t value; // offset in its section
+  uint64_t size;
+} obj_symbol_t;
+
+typedef struct {
+  const asm_t *as;
+  obj_section_t sections[ASM_SECTION_COUNT];
+  obj_symbol_t *symbols; // of each asm symbol
+} obj_t;
+
+// The object code for `as`, which must outlive it
+obj_t* dcc_x86_encode(const asm_t *as);
+void dcc_obj_free(obj_t *obj);
@@ -0,0 +1,400 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "consteval.h"
+#include "dcc.h"
+#include "fold.h"
+#include "sema.h"
+#include "type.h"
+
+static intval_t int_value(int64_t value) {
+  intval_t result = { dcc_type_basic(TYPE_INT), value };
+  return result;
+}
+
+static bool integer_constant(const exp_t *exp, intval_t *value) {
+  if (exp->tag != EXP_CONSTANT || exp->constant->tag == CONSTANT_FLOAT
+      || !dcc_type_is_integer(exp->type)) {
+    return false;
+  }
+  intval_t raw = { exp->type->unqual, exp->constant->integer };
+  *value = dcc_intval_convert(raw, exp->type);
+  return true;
+}
+
+static void make_constant(exp_t *exp, intval_t value) {
+  constant_t *constant = dcc_calloc(1, sizeof *constant);
+  constant->tag = CONSTANT_INTEGER;
+  constant->integer = value.bits;
+  constant->is_unsigned = !dcc_type_is_signed(value.type);
+  exp->tag = EXP_CONSTANT;
+  exp->type = value.type;
+  exp->constant = constant;
+}
+
+// Replace `exp` by its operand `operand`, if that has the same type
+static void replace(exp_t *exp, exp_t *operand) {
+  if (operand->type == exp->type) {
+    *exp = *operand;
+  }
+}
+
+// Convert a floating constant to an integer type, unless it is out of range
+static bool float_to_int(double floating, const type_t *type, intval_t *value) {
+  intval_t raw = { type, 0 };
+  if (type->tag == TYPE_BOOL) {
+    raw.bits = floating != 0;
+  } else if (dcc_type_is_signed(type) && floating > -0x1p63 && floating < 0x1p63) {
+    raw.bits = (int64_t)floating;
+  } else if (!dcc_type_is_signed(type) && floating > -1 && floating < 0x1p64) {
+    raw.bits = (uint64_t)floating;
+  } else {
+    return false;
+  }
+  // and within the range of `type` itself
+  *value = dcc_intval_convert(raw, type);
+  return value->bits == raw.bits;
+}
+
+// Whether `exp` has the value 0 or 1, so that !! leaves it alone
+static bool is_boolean(const exp_t *exp) {
+  switch (exp->tag) {
+  case EXP_LESS:
+  case EXP_MORE:
+  case EXP_LESSEQ:
+  case EXP_MOREEQ:
+  case EXP_EQUAL:
+  case EXP_NOTEQUAL:
+  case EXP_LOGICAND:
+  case EXP_LOGICOR:
+  case EXP_LOGICNOT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Whether `op` with `operand` on its right (or either side, if commutative)
+// yields the other operand converted to `type`
+static bool is_identity(enum exp_tag op, intval_t operand, const type_t *type, bool right) {
+  intval_t ones = dcc_intval_convert(int_value(-1), type);
+  switch (op) {
+  case EXP_MULTIPLY:
+    return operand.bits == 1;
+  case EXP_DIVIDE:
+    return right && operand.bits == 1;
+  case EXP_ADD:
+  case EXP_BITOR:
+  case EXP_BITXOR:
+    return operand.bits == 0;
+  case EXP_SUBTRACT:
+  case EXP_SHIFTLEFT:
+  case EXP_SHIFTRIGHT:
+    return right && operand.bits == 0;
+  case EXP_BITAND:
+    return dcc_intval_convert(operand, type).bits == ones.bits;
+  default:
+    return false;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Expressions
+////////////////////////////////////////////////////////////////////////////////
+
+static void fold_binary(exp_t *exp) {
+  exp_t *lhs = exp->binary.lhs, *rhs = exp->binary.rhs;
+  intval_t a, b, value;
+  bool constant_lhs = integer_constant(lhs, &a), constant_rhs = integer_constant(rhs, &b);
+  if (constant_lhs && constant_rhs) {
+    if (dcc_intval_binary(exp->tag, a, b, &value) == INTVAL_OK) {
+      make_constant(exp, value);
+    }
+    return;
+  }
+
+  // x + 0 is not x for a floating x of -0.0
+  const type_t *type = exp->type;
+  if (!dcc_type_is_integer(type) && type->tag != TYPE_POINTER) {
+    return;
+  }
+  if (constant_rhs && is_identity(exp->tag, b, type, true)) {
+    replace(exp, lhs);
+  } else if (constant_lhs && is_identity(exp->tag, a, type, false)) {
+    replace(exp, rhs);
+  }
+}
+
+static void fold_unary(exp_t *exp) {
+  exp_t *operand = exp->unary;
+  intval_t a, value;
+  if (integer_constant(operand, &a)) {
+    if (dcc_intval_unary(exp->tag, a, &value) == INTVAL_OK) {
+      make_constant(exp, value);
+    }
+  } else if (operand->tag == exp->tag) {
+    if (exp->tag != EXP_LOGICNOT) {
+      replace(exp, operand->unary);
+    } else if (is_boolean(operand->unary)) {
+      *exp = *operand->unary;
+    }
+  }
+}
+
+static void fold_cast(exp_t *exp) {
+  const type_t *type = exp->type;
+  exp_t *operand = exp->cast.value;
+  intval_t value;
+  if (!dcc_type_is_integer(type)) {
+    return;
+  } else if (integer_constant(operand, &value)) {
+    make_constant(exp, dcc_intval_convert(value, type));
+  } else if (operand->tag == EXP_CONSTANT && operand->constant->tag == CONSTANT_FLOAT
+             && float_to_int(operand->constant->floating, type, &value)) {
+    make_constant(exp, value);
+  }
+}
+
+static void fold_logical(exp_t *exp) {
+  intval_t a, b;
+  if (!integer_constant(exp->binary.lhs, &a)) {
+    return;
+  }
+  // then the right operand is either never evaluated or decides the result
+  bool is_and = exp->tag == EXP_LOGICAND;
+  if (is_and ? !a.bits : a.bits != 0) {
+    make_constant(exp, int_value(!is_and));
+  } else if (integer_constant(exp->binary.rhs, &b)) {
+    make_constant(exp, int_value(b.bits != 0));
+  } else if (is_boolean(exp->binary.rhs)) {
+    *exp = *exp->binary.rhs;
+  }
+}
+
+static void fold_ternary(exp_t *exp) {
+  intval_t cond, value;
+  if (!integer_constant(exp->ternary.cond, &cond)) {
+    return;
+  }
+  exp_t *chosen = cond.bits ? exp->ternary.true_exp : exp->ternary.false_exp;
+  if (dcc_type_is_integer(exp->type) && integer_constant(chosen, &value)) {
+    make_constant(exp, dcc_intval_convert(value, exp->type));
+  } else {
+    replace(exp, chosen);
+  }
+}
+
+static void fold_sizeof(exp_t *exp, const type_t *type) {
+  intval_t size = { dcc_type_basic(TYPE_ULONG), dcc_type_size(type) };
+  make_constant(exp, size);
+}
+
+static void fold_exp(exp_t *exp);
+static void fold_initializer(initializer_t *init);
+
+static void fold_inits(initialization_vec_t *inits) {
+  for (size_t i = 0; i < inits->size; i++) {
+    fold_initializer(inits->data[i].initializer);
+  }
+}
+
+static void fold_initializer(initializer_t *init) {
+  if (init->tag == INIT_EXP) {
+    fold_exp(init->expression);
+  } else {
+    fold_inits(init->inits);
+  }
+}
+
+// Operands are folded first, so constants rise from the leaves
+static void fold_exp(exp_t *exp) {
+  switch (exp->tag) {
+  case EXP_IDENT: {
+    symbol_t *symbol = exp->ident.symbol;
+    if (symbol && symbol->tag == SYM_ENUM_CONST) {
+      make_constant(exp, int_value(symbol->enumtor->value));
+    }
+    break;
+  }
+  case EXP_STRING:
+  case EXP_CONSTANT:
+  case EXP_UNKNOWN:
+    break;
+  case EXP_SIZEOFEXP:
+    // the operand is never evaluated
+    fold_sizeof(exp, exp->unary->type);
+    break;
+  case EXP_SIZEOFTYPE:
+    fold_sizeof(exp, exp->cast.type->type);
+    break;
+  case EXP_CAST:
+    fold_exp(exp->cast.value);
+    fold_cast(exp);
+    break;
+  case EXP_NEGATE:
+  case EXP_BITNOT:
+  case EXP_LOGICNOT:
+    fold_exp(exp->unary);
+    fold_unary(exp);
+    break;
+  case EXP_ADDRESSOF:
+  case EXP_DEREFERENCE:
+  case EXP_PREINCREMENT:
+  case EXP_PREDECREMENT:
+  case EXP_POSTINCREMENT:
+  case EXP_POSTDECREMENT:
+    fold_exp(exp->unary);
+    break;
+  case EXP_TERNARY:
+    fold_exp(exp->ternary.cond);
+    fold_exp(exp->ternary.true_exp);
+    fold_exp(exp->ternary.false_exp);
+    fold_ternary(exp);
+    break;
+  case EXP_ASSIGN:
+    fold_exp(exp->assignment.lhs);
+    fold_exp(exp->assignment.rhs);
+    break;
+  case EXP_LIST:
+    for (size_t i = 0; i < exp->list.size; i++) {
+      fold_exp(exp->list.data[i]);
+    }
+    break;
+  case EXP_DOT:
+  case EXP_ARROW:
+    fold_exp(exp->child.lhs);
+    break;
+  case EXP_CALL:
+    fold_exp(exp->call.lhs);
+    for (size_t i = 0; i < exp->call.args->size; i++) {
+      fold_exp(exp->call.args->data[i]);
+    }
+    break;
+  case EXP_STRUCT:
+    fold_inits(exp->struct_init.inits);
+    break;
+  case EXP_INDEX:
+  case EXP_VA_START:
+  case EXP_VA_COPY:
+    fold_exp(exp->binary.lhs);
+    fold_exp(exp->binary.rhs);
+    break;
+  case EXP_VA_ARG:
+    fold_exp(exp->cast.value);
+    break;
+  case EXP_VA_END:
+    fold_exp(exp->unary);
+    break;
+  case EXP_LOGICAND:
+  case EXP_LOGICOR:
+    fold_exp(exp->binary.lhs);
+    fold_exp(exp->binary.rhs);
+    fold_logical(exp);
+    break;
+  default:
+    // every remaining tag is an arithmetic, bitwise or comparison operator
+    fold_exp(exp->binary.lhs);
+    fold_exp(exp->binary.rhs);
+    fold_binary(exp);
+    break;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Statements
+////////////////////////////////////////////////////////////////////////////////
+
+static void fold_decl(decl_t *decl) {
+  for (size_t i = 0; i < decl->init_decltors.size; i++) {
+    init_decltor_t *init = decl->init_decltors.data[i];
+    if (init->initializer) {
+      fold_initializer(init->initializer);
+    }
+  }
+}
+
+static void fold_stmt(stmt_t *stmt) {
+  switch (stmt->tag) {
+  case STMT_CASE:
+    // the value of the label is known already
+    fold_stmt(stmt->stmt_case.stmt);
+    break;
+  case STMT_DEFAULT:
+    fold_stmt(stmt->stmt);
+    break;
+  case STMT_LABEL:
+    fold_stmt(stmt->stmt_label.stmt);
+    break;
+  case STMT_COMPOUND:
+    for (size_t i = 0; i < stmt->stmt_compound.size; i++) {
+      block_item_t *item = stmt->stmt_compound.data[i];
+      if (item->tag == AST_DECLARATION) {
+        fold_decl(item->declaration);
+      } else {
+        fold_stmt(item->statement);
+      }
+    }
+    break;
+  case STMT_EXP:
+  case STMT_RETURN:
+    if (stmt->exp) {
+      fold_exp(stmt->exp);
+    }
+    break;
+  case STMT_IF:
+  case STMT_SWITCH:
+    fold_exp(stmt->stmt_select.exp);
+    fold_stmt(stmt->stmt_select.primary);
+    if (stmt->stmt_select.secondary) {
+      fold_stmt(stmt->stmt_select.secondary);
+    }
+    break;
+  case STMT_DO:
+  case STMT_WHILE:
+    fold_exp(stmt->stmt_whiledo.exp);
+    fold_stmt(stmt->stmt_whiledo.stmt);
+    break;
+  case STMT_FOR: {
+    if (stmt->stmt_for.decl) {
+      fold_decl(stmt->stmt_for.decl);
+    }
+    exp_t *exps[] = { stmt->stmt_for.exp1, stmt->stmt_for.exp2, stmt->stmt_for.exp3 };
+    for (int i = 0; i < 3; i++) {
+      if (exps[i]) {
+        fold_exp(exps[i]);
+      }
+    }
+    fold_stmt(stmt->stmt_for.stmt);
+    break;
+  }
+  case STMT_GOTO:
+  case STMT_CONTINUE:
+  case STMT_BREAK:
+    break;
+  }
+}
+
+void dcc_fold(external_decl_vec_t *unit) {
+  for (size_t i = 0; i < unit->size; i++) {
+    external_decl_t *decl = unit->data[i];
+    if (decl->tag == AST_EXT_FUNCTION) {
+      fold_stmt(decl->function->compound);
+    } else {
+      fold_decl(decl->declaration);
+    }
+  }
+}
@@ -0,0 +1,34 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+  Constant folding, run once dcc_sema() has typed the tree. Integer
+  subexpressions whose operands are constants are rewritten in place into
+  EXP_CONSTANT nodes, as are enumeration constants and sizeof. The type of a
+  folded constant is its exp_t type, not the one its spelling implies. A few
+  identities are simplified too where they keep the type of the expression and
+  every side effect of its operands: x * 1, x / 1, x + 0, x - 0, x | 0, x ^ 0,
+  x & ~0, shifts by 0, - -x, ~~x and !! of a comparison. Operations whose
+  result is undefined, like signed overflow or division by zero, are left for
+  run time.
+*/
+
+#pragma once
+
+#include "parse.h"
+
+void dcc_fold(external_decl_vec_t *unit);
@@ -0,0 +1,326 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdarg.h>
+
+#include "dcc.h"
+#include "init.h"
+
+DEFINE_VEC2(init_entry_t, init_entry_vec);
+
+// A cursor over the innermost braced list being laid out
+typedef struct {
+  diag_vec_t *diags;
+  init_entry_vec_t entries;
+  initialization_vec_t *inits;
+  size_t next; // initialization of `inits` to take next
+  size_t designator; // designators of that initialization already followed
+  int64_t length; // of an outermost array of unknown length
+} layout_t;
+
+// A subobject of an aggregate
+typedef struct {
+  const type_t *type;
+  uint64_t offset;
+  const member_t *member; // if a bit-field
+} subobject_t;
+
+static void error(layout_t *layout, srcloc_t loc, const char *format, ...) {
+  if (!layout->diags) {
+    return;
+  }
+  va_list vlist;
+  va_start(vlist, format);
+  dcc_vdiag(layout->diags, DIAG_ERROR, loc, 1, format, vlist);
+  va_end(vlist);
+}
+
+static void type_error(layout_t *layout, srcloc_t loc, const char *format, const type_t *type) {
+  if (layout->diags) {
+    char *str = dcc_type_str(type);
+    error(layout, loc, format, str);
+    free(str);
+  }
+}
+
+// Where an initializer starts, or 0 if it is an empty list
+static srcloc_t initializer_loc(const initializer_t *init) {
+  if (init->tag == INIT_EXP) {
+    return init->expression->loc;
+  }
+  return init->inits->size > 0 ? initializer_loc(init->inits->data[0].initializer) : 0;
+}
+
+static bool is_aggregate(const type_t *type) {
+  return type->tag == TYPE_ARRAY || type->tag == TYPE_STRUCT || type->tag == TYPE_UNION;
+}
+
+// How many subobjects initializers fill in turn. An array of unknown length
+// is a flexible array member here, so it has none.
+static int64_t subobject_count(const type_t *type) {
+  if (type->tag == TYPE_ARRAY) {
+    return type->array.length == ARRAY_LENGTH_UNKNOWN ? 0 : type->array.length;
+  }
+  return is_aggregate(type) ? (int64_t)type->record->members.size : 0;
+}
+
+static subobject_t subobject(const type_t *type, uint64_t offset, int64_t i) {
+  subobject_t sub;
+  if (type->tag == TYPE_ARRAY) {
+    sub.type = type->array.elem;
+    sub.offset = offset + i * dcc_type_size(type->array.elem);
+    sub.member = 0;
+  } else {
+    const member_t *member = &type->record->members.data[i];
+    sub.type = member->type;
+    sub.offset = offset + member->offset;
+    sub.member = member->bit_width ? member : 0;
+  }
+  return sub;
+}
+
+// Whether `exp` initializes all of the aggregate `type` by itself
+static bool initializes_whole(const type_t *type, const exp_t *exp) {
+  if (type->tag == TYPE_ARRAY) {
+    const type_t *elem = type->array.elem;
+    return exp->tag == EXP_STRING && dcc_type_is_integer(elem) && dcc_type_size(elem) == 1;
+  }
+  return dcc_type_compatible(type->unqual, dcc_type_decay(exp->type)->unqual);
+}
+
+static initialization_t* peek(layout_t *layout) {
+  return layout->next < layout->inits->size ? &layout->inits->data[layout->next] : 0;
+}
+
+static bool is_designated(layout_t *layout, const initialization_t *item) {
+  return item->designators && layout->designator < item->designators->size;
+}
+
+// Record that the i'th element of the outermost array, of unknown length, is
+// initialized; `count` is INT64_MAX only there
+static void extend(layout_t *layout, int64_t count, int64_t i) {
+  if (count == INT64_MAX && i + 1 > layout->length) {
+    layout->length = i + 1;
+  }
+}
+
+static void take(layout_t *layout) {
+  layout->next++;
+  layout->designator = 0;
+}
+
+static void add(layout_t *layout, const type_t *type, uint64_t offset, const member_t *member,
+                exp_t *exp) {
+  if (type->tag == TYPE_ARRAY && type->array.length == ARRAY_LENGTH_UNKNOWN) {
+    // only a string literal initializes a whole array, and then fixes its length
+    size_t size;
+    dcc_strlit_bytes(exp->string, &size);
+    type = dcc_type_array(type->array.elem, size + 1);
+  }
+  init_entry_t entry = {
+    offset, type, exp, member ? member->bit_offset : 0, member ? member->bit_width : 0,
+  };
+  init_entry_vec_push(&layout->entries, entry);
+}
+
+static void excess(layout_t *layout, const type_t *type) {
+  srcloc_t loc = initializer_loc(peek(layout)->initializer);
+  if (layout->diags && loc) {
+    const char *what = type->tag == TYPE_ARRAY ? "array" : type->tag == TYPE_STRUCT ? "struct"
+      : type->tag == TYPE_UNION ? "union" : "scalar";
+    dcc_diag(layout->diags, DIAG_WARNING, loc, 1, "excess elements in %s initializer", what);
+  }
+  layout->next = layout->inits->size;
+}
+
+static void element(layout_t *layout, const type_t *type, uint64_t offset,
+                    const member_t *member);
+static void aggregate(layout_t *layout, const type_t *type, uint64_t offset, bool braced,
+                      int64_t i, int64_t count);
+
+// Follow the next designator of the current initialization into `type`, and
+// initialize what the rest of them designate. Sets *index to the subobject of
+// `type` designated, or returns false if the designator is invalid, in which
+// case the initialization is skipped.
+static bool designate(layout_t *layout, const type_t *type, uint64_t offset, int64_t count,
+                      int64_t *index) {
+  initialization_t *item = peek(layout);
+  designator_t *designator = item->designators->data[layout->designator++];
+  int64_t i;
+  if (designator->tag == DESIGNATOR_EXP) {
+    srcloc_t loc = designator->exp->loc;
+    i = designator->index;
+    if (type->tag != TYPE_ARRAY) {
+      type_error(layout, loc, "array designator cannot initialize non-array type '%s'", type);
+      take(layout);
+      return false;
+    } else if (i < 0 || i >= count) {
+      error(layout, loc, "array designator index (%lld) exceeds array bounds (%lld)",
+            (long long)i, (long long)count);
+      take(layout);
+      return false;
+    }
+  } else {
+    ident_t *ident = &designator->ident;
+    const member_t *member = type->tag == TYPE_STRUCT || type->tag == TYPE_UNION
+      ? dcc_record_member(type->record, ident->name) : 0;
+    if (!member) {
+      if (layout->diags) {
+        char *str = dcc_type_str(type);
+        error(layout, ident->loc, "field designator '%s' does not refer to any field in type '%s'",
+              ident->name->str, str);
+        free(str);
+      }
+      take(layout);
+      return false;
+    }
+    i = member - type->record->members.data;
+  }
+
+  subobject_t sub = subobject(type, offset, i);
+  if (!is_designated(layout, item)) {
+    element(layout, sub.type, sub.offset, sub.member);
+  } else {
+    // initializers after a designation continue with the next subobject of the
+    // innermost object it designates
+    int64_t inner, inner_count = subobject_count(sub.type);
+    if (designate(layout, sub.type, sub.offset, inner_count, &inner)) {
+      aggregate(layout, sub.type, sub.offset, false, inner + 1, inner_count);
+    }
+  }
+  *index = i;
+  return true;
+}
+
+// Fill the subobjects of `type` from the i'th on. A braced aggregate takes every
+// initializer left in its list; one whose braces are elided stops after its
+// last subobject or at a designator, which belongs to an enclosing list.
+static void aggregate(layout_t *layout, const type_t *type, uint64_t offset, bool braced,
+                      int64_t i, int64_t count) {
+  initialization_t *item;
+  while ((item = peek(layout))) {
+    if (is_designated(layout, item)) {
+      if (!braced) {
+        return;
+      } else if (designate(layout, type, offset, count, &i)) {
+        extend(layout, count, i);
+        i++;
+      }
+      continue;
+    }
+    // unnamed members are skipped, and only the first member of a union is filled
+    if (type->tag != TYPE_ARRAY && i < count && !type->record->members.data[i].name) {
+      i++;
+      continue;
+    } else if (i >= count || (type->tag == TYPE_UNION && i > 0)) {
+      if (braced) {
+        excess(layout, type);
+      }
+      return;
+    }
+
+    subobject_t sub = subobject(type, offset, i);
+    element(layout, sub.type, sub.offset, sub.member);
+    extend(layout, count, i);
+    i++;
+  }
+}
+
+static void braced(layout_t *layout, const type_t *type, uint64_t offset,
+                   const member_t *member, initialization_vec_t *inits, int64_t count) {
+  initialization_vec_t *outer = layout->inits;
+  size_t next = layout->next, designator = layout->designator;
+  layout->inits = inits;
+  layout->next = layout->designator = 0;
+
+  initialization_t *item = peek(layout);
+  bool whole = item && inits->size == 1 && !item->designators
+    && item->initializer->tag == INIT_EXP && is_aggregate(type)
+    && initializes_whole(type, item->initializer->expression);
+  if (whole) {
+    // a string literal for a character array may be braced
+    add(layout, type, offset, member, item->initializer->expression);
+    take(layout);
+  } else if (is_aggregate(type)) {
+    aggregate(layout, type, offset, true, 0, count);
+  } else if (item) {
+    if (is_designated(layout, item)) {
+      type_error(layout, initializer_loc(item->initializer),
+                 "designator in initializer for scalar type '%s'", type);
+      take(layout);
+    } else {
+      element(layout, type, offset, member);
+    }
+    if (peek(layout)) {
+      excess(layout, type);
+    }
+  }
+
+  layout->inits = outer;
+  layout->next = next;
+  layout->designator = designator;
+}
+
+static void element(layout_t *layout, const type_t *type, uint64_t offset,
+                    const member_t *member) {
+  initializer_t *init = peek(layout)->initializer;
+  if (init->tag == INIT_LIST) {
+    take(layout);
+    braced(layout, type, offset, member, init->inits, subobject_count(type));
+  } else if (is_aggregate(type) && !initializes_whole(type, init->expression)) {
+    // its braces are elided, so it takes as many initializers as it needs
+    aggregate(layout, type, offset, false, 0, subobject_count(type));
+  } else {
+    add(layout, type, offset, member, init->expression);
+    take(layout);
+  }
+}
+
+init_entry_vec_t dcc_init_layout(const type_t *type, initializer_t *init, diag_vec_t *diags,
+                                 int64_t *length) {
+  layout_t layout = { diags, init_entry_vec_new(), 0, 0, 0, 0 };
+  bool unbounded = type->tag == TYPE_ARRAY && type->array.length == ARRAY_LENGTH_UNKNOWN;
+  if (init->tag == INIT_LIST) {
+    braced(&layout, type, 0, 0, init->inits, unbounded ? INT64_MAX : subobject_count(type));
+  } else if (!is_aggregate(type) || initializes_whole(type, init->expression)) {
+    add(&layout, type, 0, 0, init->expression);
+  } else if (type->tag == TYPE_ARRAY) {
+    error(&layout, init->expression->loc, "array initializer must be an initializer list");
+  } else if (diags) {
+    char *to = dcc_type_str(type), *from = dcc_type_str(init->expression->type);
+    error(&layout, init->expression->loc,
+          "initializing '%s' with an expression of incompatible type '%s'", to, from);
+    free(to);
+    free(from);
+  }
+
+  if (unbounded) {
+    // unless a string literal initialized the whole array
+    const type_t *first = layout.entries.size ? layout.entries.data[0].type : 0;
+    bool string = layout.entries.size == 1 && first->tag == TYPE_ARRAY
+      && first->array.elem == type->array.elem;
+    *length = string ? first->array.length : layout.length;
+  }
+  return layout.entries;
+}
+
+uint64_t dcc_init_string_size(const init_entry_t *entry) {
+  size_t size;
+  dcc_strlit_bytes(entry->exp->string, &size);
+  uint64_t room = dcc_type_size(entry->type);
+  return size + 1 < room ? size + 1 : room;
+}
@@ -0,0 +1,50 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+  Initializer layout (stdspec.6.7.8). Walks an initializer against the type of
+  the object it initializes, following designators and eliding braces as C
+  does, and flattens it into the initializations it denotes, each with the byte
+  offset of its subobject. The object is zero before any entry applies, and a
+  later entry for a subobject overrides an earlier one.
+*/
+
+#pragma once
+
+#include "diag.h"
+#include "parse.h"
+#include "type.h"
+
+typedef struct {
+  uint64_t offset;
+  // a scalar, a struct or union initialized by an expression of its type, or a
+  // character array initialized by a string literal
+  const type_t *type;
+  exp_t *exp;
+  uint8_t bit_offset, bit_width; // bit_width is zero unless a bit-field
+} init_entry_t;
+DECLARE_VEC(init_entry_t, init_entry_vec);
+
+// Flatten `init` for an object of `type`, reporting errors to `diags` unless it
+// is null. If `type` is an array of unknown length, *length is set to the
+// length the initializer gives it and the entries are laid out for that.
+init_entry_vec_t dcc_init_layout(const type_t *type, initializer_t *init, diag_vec_t *diags,
+                                 int64_t *length);
+
+// The bytes of the string literal a character array entry copies, whose
+// terminator only goes in if there is room
+uint64_t dcc_init_string_size(const init_entry_t *entry);
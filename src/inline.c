@@ -0,0 +1,407 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <string.h>
+
+#include "inline.h"
+#include "ssa.h"
+
+#define INLINE_LIMIT 80 // instructions of an `inline` function
+#define LEAF_LIMIT 24 // of a static function making no calls
+#define CALLER_LIMIT 4000 // that a caller may grow to
+
+typedef struct {
+  ir_func_vec_t *funcs;
+  ptrmap_t indices; // name -> index + 1 of the function defining it
+  uint32_t *components; // of each function
+  FILE *report;
+} inliner_t;
+
+// The index of the function of the unit an instruction calls directly, or
+// IR_NONE
+static uint32_t callee_index(const inliner_t *inliner, const ir_func_t *func,
+                             const ir_instr_t *call) {
+  const ir_instr_t *target = &func->instrs.data[call->args[0]];
+  if (target->op != IR_GLOBAL || target->symbol->tag != SYM_FUNCTION) {
+    return IR_NONE;
+  }
+  return (uint32_t)(uintptr_t)dcc_ptrmap_get(&inliner->indices, target->symbol->name) - 1;
+}
+
+////
+// Call graph
+
+// Number the strongly connected components of the call graph, and list the
+// functions with callees before callers
+static uint32_t* bottom_up(inliner_t *inliner) {
+  ir_func_vec_t *funcs = inliner->funcs;
+  uint32_t n = funcs->size;
+
+  // the callees of each function, as rows of one array
+  uint32_t *start = dcc_malloc((n + 1) * sizeof(uint32_t));
+  uint32_vec_t edges = uint32_vec_new();
+  for (uint32_t f = 0; f < n; f++) {
+    start[f] = edges.size;
+    ir_func_t *func = funcs->data[f];
+    for (ir_ref_t ref = 0; ref < func->instrs.size; ref++) {
+      const ir_instr_t *instr = &func->instrs.data[ref];
+      uint32_t callee = instr->op == IR_CALL ? callee_index(inliner, func, instr) : IR_NONE;
+      if (callee != IR_NONE) {
+        uint32_vec_push(&edges, callee);
+      }
+    }
+  }
+  start[n] = edges.size;
+
+  // Tarjan's algorithm, with explicit stacks; components are completed
+  // callees first
+  uint32_t *order = dcc_malloc((n + 1) * sizeof(uint32_t));
+  uint32_t *number = dcc_malloc((n + 1) * sizeof(uint32_t));
+  uint32_t *low = dcc_malloc((n + 1) * sizeof(uint32_t));
+  uint32_t *next = dcc_malloc((n + 1) * sizeof(uint32_t));
+  bool *on_stack = dcc_calloc(n + 1, sizeof(bool));
+  uint32_vec_t stack = uint32_vec_new(), path = uint32_vec_new();
+  uint32_t counter = 0, done = 0, components = 0;
+  for (uint32_t f = 0; f < n; f++) {
+    number[f] = IR_NONE;
+  }
+  for (uint32_t root = 0; root < n; root++) {
+    if (number[root] != IR_NONE) {
+      continue;
+    }
+    number[root] = low[root] = counter++;
+    next[root] = start[root];
+    uint32_vec_push(&stack, root);
+    on_stack[root] = true;
+    uint32_vec_push(&path, root);
+    while (path.size) {
+      uint32_t f = path.data[path.size - 1];
+      if (next[f] < start[f + 1]) {
+        uint32_t g = edges.data[next[f]++];
+        if (number[g] == IR_NONE) {
+          number[g] = low[g] = counter++;
+          next[g] = start[g];
+          uint32_vec_push(&stack, g);
+          on_stack[g] = true;
+          uint32_vec_push(&path, g);
+        } else if (on_stack[g] && number[g] < low[f]) {
+          low[f] = number[g];
+        }
+        continue;
+      }
+      path.size--;
+      if (path.size && low[f] < low[path.data[path.size - 1]]) {
+        low[path.data[path.size - 1]] = low[f];
+      }
+      if (low[f] == number[f]) {
+        uint32_t g;
+        do {
+          g = uint32_vec_pop(&stack);
+          on_stack[g] = false;
+          inliner->components[g] = components;
+          order[done++] = g;
+        } while (g != f);
+        components++;
+      }
+    }
+  }
+
+  free(start);
+  uint32_vec_free(&edges);
+  free(number);
+  free(low);
+  free(next);
+  free(on_stack);
+  uint32_vec_free(&stack);
+  uint32_vec_free(&path);
+  return order;
+}
+
+////
+// Decisions
+
+static bool makes_calls(const ir_func_t *func) {
+  for (ir_ref_t ref = 0; ref < func->instrs.size; ref++) {
+    if (func->instrs.data[ref].op == IR_CALL) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Why a call should not be inlined, or null if it should
+static const char* refusal(const inliner_t *inliner, const ir_func_t *func,
+                           uint32_t caller, const ir_instr_t *call, uint32_t callee) {
+  const ir_func_t *target = inliner->funcs->data[callee];
+  const type_t *type = target->symbol->type;
+  const decl_spec_t *specs = target->symbol->decl.specs;
+  bool is_inline = specs && specs->func_spec == AST_FUNC_SPEC_INLINE;
+  bool is_static = specs && (specs->storage & AST_STORAGE_STATIC);
+  uint32_t size = target->instrs.size;
+  if (inliner->components[callee] == inliner->components[caller]) {
+    return "recursive";
+  } else if (type->func.is_vararg) {
+    return "variadic";
+  } else if (!is_inline && !(is_static && !makes_calls(target))) {
+    return "neither inline nor a static leaf";
+  } else if (size > (is_inline ? INLINE_LIMIT : LEAF_LIMIT)) {
+    return "too large";
+  } else if (func->instrs.size + size > CALLER_LIMIT) {
+    return "caller too large";
+  } else if (target->blocks.data[0].preds.size) {
+    return "entry is a loop header";
+  }
+
+  // the call must pass what the definition takes
+  const type_t *ret = type->func.ret->unqual;
+  uint32_t first = 1 + dcc_type_is_record(ret);
+  if (call->count - first != target->param_count
+      || (!dcc_type_is_record(ret) && dcc_ir_kind(ret) != call->kind)) {
+    return "arguments do not match";
+  }
+  for (uint32_t i = 0; i < target->param_count; i++) {
+    const type_t *param = target->params[i]->unqual, *arg = call->call->args[i]->unqual;
+    if (dcc_type_is_record(param) != dcc_type_is_record(arg)
+        || (dcc_type_is_record(param) ? dcc_type_size(param) != dcc_type_size(arg)
+            : dcc_ir_kind(param) != dcc_ir_kind(arg))) {
+      return "arguments do not match";
+    }
+  }
+  return 0;
+}
+
+////
+// Copying
+
+// Split `block` after `call`, which is dropped, moving the rest of the block
+// and its successors to a new block, which is returned
+static uint32_t split(ir_func_t *func, uint32_t block, ir_ref_t call) {
+  uint32_t after = dcc_ir_block(func);
+  ir_block_t *from = &func->blocks.data[block], *to = &func->blocks.data[after];
+  size_t k = 0;
+  while (from->instrs.data[k] != call) {
+    k++;
+  }
+  for (size_t i = k + 1; i < from->instrs.size; i++) {
+    uint32_vec_push(&to->instrs, from->instrs.data[i]);
+    func->instrs.data[from->instrs.data[i]].block = after;
+  }
+  from->instrs.size = k;
+
+  uint32_vec_t succs = from->succs;
+  from->succs = to->succs;
+  to->succs = succs;
+  for (size_t s = 0; s < succs.size; s++) {
+    uint32_vec_t *preds = &func->blocks.data[succs.data[s]].preds;
+    for (size_t p = 0; p < preds->size; p++) {
+      if (preds->data[p] == block) {
+        preds->data[p] = after;
+      }
+    }
+  }
+  return after;
+}
+
+static ir_ref_t append2(ir_func_t *func, uint32_t block, enum ir_op op, ir_ref_t a,
+                        ir_ref_t b, int64_t imm) {
+  ir_ref_t args[] = { a, b };
+  ir_ref_t ref = dcc_ir_append(func, block, op, IR_VOID, 2, args);
+  func->instrs.data[ref].imm = imm;
+  return ref;
+}
+
+static void inline_call(ir_func_t *func, ir_ref_t ref, const ir_func_t *callee) {
+  ir_instr_t call = func->instrs.data[ref];
+  const type_t *ret = callee->symbol->type->func.ret->unqual;
+  bool sret = dcc_type_is_record(ret);
+  uint32_t block = call.block;
+  uint32_t after = split(func, block, ref);
+
+  // parameters are the arguments, and aggregates are copied, as the callee
+  // may change them
+  ir_ref_t *map = dcc_malloc((callee->instrs.size + 1) * sizeof(ir_ref_t));
+  for (ir_ref_t r = 0; r < callee->instrs.size; r++) {
+    const ir_instr_t *instr = &callee->instrs.data[r];
+    if (instr->op != IR_PARAM) {
+      continue;
+    }
+    const type_t *type = callee->params[instr->imm];
+    ir_ref_t arg = call.args[1 + sret + instr->imm];
+    if (dcc_type_is_record(type->unqual)) {
+      ir_slot_t slot = { dcc_type_size(type), dcc_type_align(type), 0 };
+      ir_slot_vec_push(&func->slots, slot);
+      map[r] = dcc_ir_append(func, block, IR_SLOT, IR_I64, 0, 0);
+      func->instrs.data[map[r]].imm = func->slots.size - 1;
+      append2(func, block, IR_MEMCPY, map[r], arg, slot.size);
+    } else {
+      map[r] = arg;
+    }
+  }
+
+  // copy the blocks and instructions, then map the operands once every
+  // instruction has its number
+  uint32_t base = func->blocks.size, slot_base = func->slots.size;
+  for (size_t b = 0; b < callee->blocks.size; b++) {
+    uint32_t copy = dcc_ir_block(func);
+    const ir_block_t *from = &callee->blocks.data[b];
+    ir_block_t *to = &func->blocks.data[copy];
+    for (size_t k = 0; k < from->preds.size; k++) {
+      uint32_vec_push(&to->preds, base + from->preds.data[k]);
+    }
+    for (size_t k = 0; k < from->succs.size; k++) {
+      uint32_vec_push(&to->succs, base + from->succs.data[k]);
+    }
+  }
+  for (size_t s = 0; s < callee->slots.size; s++) {
+    ir_slot_vec_push(&func->slots, callee->slots.data[s]);
+  }
+  ir_ref_t first = func->instrs.size;
+  uint32_vec_t returns = uint32_vec_new();
+  for (size_t b = 0; b < callee->blocks.size; b++) {
+    const uint32_vec_t *instrs = &callee->blocks.data[b].instrs;
+    for (size_t k = 0; k < instrs->size; k++) {
+      const ir_instr_t *instr = &callee->instrs.data[instrs->data[k]];
+      if (instr->op == IR_PARAM) {
+        continue;
+      } else if (instr->op == IR_RET) {
+        uint32_vec_push(&returns, instrs->data[k]);
+        continue;
+      }
+      ir_ref_t copy = dcc_ir_append(func, base + b, instr->op, instr->kind, instr->count,
+                                    instr->args);
+      ir_instr_t *to = &func->instrs.data[copy];
+      ir_ref_t *args = to->args;
+      *to = *instr;
+      to->block = base + b;
+      to->args = args;
+      if (instr->op == IR_SLOT) {
+        to->imm += slot_base;
+      } else if (instr->op == IR_CALL) {
+        uint32_t count = instr->count - 1 - dcc_type_is_record(instr->call->func->func.ret->unqual);
+        ir_call_t *info = dcc_arena_alloc(&func->arena, sizeof(ir_call_t));
+        info->func = instr->call->func;
+        info->args = dcc_arena_alloc(&func->arena, (count + 1) * sizeof(type_t*));
+        memcpy(info->args, instr->call->args, count * sizeof(type_t*));
+        to->call = info;
+      } else if (instr->op == IR_SWITCH) {
+        ir_table_t *table = dcc_arena_alloc(&func->arena, sizeof(ir_table_t));
+        table->size = instr->table->size;
+        table->succs = dcc_arena_alloc(&func->arena, table->size * sizeof(uint32_t));
+        memcpy(table->succs, instr->table->succs, table->size * sizeof(uint32_t));
+        to->table = table;
+      }
+      map[instrs->data[k]] = copy;
+    }
+  }
+  for (ir_ref_t r = first; r < func->instrs.size; r++) {
+    ir_instr_t *instr = &func->instrs.data[r];
+    for (uint32_t k = 0; k < instr->count; k++) {
+      instr->args[k] = map[instr->args[k]];
+    }
+  }
+
+  // returns go on to the rest of the caller, which takes their values
+  ir_ref_t *values = dcc_malloc((returns.size + 1) * sizeof(ir_ref_t));
+  for (size_t i = 0; i < returns.size; i++) {
+    const ir_instr_t *instr = &callee->instrs.data[returns.data[i]];
+    uint32_t from = base + instr->block;
+    if (sret && instr->count) {
+      append2(func, from, IR_MEMCPY, call.args[1], map[instr->args[0]], dcc_type_size(ret));
+    }
+    if (call.kind != IR_VOID) {
+      values[i] = instr->count ? map[instr->args[0]]
+        : dcc_ir_append(func, from, IR_UNDEF, call.kind, 0, 0);
+    }
+    dcc_ir_append(func, from, IR_JMP, IR_VOID, 0, 0);
+    dcc_ir_edge(func, from, after);
+  }
+  dcc_ir_append(func, block, IR_JMP, IR_VOID, 0, 0);
+  dcc_ir_edge(func, block, base);
+
+  if (call.kind != IR_VOID) {
+    ir_ref_t result = returns.size == 1 ? values[0]
+      : returns.size ? dcc_ir_insert(func, after, 0, IR_PHI, call.kind, returns.size, values)
+      : dcc_ir_insert(func, after, 0, IR_UNDEF, call.kind, 0, 0);
+    for (ir_ref_t r = 0; r < func->instrs.size; r++) {
+      ir_instr_t *instr = &func->instrs.data[r];
+      for (uint32_t k = 0; k < instr->count; k++) {
+        if (instr->args[k] == ref) {
+          instr->args[k] = result;
+        }
+      }
+    }
+  }
+  func->instrs.data[ref].op = IR_NOP;
+  func->instrs.data[ref].count = 0;
+
+  free(map);
+  free(values);
+  uint32_vec_free(&returns);
+}
+
+void dcc_inline(ir_func_vec_t *funcs, FILE *report) {
+  inliner_t inliner = { funcs, dcc_ptrmap_new(), dcc_malloc((funcs->size + 1) * sizeof(uint32_t)),
+                        report };
+  for (size_t f = 0; f < funcs->size; f++) {
+    dcc_ptrmap_put(&inliner.indices, funcs->data[f]->symbol->name, (void*)(uintptr_t)(f + 1));
+  }
+  uint32_t *order = bottom_up(&inliner);
+
+  uint32_vec_t calls = uint32_vec_new();
+  for (size_t i = 0; i < funcs->size; i++) {
+    uint32_t caller = order[i];
+    ir_func_t *func = funcs->data[caller];
+    // only the calls the function makes itself; those it gains were declined
+    // by its callees
+    calls.size = 0;
+    for (ir_ref_t ref = 0; ref < func->instrs.size; ref++) {
+      if (func->instrs.data[ref].op == IR_CALL) {
+        uint32_vec_push(&calls, ref);
+      }
+    }
+    bool changed = false;
+    for (size_t c = 0; c < calls.size; c++) {
+      const ir_instr_t *call = &func->instrs.data[calls.data[c]];
+      uint32_t callee = callee_index(&inliner, func, call);
+      if (callee == IR_NONE) {
+        continue;
+      }
+      const ir_func_t *target = funcs->data[callee];
+      const char *reason = refusal(&inliner, func, caller, call, callee);
+      if (report) {
+        fprintf(report, "%s: %s %s (%zu instructions)%s%s\n", func->symbol->name->str,
+                reason ? "not inlining" : "inlined", target->symbol->name->str,
+                target->instrs.size, reason ? ": " : "", reason ? reason : "");
+      }
+      if (!reason) {
+        inline_call(func, calls.data[c], target);
+        changed = true;
+      }
+    }
+    if (changed) {
+      dcc_ir_compact(func);
+      dcc_ir_dominators(func);
+      dcc_ir_verify(func);
+    }
+  }
+
+  uint32_vec_free(&calls);
+  free(order);
+  free(inliner.components);
+  dcc_ptrmap_free(&inliner.indices);
+}
@@ -0,0 +1,37 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Inlining over the IR. Functions are visited bottom-up over the call graph,
+  whose strongly connected components come from Tarjan's algorithm, so each
+  callee has had its own calls inlined before it is measured and copied.
+  Calls within a component, which may recurse, are never inlined. A direct
+  call is inlined if the callee is declared `inline` and is small, or is a
+  static leaf and smaller still, while the caller stays under a budget.
+*/
+
+#pragma once
+
+#include <stdio.h>
+
+#include "ir.h"
+
+// Inline calls between the functions of one unit, leaving each compacted and
+// in SSA form. Every decision about a direct call to a function of the unit
+// is reported to `report` if it is not null.
+void dcc_inline(ir_func_vec_t *funcs, FILE *report);
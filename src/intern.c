@@ -0,0 +1,102 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <string.h>
+
+#include "dcc.h"
+#include "intern.h"
+
+// Names are carved out of large chunks rather than malloc'd one by one; they
+// are never freed.
+#define CHUNK_SIZE (64 * 1024)
+
+static struct {
+  const name_t **slots;
+  size_t size, capacity; // capacity is a power of two
+  char *chunk;
+  size_t chunk_left;
+} table;
+
+static uint32_t hash_bytes(const char *str, size_t len) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (unsigned char)str[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static name_t* alloc_name(size_t len) {
+  size_t size = (sizeof(name_t) + len + 1 + 7) & ~(size_t)7;
+  if (size > CHUNK_SIZE / 4) {
+    return dcc_malloc(size);
+  }
+  if (size > table.chunk_left) {
+    table.chunk = dcc_malloc(CHUNK_SIZE);
+    table.chunk_left = CHUNK_SIZE;
+  }
+  name_t *name = (name_t*)table.chunk;
+  table.chunk += size;
+  table.chunk_left -= size;
+  return name;
+}
+
+static void grow_table() {
+  size_t capacity = table.capacity ? table.capacity * 2 : 1024;
+  const name_t **slots = dcc_calloc(capacity, sizeof *slots);
+  for (size_t i = 0; i < table.capacity; i++) {
+    const name_t *name = table.slots[i];
+    if (!name) {
+      continue;
+    }
+    size_t j = name->hash & (capacity - 1);
+    while (slots[j]) {
+      j = (j + 1) & (capacity - 1);
+    }
+    slots[j] = name;
+  }
+  free(table.slots);
+  table.slots = slots;
+  table.capacity = capacity;
+}
+
+const name_t* dcc_intern(const char *str, size_t len) {
+  // keep load factor below 1/2 so probe sequences stay short
+  if ((table.size + 1) * 2 > table.capacity) {
+    grow_table();
+  }
+
+  uint32_t hash = hash_bytes(str, len);
+  size_t i = hash & (table.capacity - 1);
+  for (const name_t *name; (name = table.slots[i]); i = (i + 1) & (table.capacity - 1)) {
+    if (name->hash == hash && name->len == len && memcmp(name->str, str, len) == 0) {
+      return name;
+    }
+  }
+
+  name_t *name = alloc_name(len);
+  name->hash = hash;
+  name->len = len;
+  memcpy(name->str, str, len);
+  name->str[len] = 0;
+
+  table.slots[i] = name;
+  table.size++;
+  return name;
+}
@@ -0,0 +1,35 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Identifier interning. Every distinct spelling maps to exactly one name_t, so
+  names outlive the token buffer and compare by pointer.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct name {
+  uint32_t hash;
+  uint32_t len;
+  char str[]; // null terminated
+} name_t;
+
+const name_t* dcc_intern(const char *str, size_t len);
@@ -0,0 +1,585 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "ir.h"
+
+DEFINE_VEC2(ir_instr_t, ir_instr_vec);
+DEFINE_VEC2(ir_slot_t, ir_slot_vec);
+DEFINE_VEC2(ir_var_t, ir_var_vec);
+DEFINE_VEC2(ir_func_ptr_t, ir_func_vec);
+
+static void free_block(ir_block_t *block) {
+  uint32_vec_free(&block->instrs);
+  uint32_vec_free(&block->preds);
+  uint32_vec_free(&block->succs);
+}
+DEFINE_VEC3(ir_block_t, ir_block_vec, free_block);
+
+ir_func_t* dcc_ir_func_new(symbol_t *symbol) {
+  ir_func_t *func = dcc_calloc(1, sizeof(ir_func_t));
+  func->symbol = symbol;
+  func->arena = dcc_arena_new();
+  return func;
+}
+
+void dcc_ir_func_free(ir_func_t *func) {
+  dcc_arena_free(&func->arena);
+  ir_instr_vec_free(&func->instrs);
+  ir_block_vec_free(&func->blocks);
+  ir_slot_vec_free(&func->slots);
+  ir_var_vec_free(&func->vars);
+  free(func->use_start);
+  free(func->uses);
+  free(func);
+}
+
+ir_kind_t dcc_ir_kind(const type_t *type) {
+  switch (type->tag) {
+  case TYPE_VOID:
+    return IR_VOID;
+  case TYPE_FLOAT:
+    return IR_F32;
+  case TYPE_DOUBLE:
+  case TYPE_LDOUBLE:
+    return IR_F64;
+  case TYPE_BOOL:
+  case TYPE_CHAR:
+  case TYPE_SCHAR:
+  case TYPE_UCHAR:
+  case TYPE_SHORT:
+  case TYPE_USHORT:
+  case TYPE_INT:
+  case TYPE_UINT:
+  case TYPE_ENUM:
+    switch (dcc_type_size(type)) {
+    case 1: return IR_I8;
+    case 2: return IR_I16;
+    case 4: return IR_I32;
+    }
+    return IR_I64;
+  default:
+    return IR_I64;
+  }
+}
+
+bool dcc_ir_is_vector(ir_kind_t kind) {
+  return kind >= IR_V16I8;
+}
+
+ir_kind_t dcc_ir_lane(ir_kind_t kind) {
+  return kind - IR_V16I8 + IR_I8;
+}
+
+ir_kind_t dcc_ir_vector(ir_kind_t kind) {
+  return kind - IR_I8 + IR_V16I8;
+}
+
+static uint8_t kind_bits(ir_kind_t kind) {
+  switch (kind) {
+  case IR_I8: return 8;
+  case IR_I16: return 16;
+  case IR_I32: return 32;
+  default: return 64;
+  }
+}
+
+// A value of a kind, as a signed number
+static int64_t normalize(ir_kind_t kind, uint64_t value) {
+  switch (kind) {
+  case IR_I8: return (int8_t)value;
+  case IR_I16: return (int16_t)value;
+  case IR_I32: return (int32_t)value;
+  default: return (int64_t)value;
+  }
+}
+
+bool dcc_ir_constant_value(const ir_func_t *func, ir_ref_t ref, int64_t *value) {
+  const ir_instr_t *instr = &func->instrs.data[ref];
+  int64_t a, b;
+  if (instr->op == IR_CONST) {
+    *value = normalize(instr->kind, instr->imm);
+    return true;
+  } else if (instr->op < IR_ADD || instr->op > IR_FCONV || instr->count < 1
+             || !dcc_ir_constant_value(func, instr->args[0], &a)) {
+    return false;
+  } else if (instr->count > 1 && !dcc_ir_constant_value(func, instr->args[1], &b)) {
+    return false;
+  }
+  uint64_t x = a, y = b;
+  switch (instr->op) {
+  case IR_ADD: *value = normalize(instr->kind, x + y); return true;
+  case IR_SUB: *value = normalize(instr->kind, x - y); return true;
+  case IR_MUL: *value = normalize(instr->kind, x * y); return true;
+  case IR_SHL: *value = normalize(instr->kind, x << (y & 63)); return true;
+  case IR_SEXT:
+  case IR_TRUNC: *value = normalize(instr->kind, x); return true;
+  case IR_ZEXT: {
+    uint8_t bits = kind_bits(func->instrs.data[instr->args[0]].kind);
+    *value = bits == 64 ? a : (int64_t)(x & ((UINT64_C(1) << bits) - 1));
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+////
+// Building
+
+uint32_t dcc_ir_block(ir_func_t *func) {
+  ir_block_t block = { uint32_vec_new(), uint32_vec_new(), uint32_vec_new(),
+                       IR_NONE, 0, 0 };
+  ir_block_vec_push(&func->blocks, block);
+  return func->blocks.size - 1;
+}
+
+void dcc_ir_edge(ir_func_t *func, uint32_t from, uint32_t to) {
+  uint32_vec_push(&func->blocks.data[from].succs, to);
+  uint32_vec_push(&func->blocks.data[to].preds, from);
+}
+
+static ir_ref_t new_instr(ir_func_t *func, uint32_t block, enum ir_op op, ir_kind_t kind,
+                          uint32_t count, const ir_ref_t *args) {
+  ir_instr_t instr = { op, kind, 0, block, count, 0, { 0 } };
+  if (count) {
+    instr.args = dcc_arena_alloc(&func->arena, count * sizeof(ir_ref_t));
+    if (args) {
+      memcpy(instr.args, args, count * sizeof(ir_ref_t));
+    }
+  }
+  ir_instr_vec_push(&func->instrs, instr);
+  return func->instrs.size - 1;
+}
+
+ir_ref_t dcc_ir_append(ir_func_t *func, uint32_t block, enum ir_op op, ir_kind_t kind,
+                       uint32_t count, const ir_ref_t *args) {
+  ir_ref_t ref = new_instr(func, block, op, kind, count, args);
+  uint32_vec_push(&func->blocks.data[block].instrs, ref);
+  return ref;
+}
+
+ir_ref_t dcc_ir_insert(ir_func_t *func, uint32_t block, uint32_t position, enum ir_op op,
+                       ir_kind_t kind, uint32_t count, const ir_ref_t *args) {
+  ir_ref_t ref = new_instr(func, block, op, kind, count, args);
+  uint32_vec_t *instrs = &func->blocks.data[block].instrs;
+  dcc_assert(position <= instrs->size);
+  uint32_vec_push(instrs, ref);
+  memmove(&instrs->data[position + 1], &instrs->data[position],
+          (instrs->size - 1 - position) * sizeof(uint32_t));
+  instrs->data[position] = ref;
+  return ref;
+}
+
+bool dcc_ir_is_terminator(enum ir_op op) {
+  return op == IR_JMP || op == IR_BR || op == IR_RET || op == IR_SWITCH;
+}
+
+ir_ref_t dcc_ir_terminator(const ir_func_t *func, uint32_t block) {
+  const uint32_vec_t *instrs = &func->blocks.data[block].instrs;
+  if (instrs->size == 0) {
+    return IR_NONE;
+  }
+  ir_ref_t last = instrs->data[instrs->size - 1];
+  return dcc_ir_is_terminator(func->instrs.data[last].op) ? last : IR_NONE;
+}
+
+////
+// Compaction
+
+// Blocks reachable from the entry, in reverse postorder
+static uint32_t* reverse_postorder(const ir_func_t *func, uint32_t *count) {
+  size_t n = func->blocks.size;
+  uint32_t *order = dcc_malloc(n * sizeof(uint32_t));
+  uint32_t *stack = dcc_malloc(n * sizeof(uint32_t));
+  uint32_t *next_succ = dcc_calloc(n, sizeof(uint32_t));
+  bool *seen = dcc_calloc(n, sizeof(bool));
+
+  // an explicit stack, since deep nests of loops would blow the C one
+  uint32_t done = 0, depth = 0;
+  stack[depth++] = 0;
+  seen[0] = true;
+  while (depth) {
+    uint32_t block = stack[depth - 1];
+    const uint32_vec_t *succs = &func->blocks.data[block].succs;
+    if (next_succ[block] < succs->size) {
+      uint32_t succ = succs->data[next_succ[block]++];
+      if (!seen[succ]) {
+        seen[succ] = true;
+        stack[depth++] = succ;
+      }
+    } else {
+      order[done++] = block;
+      depth--;
+    }
+  }
+  for (uint32_t i = 0; i < done / 2; i++) {
+    uint32_t t = order[i];
+    order[i] = order[done - 1 - i];
+    order[done - 1 - i] = t;
+  }
+
+  free(stack);
+  free(next_succ);
+  free(seen);
+  *count = done;
+  return order;
+}
+
+void dcc_ir_compact(ir_func_t *func) {
+  uint32_t count;
+  uint32_t *order = reverse_postorder(func, &count);
+  uint32_t *block_map = dcc_malloc(func->blocks.size * sizeof(uint32_t));
+  for (size_t i = 0; i < func->blocks.size; i++) {
+    block_map[i] = IR_NONE;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    block_map[order[i]] = i;
+  }
+
+  // drop edges from unreachable blocks, and the phi operands that go with them
+  for (uint32_t i = 0; i < count; i++) {
+    ir_block_t *block = &func->blocks.data[order[i]];
+    uint32_t kept = 0;
+    for (size_t p = 0; p < block->preds.size; p++) {
+      if (block_map[block->preds.data[p]] == IR_NONE) {
+        continue;
+      }
+      for (size_t k = 0; k < block->instrs.size; k++) {
+        ir_instr_t *instr = &func->instrs.data[block->instrs.data[k]];
+        if (instr->op == IR_PHI) {
+          instr->args[kept] = instr->args[p];
+        }
+      }
+      block->preds.data[kept++] = block->preds.data[p];
+    }
+    if (kept != block->preds.size) {
+      for (size_t k = 0; k < block->instrs.size; k++) {
+        ir_instr_t *instr = &func->instrs.data[block->instrs.data[k]];
+        if (instr->op == IR_PHI) {
+          instr->count = kept;
+        }
+      }
+      block->preds.size = kept;
+    }
+  }
+
+  // number the surviving instructions in block order
+  uint32_t *instr_map = dcc_malloc(func->instrs.size * sizeof(uint32_t));
+  for (size_t i = 0; i < func->instrs.size; i++) {
+    instr_map[i] = IR_NONE;
+  }
+  ir_instr_vec_t instrs = ir_instr_vec_new();
+  for (uint32_t i = 0; i < count; i++) {
+    ir_block_t *block = &func->blocks.data[order[i]];
+    uint32_t kept = 0;
+    for (size_t k = 0; k < block->instrs.size; k++) {
+      ir_ref_t ref = block->instrs.data[k];
+      ir_instr_t instr = func->instrs.data[ref];
+      if (instr.op == IR_NOP) {
+        continue;
+      }
+      instr.block = i;
+      instr_map[ref] = instrs.size;
+      block->instrs.data[kept++] = instrs.size;
+      ir_instr_vec_push(&instrs, instr);
+    }
+    block->instrs.size = kept;
+  }
+  for (size_t i = 0; i < instrs.size; i++) {
+    ir_instr_t *instr = &instrs.data[i];
+    for (uint32_t k = 0; k < instr->count; k++) {
+      instr->args[k] = instr_map[instr->args[k]];
+      dcc_assert(instr->args[k] != IR_NONE);
+    }
+  }
+  ir_instr_vec_free(&func->instrs);
+  func->instrs = instrs;
+
+  ir_block_vec_t blocks = ir_block_vec_new();
+  for (uint32_t i = 0; i < count; i++) {
+    ir_block_t block = func->blocks.data[order[i]];
+    for (size_t k = 0; k < block.preds.size; k++) {
+      block.preds.data[k] = block_map[block.preds.data[k]];
+    }
+    for (size_t k = 0; k < block.succs.size; k++) {
+      block.succs.data[k] = block_map[block.succs.data[k]];
+    }
+    ir_block_vec_push(&blocks, block);
+    func->blocks.data[order[i]] = (ir_block_t){ { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 }, 0, 0, 0 };
+  }
+  ir_block_vec_free(&func->blocks);
+  func->blocks = blocks;
+
+  free(order);
+  free(block_map);
+  free(instr_map);
+  // use lists name the old instructions
+  free(func->use_start);
+  free(func->uses);
+  func->use_start = 0;
+  func->uses = 0;
+}
+
+////
+// Uses
+
+void dcc_ir_uses(ir_func_t *func) {
+  size_t n = func->instrs.size;
+  free(func->use_start);
+  free(func->uses);
+  func->use_start = dcc_calloc(n + 1, sizeof(uint32_t));
+
+  // count, prefix sum, then fill from the back so each list ends up in order
+  for (size_t i = 0; i < n; i++) {
+    const ir_instr_t *instr = &func->instrs.data[i];
+    for (uint32_t k = 0; k < instr->count; k++) {
+      func->use_start[instr->args[k] + 1]++;
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    func->use_start[i + 1] += func->use_start[i];
+  }
+  func->uses = dcc_malloc((func->use_start[n] + 1) * sizeof(ir_use_t));
+  uint32_t *fill = dcc_malloc((n + 1) * sizeof(uint32_t));
+  memcpy(fill, func->use_start, (n + 1) * sizeof(uint32_t));
+  for (size_t i = 0; i < n; i++) {
+    const ir_instr_t *instr = &func->instrs.data[i];
+    for (uint32_t k = 0; k < instr->count; k++) {
+      ir_use_t use = { i, k };
+      func->uses[fill[instr->args[k]]++] = use;
+    }
+  }
+  free(fill);
+}
+
+void dcc_ir_replace(ir_func_t *func, ir_ref_t from, ir_ref_t to) {
+  if (func->use_start) {
+    for (uint32_t u = func->use_start[from]; u < func->use_start[from + 1]; u++) {
+      ir_use_t use = func->uses[u];
+      func->instrs.data[use.user].args[use.index] = to;
+    }
+    return;
+  }
+  for (size_t i = 0; i < func->instrs.size; i++) {
+    ir_instr_t *instr = &func->instrs.data[i];
+    for (uint32_t k = 0; k < instr->count; k++) {
+      if (instr->args[k] == from) {
+        instr->args[k] = to;
+      }
+    }
+  }
+}
+
+////
+// Printing
+
+static const char *OP_STRINGS[] = {
+  "nop", "undef", "const", "fconst", "param", "global", "string", "slot", "varargs",
+  "add", "sub", "mul", "sdiv", "udiv", "srem", "urem", "and", "or", "xor",
+  "shl", "sar", "shr", "neg", "not", "fadd", "fsub", "fmul", "fdiv", "fneg",
+  "eq", "ne", "slt", "sle", "sgt", "sge", "ult", "ule", "ugt", "uge",
+  "feq", "fne", "flt", "fle", "fgt", "fge",
+  "sext", "zext", "trunc", "sitof", "uitof", "ftosi", "ftoui", "fconv",
+  "splat",
+  "load", "store", "memcpy", "memzero", "call", "phi", "get", "set",
+  "jmp", "br", "ret", "switch",
+};
+
+static const char *KIND_STRINGS[] = {
+  "void", "i8", "i16", "i32", "i64", "f32", "f64",
+  "v16i8", "v8i16", "v4i32", "v2i64", "v4f32", "v2f64",
+};
+
+const char* dcc_ir_op_str(enum ir_op op) {
+  if (op >= sizeof(OP_STRINGS) / sizeof(char*)) {
+    dcc_ice("invalid ir op %d\n", op);
+  }
+  return OP_STRINGS[op];
+}
+
+void dcc_ir_print(FILE *file, const ir_func_t *func) {
+  fprintf(file, "function %s:\n", func->symbol->name->str);
+  for (size_t i = 0; i < func->slots.size; i++) {
+    const ir_slot_t *slot = &func->slots.data[i];
+    fprintf(file, "  slot %zu: %" PRIu64 " bytes, align %u", i, slot->size, slot->align);
+    if (slot->symbol) {
+      fprintf(file, " (%s)", slot->symbol->name->str);
+    }
+    fputc('\n', file);
+  }
+
+  for (size_t b = 0; b < func->blocks.size; b++) {
+    const ir_block_t *block = &func->blocks.data[b];
+    fprintf(file, "b%zu:", b);
+    if (block->preds.size) {
+      fprintf(file, " ; preds");
+      for (size_t k = 0; k < block->preds.size; k++) {
+        fprintf(file, " b%u", block->preds.data[k]);
+      }
+    }
+    fputc('\n', file);
+
+    for (size_t k = 0; k < block->instrs.size; k++) {
+      ir_ref_t ref = block->instrs.data[k];
+      const ir_instr_t *instr = &func->instrs.data[ref];
+      fprintf(file, "  ");
+      if (instr->kind != IR_VOID) {
+        fprintf(file, "%%%u = %s ", ref, KIND_STRINGS[instr->kind]);
+      }
+      fprintf(file, "%s", dcc_ir_op_str(instr->op));
+      if (instr->flags & IR_VOLATILE) {
+        fprintf(file, " volatile");
+      }
+      if (instr->flags & IR_REGISTER) {
+        fprintf(file, " register");
+      }
+      if (instr->flags & IR_NO_WRAP) {
+        fprintf(file, " nowrap");
+      }
+      if (instr->flags & IR_ANY_TYPE) {
+        fprintf(file, " anytype");
+      }
+
+      switch (instr->op) {
+      case IR_CONST:
+      case IR_PARAM:
+      case IR_SLOT:
+      case IR_VARARGS:
+      case IR_MEMCPY:
+      case IR_MEMZERO:
+      case IR_GET:
+      case IR_SET:
+        fprintf(file, " %" PRId64, instr->imm);
+        break;
+      case IR_FCONST:
+        fprintf(file, " %g", instr->fimm);
+        break;
+      case IR_GLOBAL:
+        fprintf(file, " @%s", instr->symbol->name->str);
+        break;
+      case IR_STRING: {
+        size_t size;
+        const char *bytes = dcc_strlit_bytes(instr->string, &size);
+        fputs(" \"", file);
+        for (size_t c = 0; c + 1 < size && c < 24; c++) {
+          unsigned char ch = bytes[c];
+          fprintf(file, ch >= ' ' && ch < 127 && ch != '"' && ch != '\\' ? "%c" : "\\%03o", ch);
+        }
+        fputs(size > 25 ? "...\"" : "\"", file);
+        break;
+      }
+      case IR_SWITCH:
+        fputs(" [", file);
+        for (uint32_t e = 0; e < instr->table->size; e++) {
+          fprintf(file, "%sb%u", e ? " " : "", block->succs.data[instr->table->succs[e]]);
+        }
+        fputc(']', file);
+        break;
+      default:
+        break;
+      }
+
+      for (uint32_t a = 0; a < instr->count; a++) {
+        fprintf(file, "%s%%%u", a ? ", " : " ", instr->args[a]);
+        if (instr->op == IR_PHI) {
+          fprintf(file, " b%u", block->preds.data[a]);
+        }
+      }
+      for (size_t s = 0; s < block->succs.size && instr->op != IR_PHI &&
+             dcc_ir_is_terminator(instr->op); s++) {
+        fprintf(file, "%sb%u", s || instr->count ? ", " : " ", block->succs.data[s]);
+      }
+      fputc('\n', file);
+    }
+  }
+}
+
+////
+// Verification
+
+static bool dominates(const ir_func_t *func, uint32_t a, uint32_t b) {
+  const ir_block_t *x = &func->blocks.data[a], *y = &func->blocks.data[b];
+  return x->dom_enter <= y->dom_enter && y->dom_exit <= x->dom_exit;
+}
+
+#define CHECK(cond, ...) if (!(cond)) { dcc_ice(__VA_ARGS__); }
+
+void dcc_ir_verify(const ir_func_t *func) {
+  const char *name = func->symbol->name->str;
+  // the position of each instruction within its block
+  uint32_t *position = dcc_malloc((func->instrs.size + 1) * sizeof(uint32_t));
+  for (size_t b = 0; b < func->blocks.size; b++) {
+    const ir_block_t *block = &func->blocks.data[b];
+    for (size_t k = 0; k < block->instrs.size; k++) {
+      ir_ref_t ref = block->instrs.data[k];
+      CHECK(func->instrs.data[ref].block == b, "%s: %%%u is not in b%zu\n", name, ref, b);
+      position[ref] = k;
+    }
+  }
+
+  for (size_t b = 0; b < func->blocks.size; b++) {
+    const ir_block_t *block = &func->blocks.data[b];
+    CHECK(block->instrs.size, "%s: b%zu is empty\n", name, b);
+    bool phis = true;
+    for (size_t k = 0; k < block->instrs.size; k++) {
+      ir_ref_t ref = block->instrs.data[k];
+      const ir_instr_t *instr = &func->instrs.data[ref];
+      bool last = k + 1 == block->instrs.size;
+      CHECK(instr->op != IR_NOP && instr->op != IR_GET && instr->op != IR_SET,
+            "%s: %%%u is a %s\n", name, ref, dcc_ir_op_str(instr->op));
+      CHECK(dcc_ir_is_terminator(instr->op) == last,
+            "%s: misplaced terminator around %%%u\n", name, ref);
+      if (instr->op == IR_PHI) {
+        CHECK(phis, "%s: phi %%%u after other instructions\n", name, ref);
+        CHECK(instr->count == block->preds.size, "%s: phi %%%u has %u operands\n",
+              name, ref, instr->count);
+      } else {
+        phis = false;
+      }
+
+      for (uint32_t a = 0; a < instr->count; a++) {
+        ir_ref_t arg = instr->args[a];
+        CHECK(arg < func->instrs.size && func->instrs.data[arg].kind != IR_VOID,
+              "%s: %%%u uses %%%u, which is not a value\n", name, ref, arg);
+        uint32_t def = func->instrs.data[arg].block;
+        uint32_t use = instr->op == IR_PHI ? block->preds.data[a] : b;
+        bool ok = def == use && instr->op != IR_PHI
+          ? position[arg] < k : dominates(func, def, use);
+        CHECK(ok, "%s: %%%u does not dominate its use in %%%u\n", name, arg, ref);
+      }
+    }
+
+    ir_ref_t term = block->instrs.data[block->instrs.size - 1];
+    enum ir_op op = func->instrs.data[term].op;
+    if (op == IR_SWITCH) {
+      const ir_table_t *table = func->instrs.data[term].table;
+      CHECK(block->succs.size, "%s: b%zu has no successors\n", name, b);
+      for (uint32_t e = 0; e < table->size; e++) {
+        CHECK(table->succs[e] < block->succs.size, "%s: b%zu has no successor %u\n",
+              name, b, table->succs[e]);
+      }
+    } else {
+      size_t succs = op == IR_JMP ? 1 : op == IR_BR ? 2 : 0;
+      CHECK(block->succs.size == succs, "%s: b%zu has %zu successors\n",
+            name, b, block->succs.size);
+    }
+  }
+  free(position);
+}
@@ -0,0 +1,281 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+  The intermediate representation. Each function definition becomes a control
+  flow graph of blocks in SSA form over one array of instructions. An
+  instruction is named by its index in that array, which is also the name of
+  the value it defines, so operands are plain 32-bit references. Blocks list
+  their instructions in order, and dcc_ir_compact() renumbers everything so
+  that blocks are in reverse postorder and each block's instructions are
+  adjacent; passes then walk memory front to back. Operand lists and other
+  small parts are carved out of an arena owned by the function.
+
+  Aggregates are never values: an expression of struct or union type is
+  represented by the address of its storage, and instructions copy them.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "arena.h"
+#include "sema.h"
+#include "type.h"
+#include "vec_types.h"
+
+typedef uint32_t ir_ref_t; // an instruction, and the value it defines
+
+#define IR_NONE UINT32_MAX
+
+typedef enum ir_kind {
+  IR_VOID,
+  IR_I8,
+  IR_I16,
+  IR_I32,
+  IR_I64, // and pointers
+  IR_F32,
+  IR_F64, // and long double, which is not told apart
+  // 16-byte vectors of lanes of each scalar kind, made by the vectorizer
+  IR_V16I8,
+  IR_V8I16,
+  IR_V4I32,
+  IR_V2I64,
+  IR_V4F32,
+  IR_V2F64,
+} ir_kind_t;
+
+enum ir_op {
+  IR_NOP, // left by passes that delete, until dcc_ir_compact()
+
+  IR_UNDEF,
+  IR_CONST, // imm
+  IR_FCONST, // fimm
+  IR_PARAM, // the imm'th parameter, or the address of it if an aggregate
+  IR_GLOBAL, // address of `symbol`
+  IR_STRING, // address of `string`
+  IR_SLOT, // address of the imm'th stack slot
+  IR_VARARGS, // what va_start sets a field of a va_list to, by imm; see IR_VA_GP
+
+  // integer arithmetic, with operands of the instruction's kind, lane by lane
+  // on vectors, where a shift count is the splat of a constant
+  IR_ADD,
+  IR_SUB,
+  IR_MUL,
+  IR_SDIV,
+  IR_UDIV,
+  IR_SREM,
+  IR_UREM,
+  IR_AND,
+  IR_OR,
+  IR_XOR,
+  IR_SHL,
+  IR_SAR,
+  IR_SHR,
+  IR_NEG,
+  IR_NOT,
+  IR_FADD,
+  IR_FSUB,
+  IR_FMUL,
+  IR_FDIV,
+  IR_FNEG,
+
+  // comparisons of two operands of one kind, giving an IR_I32 0 or 1
+  IR_EQ,
+  IR_NE,
+  IR_SLT,
+  IR_SLE,
+  IR_SGT,
+  IR_SGE,
+  IR_ULT,
+  IR_ULE,
+  IR_UGT,
+  IR_UGE,
+  IR_FEQ,
+  IR_FNE, // true if unordered
+  IR_FLT,
+  IR_FLE,
+  IR_FGT,
+  IR_FGE,
+
+  // conversions from the operand's kind to the instruction's
+  IR_SEXT,
+  IR_ZEXT,
+  IR_TRUNC,
+  IR_SITOF,
+  IR_UITOF,
+  IR_FTOSI,
+  IR_FTOUI,
+  IR_FCONV,
+  IR_SPLAT, // to a vector with the operand in every lane
+
+  IR_LOAD, // from args[0]
+  IR_STORE, // args[1] to args[0]
+  IR_MEMCPY, // imm bytes from args[1] to args[0]
+  IR_MEMZERO, // imm bytes at args[0]
+  // args[0] is the callee and the rest are its arguments, but if the callee
+  // returns an aggregate args[1] is the address that receives it
+  IR_CALL,
+  IR_PHI, // an operand for each predecessor of its block, in order
+
+  // variables, which only exist until dcc_ir_ssa() builds SSA form
+  IR_GET, // the imm'th variable
+  IR_SET, // args[0] to the imm'th variable
+
+  // terminators, which end every block and jump to its successors
+  IR_JMP,
+  IR_BR, // to the first successor if args[0] is nonzero, else the second
+  IR_RET, // args[0], if any, or the address of an aggregate
+  // to the successor table->succs[args[0]] if args[0] is below table->size,
+  // compared unsigned, else the first
+  IR_SWITCH,
+
+  IR_OP_COUNT,
+};
+
+// The fields of a va_list, which only the back end knows the values of on
+// entry: how far into the saved argument registers the general and vector
+// arguments past the named ones begin, where the arguments on the stack past
+// them are, and where the registers are saved
+#define IR_VA_GP 0
+#define IR_VA_FP 4
+#define IR_VA_STACK 8
+#define IR_VA_SAVE_AREA 16
+#define IR_VA_LIST_SIZE 24
+
+#define IR_VOLATILE 1 // flag of a load or store
+#define IR_REGISTER 2 // flag of a value or variable declared `register`
+#define IR_NO_WRAP 4 // flag of signed arithmetic, which may assume no overflow
+// flag of a load or store through a union member or of a bit-field's storage
+// unit, which may share memory with an object of any type
+#define IR_ANY_TYPE 8
+
+typedef struct {
+  const type_t *func; // the callee's type
+  const type_t **args; // the type of each argument, after promotion
+} ir_call_t;
+
+// The entries of an IR_SWITCH, as indexes into its block's successors
+typedef struct {
+  uint32_t size;
+  uint32_t *succs;
+} ir_table_t;
+
+typedef struct {
+  uint8_t op; // enum ir_op
+  uint8_t kind; // of the value defined, IR_VOID if none
+  uint16_t flags;
+  uint32_t block;
+  uint32_t count;
+  ir_ref_t *args; // `count` operands
+  union {
+    int64_t imm;
+    double fimm;
+    symbol_t *symbol;
+    strlit_t *string;
+    ir_call_t *call;
+    ir_table_t *table;
+  };
+} ir_instr_t;
+DECLARE_VEC(ir_instr_t, ir_instr_vec);
+
+typedef struct {
+  uint32_vec_t instrs; // in order, ending with a terminator
+  uint32_vec_t preds, succs;
+  // set by dcc_ir_dominators(): the immediate dominator, which is the entry
+  // block itself for the entry, and the interval of the block's subtree in a
+  // preorder walk of the dominator tree
+  uint32_t idom, dom_enter, dom_exit;
+} ir_block_t;
+DECLARE_VEC(ir_block_t, ir_block_vec);
+
+typedef struct {
+  uint64_t size;
+  uint32_t align;
+  symbol_t *symbol; // null for a temporary
+} ir_slot_t;
+DECLARE_VEC(ir_slot_t, ir_slot_vec);
+
+typedef struct {
+  uint8_t kind; // of its values
+  uint16_t flags;
+} ir_var_t;
+DECLARE_VEC(ir_var_t, ir_var_vec);
+
+typedef struct {
+  ir_ref_t user;
+  uint32_t index; // of the operand
+} ir_use_t;
+
+typedef struct ir_func {
+  symbol_t *symbol;
+  arena_t arena;
+  ir_instr_vec_t instrs;
+  ir_block_vec_t blocks; // the first is the entry
+  ir_slot_vec_t slots;
+  const type_t **params; // the type of each IR_PARAM, by index
+  uint32_t param_count;
+  ir_var_vec_t vars;
+  // set by dcc_ir_uses(): the uses of v are uses[use_start[v]] up to
+  // uses[use_start[v + 1]]
+  uint32_t *use_start;
+  ir_use_t *uses;
+} ir_func_t;
+
+typedef ir_func_t* ir_func_ptr_t;
+DECLARE_VEC(ir_func_ptr_t, ir_func_vec);
+
+ir_func_t* dcc_ir_func_new(symbol_t *symbol);
+void dcc_ir_func_free(ir_func_t *func);
+
+// The kind of a value of the scalar `type`; IR_I64, the kind of an address,
+// for aggregates and functions
+ir_kind_t dcc_ir_kind(const type_t *type);
+bool dcc_ir_is_vector(ir_kind_t kind);
+// The kind of the lanes of a vector, and the vector of a scalar kind
+ir_kind_t dcc_ir_lane(ir_kind_t kind);
+ir_kind_t dcc_ir_vector(ir_kind_t kind);
+// The value of arithmetic on constants, such as the `(long)1 * 4` lowering
+// leaves as the step of a pointer
+bool dcc_ir_constant_value(const ir_func_t *func, ir_ref_t ref, int64_t *value);
+
+uint32_t dcc_ir_block(ir_func_t *func);
+void dcc_ir_edge(ir_func_t *func, uint32_t from, uint32_t to);
+// A new instruction at the end of `block`, whose operands are copied
+ir_ref_t dcc_ir_append(ir_func_t *func, uint32_t block, enum ir_op op, ir_kind_t kind,
+                       uint32_t count, const ir_ref_t *args);
+// Likewise, but before the instruction at `position` in `block`
+ir_ref_t dcc_ir_insert(ir_func_t *func, uint32_t block, uint32_t position, enum ir_op op,
+                       ir_kind_t kind, uint32_t count, const ir_ref_t *args);
+
+bool dcc_ir_is_terminator(enum ir_op op);
+// The terminator of `block`, or IR_NONE if it does not have one yet
+ir_ref_t dcc_ir_terminator(const ir_func_t *func, uint32_t block);
+
+// Drop unreachable blocks and IR_NOPs, and renumber blocks into reverse
+// postorder and instructions into block order
+void dcc_ir_compact(ir_func_t *func);
+// Compute use lists, which stay valid until the function changes
+void dcc_ir_uses(ir_func_t *func);
+// Redirect every use of `from` to `to`
+void dcc_ir_replace(ir_func_t *func, ir_ref_t from, ir_ref_t to);
+
+const char* dcc_ir_op_str(enum ir_op op);
+void dcc_ir_print(FILE *file, const ir_func_t *func);
+// Check the invariants of SSA form, and raise an internal error if one fails
+void dcc_ir_verify(const ir_func_t *func);
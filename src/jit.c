@@ -0,0 +1,314 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// for MAP_ANONYMOUS
+#define _DEFAULT_SOURCE
+
+#include <dlfcn.h>
+#include <gnu/lib-names.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "jit.h"
+
+// The loaded code is laid out in three runs of pages, by protection: text
+// and the stubs through which it calls out of the process, read-only data
+// and the table of addresses those stubs and GOTPCREL references load, and
+// writable data
+enum {
+  REGION_CODE,
+  REGION_CONST,
+  REGION_DATA,
+  REGION_COUNT,
+};
+
+struct jit {
+  const obj_t *obj;
+  uint8_t *map;
+  size_t size;
+  uint8_t *bases[ASM_SECTION_COUNT];
+  void **libraries; // handles of those named with -l, searched after the process
+  size_t library_count;
+};
+
+// A stub is `jmp *slot(%rip)`, padded with int3 to its size
+#define STUB_SIZE 8
+
+typedef struct {
+  jit_t *jit;
+  void *process; // handle of the running process, for dlsym
+  uint64_t *addresses; // of each symbol, 0 until resolved
+  int32_t *slots; // index in the address table of each symbol, or -1
+  int32_t *stubs; // index of the stub of each symbol, or -1
+  uint32_t slot_count, stub_count;
+  uint8_t *table, *stub_base;
+} loader_t;
+
+static uint64_t align_to(uint64_t value, uint64_t align) {
+  return (value + align - 1) / align * align;
+}
+
+// Functions the C library links statically into each program, so that there
+// is nothing for dlsym to find; the loaded code shares this process's copies
+static const struct {
+  const char *name;
+  void (*address)(void);
+} STATIC_FUNCTIONS[] = {
+  { "atexit", (void (*)(void))atexit },
+};
+
+// Libraries of the C library itself, whose lib<name>.so is at most a linker
+// script for development, by the soname the dynamic linker knows them by
+static const struct {
+  const char *name, *soname;
+} LIBRARY_SONAMES[] = {
+  { "m", LIBM_SO },
+  { "dl", LIBDL_SO },
+  { "pthread", LIBPTHREAD_SO },
+  { "rt", LIBRT_SO },
+};
+
+// Open the library `name`, as given to -l, or report it and return null
+static void* open_library(const char *name) {
+  for (size_t i = 0; i < sizeof LIBRARY_SONAMES / sizeof *LIBRARY_SONAMES; i++) {
+    if (strcmp(LIBRARY_SONAMES[i].name, name) == 0) {
+      void *handle = dlopen(LIBRARY_SONAMES[i].soname, RTLD_NOW | RTLD_GLOBAL);
+      if (handle) {
+        return handle;
+      }
+    }
+  }
+  char *file = dcc_malloc(strlen(name) + sizeof "lib.so");
+  sprintf(file, "lib%s.so", name);
+  void *handle = dlopen(file, RTLD_NOW | RTLD_GLOBAL);
+  if (!handle) {
+    fprintf(stderr, "dcc: cannot load library -l%s: %s\n", name, dlerror());
+  }
+  free(file);
+  return handle;
+}
+
+// The address of an undefined symbol in the running process or, failing that,
+// in the libraries in the order given
+static uint64_t resolve(loader_t *l, const char *name) {
+  for (size_t i = 0; i < sizeof STATIC_FUNCTIONS / sizeof *STATIC_FUNCTIONS; i++) {
+    if (strcmp(STATIC_FUNCTIONS[i].name, name) == 0) {
+      return (uintptr_t)STATIC_FUNCTIONS[i].address;
+    }
+  }
+  if (!l->process) {
+    l->process = dlopen(0, RTLD_NOW);
+  }
+  void *address = l->process ? dlsym(l->process, name) : 0;
+  for (size_t i = 0; !address && i < l->jit->library_count; i++) {
+    address = dlsym(l->jit->libraries[i], name);
+  }
+  return (uintptr_t)address;
+}
+
+// Give every symbol referenced through the table or a stub its entries, and
+// every undefined one that is referenced an address
+static bool plan(loader_t *l) {
+  const obj_t *obj = l->jit->obj;
+  const asm_symbol_vec_t *symbols = &obj->as->symbols;
+  bool *referenced = dcc_calloc(symbols->size + 1, sizeof(bool));
+  for (int i = 0; i < ASM_SECTION_COUNT; i++) {
+    const obj_reloc_vec_t *relocs = &obj->sections[i].relocs;
+    for (size_t j = 0; j < relocs->size; j++) {
+      const obj_reloc_t *reloc = &relocs->data[j];
+      bool undefined = obj->symbols[reloc->symbol].section < 0;
+      referenced[reloc->symbol] = true;
+      bool stub = reloc->type == R_X86_64_PLT32 && undefined;
+      if ((stub || reloc->type == R_X86_64_GOTPCREL) && l->slots[reloc->symbol] < 0) {
+        l->slots[reloc->symbol] = l->slot_count++;
+      }
+      if (stub && l->stubs[reloc->symbol] < 0) {
+        l->stubs[reloc->symbol] = l->stub_count++;
+      }
+    }
+  }
+
+  bool ok = true;
+  for (size_t i = 0; i < symbols->size; i++) {
+    if (referenced[i] && obj->symbols[i].section < 0
+        && !(l->addresses[i] = resolve(l, symbols->data[i].name))) {
+      fprintf(stderr, "dcc: undefined symbol %s\n", symbols->data[i].name);
+      ok = false;
+    }
+  }
+  free(referenced);
+  return ok;
+}
+
+static bool relocate(loader_t *l, asm_section_t index) {
+  const obj_t *obj = l->jit->obj;
+  const obj_reloc_vec_t *relocs = &obj->sections[index].relocs;
+  for (size_t i = 0; i < relocs->size; i++) {
+    const obj_reloc_t *reloc = &relocs->data[i];
+    uint8_t *place = l->jit->bases[index] + reloc->offset;
+    uint64_t target = l->addresses[reloc->symbol];
+    if (reloc->type == R_X86_64_64) {
+      target += reloc->addend;
+      memcpy(place, &target, 8);
+      continue;
+    }
+
+    if (reloc->type == R_X86_64_GOTPCREL) {
+      target = (uintptr_t)(l->table + 8 * l->slots[reloc->symbol]);
+    } else if (reloc->type == R_X86_64_PLT32 && l->stubs[reloc->symbol] >= 0) {
+      target = (uintptr_t)(l->stub_base + STUB_SIZE * l->stubs[reloc->symbol]);
+    }
+    int64_t value = (int64_t)(target + reloc->addend - (uintptr_t)place);
+    if (value != (int32_t)value) {
+      fprintf(stderr, "dcc: relocation against %s out of range\n",
+              obj->as->symbols.data[reloc->symbol].name);
+      return false;
+    }
+    int32_t value32 = value;
+    memcpy(place, &value32, 4);
+  }
+  return true;
+}
+
+jit_t* dcc_jit_load(const obj_t *obj, const char **libraries, size_t library_count) {
+  size_t symbol_count = obj->as->symbols.size;
+  jit_t *jit = dcc_calloc(1, sizeof(jit_t));
+  jit->obj = obj;
+  jit->libraries = dcc_calloc(library_count + 1, sizeof *jit->libraries);
+  for (size_t i = 0; i < library_count; i++) {
+    if (!(jit->libraries[jit->library_count++] = open_library(libraries[i]))) {
+      dcc_jit_free(jit);
+      return 0;
+    }
+  }
+  loader_t l = { jit, 0 };
+  l.addresses = dcc_calloc(symbol_count + 1, sizeof *l.addresses);
+  l.slots = dcc_malloc((symbol_count + 1) * sizeof *l.slots);
+  l.stubs = dcc_malloc((symbol_count + 1) * sizeof *l.stubs);
+  for (size_t i = 0; i < symbol_count; i++) {
+    l.slots[i] = l.stubs[i] = -1;
+  }
+
+  bool ok = plan(&l);
+  if (ok) {
+    // lay out each region from page boundaries, which satisfy any section
+    // alignment
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    const obj_section_t *sections = obj->sections;
+    uint64_t stubs = align_to(sections[ASM_TEXT].size, STUB_SIZE);
+    uint64_t table = align_to(sections[ASM_RODATA].size, 8);
+    uint64_t bss = align_to(sections[ASM_DATA].size, sections[ASM_BSS].align);
+    uint64_t sizes[REGION_COUNT] = {
+      [REGION_CODE] = align_to(stubs + STUB_SIZE * l.stub_count, page),
+      [REGION_CONST] = align_to(table + 8 * l.slot_count, page),
+      [REGION_DATA] = align_to(bss + sections[ASM_BSS].size, page),
+    };
+    jit->size = sizes[REGION_CODE] + sizes[REGION_CONST] + sizes[REGION_DATA];
+    // an empty mapping is an error
+    jit->size = jit->size ? jit->size : page;
+    jit->map = mmap(0, jit->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                    -1, 0);
+    if (jit->map == MAP_FAILED) {
+      fprintf(stderr, "dcc: cannot map memory for code\n");
+      jit->map = 0;
+      ok = false;
+    }
+    if (ok) {
+      uint8_t *code = jit->map, *constants = code + sizes[REGION_CODE],
+        *data = constants + sizes[REGION_CONST];
+      jit->bases[ASM_TEXT] = code;
+      jit->bases[ASM_RODATA] = constants;
+      jit->bases[ASM_DATA] = data;
+      jit->bases[ASM_BSS] = data + bss;
+      l.stub_base = code + stubs;
+      l.table = constants + table;
+
+      for (int i = 0; i < ASM_SECTION_COUNT; i++) {
+        if (i != ASM_BSS && sections[i].bytes.size) {
+          memcpy(jit->bases[i], sections[i].bytes.data, sections[i].bytes.size);
+        }
+      }
+      for (size_t i = 0; i < symbol_count; i++) {
+        const obj_symbol_t *symbol = &obj->symbols[i];
+        if (symbol->section >= 0) {
+          l.addresses[i] = (uintptr_t)(jit->bases[symbol->section] + symbol->value);
+        }
+        if (l.slots[i] >= 0) {
+          memcpy(l.table + 8 * l.slots[i], &l.addresses[i], 8);
+        }
+        if (l.stubs[i] >= 0) {
+          uint8_t *stub = l.stub_base + STUB_SIZE * l.stubs[i];
+          int32_t offset = (l.table + 8 * l.slots[i]) - (stub + 6);
+          stub[0] = 0xff;
+          stub[1] = 0x25;
+          memcpy(stub + 2, &offset, 4);
+          memset(stub + 6, 0xcc, STUB_SIZE - 6);
+        }
+      }
+      for (int i = 0; i < ASM_SECTION_COUNT && ok; i++) {
+        ok = relocate(&l, i);
+      }
+
+      // only now that nothing is left to write may the code run
+      if (ok && (mprotect(code, sizes[REGION_CODE], PROT_READ | PROT_EXEC) != 0
+                 || mprotect(constants, sizes[REGION_CONST], PROT_READ) != 0)) {
+        fprintf(stderr, "dcc: cannot protect memory for code\n");
+        ok = false;
+      }
+    }
+  }
+
+  if (l.process) {
+    dlclose(l.process);
+  }
+  free(l.addresses);
+  free(l.slots);
+  free(l.stubs);
+  if (!ok) {
+    dcc_jit_free(jit);
+    return 0;
+  }
+  return jit;
+}
+
+void* dcc_jit_symbol(const jit_t *jit, const char *name) {
+  const asm_symbol_vec_t *symbols = &jit->obj->as->symbols;
+  for (size_t i = 0; i < symbols->size; i++) {
+    const obj_symbol_t *symbol = &jit->obj->symbols[i];
+    if (symbols->data[i].is_global && symbol->section >= 0
+        && strcmp(symbols->data[i].name, name) == 0) {
+      return jit->bases[symbol->section] + symbol->value;
+    }
+  }
+  return 0;
+}
+
+void dcc_jit_free(jit_t *jit) {
+  if (jit->map) {
+    munmap(jit->map, jit->size);
+  }
+  for (size_t i = 0; i < jit->library_count; i++) {
+    if (jit->libraries[i]) {
+      dlclose(jit->libraries[i]);
+    }
+  }
+  free(jit->libraries);
+  free(jit);
+}
@@ -0,0 +1,38 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+  In-process execution of object code. Loads the sections of an obj_t into
+  fresh pages, links them against the symbols of the running process and of
+  the libraries named with -l, the way the dynamic linker would a shared
+  object, and hands out the addresses of what it defines. Pages are never
+  writable and executable at once.
+*/
+
+#pragma once
+
+#include "encode.h"
+
+typedef struct jit jit_t;
+
+// Load `obj` into executable memory, linked against `libraries` as -l names
+// them, or report on stderr and return null if a library cannot be opened or
+// a symbol it needs cannot be found or placed
+jit_t* dcc_jit_load(const obj_t *obj, const char **libraries, size_t library_count);
+// The address of the global `name` defined by the loaded code, or null
+void* dcc_jit_symbol(const jit_t *jit, const char *name);
+void dcc_jit_free(jit_t *jit);
@@ -0,0 +1,696 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "alias.h"
+#include "loop.h"
+#include "ssa.h"
+
+static void free_loop(ir_loop_t *loop) {
+  uint32_vec_free(&loop->blocks);
+  uint32_vec_free(&loop->latches);
+}
+DEFINE_VEC3(ir_loop_t, ir_loop_vec, free_loop);
+
+////////////////////////////////////////////////////////////////////////////////
+// Analysis
+////////////////////////////////////////////////////////////////////////////////
+
+static int compare_blocks(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+ir_loops_t dcc_ir_loops(const ir_func_t *func) {
+  size_t n = func->blocks.size;
+  ir_loops_t loops = { ir_loop_vec_new(), dcc_malloc(n * sizeof(uint32_t)) };
+  uint32_t *mark = dcc_calloc(n, sizeof(uint32_t)); // loop index + 1
+  uint32_vec_t work = uint32_vec_new();
+  for (uint32_t b = 0; b < n; b++) {
+    loops.innermost[b] = IR_NONE;
+  }
+
+  for (uint32_t h = 0; h < n; h++) {
+    const uint32_vec_t *preds = &func->blocks.data[h].preds;
+    ir_loop_t loop = { h, IR_NONE, IR_NONE, 1, uint32_vec_new(), uint32_vec_new(), true };
+    for (size_t p = 0; p < preds->size; p++) {
+      if (dcc_ir_dominates(func, h, preds->data[p])) {
+        uint32_vec_push(&loop.latches, preds->data[p]);
+      }
+    }
+    if (!loop.latches.size) {
+      free_loop(&loop);
+      continue;
+    }
+
+    // walk back from the latches, stopping at the header
+    uint32_t index = loops.loops.size, stamp = index + 1;
+    mark[h] = stamp;
+    uint32_vec_push(&loop.blocks, h);
+    for (size_t l = 0; l < loop.latches.size; l++) {
+      uint32_t latch = loop.latches.data[l];
+      if (mark[latch] != stamp) {
+        mark[latch] = stamp;
+        uint32_vec_push(&work, latch);
+      }
+    }
+    while (work.size) {
+      uint32_t b = work.data[--work.size];
+      uint32_vec_push(&loop.blocks, b);
+      const uint32_vec_t *bpreds = &func->blocks.data[b].preds;
+      for (size_t p = 0; p < bpreds->size; p++) {
+        if (mark[bpreds->data[p]] != stamp) {
+          mark[bpreds->data[p]] = stamp;
+          uint32_vec_push(&work, bpreds->data[p]);
+        }
+      }
+    }
+    qsort(loop.blocks.data, loop.blocks.size, sizeof(uint32_t), compare_blocks);
+
+    // a loop around this one has an earlier header, so it was found already
+    loop.parent = loops.innermost[h];
+    if (loop.parent != IR_NONE) {
+      ir_loop_t *parent = &loops.loops.data[loop.parent];
+      parent->is_innermost = false;
+      loop.depth = parent->depth + 1;
+    }
+    for (size_t i = 0; i < loop.blocks.size; i++) {
+      loops.innermost[loop.blocks.data[i]] = index;
+    }
+    ir_loop_vec_push(&loops.loops, loop);
+  }
+  uint32_vec_free(&work);
+  free(mark);
+  return loops;
+}
+
+void dcc_ir_loops_free(ir_loops_t *loops) {
+  ir_loop_vec_free(&loops->loops);
+  free(loops->innermost);
+}
+
+bool dcc_ir_in_loop(const ir_loops_t *loops, uint32_t loop, uint32_t block) {
+  for (uint32_t l = loops->innermost[block]; l != IR_NONE; l = loops->loops.data[l].parent) {
+    if (l == loop) {
+      return true;
+    }
+  }
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Preheaders
+////////////////////////////////////////////////////////////////////////////////
+
+// Route the edges into a loop's header from outside it through a new block,
+// which merges the operands they give the header's phis
+static void insert_preheader(ir_func_t *func, const uint32_vec_t *outside,
+                             const uint32_vec_t *inside, uint32_t header) {
+  uint32_t pre = dcc_ir_block(func);
+  uint32_t *args = dcc_malloc((outside->size + 1) * sizeof(uint32_t));
+  const uint32_vec_t *header_instrs = &func->blocks.data[header].instrs;
+  for (size_t k = 0; k < header_instrs->size; k++) {
+    ir_ref_t ref = func->blocks.data[header].instrs.data[k];
+    if (func->instrs.data[ref].op != IR_PHI) {
+      break;
+    }
+    // the operands from each side, by position in the old predecessors
+    const uint32_vec_t *preds = &func->blocks.data[header].preds;
+    uint32_t in = 0, out = 0;
+    ir_ref_t *old = func->instrs.data[ref].args;
+    ir_ref_t *new = dcc_arena_alloc(&func->arena, (inside->size + 1) * sizeof(ir_ref_t));
+    bool same = true;
+    for (size_t p = 0; p < preds->size; p++) {
+      bool is_outside = out < outside->size && outside->data[out] == preds->data[p];
+      if (is_outside) {
+        args[out] = old[p];
+        same &= old[p] == args[0];
+        out++;
+      } else {
+        new[++in] = old[p];
+      }
+    }
+    ir_instr_t phi = func->instrs.data[ref];
+    if (same) {
+      new[0] = args[0];
+    } else {
+      new[0] = dcc_ir_append(func, pre, IR_PHI, phi.kind, outside->size, args);
+      func->instrs.data[new[0]].flags = phi.flags;
+    }
+    func->instrs.data[ref].args = new;
+    func->instrs.data[ref].count = inside->size + 1;
+  }
+  free(args);
+
+  dcc_ir_append(func, pre, IR_JMP, IR_VOID, 0, 0);
+  for (size_t p = 0; p < outside->size; p++) {
+    uint32_vec_t *succs = &func->blocks.data[outside->data[p]].succs;
+    for (size_t s = 0; s < succs->size; s++) {
+      if (succs->data[s] == header) {
+        succs->data[s] = pre;
+      }
+    }
+    uint32_vec_push(&func->blocks.data[pre].preds, outside->data[p]);
+  }
+  uint32_vec_push(&func->blocks.data[pre].succs, header);
+  uint32_vec_t *preds = &func->blocks.data[header].preds;
+  preds->size = 0;
+  uint32_vec_push(preds, pre);
+  for (size_t p = 0; p < inside->size; p++) {
+    uint32_vec_push(preds, inside->data[p]);
+  }
+}
+
+void dcc_ir_preheaders(ir_func_t *func, ir_loops_t *loops) {
+  bool changed = false;
+  uint32_vec_t outside = uint32_vec_new(), inside = uint32_vec_new();
+  for (uint32_t l = 0; l < loops->loops.size; l++) {
+    ir_loop_t *loop = &loops->loops.data[l];
+    if (loop->header == 0) {
+      continue;
+    }
+    outside.size = inside.size = 0;
+    const uint32_vec_t *preds = &func->blocks.data[loop->header].preds;
+    for (size_t p = 0; p < preds->size; p++) {
+      bool in = dcc_ir_in_loop(loops, l, preds->data[p]);
+      uint32_vec_push(in ? &inside : &outside, preds->data[p]);
+    }
+    if (outside.size == 1 && func->blocks.data[outside.data[0]].succs.size == 1) {
+      loop->preheader = outside.data[0];
+    } else {
+      insert_preheader(func, &outside, &inside, loop->header);
+      changed = true;
+    }
+  }
+  uint32_vec_free(&outside);
+  uint32_vec_free(&inside);
+
+  if (changed) {
+    dcc_ir_compact(func);
+    dcc_ir_dominators(func);
+    dcc_ir_loops_free(loops);
+    *loops = dcc_ir_loops(func);
+    dcc_ir_preheaders(func, loops);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Optimization
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  ir_func_t *func;
+  ir_loops_t loops;
+  ir_alias_t alias;
+  uint32_t loop; // being optimized
+  uint32_t preheader;
+  uint32_vec_t writers; // the instructions of the loop that may write memory
+  // of each instruction the optimization started with: the copy of a
+  // constant or address made in the preheader of loop clone_loop[ref]
+  uint32_t *clones, *clone_loop;
+  uint32_t count;
+} opt_t;
+
+// Values that are as cheap to compute again as to keep, and are copied into
+// the preheader rather than moved
+static bool is_leaf(enum ir_op op) {
+  return op == IR_CONST || op == IR_FCONST || op == IR_GLOBAL || op == IR_STRING
+    || op == IR_SLOT;
+}
+
+// Whether an instruction has no effect but its value, and cannot trap
+static bool is_pure(const ir_func_t *func, const ir_instr_t *instr) {
+  switch (instr->op) {
+  case IR_SDIV:
+  case IR_SREM:
+  case IR_UDIV:
+  case IR_UREM: {
+    const ir_instr_t *divisor = &func->instrs.data[instr->args[1]];
+    bool is_signed = instr->op == IR_SDIV || instr->op == IR_SREM;
+    return divisor->op == IR_CONST && divisor->imm && !(is_signed && divisor->imm == -1);
+  }
+  default:
+    return instr->op >= IR_ADD && instr->op <= IR_SPLAT;
+  }
+}
+
+static bool is_invariant(const opt_t *opt, ir_ref_t ref) {
+  const ir_instr_t *instr = &opt->func->instrs.data[ref];
+  return is_leaf(instr->op) || !dcc_ir_in_loop(&opt->loops, opt->loop, instr->block);
+}
+
+// A new instruction at the end of the preheader
+static ir_ref_t emit(opt_t *opt, enum ir_op op, ir_kind_t kind, uint32_t count,
+                     const ir_ref_t *args) {
+  uint32_t position = opt->func->blocks.data[opt->preheader].instrs.size - 1;
+  return dcc_ir_insert(opt->func, opt->preheader, position, op, kind, count, args);
+}
+
+// An invariant value as an operand in the preheader
+static ir_ref_t outside(opt_t *opt, ir_ref_t ref) {
+  ir_func_t *func = opt->func;
+  if (!dcc_ir_in_loop(&opt->loops, opt->loop, func->instrs.data[ref].block)) {
+    return ref;
+  } else if (ref < opt->count && opt->clone_loop[ref] == opt->loop) {
+    return opt->clones[ref];
+  }
+  ir_instr_t leaf = func->instrs.data[ref];
+  ir_ref_t clone = emit(opt, leaf.op, leaf.kind, 0, 0);
+  func->instrs.data[clone].imm = leaf.imm;
+  if (leaf.op == IR_FCONST) {
+    func->instrs.data[clone].fimm = leaf.fimm;
+  } else if (leaf.op == IR_GLOBAL) {
+    func->instrs.data[clone].symbol = leaf.symbol;
+  } else if (leaf.op == IR_STRING) {
+    func->instrs.data[clone].string = leaf.string;
+  }
+  if (ref < opt->count) {
+    opt->clones[ref] = clone;
+    opt->clone_loop[ref] = opt->loop;
+  }
+  return clone;
+}
+
+////
+// Invariant code motion
+
+// Whether a load of the header reads memory that nothing in the loop writes.
+// The header runs whenever the preheader does, so the load cannot trap there
+// unless it would have anyway.
+static bool is_invariant_load(const opt_t *opt, ir_ref_t ref) {
+  const ir_instr_t *instr = &opt->func->instrs.data[ref];
+  if (instr->op != IR_LOAD || (instr->flags & IR_VOLATILE) || ref >= opt->count
+      || instr->block != opt->loops.loops.data[opt->loop].header) {
+    return false;
+  }
+  ir_access_t access = dcc_ir_access(opt->func, ref);
+  for (size_t i = 0; i < opt->writers.size; i++) {
+    if (dcc_ir_may_write(&opt->alias, opt->writers.data[i], access)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void hoist(opt_t *opt) {
+  ir_func_t *func = opt->func;
+  const ir_loop_t *loop = &opt->loops.loops.data[opt->loop];
+  opt->writers.size = 0;
+  for (size_t i = 0; i < loop->blocks.size; i++) {
+    const uint32_vec_t *instrs = &func->blocks.data[loop->blocks.data[i]].instrs;
+    for (size_t k = 0; k < instrs->size; k++) {
+      enum ir_op op = func->instrs.data[instrs->data[k]].op;
+      if (op == IR_STORE || op == IR_MEMCPY || op == IR_MEMZERO || op == IR_CALL) {
+        uint32_vec_push(&opt->writers, instrs->data[k]);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < loop->blocks.size; i++) {
+    uint32_t b = loop->blocks.data[i];
+    uint32_t kept = 0;
+    for (size_t k = 0; k < func->blocks.data[b].instrs.size; k++) {
+      ir_ref_t ref = func->blocks.data[b].instrs.data[k];
+      ir_instr_t *instr = &func->instrs.data[ref];
+      bool invariant = is_pure(func, instr) || is_invariant_load(opt, ref);
+      for (uint32_t a = 0; a < instr->count && invariant; a++) {
+        invariant = is_invariant(opt, instr->args[a]);
+      }
+      if (!invariant) {
+        func->blocks.data[b].instrs.data[kept++] = ref;
+        continue;
+      }
+      for (uint32_t a = 0; a < func->instrs.data[ref].count; a++) {
+        ir_ref_t arg = outside(opt, func->instrs.data[ref].args[a]);
+        func->instrs.data[ref].args[a] = arg;
+      }
+      uint32_vec_t *pre = &func->blocks.data[opt->preheader].instrs;
+      uint32_vec_push(pre, pre->data[pre->size - 1]);
+      pre->data[pre->size - 2] = ref;
+      func->instrs.data[ref].block = opt->preheader;
+    }
+    func->blocks.data[b].instrs.size = kept;
+  }
+}
+
+////
+// Strength reduction
+
+// A basic induction variable: a phi of the header that the latch steps by an
+// invariant amount
+typedef struct {
+  ir_ref_t phi;
+  ir_ref_t init, step; // as operands in the preheader
+  bool no_wrap;
+} iv_t;
+DECLARE_VEC(iv_t, iv_vec);
+DEFINE_VEC2(iv_t, iv_vec);
+
+// A value that is an induction variable times an invariant plus an invariant
+typedef struct {
+  uint32_t iv; // index of the variable, or IR_NONE if the value is not affine
+  bool no_wrap; // computed without overflow where the variable is
+  bool worth; // multiplies or extends, which a reduced value saves
+} affine_t;
+
+typedef struct {
+  opt_t *opt;
+  iv_vec_t ivs;
+  uint32_t count; // instructions the analysis covers
+  bool *known;
+  affine_t *affine;
+} reduce_t;
+
+static affine_t affine(reduce_t *r, ir_ref_t ref) {
+  affine_t result = { IR_NONE, false, false };
+  if (ref >= r->count) {
+    return result;
+  } else if (r->known[ref]) {
+    return r->affine[ref];
+  }
+  r->known[ref] = true;
+  r->affine[ref] = result;
+  const opt_t *opt = r->opt;
+  ir_instr_t instr = opt->func->instrs.data[ref];
+  if (is_invariant(opt, ref)) {
+    return result;
+  }
+
+  if (instr.op == IR_PHI) {
+    for (uint32_t i = 0; i < r->ivs.size; i++) {
+      if (r->ivs.data[i].phi == ref) {
+        result.iv = i;
+        result.no_wrap = r->ivs.data[i].no_wrap;
+      }
+    }
+  } else if (instr.op == IR_SEXT && instr.kind == IR_I64) {
+    // extending each value is extending the start and the step only if the
+    // narrow values never wrap
+    affine_t a = affine(r, instr.args[0]);
+    if (a.iv != IR_NONE && a.no_wrap) {
+      result.iv = a.iv;
+      result.no_wrap = result.worth = true;
+    }
+  } else if (instr.op == IR_ADD || instr.op == IR_SUB || instr.op == IR_MUL
+             || instr.op == IR_SHL) {
+    bool commutes = instr.op == IR_ADD || instr.op == IR_MUL;
+    affine_t a = affine(r, instr.args[0]);
+    ir_ref_t other = instr.args[1];
+    if (a.iv == IR_NONE && commutes) {
+      a = affine(r, instr.args[1]);
+      other = instr.args[0];
+    }
+    bool ok = a.iv != IR_NONE && is_invariant(opt, other);
+    if (ok && instr.op == IR_SHL) {
+      ok = opt->func->instrs.data[other].op == IR_CONST;
+    }
+    if (ok) {
+      result.iv = a.iv;
+      result.no_wrap = a.no_wrap && (instr.flags & IR_NO_WRAP);
+      result.worth = a.worth || instr.op == IR_MUL || instr.op == IR_SHL;
+    }
+  }
+  r->affine[ref] = result;
+  return result;
+}
+
+// `a op b` in the preheader, folding constants
+static ir_ref_t fold(opt_t *opt, enum ir_op op, ir_kind_t kind, ir_ref_t a, ir_ref_t b) {
+  const ir_instr_t *x = &opt->func->instrs.data[a], *y = &opt->func->instrs.data[b];
+  bool cx = x->op == IR_CONST, cy = y->op == IR_CONST;
+  if (cx && cy) {
+    uint64_t p = x->imm, q = y->imm, value;
+    switch (op) {
+    case IR_ADD: value = p + q; break;
+    case IR_SUB: value = p - q; break;
+    case IR_MUL: value = p * q; break;
+    default: value = p << (q & (kind == IR_I64 ? 63 : 31)); break;
+    }
+    ir_ref_t ref = emit(opt, IR_CONST, kind, 0, 0);
+    opt->func->instrs.data[ref].imm = kind == IR_I64 ? (int64_t)value : (int32_t)value;
+    return ref;
+  } else if ((op == IR_MUL && cy && y->imm == 1) || (op != IR_MUL && cy && !y->imm)
+             || (op == IR_MUL && cx && !x->imm)) {
+    return a;
+  } else if ((op == IR_MUL && cx && x->imm == 1) || (op == IR_ADD && cx && !x->imm)
+             || (op == IR_MUL && cy && !y->imm)) {
+    return b;
+  }
+  ir_ref_t args[] = { a, b };
+  return emit(opt, op, kind, 2, args);
+}
+
+// A value of a narrow kind as an operand in the preheader, sign extended if
+// `wide`
+static ir_ref_t widen(opt_t *opt, ir_ref_t ref, bool wide) {
+  const ir_instr_t *instr = &opt->func->instrs.data[ref];
+  if (!wide || instr->kind == IR_I64) {
+    return ref;
+  } else if (instr->op == IR_CONST) {
+    int64_t value = (int32_t)instr->imm;
+    ir_ref_t copy = emit(opt, IR_CONST, IR_I64, 0, 0);
+    opt->func->instrs.data[copy].imm = value;
+    return copy;
+  }
+  return emit(opt, IR_SEXT, IR_I64, 1, &ref);
+}
+
+// The first value of an affine value in the loop, or what it steps by, in the
+// preheader. Under an extension, the narrow arithmetic is done wide.
+static ir_ref_t materialize(reduce_t *r, ir_ref_t ref, bool step, bool wide) {
+  opt_t *opt = r->opt;
+  affine_t a = affine(r, ref);
+  if (a.iv == IR_NONE) {
+    dcc_assert(!step);
+    return widen(opt, outside(opt, ref), wide);
+  }
+  ir_instr_t instr = opt->func->instrs.data[ref];
+  if (instr.op == IR_PHI) {
+    const iv_t *iv = &r->ivs.data[a.iv];
+    return widen(opt, step ? iv->step : iv->init, wide);
+  } else if (instr.op == IR_SEXT) {
+    return materialize(r, instr.args[0], step, true);
+  }
+  bool first = affine(r, instr.args[0]).iv != IR_NONE;
+  ir_ref_t x = instr.args[!first], y = instr.args[first];
+  if (step && instr.op != IR_MUL && instr.op != IR_SHL) {
+    return materialize(r, x, true, wide);
+  }
+  x = materialize(r, x, step, wide);
+  y = materialize(r, y, false, wide);
+  return fold(opt, instr.op, wide ? IR_I64 : instr.kind, first ? x : y, first ? y : x);
+}
+
+// The basic induction variables of the loop, whose header has the preheader
+// and the one latch as its predecessors
+static void find_ivs(reduce_t *r, uint32_t pre, uint32_t latch) {
+  opt_t *opt = r->opt;
+  ir_func_t *func = opt->func;
+  const ir_loop_t *loop = &opt->loops.loops.data[opt->loop];
+  for (size_t k = 0; k < func->blocks.data[loop->header].instrs.size; k++) {
+    ir_ref_t phi = func->blocks.data[loop->header].instrs.data[k];
+    ir_instr_t instr = func->instrs.data[phi];
+    if (instr.op != IR_PHI) {
+      break;
+    } else if (instr.kind != IR_I32 && instr.kind != IR_I64) {
+      continue;
+    }
+    ir_instr_t next = func->instrs.data[instr.args[latch]];
+    if ((next.op != IR_ADD && next.op != IR_SUB) || next.kind != instr.kind) {
+      continue;
+    }
+    bool first = next.args[0] == phi;
+    if (!first && (next.op == IR_SUB || next.args[1] != phi)) {
+      continue;
+    }
+    ir_ref_t step = next.args[first];
+    if (!is_invariant(opt, step)) {
+      continue;
+    }
+    step = outside(opt, step);
+    if (next.op == IR_SUB) {
+      ir_ref_t zero = emit(opt, IR_CONST, instr.kind, 0, 0);
+      func->instrs.data[zero].imm = 0;
+      step = fold(opt, IR_SUB, instr.kind, zero, step);
+    }
+    iv_t iv = { phi, instr.args[pre], step, next.flags & IR_NO_WRAP };
+    iv_vec_push(&r->ivs, iv);
+  }
+}
+
+// Whether every use of a value is in the loop, and one of them is not itself
+// worth reducing, so reducing the value does not leave it live
+static bool is_candidate(reduce_t *r, ir_ref_t ref) {
+  const ir_func_t *func = r->opt->func;
+  bool outermost = false;
+  for (uint32_t u = func->use_start[ref]; u < func->use_start[ref + 1]; u++) {
+    ir_ref_t user = func->uses[u].user;
+    if (!dcc_ir_in_loop(&r->opt->loops, r->opt->loop, func->instrs.data[user].block)) {
+      return false;
+    }
+    affine_t a = affine(r, user);
+    outermost |= a.iv == IR_NONE || !a.worth || func->instrs.data[user].op == IR_PHI;
+  }
+  return outermost;
+}
+
+static void reduce(opt_t *opt) {
+  ir_func_t *func = opt->func;
+  const ir_loop_t *loop = &opt->loops.loops.data[opt->loop];
+  const uint32_vec_t *preds = &func->blocks.data[loop->header].preds;
+  if (loop->latches.size != 1 || preds->size != 2) {
+    return;
+  }
+  uint32_t pre = preds->data[0] != opt->preheader;
+  uint32_t header = loop->header, latch = loop->latches.data[0];
+  reduce_t r = { opt, iv_vec_new() };
+  find_ivs(&r, pre, !pre);
+  if (!r.ivs.size) {
+    iv_vec_free(&r.ivs);
+    return;
+  }
+
+  dcc_ir_uses(func);
+  r.count = func->instrs.size;
+  r.known = dcc_calloc(r.count, sizeof(bool));
+  r.affine = dcc_malloc(r.count * sizeof(affine_t));
+  uint32_vec_t candidates = uint32_vec_new(), inits = uint32_vec_new(), steps = uint32_vec_new();
+  for (size_t i = 0; i < loop->blocks.size; i++) {
+    const uint32_vec_t *instrs = &func->blocks.data[loop->blocks.data[i]].instrs;
+    for (size_t k = 0; k < instrs->size; k++) {
+      ir_ref_t ref = instrs->data[k];
+      affine_t a = affine(&r, ref);
+      if (a.iv != IR_NONE && a.worth && is_candidate(&r, ref)) {
+        uint32_vec_push(&candidates, ref);
+      }
+    }
+  }
+
+  // compute every start and step before any use changes, then give each
+  // value a phi
+  for (size_t c = 0; c < candidates.size; c++) {
+    uint32_vec_push(&inits, materialize(&r, candidates.data[c], false, false));
+    uint32_vec_push(&steps, materialize(&r, candidates.data[c], true, false));
+  }
+  for (size_t c = 0; c < candidates.size; c++) {
+    ir_ref_t ref = candidates.data[c];
+    ir_kind_t kind = func->instrs.data[ref].kind;
+    ir_ref_t args[2];
+    args[pre] = inits.data[c];
+    args[!pre] = inits.data[c];
+    ir_ref_t phi = dcc_ir_insert(func, header, 0, IR_PHI, kind, 2, args);
+    uint32_t end = func->blocks.data[latch].instrs.size - 1;
+    ir_ref_t step[] = { phi, steps.data[c] };
+    func->instrs.data[phi].args[!pre] = dcc_ir_insert(func, latch, end, IR_ADD, kind, 2, step);
+    for (uint32_t u = func->use_start[ref]; u < func->use_start[ref + 1]; u++) {
+      ir_use_t use = func->uses[u];
+      func->instrs.data[use.user].args[use.index] = phi;
+    }
+  }
+
+  free(func->use_start);
+  free(func->uses);
+  func->use_start = 0;
+  func->uses = 0;
+  uint32_vec_free(&candidates);
+  uint32_vec_free(&inits);
+  uint32_vec_free(&steps);
+  free(r.known);
+  free(r.affine);
+  iv_vec_free(&r.ivs);
+}
+
+////
+// Driver
+
+// Delete the values nothing uses any more, such as what reduced values were
+// computed from and induction variables only their own steps use
+static void sweep(ir_func_t *func) {
+  bool *live = dcc_calloc(func->instrs.size, sizeof(bool));
+  uint32_vec_t work = uint32_vec_new();
+  for (ir_ref_t ref = 0; ref < func->instrs.size; ref++) {
+    const ir_instr_t *instr = &func->instrs.data[ref];
+    if (!is_pure(func, instr) && !is_leaf(instr->op) && instr->op != IR_PHI
+        && instr->op != IR_UNDEF) {
+      live[ref] = true;
+      uint32_vec_push(&work, ref);
+    }
+  }
+  while (work.size) {
+    ir_ref_t ref = work.data[--work.size];
+    for (uint32_t a = 0; a < func->instrs.data[ref].count; a++) {
+      ir_ref_t arg = func->instrs.data[ref].args[a];
+      if (!live[arg]) {
+        live[arg] = true;
+        uint32_vec_push(&work, arg);
+      }
+    }
+  }
+  for (ir_ref_t ref = 0; ref < func->instrs.size; ref++) {
+    if (!live[ref]) {
+      func->instrs.data[ref].op = IR_NOP;
+      func->instrs.data[ref].count = 0;
+    }
+  }
+  uint32_vec_free(&work);
+  free(live);
+}
+
+void dcc_loop_optimize(ir_func_t *func) {
+  opt_t opt = { func, dcc_ir_loops(func) };
+  if (!opt.loops.loops.size) {
+    dcc_ir_loops_free(&opt.loops);
+    return;
+  }
+  dcc_ir_preheaders(func, &opt.loops);
+  opt.alias = dcc_ir_alias(func);
+  opt.writers = uint32_vec_new();
+  opt.count = func->instrs.size;
+  opt.clones = dcc_malloc(opt.count * sizeof(ir_ref_t));
+  opt.clone_loop = dcc_malloc(opt.count * sizeof(uint32_t));
+  memset(opt.clone_loop, 0xff, opt.count * sizeof(uint32_t));
+
+  // inner loops come later, and go first so that what leaves them can leave
+  // the outer loops too
+  for (uint32_t l = opt.loops.loops.size; l-- > 0;) {
+    opt.loop = l;
+    opt.preheader = opt.loops.loops.data[l].preheader;
+    if (opt.preheader != IR_NONE) {
+      hoist(&opt);
+    }
+  }
+  for (uint32_t l = opt.loops.loops.size; l-- > 0;) {
+    opt.loop = l;
+    opt.preheader = opt.loops.loops.data[l].preheader;
+    if (opt.preheader != IR_NONE) {
+      reduce(&opt);
+    }
+  }
+  sweep(func);
+  dcc_ir_compact(func);
+  dcc_ir_dominators(func);
+  dcc_ir_verify(func);
+
+  free(opt.clones);
+  free(opt.clone_loop);
+  dcc_ir_alias_free(&opt.alias);
+  uint32_vec_free(&opt.writers);
+  dcc_ir_loops_free(&opt.loops);
+}
@@ -0,0 +1,66 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Loops. A natural loop is a header and the blocks that reach one of its back
+  edges, those from blocks the header dominates, without passing through the
+  header; loops with one header share it. They are numbered in reverse
+  postorder of their headers, so a loop comes after every loop around it.
+
+  Loop optimization first gives each loop a preheader, a block outside it that
+  is its header's only predecessor from outside. Invariant code motion then
+  hoists pure instructions that cannot trap and whose operands come from
+  outside a loop into its preheader, innermost loops first, along with loads
+  of the header from memory that alias analysis finds nothing in the loop
+  writes. Strength reduction then replaces values that are affine in a basic
+  induction variable, such as the address of a[i * stride], by phis that step
+  by an invariant amount, so each iteration adds where it used to multiply.
+*/
+
+#pragma once
+
+#include "ir.h"
+
+typedef struct {
+  uint32_t header;
+  uint32_t preheader; // IR_NONE until dcc_ir_preheaders()
+  uint32_t parent; // the innermost loop around this one, or IR_NONE
+  uint32_t depth; // 1 for an outermost loop
+  uint32_vec_t blocks; // in order, including those of inner loops
+  uint32_vec_t latches; // the sources of its back edges
+  bool is_innermost;
+} ir_loop_t;
+DECLARE_VEC(ir_loop_t, ir_loop_vec);
+
+typedef struct {
+  ir_loop_vec_t loops;
+  uint32_t *innermost; // the loop of each block, or IR_NONE
+} ir_loops_t;
+
+// The loops of a compacted function with its dominators computed
+ir_loops_t dcc_ir_loops(const ir_func_t *func);
+void dcc_ir_loops_free(ir_loops_t *loops);
+bool dcc_ir_in_loop(const ir_loops_t *loops, uint32_t loop, uint32_t block);
+
+// Give every loop a preheader, except one headed by the entry block, leaving
+// the function compacted with its dominators and `loops` recomputed
+void dcc_ir_preheaders(ir_func_t *func, ir_loops_t *loops);
+
+// Hoist invariant code out of the function's loops and reduce the strength of
+// their induction variable arithmetic
+void dcc_loop_optimize(ir_func_t *func);
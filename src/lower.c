@@ -0,0 +1,1440 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "init.h"
+#include "lower.h"
+#include "ssa.h"
+#include "switch.h"
+
+typedef struct {
+  enum {
+    LOCAL_VAR,
+    LOCAL_SLOT,
+    LOCAL_ADDRESS, // an aggregate parameter, at the address it arrives at
+  } tag;
+  uint32_t index; // of the variable or slot
+  ir_ref_t address;
+} local_t;
+
+// The object an expression designates
+typedef struct {
+  const type_t *type;
+  bool is_var;
+  uint32_t var;
+  ir_ref_t address;
+  uint8_t bit_offset, bit_width; // bit_width is zero unless a bit-field
+  bool is_union_member; // of a union, directly or through an enclosing member
+} lvalue_t;
+
+typedef struct {
+  switch_case_vec_t cases; // targeting blocks
+  uint32_t default_block; // IR_NONE if there is no default label
+} switch_t;
+
+typedef struct {
+  ir_func_t *func;
+  uint32_t block; // where instructions go
+  ptrmap_t escaped; // locals whose address is taken
+  ptrmap_t locals; // symbol -> local_t
+  ptrmap_t labels; // symbol -> block + 1
+  uint32_t break_block, continue_block; // IR_NONE outside of loops
+  switch_t *switch_; // the innermost switch
+  const type_t *ret;
+  bool is_main;
+} lower_t;
+
+static const type_t* value_type(const exp_t *exp) {
+  return dcc_type_decay(exp->type)->unqual;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Emitting
+////////////////////////////////////////////////////////////////////////////////
+
+static ir_ref_t emit(lower_t *lower, enum ir_op op, ir_kind_t kind, uint32_t count,
+                     const ir_ref_t *args) {
+  return dcc_ir_append(lower->func, lower->block, op, kind, count, args);
+}
+
+static ir_ref_t emit1(lower_t *lower, enum ir_op op, ir_kind_t kind, ir_ref_t a) {
+  return emit(lower, op, kind, 1, &a);
+}
+
+static ir_ref_t emit2(lower_t *lower, enum ir_op op, ir_kind_t kind, ir_ref_t a, ir_ref_t b) {
+  ir_ref_t args[] = { a, b };
+  return emit(lower, op, kind, 2, args);
+}
+
+static ir_ref_t constant(lower_t *lower, ir_kind_t kind, int64_t imm) {
+  ir_ref_t ref = emit(lower, IR_CONST, kind, 0, 0);
+  lower->func->instrs.data[ref].imm = imm;
+  return ref;
+}
+
+static ir_ref_t fconstant(lower_t *lower, ir_kind_t kind, double fimm) {
+  ir_ref_t ref = emit(lower, IR_FCONST, kind, 0, 0);
+  lower->func->instrs.data[ref].fimm = fimm;
+  return ref;
+}
+
+static ir_ref_t slot_address(lower_t *lower, uint32_t slot) {
+  ir_ref_t ref = emit(lower, IR_SLOT, IR_I64, 0, 0);
+  lower->func->instrs.data[ref].imm = slot;
+  return ref;
+}
+
+static uint32_t new_slot(lower_t *lower, const type_t *type, symbol_t *symbol) {
+  ir_slot_t slot = { dcc_type_size(type), dcc_type_align(type), symbol };
+  ir_slot_vec_push(&lower->func->slots, slot);
+  return lower->func->slots.size - 1;
+}
+
+static ir_ref_t offset_address(lower_t *lower, ir_ref_t address, uint64_t offset) {
+  return offset ? emit2(lower, IR_ADD, IR_I64, address, constant(lower, IR_I64, offset))
+    : address;
+}
+
+static bool is_terminated(lower_t *lower) {
+  return dcc_ir_terminator(lower->func, lower->block) != IR_NONE;
+}
+
+// Jump to `target`, unless the current block has already left
+static void jump(lower_t *lower, uint32_t target) {
+  if (!is_terminated(lower)) {
+    emit(lower, IR_JMP, IR_VOID, 0, 0);
+    dcc_ir_edge(lower->func, lower->block, target);
+  }
+}
+
+static void branch(lower_t *lower, ir_ref_t cond, uint32_t then, uint32_t otherwise) {
+  if (then == otherwise) {
+    jump(lower, then);
+    return;
+  }
+  emit1(lower, IR_BR, IR_VOID, cond);
+  dcc_ir_edge(lower->func, lower->block, then);
+  dcc_ir_edge(lower->func, lower->block, otherwise);
+}
+
+// Continue in `block`, falling through to it from the current one
+static void start(lower_t *lower, uint32_t block) {
+  jump(lower, block);
+  lower->block = block;
+}
+
+// Continue after a jump, in a block nothing reaches unless a label follows
+static void start_unreachable(lower_t *lower) {
+  lower->block = dcc_ir_block(lower->func);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Conversions and arithmetic
+////////////////////////////////////////////////////////////////////////////////
+
+// An IR_I32 that is 1 if `value` of `type` is nonzero
+static ir_ref_t nonzero(lower_t *lower, ir_ref_t value, const type_t *type) {
+  ir_kind_t kind = dcc_ir_kind(type);
+  if (dcc_type_is_float(type)) {
+    return emit2(lower, IR_FNE, IR_I32, value, fconstant(lower, kind, 0));
+  }
+  return emit2(lower, IR_NE, IR_I32, value, constant(lower, kind, 0));
+}
+
+static ir_ref_t convert(lower_t *lower, ir_ref_t value, const type_t *from, const type_t *to) {
+  if (to->tag == TYPE_VOID) {
+    return IR_NONE;
+  } else if (dcc_type_is_record(to) || from == to) {
+    return value;
+  } else if (to->tag == TYPE_BOOL) {
+    return from->tag == TYPE_BOOL ? value
+      : emit1(lower, IR_TRUNC, IR_I8, nonzero(lower, value, from));
+  }
+
+  ir_kind_t fk = dcc_ir_kind(from), tk = dcc_ir_kind(to);
+  bool is_signed = dcc_type_is_signed(from);
+  if (!dcc_type_is_float(from) && !dcc_type_is_float(to)) {
+    if (fk == tk) {
+      return value;
+    }
+    return emit1(lower, tk < fk ? IR_TRUNC : is_signed ? IR_SEXT : IR_ZEXT, tk, value);
+  } else if (!dcc_type_is_float(from)) {
+    // only 32 and 64-bit integers convert, and only signed ones cheaply
+    if (fk < IR_I32 || (!is_signed && fk == IR_I32)) {
+      ir_kind_t wide = fk < IR_I32 ? IR_I32 : IR_I64;
+      value = emit1(lower, is_signed ? IR_SEXT : IR_ZEXT, wide, value);
+      is_signed = true;
+    }
+    return emit1(lower, is_signed ? IR_SITOF : IR_UITOF, tk, value);
+  } else if (!dcc_type_is_float(to)) {
+    bool to_signed = dcc_type_is_signed(to);
+    if (tk == IR_I64) {
+      return emit1(lower, to_signed ? IR_FTOSI : IR_FTOUI, tk, value);
+    }
+    // an unsigned int needs the 64-bit conversion to cover its range
+    ir_kind_t wide = to_signed ? IR_I32 : IR_I64;
+    value = emit1(lower, IR_FTOSI, wide, value);
+    return tk == wide ? value : emit1(lower, IR_TRUNC, tk, value);
+  }
+  return fk == tk ? value : emit1(lower, IR_FCONV, tk, value);
+}
+
+// `a op b` for operands of arithmetic `type`
+static ir_ref_t arith(lower_t *lower, enum exp_tag op, ir_ref_t a, ir_ref_t b,
+                      const type_t *type) {
+  ir_kind_t kind = dcc_ir_kind(type);
+  bool is_signed = dcc_type_is_signed(type);
+  enum ir_op ir_op = IR_NOP;
+  if (dcc_type_is_float(type)) {
+    switch (op) {
+    case EXP_ADD: ir_op = IR_FADD; break;
+    case EXP_SUBTRACT: ir_op = IR_FSUB; break;
+    case EXP_MULTIPLY: ir_op = IR_FMUL; break;
+    case EXP_DIVIDE: ir_op = IR_FDIV; break;
+    default: dcc_ice("not a floating operator: %d", op);
+    }
+    return emit2(lower, ir_op, kind, a, b);
+  }
+
+  switch (op) {
+  case EXP_ADD: ir_op = IR_ADD; break;
+  case EXP_SUBTRACT: ir_op = IR_SUB; break;
+  case EXP_MULTIPLY: ir_op = IR_MUL; break;
+  case EXP_DIVIDE: ir_op = is_signed ? IR_SDIV : IR_UDIV; break;
+  case EXP_MODULO: ir_op = is_signed ? IR_SREM : IR_UREM; break;
+  case EXP_BITAND: ir_op = IR_AND; break;
+  case EXP_BITOR: ir_op = IR_OR; break;
+  case EXP_BITXOR: ir_op = IR_XOR; break;
+  case EXP_SHIFTLEFT: ir_op = IR_SHL; break;
+  case EXP_SHIFTRIGHT: ir_op = is_signed ? IR_SAR : IR_SHR; break;
+  default: dcc_ice("not an arithmetic operator: %d", op);
+  }
+  ir_ref_t ref = emit2(lower, ir_op, kind, a, b);
+  if (is_signed && (ir_op == IR_ADD || ir_op == IR_SUB || ir_op == IR_MUL)) {
+    lower->func->instrs.data[ref].flags = IR_NO_WRAP;
+  }
+  return ref;
+}
+
+static ir_ref_t pointer_add(lower_t *lower, ir_ref_t pointer, const type_t *type,
+                            ir_ref_t index, const type_t *index_type, bool subtract) {
+  index = convert(lower, index, index_type, dcc_type_basic(TYPE_LONG));
+  uint64_t size = dcc_type_step(type);
+  if (size != 1) {
+    index = emit2(lower, IR_MUL, IR_I64, index, constant(lower, IR_I64, size));
+  }
+  return emit2(lower, subtract ? IR_SUB : IR_ADD, IR_I64, pointer, index);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Objects
+////////////////////////////////////////////////////////////////////////////////
+
+static lvalue_t memory(const type_t *type, ir_ref_t address) {
+  lvalue_t lvalue = { type, false, 0, address, 0, 0, false };
+  return lvalue;
+}
+
+// The flags of a load or store of an object
+static uint16_t access_flags(const lvalue_t *lvalue) {
+  uint16_t flags = lvalue->type->qual & TYPE_QUAL_VOLATILE ? IR_VOLATILE : 0;
+  return flags | (lvalue->bit_width || lvalue->is_union_member ? IR_ANY_TYPE : 0);
+}
+
+// The value of a bit-field from the storage unit holding it
+static ir_ref_t extract(lower_t *lower, ir_ref_t unit, const lvalue_t *lvalue) {
+  ir_kind_t kind = dcc_ir_kind(lvalue->type);
+  int bits = dcc_type_size(lvalue->type) * 8;
+  if (dcc_type_is_signed(lvalue->type)) {
+    int left = bits - lvalue->bit_offset - lvalue->bit_width;
+    if (left) {
+      unit = emit2(lower, IR_SHL, kind, unit, constant(lower, kind, left));
+    }
+    return emit2(lower, IR_SAR, kind, unit, constant(lower, kind, bits - lvalue->bit_width));
+  }
+  if (lvalue->bit_offset) {
+    unit = emit2(lower, IR_SHR, kind, unit, constant(lower, kind, lvalue->bit_offset));
+  }
+  uint64_t mask = lvalue->bit_width == 64 ? UINT64_MAX : (1ull << lvalue->bit_width) - 1;
+  return emit2(lower, IR_AND, kind, unit, constant(lower, kind, mask));
+}
+
+// The value of a scalar object, or the address of any other
+static ir_ref_t load(lower_t *lower, const lvalue_t *lvalue) {
+  const type_t *type = lvalue->type;
+  if (lvalue->is_var) {
+    ir_ref_t ref = emit(lower, IR_GET, dcc_ir_kind(type), 0, 0);
+    lower->func->instrs.data[ref].imm = lvalue->var;
+    return ref;
+  } else if (!dcc_type_is_scalar(type)) {
+    return lvalue->address;
+  }
+  ir_ref_t value = emit1(lower, IR_LOAD, dcc_ir_kind(type), lvalue->address);
+  lower->func->instrs.data[value].flags = access_flags(lvalue);
+  return lvalue->bit_width ? extract(lower, value, lvalue) : value;
+}
+
+// Store `value`, converted to the object's type already, and return the value
+// the object then has
+static ir_ref_t store(lower_t *lower, const lvalue_t *lvalue, ir_ref_t value) {
+  const type_t *type = lvalue->type;
+  ir_func_t *func = lower->func;
+  if (lvalue->is_var) {
+    ir_ref_t set = emit1(lower, IR_SET, IR_VOID, value);
+    func->instrs.data[set].imm = lvalue->var;
+    return value;
+  } else if (!dcc_type_is_scalar(type)) {
+    ir_ref_t copy = emit2(lower, IR_MEMCPY, IR_VOID, lvalue->address, value);
+    func->instrs.data[copy].imm = dcc_type_size(type);
+    return lvalue->address;
+  }
+
+  ir_kind_t kind = dcc_ir_kind(type);
+  ir_ref_t unit = value;
+  if (lvalue->bit_width) {
+    uint64_t mask = lvalue->bit_width == 64 ? UINT64_MAX : (1ull << lvalue->bit_width) - 1;
+    ir_ref_t old = emit1(lower, IR_LOAD, kind, lvalue->address);
+    func->instrs.data[old].flags = access_flags(lvalue);
+    old = emit2(lower, IR_AND, kind, old,
+                constant(lower, kind, ~(mask << lvalue->bit_offset)));
+    unit = emit2(lower, IR_AND, kind, value, constant(lower, kind, mask));
+    if (lvalue->bit_offset) {
+      unit = emit2(lower, IR_SHL, kind, unit, constant(lower, kind, lvalue->bit_offset));
+    }
+    unit = emit2(lower, IR_OR, kind, old, unit);
+  }
+  ir_ref_t ref = emit2(lower, IR_STORE, IR_VOID, lvalue->address, unit);
+  func->instrs.data[ref].flags = access_flags(lvalue);
+  return lvalue->bit_width ? extract(lower, unit, lvalue) : value;
+}
+
+static ir_ref_t rvalue(lower_t *lower, exp_t *exp);
+static void condition(lower_t *lower, exp_t *exp, uint32_t then, uint32_t otherwise);
+
+// Whether a member access goes through a union, whose members share memory
+// whatever their types
+static bool through_union(exp_t *exp) {
+  for (; exp->tag == EXP_DOT || exp->tag == EXP_ARROW; exp = exp->child.lhs) {
+    const type_t *record = exp->tag == EXP_ARROW ? value_type(exp->child.lhs)->base
+      : exp->child.lhs->type;
+    if (record->tag == TYPE_UNION) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static lvalue_t member(lower_t *lower, exp_t *exp) {
+  // the value of a struct is its address, which is also the base of an arrow
+  const type_t *record = exp->tag == EXP_ARROW ? value_type(exp->child.lhs)->base
+    : exp->child.lhs->type;
+  ir_ref_t base = rvalue(lower, exp->child.lhs);
+  const member_t *member = dcc_record_member(record->record, exp->child.name.name);
+  lvalue_t lvalue = memory(exp->type, offset_address(lower, base, member->offset));
+  lvalue.bit_offset = member->bit_offset;
+  lvalue.bit_width = member->bit_width;
+  lvalue.is_union_member = through_union(exp);
+  return lvalue;
+}
+
+static void init_object(lower_t *lower, ir_ref_t address, const type_t *type,
+                        initializer_t *init);
+
+static lvalue_t lvalue(lower_t *lower, exp_t *exp) {
+  switch (exp->tag) {
+  case EXP_IDENT: {
+    symbol_t *symbol = exp->ident.symbol;
+    local_t *local = dcc_ptrmap_get(&lower->locals, symbol);
+    if (!local) {
+      ir_ref_t ref = emit(lower, IR_GLOBAL, IR_I64, 0, 0);
+      lower->func->instrs.data[ref].symbol = symbol;
+      return memory(exp->type, ref);
+    } else if (local->tag == LOCAL_VAR) {
+      lvalue_t lvalue = { exp->type, true, local->index, IR_NONE, 0, 0 };
+      return lvalue;
+    }
+    return memory(exp->type, local->tag == LOCAL_SLOT
+                  ? slot_address(lower, local->index) : local->address);
+  }
+  case EXP_STRING: {
+    ir_ref_t ref = emit(lower, IR_STRING, IR_I64, 0, 0);
+    lower->func->instrs.data[ref].string = exp->string;
+    return memory(exp->type, ref);
+  }
+  case EXP_STRUCT: {
+    initializer_t init;
+    init.tag = INIT_LIST;
+    init.inits = exp->struct_init.inits;
+    ir_ref_t address = slot_address(lower, new_slot(lower, exp->type, 0));
+    init_object(lower, address, exp->type, &init);
+    return memory(exp->type, address);
+  }
+  case EXP_DEREFERENCE:
+    return memory(exp->type, rvalue(lower, exp->unary));
+  case EXP_INDEX: {
+    exp_t *pointer = exp->binary.lhs, *index = exp->binary.rhs;
+    if (value_type(index)->tag == TYPE_POINTER) {
+      exp_t *swap = pointer;
+      pointer = index;
+      index = swap;
+    }
+    ir_ref_t base = rvalue(lower, pointer);
+    ir_ref_t offset = rvalue(lower, index);
+    return memory(exp->type, pointer_add(lower, base, value_type(pointer), offset,
+                                         value_type(index), false));
+  }
+  case EXP_DOT:
+  case EXP_ARROW:
+    return member(lower, exp);
+  default:
+    // an aggregate rvalue, which lives in a temporary
+    dcc_assert(dcc_type_is_record(exp->type));
+    return memory(exp->type, rvalue(lower, exp));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Expressions
+////////////////////////////////////////////////////////////////////////////////
+
+// `old op operand` converted back to the type of `old`, for compound
+// assignments and increments
+static ir_ref_t combine(lower_t *lower, enum exp_tag op, ir_ref_t old, const type_t *type,
+                        ir_ref_t operand, const type_t *operand_type) {
+  if (type->tag == TYPE_POINTER) {
+    return pointer_add(lower, old, type, operand, operand_type, op == EXP_SUBTRACT);
+  }
+  const type_t *common = dcc_type_operation(op, type, operand_type);
+  ir_ref_t a = convert(lower, old, type, common);
+  ir_ref_t b = convert(lower, operand, operand_type, common);
+  return convert(lower, arith(lower, op, a, b, common), common, type);
+}
+
+static ir_ref_t compare(lower_t *lower, exp_t *exp) {
+  exp_t *lhs = exp->binary.lhs, *rhs = exp->binary.rhs;
+  const type_t *a = value_type(lhs), *b = value_type(rhs);
+  ir_ref_t x = rvalue(lower, lhs), y = rvalue(lower, rhs);
+  const type_t *type = dcc_type_comparison(a, b);
+  x = convert(lower, x, a, type);
+  y = convert(lower, y, b, type);
+
+  static const enum ir_op OPS[][3] = {
+    // floating, signed, unsigned
+    { IR_FLT, IR_SLT, IR_ULT },
+    { IR_FGT, IR_SGT, IR_UGT },
+    { IR_FLE, IR_SLE, IR_ULE },
+    { IR_FGE, IR_SGE, IR_UGE },
+    { IR_FEQ, IR_EQ, IR_EQ },
+    { IR_FNE, IR_NE, IR_NE },
+  };
+  int row;
+  switch (exp->tag) {
+  case EXP_LESS: row = 0; break;
+  case EXP_MORE: row = 1; break;
+  case EXP_LESSEQ: row = 2; break;
+  case EXP_MOREEQ: row = 3; break;
+  case EXP_EQUAL: row = 4; break;
+  default: row = 5; break;
+  }
+  int column = dcc_type_is_float(type) ? 0 : dcc_type_is_signed(type) ? 1 : 2;
+  return emit2(lower, OPS[row][column], IR_I32, x, y);
+}
+
+static ir_ref_t binary(lower_t *lower, exp_t *exp) {
+  exp_t *lhs = exp->binary.lhs, *rhs = exp->binary.rhs;
+  const type_t *a = value_type(lhs), *b = value_type(rhs), *type = value_type(exp);
+  ir_ref_t x = rvalue(lower, lhs), y = rvalue(lower, rhs);
+  bool subtract = exp->tag == EXP_SUBTRACT;
+  if (a->tag == TYPE_POINTER && b->tag == TYPE_POINTER) {
+    ir_ref_t diff = emit2(lower, IR_SUB, IR_I64, x, y);
+    uint64_t size = dcc_type_step(a);
+    return size == 1 ? diff : emit2(lower, IR_SDIV, IR_I64, diff, constant(lower, IR_I64, size));
+  } else if (a->tag == TYPE_POINTER) {
+    return pointer_add(lower, x, a, y, b, subtract);
+  } else if (b->tag == TYPE_POINTER) {
+    return pointer_add(lower, y, b, x, a, false);
+  }
+  const type_t *common = dcc_type_operation(exp->tag, a, b);
+  x = convert(lower, x, a, common);
+  y = convert(lower, y, b, common);
+  return convert(lower, arith(lower, exp->tag, x, y, common), common, type);
+}
+
+static ir_ref_t assign(lower_t *lower, exp_t *exp) {
+  exp_t *lhs = exp->assignment.lhs, *rhs = exp->assignment.rhs;
+  lvalue_t target = lvalue(lower, lhs);
+  const type_t *type = value_type(lhs);
+  ir_ref_t value = rvalue(lower, rhs);
+  enum exp_tag op = exp->assignment.operator;
+  if (op == EXP_EQUAL) {
+    value = convert(lower, value, value_type(rhs), type);
+  } else {
+    value = combine(lower, op, load(lower, &target), type, value, value_type(rhs));
+  }
+  return store(lower, &target, value);
+}
+
+static ir_ref_t increment(lower_t *lower, exp_t *exp) {
+  bool is_increment = exp->tag == EXP_PREINCREMENT || exp->tag == EXP_POSTINCREMENT;
+  bool is_prefix = exp->tag == EXP_PREINCREMENT || exp->tag == EXP_PREDECREMENT;
+  lvalue_t target = lvalue(lower, exp->unary);
+  ir_ref_t old = load(lower, &target);
+  ir_ref_t value = combine(lower, is_increment ? EXP_ADD : EXP_SUBTRACT, old,
+                           value_type(exp->unary), constant(lower, IR_I32, 1),
+                           dcc_type_basic(TYPE_INT));
+  value = store(lower, &target, value);
+  return is_prefix ? value : old;
+}
+
+static ir_ref_t call(lower_t *lower, exp_t *exp) {
+  exp_t *callee = exp->call.lhs;
+  exp_vec_t *args = exp->call.args;
+  const type_t *func = value_type(callee)->base;
+  const type_t *ret = func->func.ret->unqual;
+  bool sret = dcc_type_is_record(ret);
+
+  ir_call_t *info = dcc_arena_alloc(&lower->func->arena, sizeof(ir_call_t));
+  info->func = func;
+  info->args = dcc_arena_alloc(&lower->func->arena, args->size * sizeof(type_t*));
+  uint32_t count = 1 + sret + args->size;
+  ir_ref_t *refs = dcc_malloc(count * sizeof(ir_ref_t));
+  refs[0] = rvalue(lower, callee);
+  for (size_t i = 0; i < args->size; i++) {
+    exp_t *arg = args->data[i];
+    info->args[i] = dcc_type_argument(func, i, value_type(arg));
+    refs[1 + sret + i] = convert(lower, rvalue(lower, arg), value_type(arg), info->args[i]);
+  }
+  if (sret) {
+    refs[1] = slot_address(lower, new_slot(lower, ret, 0));
+  }
+
+  ir_kind_t kind = sret ? IR_VOID : dcc_ir_kind(ret);
+  ir_ref_t ref = emit(lower, IR_CALL, kind, count, refs);
+  lower->func->instrs.data[ref].call = info;
+  ir_ref_t result = sret ? refs[1] : kind == IR_VOID ? IR_NONE : ref;
+  free(refs);
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Variable arguments
+////////////////////////////////////////////////////////////////////////////////
+
+// The six general argument registers come first in the save area, then the
+// eight vector ones, sixteen bytes each
+#define VA_GP_END 48
+#define VA_FP_END 176
+
+static ir_kind_t va_field_kind(uint32_t field) {
+  return field < IR_VA_STACK ? IR_I32 : IR_I64;
+}
+
+static ir_ref_t va_load(lower_t *lower, ir_ref_t ap, uint32_t field) {
+  return emit1(lower, IR_LOAD, va_field_kind(field), offset_address(lower, ap, field));
+}
+
+static void va_store(lower_t *lower, ir_ref_t ap, uint32_t field, ir_ref_t value) {
+  emit2(lower, IR_STORE, IR_VOID, offset_address(lower, ap, field), value);
+}
+
+static void va_start_list(lower_t *lower, ir_ref_t ap) {
+  static const uint32_t FIELDS[] = { IR_VA_GP, IR_VA_FP, IR_VA_STACK, IR_VA_SAVE_AREA };
+  for (size_t i = 0; i < sizeof FIELDS / sizeof *FIELDS; i++) {
+    ir_ref_t value = emit(lower, IR_VARARGS, va_field_kind(FIELDS[i]), 0, 0);
+    lower->func->instrs.data[value].imm = FIELDS[i];
+    va_store(lower, ap, FIELDS[i], value);
+  }
+}
+
+// The address of the next argument of `type` from the va_list at `ap`: in the
+// save area if it was passed in registers, which it was while enough of each
+// class were left, else on the stack
+static ir_ref_t va_arg_address(lower_t *lower, ir_ref_t ap, const type_t *type) {
+  ir_func_t *func = lower->func;
+  abi_class_t classes[2] = { dcc_type_is_float(type) ? CLASS_SSE : CLASS_INTEGER };
+  int n = dcc_type_is_record(type) ? dcc_type_classify(type, classes) : 1;
+  int ints = dcc_type_count_class(classes, n, CLASS_INTEGER);
+  int sses = dcc_type_count_class(classes, n, CLASS_SSE);
+  uint32_t on_stack = n ? dcc_ir_block(func) : lower->block, join = IR_NONE;
+  ir_ref_t addresses[2];
+  if (n) {
+    uint32_t in_regs = dcc_ir_block(func);
+    join = dcc_ir_block(func);
+    ir_ref_t gp = IR_NONE, fp = IR_NONE, fits = IR_NONE;
+    if (ints) {
+      gp = va_load(lower, ap, IR_VA_GP);
+      fits = emit2(lower, IR_ULE, IR_I32, gp, constant(lower, IR_I32, VA_GP_END - 8 * ints));
+    }
+    if (sses) {
+      fp = va_load(lower, ap, IR_VA_FP);
+      ir_ref_t room = emit2(lower, IR_ULE, IR_I32, fp,
+                            constant(lower, IR_I32, VA_FP_END - 16 * sses));
+      fits = fits == IR_NONE ? room : emit2(lower, IR_AND, IR_I32, fits, room);
+    }
+    branch(lower, fits, in_regs, on_stack);
+
+    lower->block = in_regs;
+    ir_ref_t area = va_load(lower, ap, IR_VA_SAVE_AREA);
+    if (!dcc_type_is_record(type)) {
+      addresses[0] = emit2(lower, IR_ADD, IR_I64, area,
+                           emit1(lower, IR_ZEXT, IR_I64, ints ? gp : fp));
+    } else {
+      // the eightbytes may come from both halves of the area, so they are
+      // gathered in a temporary
+      ir_slot_t slot = { 16, 8, 0 };
+      ir_slot_vec_push(&func->slots, slot);
+      addresses[0] = slot_address(lower, func->slots.size - 1);
+      ir_ref_t offsets[] = { gp, fp };
+      for (int j = 0; j < n; j++) {
+        bool is_sse = classes[j] == CLASS_SSE;
+        ir_ref_t from = emit2(lower, IR_ADD, IR_I64, area,
+                              emit1(lower, IR_ZEXT, IR_I64, offsets[is_sse]));
+        emit2(lower, IR_STORE, IR_VOID, offset_address(lower, addresses[0], 8 * j),
+              emit1(lower, IR_LOAD, IR_I64, from));
+        offsets[is_sse] = emit2(lower, IR_ADD, IR_I32, offsets[is_sse],
+                                constant(lower, IR_I32, is_sse ? 16 : 8));
+      }
+    }
+    if (ints) {
+      va_store(lower, ap, IR_VA_GP,
+               emit2(lower, IR_ADD, IR_I32, gp, constant(lower, IR_I32, 8 * ints)));
+    }
+    if (sses) {
+      va_store(lower, ap, IR_VA_FP,
+               emit2(lower, IR_ADD, IR_I32, fp, constant(lower, IR_I32, 16 * sses)));
+    }
+    jump(lower, join);
+  }
+
+  lower->block = on_stack;
+  ir_ref_t stack = va_load(lower, ap, IR_VA_STACK);
+  if (dcc_type_align(type) > 8) {
+    stack = emit2(lower, IR_AND, IR_I64, emit2(lower, IR_ADD, IR_I64, stack,
+                                               constant(lower, IR_I64, 15)),
+                  constant(lower, IR_I64, -16));
+  }
+  uint64_t size = (dcc_type_size(type) + 7) / 8 * 8;
+  va_store(lower, ap, IR_VA_STACK, offset_address(lower, stack, size));
+  addresses[1] = stack;
+  if (!n) {
+    return stack;
+  }
+  jump(lower, join);
+  lower->block = join;
+  return emit(lower, IR_PHI, IR_I64, 2, addresses);
+}
+
+static ir_ref_t builtin(lower_t *lower, exp_t *exp) {
+  switch (exp->tag) {
+  case EXP_VA_START:
+    va_start_list(lower, rvalue(lower, exp->binary.lhs));
+    break;
+  case EXP_VA_ARG: {
+    ir_ref_t ap = rvalue(lower, exp->cast.value);
+    lvalue_t object = memory(value_type(exp), va_arg_address(lower, ap, value_type(exp)));
+    return load(lower, &object);
+  }
+  case EXP_VA_COPY: {
+    ir_ref_t to = rvalue(lower, exp->binary.lhs), from = rvalue(lower, exp->binary.rhs);
+    ir_ref_t copy = emit2(lower, IR_MEMCPY, IR_VOID, to, from);
+    lower->func->instrs.data[copy].imm = IR_VA_LIST_SIZE;
+    break;
+  }
+  default:
+    rvalue(lower, exp->unary);
+    break;
+  }
+  return IR_NONE;
+}
+
+// The 0 or 1 of a logical expression
+static ir_ref_t logical(lower_t *lower, exp_t *exp) {
+  ir_func_t *func = lower->func;
+  uint32_t then = dcc_ir_block(func), otherwise = dcc_ir_block(func);
+  uint32_t join = dcc_ir_block(func);
+  condition(lower, exp, then, otherwise);
+  ir_ref_t values[2];
+  lower->block = then;
+  values[0] = constant(lower, IR_I32, 1);
+  jump(lower, join);
+  lower->block = otherwise;
+  values[1] = constant(lower, IR_I32, 0);
+  jump(lower, join);
+  lower->block = join;
+  return emit(lower, IR_PHI, IR_I32, 2, values);
+}
+
+static ir_ref_t ternary(lower_t *lower, exp_t *exp) {
+  ir_func_t *func = lower->func;
+  const type_t *type = value_type(exp);
+  exp_t *arms[] = { exp->ternary.true_exp, exp->ternary.false_exp };
+  uint32_t blocks[] = { dcc_ir_block(func), dcc_ir_block(func) };
+  uint32_t join = dcc_ir_block(func);
+  condition(lower, exp->ternary.cond, blocks[0], blocks[1]);
+
+  // each arm ends in a single jump to the join, so its phi operands are in order
+  ir_ref_t values[2];
+  for (int i = 0; i < 2; i++) {
+    lower->block = blocks[i];
+    values[i] = convert(lower, rvalue(lower, arms[i]), value_type(arms[i]), type);
+    jump(lower, join);
+  }
+  lower->block = join;
+  return type->tag == TYPE_VOID ? IR_NONE : emit(lower, IR_PHI, dcc_ir_kind(type), 2, values);
+}
+
+// The value of `exp` after decay, which is an address for an aggregate, or
+// IR_NONE if it is void
+static ir_ref_t rvalue(lower_t *lower, exp_t *exp) {
+  const type_t *type = value_type(exp);
+  switch (exp->tag) {
+  case EXP_CONSTANT:
+    if (dcc_type_is_float(type)) {
+      return fconstant(lower, dcc_ir_kind(type), exp->constant->floating);
+    }
+    return constant(lower, dcc_ir_kind(type), exp->constant->integer);
+  case EXP_IDENT:
+    if (exp->ident.symbol->tag == SYM_ENUM_CONST) {
+      return constant(lower, dcc_ir_kind(type), exp->ident.symbol->enumtor->value);
+    }
+    // fall through
+  case EXP_STRING:
+  case EXP_STRUCT:
+  case EXP_DEREFERENCE:
+  case EXP_INDEX:
+  case EXP_DOT:
+  case EXP_ARROW: {
+    lvalue_t object = lvalue(lower, exp);
+    return load(lower, &object);
+  }
+  case EXP_ADDRESSOF: {
+    lvalue_t object = lvalue(lower, exp->unary);
+    dcc_assert(!object.is_var);
+    return object.address;
+  }
+  case EXP_SIZEOFEXP:
+    return constant(lower, IR_I64, dcc_type_size(exp->unary->type));
+  case EXP_SIZEOFTYPE:
+    return constant(lower, IR_I64, dcc_type_size(exp->cast.type->type));
+  case EXP_CAST: {
+    exp_t *value = exp->cast.value;
+    return convert(lower, rvalue(lower, value), value_type(value), type);
+  }
+  case EXP_NEGATE:
+  case EXP_BITNOT: {
+    ir_ref_t value = convert(lower, rvalue(lower, exp->unary), value_type(exp->unary), type);
+    enum ir_op op = exp->tag == EXP_BITNOT ? IR_NOT : dcc_type_is_float(type) ? IR_FNEG : IR_NEG;
+    return emit1(lower, op, dcc_ir_kind(type), value);
+  }
+  case EXP_LOGICNOT: {
+    const type_t *operand = value_type(exp->unary);
+    ir_ref_t value = rvalue(lower, exp->unary);
+    ir_kind_t kind = dcc_ir_kind(operand);
+    if (dcc_type_is_float(operand)) {
+      return emit2(lower, IR_FEQ, IR_I32, value, fconstant(lower, kind, 0));
+    }
+    return emit2(lower, IR_EQ, IR_I32, value, constant(lower, kind, 0));
+  }
+  case EXP_LOGICAND:
+  case EXP_LOGICOR:
+    return logical(lower, exp);
+  case EXP_TERNARY:
+    return ternary(lower, exp);
+  case EXP_ASSIGN:
+    return assign(lower, exp);
+  case EXP_PREINCREMENT:
+  case EXP_PREDECREMENT:
+  case EXP_POSTINCREMENT:
+  case EXP_POSTDECREMENT:
+    return increment(lower, exp);
+  case EXP_CALL:
+    return call(lower, exp);
+  case EXP_VA_START:
+  case EXP_VA_ARG:
+  case EXP_VA_COPY:
+  case EXP_VA_END:
+    return builtin(lower, exp);
+  case EXP_LIST:
+    for (size_t i = 0; i + 1 < exp->list.size; i++) {
+      rvalue(lower, exp->list.data[i]);
+    }
+    return rvalue(lower, exp->list.data[exp->list.size - 1]);
+  case EXP_LESS:
+  case EXP_MORE:
+  case EXP_LESSEQ:
+  case EXP_MOREEQ:
+  case EXP_EQUAL:
+  case EXP_NOTEQUAL:
+    return compare(lower, exp);
+  case EXP_UNKNOWN:
+    dcc_ice("lowering an unknown expression");
+  default:
+    return binary(lower, exp);
+  }
+}
+
+// Branch on `exp`, without materializing the value of && and ||
+static void condition(lower_t *lower, exp_t *exp, uint32_t then, uint32_t otherwise) {
+  switch (exp->tag) {
+  case EXP_LOGICAND:
+  case EXP_LOGICOR: {
+    uint32_t rhs = dcc_ir_block(lower->func);
+    if (exp->tag == EXP_LOGICAND) {
+      condition(lower, exp->binary.lhs, rhs, otherwise);
+    } else {
+      condition(lower, exp->binary.lhs, then, rhs);
+    }
+    lower->block = rhs;
+    condition(lower, exp->binary.rhs, then, otherwise);
+    return;
+  }
+  case EXP_LOGICNOT:
+    condition(lower, exp->unary, otherwise, then);
+    return;
+  case EXP_CONSTANT:
+    if (exp->constant->tag != CONSTANT_FLOAT) {
+      jump(lower, exp->constant->integer ? then : otherwise);
+      return;
+    }
+    break;
+  default:
+    break;
+  }
+
+  const type_t *type = value_type(exp);
+  ir_ref_t value = rvalue(lower, exp);
+  branch(lower, dcc_type_is_float(type) ? nonzero(lower, value, type) : value, then, otherwise);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Declarations
+////////////////////////////////////////////////////////////////////////////////
+
+// Fill the object at `address` from `init`
+static void init_object(lower_t *lower, ir_ref_t address, const type_t *type,
+                        initializer_t *init) {
+  if (init->tag == INIT_EXP && type->tag != TYPE_ARRAY) {
+    lvalue_t target = memory(type, address);
+    exp_t *exp = init->expression;
+    store(lower, &target, convert(lower, rvalue(lower, exp), value_type(exp), type->unqual));
+    return;
+  }
+
+  ir_ref_t zero = emit1(lower, IR_MEMZERO, IR_VOID, address);
+  lower->func->instrs.data[zero].imm = dcc_type_size(type);
+  int64_t length;
+  init_entry_vec_t entries = dcc_init_layout(type, init, 0, &length);
+  for (size_t i = 0; i < entries.size; i++) {
+    init_entry_t *entry = &entries.data[i];
+    ir_ref_t at = offset_address(lower, address, entry->offset);
+    exp_t *exp = entry->exp;
+    if (entry->type->tag == TYPE_ARRAY) {
+      ir_ref_t copy = emit2(lower, IR_MEMCPY, IR_VOID, at, rvalue(lower, exp));
+      lower->func->instrs.data[copy].imm = dcc_init_string_size(entry);
+      continue;
+    }
+    lvalue_t target = memory(entry->type, at);
+    target.bit_offset = entry->bit_offset;
+    target.bit_width = entry->bit_width;
+    store(lower, &target, convert(lower, rvalue(lower, exp), value_type(exp),
+                                  entry->type->unqual));
+  }
+  init_entry_vec_free(&entries);
+}
+
+static local_t* new_local(lower_t *lower, symbol_t *symbol) {
+  ir_func_t *func = lower->func;
+  const type_t *type = symbol->type;
+  local_t *local = dcc_arena_alloc(&func->arena, sizeof(local_t));
+  if (dcc_type_is_scalar(type) && !(type->qual & TYPE_QUAL_VOLATILE)
+      && !dcc_ptrmap_get(&lower->escaped, symbol)) {
+    local->tag = LOCAL_VAR;
+    local->index = func->vars.size;
+    const decl_spec_t *specs = symbol->decl.specs;
+    ir_var_t var = { dcc_ir_kind(type),
+                     specs && (specs->storage & AST_STORAGE_REGISTER) ? IR_REGISTER : 0 };
+    ir_var_vec_push(&func->vars, var);
+  } else {
+    local->tag = LOCAL_SLOT;
+    local->index = new_slot(lower, type, symbol);
+  }
+  dcc_ptrmap_put(&lower->locals, symbol, local);
+  return local;
+}
+
+static void lower_decl(lower_t *lower, decl_t *decl) {
+  // static and extern locals have static storage, which is laid out elsewhere
+  if (decl->specifiers->storage & (AST_STORAGE_TYPEDEF | AST_STORAGE_EXTERN
+                                   | AST_STORAGE_STATIC)) {
+    return;
+  }
+  for (size_t i = 0; i < decl->init_decltors.size; i++) {
+    init_decltor_t *init_decltor = decl->init_decltors.data[i];
+    ident_t *ident = dcc_decltor_ident(init_decltor->declarator);
+    symbol_t *symbol = ident ? ident->symbol : 0;
+    if (!symbol || symbol->tag != SYM_OBJECT) {
+      continue;
+    }
+    local_t *local = new_local(lower, symbol);
+    initializer_t *init = init_decltor->initializer;
+    if (!init) {
+      continue;
+    } else if (local->tag == LOCAL_SLOT) {
+      init_object(lower, slot_address(lower, local->index), symbol->type, init);
+      continue;
+    }
+
+    // a scalar may still be braced
+    while (init->tag == INIT_LIST) {
+      init = init->inits->data[0].initializer;
+    }
+    lvalue_t target = { symbol->type, true, local->index, IR_NONE, 0, 0 };
+    exp_t *exp = init->expression;
+    store(lower, &target, convert(lower, rvalue(lower, exp), value_type(exp),
+                                  symbol->type->unqual));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Statements
+////////////////////////////////////////////////////////////////////////////////
+
+static void lower_stmt(lower_t *lower, stmt_t *stmt);
+
+static void lower_items(lower_t *lower, block_item_vec_t *items) {
+  for (size_t i = 0; i < items->size; i++) {
+    block_item_t *item = items->data[i];
+    if (item->tag == AST_DECLARATION) {
+      lower_decl(lower, item->declaration);
+    } else {
+      lower_stmt(lower, item->statement);
+    }
+  }
+}
+
+static uint32_t label_block(lower_t *lower, symbol_t *label) {
+  uint32_t block = (uintptr_t)dcc_ptrmap_get(&lower->labels, label);
+  if (!block) {
+    block = dcc_ir_block(lower->func) + 1;
+    dcc_ptrmap_put(&lower->labels, label, (void*)(uintptr_t)block);
+  }
+  return block - 1;
+}
+
+// Lower the body of a loop, which breaks to `exit` and continues at `next`
+static void loop_body(lower_t *lower, stmt_t *body, uint32_t exit, uint32_t next) {
+  uint32_t outer_break = lower->break_block, outer_continue = lower->continue_block;
+  lower->break_block = exit;
+  lower->continue_block = next;
+  lower_stmt(lower, body);
+  lower->break_block = outer_break;
+  lower->continue_block = outer_continue;
+}
+
+// The value a function returns when control reaches its end
+static void return_default(lower_t *lower) {
+  ir_kind_t kind = dcc_ir_kind(lower->ret);
+  if (lower->ret->tag == TYPE_VOID) {
+    emit(lower, IR_RET, IR_VOID, 0, 0);
+  } else if (lower->is_main) {
+    emit1(lower, IR_RET, IR_VOID, constant(lower, kind, 0));
+  } else {
+    emit1(lower, IR_RET, IR_VOID, emit(lower, IR_UNDEF, kind, 0, 0));
+  }
+}
+
+// The dispatch of a switch on `value` by its plan
+typedef struct {
+  ir_ref_t value;
+  ir_kind_t kind;
+  bool is_signed;
+  const switch_case_vec_t *cases;
+  const switch_plan_t *plan;
+} dispatch_t;
+
+// The index of `target` among the successors of the current block, adding an
+// edge to it if there is none
+static uint32_t succ_index(lower_t *lower, uint32_t target) {
+  uint32_vec_t *succs = &lower->func->blocks.data[lower->block].succs;
+  for (uint32_t s = 0; s < succs->size; s++) {
+    if (succs->data[s] == target) {
+      return s;
+    }
+  }
+  dcc_ir_edge(lower->func, lower->block, target);
+  return succs->size - 1;
+}
+
+// Test the value against one cluster, going on to `fail` if it misses
+static void lower_cluster(lower_t *lower, const dispatch_t *d, const switch_cluster_t *cluster,
+                          uint32_t fail) {
+  ir_func_t *func = lower->func;
+  const switch_case_t *cases = d->cases->data + cluster->first;
+  int64_t low = cluster->low;
+  if (cluster->tag == SWITCH_CASE) {
+    ir_ref_t match = emit2(lower, IR_EQ, IR_I32, d->value, constant(lower, d->kind, low));
+    branch(lower, match, cases[0].target, fail);
+    return;
+  }
+
+  uint64_t range = cluster->range;
+  ir_ref_t index = d->value;
+  if (low) {
+    index = emit2(lower, IR_SUB, d->kind, index, constant(lower, d->kind, low));
+  }
+  if (cluster->tag == SWITCH_TABLE) {
+    ir_ref_t ref = emit1(lower, IR_SWITCH, IR_VOID, index);
+    ir_table_t *table = dcc_arena_alloc(&func->arena, sizeof(ir_table_t));
+    table->size = range;
+    table->succs = dcc_arena_alloc(&func->arena, range * sizeof(uint32_t));
+    func->instrs.data[ref].table = table;
+    dcc_ir_edge(func, lower->block, fail);
+    for (uint64_t e = 0; e < range; e++) {
+      table->succs[e] = 0;
+    }
+    for (uint32_t i = 0; i < cluster->count; i++) {
+      uint64_t e = (uint64_t)cases[i].value - (uint64_t)low;
+      table->succs[e] = succ_index(lower, cases[i].target);
+    }
+    return;
+  }
+
+  // a bit test: the index selects a bit of the mask of each target
+  uint32_t test = dcc_ir_block(func);
+  ir_ref_t in_range = emit2(lower, IR_ULE, IR_I32, index, constant(lower, d->kind, range - 1));
+  branch(lower, in_range, test, fail);
+  lower->block = test;
+  if (d->kind != IR_I64) {
+    index = emit1(lower, IR_ZEXT, IR_I64, index);
+  }
+  ir_ref_t bit = emit2(lower, IR_SHL, IR_I64, constant(lower, IR_I64, 1), index);
+  for (uint32_t m = 0; m < cluster->masks; m++) {
+    const switch_mask_t *mask = &cluster->mask[m];
+    uint32_t next = m + 1 < cluster->masks ? dcc_ir_block(func) : fail;
+    ir_ref_t hit = emit2(lower, IR_AND, IR_I64, bit, constant(lower, IR_I64, mask->mask));
+    branch(lower, emit2(lower, IR_NE, IR_I32, hit, constant(lower, IR_I64, 0)),
+           mask->target, next);
+    lower->block = next;
+  }
+}
+
+// Lower the search from `node` of the plan, going on to `fail` if no case
+// matches
+static void lower_search(lower_t *lower, const dispatch_t *d, uint32_t node, uint32_t fail) {
+  ir_func_t *func = lower->func;
+  const switch_node_t *n = &d->plan->nodes.data[node];
+  if (!n->is_split) {
+    for (uint32_t i = 0; i < n->count; i++) {
+      uint32_t next = i + 1 < n->count ? dcc_ir_block(func) : fail;
+      lower_cluster(lower, d, &d->plan->clusters.data[n->first + i], next);
+      lower->block = next;
+    }
+    return;
+  }
+  uint32_t left = dcc_ir_block(func), right = dcc_ir_block(func);
+  ir_ref_t pivot = constant(lower, d->kind, n->pivot);
+  branch(lower, emit2(lower, d->is_signed ? IR_SLT : IR_ULT, IR_I32, d->value, pivot),
+         left, right);
+  lower->block = left;
+  lower_search(lower, d, n->left, fail);
+  lower->block = right;
+  lower_search(lower, d, n->right, fail);
+}
+
+static void lower_switch(lower_t *lower, stmt_t *stmt) {
+  ir_func_t *func = lower->func;
+  exp_t *exp = stmt->stmt_whiledo.exp;
+  const type_t *type = dcc_type_promote(value_type(exp));
+  ir_ref_t value = convert(lower, rvalue(lower, exp), value_type(exp), type);
+  uint32_t head = lower->block, exit = dcc_ir_block(func);
+
+  // the body reaches its cases, and only then is the dispatch known
+  switch_t context = { switch_case_vec_new(), IR_NONE };
+  switch_t *outer = lower->switch_;
+  uint32_t outer_break = lower->break_block;
+  lower->switch_ = &context;
+  lower->break_block = exit;
+  start_unreachable(lower);
+  lower_stmt(lower, stmt->stmt_whiledo.stmt);
+  jump(lower, exit);
+  lower->switch_ = outer;
+  lower->break_block = outer_break;
+
+  lower->block = head;
+  bool is_signed = dcc_type_is_signed(type);
+  switch_plan_t plan = dcc_switch_plan(&context.cases, is_signed);
+  dispatch_t d = { value, dcc_ir_kind(type), is_signed, &context.cases, &plan };
+  uint32_t fail = context.default_block != IR_NONE ? context.default_block : exit;
+  if (plan.nodes.size) {
+    lower_search(lower, &d, 0, fail);
+  } else {
+    jump(lower, fail);
+  }
+  lower->block = exit;
+  dcc_switch_plan_free(&plan);
+  switch_case_vec_free(&context.cases);
+}
+
+static void lower_stmt(lower_t *lower, stmt_t *stmt) {
+  ir_func_t *func = lower->func;
+  switch (stmt->tag) {
+  case STMT_CASE: {
+    // labels in a row share a block, so the dispatch sees one target
+    uint32_t block = dcc_ir_block(func);
+    for (; stmt->tag == STMT_CASE; stmt = stmt->stmt_case.stmt) {
+      switch_case_t c = { stmt->stmt_case.value, block };
+      switch_case_vec_push(&lower->switch_->cases, c);
+    }
+    start(lower, block);
+    lower_stmt(lower, stmt);
+    break;
+  }
+  case STMT_DEFAULT:
+    lower->switch_->default_block = dcc_ir_block(func);
+    start(lower, lower->switch_->default_block);
+    lower_stmt(lower, stmt->stmt);
+    break;
+  case STMT_LABEL:
+    start(lower, label_block(lower, stmt->stmt_label.ident.symbol));
+    lower_stmt(lower, stmt->stmt_label.stmt);
+    break;
+  case STMT_COMPOUND:
+    lower_items(lower, &stmt->stmt_compound);
+    break;
+  case STMT_EXP:
+    if (stmt->exp) {
+      rvalue(lower, stmt->exp);
+    }
+    break;
+  case STMT_IF: {
+    uint32_t then = dcc_ir_block(func), join = dcc_ir_block(func);
+    uint32_t otherwise = stmt->stmt_select.secondary ? dcc_ir_block(func) : join;
+    condition(lower, stmt->stmt_select.exp, then, otherwise);
+    lower->block = then;
+    lower_stmt(lower, stmt->stmt_select.primary);
+    jump(lower, join);
+    if (stmt->stmt_select.secondary) {
+      lower->block = otherwise;
+      lower_stmt(lower, stmt->stmt_select.secondary);
+      jump(lower, join);
+    }
+    lower->block = join;
+    break;
+  }
+  case STMT_SWITCH:
+    lower_switch(lower, stmt);
+    break;
+  case STMT_WHILE: {
+    uint32_t head = dcc_ir_block(func), body = dcc_ir_block(func), exit = dcc_ir_block(func);
+    start(lower, head);
+    condition(lower, stmt->stmt_whiledo.exp, body, exit);
+    lower->block = body;
+    loop_body(lower, stmt->stmt_whiledo.stmt, exit, head);
+    jump(lower, head);
+    lower->block = exit;
+    break;
+  }
+  case STMT_DO: {
+    uint32_t body = dcc_ir_block(func), test = dcc_ir_block(func), exit = dcc_ir_block(func);
+    start(lower, body);
+    loop_body(lower, stmt->stmt_whiledo.stmt, exit, test);
+    start(lower, test);
+    condition(lower, stmt->stmt_whiledo.exp, body, exit);
+    lower->block = exit;
+    break;
+  }
+  case STMT_FOR: {
+    if (stmt->stmt_for.decl) {
+      lower_decl(lower, stmt->stmt_for.decl);
+    } else if (stmt->stmt_for.exp1) {
+      rvalue(lower, stmt->stmt_for.exp1);
+    }
+    uint32_t head = dcc_ir_block(func), body = dcc_ir_block(func);
+    uint32_t step = dcc_ir_block(func), exit = dcc_ir_block(func);
+    start(lower, head);
+    if (stmt->stmt_for.exp2) {
+      condition(lower, stmt->stmt_for.exp2, body, exit);
+    } else {
+      jump(lower, body);
+    }
+    lower->block = body;
+    loop_body(lower, stmt->stmt_for.stmt, exit, step);
+    start(lower, step);
+    if (stmt->stmt_for.exp3) {
+      rvalue(lower, stmt->stmt_for.exp3);
+    }
+    jump(lower, head);
+    lower->block = exit;
+    break;
+  }
+  case STMT_GOTO:
+    jump(lower, label_block(lower, stmt->label.symbol));
+    start_unreachable(lower);
+    break;
+  case STMT_CONTINUE:
+    jump(lower, lower->continue_block);
+    start_unreachable(lower);
+    break;
+  case STMT_BREAK:
+    jump(lower, lower->break_block);
+    start_unreachable(lower);
+    break;
+  case STMT_RETURN: {
+    exp_t *exp = stmt->exp;
+    ir_ref_t value = exp ? rvalue(lower, exp) : IR_NONE;
+    if (value != IR_NONE && lower->ret->tag != TYPE_VOID) {
+      emit1(lower, IR_RET, IR_VOID, convert(lower, value, value_type(exp), lower->ret));
+    } else {
+      return_default(lower);
+    }
+    start_unreachable(lower);
+    break;
+  }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Functions
+////////////////////////////////////////////////////////////////////////////////
+
+static void scan_exp(ptrmap_t *escaped, exp_t *exp);
+
+static void scan_init(ptrmap_t *escaped, initializer_t *init) {
+  if (init->tag == INIT_EXP) {
+    scan_exp(escaped, init->expression);
+    return;
+  }
+  for (size_t i = 0; i < init->inits->size; i++) {
+    scan_init(escaped, init->inits->data[i].initializer);
+  }
+}
+
+// Record the locals whose address `exp` takes
+static void scan_exp(ptrmap_t *escaped, exp_t *exp) {
+  switch (exp->tag) {
+  case EXP_IDENT:
+  case EXP_STRING:
+  case EXP_CONSTANT:
+  case EXP_SIZEOFTYPE:
+  case EXP_UNKNOWN:
+    break;
+  case EXP_ADDRESSOF:
+    if (exp->unary->tag == EXP_IDENT) {
+      dcc_ptrmap_put(escaped, exp->unary->ident.symbol, exp->unary->ident.symbol);
+    }
+    scan_exp(escaped, exp->unary);
+    break;
+  case EXP_DEREFERENCE:
+  case EXP_NEGATE:
+  case EXP_BITNOT:
+  case EXP_LOGICNOT:
+  case EXP_PREINCREMENT:
+  case EXP_PREDECREMENT:
+  case EXP_POSTINCREMENT:
+  case EXP_POSTDECREMENT:
+  case EXP_SIZEOFEXP:
+  case EXP_VA_END:
+    scan_exp(escaped, exp->unary);
+    break;
+  case EXP_CAST:
+  case EXP_VA_ARG:
+    scan_exp(escaped, exp->cast.value);
+    break;
+  case EXP_TERNARY:
+    scan_exp(escaped, exp->ternary.cond);
+    scan_exp(escaped, exp->ternary.true_exp);
+    scan_exp(escaped, exp->ternary.false_exp);
+    break;
+  case EXP_CALL:
+    scan_exp(escaped, exp->call.lhs);
+    for (size_t i = 0; i < exp->call.args->size; i++) {
+      scan_exp(escaped, exp->call.args->data[i]);
+    }
+    break;
+  case EXP_LIST:
+    for (size_t i = 0; i < exp->list.size; i++) {
+      scan_exp(escaped, exp->list.data[i]);
+    }
+    break;
+  case EXP_DOT:
+  case EXP_ARROW:
+    scan_exp(escaped, exp->child.lhs);
+    break;
+  case EXP_ASSIGN:
+    scan_exp(escaped, exp->assignment.lhs);
+    scan_exp(escaped, exp->assignment.rhs);
+    break;
+  case EXP_STRUCT:
+    for (size_t i = 0; i < exp->struct_init.inits->size; i++) {
+      scan_init(escaped, exp->struct_init.inits->data[i].initializer);
+    }
+    break;
+  default:
+    scan_exp(escaped, exp->binary.lhs);
+    scan_exp(escaped, exp->binary.rhs);
+    break;
+  }
+}
+
+static void scan_decl(ptrmap_t *escaped, decl_t *decl) {
+  for (size_t i = 0; i < decl->init_decltors.size; i++) {
+    initializer_t *init = decl->init_decltors.data[i]->initializer;
+    if (init) {
+      scan_init(escaped, init);
+    }
+  }
+}
+
+static void scan_stmt(ptrmap_t *escaped, stmt_t *stmt) {
+  switch (stmt->tag) {
+  case STMT_CASE:
+    scan_stmt(escaped, stmt->stmt_case.stmt);
+    break;
+  case STMT_DEFAULT:
+    scan_stmt(escaped, stmt->stmt);
+    break;
+  case STMT_LABEL:
+    scan_stmt(escaped, stmt->stmt_label.stmt);
+    break;
+  case STMT_COMPOUND:
+    for (size_t i = 0; i < stmt->stmt_compound.size; i++) {
+      block_item_t *item = stmt->stmt_compound.data[i];
+      if (item->tag == AST_DECLARATION) {
+        scan_decl(escaped, item->declaration);
+      } else {
+        scan_stmt(escaped, item->statement);
+      }
+    }
+    break;
+  case STMT_EXP:
+  case STMT_RETURN:
+    if (stmt->exp) {
+      scan_exp(escaped, stmt->exp);
+    }
+    break;
+  case STMT_IF:
+    scan_exp(escaped, stmt->stmt_select.exp);
+    scan_stmt(escaped, stmt->stmt_select.primary);
+    if (stmt->stmt_select.secondary) {
+      scan_stmt(escaped, stmt->stmt_select.secondary);
+    }
+    break;
+  case STMT_SWITCH:
+  case STMT_DO:
+  case STMT_WHILE:
+    scan_exp(escaped, stmt->stmt_whiledo.exp);
+    scan_stmt(escaped, stmt->stmt_whiledo.stmt);
+    break;
+  case STMT_FOR:
+    if (stmt->stmt_for.decl) {
+      scan_decl(escaped, stmt->stmt_for.decl);
+    }
+    exp_t *exps[] = { stmt->stmt_for.exp1, stmt->stmt_for.exp2, stmt->stmt_for.exp3 };
+    for (int i = 0; i < 3; i++) {
+      if (exps[i]) {
+        scan_exp(escaped, exps[i]);
+      }
+    }
+    scan_stmt(escaped, stmt->stmt_for.stmt);
+    break;
+  default:
+    break;
+  }
+}
+
+void dcc_find_escaped(stmt_t *body, ptrmap_t *escaped) {
+  scan_stmt(escaped, body);
+}
+
+static void lower_param(lower_t *lower, uint32_t index, symbol_t *symbol,
+                        const type_t *type) {
+  ir_ref_t param = emit(lower, IR_PARAM, dcc_ir_kind(type), 0, 0);
+  lower->func->instrs.data[param].imm = index;
+  lower->func->params[index] = type;
+  lower->func->param_count = index + 1;
+  if (!symbol) {
+    return;
+  } else if (dcc_type_is_record(type)) {
+    local_t *local = dcc_arena_alloc(&lower->func->arena, sizeof(local_t));
+    local->tag = LOCAL_ADDRESS;
+    local->address = param;
+    dcc_ptrmap_put(&lower->locals, symbol, local);
+    return;
+  }
+
+  local_t *local = new_local(lower, symbol);
+  lvalue_t target = local->tag == LOCAL_VAR
+    ? (lvalue_t){ symbol->type, true, local->index, IR_NONE, 0, 0 }
+    : memory(symbol->type, slot_address(lower, local->index));
+  store(lower, &target, param);
+}
+
+static ir_func_t* lower_function(func_def_t *def) {
+  ident_t *ident = dcc_decltor_ident(def->declarator);
+  symbol_t *symbol = ident->symbol;
+  lower_t lower = {
+    dcc_ir_func_new(symbol), 0, dcc_ptrmap_new(), dcc_ptrmap_new(), dcc_ptrmap_new(),
+    IR_NONE, IR_NONE, 0, symbol->type->func.ret->unqual,
+    strcmp(ident->name->str, "main") == 0,
+  };
+  lower.block = dcc_ir_block(lower.func);
+  dcc_find_escaped(def->compound, &lower.escaped);
+
+  direct_decltor_t *params = dcc_decltor_func(def->declarator);
+  size_t count = params->tag == AST_DECLTOR_FUNC_IDENTS
+    ? (params->idents ? params->idents->size : 0)
+    : (params->params ? params->params->decls.size : 0);
+  lower.func->params = dcc_arena_alloc(&lower.func->arena, (count + 1) * sizeof(type_t*));
+  if (params->tag == AST_DECLTOR_FUNC_IDENTS) {
+    for (size_t i = 0; params->idents && i < params->idents->size; i++) {
+      symbol_t *param = params->idents->data[i].symbol;
+      lower_param(&lower, i, param, param->type);
+    }
+  } else {
+    for (size_t i = 0; params->params && i < params->params->decls.size; i++) {
+      param_decl_t *decl = params->params->decls.data[i];
+      if (decl->type->tag == TYPE_VOID) {
+        break;
+      }
+      ident_t *name = decl->decltor ? dcc_decltor_ident(decl->decltor) : 0;
+      lower_param(&lower, i, name ? name->symbol : 0, decl->type);
+    }
+  }
+
+  lower_stmt(&lower, def->compound);
+  if (!is_terminated(&lower)) {
+    return_default(&lower);
+  }
+
+  dcc_ptrmap_free(&lower.escaped);
+  dcc_ptrmap_free(&lower.locals);
+  dcc_ptrmap_free(&lower.labels);
+  dcc_ir_ssa(lower.func);
+  dcc_ir_verify(lower.func);
+  return lower.func;
+}
+
+ir_func_vec_t dcc_lower(external_decl_vec_t *unit) {
+  ir_func_vec_t funcs = ir_func_vec_new();
+  for (size_t i = 0; i < unit->size; i++) {
+    if (unit->data[i]->tag == AST_EXT_FUNCTION) {
+      ir_func_vec_push(&funcs, lower_function(unit->data[i]->function));
+    }
+  }
+  return funcs;
+}
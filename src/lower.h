@@ -0,0 +1,36 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+  Lowering from the typed, folded AST to the IR. Scalar locals and parameters
+  whose address is never taken and which are not volatile become variables,
+  which dcc_ir_ssa() turns into values; everything else lives in a stack slot.
+  Control flow, including &&, || and ?:, becomes branches between blocks.
+*/
+
+#pragma once
+
+#include "ir.h"
+#include "parse.h"
+
+// Lower every function definition in `unit` to a verified function in SSA
+// form. The symbols of the unit must still be alive.
+ir_func_vec_t dcc_lower(external_decl_vec_t *unit);
+
+// Add to `escaped` every local of `body` whose address is taken, which must
+// live in memory
+void dcc_find_escaped(stmt_t *body, ptrmap_t *escaped);
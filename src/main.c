@@ -19,38 +19,322 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "alias.h"
 #include "dcc.h"
+#include "diag.h"
+#include "elf.h"
+#include "fold.h"
+#include "inline.h"
+#include "jit.h"
+#include "loop.h"
+#include "lower.h"
+#include "source_map.h"
 #include "tokenize.h"
 #include "parse.h"
+#include "pp.h"
+#include "sema.h"
+#include "vectorize.h"
+#include "vm.h"
+#include "x86.h"
 
 
-log_level active_log_level = LOG_TRACE;
+// tracing the parser costs more than compiling, so it is only on with -trace
+log_level active_log_level = LOG_ERROR;
 
-static char* read_stdin() {
+static char* read_stream(FILE *stream, size_t *size) {
   char *output = 0;
-  char buffer[512];
-  size_t len = 0;
+  char buffer[4096];
+  size_t len = 0, capacity = 0;
 
-  while (!feof(stdin)) {
-    size_t quantity = fread(buffer, 1, sizeof buffer, stdin);
+  while (!feof(stream)) {
+    size_t quantity = fread(buffer, 1, sizeof buffer, stream);
+    if (quantity == 0 && ferror(stream)) {
+      break;
+    }
 
-    // TODO smarter growth strategy
     // +1 for null terminator
-    output = dcc_realloc(output, len + quantity + 1);
+    if (len + quantity + 1 > capacity) {
+      capacity = 2 * (len + quantity + 1);
+      output = dcc_realloc(output, capacity);
+    }
     memcpy(output + len, buffer, quantity);
     len += quantity;
   }
+  if (!output) {
+    output = dcc_malloc(1);
+  }
 
   output[len] = 0;
+  *size = len;
   return output;
 }
 
+// Read the file at `path`, or stdin if it is null
+static const source_file_t* read_source(const char *path) {
+  FILE *stream = path ? fopen(path, "rb") : stdin;
+  if (!stream) {
+    fprintf(stderr, "dcc: cannot open %s\n", path);
+    return 0;
+  }
+  size_t size;
+  char *input = read_stream(stream, &size);
+  if (path) {
+    fclose(stream);
+  }
+  return dcc_source_add(path ? path : "<stdin>", input, size);
+}
+
+// The file a compiler writes for `path` by default: its base name with the
+// extension `ext`, like the .o Make would build
+static char* output_name(const char *path, char ext) {
+  const char *slash = strrchr(path, '/');
+  const char *base = slash ? slash + 1 : path;
+  const char *dot = strrchr(base, '.');
+  int len = dot ? dot - base : (int)strlen(base);
+
+  char *name = dcc_malloc(len + 3);
+  sprintf(name, "%.*s.%c", len, base, ext);
+  return name;
+}
+
+static bool report_inlining = false;
+
+// Lower the checked unit to IR and optimize it
+static ir_func_vec_t lower(external_decl_vec_t *unit) {
+  ir_func_vec_t funcs = dcc_lower(unit);
+  dcc_inline(&funcs, report_inlining ? stderr : 0);
+  for (size_t i = 0; i < funcs.size; i++) {
+    dcc_promote_slots(funcs.data[i]);
+    dcc_eliminate_loads(funcs.data[i]);
+    dcc_loop_optimize(funcs.data[i]);
+    dcc_vectorize(funcs.data[i]);
+  }
+  return funcs;
+}
+
+// Generate code for the checked unit
+static asm_t* generate(external_decl_vec_t *unit, diag_vec_t *diags) {
+  ir_func_vec_t funcs = lower(unit);
+  asm_t *as = dcc_asm_new();
+  dcc_x86_gen(as, unit, &funcs, diags);
+  for (size_t i = 0; i < funcs.size; i++) {
+    dcc_ir_func_free(funcs.data[i]);
+  }
+  ir_func_vec_free(&funcs);
+  return as;
+}
+
+// Generate code for the checked unit, writing it to `output` as assembly or
+// an object file, or to stdout if it is null
+static void compile(external_decl_vec_t *unit, const char *output, bool object,
+                    diag_vec_t *diags) {
+  asm_t *as = generate(unit, diags);
+  if (!dcc_diag_error_count(diags)) {
+    FILE *file = output ? fopen(output, object ? "wb" : "w") : stdout;
+    bool ok = file != 0;
+    if (ok && object) {
+      obj_t *obj = dcc_x86_encode(as);
+      ok = dcc_elf_write(file, obj);
+      dcc_obj_free(obj);
+    } else if (ok) {
+      dcc_asm_print(file, as);
+    }
+    if (file && output) {
+      ok = fclose(file) == 0 && ok;
+    }
+    if (!ok) {
+      fprintf(stderr, "dcc: cannot write %s\n", output ? output : "<stdout>");
+      exit(1);
+    }
+  }
+  dcc_asm_free(as);
+}
+
+typedef int entry_t(int argc, char *argv[]);
+
+// Generate code for the checked unit and load it into this process, linked
+// against `libraries`, returning its main function, or null if there is none
+// or it cannot be loaded
+static entry_t* load(external_decl_vec_t *unit, const char **libraries, size_t library_count,
+                     diag_vec_t *diags) {
+  asm_t *as = generate(unit, diags);
+  entry_t *entry = 0;
+  if (!dcc_diag_error_count(diags)) {
+    obj_t *obj = dcc_x86_encode(as);
+    jit_t *jit = dcc_jit_load(obj, libraries, library_count);
+    void *main = jit ? dcc_jit_symbol(jit, "main") : 0;
+    if (jit && !main) {
+      fprintf(stderr, "dcc: undefined symbol main\n");
+    }
+    // the loaded code stays mapped until exit, for the sake of anything it
+    // leaves to atexit
+    *(void**)&entry = main;
+    dcc_obj_free(obj);
+  }
+  dcc_asm_free(as);
+  return entry;
+}
+
+static void usage() {
+  fprintf(stderr, "usage: dcc [-E|-emit-ir|-S|-c] [-inline-report] [-trace] [-o file] [-I dir] [-D name[=value]] [-include-pch pch] [file]\n"
+          "       dcc -run|-interpret [-inline-report] [-trace] [-I dir] [-D name[=value]] [-include-pch pch] [-l lib] file [arg...]\n"
+          "       dcc -M|-MM [-I dir] [-D name[=value]] file...\n"
+          "       dcc --emit-pch [-I dir] [-D name[=value]] header -o pch\n");
+  exit(1);
+}
+
 int main(int argc, char *argv[]) {
-  char *input = read_stdin();
-  token_vec_t tokens = dcc_tokenize(input);
-  dcc_log_tokens(&tokens);
+  diag_vec_t diags = diag_vec_new();
+  pp_t *pp = dcc_pp_new(&diags);
+  const char **paths = dcc_calloc(argc, sizeof *paths);
+  const char **libraries = dcc_calloc(argc, sizeof *libraries);
+  const char *output = 0, *pch = 0;
+  int path_count = 0, library_count = 0;
+  bool preprocess_only = false, emit_pch = false, emit_ir = false, emit_asm = false,
+    emit_obj = false;
+  bool deps = false, system_deps = false, run = false, interpret = false;
+  int run_argc = 0, status = 0;
+  char **run_argv = 0;
+  entry_t *entry = 0;
 
-  dcc_parse(&tokens);
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (strncmp(arg, "-I", 2) == 0 || strncmp(arg, "-D", 2) == 0 || strncmp(arg, "-l", 2) == 0) {
+      // the value may be attached or the next argument
+      const char *value = arg[2] ? arg + 2 : argv[++i];
+      if (!value) {
+        usage();
+      } else if (arg[1] == 'I') {
+        dcc_pp_add_include_dir(pp, value);
+      } else if (arg[1] == 'D') {
+        dcc_pp_define(pp, value);
+      } else {
+        libraries[library_count++] = value;
+      }
+    } else if (strcmp(arg, "-E") == 0) {
+      preprocess_only = true;
+    } else if (strcmp(arg, "-emit-ir") == 0) {
+      emit_ir = true;
+    } else if (strcmp(arg, "-inline-report") == 0) {
+      report_inlining = true;
+    } else if (strcmp(arg, "-trace") == 0) {
+      active_log_level = LOG_TRACE;
+    } else if (strcmp(arg, "-S") == 0 || strcmp(arg, "-c") == 0) {
+      *(arg[1] == 'S' ? &emit_asm : &emit_obj) = true;
+    } else if (strcmp(arg, "-M") == 0 || strcmp(arg, "-MM") == 0) {
+      deps = true;
+      system_deps = !arg[2];
+    } else if (strcmp(arg, "-run") == 0 || strcmp(arg, "-interpret") == 0) {
+      run = true;
+      interpret = arg[1] == 'i';
+    } else if (strcmp(arg, "--emit-pch") == 0) {
+      emit_pch = true;
+    } else if (strcmp(arg, "-o") == 0 || strcmp(arg, "-include-pch") == 0) {
+      const char *value = argv[++i];
+      if (!value) {
+        usage();
+      }
+      *(arg[1] == 'o' ? &output : &pch) = value;
+    } else if (arg[0] == '-') {
+      usage();
+    } else if (run) {
+      // the file and everything after it are the program's arguments
+      paths[path_count++] = arg;
+      run_argc = argc - i;
+      run_argv = argv + i;
+      break;
+    } else {
+      paths[path_count++] = arg;
+    }
+  }
+
+  // only dependency scanning takes more than one file
+  if ((emit_pch && !output) || (output && !emit_pch && !emit_asm && !emit_obj)
+      || (path_count > 1 && !deps) || (deps && !path_count)
+      || (run && (!path_count || output || preprocess_only || emit_pch || emit_ir
+                  || emit_asm || emit_obj || deps))) {
+    usage();
+  }
+  const char *stale;
+  if (pch && !dcc_pp_load_pch(pp, pch, &stale)) {
+    if (stale) {
+      fprintf(stderr, "dcc: precompiled header %s is out of date: %s has changed\n", pch,
+              stale);
+    } else {
+      fprintf(stderr, "dcc: cannot load precompiled header %s\n", pch);
+    }
+    return 1;
+  }
 
-  return 0;
+  const source_file_t *file;
+  if (deps) {
+    // one preprocessor for every file, so that headers are only read once
+    for (int i = 0; i < path_count; i++) {
+      if (!(file = read_source(paths[i]))) {
+        return 1;
+      }
+      char *target = output_name(paths[i], 'o');
+      dcc_pp_scan(pp, file, stdout, target, system_deps);
+      free(target);
+    }
+  } else if (!(file = read_source(paths[0]))) {
+    return 1;
+  } else if (preprocess_only || emit_pch) {
+    token_vec_t tokens = dcc_preprocess(pp, file);
+    if (preprocess_only) {
+      dcc_pp_print(stdout, &tokens);
+    } else if (!dcc_diag_error_count(&diags) && !dcc_pp_write_pch(pp, &tokens, output)) {
+      fprintf(stderr, "dcc: cannot write %s\n", output);
+      return 1;
+    }
+    token_vec_free(&tokens);
+  } else {
+    // the parser pulls tokens as it goes
+    dcc_pp_enter(pp, file);
+    external_decl_vec_t unit = dcc_parse(pp, &diags);
+    // names in a partial tree would only add spurious errors
+    if (!dcc_diag_error_count(&diags)) {
+      sema_t *sema = dcc_sema_new(&diags);
+      dcc_sema(sema, &unit);
+      if (!dcc_diag_error_count(&diags)) {
+        dcc_fold(&unit);
+      }
+      if (emit_ir && !dcc_diag_error_count(&diags)) {
+        ir_func_vec_t funcs = lower(&unit);
+        for (size_t i = 0; i < funcs.size; i++) {
+          dcc_ir_print(stdout, funcs.data[i]);
+          dcc_ir_func_free(funcs.data[i]);
+        }
+        ir_func_vec_free(&funcs);
+      } else if ((emit_asm || emit_obj) && !dcc_diag_error_count(&diags)) {
+        char *name = output || !paths[0] ? 0 : output_name(paths[0], emit_obj ? 'o' : 's');
+        compile(&unit, output ? output : name, emit_obj, &diags);
+        free(name);
+      } else if (interpret && !dcc_diag_error_count(&diags)) {
+        vm_t *vm = dcc_vm_new(&diags);
+        if (!dcc_vm_load(vm, &unit) || !dcc_vm_main(vm, run_argc, run_argv, &status)) {
+          status = 1;
+          if (!dcc_diag_error_count(&diags)) {
+            fprintf(stderr, "dcc: undefined symbol main\n");
+          }
+        }
+        dcc_vm_free(vm);
+      } else if (run && !dcc_diag_error_count(&diags)) {
+        entry = load(&unit, libraries, library_count, &diags);
+      }
+      dcc_sema_free(sema);
+    }
+  }
+  free(paths);
+  free(libraries);
+  dcc_pp_free(pp);
+  dcc_log_diags(&diags);
+
+  if (dcc_diag_error_count(&diags) || (run && !interpret && !entry)) {
+    return 1;
+  } else if (interpret) {
+    return status;
+  }
+  // the program sees its file as its name, followed by its own arguments
+  return entry ? entry(run_argc, run_argv) : 0;
 }
@@ -15,8 +15,14 @@
   along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <setjmp.h>
+#include <stdarg.h>
+#include <string.h>
+
 #include "dcc.h"
+#include "diag.h"
 #include "parse.h"
+#include "scope.h"
 #include "tokenize.h"
 #include "vec_types.h"
 #include "util.h"
@@ -36,6 +42,8 @@ DEFINE_VEC2(type_qual_t, type_qual_vec);
 DEFINE_VEC2(designator_t*, designator_vec);
 DEFINE_VEC2(initialization_t, initialization_vec);
 DEFINE_VEC2(enumtor_t*, enumtor_vec);
+DEFINE_VEC2(ident_t, ident_vec);
+DEFINE_VEC2(type_spec_t*, type_spec_vec);
 
 typedef struct {
   enum token_tag token;
@@ -46,11 +54,22 @@ typedef struct {
 // Stream operations
 ////////////////////////////////////////////////////////////////////////////////
 
-// A stream owns the vector of tokens and a stack representing the parser's
-// current position therein.
+// A stream pulls tokens from the preprocessor as the parser peeks at them and
+// keeps a stack representing the parser's current position. Positions count
+// from the first token; `tokens` holds those from `base` on, since whatever
+// precedes the current external declaration can no longer be backtracked to.
+// Syntax errors are recorded in `diags` and unwind to the innermost recovery
+// point via `recover`. `names` tracks which identifiers are typedef names,
+// which the grammar cannot tell apart on its own.
 typedef struct {
+  pp_t *pp;
   token_vec_t tokens;
+  int base;
   int_vec_t stack;
+  diag_vec_t *diags;
+  jmp_buf *recover;
+  int error_pos;
+  scope_t names;
 } stream_t;
 
 // Begin attempting to parse a new feature, so record the previous location such
@@ -77,12 +96,45 @@ static void stream_commit(stream_t *stream) {
   *last = now;
 }
 
+// Return the token at `pos`, reading up to it if need be. The pointer is good
+// until the next token is read.
+static token_t* stream_token(stream_t *stream, int pos) {
+  dcc_assert(pos >= stream->base);
+  while (pos - stream->base >= stream->tokens.size) {
+    token_t *last = token_vec_last(&stream->tokens);
+    if (last && last->tag == TOKEN_EOF) {
+      return last;
+    }
+    token_vec_push(&stream->tokens, dcc_pp_next(stream->pp));
+  }
+  return &stream->tokens.data[pos - stream->base];
+}
+
 // Return ptr to next token
 static token_t* stream_peek(stream_t *stream) {
   int *curr = int_vec_last(&stream->stack);
   dcc_assert(curr);
-  dcc_assert(*curr < stream->tokens.size);
-  return &stream->tokens.data[*curr];
+  return stream_token(stream, *curr);
+}
+
+// Forget the tokens before the current position, which must not be
+// backtracked to
+static void stream_discard(stream_t *stream) {
+  dcc_assert(stream->stack.size == 1);
+  int pos = *int_vec_last(&stream->stack);
+  int count = pos - stream->base;
+  if (count > stream->tokens.size) {
+    count = stream->tokens.size; // past EOF
+  }
+  memmove(stream->tokens.data, stream->tokens.data + count,
+          (stream->tokens.size - count) * sizeof(token_t));
+  stream->tokens.size -= count;
+  stream->base += count;
+}
+
+// Location of the next token
+static srcloc_t stream_loc(stream_t *stream) {
+  return stream_peek(stream)->loc;
 }
 
 // Advance to next token
@@ -92,6 +144,20 @@ static void stream_next(stream_t *stream) {
   (*curr) += 1;
 }
 
+// Record a syntax error at the next token and unwind to the innermost recovery
+// point. See parse_recover() for how parsing resumes.
+static void stream_error(stream_t *stream, const char *format, ...) {
+  token_t *token = stream_peek(stream);
+  va_list vlist;
+  va_start(vlist, format);
+  dcc_vdiag(stream->diags, DIAG_ERROR, token->loc, token->len, format, vlist);
+  va_end(vlist);
+
+  stream->error_pos = *int_vec_last(&stream->stack);
+  dcc_assert(stream->recover);
+  longjmp(*stream->recover, 1);
+}
+
 // Assert that the next token is of a specific type
 static token_t* stream_expect(stream_t *stream, token_tag_t tag) {
   token_t *token = stream_peek(stream);
@@ -99,19 +165,25 @@ static token_t* stream_expect(stream_t *stream, token_tag_t tag) {
     stream_next(stream);
     return token;
   } else {
-    dcc_ice("expected token `%s` found `%s`\n",
-            dcc_token_tag_str(tag),
-            dcc_token_tag_str(token->tag));
+    stream_error(stream, "expected token `%s` found `%s`",
+                 dcc_token_tag_str(tag),
+                 dcc_token_tag_str(token->tag));
     // unreachable
     return 0;
   }
 }
 
+// Consume an identifier, keeping only its interned name and location
+static ident_t stream_expect_ident(stream_t *stream) {
+  token_t *token = stream_expect(stream, TOKEN_IDENT);
+  return (ident_t) { token->val.name, token->loc };
+}
+
 // Print consistent error message
 static void stream_expected(stream_t *stream, char* phrase) {
-  dcc_ice("expected %s found `%s`\n",
-          phrase,
-          dcc_token_tag_str(stream_peek(stream)->tag));
+  stream_error(stream, "expected %s found `%s`",
+               phrase,
+               dcc_token_tag_str(stream_peek(stream)->tag));
 }
 
 // Query
@@ -125,14 +197,105 @@ static void stream_assert(stream_t *stream, bool cond, char *phrase) {
   }
 }
 
-#define STREAM_ACTION(result, ...)                   \
-  TRACE("");                                         \
-  for (int i = 0; i < stream->stack.size - 1; ++i) { \
-    eprintf("  ");                                   \
-  }                                                  \
-  eprintf("%s %s ", result, __func__);               \
-  eprintf(__VA_ARGS__);                              \
-  eprintf("\n");
+// Tokens which may begin a declaration at file scope, used to resynchronize
+// after a syntax error at the top level.
+static bool starts_external_decl(token_tag_t tag) {
+  switch (tag) {
+  case TOKEN_KEYWORD_AUTO: case TOKEN_KEYWORD_CHAR: case TOKEN_KEYWORD_CONST:
+  case TOKEN_KEYWORD_DOUBLE: case TOKEN_KEYWORD_ENUM: case TOKEN_KEYWORD_EXTERN:
+  case TOKEN_KEYWORD_FLOAT: case TOKEN_KEYWORD_INLINE: case TOKEN_KEYWORD_INT:
+  case TOKEN_KEYWORD_LONG: case TOKEN_KEYWORD_REGISTER:
+  case TOKEN_KEYWORD_RESTRICT: case TOKEN_KEYWORD_SHORT:
+  case TOKEN_KEYWORD_SIGNED: case TOKEN_KEYWORD_STATIC:
+  case TOKEN_KEYWORD_STRUCT: case TOKEN_KEYWORD_TYPEDEF:
+  case TOKEN_KEYWORD_UNION: case TOKEN_KEYWORD_UNSIGNED:
+  case TOKEN_KEYWORD_VOID: case TOKEN_KEYWORD_VOLATILE:
+  case TOKEN_KEYWORD__BOOL: case TOKEN_KEYWORD__COMPLEX:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Resynchronize after stream_error() unwound to a recovery point installed at
+// stack depth `depth`. Skips to just past a `;` or a balanced `}`, stops before
+// a `}` closing the enclosing block, or at the top level stops before the next
+// token that may begin a declaration. Always makes progress.
+static void parse_recover(stream_t *stream, size_t depth, bool top_level) {
+  stream->stack.size = depth;
+  int *pos = int_vec_last(&stream->stack);
+  int start = *pos;
+
+  // braces opened between the start of the item and the error
+  int nest = 0;
+  for (; *pos < stream->error_pos; ++*pos) {
+    token_tag_t tag = stream_token(stream, *pos)->tag;
+    if (tag == TOKEN_LCURLY) {
+      nest++;
+    } else if (tag == TOKEN_RCURLY && nest > 0) {
+      nest--;
+    }
+  }
+
+  for (token_tag_t tag; (tag = stream_token(stream, *pos)->tag) != TOKEN_EOF; ++*pos) {
+    if (nest == 0 && *pos > start) {
+      if (top_level && starts_external_decl(tag)) {
+        return;
+      }
+      if (!top_level && tag == TOKEN_RCURLY) {
+        return;
+      }
+    }
+
+    if (tag == TOKEN_LCURLY) {
+      nest++;
+    } else if (tag == TOKEN_RCURLY && nest > 0 && --nest == 0) {
+      ++*pos;
+      if (stream_token(stream, *pos)->tag == TOKEN_SEMI) {
+        ++*pos;
+      }
+      return;
+    } else if (tag == TOKEN_SEMI && nest == 0) {
+      ++*pos;
+      return;
+    }
+  }
+}
+
+typedef bool (*parse_item_func_t)(stream_t *stream, void *ctx);
+
+// Run `parse` with a recovery point installed so that a syntax error inside it
+// is recorded and skipped rather than aborting the whole parse. Returns false
+// once `parse` reports there are no more items.
+static bool parse_recoverable(stream_t *stream, parse_item_func_t parse,
+                              void *ctx, bool top_level) {
+  jmp_buf recover, *outer = stream->recover;
+  size_t depth = stream->stack.size;
+  int scope_depth = dcc_scope_depth(&stream->names);
+  bool more;
+
+  stream->recover = &recover;
+  if (setjmp(recover)) {
+    dcc_scope_leave_to(&stream->names, scope_depth);
+    parse_recover(stream, depth, top_level);
+    more = !stream_is(stream, TOKEN_EOF);
+  } else {
+    more = parse(stream, ctx);
+  }
+  stream->recover = outer;
+  return more;
+}
+
+#define STREAM_ACTION(result, ...)                     \
+  if (active_log_level <= LOG_TRACE) {                 \
+    TRACE("");                                         \
+    for (int i = 0; i < stream->stack.size - 1; ++i) { \
+      eprintf("  ");                                   \
+    }                                                  \
+    eprintf("%s %s ", result, __func__);               \
+    eprintf(__VA_ARGS__);                              \
+    eprintf("\n");                                     \
+  }
 
 /* #define STREAM_PUSH() STREAM_ACTION("attempt"); stream_push(stream); */
 /* #define STREAM_COMMIT() stream_commit(stream); STREAM_ACTION("commit"); */
@@ -146,6 +309,71 @@ static void stream_assert(stream_t *stream, bool cond, char *phrase) {
 #define STREAM_COMMITa(...) stream_commit(stream); STREAM_ACTION("commit", __VA_ARGS__);
 #define STREAM_POPa(...) stream_pop(stream); STREAM_ACTION("abort", __VA_ARGS__);
 
+////////////////////////////////////////////////////////////////////////////////
+// Typedef names
+////////////////////////////////////////////////////////////////////////////////
+
+// Values bound in stream->names. Ordinary identifiers are bound too, since
+// they hide typedef names declared in enclosing scopes.
+static char TYPEDEF_NAME, OTHER_NAME;
+
+static bool is_typedef_name(stream_t *stream, const name_t *name) {
+  return dcc_scope_lookup(&stream->names, name) == &TYPEDEF_NAME;
+}
+
+static void bind_name(stream_t *stream, decltor_t *decltor, bool is_typedef) {
+  ident_t *ident = decltor ? dcc_decltor_ident(decltor) : 0;
+  if (ident) {
+    dcc_scope_bind(&stream->names, ident->name,
+                   is_typedef ? &TYPEDEF_NAME : &OTHER_NAME);
+  }
+}
+
+ident_t* dcc_decltor_ident(decltor_t *decltor) {
+  while (decltor->directs.size > 0) {
+    direct_decltor_t *direct = &decltor->directs.data[0];
+    if (direct->tag == AST_DECLTOR_IDENT) {
+      return &direct->ident;
+    } else if (direct->tag != AST_DECLTOR_NESTED) {
+      break;
+    }
+    decltor = direct->nested;
+  }
+  return 0;
+}
+
+// The derivation applied first to the declared type: the first suffix, or else
+// the last pointer, of the innermost declarator having either. Returns false
+// if there is none; *suffix is null for a pointer.
+static bool first_derivation(decltor_t *decltor, direct_decltor_t **suffix) {
+  if (decltor->directs.size > 0 && decltor->directs.data[0].tag == AST_DECLTOR_NESTED
+      && first_derivation(decltor->directs.data[0].nested, suffix)) {
+    return true;
+  }
+  *suffix = decltor->directs.size > 1 ? &decltor->directs.data[1] : 0;
+  return decltor->directs.size > 1 || decltor->pointers.size > 0;
+}
+
+direct_decltor_t* dcc_decltor_func(decltor_t *decltor) {
+  direct_decltor_t *suffix;
+  if (first_derivation(decltor, &suffix) && suffix
+      && (suffix->tag == AST_DECLTOR_FUNC_TYPES || suffix->tag == AST_DECLTOR_FUNC_IDENTS)) {
+    return suffix;
+  }
+  return 0;
+}
+
+// Bind the parameter names of the function `decltor` declares
+static void bind_params(stream_t *stream, decltor_t *decltor) {
+  direct_decltor_t *func = dcc_decltor_func(decltor);
+  if (!func || func->tag != AST_DECLTOR_FUNC_TYPES || !func->params) {
+    return;
+  }
+  for (size_t i = 0; i < func->params->decls.size; i++) {
+    bind_name(stream, func->params->decls.data[i]->decltor, false);
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // stdspec.6.4 Constants
 ////////////////////////////////////////////////////////////////////////////////
@@ -153,16 +381,31 @@ static void stream_assert(stream_t *stream, bool cond, char *phrase) {
 static constant_t* parse_constant(stream_t *stream) {
   stream_push(stream);
 
-  constant_t constant;
+  constant_t constant = { 0 };
   if (stream_is(stream, TOKEN_INTEGER)) {
+    token_t *token = stream_peek(stream);
     constant.tag = CONSTANT_INTEGER;
-    constant.integer = stream_peek(stream)->val.integer;
+    constant.integer = token->val.integer;
+    const char *spelling = dcc_source_text(token->loc);
+    constant.is_decimal = spelling[0] != '0' || token->len == 1;
+    for (const char *s = spelling + token->len - 1; strchr("uUlL", *s); s--) {
+      constant.is_unsigned |= *s == 'u' || *s == 'U';
+      constant.longs += *s == 'l' || *s == 'L';
+    }
+    stream_next(stream);
+  } else if (stream_is(stream, TOKEN_CHARACTER)) {
+    token_t *token = stream_peek(stream);
+    const char *spelling = dcc_source_text(token->loc);
+    constant.tag = CONSTANT_CHAR;
+    constant.integer = token->val.integer;
+    constant.prefix = dcc_literal_prefix(&spelling);
+    stream_next(stream);
   } else if (stream_is(stream, TOKEN_FLOATING)) {
     constant.tag = CONSTANT_FLOAT;
     constant.floating = stream_peek(stream)->val.floating;
     stream_next(stream);
   } else {
-    // TODO FIXME char/enum constants
+    // TODO FIXME enum constants
     // enum constants will probably have to be inferred out of just variable
     // names in another pass
     stream_pop(stream);
@@ -185,21 +428,137 @@ static exp_t* parse_cast_exp(stream_t *stream);
 static type_name_t* parse_type_name(stream_t *stream);
 static initialization_vec_t* parse_initialization_list(stream_t *stream);
 
+// stdspec.6.4.5 Adjacent string literals are concatenated into one literal
+// which only records where each piece is spelled.
+static strlit_t* parse_string_literal(stream_t *stream) {
+  strlit_piece_t buffer[16], *pieces = buffer;
+  uint32_t count = 0, capacity = 16;
+
+  for (token_t *token; (token = stream_peek(stream))->tag == TOKEN_STRING;) {
+    if (count == capacity) {
+      capacity *= 2;
+      if (pieces == buffer) {
+        pieces = dcc_malloc(capacity * sizeof *pieces);
+        memcpy(pieces, buffer, sizeof buffer);
+      } else {
+        pieces = dcc_realloc(pieces, capacity * sizeof *pieces);
+      }
+    }
+    pieces[count++] = (strlit_piece_t) { token->loc, token->len };
+    stream_next(stream);
+  }
+
+  strlit_t *output = dcc_strlit_new(pieces, count);
+  if (pieces != buffer) {
+    free(pieces);
+  }
+  return output;
+}
+
+// Whether the current token is a `(` opening a type name, as in a cast or a
+// compound literal, rather than a parenthesized expression
+static bool stream_is_paren_type(stream_t *stream) {
+  if (!stream_is(stream, TOKEN_LPAREN)) {
+    return false;
+  }
+  token_t *next = stream_token(stream, *int_vec_last(&stream->stack) + 1);
+  switch (next->tag) {
+  case TOKEN_KEYWORD_VOID:
+  case TOKEN_KEYWORD_CHAR:
+  case TOKEN_KEYWORD_SHORT:
+  case TOKEN_KEYWORD_INT:
+  case TOKEN_KEYWORD_LONG:
+  case TOKEN_KEYWORD_FLOAT:
+  case TOKEN_KEYWORD_DOUBLE:
+  case TOKEN_KEYWORD_SIGNED:
+  case TOKEN_KEYWORD_UNSIGNED:
+  case TOKEN_KEYWORD__BOOL:
+  case TOKEN_KEYWORD__COMPLEX:
+  case TOKEN_KEYWORD_STRUCT:
+  case TOKEN_KEYWORD_UNION:
+  case TOKEN_KEYWORD_ENUM:
+  case TOKEN_KEYWORD_CONST:
+  case TOKEN_KEYWORD_RESTRICT:
+  case TOKEN_KEYWORD_VOLATILE:
+    return true;
+  case TOKEN_IDENT:
+    return is_typedef_name(stream, next->val.name);
+  default:
+    return false;
+  }
+}
+
+// The builtin an identifier names, or EXP_UNKNOWN if it is an ordinary one
+static enum exp_tag builtin_tag(const name_t *name) {
+  static const struct {
+    const char *name;
+    enum exp_tag tag;
+  } BUILTINS[] = {
+    { "__builtin_va_start", EXP_VA_START },
+    { "__builtin_va_arg", EXP_VA_ARG },
+    { "__builtin_va_copy", EXP_VA_COPY },
+    { "__builtin_va_end", EXP_VA_END },
+  };
+  for (size_t i = 0; i < sizeof BUILTINS / sizeof *BUILTINS; i++) {
+    if (strcmp(name->str, BUILTINS[i].name) == 0) {
+      return BUILTINS[i].tag;
+    }
+  }
+  return EXP_UNKNOWN;
+}
+
+static exp_t* parse_builtin_operand(stream_t *stream) {
+  exp_t *operand = parse_assignment_exp(stream);
+  if (!operand) {
+    stream_expected(stream, "expression");
+  }
+  return operand;
+}
+
+// The builtins of <stdarg.h>, which look like calls but whose va_arg takes a
+// type name
+static void parse_builtin(stream_t *stream, exp_t *exp, enum exp_tag tag) {
+  stream_next(stream);
+  stream_expect(stream, TOKEN_LPAREN);
+  exp->tag = tag;
+  if (tag == EXP_VA_END) {
+    exp->unary = parse_builtin_operand(stream);
+  } else if (tag == EXP_VA_ARG) {
+    exp->cast.value = parse_builtin_operand(stream);
+    stream_expect(stream, TOKEN_COMMA);
+    exp->cast.type = parse_type_name(stream);
+    if (!exp->cast.type) {
+      stream_expected(stream, "type name");
+    }
+  } else {
+    exp->binary.lhs = parse_builtin_operand(stream);
+    stream_expect(stream, TOKEN_COMMA);
+    exp->binary.rhs = parse_builtin_operand(stream);
+  }
+  stream_expect(stream, TOKEN_RPAREN);
+}
+
 // stdspec.6.5.1
 static exp_t* parse_primary_exp(stream_t *stream) {
   STREAM_PUSH();
 
   exp_t *exp = dcc_malloc(sizeof(exp_t));
-  if (stream_is(stream, TOKEN_IDENT)) {
+  exp->loc = stream_loc(stream);
+  if (stream_is_paren_type(stream)) {
+    free(exp);
+    STREAM_POP();
+    return 0;
+  } else if (stream_is(stream, TOKEN_IDENT) && builtin_tag(stream_peek(stream)->val.name)) {
+    parse_builtin(stream, exp, builtin_tag(stream_peek(stream)->val.name));
+  } else if (stream_is(stream, TOKEN_IDENT)) {
     exp->tag = EXP_IDENT;
-    exp->token = stream_peek(stream);
-    stream_next(stream);
+    exp->ident = stream_expect_ident(stream);
   } else if (stream_is(stream, TOKEN_STRING)) {
     exp->tag = EXP_STRING;
-    exp->token = stream_peek(stream);
-    stream_next(stream);
+    exp->string = parse_string_literal(stream);
   } else if (stream_is(stream, TOKEN_LPAREN)) {
     stream_next(stream);
+    free(exp);
     exp = parse_exp(stream);
     if (!exp) {
       stream_expected(stream, "expression");
@@ -226,18 +585,17 @@ static exp_vec_t* parse_argument_exp_list(stream_t *stream) {
   STREAM_PUSH();
   exp_vec_t args = exp_vec_new();
 
-  while (true) {
-    if (args.size) {
-      // if there are prior arguments, they should be separated by commas
-      stream_expect(stream, TOKEN_COMMA);
-    }
-
-    exp_t *arg = parse_assignment_exp(stream);
-    if (!arg) {
-      break;
-    }
-
+  exp_t *arg = parse_assignment_exp(stream);
+  if (arg) {
     exp_vec_push(&args, arg);
+    while (stream_is(stream, TOKEN_COMMA)) {
+      stream_next(stream);
+      arg = parse_assignment_exp(stream);
+      if (!arg) {
+        stream_expected(stream, "expression after `,`");
+      }
+      exp_vec_push(&args, arg);
+    }
   }
 
   exp_vec_t *output = dcc_malloc(sizeof args);
@@ -250,18 +608,22 @@ static exp_vec_t* parse_argument_exp_list(stream_t *stream) {
 static exp_t* parse_postfix_exp(stream_t *stream) {
   STREAM_PUSH();
   exp_t *previous = parse_primary_exp(stream);
-  if (!previous && stream_is(stream, TOKEN_LPAREN)) {
+  if (!previous && stream_is_paren_type(stream)) {
+    srcloc_t tname_loc = stream_loc(stream);
     stream_next(stream);
     type_name_t *tname = parse_type_name(stream);
     stream_expect(stream, TOKEN_RPAREN);
 
+    // without an initializer list this is a cast, which is no postfix expression
     initialization_vec_t *inits = parse_initialization_list(stream);
     if (!inits) {
-      dcc_ice("expected initializer-list after `)`");
+      STREAM_POP();
+      return 0;
     }
 
     previous = dcc_malloc(sizeof *previous);
     previous->tag = EXP_STRUCT;
+    previous->loc = tname_loc;
     previous->struct_init.tname = tname;
     previous->struct_init.inits = inits;
   }
@@ -274,6 +636,7 @@ static exp_t* parse_postfix_exp(stream_t *stream) {
 
   while (true) {
     exp_t *exp = dcc_malloc(sizeof(exp_t));
+    exp->loc = stream_loc(stream);
     if (stream_is(stream, TOKEN_LSQUARE)) {
       stream_next(stream);
       exp_t *index = parse_exp(stream);
@@ -294,14 +657,12 @@ static exp_t* parse_postfix_exp(stream_t *stream) {
       stream_next(stream);
       exp->tag = EXP_DOT;
       exp->child.lhs = previous;
-      exp->child.name = stream_peek(stream);
-      stream_expect(stream, TOKEN_IDENT);
+      exp->child.name = stream_expect_ident(stream);
     } else if (stream_is(stream, TOKEN_ARROW)) {
       stream_next(stream);
       exp->tag = EXP_ARROW;
       exp->child.lhs = previous;
-      exp->child.name = stream_peek(stream);
-      stream_expect(stream, TOKEN_IDENT);
+      exp->child.name = stream_expect_ident(stream);
     } else if (stream_is(stream, TOKEN_INCREMENT)) {
       stream_next(stream);
       exp->tag = EXP_POSTINCREMENT;
@@ -311,7 +672,6 @@ static exp_t* parse_postfix_exp(stream_t *stream) {
       exp->tag = EXP_POSTDECREMENT;
       exp->unary = previous;
     } else {
-      stream_pop(stream);
       free(exp);
       break;
     }
@@ -337,6 +697,30 @@ static exp_t* parse_unary_exp(stream_t *stream) {
   };
 
   STREAM_PUSH();
+  srcloc_t loc = stream_loc(stream);
+
+  // `sizeof (T) {...}` is the size of a compound literal, not of T
+  if (stream_is(stream, TOKEN_KEYWORD_SIZEOF)) {
+    STREAM_PUSH();
+    stream_next(stream);
+    type_name_t *tname = 0;
+    if (stream_is_paren_type(stream)) {
+      stream_next(stream);
+      tname = parse_type_name(stream);
+      stream_expect(stream, TOKEN_RPAREN);
+    }
+    if (tname && !stream_is(stream, TOKEN_LCURLY)) {
+      exp_t *output = dcc_malloc(sizeof(exp_t));
+      output->tag = EXP_SIZEOFTYPE;
+      output->loc = loc;
+      output->cast.type = tname;
+      output->cast.value = 0;
+      STREAM_COMMIT();
+      STREAM_COMMIT();
+      return output;
+    }
+    STREAM_POP();
+  }
   for (token_exp_tag_pair *pair = UNARY_PAIRS; pair->token; ++pair) {
     if (stream_peek(stream)->tag == pair->token) {
       stream_next(stream);
@@ -347,6 +731,7 @@ static exp_t* parse_unary_exp(stream_t *stream) {
       }
       exp_t *output = dcc_malloc(sizeof(exp_t));
       output->tag = pair->exp;
+      output->loc = loc;
       output->unary = unary;
 
       STREAM_COMMIT();
@@ -376,6 +761,7 @@ static exp_t* parse_unary_exp(stream_t *stream) {
       if (pair->exp) { // anything but TOKEN_PLUS
         output = dcc_malloc(sizeof(exp_t));
         output->tag = pair->exp;
+        output->loc = loc;
         output->unary = cast;
       } else {
         // TOKEN_PLUS is a no-op
@@ -387,15 +773,37 @@ static exp_t* parse_unary_exp(stream_t *stream) {
   }
 
   STREAM_POP();
-  stream_expected(stream, "unary operator");
-  // unreachable
   return 0;
 }
 
 // stdspec.6.5.4
 static exp_t* parse_cast_exp(stream_t *stream) {
-  // TODO FIXME cast expression
-  return parse_unary_exp(stream);
+  if (!stream_is_paren_type(stream)) {
+    return parse_unary_exp(stream);
+  }
+
+  // a brace after the type name makes a compound literal, a postfix expression
+  STREAM_PUSH();
+  srcloc_t loc = stream_loc(stream);
+  stream_next(stream);
+  type_name_t *tname = parse_type_name(stream);
+  stream_expect(stream, TOKEN_RPAREN);
+  if (stream_is(stream, TOKEN_LCURLY)) {
+    STREAM_POP();
+    return parse_unary_exp(stream);
+  }
+
+  exp_t *value = parse_cast_exp(stream);
+  if (!value) {
+    stream_expected(stream, "expression after cast");
+  }
+  exp_t *output = dcc_malloc(sizeof(exp_t));
+  output->tag = EXP_CAST;
+  output->loc = loc;
+  output->cast.type = tname;
+  output->cast.value = value;
+  STREAM_COMMIT();
+  return output;
 }
 
 #define RECURSIVE_BINOP(name, inner, pairs)                       \
@@ -411,6 +819,7 @@ static exp_t* name(stream_t *stream) {                            \
   while (true) {                                                  \
     for (token_exp_tag_pair *pair = pairs; pair->token; pair++) { \
       if (!stream_is(stream, pair->token)) { continue; }          \
+      srcloc_t loc = stream_loc(stream);                          \
       stream_next(stream);                                        \
                                                                   \
       exp_t *rhs = inner(stream);                                 \
@@ -420,6 +829,7 @@ static exp_t* name(stream_t *stream) {                            \
                                                                   \
       exp_t *output = dcc_malloc(sizeof(exp_t));                  \
       output->tag = pair->exp;                                    \
+      output->loc = loc;                                          \
       output->binary.lhs = lhs;                                   \
       output->binary.rhs = rhs;                                   \
       lhs = output;                                               \
@@ -518,6 +928,7 @@ static exp_t* parse_cond_exp(stream_t *stream) {
 
   exp_t *output = cond;
   if (stream_is(stream, TOKEN_QUEST)) {
+    srcloc_t loc = stream_loc(stream);
     stream_next(stream);
 
     exp_t *true_exp = parse_exp(stream);
@@ -528,12 +939,12 @@ static exp_t* parse_cond_exp(stream_t *stream) {
 
     exp_t *false_exp = parse_cond_exp(stream);
     if (!false_exp) {
-      dcc_ice("expected expression found %s\n",
-              dcc_token_tag_str(stream_peek(stream)->tag));
+      stream_expected(stream, "expression after `:`");
     }
 
     output = dcc_malloc(sizeof(exp_t));
     output->tag = EXP_TERNARY;
+    output->loc = loc;
     output->ternary.cond = cond;
     output->ternary.true_exp = true_exp;
     output->ternary.false_exp = false_exp;
@@ -565,8 +976,9 @@ static exp_t* parse_assignment_exp(stream_t *stream) {
   };
 
   exp_t *unary = parse_unary_exp(stream);
-  for (token_exp_tag_pair *assignment = ASSIGNMENTS; assignment->token; assignment++) {
+  for (token_exp_tag_pair *assignment = ASSIGNMENTS; unary && assignment->token; assignment++) {
     if (stream_is(stream, assignment->token)) {
+      srcloc_t loc = stream_loc(stream);
       stream_next(stream);
       exp_t *rhs = parse_assignment_exp(stream);
       if (!rhs) {
@@ -574,6 +986,8 @@ static exp_t* parse_assignment_exp(stream_t *stream) {
       }
       stream_commit(stream);
       exp_t *output = dcc_malloc(sizeof(exp_t));
+      output->tag = EXP_ASSIGN;
+      output->loc = loc;
       output->assignment.lhs = unary;
       output->assignment.rhs = rhs;
       output->assignment.operator = assignment->exp;
@@ -596,6 +1010,7 @@ static exp_t* parse_exp(stream_t *stream) {
   if (stream_is(stream, TOKEN_COMMA)) {
     exp_t *output = dcc_malloc(sizeof(exp_t));
     output->tag = EXP_LIST;
+    output->loc = exp->loc;
     output->list = exp_vec_new();
     do {
       stream_next(stream); // consume comma
@@ -605,7 +1020,7 @@ static exp_t* parse_exp(stream_t *stream) {
         stream_expected(stream, "expression after `,`");
       }
     } while (stream_is(stream, TOKEN_COMMA));
-    STREAM_COMMIT();
+    exp_vec_push(&output->list, exp);
     return output;
   } else {
     return exp;
@@ -618,7 +1033,7 @@ static exp_t* parse_exp(stream_t *stream) {
 
 static decltor_t* parse_decltor(stream_t *stream);
 static storage_spec_t parse_storage_spec(stream_t *stream);
-static type_spec_t* parse_type_spec(stream_t *stream);
+static type_spec_t* parse_type_spec(stream_t *stream, bool typedef_name);
 static type_qual_t parse_type_qual(stream_t *stream);
 static func_spec_t parse_func_spec(stream_t *stream);
 static initializer_t* parse_initializer(stream_t *stream);
@@ -680,7 +1095,7 @@ static init_decltor_vec_t parse_init_decltor_list(stream_t *stream) {
 
 static decl_spec_t* parse_decl_specs(stream_t *stream) {
 
-  decl_spec_t decl_spec = {0, 0, 0, 0};
+  decl_spec_t decl_spec = { 0, type_spec_vec_new(), 0, 0, stream_loc(stream) };
   bool succeeded = false;
   while (true) {
     STREAM_PUSH();
@@ -688,22 +1103,23 @@ static decl_spec_t* parse_decl_specs(stream_t *stream) {
     storage_spec_t storage = parse_storage_spec(stream);
     if (storage != AST_STORAGE_NONE) {
       if (storage & decl_spec.storage) {
-        dcc_ice("cannot repeat storage specifier");
+        stream_error(stream, "cannot repeat storage specifier");
       }
       decl_spec.storage |= storage;
       goto success;
     }
 
-    type_spec_t *tspec = parse_type_spec(stream);
+    // an identifier after a type specifier is what is being declared
+    type_spec_t *tspec = parse_type_spec(stream, !decl_spec.type_specs.size);
     if (tspec) {
-      decl_spec.type_spec = tspec;
+      type_spec_vec_push(&decl_spec.type_specs, tspec);
       goto success;
     }
 
     type_qual_t tqual = parse_type_qual(stream);
     if (tqual != TYPE_QUAL_NONE) {
       if (tqual & decl_spec.type_qual) {
-        dcc_ice("cannot repeat type qualifier");
+        stream_error(stream, "cannot repeat type qualifier");
       }
       decl_spec.type_qual |= tqual;
       goto success;
@@ -712,7 +1128,7 @@ static decl_spec_t* parse_decl_specs(stream_t *stream) {
     func_spec_t fspec = parse_func_spec(stream);
     if (fspec) {
       if (fspec & decl_spec.func_spec) {
-        dcc_ice("cannot repeat function specifier");
+        stream_error(stream, "cannot repeat function specifier");
       }
       decl_spec.func_spec |= fspec;
       goto success;
@@ -747,6 +1163,11 @@ static decl_t* parse_decl(stream_t *stream) {
   init_decltor_vec_t init_decltors = parse_init_decltor_list(stream);
   stream_expect(stream, TOKEN_SEMI);
 
+  for (size_t i = 0; i < init_decltors.size; i++) {
+    bind_name(stream, init_decltors.data[i]->declarator,
+              specifiers->storage & AST_STORAGE_TYPEDEF);
+  }
+
   decl_t *output = dcc_malloc(sizeof *output);
   output->specifiers = specifiers;
   output->init_decltors = init_decltors;
@@ -773,6 +1194,7 @@ static storage_spec_t parse_storage_spec(stream_t *stream) {
   token_tag_t tag = stream_peek(stream)->tag;
   for (struct pair *pair = PAIRS; pair->token; ++pair) {
     if (pair->token == tag) {
+      stream_next(stream);
       return pair->storage;
     }
   }
@@ -786,14 +1208,11 @@ static storage_spec_t parse_storage_spec(stream_t *stream) {
 static type_squal_t* parse_type_squal(stream_t *stream) {
   bool success = false;
 
-  type_squal_t squal = { 0, 0 };
+  type_squal_t squal = { type_spec_vec_new(), 0, stream_loc(stream) };
   while (true) {
-    type_spec_t *tspec = parse_type_spec(stream);
+    type_spec_t *tspec = parse_type_spec(stream, !squal.specs.size);
     if (tspec) {
-      if (squal.spec) {
-        dcc_ice("struct decl must included only one specifier");
-      }
-      squal.spec = tspec;
+      type_spec_vec_push(&squal.specs, tspec);
       success = true;
       continue;
     }
@@ -807,8 +1226,8 @@ static type_squal_t* parse_type_squal(stream_t *stream) {
 
     break;
   }
-  if (success && !squal.spec) {
-    dcc_ice("struct decl must include a type specifier");
+  if (success && !squal.specs.size) {
+    stream_error(stream, "struct decl must include a type specifier");
   }
 
   if (success) {
@@ -836,19 +1255,24 @@ static void parse_struct_decls(stream_t *stream, struct_decl_vec_t *sdecls) {
 
     struct_decltor_vec_t sdecltors = struct_decltor_vec_new();
     while(true) {
-      if (sdecltors.size > 0 && !stream_is(stream, TOKEN_COMMA)) {
-        // break if no comma after previous sdecltor
-        break;
+      if (sdecltors.size > 0) {
+        if (!stream_is(stream, TOKEN_COMMA)) {
+          // break if no comma after previous sdecltor
+          break;
+        }
+        stream_next(stream);
       }
+      // an unnamed bit-field has no declarator
       decltor_t *decltor = parse_decltor(stream);
-      if (!decltor) {
+      if (!decltor && !stream_is(stream, TOKEN_COLON)) {
         break;
       }
 
       exp_t *exp = 0;
       if (stream_is(stream, TOKEN_COLON)) {
         stream_next(stream);
-        exp = parse_exp(stream);
+        // a comma would start the next declarator
+        exp = parse_cond_exp(stream);
         // TODO FIXME only parse constant expressions here, for bitfields
       }
 
@@ -859,7 +1283,7 @@ static void parse_struct_decls(stream_t *stream, struct_decl_vec_t *sdecls) {
       struct_decltor_vec_push(&sdecltors, sdecltor);
     }
     if (sdecltors.size == 0) {
-      dcc_ice("struct field must have at least one declarator");
+      stream_error(stream, "struct field must have at least one declarator");
     }
 
     STREAM_COMMIT();
@@ -882,10 +1306,9 @@ static sunion_spec_t* parse_sunion_spec(stream_t *stream) {
   }
   stream_next(stream);
 
-  token_t *ident = 0;
+  ident_t ident = { 0, stream_loc(stream) };
   if (stream_is(stream, TOKEN_IDENT)) {
-    ident = stream_peek(stream);
-    stream_next(stream);
+    ident = stream_expect_ident(stream);
   }
 
   struct_decl_vec_t decls = struct_decl_vec_new();
@@ -912,37 +1335,34 @@ static enum_spec_t* parse_enum_spec(stream_t *stream) {
 
   stream_next(stream);
   enum_spec_t *output = dcc_malloc(sizeof *output);
-  output->ident = 0;
+  output->ident = (ident_t) { 0, stream_loc(stream) };
   output->enumtors = enumtor_vec_new();
 
   if (stream_is(stream, TOKEN_IDENT)) {
-    output->ident = stream_peek(stream);
-    stream_next(stream);
+    output->ident = stream_expect_ident(stream);
   }
 
   if (stream_is(stream, TOKEN_LCURLY)) {
     stream_next(stream);
 
     while (!stream_is(stream, TOKEN_RCURLY)) {
-      if (output->enumtors.size > 0) {
-        stream_expect(stream, TOKEN_COMMA);
-      }
-
       enumtor_t *enumtor = dcc_malloc(sizeof *enumtor);
-      enumtor->ident = stream_peek(stream);
-      stream_expect(stream, TOKEN_IDENT);
+      enumtor->ident = stream_expect_ident(stream);
+      enumtor->exp = 0;
+      enumtor->value = 0;
 
       if (stream_is(stream, TOKEN_EQUAL)) {
         stream_next(stream);
-        enumtor->exp = parse_exp(stream);
+        enumtor->exp = parse_cond_exp(stream);
         if (!enumtor->exp) {
           stream_expected(stream, "constant expression after `=`");
         }
       }
-      if (stream_is(stream, TOKEN_COMMA)) {
-        stream_next(stream);
-      }
       enumtor_vec_push(&output->enumtors, enumtor);
+      if (!stream_is(stream, TOKEN_COMMA)) {
+        break;
+      }
+      stream_next(stream);
     }
     stream_expect(stream, TOKEN_RCURLY);
   }
@@ -951,7 +1371,8 @@ static enum_spec_t* parse_enum_spec(stream_t *stream) {
   return output;
 }
 
-static type_spec_t* parse_type_spec(stream_t *stream) {
+// Identifiers are only taken as typedef names if `typedef_name` is set
+static type_spec_t* parse_type_spec(stream_t *stream, bool typedef_name) {
   static struct pair {
     token_tag_t token;
     enum type_spec_tag type;
@@ -961,6 +1382,7 @@ static type_spec_t* parse_type_spec(stream_t *stream) {
     { TOKEN_KEYWORD_SHORT, AST_TYPE_SHORT },
     { TOKEN_KEYWORD_INT, AST_TYPE_INT },
     { TOKEN_KEYWORD_LONG, AST_TYPE_LONG },
+    { TOKEN_KEYWORD_FLOAT, AST_TYPE_FLOAT },
     { TOKEN_KEYWORD_DOUBLE, AST_TYPE_DOUBLE },
     { TOKEN_KEYWORD_SIGNED, AST_TYPE_SIGNED },
     { TOKEN_KEYWORD_UNSIGNED, AST_TYPE_UNSIGNED },
@@ -985,7 +1407,7 @@ static type_spec_t* parse_type_spec(stream_t *stream) {
   sunion_spec_t *suspec = parse_sunion_spec(stream);
   if (suspec) {
     type_spec_t *output = dcc_malloc(sizeof *output);
-    output->tag = AST_TYPE_STRUCT;
+    output->tag = tag == TOKEN_KEYWORD_UNION ? AST_TYPE_UNION : AST_TYPE_STRUCT;
     output->suspec = suspec;
     STREAM_COMMIT();
     return output;
@@ -1000,11 +1422,11 @@ static type_spec_t* parse_type_spec(stream_t *stream) {
     return output;
   }
 
-  if (stream_is(stream, TOKEN_IDENT)) {
+  if (typedef_name && stream_is(stream, TOKEN_IDENT)
+      && is_typedef_name(stream, stream_peek(stream)->val.name)) {
     type_spec_t *output = dcc_malloc(sizeof *output);
     output->tag = AST_TYPE_TYPEDEF;
-    output->ident = stream_peek(stream);
-    stream_next(stream);
+    output->ident = stream_expect_ident(stream);
     STREAM_COMMIT();
     return output;
   }
@@ -1057,21 +1479,19 @@ static func_spec_t parse_func_spec(stream_t *stream) {
 
 static decltor_t* parse_abstract_decltor(stream_t *stream);
 
-static token_vec_t* parse_ident_list(stream_t *stream) {
+static ident_vec_t* parse_ident_list(stream_t *stream) {
   STREAM_PUSH();
-  token_t *token = stream_peek(stream);
-  if (token->tag != TOKEN_IDENT) {
+  if (!stream_is(stream, TOKEN_IDENT)) {
     STREAM_POP();
     return 0;
   }
 
-  token_vec_t *idents = dcc_malloc(sizeof(token_vec_t));
-  *idents = token_vec_new();
-  token_vec_push(idents, *token);
-  while (token = stream_peek(stream), token->tag == TOKEN_COMMA) {
+  ident_vec_t *idents = dcc_malloc(sizeof(ident_vec_t));
+  *idents = ident_vec_new();
+  ident_vec_push(idents, stream_expect_ident(stream));
+  while (stream_is(stream, TOKEN_COMMA)) {
     stream_next(stream); // skip comma
-    token = stream_expect(stream, TOKEN_IDENT);
-    token_vec_push(idents, *token);
+    ident_vec_push(idents, stream_expect_ident(stream));
   }
   STREAM_COMMITa("parsed ident_list (%d idents)", idents->size)
   return idents;
@@ -1087,7 +1507,9 @@ static param_decl_t* parse_param_decl(stream_t *stream) {
   }
 
   param_decl_t *output = dcc_malloc(sizeof *output);
+  output->specifiers = specifiers;
   output->is_abstract = false;
+  output->type = 0;
   output->decltor = parse_decltor(stream);
   if (!output->decltor) {
     output->decltor = parse_abstract_decltor(stream);
@@ -1120,74 +1542,49 @@ static param_type_list_t* parse_param_type_list(stream_t *stream) {
       continue;
     }
 
-    if (stream_is(stream, TOKEN_ELLIPSE)) {
-      stream_next(stream);
-      is_vararg = true;
-    }
+    stream_expect(stream, TOKEN_ELLIPSE);
+    is_vararg = true;
     break;
   }
 
   param_type_list_t *output = dcc_malloc(sizeof *output);
   output->decls = decls;
   output->is_vararg = is_vararg;
+  STREAM_COMMIT();
   return output;
 }
 
-// NOTE: basically a copy of parse_abstract_decltor()
-static decltor_t* parse_decltor(stream_t *stream) {
-  STREAM_PUSH();
-
+// Parse the `*` and qualifiers at the start of a (possibly abstract) declarator
+static type_qual_vec_t parse_pointers(stream_t *stream) {
   type_qual_vec_t pointers = type_qual_vec_new();
   while (stream_is(stream, TOKEN_STAR)) {
     stream_next(stream);
 
     type_qual_t total = TYPE_QUAL_NONE;
-    type_qual_t qual = parse_type_qual(stream);
-    while (qual != TYPE_QUAL_NONE) {
+    for (type_qual_t qual; (qual = parse_type_qual(stream)) != TYPE_QUAL_NONE;) {
       if (total & qual) { // already matched this qualifier, throw an error
-        dcc_ice("cannot repeat type qualifier");
+        stream_error(stream, "cannot repeat type qualifier");
       }
       total |= qual;
     }
 
     type_qual_vec_push(&pointers, total);
   }
+  return pointers;
+}
 
-
-  token_t *token = stream_peek(stream);
-  token_tag_t tag = token->tag;
-  if (!(tag == TOKEN_IDENT || tag == TOKEN_LPAREN)) {
-    // do not proceed if not followed by direct-decltor possible tokens
-    type_qual_vec_free(&pointers);
-    STREAM_POP();
-    return 0;
-  }
-  stream_next(stream);
-
-  direct_decltor_vec_t directs = direct_decltor_vec_new();
+// Parse the array and function suffixes of a (possibly abstract) declarator
+// into `directs`. Only concrete declarators may use an identifier list.
+static void parse_direct_suffixes(stream_t *stream, direct_decltor_vec_t *directs,
+                                  bool abstract) {
   direct_decltor_t direct;
-  if (tag == TOKEN_IDENT) {
-    direct.tag = AST_DECLTOR_IDENT;
-    direct.ident = token;
-  } else { // TOKEN_LPAREN, see ifstatement above
-    direct.tag = AST_DECLTOR_NESTED;
-    direct.nested = parse_abstract_decltor(stream);
-    if (!direct.nested) {
-      stream_expected(stream, "declarator after `(`");
-    }
-    stream_expect(stream, TOKEN_RPAREN);
-  }
-  direct_decltor_vec_push(&directs, direct);
-
   while(true) {
     if (stream_is(stream, TOKEN_LPAREN)) {
       stream_next(stream);
 
-      param_type_list_t *params = parse_param_type_list(stream);
-      if (params) {
-        direct.tag = AST_DECLTOR_FUNC_TYPES;
-        direct.params = parse_param_type_list(stream);
-      } else {
+      direct.tag = AST_DECLTOR_FUNC_TYPES;
+      direct.params = parse_param_type_list(stream);
+      if (!direct.params && !abstract) {
         direct.tag = AST_DECLTOR_FUNC_IDENTS;
         direct.idents = parse_ident_list(stream);
         // param list may be empty, which returns null
@@ -1195,26 +1592,30 @@ static decltor_t* parse_decltor(stream_t *stream) {
 
       stream_expect(stream, TOKEN_RPAREN);
     } else if (stream_is(stream, TOKEN_LSQUARE)) {
+      stream_next(stream);
       direct.tag = AST_DECLTOR_ARRAY;
       direct.array.is_static = false;
       direct.array.is_vla = false;
+      direct.array.exp = 0;
 
       if (stream_is(stream, TOKEN_KEYWORD_STATIC)) {
         stream_next(stream);
         direct.array.is_static = true;
       }
 
-      direct.array.qualifiers = parse_type_qual(stream);
+      direct.array.qualifiers = TYPE_QUAL_NONE;
+      for (type_qual_t qual; (qual = parse_type_qual(stream)) != TYPE_QUAL_NONE;) {
+        direct.array.qualifiers |= qual;
+      }
       if (stream_is(stream, TOKEN_STAR)) {
         stream_next(stream);
         direct.array.is_vla = true;
         goto vla;
       }
 
-
       if (stream_is(stream, TOKEN_KEYWORD_STATIC)) {
         if (direct.array.is_static) {
-          dcc_ice("cannot repeat `static`");
+          stream_error(stream, "cannot repeat `static`");
         }
         stream_next(stream);
         direct.array.is_static = true;
@@ -1222,16 +1623,50 @@ static decltor_t* parse_decltor(stream_t *stream) {
 
       direct.array.exp = parse_assignment_exp(stream);
       if (direct.array.is_static && !direct.array.exp) {
-        dcc_ice("assignment-expression must follow static inside declarator");
+        stream_error(stream, "assignment-expression must follow static inside declarator");
       }
 
     vla:
       stream_expect(stream, TOKEN_RSQUARE);
-   } else {
+    } else {
       break;
     }
-    direct_decltor_vec_push(&directs, direct);
+    direct_decltor_vec_push(directs, direct);
   }
+}
+
+static decltor_t* parse_decltor(stream_t *stream) {
+  STREAM_PUSH();
+
+  type_qual_vec_t pointers = parse_pointers(stream);
+
+  token_tag_t tag = stream_peek(stream)->tag;
+  if (!(tag == TOKEN_IDENT || tag == TOKEN_LPAREN)) {
+    // do not proceed if not followed by direct-decltor possible tokens
+    type_qual_vec_free(&pointers);
+    STREAM_POP();
+    return 0;
+  }
+
+  direct_decltor_t direct;
+  if (tag == TOKEN_IDENT) {
+    direct.tag = AST_DECLTOR_IDENT;
+    direct.ident = stream_expect_ident(stream);
+  } else { // TOKEN_LPAREN, see ifstatement above
+    stream_next(stream);
+    direct.tag = AST_DECLTOR_NESTED;
+    direct.nested = parse_decltor(stream);
+    if (!direct.nested) {
+      // a parenthesized parameter list, so this declarator is abstract
+      type_qual_vec_free(&pointers);
+      STREAM_POP();
+      return 0;
+    }
+    stream_expect(stream, TOKEN_RPAREN);
+  }
+  direct_decltor_vec_t directs = direct_decltor_vec_new();
+  direct_decltor_vec_push(&directs, direct);
+  parse_direct_suffixes(stream, &directs, false);
 
   decltor_t *output = dcc_malloc(sizeof *output);
   output->pointers = pointers;
@@ -1244,85 +1679,29 @@ static decltor_t* parse_decltor(stream_t *stream) {
 // stdspec.6.7.6 Type names
 ////////////////////////////////////////////////////////////////////////////////
 
-// NOTE: basically a copy of parse_decltor()
 static decltor_t* parse_abstract_decltor(stream_t *stream) {
   STREAM_PUSH();
 
-  type_qual_vec_t pointers = type_qual_vec_new();
-  while (stream_is(stream, TOKEN_STAR)) {
-    stream_next(stream);
-
-    type_qual_t total = TYPE_QUAL_NONE;
-    type_qual_t qual = parse_type_qual(stream);
-    while (qual != TYPE_QUAL_NONE) {
-      if (total & qual) { // already matched this qualifier, throw an error
-        dcc_ice("cannot repeat type qualifier");
-      }
-      total |= qual;
-    }
-
-    type_qual_vec_push(&pointers, total);
-  }
+  type_qual_vec_t pointers = parse_pointers(stream);
 
+  // `(` opens either a nested declarator or a parameter list
   direct_decltor_vec_t directs = direct_decltor_vec_new();
-  direct_decltor_t direct;
-  if (stream_is(stream, TOKEN_RPAREN)) {
+  if (stream_is(stream, TOKEN_LPAREN)) {
+    STREAM_PUSH();
     stream_next(stream);
 
+    direct_decltor_t direct;
     direct.tag = AST_DECLTOR_NESTED;
     direct.nested = parse_abstract_decltor(stream);
-    if (!direct.nested) {
-      stream_expected(stream, "abstract-declarator after `(`");
-    }
-    direct_decltor_vec_push(&directs, direct);
-    stream_expect(stream, TOKEN_RPAREN);
-  }
-
-  while(true) {
-    if (stream_is(stream, TOKEN_LPAREN)) {
+    if (direct.nested && stream_is(stream, TOKEN_RPAREN)) {
       stream_next(stream);
-
-      direct.tag = AST_DECLTOR_FUNC_TYPES;
-      direct.params = parse_param_type_list(stream);
-
-      stream_expect(stream, TOKEN_RPAREN);
-    } else if (stream_is(stream, TOKEN_LSQUARE)) {
-      direct.tag = AST_DECLTOR_ARRAY;
-      direct.array.is_static = false;
-      direct.array.is_vla = false;
-      direct.array.qualifiers = 0;
-
-      if (stream_is(stream, TOKEN_STAR)) {
-        stream_next(stream);
-        direct.array.is_vla = true;
-        goto vla;
-      } else if (stream_is(stream, TOKEN_KEYWORD_STATIC)) {
-        stream_next(stream);
-        direct.array.is_static = true;
-      }
-
-      direct.array.qualifiers = parse_type_qual(stream);
-
-      if (stream_is(stream, TOKEN_KEYWORD_STATIC)) {
-        if (direct.array.is_static) {
-          dcc_ice("cannot repeat `static`");
-        }
-        stream_next(stream);
-        direct.array.is_static = true;
-      }
-
-      direct.array.exp = parse_assignment_exp(stream);
-      if (direct.array.is_static && !direct.array.exp) {
-        dcc_ice("assignment-expression must follow static inside declarator");
-      }
-
-    vla:
-      stream_expect(stream, TOKEN_RSQUARE);
-   } else {
-      break;
+      direct_decltor_vec_push(&directs, direct);
+      STREAM_COMMIT();
+    } else {
+      STREAM_POP();
     }
-    direct_decltor_vec_push(&directs, direct);
   }
+  parse_direct_suffixes(stream, &directs, true);
 
   if (pointers.size > 0 || directs.size > 0) {
     decltor_t *output = dcc_malloc(sizeof *output);
@@ -1331,6 +1710,7 @@ static decltor_t* parse_abstract_decltor(stream_t *stream) {
     STREAM_COMMIT();
     return output;
   } else {
+    type_qual_vec_free(&pointers);
     STREAM_POP();
     return 0;
   }
@@ -1339,7 +1719,7 @@ static decltor_t* parse_abstract_decltor(stream_t *stream) {
 static type_name_t* parse_type_name(stream_t *stream) {
   STREAM_PUSH();
 
-  type_name_t tname = { 0, 0 };
+  type_name_t tname = { 0, 0, 0 };
 
   tname.squal = parse_type_squal(stream);
   if (!tname.squal) {
@@ -1368,6 +1748,7 @@ static designator_t* parse_designator(stream_t *stream) {
   STREAM_PUSH();
 
   designator_t designator;
+  designator.index = 0;
   if (stream_is(stream, TOKEN_LSQUARE)) {
     stream_next(stream);
     designator.tag = DESIGNATOR_EXP;
@@ -1380,14 +1761,12 @@ static designator_t* parse_designator(stream_t *stream) {
     stream_next(stream);
   } else if (stream_is(stream, TOKEN_DOT)) {
     stream_next(stream);
-    token_t *token = stream_peek(stream);
-    if (token->tag != TOKEN_IDENT) {
+    if (!stream_is(stream, TOKEN_IDENT)) {
       STREAM_POP();
       return 0;
     }
-    stream_next(stream);
     designator.tag = DESIGNATOR_IDENT;
-    designator.ident = token;
+    designator.ident = stream_expect_ident(stream);
   } else {
     STREAM_POP();
     return 0;
@@ -1435,7 +1814,11 @@ static initialization_vec_t* parse_initialization_list(stream_t *stream) {
   while (true) {
     STREAM_PUSH();
     if (output->size > 0) {
-      stream_expect(stream, TOKEN_COMMA);
+      if (!stream_is(stream, TOKEN_COMMA)) {
+        STREAM_POP();
+        break;
+      }
+      stream_next(stream);
     }
 
     designator_vec_t *designators = parse_designators(stream);
@@ -1451,6 +1834,11 @@ static initialization_vec_t* parse_initialization_list(stream_t *stream) {
     });
     STREAM_COMMIT();
   }
+  // a trailing comma is allowed
+  if (output->size > 0 && stream_is(stream, TOKEN_COMMA)) {
+    stream_next(stream);
+  }
+  stream_expect(stream, TOKEN_RCURLY);
 
   STREAM_COMMIT();
   return output;
@@ -1499,7 +1887,8 @@ static stmt_t* parse_label(stream_t *stream) {
     output = dcc_malloc(sizeof *output);
     output->tag = STMT_CASE;
 
-    output->stmt_case.exp = parse_exp(stream);
+    output->stmt_case.exp = parse_cond_exp(stream);
+    output->stmt_case.value = 0;
     stream_assert(stream, output->stmt_case.exp, "constant expression after `case`");
 
     stream_expect(stream, TOKEN_COLON);
@@ -1516,12 +1905,12 @@ static stmt_t* parse_label(stream_t *stream) {
     output->stmt = parse_statement(stream);
     stream_assert(stream, output->stmt, "statement after `:`");
   } else if (stream_is(stream, TOKEN_IDENT)) {
-    stream_next(stream);
+    ident_t ident = stream_expect_ident(stream);
 
     if (stream_is(stream, TOKEN_COLON)) {
       output = dcc_malloc(sizeof *output);
       output->tag = STMT_LABEL;
-      output->stmt_label.ident = stream_peek(stream);
+      output->stmt_label.ident = ident;
       stream_next(stream);
 
       output->stmt_label.stmt = parse_statement(stream);
@@ -1545,7 +1934,7 @@ static block_item_t* parse_block_item(stream_t *stream) {
   decl_t *decl = parse_decl(stream);
   if (decl) {
     block_item_t *output = dcc_malloc(sizeof *output);
-    output->tag = AST_STATEMENT;
+    output->tag = AST_DECLARATION;
     output->declaration = decl;
     STREAM_COMMIT();
     return output;
@@ -1564,34 +1953,47 @@ static block_item_t* parse_block_item(stream_t *stream) {
   return 0;
 }
 
+static bool parse_block_item_into(stream_t *stream, void *items) {
+  block_item_t* item = parse_block_item(stream);
+  if (!item) {
+    if (stream_is(stream, TOKEN_RCURLY) || stream_is(stream, TOKEN_EOF)) {
+      return false;
+    }
+    stream_expected(stream, "declaration or statement");
+  }
+  block_item_vec_push(items, item);
+  return true;
+}
+
 static stmt_t* parse_compound_statement(stream_t *stream) {
   STREAM_PUSH();
   if (!stream_is(stream, TOKEN_LCURLY)) {
     STREAM_POP();
     return 0;
   }
+  srcloc_t loc = stream_loc(stream);
   stream_next(stream); // consume LCURLY
 
   stmt_t *output = dcc_malloc(sizeof *output);
   output->tag = STMT_COMPOUND;
+  output->loc = loc;
   output->stmt_compound = block_item_vec_new();
-  while (true) {
-    block_item_t* item = parse_block_item(stream);
-    if (!item) {
-      break;
-    }
-    block_item_vec_push(&output->stmt_compound, item);
-  }
+  dcc_scope_enter(&stream->names);
+  while (parse_recoverable(stream, parse_block_item_into,
+                           &output->stmt_compound, false)) {}
+  dcc_scope_leave(&stream->names);
   stream_expect(stream, TOKEN_RCURLY); // consume RCURLY
   STREAM_COMMIT();
   return output;
 }
 
+// An expression statement, or the null statement `;` with a null exp
 static stmt_t *parse_exp_statement (stream_t *stream) {
   STREAM_PUSH();
 
   exp_t *exp = parse_exp(stream);
-  if (exp) {
+  if (exp || stream_is(stream, TOKEN_SEMI)) {
+    stream_expect(stream, TOKEN_SEMI);
     stmt_t *output = dcc_malloc(sizeof *output);
     output->tag = STMT_EXP;
     output->exp = exp;
@@ -1612,8 +2014,6 @@ static stmt_t* parse_selection(stream_t *stream) {
     STREAM_POP();
     return 0;
   }
-  stream_next(stream);
-
   stream_next(stream);
   stream_expect(stream, TOKEN_LPAREN);
 
@@ -1628,8 +2028,9 @@ static stmt_t* parse_selection(stream_t *stream) {
   stmt_t *output = dcc_malloc(sizeof *output);
   if (tag == TOKEN_KEYWORD_IF) {
     if (stream_is(stream, TOKEN_KEYWORD_ELSE)) {
+      stream_next(stream);
       secondary = parse_statement(stream);
-      stream_assert(stream, secondary, "statement after `)`");
+      stream_assert(stream, secondary, "statement after `else`");
     }
     output->tag = STMT_IF;
   } else if (tag == TOKEN_KEYWORD_SWITCH) {
@@ -1638,7 +2039,7 @@ static stmt_t* parse_selection(stream_t *stream) {
 
   output->stmt_select.exp = exp;
   output->stmt_select.primary = primary;
-  output->stmt_select.primary = secondary;
+  output->stmt_select.secondary = secondary;
 
   STREAM_COMMIT();
   return output;
@@ -1690,23 +2091,31 @@ static stmt_t* parse_iteration(stream_t *stream) {
     output->stmt_whiledo.stmt = stmt;
   } else if (tag == TOKEN_KEYWORD_FOR) {
     stream_expect(stream, TOKEN_LPAREN);
-    exp = parse_exp(stream);
-    stream_expect(stream, TOKEN_SEMI);
+    // the declaration is scoped to the loop and consumes its own `;`
+    dcc_scope_enter(&stream->names);
+    decl_t *decl = parse_decl(stream);
+    exp = 0;
+    if (!decl) {
+      exp = parse_exp(stream);
+      stream_expect(stream, TOKEN_SEMI);
+    }
 
     exp2 = parse_exp(stream);
     stream_expect(stream, TOKEN_SEMI);
 
     exp3 = parse_exp(stream);
-    stream_expect(stream, TOKEN_SEMI);
     stream_expect(stream, TOKEN_RPAREN);
 
     stmt = parse_statement(stream);
+    stream_assert(stream, stmt, "statement after `)`");
+    dcc_scope_leave(&stream->names);
 
     output->tag = STMT_FOR;
+    output->stmt_for.decl = decl;
     output->stmt_for.exp1 = exp;
     output->stmt_for.exp2 = exp2;
     output->stmt_for.exp3 = exp3;
-    output->stmt_whiledo.stmt = stmt;
+    output->stmt_for.stmt = stmt;
   }
 
   STREAM_COMMIT();
@@ -1721,17 +2130,15 @@ static stmt_t* parse_jump(stream_t *stream) {
   if (stream_is(stream, TOKEN_KEYWORD_GOTO)) {
     stream_next(stream);
 
-    token_t *tok = stream_peek(stream);
-    stream_expect(stream, TOKEN_IDENT);
+    ident_t label = stream_expect_ident(stream);
     stream_expect(stream, TOKEN_SEMI);
 
     output->tag = STMT_GOTO;
-    output->token = tok;
+    output->label = label;
   } else if (stream_is(stream, TOKEN_KEYWORD_CONTINUE)) {
     stream_next(stream);
     stream_expect(stream, TOKEN_SEMI);
 
-    stmt_t *output = dcc_malloc(sizeof *output);
     output->tag = STMT_CONTINUE;
   } else if (stream_is(stream, TOKEN_KEYWORD_BREAK)) {
     stream_next(stream);
@@ -1768,9 +2175,11 @@ static stmt_t* parse_statement(stream_t *stream) {
   };
 
   STREAM_PUSH();
+  srcloc_t loc = stream_loc(stream);
   for (stmt_func_t* func = STATEMENTS; *func; ++func) {
     stmt_t *output = (*func)(stream);
     if (output) {
+      output->loc = loc;
       STREAM_COMMIT();
       return output;
     }
@@ -1798,8 +2207,13 @@ static func_def_t* parse_func_def(stream_t *stream) {
   if (!stream_is(stream, TOKEN_LCURLY)) {
     goto error;
   }
+  // the function is visible in its own body, the parameters only there
+  bind_name(stream, decltor, false);
+  dcc_scope_enter(&stream->names);
+  bind_params(stream, decltor);
   // TODO Why can we only now commit to func_def
   stmt_t *compound = parse_compound_statement(stream);
+  dcc_scope_leave(&stream->names);
   if (!compound) {
     goto error;
   }
@@ -1847,30 +2261,46 @@ static external_decl_t* parse_external_decl(stream_t *stream) {
   return output;
 }
 
-external_decl_vec_t dcc_parse(token_vec_t *tokens) {
+static bool parse_external_decl_into(stream_t *stream, void *decls) {
+  external_decl_t *ext_decl = parse_external_decl(stream);
+  if (!ext_decl) {
+    if (stream_is(stream, TOKEN_EOF)) {
+      return false;
+    }
+    stream_expected(stream, "declaration");
+  }
+  external_decl_vec_push(decls, ext_decl);
+  return true;
+}
+
+external_decl_vec_t dcc_parse(pp_t *pp, diag_vec_t *diags) {
   stream_t stream = {
-    .tokens = *tokens, // TODO figure lifetime of tokens
+    .pp = pp,
+    .tokens = token_vec_new(),
+    .base = 0,
     .stack = int_vec_new(),
+    .diags = diags,
+    .recover = 0,
+    .names = dcc_scope_new(),
   };
 
   stream_push(&stream);
+  dcc_scope_enter(&stream.names);
 
   external_decl_vec_t output = external_decl_vec_new();
-  external_decl_t *ext_decl;
-  while (true) {
-    ext_decl = parse_external_decl(&stream);
-    if (!ext_decl) {
-      break;
-    }
-    external_decl_vec_push(&output, ext_decl);
+  while (parse_recoverable(&stream, parse_external_decl_into, &output, true)) {
+    stream_discard(&stream);
   }
   dcc_assert(stream_peek(&stream)->tag == TOKEN_EOF);
+  token_vec_free(&stream.tokens);
+  int_vec_free(&stream.stack);
+  dcc_scope_free(&stream.names);
 
   return output;
 }
 
-// ignore warning about tautological test in macro below
-#ifdef __GNUC__
+// ignore clang's warning about tautological test in macro below
+#ifdef __clang__
 #pragma GCC diagnostic ignored "-Wtautological-constant-out-of-range-compare"
 #endif
 #define STRING_GETTER(name, type, strings)          \
@@ -15,7 +15,12 @@
   along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#pragma once
+
 #include "dcc.h"
+#include "diag.h"
+#include "pp.h"
+#include "strlit.h"
 #include "vec.h"
 #include "tokenize.h"
 
@@ -38,6 +43,18 @@ typedef struct initializer initializer_t;
 typedef struct struct_decltor struct_decltor_t;
 typedef struct type_squal type_squal_t;
 DECLARE_VEC(exp_t*, exp_vec);
+
+struct symbol;
+
+// The AST does not point into the token vector; identifiers are kept as
+// interned names plus the location of their token. dcc_sema() then binds each
+// one to the symbol it declares or refers to.
+typedef struct {
+  const name_t *name;
+  srcloc_t loc;
+  struct symbol *symbol; // null until bound
+} ident_t;
+DECLARE_VEC(ident_t, ident_vec);
 DECLARE_VEC(initialization_t, initialization_vec);
 DECLARE_VEC(struct_decltor_t, struct_decltor_vec);
 
@@ -61,18 +78,19 @@ typedef struct {
 DECLARE_VEC(struct_decl_t, struct_decl_vec);
 
 typedef struct {
-  token_t *ident; // nullable
+  ident_t ident; // name nullable
   struct_decl_vec_t decls;
 } sunion_spec_t;
 
 typedef struct {
-  token_t *ident;
-  exp_t *exp;
+  ident_t ident;
+  exp_t *exp; // nullable
+  int64_t value; // set by dcc_sema()
 } enumtor_t;
 DECLARE_VEC(enumtor_t*, enumtor_vec);
 
 typedef struct {
-  token_t *ident; // nullable
+  ident_t ident; // name nullable
   enumtor_vec_t enumtors; // nullable
 } enum_spec_t;
 
@@ -97,9 +115,10 @@ typedef struct {
   union {
     sunion_spec_t *suspec;
     enum_spec_t *espec;
-    token_t *ident;
+    ident_t ident;
   };
 } type_spec_t;
+DECLARE_VEC(type_spec_t*, type_spec_vec);
 DECLARE_STRING_GETTER(type_spec);
 
 typedef enum type_qual {
@@ -111,8 +130,9 @@ typedef enum type_qual {
 DECLARE_VEC(type_qual_t, type_qual_vec);
 
 struct type_squal {
-    type_spec_t *spec;
+    type_spec_vec_t specs; // in source order, like `unsigned long`
     type_qual_t qual;
+    srcloc_t loc;
 }; // typedef forward declared
 
 typedef enum func_spec_tag {
@@ -123,15 +143,17 @@ DECLARE_STRING_GETTER(func_spec);
 
 typedef struct {
     storage_spec_t storage;
-    type_spec_t *type_spec;
+    type_spec_vec_t type_specs; // in source order, like `unsigned long`
     type_qual_t type_qual;
     func_spec_t func_spec;
+    srcloc_t loc;
 } decl_spec_t;
 
 typedef struct {
   decl_spec_t *specifiers;
   decltor_t *decltor; // may be null
   bool is_abstract;
+  const struct type *type; // adjusted to a pointer if need be, null until dcc_sema()
 } param_decl_t;
 DECLARE_VEC(param_decl_t*, param_decl_vec);
 
@@ -149,7 +171,7 @@ typedef struct {
     AST_DECLTOR_FUNC_IDENTS,
   } tag;
   union {
-    token_t *ident;
+    ident_t ident;
     decltor_t *nested;
     struct {
       bool is_static;
@@ -158,7 +180,7 @@ typedef struct {
       exp_t *exp;
     } array;
     param_type_list_t *params;
-    token_vec_t *idents; // nullable
+    ident_vec_t *idents; // nullable
   };
 } direct_decltor_t;
 DECLARE_VEC(direct_decltor_t, direct_decltor_vec);
@@ -171,6 +193,7 @@ struct decltor {
 typedef struct {
   type_squal_t *squal;
   decltor_t *decltor;
+  const struct type *type; // null until dcc_sema()
 } type_name_t;
 
 typedef struct constant {
@@ -181,10 +204,13 @@ typedef struct constant {
     CONSTANT_CHAR,
   } tag;
   union {
-    int integer;
+    uint64_t integer; // also CONSTANT_CHAR
     double floating;
-    
   };
+  // the spelling an integer constant's type depends on
+  bool is_unsigned, is_decimal;
+  uint8_t longs;
+  literal_prefix_t prefix; // of a character constant, which its type depends on
 } constant_t;
 
 struct exp {
@@ -230,12 +256,20 @@ struct exp {
     EXP_SIZEOFEXP,
     EXP_SIZEOFTYPE,
     EXP_NEGATE,
+    EXP_CAST,
+    // the builtins <stdarg.h> is made of, whose va_list is the first operand
+    EXP_VA_START, // binary: the va_list and the last named parameter
+    EXP_VA_ARG, // cast: the type read and the va_list
+    EXP_VA_COPY, // binary: the destination and the source
+    EXP_VA_END, // unary
   } tag;
+  srcloc_t loc;
+  const struct type *type; // before any decay; null until dcc_sema()
   union {
     struct {
       type_name_t *type;
-      struct exp *value;
-    } cast;
+      struct exp *value; // null for EXP_SIZEOFTYPE
+    } cast; // EXP_CAST, EXP_SIZEOFTYPE and EXP_VA_ARG
     struct exp *unary;
     struct {
       struct exp *lhs, *rhs;
@@ -250,9 +284,10 @@ struct exp {
     exp_vec_t list;
     struct {
       struct exp *lhs;
-      token_t *name;
+      ident_t name;
     } child;
-    token_t *token;
+    ident_t ident;
+    strlit_t *string;
     constant_t *constant;
     struct {
       struct exp *lhs, *rhs;
@@ -266,7 +301,7 @@ struct exp {
 };
 
 struct struct_decltor {
-  decltor_t *decltor;
+  decltor_t *decltor; // null for an unnamed bit-field
   exp_t *exp;
 }; // typedef forward declared
 
@@ -276,9 +311,10 @@ typedef struct {
     DESIGNATOR_IDENT,
   } tag;
   union {
-    token_t *ident;
+    ident_t ident;
     exp_t *exp;
   };
+  int64_t index; // of a DESIGNATOR_EXP, set by dcc_sema()
 } designator_t;
 DECLARE_VEC(designator_t*, designator_vec);
 
@@ -342,32 +378,35 @@ struct stmt {
     STMT_BREAK,
     STMT_RETURN,
   } tag;
+  srcloc_t loc;
   union {
     /* exp_t *exp; */
     struct {
       exp_t *exp;
       stmt_t *stmt;
+      int64_t value; // set by dcc_sema()
     } stmt_case;
     struct {
-      token_t *ident;
+      ident_t ident;
       stmt_t *stmt;
     } stmt_label;
     stmt_t *stmt;
     block_item_vec_t stmt_compound;
-    exp_t *exp;
+    exp_t *exp; // STMT_EXP and STMT_RETURN, nullable
     struct {
       exp_t *exp;
-      stmt_t *primary, *secondary;
+      stmt_t *primary, *secondary; // secondary nullable
     } stmt_select;
     struct {
       exp_t *exp;
       stmt_t *stmt;
     } stmt_whiledo;
     struct {
-      exp_t *exp1, *exp2, *exp3;
+      decl_t *decl; // C99 declaration in place of exp1, nullable
+      exp_t *exp1, *exp2, *exp3; // nullable
       stmt_t *stmt;
     } stmt_for;
-    token_t *token;
+    ident_t label; // STMT_GOTO
   };
 };
 
@@ -391,4 +430,15 @@ typedef struct {
 DECLARE_VEC(external_decl_t*, external_decl_vec);
 DECLARE_STRING_GETTER(external_decl);
 
-external_decl_vec_t dcc_parse(token_vec_t *tokens);
+// Parse a translation unit. Syntax errors are recorded in `diags` and parsing
+// resumes at the next statement or declaration; check dcc_diag_error_count().
+// The resulting AST holds no references to `tokens`, which may be freed as soon
+// as this returns.
+// Parse the translation unit read from `pp`, which must have entered its file
+external_decl_vec_t dcc_parse(pp_t *pp, diag_vec_t *diags);
+
+// The identifier `decltor` declares, or null if it is abstract
+ident_t* dcc_decltor_ident(decltor_t *decltor);
+// The parameter list of the function `decltor` declares, or null if it does not
+// declare a function
+direct_decltor_t* dcc_decltor_func(decltor_t *decltor);
@@ -0,0 +1,2690 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dcc.h"
+#include "intern.h"
+#include "pp.h"
+#include "ptrmap.h"
+#include "vec_types.h"
+
+#define MAX_INCLUDE_DEPTH 200
+
+// The headers dcc ships in include/, which the Makefile points at
+#ifndef DCC_INCLUDE_DIR
+#define DCC_INCLUDE_DIR "/usr/local/lib/dcc/include"
+#endif
+
+static const char *SYSTEM_INCLUDE_DIRS[] = {
+  DCC_INCLUDE_DIR,
+  "/usr/local/include",
+  "/usr/include/x86_64-linux-gnu",
+  "/usr/include",
+};
+
+static const char *PREDEFINED_MACROS[] = {
+  "__STDC__=1",
+  "__STDC_HOSTED__=1",
+  "__STDC_VERSION__=199901L",
+  "__CHAR_BIT__=8",
+  "__LP64__=1",
+  "__x86_64__=1",
+  "__linux__=1",
+};
+
+typedef char* str_t;
+DECLARE_VEC(str_t, str_vec);
+DEFINE_VEC2(str_t, str_vec);
+
+typedef const name_t* name_ptr_t;
+DECLARE_VEC(name_ptr_t, name_vec);
+DEFINE_VEC2(name_ptr_t, name_vec);
+
+////////////////////////////////////////////////////////////////////////////////
+// Preprocessor state
+////////////////////////////////////////////////////////////////////////////////
+
+typedef enum {
+  MACRO_OBJECT,
+  MACRO_FUNCTION,
+  MACRO_FILE, // __FILE__
+  MACRO_LINE, // __LINE__
+} macro_kind_t;
+
+typedef struct {
+  macro_kind_t kind;
+  const name_t *name;
+  srcloc_t loc;
+  bool variadic; // the last parameter is __VA_ARGS__
+  bool has_ops; // the body uses # or ##
+  bool kept; // by a recorded inclusion, which outlives it; see pp->kept
+  name_vec_t params;
+  token_vec_t body;
+} macro_t;
+
+typedef macro_t* macro_ptr_t;
+DECLARE_VEC(macro_ptr_t, macro_vec);
+DEFINE_VEC2(macro_ptr_t, macro_vec);
+
+struct include;
+
+typedef struct {
+  const source_file_t *source; // null until a file from a precompiled header is entered
+  const name_t *path; // canonical, or null if the file has none
+  token_vec_t tokens;
+  bool tokenized;
+  bool once; // #pragma once
+  const name_t *guard; // the file may be skipped while this is defined
+  bool system; // found in a system directory, or next to a file which was
+  uint32_t unit; // the last translation unit to include it, see dcc_pp_scan()
+  struct include *includes; // recorded inclusions, newest first
+} pp_file_t;
+
+typedef pp_file_t* pp_file_ptr_t;
+DECLARE_VEC(pp_file_ptr_t, pp_file_vec);
+DEFINE_VEC2(pp_file_ptr_t, pp_file_vec);
+
+// A file has an include guard when its first directive is #ifndef and nothing
+// but whitespace and comments follows the matching #endif. Each frame watches
+// for this while its file is read.
+typedef enum {
+  GUARD_START, // nothing seen yet
+  GUARD_OPEN, // inside the leading #ifndef
+  GUARD_CLOSED, // past its #endif with nothing after it so far
+  GUARD_NONE, // not guarded
+} guard_state_t;
+
+// An entry of the include stack
+typedef struct {
+  pp_file_t *file;
+  size_t pos; // index into file->tokens
+  size_t cond_depth; // conditionals open when the file was entered
+  guard_state_t guard_state;
+  const name_t *guard;
+  struct include *record; // being made of this inclusion, if scanning
+} frame_t;
+DECLARE_VEC(frame_t, frame_vec);
+DEFINE_VEC2(frame_t, frame_vec);
+
+// What one inclusion of a file looked at and what it did, see replay_include()
+typedef struct include {
+  ptrmap_t reads; // name_t* -> macro_t* found when first looked up, or NO_MACRO
+  ptrmap_t writes; // name_t* -> macro_t* left defined, or NO_MACRO
+  ptrmap_t onces; // pp_file_t* -> ONCE_SET or ONCE_CLEAR, as first found
+  ptrmap_t made_once; // pp_file_t* -> itself
+  pp_file_vec_t deps; // every file it included, in order
+  size_t diag_count; // diagnostics before it began
+  struct include *next;
+} include_t;
+
+// An open #if; skipped groups are never on this stack
+typedef struct {
+  srcloc_t loc;
+  bool taken; // one of the groups has been included
+  bool seen_else;
+} cond_t;
+DECLARE_VEC(cond_t, cond_vec);
+DEFINE_VEC2(cond_t, cond_vec);
+
+// Arguments of one function-like macro invocation, which also hold the tokens
+// made by # and ##
+typedef struct {
+  token_vec_t tokens; // every argument, back to back
+  uint32_vec_t bounds; // argument i is tokens[bounds[i]..bounds[i+1])
+  token_vec_t *expanded; // macro-expanded arguments, made on demand
+  bool *is_expanded;
+  token_t *made;
+  size_t made_count;
+} args_t;
+
+// Expansions are rescanned from a stack of contexts. Rather than copies, a
+// context refers to a slice of a macro body, an argument or a directive line;
+// tokens are only materialized as they are read, at which point the hide-set
+// of the expansion is added to them.
+typedef struct {
+  const token_t *p, *end;
+  uint32_t hideset;
+  int first_flags; // replaces the flags of the next token unless negative
+  token_t token; // a lone token pushed back, see unread_token()
+  bool has_token;
+  args_t *args; // freed with the context
+} context_t;
+DECLARE_VEC(context_t, context_vec);
+DEFINE_VEC2(context_t, context_vec);
+
+// Hide-sets (Prosser's algorithm) are interned, so tokens carry a small id and
+// equal sets share one id. Id 0 is the empty set.
+typedef struct {
+  name_ptr_t *names; // sorted by address
+  uint32_t count;
+  uint32_t hash;
+} hideset_t;
+DECLARE_VEC(hideset_t, hideset_vec);
+DEFINE_VEC2(hideset_t, hideset_vec);
+
+struct pp {
+  diag_vec_t *diags;
+  str_vec_t include_dirs;
+
+  ptrmap_t macros; // name_t* -> macro_t*
+  ptrmap_t scratch; // interned spelling -> token_t*, see scratch_token()
+  macro_vec_t undefined; // freed with the preprocessor
+  ptrmap_t files; // interned path as searched -> pp_file_t*
+  ptrmap_t real_files; // interned canonical path -> pp_file_t*
+  pp_file_vec_t all_files;
+  // output of a precompiled header, read before the file entered
+  const token_t *prefix, *prefix_end;
+
+  // dependency scanning, where one preprocessor reads many files
+  bool directives_only;
+  uint32_t unit; // counts the files scanned
+  ptrmap_t initial; // name_t* -> macro_t*, the macros defined before the first
+  pp_file_vec_t deps; // included by the current unit, in order
+  pp_file_vec_t once_files; // made #pragma once by the current unit
+  macro_vec_t kept; // freed with the preprocessor
+
+  frame_vec_t frames;
+  cond_vec_t conds;
+  context_vec_t contexts;
+  token_t eof;
+  token_t zero, one; // results of `defined`
+
+  hideset_vec_t hidesets;
+  uint32_t *hideset_index; // open addressing table of ids
+  size_t hideset_capacity;
+  // the same few sets meet over and over as expansions are read
+  struct {
+    uint32_t a, b, result;
+  } union_cache[256];
+};
+
+static struct {
+  const name_t *define, *undef, *include, *if_, *ifdef, *ifndef, *elif,
+    *else_, *endif, *line, *error, *warning, *pragma, *once, *defined,
+    *va_args, *file, *line_macro;
+} NAMES;
+
+// Files that could not be opened are cached too, so that searching the
+// include path never asks twice
+static pp_file_t MISSING_FILE;
+
+static void free_macro(macro_t *macro) {
+  name_vec_free(&macro->params);
+  token_vec_free(&macro->body);
+  free(macro);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tokens
+////////////////////////////////////////////////////////////////////////////////
+
+// Keywords are ordinary identifiers to the preprocessor
+static bool is_name(const token_t *token) {
+  return token->tag == TOKEN_IDENT ||
+    (token->tag >= TOKEN_KEYWORD_AUTO && token->tag <= TOKEN_KEYWORD__IMAGINARY);
+}
+
+static const char* spelling(const token_t *token) {
+  return dcc_source_text(token->loc);
+}
+
+// Tokenize text made up by the preprocessor itself (pasted tokens, stringified
+// arguments and the like), taking ownership of it. Each piece is registered as
+// a file of its own so that its tokens are spelled like any other. Its errors
+// are those of the directive or operator that made it.
+static token_vec_t tokenize_scratch(const char *path, char *text, size_t size) {
+  return dcc_tokenize(dcc_source_add(path, text, size), 0);
+}
+
+// The single token spelled by `text`, or TOKEN_UNKNOWN if it is not one. The
+// same spellings come up again and again (think __FILE__), so each is only
+// tokenized once.
+static token_t scratch_token(pp_t *pp, char *text, size_t size) {
+  const name_t *key = dcc_intern(text, size);
+  token_t *cached = dcc_ptrmap_get(&pp->scratch, key);
+  if (cached) {
+    free(text);
+    return *cached;
+  }
+
+  token_vec_t tokens = tokenize_scratch("<scratch>", text, size);
+  cached = dcc_malloc(sizeof *cached);
+  *cached = tokens.data[0];
+  if (tokens.size != 2 || cached->len != size) {
+    cached->tag = TOKEN_UNKNOWN;
+  }
+  token_vec_free(&tokens);
+  dcc_ptrmap_put(&pp->scratch, key, cached);
+  return *cached;
+}
+
+static void error(pp_t *pp, const token_t *token, const char *format, ...) {
+  va_list vlist;
+  va_start(vlist, format);
+  dcc_vdiag(pp->diags, DIAG_ERROR, token->loc, token->len, format, vlist);
+  va_end(vlist);
+}
+
+static void warning(pp_t *pp, const token_t *token, const char *format, ...) {
+  va_list vlist;
+  va_start(vlist, format);
+  dcc_vdiag(pp->diags, DIAG_WARNING, token->loc, token->len, format, vlist);
+  va_end(vlist);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Hide-sets
+////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t hash_names(const name_ptr_t *names, uint32_t count) {
+  uint32_t hash = 2166136261u;
+  for (uint32_t i = 0; i < count; i++) {
+    hash = (hash ^ names[i]->hash) * 16777619u;
+  }
+  return hash;
+}
+
+static void index_hideset(pp_t *pp, uint32_t id) {
+  size_t mask = pp->hideset_capacity - 1;
+  size_t i = pp->hidesets.data[id].hash & mask;
+  while (pp->hideset_index[i]) {
+    i = (i + 1) & mask;
+  }
+  pp->hideset_index[i] = id;
+}
+
+static uint32_t intern_hideset(pp_t *pp, const name_ptr_t *names, uint32_t count) {
+  if (count == 0) {
+    return 0;
+  }
+
+  if (pp->hidesets.size * 2 >= pp->hideset_capacity) {
+    free(pp->hideset_index);
+    pp->hideset_capacity *= 2;
+    pp->hideset_index = dcc_calloc(pp->hideset_capacity, sizeof(uint32_t));
+    for (uint32_t id = 1; id < pp->hidesets.size; id++) {
+      index_hideset(pp, id);
+    }
+  }
+
+  uint32_t hash = hash_names(names, count);
+  size_t mask = pp->hideset_capacity - 1;
+  for (size_t i = hash & mask; pp->hideset_index[i]; i = (i + 1) & mask) {
+    hideset_t *set = &pp->hidesets.data[pp->hideset_index[i]];
+    if (set->hash == hash && set->count == count &&
+        memcmp(set->names, names, count * sizeof *names) == 0) {
+      return pp->hideset_index[i];
+    }
+  }
+
+  hideset_t set = { dcc_malloc(count * sizeof *names), count, hash };
+  memcpy(set.names, names, count * sizeof *names);
+  hideset_vec_push(&pp->hidesets, set);
+  index_hideset(pp, pp->hidesets.size - 1);
+  return pp->hidesets.size - 1;
+}
+
+static bool hideset_contains(pp_t *pp, uint32_t id, const name_t *name) {
+  hideset_t *set = &pp->hidesets.data[id];
+  for (uint32_t i = 0; i < set->count; i++) {
+    if (set->names[i] == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Merge two sets, keeping names found in both or (when `intersect` is false)
+// in either
+static uint32_t hideset_merge(pp_t *pp, uint32_t a, uint32_t b, bool intersect) {
+  hideset_t x = pp->hidesets.data[a], y = pp->hidesets.data[b];
+  name_ptr_t *names = dcc_malloc((x.count + y.count) * sizeof *names + 1);
+  uint32_t count = 0, i = 0, j = 0;
+
+  while (i < x.count || j < y.count) {
+    if (i < x.count && j < y.count && x.names[i] == y.names[j]) {
+      names[count++] = x.names[i];
+      i++, j++;
+    } else if (j == y.count || (i < x.count && (uintptr_t)x.names[i] < (uintptr_t)y.names[j])) {
+      if (!intersect) {
+        names[count++] = x.names[i];
+      }
+      i++;
+    } else {
+      if (!intersect) {
+        names[count++] = y.names[j];
+      }
+      j++;
+    }
+  }
+
+  uint32_t id = intern_hideset(pp, names, count);
+  free(names);
+  return id;
+}
+
+static uint32_t hideset_union(pp_t *pp, uint32_t a, uint32_t b) {
+  if (a == b || b == 0) {
+    return a;
+  } else if (a == 0) {
+    return b;
+  }
+
+  size_t slot = (a * 31 + b) & 255;
+  if (pp->union_cache[slot].a != a || pp->union_cache[slot].b != b) {
+    pp->union_cache[slot].a = a;
+    pp->union_cache[slot].b = b;
+    pp->union_cache[slot].result = hideset_merge(pp, a, b, false);
+  }
+  return pp->union_cache[slot].result;
+}
+
+static uint32_t hideset_intersect(pp_t *pp, uint32_t a, uint32_t b) {
+  if (a == b || a == 0 || b == 0) {
+    return a == b ? a : 0;
+  }
+  return hideset_merge(pp, a, b, true);
+}
+
+static uint32_t hideset_add(pp_t *pp, uint32_t id, const name_t *name) {
+  return hideset_union(pp, id, intern_hideset(pp, &name, 1));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Recorded inclusions
+////////////////////////////////////////////////////////////////////////////////
+
+// When scanning dependencies, file after file includes the same headers. What
+// an inclusion does depends only on the macros it looks up and the
+// #pragma once files it meets, so each is recorded along with what it changed
+// and replayed, without reading the file, wherever those are found as they
+// were. Nested inclusions are folded into the records of their includers.
+
+static macro_t NO_MACRO; // recorded for names which were not defined
+#define ONCE_CLEAR ((void*)1)
+#define ONCE_SET ((void*)2)
+
+// Records kept per file; past this, inclusions of it are no longer recorded
+#define MAX_INCLUDES 8
+
+static bool same_macro(const macro_t *a, const macro_t *b);
+
+static include_t* recording(pp_t *pp) {
+  return pp->frames.size ? frame_vec_last(&pp->frames)->record : 0;
+}
+
+static include_t* new_include(pp_t *pp) {
+  include_t *record = dcc_calloc(1, sizeof *record);
+  record->reads = dcc_ptrmap_new();
+  record->writes = dcc_ptrmap_new();
+  record->onces = dcc_ptrmap_new();
+  record->made_once = dcc_ptrmap_new();
+  record->deps = pp_file_vec_new();
+  record->diag_count = pp->diags->size;
+  return record;
+}
+
+static void free_include(include_t *record) {
+  dcc_ptrmap_free(&record->reads);
+  dcc_ptrmap_free(&record->writes);
+  dcc_ptrmap_free(&record->onces);
+  dcc_ptrmap_free(&record->made_once);
+  pp_file_vec_free(&record->deps);
+  free(record);
+}
+
+// Only the first look at a name counts, unless the inclusion defined it itself
+static void note_read(include_t *record, const name_t *name, macro_t *macro) {
+  if (!dcc_ptrmap_get(&record->writes, name) && !dcc_ptrmap_get(&record->reads, name)) {
+    dcc_ptrmap_put(&record->reads, name, macro);
+  }
+}
+
+static void note_once(include_t *record, pp_file_t *file, void *once) {
+  if (!dcc_ptrmap_get(&record->made_once, file) && !dcc_ptrmap_get(&record->onces, file)) {
+    dcc_ptrmap_put(&record->onces, file, once);
+  }
+}
+
+// Every lookup of a macro goes through here, so that it is recorded
+static macro_t* lookup_macro(pp_t *pp, const name_t *name) {
+  macro_t *macro = dcc_ptrmap_get(&pp->macros, name);
+  include_t *record = recording(pp);
+  if (record) {
+    note_read(record, name, macro ? macro : &NO_MACRO);
+  }
+  return macro;
+}
+
+// Likewise for (re)definitions, where `macro` is null for #undef
+static void note_write(pp_t *pp, const name_t *name, macro_t *macro) {
+  include_t *record = recording(pp);
+  if (record) {
+    dcc_ptrmap_put(&record->writes, name, macro ? macro : &NO_MACRO);
+  }
+}
+
+static bool is_once(pp_t *pp, pp_file_t *file) {
+  include_t *record = recording(pp);
+  if (record) {
+    note_once(record, file, file->once ? ONCE_SET : ONCE_CLEAR);
+  }
+  return file->once;
+}
+
+// Files are only #pragma once until the next unit is scanned
+static void mark_once(pp_t *pp, pp_file_t *file) {
+  if (!file->once) {
+    file->once = true;
+    pp_file_vec_push(&pp->once_files, file);
+  }
+}
+
+static void set_once(pp_t *pp, pp_file_t *file) {
+  include_t *record = recording(pp);
+  if (record) {
+    dcc_ptrmap_put(&record->made_once, file, file);
+  }
+  mark_once(pp, file);
+}
+
+static void add_dep(pp_t *pp, pp_file_t *file) {
+  if (file->unit != pp->unit) {
+    file->unit = pp->unit;
+    pp_file_vec_push(&pp->deps, file);
+  }
+  include_t *record = recording(pp);
+  if (record) {
+    pp_file_vec_push(&record->deps, file);
+  }
+}
+
+static void merge_include(include_t *into, const include_t *from) {
+  for (size_t i = 0; i < from->reads.capacity; i++) {
+    if (from->reads.entries[i].key) {
+      note_read(into, from->reads.entries[i].key, from->reads.entries[i].value);
+    }
+  }
+  for (size_t i = 0; i < from->writes.capacity; i++) {
+    if (from->writes.entries[i].key) {
+      dcc_ptrmap_put(&into->writes, from->writes.entries[i].key, from->writes.entries[i].value);
+    }
+  }
+  for (size_t i = 0; i < from->onces.capacity; i++) {
+    if (from->onces.entries[i].key) {
+      note_once(into, (pp_file_t*)from->onces.entries[i].key, from->onces.entries[i].value);
+    }
+  }
+  for (size_t i = 0; i < from->made_once.capacity; i++) {
+    if (from->made_once.entries[i].key) {
+      dcc_ptrmap_put(&into->made_once, from->made_once.entries[i].key,
+                     from->made_once.entries[i].value);
+    }
+  }
+  for (size_t i = 0; i < from->deps.size; i++) {
+    pp_file_vec_push(&into->deps, from->deps.data[i]);
+  }
+}
+
+// Whether everything `record` looked at is as it was
+static bool include_matches(pp_t *pp, const include_t *record) {
+  for (size_t i = 0; i < record->reads.capacity; i++) {
+    if (record->reads.entries[i].key) {
+      // macros defined afresh by each file scanned match by their definition
+      const macro_t *macro = dcc_ptrmap_get(&pp->macros, record->reads.entries[i].key);
+      const macro_t *seen = record->reads.entries[i].value;
+      if (macro ? seen == &NO_MACRO || (macro != seen && !same_macro(macro, seen))
+                : seen != &NO_MACRO) {
+        return false;
+      }
+    }
+  }
+  for (size_t i = 0; i < record->onces.capacity; i++) {
+    const pp_file_t *file = record->onces.entries[i].key;
+    if (file && (file->once ? ONCE_SET : ONCE_CLEAR) != record->onces.entries[i].value) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Include `file` by replaying a recording of it, if one applies
+static bool replay_include(pp_t *pp, pp_file_t *file) {
+  include_t *record = file->includes;
+  while (record && !include_matches(pp, record)) {
+    record = record->next;
+  }
+  if (!record) {
+    return false;
+  }
+
+  for (size_t i = 0; i < record->writes.capacity; i++) {
+    const name_t *name = record->writes.entries[i].key;
+    macro_t *macro = record->writes.entries[i].value;
+    if (!name) {
+      continue;
+    }
+    macro_t *old = macro == &NO_MACRO
+      ? dcc_ptrmap_remove(&pp->macros, name)
+      : dcc_ptrmap_put(&pp->macros, name, macro);
+    if (old && old != macro) {
+      macro_vec_push(&pp->undefined, old);
+    }
+  }
+  for (size_t i = 0; i < record->made_once.capacity; i++) {
+    pp_file_t *made_once = record->made_once.entries[i].value;
+    if (made_once) {
+      mark_once(pp, made_once);
+    }
+  }
+  for (size_t i = 0; i < record->deps.size; i++) {
+    pp_file_t *dep = record->deps.data[i];
+    if (dep->unit != pp->unit) {
+      dep->unit = pp->unit;
+      pp_file_vec_push(&pp->deps, dep);
+    }
+  }
+
+  include_t *includer = recording(pp);
+  if (includer) {
+    merge_include(includer, record);
+  }
+  return true;
+}
+
+static void keep_macro(pp_t *pp, macro_t *macro) {
+  if (macro != &NO_MACRO && !macro->kept) {
+    macro->kept = true;
+    macro_vec_push(&pp->kept, macro);
+  }
+}
+
+// Store the record of an inclusion which has just been left, unless something
+// went wrong during it
+static void finish_include(pp_t *pp, pp_file_t *file, include_t *record) {
+  include_t *includer = recording(pp);
+  if (includer) {
+    merge_include(includer, record);
+  }
+  size_t count = 0;
+  for (include_t *other = file->includes; other; other = other->next) {
+    count++;
+  }
+  if (pp->diags->size != record->diag_count || count == MAX_INCLUDES) {
+    free_include(record);
+    return;
+  }
+
+  for (size_t i = 0; i < record->reads.capacity; i++) {
+    if (record->reads.entries[i].key) {
+      keep_macro(pp, record->reads.entries[i].value);
+    }
+  }
+  for (size_t i = 0; i < record->writes.capacity; i++) {
+    if (record->writes.entries[i].key) {
+      keep_macro(pp, record->writes.entries[i].value);
+    }
+  }
+  record->next = file->includes;
+  file->includes = record;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Source files
+////////////////////////////////////////////////////////////////////////////////
+
+static char* read_file(const char *path, size_t *size) {
+  FILE *stream = fopen(path, "rb");
+  if (!stream) {
+    return 0;
+  }
+
+  struct stat info;
+  if (fstat(fileno(stream), &info) != 0 || !S_ISREG(info.st_mode)) {
+    fclose(stream);
+    return 0;
+  }
+
+  char *text = dcc_malloc(info.st_size + 1);
+  *size = fread(text, 1, info.st_size, stream);
+  text[*size] = 0;
+  fclose(stream);
+  return text;
+}
+
+static pp_file_t* new_file(pp_t *pp, const source_file_t *source, const name_t *path) {
+  pp_file_t *file = dcc_calloc(1, sizeof *file);
+  file->source = source;
+  file->path = path;
+  pp_file_vec_push(&pp->all_files, file);
+  return file;
+}
+
+// Look up the file at `path`, reading it if this is the first time. Every path
+// naming the same file leads to the same pp_file_t, so that guards and
+// #pragma once recognize it however it is included.
+static pp_file_t* find_file(pp_t *pp, const char *path) {
+  const name_t *key = dcc_intern(path, strlen(path));
+  pp_file_t *file = dcc_ptrmap_get(&pp->files, key);
+  if (file) {
+    return file == &MISSING_FILE ? 0 : file;
+  }
+
+  char *real = realpath(path, 0);
+  if (real) {
+    const name_t *real_key = dcc_intern(real, strlen(real));
+    file = dcc_ptrmap_get(&pp->real_files, real_key);
+    size_t size;
+    char *text = file ? 0 : read_file(path, &size);
+    if (text) {
+      file = new_file(pp, dcc_source_add(path, text, size), real_key);
+      dcc_ptrmap_put(&pp->real_files, real_key, file);
+    }
+  }
+  free(real);
+  dcc_ptrmap_put(&pp->files, key, file ? file : &MISSING_FILE);
+  return file;
+}
+
+static pp_file_t* find_file_in(pp_t *pp, const char *dir, size_t dir_len, const char *name) {
+  if (name[0] == '/') {
+    return find_file(pp, name);
+  }
+
+  char *path = dcc_malloc(dir_len + strlen(name) + 2);
+  if (dir_len) {
+    sprintf(path, "%.*s/%s", (int)dir_len, dir, name);
+  } else {
+    strcpy(path, name);
+  }
+  pp_file_t *file = find_file(pp, path);
+  free(path);
+  return file;
+}
+
+// stdspec.6.10.2 A quoted name is first looked for next to the including file
+static pp_file_t* find_include(pp_t *pp, const char *name, bool quoted) {
+  pp_file_t *file = 0;
+  bool system = false;
+  if (quoted) {
+    const pp_file_t *includer = frame_vec_last(&pp->frames)->file;
+    const char *path = includer->source->path;
+    const char *slash = strrchr(path, '/');
+    file = find_file_in(pp, path, slash ? slash - path : 0, name);
+    system = includer->system;
+  }
+  for (size_t i = 0; !file && i < pp->include_dirs.size; i++) {
+    const char *dir = pp->include_dirs.data[i];
+    file = find_file_in(pp, dir, strlen(dir), name);
+  }
+  for (size_t i = 0; !file && i < sizeof SYSTEM_INCLUDE_DIRS / sizeof(char*); i++) {
+    const char *dir = SYSTEM_INCLUDE_DIRS[i];
+    file = find_file_in(pp, dir, strlen(dir), name);
+    system = true;
+  }
+  if (file && system) {
+    file->system = true;
+  }
+  return file;
+}
+
+// Whether including `file` again would have no effect
+static bool skippable(pp_t *pp, pp_file_t *file) {
+  return is_once(pp, file) || (file->guard && lookup_macro(pp, file->guard));
+}
+
+// Returns false if the file cannot be read
+static bool enter_file(pp_t *pp, pp_file_t *file) {
+  // files known from a precompiled header are only read once they are needed
+  if (!file->source) {
+    size_t size;
+    char *text = read_file(file->path->str, &size);
+    if (!text) {
+      return false;
+    }
+    file->source = dcc_source_add(file->path->str, text, size);
+  }
+  if (!file->tokenized) {
+    file->tokens = pp->directives_only
+      ? dcc_tokenize_directives(file->source, pp->diags)
+      : dcc_tokenize(file->source, pp->diags);
+    file->tokenized = true;
+  }
+  frame_t frame = { file, 0, pp->conds.size, GUARD_START, 0, 0 };
+  frame_vec_push(&pp->frames, frame);
+  return true;
+}
+
+static void leave_file(pp_t *pp) {
+  frame_t frame = frame_vec_pop(&pp->frames);
+  while (pp->conds.size > frame.cond_depth) {
+    cond_t cond = cond_vec_pop(&pp->conds);
+    dcc_diag(pp->diags, DIAG_ERROR, cond.loc, 1, "unterminated conditional directive");
+  }
+
+  pp_file_t *file = frame.file;
+  if (frame.guard_state == GUARD_CLOSED) {
+    file->guard = frame.guard;
+  }
+  // a guarded file is unlikely to be entered again, so its tokens can go;
+  // when scanning, the next file may well enter it though
+  if ((file->guard || file->once) && !pp->directives_only) {
+    token_vec_free(&file->tokens);
+    file->tokens = token_vec_new();
+    file->tokenized = false;
+  }
+  if (frame.record) {
+    finish_include(pp, file, frame.record);
+  }
+}
+
+// Return the tokens of the directive whose `#` is at the current position,
+// moving past them
+static const token_t* directive_line(frame_t *frame, const token_t **end) {
+  const token_t *tokens = frame->file->tokens.data;
+  const token_t *begin = &tokens[frame->pos + 1], *p = begin;
+  while (p->tag != TOKEN_EOF && !(p->flags & TOKEN_FLAG_BOL)) {
+    p++;
+  }
+  frame->pos = p - tokens;
+  *end = p;
+  return begin;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Macro expansion
+////////////////////////////////////////////////////////////////////////////////
+
+static token_t file_next(pp_t *pp);
+
+static bool context_done(const context_t *context) {
+  return !context->has_token && context->p == context->end;
+}
+
+static void push_context(pp_t *pp, context_t context) {
+  context_vec_push(&pp->contexts, context);
+}
+
+// Push back a single token which has already been read
+static void unread_token(pp_t *pp, token_t token) {
+  context_t context = { 0, 0, 0, token.flags, token, true, 0 };
+  push_context(pp, context);
+}
+
+static void free_args(args_t *args) {
+  if (!args) {
+    return;
+  }
+  for (size_t i = 0; args->expanded && i + 1 < args->bounds.size; i++) {
+    token_vec_free(&args->expanded[i]);
+  }
+  free(args->expanded);
+  free(args->is_expanded);
+  free(args->made);
+  token_vec_free(&args->tokens);
+  uint32_vec_free(&args->bounds);
+  free(args);
+}
+
+static void pop_context(pp_t *pp) {
+  context_t context = context_vec_pop(&pp->contexts);
+  free_args(context.args);
+}
+
+// Whether only exhausted contexts lie above `floor`
+static bool contexts_done(pp_t *pp, size_t floor) {
+  for (size_t i = floor; i < pp->contexts.size; i++) {
+    if (!context_done(&pp->contexts.data[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Read the next unexpanded token. Expansions are rescanned together with the
+// rest of the input, except that arguments are expanded `isolated` from what
+// follows them; only the contexts above `floor` belong to them. This is where
+// tokens of an expansion are materialized.
+static token_t read_token(pp_t *pp, size_t floor, bool isolated) {
+  while (pp->contexts.size > floor) {
+    context_t *context = context_vec_last(&pp->contexts);
+    if (context_done(context)) {
+      pop_context(pp);
+      continue;
+    }
+
+    token_t token;
+    if (context->has_token) {
+      token = context->token;
+      context->has_token = false;
+    } else {
+      token = *context->p++;
+    }
+    if (context->first_flags >= 0) {
+      token.flags = context->first_flags;
+      context->first_flags = -1;
+    } else {
+      token.flags &= ~TOKEN_FLAG_BOL;
+    }
+    token.hideset = hideset_union(pp, token.hideset, context->hideset);
+    return token;
+  }
+  return isolated ? pp->eof : file_next(pp);
+}
+
+static bool at_directive(pp_t *pp, size_t floor, bool isolated) {
+  if (isolated || !contexts_done(pp, floor) || pp->frames.size == 0) {
+    return false;
+  }
+  const frame_t *frame = frame_vec_last(&pp->frames);
+  const token_t *token = &frame->file->tokens.data[frame->pos];
+  return token->tag == TOKEN_HASH && token->flags & TOKEN_FLAG_BOL;
+}
+
+static int param_index(const macro_t *macro, const token_t *token) {
+  if (macro->kind != MACRO_FUNCTION || !is_name(token)) {
+    return -1;
+  }
+  for (size_t i = 0; i < macro->params.size; i++) {
+    if (macro->params.data[i] == token->val.name) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static args_t* new_args(const macro_t *macro) {
+  args_t *args = dcc_calloc(1, sizeof *args);
+  args->tokens = token_vec_new();
+  args->bounds = uint32_vec_new();
+  // every # or ## makes at most one token
+  args->made = dcc_malloc((macro->body.size + 1) * sizeof(token_t));
+  uint32_vec_push(&args->bounds, 0);
+  return args;
+}
+
+// Read the arguments of a function-like macro invocation, up to and including
+// the closing parenthesis
+static args_t* collect_args(pp_t *pp, const macro_t *macro, const token_t *name,
+                            size_t floor, bool isolated, token_t *rparen) {
+  args_t *args = new_args(macro);
+  size_t params = macro->params.size;
+  int depth = 0;
+  while (true) {
+    token_t token = read_token(pp, floor, isolated);
+    if (token.tag == TOKEN_EOF) {
+      error(pp, name, "unterminated argument list invoking macro \"%s\"", macro->name->str);
+      free_args(args);
+      return 0;
+    } else if (depth == 0 && token.tag == TOKEN_RPAREN) {
+      *rparen = token;
+      uint32_vec_push(&args->bounds, args->tokens.size);
+      break;
+    } else if (depth == 0 && token.tag == TOKEN_COMMA &&
+               !(macro->variadic && args->bounds.size >= params)) {
+      uint32_vec_push(&args->bounds, args->tokens.size);
+      continue;
+    }
+    depth += token.tag == TOKEN_LPAREN;
+    depth -= token.tag == TOKEN_RPAREN;
+    token_vec_push(&args->tokens, token);
+  }
+
+  // `f()` passes one empty argument, which is all a macro without parameters
+  // takes; the variable arguments may be left out entirely
+  size_t count = args->bounds.size - 1;
+  if (count == 1 && params == 0 && args->tokens.size == 0) {
+    uint32_vec_pop(&args->bounds);
+    count = 0;
+  } else if (macro->variadic && count + 1 == params) {
+    uint32_vec_push(&args->bounds, args->tokens.size);
+    count++;
+  }
+
+  if (count != params) {
+    error(pp, name, "macro \"%s\" requires %zu arguments, but %zu given",
+          macro->name->str, params, count);
+    free_args(args);
+    return 0;
+  }
+  args->expanded = dcc_calloc(count + 1, sizeof(token_vec_t));
+  args->is_expanded = dcc_calloc(count + 1, sizeof(bool));
+  return args;
+}
+
+static void raw_arg(const args_t *args, int i, const token_t **begin, const token_t **end) {
+  *begin = args->tokens.data + args->bounds.data[i];
+  *end = args->tokens.data + args->bounds.data[i + 1];
+}
+
+static token_t expand_next(pp_t *pp, size_t floor, bool isolated);
+
+// An argument after macro expansion. Arguments which mention no macro, the
+// usual case, are used as they are.
+static void expanded_arg(pp_t *pp, args_t *args, int i, const token_t **begin,
+                         const token_t **end) {
+  raw_arg(args, i, begin, end);
+  if (!args->is_expanded[i]) {
+    args->is_expanded[i] = true;
+    for (const token_t *p = *begin; p < *end; p++) {
+      if (is_name(p) && lookup_macro(pp, p->val.name)) {
+        size_t floor = pp->contexts.size;
+        context_t context = { *begin, *end, 0, -1, { 0 }, false, 0 };
+        push_context(pp, context);
+
+        token_vec_t expanded = token_vec_new();
+        for (token_t token; (token = expand_next(pp, floor, true)).tag != TOKEN_EOF;) {
+          token_vec_push(&expanded, token);
+        }
+        args->expanded[i] = expanded;
+        // a non-null `data` marks the argument as expanded, even if empty
+        if (!expanded.data) {
+          args->expanded[i].data = dcc_malloc(sizeof(token_t));
+        }
+        break;
+      }
+    }
+  }
+
+  if (args->expanded[i].data) {
+    *begin = args->expanded[i].data;
+    *end = *begin + args->expanded[i].size;
+  }
+}
+
+// stdspec.6.10.3.2 The # operator
+static token_t stringify(pp_t *pp, const token_t *begin, const token_t *end,
+                         const token_t *hash) {
+  size_t capacity = 3;
+  for (const token_t *p = begin; p < end; p++) {
+    capacity += p->len * 2 + 1;
+  }
+
+  char *text = dcc_malloc(capacity);
+  size_t size = 0;
+  text[size++] = '"';
+  for (const token_t *p = begin; p < end; p++) {
+    if (p != begin && p->flags & TOKEN_FLAG_SPACE) {
+      text[size++] = ' ';
+    }
+    // quotes and backslashes in literals are escaped
+    bool literal = p->tag == TOKEN_STRING || p->tag == TOKEN_CHARACTER;
+    const char *s = spelling(p);
+    for (uint32_t i = 0; i < p->len; i++) {
+      if (literal && (s[i] == '"' || s[i] == '\\')) {
+        text[size++] = '\\';
+      }
+      text[size++] = s[i];
+    }
+  }
+  text[size++] = '"';
+  text[size] = 0;
+
+  token_t token = scratch_token(pp, text, size);
+  if (token.tag != TOKEN_STRING) {
+    error(pp, hash, "'#' does not produce a valid string literal");
+  }
+  token.flags = hash->flags;
+  return token;
+}
+
+// stdspec.6.10.3.3 The ## operator. Replaces *lhs with the token made by
+// pasting it to rhs, or returns false if they do not form one token.
+static bool paste(pp_t *pp, token_t *lhs, const token_t *rhs) {
+  size_t size = lhs->len + rhs->len;
+  char *text = dcc_malloc(size + 1);
+  memcpy(text, spelling(lhs), lhs->len);
+  memcpy(text + lhs->len, spelling(rhs), rhs->len);
+  text[size] = 0;
+
+  token_t token = scratch_token(pp, text, size);
+  if (token.tag == TOKEN_UNKNOWN) {
+    error(pp, lhs, "pasting \"%.*s\" and \"%.*s\" does not give a valid preprocessing token",
+          (int)lhs->len, spelling(lhs), (int)rhs->len, spelling(rhs));
+    return false;
+  }
+  token.flags = lhs->flags;
+  token.hideset = lhs->hideset;
+  *lhs = token;
+  return true;
+}
+
+// Append a slice to the expansion being built, merging it with the previous
+// one where they are adjacent. A non-negative `first_flags` replaces the
+// spacing of its first token.
+static void emit(context_vec_t *out, const token_t *begin, const token_t *end,
+                 int first_flags) {
+  if (begin == end) {
+    return;
+  }
+  context_t *last = context_vec_last(out);
+  if (last && last->end == begin && first_flags < 0) {
+    last->end = end;
+    return;
+  }
+  context_t context = { begin, end, 0, first_flags, { 0 }, false, 0 };
+  context_vec_push(out, context);
+}
+
+static void emit_made(args_t *args, context_vec_t *out, token_t token) {
+  token_t *made = &args->made[args->made_count++];
+  *made = token;
+  emit(out, made, made + 1, -1);
+}
+
+static void drop_last(context_vec_t *out) {
+  context_t *last = context_vec_last(out);
+  if (last && --last->end == last->p) {
+    context_vec_pop(out);
+  }
+}
+
+// Paste the last token of the expansion so far to rhs
+static bool paste_last(pp_t *pp, args_t *args, context_vec_t *out, const token_t *rhs) {
+  context_t *last = context_vec_last(out);
+  token_t lhs = last->end[-1];
+  if (last->end - 1 == last->p && last->first_flags >= 0) {
+    lhs.flags = last->first_flags;
+  }
+  if (!paste(pp, &lhs, rhs)) {
+    return false;
+  }
+  drop_last(out);
+  emit_made(args, out, lhs);
+  return true;
+}
+
+// Substitute arguments into the body of `macro`, evaluating # and ##. The
+// result is a list of slices of the body, of the arguments and of the few
+// tokens made by # and ##.
+static void subst(pp_t *pp, const macro_t *macro, args_t *args, context_vec_t *out) {
+  const token_t *body = macro->body.data;
+  size_t size = macro->body.size;
+  bool placemarker = false; // the last operand of ## was an empty argument
+
+  for (size_t i = 0; i < size; i++) {
+    const token_t *token = &body[i];
+    int param = param_index(macro, token);
+    const token_t *arg, *arg_end;
+
+    if (token->tag == TOKEN_HASH && macro->kind == MACRO_FUNCTION) {
+      // checked by #define to be followed by a parameter
+      raw_arg(args, param_index(macro, &body[++i]), &arg, &arg_end);
+      emit_made(args, out, stringify(pp, arg, arg_end, token));
+      placemarker = false;
+    } else if (token->tag == TOKEN_HASHHASH) {
+      // the operands of ## are not macro-expanded
+      const token_t *rhs = &body[++i];
+      param = param_index(macro, rhs);
+      arg = rhs;
+      arg_end = rhs + 1;
+      if (param >= 0) {
+        raw_arg(args, param, &arg, &arg_end);
+      }
+      bool empty = arg == arg_end;
+
+      // as an extension, `, ## __VA_ARGS__` drops the comma when there are
+      // no variable arguments instead of pasting
+      bool comma = !placemarker && out->size && context_vec_last(out)->end[-1].tag == TOKEN_COMMA &&
+        macro->variadic && param == macro->params.size - 1;
+      if (comma && empty) {
+        drop_last(out);
+      } else if (placemarker || comma || !out->size) {
+        emit(out, arg, arg_end, -1);
+      } else if (!empty) {
+        if (paste_last(pp, args, out, arg)) {
+          arg++;
+        }
+        emit(out, arg, arg_end, -1);
+      }
+      placemarker = placemarker && empty;
+    } else if (param >= 0) {
+      if (i + 1 < size && body[i + 1].tag == TOKEN_HASHHASH) {
+        raw_arg(args, param, &arg, &arg_end);
+        placemarker = arg == arg_end;
+      } else {
+        expanded_arg(pp, args, param, &arg, &arg_end);
+        placemarker = false;
+      }
+      // the argument takes the place (and spacing) of the parameter
+      emit(out, arg, arg_end, token->flags);
+    } else {
+      emit(out, token, token + 1, -1);
+      placemarker = false;
+    }
+  }
+}
+
+// stdspec.6.10.8 __FILE__ and __LINE__ refer to the position in the file being
+// read, even when they appear in the body of another macro
+static token_t expand_builtin(pp_t *pp, const macro_t *macro, const token_t *name) {
+  const frame_t *frame = frame_vec_last(&pp->frames);
+  srcloc_t loc = frame->pos ? frame->file->tokens.data[frame->pos - 1].loc : name->loc;
+  srcpos_t pos = dcc_source_pos(loc);
+
+  char *text;
+  size_t size = 0;
+  if (macro->kind == MACRO_LINE) {
+    text = dcc_malloc(16);
+    size = sprintf(text, "%u", pos.line);
+  } else {
+    const char *path = frame->file->source->path;
+    text = dcc_malloc(strlen(path) * 2 + 3);
+    text[size++] = '"';
+    for (const char *p = path; *p; p++) {
+      if (*p == '"' || *p == '\\') {
+        text[size++] = '\\';
+      }
+      text[size++] = *p;
+    }
+    text[size++] = '"';
+    text[size] = 0;
+  }
+
+  token_t token = scratch_token(pp, text, size);
+  token.flags = name->flags;
+  return token;
+}
+
+// Replace the invocation of `macro` that starts with `name` by its expansion,
+// which is pushed as contexts to be rescanned. Returns false if a function-like
+// macro turns out not to be invoked.
+static bool expand(pp_t *pp, const macro_t *macro, const token_t *name,
+                   size_t floor, bool isolated) {
+  uint32_t hideset = name->hideset;
+
+  if (macro->kind == MACRO_FILE || macro->kind == MACRO_LINE) {
+    token_t token = expand_builtin(pp, macro, name);
+    token.hideset = hideset_add(pp, hideset, macro->name);
+    unread_token(pp, token);
+    return true;
+  } else if (macro->kind == MACRO_OBJECT && !macro->has_ops) {
+    // the common case refers to the body as it is
+    context_t context = {
+      macro->body.data, macro->body.data + macro->body.size,
+      hideset_add(pp, hideset, macro->name), name->flags, { 0 }, false, 0,
+    };
+    push_context(pp, context);
+    return true;
+  }
+
+  args_t *args;
+  if (macro->kind == MACRO_FUNCTION) {
+    // a directive cannot come between the name and its arguments
+    if (at_directive(pp, floor, isolated)) {
+      return false;
+    }
+    token_t paren = read_token(pp, floor, isolated);
+    if (paren.tag != TOKEN_LPAREN) {
+      if (paren.tag != TOKEN_EOF) {
+        unread_token(pp, paren);
+      }
+      return false;
+    }
+
+    token_t rparen;
+    if (!(args = collect_args(pp, macro, name, floor, isolated, &rparen))) {
+      return true;
+    }
+    hideset = hideset_intersect(pp, name->hideset, rparen.hideset);
+  } else {
+    args = new_args(macro);
+  }
+
+  context_vec_t out = context_vec_new();
+  subst(pp, macro, args, &out);
+
+  // the expansion takes the place of the invocation, spacing included; the
+  // arguments live as long as the context read last
+  hideset = hideset_add(pp, hideset, macro->name);
+  for (size_t i = out.size; i-- > 0;) {
+    context_t context = out.data[i];
+    context.hideset = hideset;
+    context.first_flags = i == 0 ? name->flags : context.first_flags;
+    context.args = i + 1 == out.size ? args : 0;
+    push_context(pp, context);
+  }
+  if (out.size == 0) {
+    free_args(args);
+  }
+  context_vec_free(&out);
+  return true;
+}
+
+static token_t expand_next(pp_t *pp, size_t floor, bool isolated) {
+  while (true) {
+    token_t token = read_token(pp, floor, isolated);
+    macro_t *macro;
+    if (!is_name(&token) ||
+        !(macro = lookup_macro(pp, token.val.name)) ||
+        hideset_contains(pp, token.hideset, macro->name) ||
+        !expand(pp, macro, &token, floor, isolated)) {
+      return token;
+    }
+  }
+}
+
+// Fully expand the tokens of a directive line
+static token_vec_t expand_line(pp_t *pp, const token_t *begin, const token_t *end) {
+  size_t floor = pp->contexts.size;
+  context_t context = { begin, end, 0, -1, { 0 }, false, 0 };
+  push_context(pp, context);
+
+  token_vec_t tokens = token_vec_new();
+  for (token_t token; (token = expand_next(pp, floor, true)).tag != TOKEN_EOF;) {
+    token_vec_push(&tokens, token);
+  }
+  return tokens;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// stdspec.6.10.1 Conditional inclusion
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  uint64_t bits;
+  bool is_unsigned;
+} pp_value_t;
+
+typedef struct {
+  pp_t *pp;
+  const token_t *directive;
+  const token_t *p, *end;
+  int unevaluated; // inside the skipped operand of &&, || or ?:
+  bool failed;
+} eval_t;
+
+static pp_value_t eval_cond(eval_t *eval);
+
+static void eval_error(eval_t *eval, const char *message) {
+  if (!eval->failed) {
+    error(eval->pp, eval->directive, "%s in #%s expression", message,
+          eval->directive->val.name->str);
+  }
+  eval->failed = true;
+}
+
+static pp_value_t eval_primary(eval_t *eval) {
+  pp_value_t value = { 0, false };
+  if (eval->p == eval->end) {
+    eval_error(eval, "expected value");
+    return value;
+  }
+
+  const token_t *token = eval->p++;
+  switch (token->tag) {
+  case TOKEN_INTEGER: {
+    value.bits = token->val.integer;
+    value.is_unsigned = value.bits > INT64_MAX;
+    for (const char *s = spelling(token) + token->len - 1; strchr("uUlL", *s); s--) {
+      value.is_unsigned |= *s == 'u' || *s == 'U';
+    }
+    break;
+  }
+  case TOKEN_CHARACTER:
+    value.bits = token->val.integer;
+    break;
+  case TOKEN_LPAREN:
+    value = eval_cond(eval);
+    if (eval->p == eval->end || eval->p->tag != TOKEN_RPAREN) {
+      eval_error(eval, "expected ')'");
+    } else {
+      eval->p++;
+    }
+    break;
+  case TOKEN_PLUS:
+    value = eval_primary(eval);
+    break;
+  case TOKEN_MINUS:
+    value = eval_primary(eval);
+    value.bits = -value.bits;
+    break;
+  case TOKEN_SQUIGGLE:
+    value = eval_primary(eval);
+    value.bits = ~value.bits;
+    break;
+  case TOKEN_EXCLAIM:
+    value = eval_primary(eval);
+    value.bits = !value.bits;
+    value.is_unsigned = false;
+    break;
+  default:
+    // identifiers left after expansion evaluate to 0
+    if (!is_name(token)) {
+      eval_error(eval, "invalid token");
+    }
+    break;
+  }
+  return value;
+}
+
+static int binary_precedence(token_tag_t tag) {
+  switch (tag) {
+  case TOKEN_STAR: case TOKEN_FORWARD: case TOKEN_PERCENT:
+    return 10;
+  case TOKEN_PLUS: case TOKEN_MINUS:
+    return 9;
+  case TOKEN_LEFT: case TOKEN_RIGHT:
+    return 8;
+  case TOKEN_LESS: case TOKEN_MORE: case TOKEN_LESSEQ: case TOKEN_MOREEQ:
+    return 7;
+  case TOKEN_EQEQ: case TOKEN_NOTEQ:
+    return 6;
+  case TOKEN_AMP:
+    return 5;
+  case TOKEN_CARET:
+    return 4;
+  case TOKEN_PIPE:
+    return 3;
+  case TOKEN_AMPAMP:
+    return 2;
+  case TOKEN_PIPEPIPE:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+static pp_value_t eval_apply(eval_t *eval, token_tag_t op, pp_value_t a, pp_value_t b) {
+  // the usual arithmetic conversions, with everything as wide as intmax_t
+  bool is_unsigned = a.is_unsigned || b.is_unsigned;
+  int64_t x = a.bits, y = b.bits;
+  pp_value_t result = { 0, is_unsigned };
+
+  switch (op) {
+  case TOKEN_STAR: result.bits = a.bits * b.bits; break;
+  case TOKEN_PLUS: result.bits = a.bits + b.bits; break;
+  case TOKEN_MINUS: result.bits = a.bits - b.bits; break;
+  case TOKEN_FORWARD:
+  case TOKEN_PERCENT:
+    if (b.bits == 0) {
+      if (!eval->unevaluated) {
+        eval_error(eval, "division by zero");
+      }
+    } else if (is_unsigned) {
+      result.bits = op == TOKEN_FORWARD ? a.bits / b.bits : a.bits % b.bits;
+    } else if (y == -1) {
+      result.bits = op == TOKEN_FORWARD ? -a.bits : 0;
+    } else {
+      result.bits = op == TOKEN_FORWARD ? x / y : x % y;
+    }
+    break;
+  case TOKEN_LEFT:
+  case TOKEN_RIGHT:
+    result.is_unsigned = a.is_unsigned;
+    if (b.bits >= 64) {
+      result.bits = op == TOKEN_RIGHT && !a.is_unsigned && x < 0 ? -1 : 0;
+    } else if (op == TOKEN_LEFT) {
+      result.bits = a.bits << b.bits;
+    } else {
+      result.bits = a.is_unsigned ? a.bits >> b.bits : (uint64_t)(x >> b.bits);
+    }
+    break;
+  case TOKEN_LESS: result.bits = is_unsigned ? a.bits < b.bits : x < y; break;
+  case TOKEN_MORE: result.bits = is_unsigned ? a.bits > b.bits : x > y; break;
+  case TOKEN_LESSEQ: result.bits = is_unsigned ? a.bits <= b.bits : x <= y; break;
+  case TOKEN_MOREEQ: result.bits = is_unsigned ? a.bits >= b.bits : x >= y; break;
+  case TOKEN_EQEQ: result.bits = a.bits == b.bits; break;
+  case TOKEN_NOTEQ: result.bits = a.bits != b.bits; break;
+  case TOKEN_AMP: result.bits = a.bits & b.bits; break;
+  case TOKEN_CARET: result.bits = a.bits ^ b.bits; break;
+  case TOKEN_PIPE: result.bits = a.bits | b.bits; break;
+  case TOKEN_AMPAMP: result.bits = a.bits && b.bits; break;
+  case TOKEN_PIPEPIPE: result.bits = a.bits || b.bits; break;
+  default:
+    dcc_ice("unexpected operator %s in #if\n", dcc_token_tag_str(op));
+  }
+
+  switch (op) {
+  case TOKEN_LESS: case TOKEN_MORE: case TOKEN_LESSEQ: case TOKEN_MOREEQ:
+  case TOKEN_EQEQ: case TOKEN_NOTEQ: case TOKEN_AMPAMP: case TOKEN_PIPEPIPE:
+    result.is_unsigned = false;
+    break;
+  default:
+    break;
+  }
+  return result;
+}
+
+// Operator precedence parsing of the binary operators binding at least as
+// tightly as `precedence`
+static pp_value_t eval_binary(eval_t *eval, int precedence) {
+  pp_value_t lhs = eval_primary(eval);
+  while (eval->p < eval->end) {
+    token_tag_t op = eval->p->tag;
+    int op_precedence = binary_precedence(op);
+    if (op_precedence < precedence || op_precedence == 0) {
+      break;
+    }
+    eval->p++;
+
+    // the right operand of a short-circuiting operator may not be evaluated
+    bool skip = (op == TOKEN_AMPAMP && !lhs.bits) || (op == TOKEN_PIPEPIPE && lhs.bits);
+    eval->unevaluated += skip;
+    pp_value_t rhs = eval_binary(eval, op_precedence + 1);
+    eval->unevaluated -= skip;
+    lhs = eval_apply(eval, op, lhs, rhs);
+  }
+  return lhs;
+}
+
+static pp_value_t eval_cond(eval_t *eval) {
+  pp_value_t cond = eval_binary(eval, 1);
+  if (eval->p == eval->end || eval->p->tag != TOKEN_QUEST) {
+    return cond;
+  }
+  eval->p++;
+
+  eval->unevaluated += !cond.bits;
+  pp_value_t then = eval_cond(eval);
+  eval->unevaluated -= !cond.bits;
+
+  if (eval->p == eval->end || eval->p->tag != TOKEN_COLON) {
+    eval_error(eval, "expected ':'");
+    return then;
+  }
+  eval->p++;
+
+  eval->unevaluated += !!cond.bits;
+  pp_value_t otherwise = eval_cond(eval);
+  eval->unevaluated -= !!cond.bits;
+
+  pp_value_t result = cond.bits ? then : otherwise;
+  result.is_unsigned = then.is_unsigned || otherwise.is_unsigned;
+  return result;
+}
+
+// Evaluate the controlling expression of #if or #elif
+static bool eval_if(pp_t *pp, const token_t *directive, const token_t *begin,
+                    const token_t *end) {
+  // `defined` is evaluated before anything is expanded
+  token_vec_t line = token_vec_new();
+  for (const token_t *p = begin; p < end; p++) {
+    if (!is_name(p) || p->val.name != NAMES.defined) {
+      token_vec_push(&line, *p);
+      continue;
+    }
+
+    const token_t *operand = p + 1;
+    bool paren = operand < end && operand->tag == TOKEN_LPAREN;
+    operand += paren;
+    if (operand >= end || !is_name(operand) ||
+        (paren && (operand + 1 >= end || operand[1].tag != TOKEN_RPAREN))) {
+      error(pp, p, "operator \"defined\" requires an identifier");
+      token_vec_free(&line);
+      return false;
+    }
+
+    token_t value = lookup_macro(pp, operand->val.name) ? pp->one : pp->zero;
+    value.flags = p->flags;
+    token_vec_push(&line, value);
+    p = operand + paren;
+  }
+
+  token_vec_t tokens = expand_line(pp, line.data, line.data + line.size);
+  token_vec_free(&line);
+
+  eval_t eval = { pp, directive, tokens.data, tokens.data + tokens.size, 0, false };
+  pp_value_t value = eval_cond(&eval);
+  if (eval.p != eval.end) {
+    eval_error(&eval, "unexpected token");
+  }
+  token_vec_free(&tokens);
+  return !eval.failed && value.bits;
+}
+
+// Move on to the next group of the innermost conditional, returning it (or
+// null if there is none in this file)
+static cond_t* next_group(pp_t *pp, const token_t *directive, bool is_else) {
+  frame_t *frame = frame_vec_last(&pp->frames);
+  if (pp->conds.size == frame->cond_depth) {
+    error(pp, directive, "#%s without #if", directive->val.name->str);
+    return 0;
+  }
+
+  cond_t *cond = cond_vec_last(&pp->conds);
+  if (cond->seen_else) {
+    error(pp, directive, "#%s after #else", directive->val.name->str);
+  }
+  cond->seen_else |= is_else;
+
+  // a guard cannot have an alternative
+  if (frame->guard_state == GUARD_OPEN && pp->conds.size == frame->cond_depth + 1) {
+    frame->guard_state = GUARD_NONE;
+  }
+  return cond;
+}
+
+static void end_cond(pp_t *pp, const token_t *directive) {
+  frame_t *frame = frame_vec_last(&pp->frames);
+  if (pp->conds.size == frame->cond_depth) {
+    error(pp, directive, "#endif without #if");
+    return;
+  }
+
+  cond_vec_pop(&pp->conds);
+  if (frame->guard_state == GUARD_OPEN && pp->conds.size == frame->cond_depth) {
+    frame->guard_state = GUARD_CLOSED;
+  }
+}
+
+// Skip a group whose condition failed, up to the #elif or #else that starts a
+// group to include or the #endif which closes the conditional. Only the
+// directives are looked at.
+static void skip_group(pp_t *pp) {
+  frame_t *frame = frame_vec_last(&pp->frames);
+  const token_t *tokens = frame->file->tokens.data;
+  size_t depth = 0;
+
+  while (tokens[frame->pos].tag != TOKEN_EOF) {
+    const token_t *token = &tokens[frame->pos];
+    if (token->tag != TOKEN_HASH || !(token->flags & TOKEN_FLAG_BOL)) {
+      frame->pos++;
+      continue;
+    }
+
+    const token_t *end, *begin = directive_line(frame, &end);
+    if (begin == end || !is_name(begin)) {
+      continue;
+    }
+
+    const name_t *name = begin->val.name;
+    if (name == NAMES.if_ || name == NAMES.ifdef || name == NAMES.ifndef) {
+      depth++;
+    } else if (name == NAMES.endif) {
+      if (depth == 0) {
+        end_cond(pp, begin);
+        return;
+      }
+      depth--;
+    } else if (depth == 0 && (name == NAMES.elif || name == NAMES.else_)) {
+      bool is_else = name == NAMES.else_;
+      cond_t *cond = next_group(pp, begin, is_else);
+      if (cond && !cond->taken && (is_else || eval_if(pp, begin, begin + 1, end))) {
+        cond->taken = true;
+        return;
+      }
+    }
+  }
+  // leave_file reports the unterminated conditional
+}
+
+static void push_cond(pp_t *pp, const token_t *directive, bool taken) {
+  cond_t cond = { directive->loc, taken, false };
+  cond_vec_push(&pp->conds, cond);
+  if (!taken) {
+    skip_group(pp);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Directives
+////////////////////////////////////////////////////////////////////////////////
+
+static void extra_tokens(pp_t *pp, const token_t *directive, const token_t *p,
+                         const token_t *end) {
+  if (p < end) {
+    warning(pp, p, "extra tokens at end of #%s directive", directive->val.name->str);
+  }
+}
+
+// The name operand of #ifdef, #ifndef and #undef
+static const name_t* directive_name(pp_t *pp, const token_t *directive,
+                                    const token_t *p, const token_t *end) {
+  if (p == end || !is_name(p)) {
+    error(pp, p == end ? directive : p, "macro name must be an identifier");
+    return 0;
+  }
+  extra_tokens(pp, directive, p + 1, end);
+  return p->val.name;
+}
+
+static bool same_macro(const macro_t *a, const macro_t *b) {
+  if (a->kind != b->kind || a->variadic != b->variadic ||
+      a->params.size != b->params.size || a->body.size != b->body.size) {
+    return false;
+  }
+  for (size_t i = 0; i < a->params.size; i++) {
+    if (a->params.data[i] != b->params.data[i]) {
+      return false;
+    }
+  }
+  // stdspec.6.10.3p1 whitespace separation matters, but not its amount
+  for (size_t i = 0; i < a->body.size; i++) {
+    const token_t *x = &a->body.data[i], *y = &b->body.data[i];
+    if (x->tag != y->tag || x->len != y->len ||
+        memcmp(spelling(x), spelling(y), x->len) != 0 ||
+        (i > 0 && (x->flags & TOKEN_FLAG_SPACE) != (y->flags & TOKEN_FLAG_SPACE))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void define_macro(pp_t *pp, macro_t *macro) {
+  note_write(pp, macro->name, macro);
+  macro_t *old = dcc_ptrmap_put(&pp->macros, macro->name, macro);
+  if (old) {
+    if (!same_macro(old, macro)) {
+      dcc_diag(pp->diags, DIAG_WARNING, macro->loc, macro->name->len,
+               "\"%s\" redefined", macro->name->str);
+    }
+    // an invocation of the old definition may still be under way
+    macro_vec_push(&pp->undefined, old);
+  }
+}
+
+// stdspec.6.10.3 #define
+static void do_define(pp_t *pp, const token_t *directive, const token_t *p,
+                      const token_t *end) {
+  if (p == end || !is_name(p)) {
+    error(pp, p == end ? directive : p, "macro name must be an identifier");
+    return;
+  } else if (p->val.name == NAMES.defined) {
+    error(pp, p, "\"defined\" cannot be used as a macro name");
+    return;
+  }
+
+  macro_t *macro = dcc_malloc(sizeof *macro);
+  macro->kind = MACRO_OBJECT;
+  macro->name = p->val.name;
+  macro->loc = p->loc;
+  macro->variadic = false;
+  macro->has_ops = false;
+  macro->kept = false;
+  macro->params = name_vec_new();
+  macro->body = token_vec_new();
+  p++;
+
+  // the parenthesis of a function-like macro immediately follows its name
+  if (p < end && p->tag == TOKEN_LPAREN && !(p->flags & TOKEN_FLAG_SPACE)) {
+    macro->kind = MACRO_FUNCTION;
+    bool closed = false;
+    for (p++; p < end && !closed; p++) {
+      if (p->tag == TOKEN_RPAREN && macro->params.size == 0) {
+        closed = true;
+      } else if (p->tag == TOKEN_ELLIPSE) {
+        macro->variadic = true;
+        name_vec_push(&macro->params, NAMES.va_args);
+        closed = p + 1 < end && p[1].tag == TOKEN_RPAREN;
+        p += 2;
+        break;
+      } else if (is_name(p) && p + 1 < end &&
+                 (p[1].tag == TOKEN_COMMA || p[1].tag == TOKEN_RPAREN)) {
+        name_vec_push(&macro->params, p->val.name);
+        closed = p[1].tag == TOKEN_RPAREN;
+        p++;
+      } else {
+        break;
+      }
+    }
+    if (!closed) {
+      error(pp, p < end ? p : directive,
+            "expected parameter name, ',' or ')' in macro parameter list");
+      free_macro(macro);
+      return;
+    }
+  }
+
+  for (const token_t *q = p; q < end; q++) {
+    token_t token = *q;
+    if (q == p) {
+      token.flags = 0;
+    }
+    token_vec_push(&macro->body, token);
+
+    macro->has_ops |= q->tag == TOKEN_HASHHASH ||
+      (q->tag == TOKEN_HASH && macro->kind == MACRO_FUNCTION);
+    if (q->tag == TOKEN_HASH && macro->kind == MACRO_FUNCTION &&
+        (q + 1 == end || param_index(macro, q + 1) < 0)) {
+      error(pp, q, "'#' is not followed by a macro parameter");
+      free_macro(macro);
+      return;
+    } else if (q->tag == TOKEN_HASHHASH && (q == p || q + 1 == end)) {
+      error(pp, q, "'##' cannot appear at either end of a macro expansion");
+      free_macro(macro);
+      return;
+    }
+  }
+
+  define_macro(pp, macro);
+}
+
+static void do_undef(pp_t *pp, const token_t *directive, const token_t *p,
+                     const token_t *end) {
+  const name_t *name = directive_name(pp, directive, p, end);
+  macro_t *macro = name ? dcc_ptrmap_remove(&pp->macros, name) : 0;
+  if (name) {
+    note_write(pp, name, 0);
+  }
+  if (macro) {
+    macro_vec_push(&pp->undefined, macro);
+  }
+}
+
+// Concatenate the spellings of tokens, separated as they were
+static char* spell_tokens(const token_t *begin, const token_t *end) {
+  size_t size = 0;
+  for (const token_t *p = begin; p < end; p++) {
+    size += p->len + 1;
+  }
+
+  char *text = dcc_malloc(size + 1);
+  size = 0;
+  for (const token_t *p = begin; p < end; p++) {
+    if (p != begin && p->flags & TOKEN_FLAG_SPACE) {
+      text[size++] = ' ';
+    }
+    memcpy(text + size, spelling(p), p->len);
+    size += p->len;
+  }
+  text[size] = 0;
+  return text;
+}
+
+// The file named by #include, or null if it is malformed
+static char* include_name(pp_t *pp, const token_t *directive, const token_t *p,
+                          const token_t *end, bool expanded, bool *quoted) {
+  if (p < end && p->tag == TOKEN_STRING) {
+    extra_tokens(pp, directive, p + 1, end);
+    *quoted = true;
+    char *name = dcc_malloc(p->len - 1);
+    memcpy(name, spelling(p) + 1, p->len - 2);
+    name[p->len - 2] = 0;
+    return name;
+  } else if (p < end && p->tag == TOKEN_LESS) {
+    const token_t *close = p + 1;
+    while (close < end && close->tag != TOKEN_MORE) {
+      close++;
+    }
+    if (close == end) {
+      return 0;
+    }
+    extra_tokens(pp, directive, close + 1, end);
+    *quoted = false;
+
+    // <...> is not a token, but written out directly its text is the name
+    if (expanded) {
+      return spell_tokens(p + 1, close);
+    }
+    const char *begin = spelling(p) + 1;
+    size_t len = spelling(close) - begin;
+    char *name = dcc_malloc(len + 1);
+    memcpy(name, begin, len);
+    name[len] = 0;
+    return name;
+  } else if (!expanded) {
+    // stdspec.6.10.2p4 otherwise the line is macro-expanded first
+    token_vec_t tokens = expand_line(pp, p, end);
+    char *name = include_name(pp, directive, tokens.data, tokens.data + tokens.size,
+                              true, quoted);
+    token_vec_free(&tokens);
+    return name;
+  }
+  return 0;
+}
+
+// stdspec.6.10.2 #include
+static void do_include(pp_t *pp, const token_t *directive, const token_t *p,
+                       const token_t *end) {
+  bool quoted;
+  char *name = include_name(pp, directive, p, end, false, &quoted);
+  if (!name || !*name) {
+    error(pp, directive, "#include expects \"FILENAME\" or <FILENAME>");
+  } else if (pp->frames.size >= MAX_INCLUDE_DEPTH) {
+    error(pp, directive, "#include nested too deeply");
+  } else {
+    pp_file_t *file = find_include(pp, name, quoted);
+    if (file) {
+      add_dep(pp, file);
+    }
+    if (file && (skippable(pp, file) || (pp->directives_only && replay_include(pp, file)))) {
+      // nothing to read
+    } else if (!file || !enter_file(pp, file)) {
+      error(pp, directive, "'%s' file not found", name);
+    } else if (pp->directives_only) {
+      frame_vec_last(&pp->frames)->record = new_include(pp);
+    }
+  }
+  free(name);
+}
+
+// #error and #warning
+static void do_message(pp_t *pp, diag_level_t level, const token_t *directive,
+                       const token_t *p, const token_t *end) {
+  const char *text = "";
+  int len = 0;
+  if (p < end) {
+    text = spelling(p);
+    len = spelling(end - 1) + end[-1].len - text;
+  }
+  dcc_diag(pp->diags, level, directive->loc, directive->len, "%.*s", len, text);
+}
+
+// stdspec.6.10.6 #pragma. Only `once` means anything to us.
+static void do_pragma(pp_t *pp, const token_t *p, const token_t *end) {
+  if (p < end && is_name(p) && p->val.name == NAMES.once) {
+    set_once(pp, frame_vec_last(&pp->frames)->file);
+  }
+}
+
+// Interpret the directive whose `#` is at the current position of the file
+// being read
+static void directive(pp_t *pp) {
+  frame_t *frame = frame_vec_last(&pp->frames);
+  const token_t *end, *begin = directive_line(frame, &end);
+  if (begin == end) {
+    return; // the null directive
+  }
+
+  const token_t *args = begin + 1;
+  const name_t *name = is_name(begin) ? begin->val.name : 0;
+
+  guard_state_t guard_state = frame->guard_state;
+  if (guard_state == GUARD_START && name == NAMES.ifndef && args < end && is_name(args)) {
+    frame->guard_state = GUARD_OPEN;
+    frame->guard = args->val.name;
+  } else if (guard_state == GUARD_START || guard_state == GUARD_CLOSED) {
+    frame->guard_state = GUARD_NONE;
+  }
+
+  if (name == NAMES.define) {
+    do_define(pp, begin, args, end);
+  } else if (name == NAMES.undef) {
+    do_undef(pp, begin, args, end);
+  } else if (name == NAMES.include) {
+    do_include(pp, begin, args, end);
+  } else if (name == NAMES.if_) {
+    push_cond(pp, begin, eval_if(pp, begin, args, end));
+  } else if (name == NAMES.ifdef || name == NAMES.ifndef) {
+    const name_t *macro = directive_name(pp, begin, args, end);
+    bool defined = macro && lookup_macro(pp, macro);
+    push_cond(pp, begin, macro && defined == (name == NAMES.ifdef));
+  } else if (name == NAMES.elif || name == NAMES.else_) {
+    // the group before was taken, so every group after is skipped
+    if (name == NAMES.else_) {
+      extra_tokens(pp, begin, args, end);
+    }
+    if (next_group(pp, begin, name == NAMES.else_)) {
+      skip_group(pp);
+    }
+  } else if (name == NAMES.endif) {
+    extra_tokens(pp, begin, args, end);
+    end_cond(pp, begin);
+  } else if (name == NAMES.error) {
+    do_message(pp, DIAG_ERROR, begin, args, end);
+  } else if (name == NAMES.warning) {
+    do_message(pp, DIAG_WARNING, begin, args, end);
+  } else if (name == NAMES.pragma) {
+    do_pragma(pp, args, end);
+  } else if (name == NAMES.line || begin->tag == TOKEN_INTEGER) {
+    // TODO #line and line markers
+  } else {
+    error(pp, begin, "invalid preprocessing directive");
+  }
+}
+
+// The next token of the file being read, after any directives before it
+static token_t file_next(pp_t *pp) {
+  while (pp->frames.size) {
+    frame_t *frame = frame_vec_last(&pp->frames);
+    const token_t *token = &frame->file->tokens.data[frame->pos];
+    if (token->tag == TOKEN_EOF) {
+      return *token;
+    } else if (token->tag == TOKEN_HASH && token->flags & TOKEN_FLAG_BOL) {
+      directive(pp);
+      continue;
+    }
+
+    frame->pos++;
+    if (frame->guard_state != GUARD_OPEN) {
+      frame->guard_state = GUARD_NONE;
+    }
+    return *token;
+  }
+  return pp->eof;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Precompiled headers
+////////////////////////////////////////////////////////////////////////////////
+
+// A precompiled header holds what preprocessing a header leaves behind: the
+// macros defined, the guards of the files included and the output tokens,
+// along with the text of every source those tokens are spelled in. Loading one
+// maps the file and fixes it up in place, so the cost is a pass over the
+// tokens rather than reading, tokenizing and expanding the header again.
+//
+// Sections are addressed by offset from the start of the file. Tokens are
+// stored as they are in memory, except that names are replaced by indices into
+// the name table and a hide-set by one of its names; past the header,
+// hide-sets only affect the spacing of -E output.
+//
+// Each source read from a file keeps that file's size and modification time,
+// and a header is refused once any of them has changed. Only preprocessing is
+// saved: the declarations in the output tokens are still parsed and checked
+// each time the header is loaded.
+
+#define PCH_MAGIC "dccpch2"
+
+typedef struct {
+  uint64_t offset;
+  uint32_t count;
+  uint32_t size; // of one element, which checks that the layout matches
+} pch_section_t;
+
+typedef struct {
+  char magic[8];
+  srcloc_t base; // location of the first source when it was written
+  uint32_t output_count; // the output comes first in the tokens
+  pch_section_t names, sources, tokens, params, macros, files;
+} pch_header_t;
+
+// Name 0 is null
+typedef struct {
+  uint64_t offset; // of the null terminated spelling
+  uint32_t len;
+} pch_name_t;
+
+typedef struct {
+  uint64_t text; // null terminated
+  uint32_t size;
+  uint32_t path; // name
+  uint32_t is_file; // whether the path was a file when written, stamped below
+  uint64_t file_size;
+  int64_t mtime; // in nanoseconds
+} pch_source_t;
+
+typedef struct {
+  uint32_t name, kind, loc;
+  uint32_t variadic, has_ops;
+  uint32_t params, param_count; // names in the params section
+  uint32_t body, body_count; // into the tokens
+} pch_macro_t;
+
+// A file with a guard or #pragma once
+typedef struct {
+  uint32_t path, guard; // names; the canonical path
+  uint32_t once;
+} pch_file_t;
+
+typedef struct {
+  char *data;
+  size_t size, capacity;
+  ptrmap_t name_index; // name_t* -> index in names
+  name_vec_t names;
+} pch_writer_t;
+
+// Append `size` bytes, 8-byte aligned, returning their offset
+static uint64_t pch_append(pch_writer_t *writer, const void *data, size_t size) {
+  size_t offset = (writer->size + 7) & ~(size_t)7;
+  if (offset + size > writer->capacity) {
+    writer->capacity = 2 * (offset + size);
+    writer->data = dcc_realloc(writer->data, writer->capacity);
+  }
+  memset(writer->data + writer->size, 0, offset - writer->size);
+  memcpy(writer->data + offset, data, size);
+  writer->size = offset + size;
+  return offset;
+}
+
+static pch_section_t pch_section(pch_writer_t *writer, const void *data,
+                                 uint32_t count, uint32_t size) {
+  pch_section_t section = { pch_append(writer, data, (size_t)count * size), count, size };
+  return section;
+}
+
+static uint32_t pch_name(pch_writer_t *writer, const name_t *name) {
+  if (!name) {
+    return 0;
+  }
+  uintptr_t index = (uintptr_t)dcc_ptrmap_get(&writer->name_index, name);
+  if (!index) {
+    index = writer->names.size;
+    name_vec_push(&writer->names, name);
+    dcc_ptrmap_put(&writer->name_index, name, (void*)index);
+  }
+  return index;
+}
+
+// Stamp a source with the size and modification time of its file, if it has
+// one
+static void pch_stamp(pch_source_t *source, const char *path) {
+  struct stat info;
+  source->is_file = stat(path, &info) == 0 && S_ISREG(info.st_mode);
+  if (source->is_file) {
+    source->file_size = info.st_size;
+    source->mtime = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+  }
+}
+
+static token_t pch_token(pp_t *pp, pch_writer_t *writer, token_t token) {
+  if (is_name(&token)) {
+    token.val.integer = pch_name(writer, token.val.name);
+  }
+  if (token.hideset) {
+    token.hideset = pch_name(writer, pp->hidesets.data[token.hideset].names[0]);
+  }
+  return token;
+}
+
+bool dcc_pp_write_pch(pp_t *pp, const token_vec_t *output, const char *path) {
+  pch_writer_t writer = { 0, 0, 0, dcc_ptrmap_new(), name_vec_new() };
+  name_vec_push(&writer.names, 0);
+  pch_header_t header;
+  memset(&header, 0, sizeof header);
+  memcpy(header.magic, PCH_MAGIC, sizeof header.magic);
+  pch_append(&writer, &header, sizeof header);
+
+  // every source, since macros may have made tokens spelled in scratch text
+  size_t source_count = dcc_source_count();
+  pch_source_t *sources = dcc_calloc(source_count, sizeof *sources);
+  for (size_t i = 0; i < source_count; i++) {
+    const source_file_t *file = dcc_source_at(i);
+    sources[i].text = pch_append(&writer, file->text, file->size + 1);
+    sources[i].size = file->size;
+    sources[i].path = pch_name(&writer, dcc_intern(file->path, strlen(file->path)));
+    pch_stamp(&sources[i], file->path);
+  }
+  header.base = dcc_source_at(0)->base;
+  header.sources = pch_section(&writer, sources, source_count, sizeof *sources);
+  free(sources);
+
+  token_vec_t tokens = token_vec_new();
+  for (size_t i = 0; i < output->size && output->data[i].tag != TOKEN_EOF; i++) {
+    token_vec_push(&tokens, pch_token(pp, &writer, output->data[i]));
+  }
+  header.output_count = tokens.size;
+
+  uint32_vec_t params = uint32_vec_new();
+  pch_macro_t *macros = dcc_calloc(pp->macros.size, sizeof *macros);
+  uint32_t macro_count = 0;
+  for (size_t i = 0; i < pp->macros.capacity; i++) {
+    const macro_t *macro = pp->macros.entries[i].value;
+    if (!pp->macros.entries[i].key || macro->kind == MACRO_FILE || macro->kind == MACRO_LINE) {
+      continue;
+    }
+    pch_macro_t *record = &macros[macro_count++];
+    record->name = pch_name(&writer, macro->name);
+    record->kind = macro->kind;
+    record->loc = macro->loc;
+    record->variadic = macro->variadic;
+    record->has_ops = macro->has_ops;
+    record->params = params.size;
+    record->param_count = macro->params.size;
+    for (size_t j = 0; j < macro->params.size; j++) {
+      uint32_vec_push(&params, pch_name(&writer, macro->params.data[j]));
+    }
+    record->body = tokens.size;
+    record->body_count = macro->body.size;
+    for (size_t j = 0; j < macro->body.size; j++) {
+      token_vec_push(&tokens, pch_token(pp, &writer, macro->body.data[j]));
+    }
+  }
+  header.tokens = pch_section(&writer, tokens.data, tokens.size, sizeof(token_t));
+  header.params = pch_section(&writer, params.data, params.size, sizeof(uint32_t));
+  header.macros = pch_section(&writer, macros, macro_count, sizeof *macros);
+  token_vec_free(&tokens);
+  uint32_vec_free(&params);
+  free(macros);
+
+  pch_file_t *files = dcc_calloc(pp->real_files.size, sizeof *files);
+  uint32_t file_count = 0;
+  for (size_t i = 0; i < pp->real_files.capacity; i++) {
+    const pp_file_t *file = pp->real_files.entries[i].value;
+    if (pp->real_files.entries[i].key && (file->guard || file->once)) {
+      pch_file_t record = { pch_name(&writer, file->path), pch_name(&writer, file->guard), file->once };
+      files[file_count++] = record;
+    }
+  }
+  header.files = pch_section(&writer, files, file_count, sizeof *files);
+  free(files);
+
+  // last, now that every name has been seen
+  pch_name_t *names = dcc_calloc(writer.names.size, sizeof *names);
+  for (size_t i = 1; i < writer.names.size; i++) {
+    const name_t *name = writer.names.data[i];
+    names[i].offset = pch_append(&writer, name->str, name->len + 1);
+    names[i].len = name->len;
+  }
+  header.names = pch_section(&writer, names, writer.names.size, sizeof *names);
+  free(names);
+  memcpy(writer.data, &header, sizeof header);
+
+  FILE *stream = fopen(path, "wb");
+  bool written = stream && fwrite(writer.data, 1, writer.size, stream) == writer.size;
+  if (stream && fclose(stream) != 0) {
+    written = false;
+  }
+  free(writer.data);
+  dcc_ptrmap_free(&writer.name_index);
+  name_vec_free(&writer.names);
+  return written;
+}
+
+typedef struct {
+  const name_t **names;
+  uint32_t count;
+  bool valid; // cleared by a reference to a name that does not exist
+} pch_names_t;
+
+static const name_t* pch_name_at(pch_names_t *names, uint32_t index, bool nullable) {
+  if (index >= names->count || (!index && !nullable)) {
+    names->valid = false;
+    return 0;
+  }
+  return names->names[index];
+}
+
+static bool pch_section_valid(const pch_section_t *section, size_t element_size,
+                              size_t size) {
+  return section->size == element_size && section->offset <= size &&
+    (size - section->offset) / element_size >= section->count;
+}
+
+static bool pch_string_valid(const char *map, size_t size, uint64_t offset,
+                             uint32_t len) {
+  return offset < size && size - offset > len && !map[offset + len];
+}
+
+// Read the names and sources of a mapped precompiled header, registering the
+// sources so that locations in it need only be moved by `delta`
+// Returns where the sources ended when the header was written
+static srcloc_t pch_load_sources(const char *map, size_t size, pch_names_t *names,
+                                 srcloc_t *delta) {
+  const pch_header_t *header = (const pch_header_t*)map;
+  const pch_name_t *records = (const pch_name_t*)(map + header->names.offset);
+  names->count = header->names.count;
+  names->names = dcc_calloc(names->count + 1, sizeof *names->names);
+  names->valid = names->count > 0;
+  for (uint32_t i = 1; i < names->count; i++) {
+    if (!pch_string_valid(map, size, records[i].offset, records[i].len)) {
+      names->valid = false;
+      return 0;
+    }
+    names->names[i] = dcc_intern(map + records[i].offset, records[i].len);
+  }
+
+  const pch_source_t *sources = (const pch_source_t*)(map + header->sources.offset);
+  srcloc_t base = header->base;
+  for (uint32_t i = 0; i < header->sources.count; i++) {
+    const name_t *path = pch_name_at(names, sources[i].path, false);
+    if (!path || !pch_string_valid(map, size, sources[i].text, sources[i].size)) {
+      names->valid = false;
+      return 0;
+    }
+    const source_file_t *file = dcc_source_add(path->str, map + sources[i].text,
+                                               sources[i].size);
+    if (i == 0) {
+      *delta = file->base - base;
+    }
+    // sources are laid out back to back, so one offset fits them all
+    dcc_assert(file->base == base + *delta);
+    base += sources[i].size + 1;
+  }
+  return base;
+}
+
+// Whether a token of a mapped precompiled header is one that could have been
+// written, spelled inside the sources from `base` to `end`
+static bool pch_token_valid(const token_t *token, srcloc_t base, srcloc_t end) {
+  return (unsigned)token->tag < TOKEN_MAX && token->tag != TOKEN_EOF &&
+    token->loc >= base && token->loc <= end && end - token->loc >= token->len;
+}
+
+// The first source of a mapped precompiled header whose file has changed
+// since, or null
+static const char* pch_stale_source(const char *map, pch_names_t *names) {
+  const pch_header_t *header = (const pch_header_t*)map;
+  const pch_source_t *sources = (const pch_source_t*)(map + header->sources.offset);
+  for (uint32_t i = 0; i < header->sources.count; i++) {
+    if (!sources[i].is_file) {
+      continue;
+    }
+    const char *path = pch_name_at(names, sources[i].path, false)->str;
+    pch_source_t now;
+    pch_stamp(&now, path);
+    if (!now.is_file || now.file_size != sources[i].file_size
+        || now.mtime != sources[i].mtime) {
+      return path;
+    }
+  }
+  return 0;
+}
+
+bool dcc_pp_load_pch(pp_t *pp, const char *path, const char **stale) {
+  *stale = 0;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  char *map = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(pch_header_t)) {
+    // private and writable, as tokens are fixed up where they lie
+    map = mmap(0, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+
+  size_t size = info.st_size;
+  const pch_header_t *header = (const pch_header_t*)map;
+  if (memcmp(header->magic, PCH_MAGIC, sizeof header->magic) != 0 ||
+      !pch_section_valid(&header->names, sizeof(pch_name_t), size) ||
+      !pch_section_valid(&header->sources, sizeof(pch_source_t), size) ||
+      !pch_section_valid(&header->tokens, sizeof(token_t), size) ||
+      !pch_section_valid(&header->params, sizeof(uint32_t), size) ||
+      !pch_section_valid(&header->macros, sizeof(pch_macro_t), size) ||
+      !pch_section_valid(&header->files, sizeof(pch_file_t), size) ||
+      header->output_count > header->tokens.count) {
+    munmap(map, size);
+    return false;
+  }
+
+  // the mapping is never unmapped from here on, as the sources registered
+  // with the source map live in it
+  pch_names_t names;
+  srcloc_t delta = 0;
+  srcloc_t end = pch_load_sources(map, size, &names, &delta);
+  if (names.valid && (*stale = pch_stale_source(map, &names))) {
+    free(names.names);
+    return false;
+  }
+
+  token_t *tokens = (token_t*)(map + header->tokens.offset);
+  for (uint32_t i = 0; names.valid && i < header->tokens.count; i++) {
+    token_t *token = &tokens[i];
+    if (!pch_token_valid(token, header->base, end)) {
+      names.valid = false;
+      break;
+    }
+    token->loc += delta;
+    // an identifier without a name invalidates `names`
+    if (is_name(token)) {
+      token->val.name = pch_name_at(&names, token->val.integer, false);
+    }
+    if (token->hideset) {
+      const name_t *name = pch_name_at(&names, token->hideset, false);
+      token->hideset = name ? intern_hideset(pp, &name, 1) : 0;
+    }
+  }
+
+  const uint32_t *params = (const uint32_t*)(map + header->params.offset);
+  const pch_macro_t *macros = (const pch_macro_t*)(map + header->macros.offset);
+  for (uint32_t i = 0; names.valid && i < header->macros.count; i++) {
+    const pch_macro_t *record = &macros[i];
+    const name_t *name = pch_name_at(&names, record->name, false);
+    if (!name || (record->kind != MACRO_OBJECT && record->kind != MACRO_FUNCTION) ||
+        record->loc < header->base || record->loc > end ||
+        record->params > header->params.count ||
+        header->params.count - record->params < record->param_count ||
+        record->body > header->tokens.count ||
+        header->tokens.count - record->body < record->body_count) {
+      names.valid = false;
+      break;
+    }
+
+    macro_t *macro = dcc_malloc(sizeof *macro);
+    macro->kind = record->kind;
+    macro->name = name;
+    macro->loc = record->loc + delta;
+    macro->variadic = record->variadic;
+    macro->has_ops = record->has_ops;
+    macro->kept = false;
+    macro->params = name_vec_new();
+    for (uint32_t j = 0; j < record->param_count; j++) {
+      name_vec_push(&macro->params, pch_name_at(&names, params[record->params + j], false));
+    }
+    macro->body = token_vec_new();
+    for (uint32_t j = 0; j < record->body_count; j++) {
+      token_vec_push(&macro->body, tokens[record->body + j]);
+    }
+    define_macro(pp, macro);
+  }
+
+  const pch_file_t *files = (const pch_file_t*)(map + header->files.offset);
+  for (uint32_t i = 0; names.valid && i < header->files.count; i++) {
+    const name_t *real_key = pch_name_at(&names, files[i].path, false);
+    const name_t *guard = pch_name_at(&names, files[i].guard, true);
+    if (!real_key) {
+      break;
+    }
+    pp_file_t *file = dcc_ptrmap_get(&pp->real_files, real_key);
+    if (!file) {
+      file = new_file(pp, 0, real_key);
+      dcc_ptrmap_put(&pp->real_files, real_key, file);
+    }
+    file->guard = guard;
+    file->once = files[i].once;
+  }
+
+  if (names.valid) {
+    pp->prefix = tokens;
+    pp->prefix_end = tokens + header->output_count;
+  }
+  free(names.names);
+  return names.valid;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Interface
+////////////////////////////////////////////////////////////////////////////////
+
+#define INTERN(str) dcc_intern(str, sizeof(str) - 1)
+
+pp_t* dcc_pp_new(diag_vec_t *diags) {
+  NAMES.define = INTERN("define");
+  NAMES.undef = INTERN("undef");
+  NAMES.include = INTERN("include");
+  NAMES.if_ = INTERN("if");
+  NAMES.ifdef = INTERN("ifdef");
+  NAMES.ifndef = INTERN("ifndef");
+  NAMES.elif = INTERN("elif");
+  NAMES.else_ = INTERN("else");
+  NAMES.endif = INTERN("endif");
+  NAMES.line = INTERN("line");
+  NAMES.error = INTERN("error");
+  NAMES.warning = INTERN("warning");
+  NAMES.pragma = INTERN("pragma");
+  NAMES.once = INTERN("once");
+  NAMES.defined = INTERN("defined");
+  NAMES.va_args = INTERN("__VA_ARGS__");
+  NAMES.file = INTERN("__FILE__");
+  NAMES.line_macro = INTERN("__LINE__");
+
+  pp_t *pp = dcc_calloc(1, sizeof *pp);
+  pp->diags = diags;
+  pp->include_dirs = str_vec_new();
+  pp->macros = dcc_ptrmap_new();
+  pp->scratch = dcc_ptrmap_new();
+  pp->undefined = macro_vec_new();
+  pp->files = dcc_ptrmap_new();
+  pp->real_files = dcc_ptrmap_new();
+  pp->all_files = pp_file_vec_new();
+  pp->initial = dcc_ptrmap_new();
+  pp->deps = pp_file_vec_new();
+  pp->once_files = pp_file_vec_new();
+  pp->kept = macro_vec_new();
+  pp->frames = frame_vec_new();
+  pp->conds = cond_vec_new();
+  pp->contexts = context_vec_new();
+  pp->eof.tag = TOKEN_EOF;
+
+  pp->hidesets = hideset_vec_new();
+  hideset_t empty = { 0, 0, 0 };
+  hideset_vec_push(&pp->hidesets, empty);
+  pp->hideset_capacity = 64;
+  pp->hideset_index = dcc_calloc(pp->hideset_capacity, sizeof(uint32_t));
+
+  char *text = dcc_malloc(4);
+  strcpy(text, "0 1");
+  token_vec_t booleans = tokenize_scratch("<built-in>", text, 3);
+  pp->zero = booleans.data[0];
+  pp->one = booleans.data[1];
+  token_vec_free(&booleans);
+
+  const name_t *builtins[] = { NAMES.file, NAMES.line_macro };
+  for (int i = 0; i < 2; i++) {
+    macro_t *macro = dcc_calloc(1, sizeof *macro);
+    macro->kind = i == 0 ? MACRO_FILE : MACRO_LINE;
+    macro->name = builtins[i];
+    define_macro(pp, macro);
+  }
+  for (size_t i = 0; i < sizeof PREDEFINED_MACROS / sizeof(char*); i++) {
+    dcc_pp_define(pp, PREDEFINED_MACROS[i]);
+  }
+  return pp;
+}
+
+void dcc_pp_free(pp_t *pp) {
+  // kept macros may also be defined or undefined, so they go last
+  for (size_t i = 0; i < pp->macros.capacity; i++) {
+    macro_t *macro = pp->macros.entries[i].value;
+    if (pp->macros.entries[i].key && !macro->kept) {
+      free_macro(macro);
+    }
+  }
+  for (size_t i = 0; i < pp->scratch.capacity; i++) {
+    free(pp->scratch.entries[i].value);
+  }
+  for (size_t i = 0; i < pp->undefined.size; i++) {
+    if (!pp->undefined.data[i]->kept) {
+      free_macro(pp->undefined.data[i]);
+    }
+  }
+  for (size_t i = 0; i < pp->kept.size; i++) {
+    free_macro(pp->kept.data[i]);
+  }
+  for (size_t i = 0; i < pp->all_files.size; i++) {
+    pp_file_t *file = pp->all_files.data[i];
+    while (file->includes) {
+      include_t *next = file->includes->next;
+      free_include(file->includes);
+      file->includes = next;
+    }
+    token_vec_free(&file->tokens);
+    free(file);
+  }
+  for (size_t i = 0; i < pp->include_dirs.size; i++) {
+    free(pp->include_dirs.data[i]);
+  }
+  for (size_t i = 1; i < pp->hidesets.size; i++) {
+    free(pp->hidesets.data[i].names);
+  }
+
+  str_vec_free(&pp->include_dirs);
+  dcc_ptrmap_free(&pp->macros);
+  dcc_ptrmap_free(&pp->scratch);
+  macro_vec_free(&pp->undefined);
+  dcc_ptrmap_free(&pp->files);
+  dcc_ptrmap_free(&pp->real_files);
+  pp_file_vec_free(&pp->all_files);
+  dcc_ptrmap_free(&pp->initial);
+  pp_file_vec_free(&pp->deps);
+  pp_file_vec_free(&pp->once_files);
+  macro_vec_free(&pp->kept);
+  frame_vec_free(&pp->frames);
+  cond_vec_free(&pp->conds);
+  while (pp->contexts.size) {
+    pop_context(pp);
+  }
+  context_vec_free(&pp->contexts);
+  hideset_vec_free(&pp->hidesets);
+  free(pp->hideset_index);
+  free(pp);
+}
+
+void dcc_pp_add_include_dir(pp_t *pp, const char *dir) {
+  char *copy = dcc_malloc(strlen(dir) + 1);
+  strcpy(copy, dir);
+  str_vec_push(&pp->include_dirs, copy);
+}
+
+void dcc_pp_define(pp_t *pp, const char *definition) {
+  const char *equals = strchr(definition, '=');
+  int name_len = equals ? equals - definition : (int)strlen(definition);
+  const char *value = equals ? equals + 1 : "1";
+
+  size_t size = name_len + strlen(value) + 1;
+  char *text = dcc_malloc(size + 1);
+  sprintf(text, "%.*s %s", name_len, definition, value);
+
+  token_vec_t tokens = tokenize_scratch("<command line>", text, size);
+  token_t *begin = tokens.data, *end = tokens.data + tokens.size - 1;
+  do_define(pp, begin, begin, end);
+  token_vec_free(&tokens);
+}
+
+void dcc_pp_enter(pp_t *pp, const source_file_t *file) {
+  // the file is known by its canonical path too, so that its guard is seen
+  // should it be included (or written to a precompiled header)
+  char *real = realpath(file->path, 0);
+  const name_t *real_key = real ? dcc_intern(real, strlen(real)) : 0;
+  free(real);
+
+  pp_file_t *entered = new_file(pp, file, real_key);
+  if (real_key && !dcc_ptrmap_get(&pp->real_files, real_key)) {
+    dcc_ptrmap_put(&pp->real_files, real_key, entered);
+  }
+  enter_file(pp, entered);
+}
+
+token_t dcc_pp_next(pp_t *pp) {
+  if (pp->prefix < pp->prefix_end) {
+    return *pp->prefix++;
+  }
+  while (true) {
+    token_t token = expand_next(pp, 0, false);
+    if (token.tag != TOKEN_EOF || pp->frames.size == 0) {
+      return token;
+    }
+
+    // the end of the main file is the end of the input
+    bool last = pp->frames.size == 1;
+    leave_file(pp);
+    if (last) {
+      pp->eof = token;
+      return token;
+    }
+  }
+}
+
+token_vec_t dcc_preprocess(pp_t *pp, const source_file_t *file) {
+  token_vec_t tokens = token_vec_new();
+  dcc_pp_enter(pp, file);
+
+  token_t token;
+  do {
+    token = dcc_pp_next(pp);
+    token_vec_push(&tokens, token);
+  } while (token.tag != TOKEN_EOF);
+  return tokens;
+}
+
+// Start another translation unit for dcc_pp_scan(): the macros go back to those
+// defined before the first, while files stay cached along with their guards
+// and recorded inclusions
+static void begin_unit(pp_t *pp) {
+  if (pp->unit++ == 0) {
+    for (size_t i = 0; i < pp->macros.capacity; i++) {
+      if (pp->macros.entries[i].key) {
+        dcc_ptrmap_put(&pp->initial, pp->macros.entries[i].key, pp->macros.entries[i].value);
+      }
+    }
+    return;
+  }
+
+  for (size_t i = 0; i < pp->macros.capacity; i++) {
+    macro_t *macro = pp->macros.entries[i].value;
+    if (pp->macros.entries[i].key && !macro->kept &&
+        dcc_ptrmap_get(&pp->initial, macro->name) != macro) {
+      free_macro(macro);
+    }
+  }
+  for (size_t i = 0; i < pp->undefined.size; i++) {
+    macro_t *macro = pp->undefined.data[i];
+    if (!macro->kept && dcc_ptrmap_get(&pp->initial, macro->name) != macro) {
+      free_macro(macro);
+    }
+  }
+  pp->undefined.size = 0;
+
+  dcc_ptrmap_free(&pp->macros);
+  pp->macros = dcc_ptrmap_new();
+  for (size_t i = 0; i < pp->initial.capacity; i++) {
+    if (pp->initial.entries[i].key) {
+      dcc_ptrmap_put(&pp->macros, pp->initial.entries[i].key, pp->initial.entries[i].value);
+    }
+  }
+
+  for (size_t i = 0; i < pp->once_files.size; i++) {
+    pp->once_files.data[i]->once = false;
+  }
+  pp->once_files.size = 0;
+  pp->deps.size = 0;
+  memset(&pp->eof, 0, sizeof pp->eof);
+  pp->eof.tag = TOKEN_EOF;
+}
+
+// Write one name of a Make rule, breaking lines as they fill up
+static void print_dep(FILE *out, const char *path, size_t *column) {
+  size_t len = strlen(path);
+  if (*column + len + 1 > 78) {
+    fputs(" \\\n ", out);
+    *column = 1;
+  }
+  fputc(' ', out);
+  fwrite(path, 1, len, out);
+  *column += len + 1;
+}
+
+void dcc_pp_scan(pp_t *pp, const source_file_t *file, FILE *out, const char *target,
+                 bool system_headers) {
+  pp->directives_only = true;
+  begin_unit(pp);
+  dcc_pp_enter(pp, file);
+  while (dcc_pp_next(pp).tag != TOKEN_EOF) {}
+
+  size_t column = strlen(target) + 1;
+  fprintf(out, "%s:", target);
+  print_dep(out, file->path, &column);
+  for (size_t i = 0; i < pp->deps.size; i++) {
+    const pp_file_t *dep = pp->deps.data[i];
+    if (system_headers || !dep->system) {
+      print_dep(out, dep->source ? dep->source->path : dep->path->str, &column);
+    }
+  }
+  fputc('\n', out);
+}
+
+// Whether two tokens written without a space between them could run together
+// into one; only an issue where they meet through macro expansion
+static bool needs_space(const token_t *prev, const token_t *token) {
+  if (!prev->hideset && !token->hideset) {
+    return false;
+  }
+  bool prev_word = is_name(prev) || prev->tag == TOKEN_INTEGER || prev->tag == TOKEN_FLOATING;
+  bool word = is_name(token) || token->tag == TOKEN_INTEGER || token->tag == TOKEN_FLOATING;
+  char last = spelling(prev)[prev->len - 1], first = *spelling(token);
+  return (prev_word && (word || first == '.')) ||
+    (!prev_word && !word && strchr("+-*/%<>=&|^!#.:", last) && strchr("=+-<>&|#.:*/%", first));
+}
+
+void dcc_pp_print(FILE *out, const token_vec_t *tokens) {
+  for (size_t i = 0; i < tokens->size && tokens->data[i].tag != TOKEN_EOF; i++) {
+    const token_t *token = &tokens->data[i];
+    if (i > 0) {
+      if (token->flags & TOKEN_FLAG_BOL) {
+        fputc('\n', out);
+      } else if (token->flags & TOKEN_FLAG_SPACE || needs_space(token - 1, token)) {
+        fputc(' ', out);
+      }
+    }
+    fwrite(spelling(token), 1, token->len, out);
+  }
+  fputc('\n', out);
+}
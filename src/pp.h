@@ -0,0 +1,78 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Preprocessing (stdspec.6.10). The preprocessor sits between the tokenizer and
+  the parser: tokens are pulled from it one at a time while it interprets
+  directives, splices in included files and expands macros.
+
+  Files are tokenized whole when they are first entered. An included file whose
+  contents are wrapped in a single #ifndef/#endif pair, or which says
+  #pragma once, is remembered so that later inclusions are skipped without
+  opening it again.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "diag.h"
+#include "source_map.h"
+#include "tokenize.h"
+
+typedef struct pp pp_t;
+
+pp_t* dcc_pp_new(diag_vec_t *diags);
+void dcc_pp_free(pp_t *pp);
+
+// Directories searched by #include, in the order they are added, before the
+// system directories
+void dcc_pp_add_include_dir(pp_t *pp, const char *dir);
+
+// Define a macro as -D does: `NAME` (which defines it as 1) or `NAME=VALUE`
+void dcc_pp_define(pp_t *pp, const char *definition);
+
+// Start preprocessing `file`. Tokens are then read with dcc_pp_next, which
+// returns TOKEN_EOF once the file is exhausted.
+void dcc_pp_enter(pp_t *pp, const source_file_t *file);
+token_t dcc_pp_next(pp_t *pp);
+
+// Preprocess all of `file`; the result ends with TOKEN_EOF
+token_vec_t dcc_preprocess(pp_t *pp, const source_file_t *file);
+
+// Dependency scanning (-M). Run only the directives of `file`, skipping
+// everything between them, and write a Make rule for `target` listing the file
+// and the headers it includes; those from system directories only if
+// `system_headers`. Each call starts again from the macros defined before the
+// first, but files read by one call are not read again by the next.
+void dcc_pp_scan(pp_t *pp, const source_file_t *file, FILE *out, const char *target,
+                 bool system_headers);
+
+// Precompiled headers (--emit-pch). Writing one records the macros and include
+// guards left by preprocessing a header together with its output `tokens`.
+// Loading it into a new preprocessor restores the macros and guards, and
+// dcc_pp_next then returns those tokens before reading the file entered, which
+// the parser and checker still go through as usual. Both return false on
+// failure; loading sets `stale` to a source that has changed since the header
+// was written, if that was why.
+bool dcc_pp_write_pch(pp_t *pp, const token_vec_t *tokens, const char *path);
+bool dcc_pp_load_pch(pp_t *pp, const char *path, const char **stale);
+
+// Write tokens back out as text, for -E
+void dcc_pp_print(FILE *out, const token_vec_t *tokens);
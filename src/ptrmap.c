@@ -0,0 +1,125 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdint.h>
+
+#include "dcc.h"
+#include "ptrmap.h"
+
+static size_t hash_ptr(const void *key) {
+  uint64_t x = (uintptr_t)key;
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdull;
+  x ^= x >> 33;
+  return x;
+}
+
+ptrmap_t dcc_ptrmap_new() {
+  ptrmap_t map = { 0, 0, 0 };
+  return map;
+}
+
+void dcc_ptrmap_free(ptrmap_t *map) {
+  free(map->entries);
+  map->entries = 0;
+  map->size = map->capacity = 0;
+}
+
+// Index of the slot holding `key`, or of the empty slot where it belongs
+static size_t find_slot(const ptrmap_t *map, const void *key) {
+  size_t mask = map->capacity - 1;
+  size_t i = hash_ptr(key) & mask;
+  while (map->entries[i].key && map->entries[i].key != key) {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+static void grow(ptrmap_t *map) {
+  ptrmap_t bigger = {
+    dcc_calloc(map->capacity ? map->capacity * 2 : 16, sizeof(ptrmap_entry_t)),
+    map->size,
+    map->capacity ? map->capacity * 2 : 16,
+  };
+  for (size_t i = 0; i < map->capacity; i++) {
+    if (map->entries[i].key) {
+      bigger.entries[find_slot(&bigger, map->entries[i].key)] = map->entries[i];
+    }
+  }
+  free(map->entries);
+  *map = bigger;
+}
+
+void* dcc_ptrmap_get(const ptrmap_t *map, const void *key) {
+  if (map->size == 0) {
+    return 0;
+  }
+  ptrmap_entry_t *entry = &map->entries[find_slot(map, key)];
+  return entry->key ? entry->value : 0;
+}
+
+void* dcc_ptrmap_put(ptrmap_t *map, const void *key, void *value) {
+  dcc_assert(key);
+  ptrmap_entry_t *entry = map->capacity ? &map->entries[find_slot(map, key)] : 0;
+  // only grow when adding a key, so overwriting a value never rehashes
+  if ((!entry || !entry->key) && (map->size + 1) * 4 > map->capacity * 3) {
+    grow(map);
+    entry = &map->entries[find_slot(map, key)];
+  }
+
+  void *previous = entry->key ? entry->value : 0;
+  if (!entry->key) {
+    entry->key = key;
+    map->size++;
+  }
+  entry->value = value;
+  return previous;
+}
+
+void* dcc_ptrmap_remove(ptrmap_t *map, const void *key) {
+  if (map->size == 0) {
+    return 0;
+  }
+
+  size_t mask = map->capacity - 1;
+  size_t i = find_slot(map, key);
+  if (!map->entries[i].key) {
+    return 0;
+  }
+  void *value = map->entries[i].value;
+
+  // backward shift deletion keeps probe sequences intact without tombstones
+  size_t j = i;
+  while (true) {
+    map->entries[i].key = 0;
+    while (true) {
+      j = (j + 1) & mask;
+      if (!map->entries[j].key) {
+        map->size--;
+        return value;
+      }
+      size_t home = hash_ptr(map->entries[j].key) & mask;
+      // move entry j into the hole at i unless its home lies cyclically in (i, j]
+      if (i <= j ? (i >= home || home > j) : (i >= home && home > j)) {
+        break;
+      }
+    }
+    map->entries[i] = map->entries[j];
+    i = j;
+  }
+}
@@ -0,0 +1,46 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Open-addressing hash map from pointers to pointers. Keys are compared by
+  identity, which makes it the natural index for interned names and AST nodes.
+  Null keys are not allowed.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+typedef struct {
+  const void *key;
+  void *value;
+} ptrmap_entry_t;
+
+typedef struct {
+  ptrmap_entry_t *entries;
+  size_t size, capacity; // capacity is zero or a power of two
+} ptrmap_t;
+
+ptrmap_t dcc_ptrmap_new();
+void dcc_ptrmap_free(ptrmap_t *map);
+
+void* dcc_ptrmap_get(const ptrmap_t *map, const void *key);
+// Returns the previous value, if any
+void* dcc_ptrmap_put(ptrmap_t *map, const void *key, void *value);
+// Returns the removed value, if any
+void* dcc_ptrmap_remove(ptrmap_t *map, const void *key);
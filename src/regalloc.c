@@ -0,0 +1,251 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "loop.h"
+#include "regalloc.h"
+#include "ssa.h"
+
+typedef struct {
+  ir_func_t *func;
+  uint32_t *end; // of the interval of each value
+  uint32_vec_t *live_in; // of each block
+  uint32_t *loop_end; // of each loop header, the last position in the loop, else 0
+  // the set of values live at the point the backward pass has reached in block
+  // b, as those whose live[] is b + 1, and a list holding at least them
+  uint32_t *live, *listed;
+  uint32_vec_t list;
+} live_t;
+
+static uint32_t last_instr(const ir_func_t *func, uint32_t block) {
+  const uint32_vec_t *instrs = &func->blocks.data[block].instrs;
+  return instrs->data[instrs->size - 1];
+}
+
+static void make_live(live_t *live, ir_ref_t value, uint32_t stamp) {
+  live->live[value] = stamp;
+  if (live->listed[value] != stamp) {
+    live->listed[value] = stamp;
+    uint32_vec_push(&live->list, value);
+  }
+}
+
+static void extend(live_t *live, ir_ref_t value, uint32_t position) {
+  if (position > live->end[value]) {
+    live->end[value] = position;
+  }
+}
+
+// Find what is live into `block` from what is live into its successors and
+// what it uses itself, extending the intervals of the values live in it.
+// Returns whether the set live into it grew.
+static bool scan_block(live_t *live, uint32_t block) {
+  const ir_func_t *func = live->func;
+  const ir_block_t *b = &func->blocks.data[block];
+  uint32_t stamp = block + 1, finish = last_instr(func, block);
+  live->list.size = 0;
+  for (size_t i = 0; i < b->succs.size; i++) {
+    uint32_t succ = b->succs.data[i];
+    const uint32_vec_t *in = &live->live_in[succ];
+    for (size_t k = 0; k < in->size; k++) {
+      make_live(live, in->data[k], stamp);
+    }
+    // phi operands are used on the edge from their predecessor
+    const ir_block_t *s = &func->blocks.data[succ];
+    for (size_t k = 0; k < s->preds.size; k++) {
+      if (s->preds.data[k] != block) {
+        continue;
+      }
+      for (size_t p = 0; p < s->instrs.size; p++) {
+        const ir_instr_t *phi = &func->instrs.data[s->instrs.data[p]];
+        if (phi->op != IR_PHI) {
+          break;
+        }
+        make_live(live, phi->args[k], stamp);
+      }
+    }
+  }
+  for (size_t i = 0; i < live->list.size; i++) {
+    extend(live, live->list.data[i], finish);
+  }
+
+  for (size_t i = b->instrs.size; i-- > 0;) {
+    ir_ref_t ref = b->instrs.data[i];
+    const ir_instr_t *instr = &func->instrs.data[ref];
+    live->live[ref] = 0;
+    if (instr->op == IR_PHI) {
+      continue;
+    }
+    for (uint32_t k = 0; k < instr->count; k++) {
+      extend(live, instr->args[k], ref);
+      make_live(live, instr->args[k], stamp);
+    }
+  }
+
+  uint32_vec_t *in = &live->live_in[block];
+  size_t before = in->size;
+  in->size = 0;
+  for (size_t i = 0; i < live->list.size; i++) {
+    ir_ref_t value = live->list.data[i];
+    if (live->live[value] == stamp) {
+      uint32_vec_push(in, value);
+      // what is live into a loop's header is live all through the loop
+      extend(live, value, live->loop_end[block]);
+    }
+  }
+  return in->size != before;
+}
+
+// Liveness in one backward pass over the blocks, after Wimmer and Franz. A
+// successor later in reverse postorder has been scanned already; one earlier
+// is the header of a loop around the block, whose live values the header
+// extends to the end of the loop. Only if control flow is irreducible does
+// an edge lead back to a block that is no header, and then the pass repeats
+// until nothing more is found live.
+static uint32_t* intervals(ir_func_t *func) {
+  uint32_t n = func->instrs.size, block_count = func->blocks.size;
+  live_t live = {
+    func, dcc_malloc((n + 1) * sizeof(uint32_t)),
+    dcc_malloc(block_count * sizeof(uint32_vec_t)),
+    dcc_calloc(block_count, sizeof(uint32_t)),
+    dcc_calloc(n + 1, sizeof(uint32_t)), dcc_calloc(n + 1, sizeof(uint32_t)),
+    uint32_vec_new(),
+  };
+  for (ir_ref_t value = 0; value < n; value++) {
+    live.end[value] = value;
+  }
+
+  bool reducible = true;
+  ir_loops_t loops = dcc_ir_loops(func);
+  for (size_t i = 0; i < loops.loops.size; i++) {
+    const ir_loop_t *loop = &loops.loops.data[i];
+    // the blocks are in order, and instructions are numbered in block order
+    uint32_t last = last_instr(func, loop->blocks.data[loop->blocks.size - 1]);
+    if (last > live.loop_end[loop->header]) {
+      live.loop_end[loop->header] = last;
+    }
+  }
+  dcc_ir_loops_free(&loops);
+  for (uint32_t b = 0; b < block_count; b++) {
+    live.live_in[b] = uint32_vec_new();
+    const uint32_vec_t *succs = &func->blocks.data[b].succs;
+    for (size_t i = 0; i < succs->size; i++) {
+      if (succs->data[i] <= b && !dcc_ir_dominates(func, succs->data[i], b)) {
+        reducible = false;
+      }
+    }
+  }
+
+  bool grew = true;
+  while (grew) {
+    grew = false;
+    for (uint32_t b = block_count; b-- > 0;) {
+      grew = scan_block(&live, b) || grew;
+    }
+    grew = grew && !reducible;
+  }
+
+  for (uint32_t b = 0; b < block_count; b++) {
+    uint32_vec_free(&live.live_in[b]);
+  }
+  free(live.live_in);
+  free(live.loop_end);
+  free(live.live);
+  free(live.listed);
+  uint32_vec_free(&live.list);
+  return live.end;
+}
+
+// Whether a value should keep its register rather than `other`
+static bool outranks(const ir_func_t *func, const uint32_t *end, ir_ref_t value,
+                     ir_ref_t other) {
+  bool hinted = func->instrs.data[value].flags & IR_REGISTER;
+  bool other_hinted = func->instrs.data[other].flags & IR_REGISTER;
+  return hinted != other_hinted ? hinted : end[value] < end[other];
+}
+
+uint8_t* dcc_regalloc(ir_func_t *func, const regalloc_target_t *target) {
+  uint32_t n = func->instrs.size;
+  uint32_t *end = intervals(func);
+  // calls[p] counts the calls before position p
+  uint32_t *calls = dcc_malloc((n + 1) * sizeof(uint32_t));
+  calls[0] = 0;
+  for (ir_ref_t ref = 0; ref < n; ref++) {
+    calls[ref + 1] = calls[ref] + (func->instrs.data[ref].op == IR_CALL);
+  }
+
+  uint8_t *regs = dcc_malloc((n + 1) * sizeof(uint8_t));
+  ir_ref_t owners[32]; // the value in each register
+  for (int r = 0; r < 32; r++) {
+    owners[r] = IR_NONE;
+  }
+  for (ir_ref_t ref = 0; ref < n; ref++) {
+    const ir_instr_t *instr = &func->instrs.data[ref];
+    regs[ref] = REGALLOC_SPILL;
+    if (instr->kind == IR_VOID) {
+      continue;
+    }
+    bool is_float = instr->kind == IR_F32 || instr->kind == IR_F64
+      || dcc_ir_is_vector(instr->kind);
+    const regalloc_class_t *class = is_float ? &target->floats : &target->ints;
+
+    // expire the intervals that end here, whose registers the value may take
+    // as its operands are read before it is written
+    for (uint32_t i = 0; i < class->count; i++) {
+      uint8_t r = class->regs[i];
+      if (owners[r] != IR_NONE && end[owners[r]] <= ref) {
+        owners[r] = IR_NONE;
+      }
+    }
+
+    uint32_t allowed = UINT32_MAX;
+    if (end[ref] > ref && calls[end[ref]] > calls[ref + 1]) {
+      // live across a call
+      allowed = class->callee_saved;
+    } else if (instr->op == IR_PARAM
+               || (end[ref] > ref && func->instrs.data[end[ref]].op == IR_CALL)) {
+      allowed = ~class->args;
+    }
+
+    ir_ref_t victim = IR_NONE;
+    uint8_t victim_reg = REGALLOC_SPILL;
+    for (uint32_t i = 0; i < class->count; i++) {
+      uint8_t r = class->regs[i];
+      if (!(allowed & (1u << r))) {
+        continue;
+      } else if (owners[r] == IR_NONE) {
+        victim = IR_NONE;
+        victim_reg = r;
+        break;
+      } else if (victim == IR_NONE || outranks(func, end, victim, owners[r])) {
+        victim = owners[r];
+        victim_reg = r;
+      }
+    }
+    if (victim_reg == REGALLOC_SPILL
+        || (victim != IR_NONE && !outranks(func, end, ref, victim))) {
+      continue;
+    } else if (victim != IR_NONE) {
+      regs[victim] = REGALLOC_SPILL;
+    }
+    regs[ref] = victim_reg;
+    owners[victim_reg] = ref;
+  }
+
+  free(end);
+  free(calls);
+  return regs;
+}
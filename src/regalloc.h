@@ -0,0 +1,57 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Register allocation by linear scan, after Poletto and Sarkar. A value's live
+  interval runs from its definition to the last point it is live, found by
+  one backward pass over the blocks that extends what is live into a loop
+  header to the end of the loop; lifetime holes are ignored, as the scan
+  never splits an interval. Intervals are visited in order of their start,
+  which in a compacted function is the order of the instructions, and when a
+  register file runs out the interval ending last is spilled, sparing values
+  of `register` variables.
+  Phi operands are used at the end of their predecessors, so the code
+  generator moves them on the edge, in parallel.
+*/
+
+#pragma once
+
+#include "ir.h"
+
+#define REGALLOC_SPILL UINT8_MAX
+
+// A register file, by register number
+typedef struct {
+  const uint8_t *regs; // in order of preference
+  uint32_t count;
+  // masks of 1 << register: those preserved across calls, and those written
+  // to pass arguments, which cannot hold a call's operands or a parameter
+  // while the arguments are being moved
+  uint32_t callee_saved;
+  uint32_t args;
+} regalloc_class_t;
+
+typedef struct {
+  regalloc_class_t ints; // integers and addresses
+  regalloc_class_t floats;
+} regalloc_target_t;
+
+// The register of each value of a compacted function in SSA form with its
+// dominators computed, or REGALLOC_SPILL for those left in memory. The caller
+// frees the array.
+uint8_t* dcc_regalloc(ir_func_t *func, const regalloc_target_t *target);
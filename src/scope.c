@@ -0,0 +1,67 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "dcc.h"
+#include "scope.h"
+
+DEFINE_VEC2(scope_undo_t, scope_undo_vec);
+
+scope_t dcc_scope_new() {
+  scope_t scope = { dcc_ptrmap_new(), scope_undo_vec_new(), int_vec_new() };
+  return scope;
+}
+
+void dcc_scope_free(scope_t *scope) {
+  dcc_ptrmap_free(&scope->bindings);
+  scope_undo_vec_free(&scope->undo);
+  int_vec_free(&scope->marks);
+}
+
+void dcc_scope_enter(scope_t *scope) {
+  int_vec_push(&scope->marks, scope->undo.size);
+}
+
+void dcc_scope_leave(scope_t *scope) {
+  size_t mark = int_vec_pop(&scope->marks);
+  // unwind in reverse so a name bound twice in one scope ends up restored
+  while (scope->undo.size > mark) {
+    scope_undo_t undo = scope_undo_vec_pop(&scope->undo);
+    // the name keeps its slot, so this never grows the table
+    dcc_ptrmap_put(&scope->bindings, undo.name, undo.shadowed);
+  }
+}
+
+void dcc_scope_leave_to(scope_t *scope, int depth) {
+  while (dcc_scope_depth(scope) > depth) {
+    dcc_scope_leave(scope);
+  }
+}
+
+int dcc_scope_depth(const scope_t *scope) {
+  return scope->marks.size;
+}
+
+void* dcc_scope_lookup(const scope_t *scope, const name_t *name) {
+  return dcc_ptrmap_get(&scope->bindings, name);
+}
+
+void dcc_scope_bind(scope_t *scope, const name_t *name, void *value) {
+  dcc_assert(scope->marks.size > 0);
+  void *shadowed = dcc_ptrmap_put(&scope->bindings, name, value);
+  scope_undo_vec_push(&scope->undo, (scope_undo_t) { name, shadowed });
+}
@@ -0,0 +1,57 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Scoped symbol tables. Every binding of a namespace lives in one
+  open-addressing table keyed by interned name. Binding a name saves the value
+  it shadows in an undo log, so entering a scope is O(1) and leaving one only
+  touches the bindings made inside it; nothing is ever rehashed.
+*/
+
+#pragma once
+
+#include "intern.h"
+#include "ptrmap.h"
+#include "vec_types.h"
+
+typedef struct {
+  const name_t *name;
+  void *shadowed;
+} scope_undo_t;
+DECLARE_VEC(scope_undo_t, scope_undo_vec);
+
+typedef struct {
+  ptrmap_t bindings; // innermost value of each name, null if unbound
+  scope_undo_vec_t undo;
+  int_vec_t marks; // undo.size when each open scope was entered
+} scope_t;
+
+scope_t dcc_scope_new();
+void dcc_scope_free(scope_t *scope);
+
+void dcc_scope_enter(scope_t *scope);
+void dcc_scope_leave(scope_t *scope);
+// Leave scopes until only `depth` remain open, as after a syntax error
+void dcc_scope_leave_to(scope_t *scope, int depth);
+// Number of open scopes; the outermost scope is depth 1
+int dcc_scope_depth(const scope_t *scope);
+
+// The innermost value bound to `name`, or null
+void* dcc_scope_lookup(const scope_t *scope, const name_t *name);
+// Bind `name` in the innermost scope until it is left
+void dcc_scope_bind(scope_t *scope, const name_t *name, void *value);
@@ -0,0 +1,1796 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "consteval.h"
+#include "dcc.h"
+#include "init.h"
+#include "scope.h"
+#include "sema.h"
+#include "type.h"
+
+// Symbols are carved out of fixed-size chunks rather than malloc'd one by one
+#define CHUNK_SYMBOLS 256
+
+typedef symbol_t* symbol_ptr_t;
+DECLARE_VEC(symbol_ptr_t, symbol_vec);
+DEFINE_VEC2(symbol_ptr_t, symbol_vec);
+
+typedef stmt_t* stmt_ptr_t;
+DECLARE_VEC(stmt_ptr_t, stmt_vec);
+DEFINE_VEC2(stmt_ptr_t, stmt_vec);
+
+typedef struct {
+  uint64_t value; // converted to the type of the switch
+  uint32_t order; // among the labels of the switch
+  srcloc_t loc;
+} case_label_t;
+DECLARE_VEC(case_label_t, case_label_vec);
+DEFINE_VEC2(case_label_t, case_label_vec);
+
+// What the labels of the innermost switch have used up
+typedef struct {
+  const type_t *type; // promoted, or null if the expression is not an integer
+  case_label_vec_t cases; // those with a value
+  bool has_default;
+} switch_state_t;
+
+struct sema {
+  diag_vec_t *diags;
+  consteval_t *eval;
+  scope_t names, tags, labels; // names and tags open and close together
+  ptrmap_t linked; // every symbol with linkage, whatever scope declared it
+  stmt_vec_t gotos; // of the current function, resolved at its end
+  int loops, switches; // enclosing the current statement
+  const type_t *ret; // of the current function
+  bool is_vararg; // the current function takes `...`
+  switch_state_t *switch_state; // of the innermost switch
+  symbol_vec_t chunks;
+  size_t chunk_used;
+};
+
+sema_t* dcc_sema_new(diag_vec_t *diags) {
+  sema_t *sema = dcc_malloc(sizeof *sema);
+  sema->diags = diags;
+  sema->eval = dcc_consteval_new(diags);
+  sema->names = dcc_scope_new();
+  sema->tags = dcc_scope_new();
+  sema->labels = dcc_scope_new();
+  sema->linked = dcc_ptrmap_new();
+  sema->gotos = stmt_vec_new();
+  sema->loops = sema->switches = 0;
+  sema->ret = 0;
+  sema->switch_state = 0;
+  sema->is_vararg = false;
+  sema->chunks = symbol_vec_new();
+  sema->chunk_used = CHUNK_SYMBOLS;
+  return sema;
+}
+
+void dcc_sema_free(sema_t *sema) {
+  dcc_consteval_free(sema->eval);
+  dcc_scope_free(&sema->names);
+  dcc_scope_free(&sema->tags);
+  dcc_scope_free(&sema->labels);
+  dcc_ptrmap_free(&sema->linked);
+  stmt_vec_free(&sema->gotos);
+  for (size_t i = 0; i < sema->chunks.size; i++) {
+    free(sema->chunks.data[i]);
+  }
+  symbol_vec_free(&sema->chunks);
+  free(sema);
+}
+
+static void error(sema_t *sema, const ident_t *ident, const char *format, ...) {
+  va_list vlist;
+  va_start(vlist, format);
+  dcc_vdiag(sema->diags, DIAG_ERROR, ident->loc, ident->name ? ident->name->len : 1,
+            format, vlist);
+  va_end(vlist);
+}
+
+static void error_at(sema_t *sema, srcloc_t loc, const char *format, ...) {
+  va_list vlist;
+  va_start(vlist, format);
+  dcc_vdiag(sema->diags, DIAG_ERROR, loc, 1, format, vlist);
+  va_end(vlist);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Symbols
+////////////////////////////////////////////////////////////////////////////////
+
+// A new symbol for `ident`, which is bound to it but not entered in any scope
+static symbol_t* new_symbol(sema_t *sema, enum symbol_tag tag, ident_t *ident,
+                            int depth) {
+  if (sema->chunk_used == CHUNK_SYMBOLS) {
+    symbol_vec_push(&sema->chunks, dcc_malloc(CHUNK_SYMBOLS * sizeof(symbol_t)));
+    sema->chunk_used = 0;
+  }
+  symbol_t *symbol = &(*symbol_vec_last(&sema->chunks))[sema->chunk_used++];
+  symbol->tag = tag;
+  symbol->name = ident->name;
+  symbol->loc = ident->loc;
+  symbol->depth = depth;
+  symbol->defined = false;
+  symbol->type = 0;
+  symbol->decl.specs = 0;
+  symbol->decl.decltor = 0;
+  ident->symbol = symbol;
+  return symbol;
+}
+
+static void enter_scope(sema_t *sema) {
+  dcc_scope_enter(&sema->names);
+  dcc_scope_enter(&sema->tags);
+}
+
+static void leave_scope(sema_t *sema) {
+  dcc_scope_leave(&sema->names);
+  dcc_scope_leave(&sema->tags);
+}
+
+// Objects and functions at file scope have linkage, as do functions and extern
+// objects anywhere
+static bool has_linkage(enum symbol_tag tag, storage_spec_t storage, int depth) {
+  return (tag == SYM_OBJECT || tag == SYM_FUNCTION)
+    && (depth == 1 || tag == SYM_FUNCTION || (storage & AST_STORAGE_EXTERN));
+}
+
+static storage_spec_t symbol_storage(const symbol_t *symbol) {
+  return symbol->decl.specs ? symbol->decl.specs->storage : AST_STORAGE_NONE;
+}
+
+// Declare the identifier of `decltor` in the innermost scope. Redeclaring a
+// name with linkage yields the symbol it was first declared with, so that every
+// declaration of one entity shares a symbol. Returns null if there is no
+// identifier or the redeclaration is an error.
+static symbol_t* declare(sema_t *sema, decl_spec_t *specs, decltor_t *decltor,
+                         enum symbol_tag tag) {
+  ident_t *ident = dcc_decltor_ident(decltor);
+  if (!ident) {
+    return 0;
+  }
+
+  storage_spec_t storage = specs ? specs->storage : AST_STORAGE_NONE;
+  int depth = dcc_scope_depth(&sema->names);
+  bool linkage = has_linkage(tag, storage, depth);
+
+  symbol_t *prior = dcc_scope_lookup(&sema->names, ident->name);
+  if (prior && prior->depth != depth) {
+    prior = 0; // declared in an enclosing scope, so merely hidden
+  }
+  if (!prior && linkage) {
+    prior = dcc_ptrmap_get(&sema->linked, ident->name);
+    if (prior && prior->tag == tag) {
+      dcc_scope_bind(&sema->names, ident->name, prior);
+    }
+  }
+
+  if (prior) {
+    ident->symbol = prior;
+    if (prior->tag != tag) {
+      error(sema, ident, "redefinition of '%s' as a different kind of symbol",
+            ident->name->str);
+      return 0;
+    } else if (!linkage || !has_linkage(prior->tag, symbol_storage(prior), prior->depth)) {
+      error(sema, ident, "redefinition of '%s'", ident->name->str);
+      return 0;
+    }
+    if (!prior->defined) {
+      prior->decl.specs = specs;
+      prior->decl.decltor = decltor;
+    }
+    return prior;
+  }
+
+  symbol_t *symbol = new_symbol(sema, tag, ident, depth);
+  symbol->decl.specs = specs;
+  symbol->decl.decltor = decltor;
+  dcc_scope_bind(&sema->names, ident->name, symbol);
+  if (linkage) {
+    dcc_ptrmap_put(&sema->linked, ident->name, symbol);
+  }
+  return symbol;
+}
+
+// Mark `symbol` as defined by `decltor`, which has a body or initializer
+static void define(sema_t *sema, symbol_t *symbol, decl_spec_t *specs,
+                   decltor_t *decltor) {
+  if (!symbol) {
+    return;
+  } else if (symbol->defined) {
+    error(sema, dcc_decltor_ident(decltor), "redefinition of '%s'", symbol->name->str);
+    return;
+  }
+  symbol->defined = true;
+  symbol->decl.specs = specs;
+  symbol->decl.decltor = decltor;
+}
+
+// A tag symbol, which names a new incomplete type
+static symbol_t* new_tag(sema_t *sema, enum symbol_tag tag, ident_t *ident, int depth) {
+  symbol_t *symbol = new_symbol(sema, tag, ident, depth);
+  symbol->type = dcc_type_record(tag == SYM_STRUCT ? TYPE_STRUCT
+                                 : tag == SYM_UNION ? TYPE_UNION : TYPE_ENUM, symbol);
+  return symbol;
+}
+
+// Find or declare the tag `ident` names. A definition or a bare `struct S;`
+// always declares the tag in the innermost scope, while other references
+// find the visible one.
+static symbol_t* declare_tag(sema_t *sema, enum symbol_tag tag, ident_t *ident,
+                             bool innermost) {
+  int depth = dcc_scope_depth(&sema->tags);
+  if (!ident->name) {
+    return new_tag(sema, tag, ident, depth);
+  }
+
+  symbol_t *prior = dcc_scope_lookup(&sema->tags, ident->name);
+  if (prior && innermost && prior->depth != depth) {
+    prior = 0;
+  }
+  if (!prior) {
+    symbol_t *symbol = new_tag(sema, tag, ident, depth);
+    dcc_scope_bind(&sema->tags, ident->name, symbol);
+    return symbol;
+  }
+
+  ident->symbol = prior;
+  if (prior->tag != tag) {
+    error(sema, ident, "use of '%s' with tag type that does not match previous declaration",
+          ident->name->str);
+    return new_tag(sema, tag, ident, depth); // unbound, so the error does not cascade
+  }
+  return prior;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Types
+////////////////////////////////////////////////////////////////////////////////
+
+// Give `symbol` the type one of its declarations spells, refining the types of
+// earlier declarations to their composite
+static void set_type(sema_t *sema, symbol_t *symbol, const type_t *type, ident_t *ident) {
+  if (!symbol->type) {
+    symbol->type = type;
+    return;
+  }
+  const type_t *composite = dcc_type_composite(symbol->type, type);
+  if (!composite) {
+    error(sema, ident, "conflicting types for '%s'", ident->name->str);
+  } else {
+    symbol->type = composite;
+  }
+}
+
+// The basic type spelled by a multiset of keyword specifiers, which C lets
+// appear in any order. Sets *valid to false if they do not spell a type.
+static enum type_tag keyword_type(const int *count, bool *valid) {
+  int total = 0;
+  for (int i = 0; i <= AST_TYPE__COMPLEX; i++) {
+    total += count[i];
+  }
+  int sign = count[AST_TYPE_SIGNED] + count[AST_TYPE_UNSIGNED];
+  bool is_unsigned = count[AST_TYPE_UNSIGNED] > 0;
+  *valid = sign <= 1;
+
+  if (count[AST_TYPE_VOID] || count[AST_TYPE__BOOL] || count[AST_TYPE_FLOAT]) {
+    *valid = total == 1;
+    return count[AST_TYPE_VOID] ? TYPE_VOID : count[AST_TYPE__BOOL] ? TYPE_BOOL : TYPE_FLOAT;
+  } else if (count[AST_TYPE_DOUBLE]) {
+    *valid = total == count[AST_TYPE_DOUBLE] + count[AST_TYPE_LONG]
+      && count[AST_TYPE_DOUBLE] == 1 && count[AST_TYPE_LONG] <= 1;
+    return count[AST_TYPE_LONG] ? TYPE_LDOUBLE : TYPE_DOUBLE;
+  } else if (count[AST_TYPE_CHAR]) {
+    *valid = *valid && total == 1 + sign;
+    return !sign ? TYPE_CHAR : is_unsigned ? TYPE_UCHAR : TYPE_SCHAR;
+  }
+
+  // everything else is an int, perhaps sized and signed
+  int shorts = count[AST_TYPE_SHORT], longs = count[AST_TYPE_LONG];
+  *valid = *valid && total == sign + shorts + longs + count[AST_TYPE_INT]
+    && count[AST_TYPE_INT] <= 1 && shorts + longs <= 2 && (!shorts || shorts + longs == 1);
+  if (shorts) {
+    return is_unsigned ? TYPE_USHORT : TYPE_SHORT;
+  } else if (longs == 2) {
+    return is_unsigned ? TYPE_ULLONG : TYPE_LLONG;
+  } else if (longs == 1) {
+    return is_unsigned ? TYPE_ULONG : TYPE_LONG;
+  }
+  return is_unsigned ? TYPE_UINT : TYPE_INT;
+}
+
+// The type a tag or typedef name stands for, once resolved
+static const type_t* named_type(type_spec_t *spec) {
+  symbol_t *symbol;
+  switch (spec->tag) {
+  case AST_TYPE_STRUCT:
+  case AST_TYPE_UNION:
+    symbol = spec->suspec->ident.symbol;
+    break;
+  case AST_TYPE_ENUM:
+    symbol = spec->espec->ident.symbol;
+    break;
+  default:
+    symbol = spec->ident.symbol;
+    break;
+  }
+  // an unknown type name has already been reported
+  return symbol && symbol->type ? symbol->type : dcc_type_basic(TYPE_INT);
+}
+
+// The type a list of resolved specifiers and qualifiers spells
+static const type_t* specs_type(sema_t *sema, type_spec_vec_t *specs, type_qual_t qual,
+                                srcloc_t loc) {
+  int count[AST_TYPE__COMPLEX + 1] = { 0 };
+  type_spec_t *named = 0;
+  for (size_t i = 0; i < specs->size; i++) {
+    if (specs->data[i]->tag > AST_TYPE__COMPLEX) {
+      named = specs->data[i];
+    } else {
+      count[specs->data[i]->tag]++;
+    }
+  }
+
+  const type_t *type;
+  if (named) {
+    if (specs->size > 1) {
+      error_at(sema, loc, "invalid combination of type specifiers");
+    }
+    type = named_type(named);
+  } else if (count[AST_TYPE__COMPLEX]) {
+    error_at(sema, loc, "_Complex is not supported");
+    type = dcc_type_basic(TYPE_DOUBLE);
+  } else {
+    if (!specs->size) {
+      dcc_diag(sema->diags, DIAG_WARNING, loc, 1, "type specifier missing, defaults to 'int'");
+    }
+    bool valid;
+    type = dcc_type_basic(keyword_type(count, &valid));
+    if (!valid) {
+      error_at(sema, loc, "invalid combination of type specifiers");
+    }
+  }
+  return dcc_type_qualified(type, qual);
+}
+
+// Evaluate an integer constant expression whose names are resolved
+static bool integer_constant(sema_t *sema, exp_t *exp, int64_t *value) {
+  intval_t result;
+  if (!dcc_consteval(sema->eval, exp, &result)) {
+    return false;
+  }
+  *value = result.bits;
+  if (!dcc_type_is_signed(result.type) && *value < 0) {
+    error_at(sema, exp->loc, "integer constant is too large");
+    return false;
+  }
+  return true;
+}
+
+static const type_t* array_type(sema_t *sema, direct_decltor_t *direct, const type_t *elem,
+                                srcloc_t loc) {
+  if (elem->tag == TYPE_FUNCTION) {
+    error_at(sema, loc, "array of functions is not allowed");
+    elem = dcc_type_pointer(elem);
+  } else if (!dcc_type_is_complete(elem)) {
+    char *str = dcc_type_str(elem);
+    error_at(sema, loc, "array has incomplete element type '%s'", str);
+    free(str);
+  }
+
+  int64_t length = ARRAY_LENGTH_UNKNOWN;
+  if (direct->array.exp && integer_constant(sema, direct->array.exp, &length)
+      && length < 0) {
+    error_at(sema, direct->array.exp->loc, "array has negative size");
+    length = ARRAY_LENGTH_UNKNOWN;
+  }
+  return dcc_type_array(elem, length);
+}
+
+static const type_t* function_type(sema_t *sema, direct_decltor_t *direct, const type_t *ret,
+                                   srcloc_t loc) {
+  if (ret->tag == TYPE_ARRAY || ret->tag == TYPE_FUNCTION) {
+    error_at(sema, loc, "function cannot return %s type",
+             ret->tag == TYPE_ARRAY ? "array" : "function");
+    ret = dcc_type_pointer(ret->tag == TYPE_ARRAY ? ret->array.elem : ret);
+  }
+  if (direct->tag == AST_DECLTOR_FUNC_IDENTS || !direct->params) {
+    return dcc_type_function(ret, 0, 0, false, false);
+  }
+
+  // `(void)` is a prototype without parameters
+  param_decl_vec_t *decls = &direct->params->decls;
+  if (decls->size == 1 && decls->data[0]->type == dcc_type_basic(TYPE_VOID)) {
+    return dcc_type_function(ret, 0, 0, direct->params->is_vararg, true);
+  }
+  const type_t **params = dcc_malloc(decls->size * sizeof *params);
+  for (size_t i = 0; i < decls->size; i++) {
+    const type_t *type = decls->data[i]->type;
+    params[i] = type ? type->unqual : dcc_type_basic(TYPE_INT);
+  }
+  const type_t *type = dcc_type_function(ret, params, decls->size,
+                                         direct->params->is_vararg, true);
+  free(params);
+  return type;
+}
+
+// The type `decltor` derives from `type`. Pointers bind tighter than suffixes,
+// and a nested declarator applies last, so `int *(*f)[2]` is a pointer to an
+// array of pointers. Parameter lists must already be resolved.
+static const type_t* decltor_type(sema_t *sema, decltor_t *decltor, const type_t *type,
+                                  srcloc_t loc) {
+  if (!decltor) {
+    return type;
+  }
+  for (size_t i = 0; i < decltor->pointers.size; i++) {
+    type = dcc_type_qualified(dcc_type_pointer(type), decltor->pointers.data[i]);
+  }
+
+  // an abstract declarator may have suffixes without an identifier before them
+  direct_decltor_t *head = 0;
+  if (decltor->directs.size > 0 && (decltor->directs.data[0].tag == AST_DECLTOR_IDENT
+                                    || decltor->directs.data[0].tag == AST_DECLTOR_NESTED)) {
+    head = &decltor->directs.data[0];
+  }
+  for (size_t i = decltor->directs.size; i-- > (head ? 1 : 0);) {
+    direct_decltor_t *direct = &decltor->directs.data[i];
+    if (direct->tag == AST_DECLTOR_ARRAY) {
+      type = array_type(sema, direct, type, loc);
+    } else {
+      type = function_type(sema, direct, type, loc);
+    }
+  }
+  if (head && head->tag == AST_DECLTOR_NESTED) {
+    type = decltor_type(sema, head->nested, type, loc);
+  }
+  return type;
+}
+
+// The length an initializer gives an array declared without one
+////////////////////////////////////////////////////////////////////////////////
+// Declarations
+////////////////////////////////////////////////////////////////////////////////
+
+static void resolve_exp(sema_t *sema, exp_t *exp);
+static void check_assign(sema_t *sema, const type_t *type, exp_t *exp, const char *action);
+static void resolve_type_specs(sema_t *sema, type_spec_vec_t *specs, bool innermost);
+static void resolve_decltor(sema_t *sema, decltor_t *decltor, direct_decltor_t *own);
+
+static void resolve_sunion(sema_t *sema, type_spec_t *spec, bool innermost) {
+  sunion_spec_t *suspec = spec->suspec;
+  bool defining = suspec->decls.size > 0;
+  bool is_union = spec->tag == AST_TYPE_UNION;
+  symbol_t *symbol = declare_tag(sema, is_union ? SYM_UNION : SYM_STRUCT,
+                                 &suspec->ident, innermost || defining);
+  if (!defining) {
+    return;
+  }
+  if (symbol->defined) {
+    error(sema, &suspec->ident, "redefinition of '%s'", suspec->ident.name->str);
+  }
+  symbol->defined = true;
+  symbol->spec = spec;
+
+  // members have no scope of their own, but tags declared among them do
+  member_vec_t members = member_vec_new();
+  ptrmap_t seen = dcc_ptrmap_new();
+  for (size_t i = 0; i < suspec->decls.size; i++) {
+    struct_decl_t *sdecl = &suspec->decls.data[i];
+    resolve_type_specs(sema, &sdecl->squal->specs, false);
+    const type_t *base = specs_type(sema, &sdecl->squal->specs, sdecl->squal->qual,
+                                    sdecl->squal->loc);
+    for (size_t j = 0; j < sdecl->sdecltors.size; j++) {
+      struct_decltor_t *sdecltor = &sdecl->sdecltors.data[j];
+      resolve_decltor(sema, sdecltor->decltor, 0);
+      ident_t *ident = sdecltor->decltor ? dcc_decltor_ident(sdecltor->decltor) : 0;
+      srcloc_t loc = ident ? ident->loc : sdecl->squal->loc;
+      member_t member = { ident ? ident->name : 0,
+                          decltor_type(sema, sdecltor->decltor, base, loc), 0, 0, 0 };
+
+      // a struct may end with an array of unknown length
+      bool is_last = i + 1 == suspec->decls.size && j + 1 == sdecl->sdecltors.size;
+      bool flexible = !is_union && is_last && member.type->tag == TYPE_ARRAY
+        && member.type->array.length == ARRAY_LENGTH_UNKNOWN;
+      if (!dcc_type_is_complete(member.type) && !flexible) {
+        char *str = dcc_type_str(member.type);
+        error_at(sema, loc, "field has incomplete type '%s'", str);
+        free(str);
+        continue;
+      }
+      if (member.name && dcc_ptrmap_put(&seen, member.name, symbol)) {
+        error(sema, ident, "duplicate member '%s'", member.name->str);
+        continue;
+      }
+
+      if (sdecltor->exp) {
+        resolve_exp(sema, sdecltor->exp);
+        int64_t width;
+        if (!dcc_type_is_integer(member.type)) {
+          error_at(sema, loc, "bit-field has non-integral type");
+        } else if (integer_constant(sema, sdecltor->exp, &width)) {
+          if (width < 0 || (uint64_t)width > dcc_type_size(member.type) * 8) {
+            error_at(sema, sdecltor->exp->loc, "invalid bit-field width");
+          } else if (width == 0 && member.name) {
+            error_at(sema, sdecltor->exp->loc, "named bit-field '%s' has zero width",
+                     member.name->str);
+          } else {
+            member.bit_width = width;
+          }
+        }
+      }
+      member_vec_push(&members, member);
+    }
+  }
+
+  record_t *record = symbol->type->record;
+  if (!record->complete) {
+    dcc_record_complete(record, is_union, members.data, members.size);
+  }
+  dcc_ptrmap_free(&seen);
+  member_vec_free(&members);
+}
+
+static void resolve_enum(sema_t *sema, type_spec_t *spec) {
+  enum_spec_t *espec = spec->espec;
+  bool defining = espec->enumtors.size > 0;
+  symbol_t *symbol = declare_tag(sema, SYM_ENUM, &espec->ident, defining);
+  if (!defining) {
+    return;
+  }
+  if (symbol->defined) {
+    error(sema, &espec->ident, "redefinition of '%s'", espec->ident.name->str);
+  }
+  symbol->defined = true;
+  symbol->spec = spec;
+
+  // each enumerator is in scope from the end of its own definition, and without
+  // a value follows the one before it
+  for (size_t i = 0; i < espec->enumtors.size; i++) {
+    enumtor_t *enumtor = espec->enumtors.data[i];
+    ident_t *ident = &enumtor->ident;
+    int64_t value = i > 0 ? espec->enumtors.data[i - 1]->value + 1 : 0;
+    if (enumtor->exp) {
+      resolve_exp(sema, enumtor->exp);
+      integer_constant(sema, enumtor->exp, &value);
+      if (value < INT_MIN || value > INT_MAX) {
+        error_at(sema, enumtor->exp->loc, "enumerator value is not representable in int");
+        value = 0;
+      }
+    } else if (value > INT_MAX) {
+      error(sema, ident, "overflow in enumeration value");
+      value = INT_MIN;
+    }
+    enumtor->value = value;
+
+    int depth = dcc_scope_depth(&sema->names);
+    symbol_t *prior = dcc_scope_lookup(&sema->names, ident->name);
+    if (prior && prior->depth == depth) {
+      ident->symbol = prior;
+      error(sema, ident, "redefinition of '%s'", ident->name->str);
+      continue;
+    }
+    symbol_t *constant = new_symbol(sema, SYM_ENUM_CONST, ident, depth);
+    constant->defined = true;
+    constant->type = dcc_type_basic(TYPE_INT);
+    constant->enumtor = enumtor;
+    dcc_scope_bind(&sema->names, ident->name, constant);
+  }
+  if (!symbol->type->record->complete) {
+    dcc_enum_complete(symbol->type->record);
+  }
+}
+
+// `innermost` is set for a bare `struct S;`, which declares a new tag even if
+// an outer one is visible
+static void resolve_type_spec(sema_t *sema, type_spec_t *spec, bool innermost) {
+  switch (spec->tag) {
+  case AST_TYPE_STRUCT:
+  case AST_TYPE_UNION:
+    resolve_sunion(sema, spec, innermost);
+    break;
+  case AST_TYPE_ENUM:
+    resolve_enum(sema, spec);
+    break;
+  case AST_TYPE_TYPEDEF: {
+    // the parser does not track every name that can hide a typedef
+    symbol_t *symbol = dcc_scope_lookup(&sema->names, spec->ident.name);
+    spec->ident.symbol = symbol;
+    if (!symbol || symbol->tag != SYM_TYPEDEF) {
+      error(sema, &spec->ident, "unknown type name '%s'", spec->ident.name->str);
+      spec->ident.symbol = 0;
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+static void resolve_type_specs(sema_t *sema, type_spec_vec_t *specs, bool innermost) {
+  for (size_t i = 0; i < specs->size; i++) {
+    resolve_type_spec(sema, specs->data[i], innermost);
+  }
+}
+
+// Find the derivation a declarator applies last, which is a suffix of the
+// nested declarator if any, then its pointers, then the declarator's own first
+// suffix; set `array` to it if it is an array, and return whether there is one
+static bool outermost_derivation(decltor_t *decltor, direct_decltor_t **array) {
+  if (!decltor) {
+    return false;
+  }
+  direct_decltor_t *head = 0;
+  if (decltor->directs.size > 0 && (decltor->directs.data[0].tag == AST_DECLTOR_IDENT
+                                    || decltor->directs.data[0].tag == AST_DECLTOR_NESTED)) {
+    head = &decltor->directs.data[0];
+  }
+  if (head && head->tag == AST_DECLTOR_NESTED && outermost_derivation(head->nested, array)) {
+    return true;
+  }
+  size_t first = head ? 1 : 0;
+  if (first < decltor->directs.size) {
+    direct_decltor_t *direct = &decltor->directs.data[first];
+    *array = direct->tag == AST_DECLTOR_ARRAY ? direct : 0;
+    return true;
+  }
+  *array = 0;
+  return decltor->pointers.size > 0;
+}
+
+// Resolve and declare the parameters of a function declarator in the innermost
+// scope, giving each its adjusted type
+static void resolve_params(sema_t *sema, direct_decltor_t *func) {
+  if (func->tag == AST_DECLTOR_FUNC_IDENTS) {
+    int depth = dcc_scope_depth(&sema->names);
+    for (size_t i = 0; func->idents && i < func->idents->size; i++) {
+      ident_t *ident = &func->idents->data[i];
+      symbol_t *prior = dcc_scope_lookup(&sema->names, ident->name);
+      if (prior && prior->depth == depth) {
+        error(sema, ident, "redefinition of parameter '%s'", ident->name->str);
+      }
+      symbol_t *symbol = new_symbol(sema, SYM_OBJECT, ident, depth);
+      symbol->type = dcc_type_basic(TYPE_INT);
+      dcc_scope_bind(&sema->names, ident->name, symbol);
+    }
+    return;
+  }
+
+  for (size_t i = 0; func->params && i < func->params->decls.size; i++) {
+    param_decl_t *param = func->params->decls.data[i];
+    decl_spec_t *specs = param->specifiers;
+    resolve_type_specs(sema, &specs->type_specs, false);
+    resolve_decltor(sema, param->decltor, 0);
+
+    ident_t *ident = param->decltor ? dcc_decltor_ident(param->decltor) : 0;
+    const type_t *type = specs_type(sema, &specs->type_specs, specs->type_qual, specs->loc);
+    type = decltor_type(sema, param->decltor, type, ident ? ident->loc : specs->loc);
+    // parameters of array and function type are adjusted to pointers, which
+    // take the qualifiers within the brackets, as in `int a[restrict]`
+    if (type->tag == TYPE_ARRAY) {
+      direct_decltor_t *array = 0;
+      type_qual_t qual = type->qual;
+      if (outermost_derivation(param->decltor, &array) && array) {
+        qual |= array->array.qualifiers;
+      }
+      type = dcc_type_qualified(dcc_type_pointer(type->array.elem), qual);
+    } else if (type->tag == TYPE_FUNCTION) {
+      type = dcc_type_pointer(type);
+    } else if (type->tag == TYPE_VOID && (ident || func->params->decls.size > 1)) {
+      error_at(sema, ident ? ident->loc : specs->loc,
+               "'void' must be the first and only parameter if specified");
+    }
+    param->type = type;
+
+    symbol_t *symbol = ident ? declare(sema, specs, param->decltor, SYM_OBJECT) : 0;
+    if (symbol) {
+      symbol->type = type;
+    }
+  }
+}
+
+// Resolve the expressions within `decltor` and open a prototype scope for each
+// parameter list, except for `own`, the parameters of a function definition
+static void resolve_decltor(sema_t *sema, decltor_t *decltor, direct_decltor_t *own) {
+  if (!decltor) {
+    return;
+  }
+  for (size_t i = 0; i < decltor->directs.size; i++) {
+    direct_decltor_t *direct = &decltor->directs.data[i];
+    switch (direct->tag) {
+    case AST_DECLTOR_NESTED:
+      resolve_decltor(sema, direct->nested, own);
+      break;
+    case AST_DECLTOR_ARRAY:
+      if (direct->array.exp) {
+        resolve_exp(sema, direct->array.exp);
+      }
+      break;
+    case AST_DECLTOR_FUNC_TYPES:
+      if (direct != own && direct->params) {
+        enter_scope(sema);
+        resolve_params(sema, direct);
+        leave_scope(sema);
+      }
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+static void resolve_type_name(sema_t *sema, type_name_t *tname) {
+  type_squal_t *squal = tname->squal;
+  resolve_type_specs(sema, &squal->specs, false);
+  resolve_decltor(sema, tname->decltor, 0);
+  tname->type = decltor_type(sema, tname->decltor,
+                             specs_type(sema, &squal->specs, squal->qual, squal->loc),
+                             squal->loc);
+}
+
+static void resolve_initializer(sema_t *sema, initializer_t *init);
+
+static void resolve_initializations(sema_t *sema, initialization_vec_t *inits) {
+  for (size_t i = 0; i < inits->size; i++) {
+    initialization_t *initialization = &inits->data[i];
+    for (size_t j = 0; initialization->designators && j < initialization->designators->size; j++) {
+      designator_t *designator = initialization->designators->data[j];
+      if (designator->tag == DESIGNATOR_EXP) {
+        resolve_exp(sema, designator->exp);
+        designator->index = 0;
+        integer_constant(sema, designator->exp, &designator->index);
+      }
+    }
+    resolve_initializer(sema, initialization->initializer);
+  }
+}
+
+static void resolve_initializer(sema_t *sema, initializer_t *init) {
+  if (init->tag == INIT_EXP) {
+    resolve_exp(sema, init->expression);
+  } else {
+    resolve_initializations(sema, init->inits);
+  }
+}
+
+// Lay out `init` for an object of `type`, checking each value it assigns, and
+// return `type`, completed by it if it is an array of unknown length
+static const type_t* check_initializer(sema_t *sema, const type_t *type, initializer_t *init) {
+  bool unbounded = type->tag == TYPE_ARRAY && type->array.length == ARRAY_LENGTH_UNKNOWN;
+  if (!unbounded && !dcc_type_is_complete(type)) {
+    return type; // which is an error of its own
+  }
+
+  int64_t length;
+  init_entry_vec_t entries = dcc_init_layout(type, init, sema->diags, &length);
+  for (size_t i = 0; i < entries.size; i++) {
+    init_entry_t *entry = &entries.data[i];
+    if (dcc_type_is_scalar(entry->type)) {
+      check_assign(sema, entry->type, entry->exp, "initializing");
+    }
+  }
+  init_entry_vec_free(&entries);
+  return unbounded ? dcc_type_qualified(dcc_type_array(type->array.elem, length), type->qual)
+    : type;
+}
+
+static enum symbol_tag decl_symbol_tag(decl_spec_t *specs, decltor_t *decltor) {
+  if (specs->storage & AST_STORAGE_TYPEDEF) {
+    return SYM_TYPEDEF;
+  }
+  return dcc_decltor_func(decltor) ? SYM_FUNCTION : SYM_OBJECT;
+}
+
+static void resolve_decl(sema_t *sema, decl_t *decl) {
+  decl_spec_t *specs = decl->specifiers;
+  resolve_type_specs(sema, &specs->type_specs, decl->init_decltors.size == 0);
+  const type_t *base = specs_type(sema, &specs->type_specs, specs->type_qual, specs->loc);
+
+  // each declarator is in scope from its end, so before its initializer
+  for (size_t i = 0; i < decl->init_decltors.size; i++) {
+    init_decltor_t *init = decl->init_decltors.data[i];
+    resolve_decltor(sema, init->declarator, 0);
+    ident_t *ident = dcc_decltor_ident(init->declarator);
+    const type_t *type = decltor_type(sema, init->declarator, base,
+                                      ident ? ident->loc : specs->loc);
+    enum symbol_tag tag = decl_symbol_tag(specs, init->declarator);
+    symbol_t *symbol = declare(sema, specs, init->declarator, tag);
+    if (symbol) {
+      set_type(sema, symbol, type, ident);
+    }
+    if (init->initializer) {
+      if (symbol && has_linkage(tag, specs->storage, symbol->depth)) {
+        define(sema, symbol, specs, init->declarator);
+      }
+      resolve_initializer(sema, init->initializer);
+      // which completes an array of unknown length
+      const type_t *complete = check_initializer(sema, type, init->initializer);
+      if (complete != type && symbol) {
+        set_type(sema, symbol, complete, ident);
+      }
+      type = complete;
+    }
+
+    if (symbol) {
+      // file scope objects may be completed by a later declaration
+      bool tentative = symbol->depth == 1 || (specs->storage & AST_STORAGE_EXTERN);
+      if (tag == SYM_OBJECT && (!tentative || init->initializer)
+          && !dcc_type_is_complete(type)) {
+        char *str = dcc_type_str(type);
+        error(sema, ident, "variable has incomplete type '%s'", str);
+        free(str);
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Expressions
+////////////////////////////////////////////////////////////////////////////////
+
+static void resolve_ident(sema_t *sema, ident_t *ident) {
+  symbol_t *symbol = dcc_scope_lookup(&sema->names, ident->name);
+  ident->symbol = symbol;
+  if (!symbol) {
+    error(sema, ident, "use of undeclared identifier '%s'", ident->name->str);
+  } else if (symbol->tag == SYM_TYPEDEF) {
+    error(sema, ident, "unexpected type name '%s': expected expression", ident->name->str);
+  }
+}
+
+// Calling an undeclared function declares it, as C89 did
+static void resolve_callee(sema_t *sema, ident_t *ident) {
+  if (dcc_scope_lookup(&sema->names, ident->name)) {
+    resolve_ident(sema, ident);
+    return;
+  }
+
+  dcc_diag(sema->diags, DIAG_WARNING, ident->loc, ident->name->len,
+           "implicit declaration of function '%s'", ident->name->str);
+  symbol_t *symbol = dcc_ptrmap_get(&sema->linked, ident->name);
+  if (symbol && symbol->tag == SYM_FUNCTION) {
+    ident->symbol = symbol;
+  } else {
+    symbol = new_symbol(sema, SYM_FUNCTION, ident, dcc_scope_depth(&sema->names));
+    symbol->type = dcc_type_function(dcc_type_basic(TYPE_INT), 0, 0, false, false);
+    dcc_ptrmap_put(&sema->linked, ident->name, symbol);
+  }
+  dcc_scope_bind(&sema->names, ident->name, symbol);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Expression types
+////////////////////////////////////////////////////////////////////////////////
+
+// Report a diagnostic about the types `a` and, if not null, `b`, which `format`
+// spells with %s
+static void type_diag(sema_t *sema, diag_level_t level, srcloc_t loc, const char *format,
+                      const type_t *a, const type_t *b) {
+  char *x = dcc_type_str(a), *y = b ? dcc_type_str(b) : 0;
+  dcc_diag(sema->diags, level, loc, 1, format, x, y);
+  free(x);
+  free(y);
+}
+
+static bool is_lvalue(const exp_t *exp) {
+  switch (exp->tag) {
+  case EXP_IDENT:
+    // an undeclared identifier has been reported already
+    return !exp->ident.symbol || exp->ident.symbol->tag == SYM_OBJECT;
+  case EXP_DEREFERENCE:
+  case EXP_INDEX:
+  case EXP_ARROW:
+  case EXP_STRING:
+  case EXP_STRUCT:
+    return true;
+  case EXP_DOT:
+    return is_lvalue(exp->child.lhs);
+  default:
+    return false;
+  }
+}
+
+// The type of `exp` as an operand, once it is converted to an rvalue
+static const type_t* value_type(const exp_t *exp) {
+  return dcc_type_decay(exp->type)->unqual;
+}
+
+// Whether `exp` is a null pointer constant: a literal zero, perhaps cast to
+// void *. Zero valued constant expressions of other forms are not recognized.
+static bool is_null_pointer(const exp_t *exp) {
+  if (exp->tag == EXP_CAST && exp->type->tag == TYPE_POINTER
+      && exp->type->base->tag == TYPE_VOID) {
+    exp = exp->cast.value;
+  }
+  return exp->tag == EXP_CONSTANT && exp->constant->tag != CONSTANT_FLOAT
+    && exp->constant->integer == 0;
+}
+
+static void check_scalar(sema_t *sema, exp_t *exp, const char *format) {
+  if (!dcc_type_is_scalar(value_type(exp))) {
+    type_diag(sema, DIAG_ERROR, exp->loc, format, value_type(exp), 0);
+  }
+}
+
+static void check_modifiable(sema_t *sema, exp_t *exp) {
+  const type_t *type = exp->type;
+  if (!is_lvalue(exp) || type->tag == TYPE_ARRAY || type->tag == TYPE_FUNCTION) {
+    error_at(sema, exp->loc, "expression is not assignable");
+  } else if (type->qual & TYPE_QUAL_CONST) {
+    type_diag(sema, DIAG_ERROR, exp->loc,
+              "cannot assign to an object of const-qualified type '%s'", type, 0);
+  }
+}
+
+// Check that `exp` may be assigned to an object of `type` (stdspec.6.5.16.1),
+// as it also is when initializing, passing and returning; `action` says which
+static void check_assign(sema_t *sema, const type_t *type, exp_t *exp, const char *action) {
+  const type_t *to = type->unqual, *from = value_type(exp);
+  const char *format = 0;
+  diag_level_t level = DIAG_WARNING;
+  if (dcc_type_is_arithmetic(to) && dcc_type_is_arithmetic(from)) {
+    return;
+  } else if (to->tag == TYPE_POINTER && from->tag == TYPE_POINTER) {
+    const type_t *a = to->base, *b = from->base;
+    if (a->tag != TYPE_VOID && b->tag != TYPE_VOID
+        && !dcc_type_compatible(a->unqual, b->unqual)) {
+      format = "incompatible pointer types %s '%s' from '%s'";
+    } else if (b->qual & ~a->qual) {
+      format = "%s '%s' from '%s' discards qualifiers";
+    }
+  } else if (to->tag == TYPE_POINTER && dcc_type_is_integer(from)) {
+    if (!is_null_pointer(exp)) {
+      format = "incompatible integer to pointer conversion %s '%s' from '%s'";
+    }
+  } else if (to->tag == TYPE_BOOL && from->tag == TYPE_POINTER) {
+    return;
+  } else if (dcc_type_is_integer(to) && from->tag == TYPE_POINTER) {
+    format = "incompatible pointer to integer conversion %s '%s' from '%s'";
+  } else if (!dcc_type_compatible(to, from)) {
+    format = "%s '%s' from incompatible type '%s'";
+    level = DIAG_ERROR;
+  }
+
+  if (format) {
+    char *x = dcc_type_str(type), *y = dcc_type_str(from);
+    dcc_diag(sema->diags, level, exp->loc, 1, format, action, x, y);
+    free(x);
+    free(y);
+  }
+}
+
+static void check_sizeof(sema_t *sema, exp_t *exp, const type_t *type) {
+  if (type->tag == TYPE_FUNCTION) {
+    error_at(sema, exp->loc, "invalid application of 'sizeof' to a function type");
+  } else if (!dcc_type_is_complete(type)) {
+    type_diag(sema, DIAG_ERROR, exp->loc,
+              "invalid application of 'sizeof' to an incomplete type '%s'", type, 0);
+  }
+}
+
+// Pointer arithmetic needs the size of what is pointed to, where void and
+// functions count as one byte, as in GNU C
+static const type_t* check_pointer_arith(sema_t *sema, srcloc_t loc, const type_t *pointer) {
+  const type_t *base = pointer->base;
+  if (base->tag != TYPE_VOID && base->tag != TYPE_FUNCTION && !dcc_type_is_complete(base)) {
+    type_diag(sema, DIAG_ERROR, loc, "arithmetic on a pointer to an incomplete type '%s'",
+              base, 0);
+  }
+  return pointer;
+}
+
+static const type_t* check_comparison(sema_t *sema, enum exp_tag op, exp_t *lexp,
+                                      exp_t *rexp, srcloc_t loc) {
+  const type_t *lhs = value_type(lexp), *rhs = value_type(rexp);
+  bool equality = op == EXP_EQUAL || op == EXP_NOTEQUAL;
+  if (lhs->tag == TYPE_POINTER && rhs->tag == TYPE_POINTER) {
+    const type_t *a = lhs->base->unqual, *b = rhs->base->unqual;
+    if (!dcc_type_compatible(a, b) && !(equality && (a->tag == TYPE_VOID
+                                                     || b->tag == TYPE_VOID))) {
+      type_diag(sema, DIAG_WARNING, loc, "comparison of distinct pointer types ('%s' and '%s')",
+                lhs, rhs);
+    }
+  } else if ((lhs->tag == TYPE_POINTER && dcc_type_is_integer(rhs))
+             || (dcc_type_is_integer(lhs) && rhs->tag == TYPE_POINTER)) {
+    if (!equality || !is_null_pointer(lhs->tag == TYPE_POINTER ? rexp : lexp)) {
+      type_diag(sema, DIAG_WARNING, loc, "comparison between pointer and integer ('%s' and '%s')",
+                lhs, rhs);
+    }
+  } else if (!dcc_type_is_arithmetic(lhs) || !dcc_type_is_arithmetic(rhs)) {
+    type_diag(sema, DIAG_ERROR, loc, "invalid operands to binary expression ('%s' and '%s')",
+              lhs, rhs);
+  }
+  return dcc_type_basic(TYPE_INT);
+}
+
+// The type of `lexp op rexp`, which compound assignments share
+static const type_t* check_binary(sema_t *sema, enum exp_tag op, exp_t *lexp, exp_t *rexp,
+                                  srcloc_t loc) {
+  const type_t *lhs = value_type(lexp), *rhs = value_type(rexp);
+  bool arithmetic = dcc_type_is_arithmetic(lhs) && dcc_type_is_arithmetic(rhs);
+  bool integer = dcc_type_is_integer(lhs) && dcc_type_is_integer(rhs);
+  switch (op) {
+  case EXP_MULTIPLY:
+  case EXP_DIVIDE:
+    if (arithmetic) {
+      return dcc_type_common(lhs, rhs);
+    }
+    break;
+  case EXP_MODULO:
+  case EXP_BITAND:
+  case EXP_BITXOR:
+  case EXP_BITOR:
+    if (integer) {
+      return dcc_type_common(lhs, rhs);
+    }
+    break;
+  case EXP_SHIFTLEFT:
+  case EXP_SHIFTRIGHT:
+    if (integer) {
+      return dcc_type_promote(lhs);
+    }
+    break;
+  case EXP_ADD:
+    if (arithmetic) {
+      return dcc_type_common(lhs, rhs);
+    } else if (lhs->tag == TYPE_POINTER && dcc_type_is_integer(rhs)) {
+      return check_pointer_arith(sema, loc, lhs);
+    } else if (dcc_type_is_integer(lhs) && rhs->tag == TYPE_POINTER) {
+      return check_pointer_arith(sema, loc, rhs);
+    }
+    break;
+  case EXP_SUBTRACT:
+    if (arithmetic) {
+      return dcc_type_common(lhs, rhs);
+    } else if (lhs->tag == TYPE_POINTER && dcc_type_is_integer(rhs)) {
+      return check_pointer_arith(sema, loc, lhs);
+    } else if (lhs->tag == TYPE_POINTER && rhs->tag == TYPE_POINTER
+               && dcc_type_compatible(lhs->base->unqual, rhs->base->unqual)) {
+      check_pointer_arith(sema, loc, lhs);
+      return dcc_type_basic(TYPE_LONG); // ptrdiff_t
+    }
+    break;
+  case EXP_LESS:
+  case EXP_MORE:
+  case EXP_LESSEQ:
+  case EXP_MOREEQ:
+  case EXP_EQUAL:
+  case EXP_NOTEQUAL:
+    return check_comparison(sema, op, lexp, rexp, loc);
+  default:
+    dcc_ice("not a binary operator: %d", op);
+  }
+  type_diag(sema, DIAG_ERROR, loc, "invalid operands to binary expression ('%s' and '%s')",
+            lhs, rhs);
+  return dcc_type_basic(TYPE_INT);
+}
+
+static const type_t* check_assignment(sema_t *sema, exp_t *exp) {
+  exp_t *lhs = exp->assignment.lhs, *rhs = exp->assignment.rhs;
+  enum exp_tag op = exp->assignment.operator;
+  check_modifiable(sema, lhs);
+  if (op == EXP_EQUAL) {
+    check_assign(sema, lhs->type, rhs, "assigning to");
+  } else if (check_binary(sema, op, lhs, rhs, exp->loc)->tag == TYPE_POINTER
+             && value_type(lhs)->tag != TYPE_POINTER) {
+    type_diag(sema, DIAG_ERROR, exp->loc,
+              "invalid operands to binary expression ('%s' and '%s')",
+              value_type(lhs), value_type(rhs));
+  }
+  return lhs->type->unqual;
+}
+
+static const type_t* check_ternary(sema_t *sema, exp_t *exp) {
+  exp_t *then = exp->ternary.true_exp, *otherwise = exp->ternary.false_exp;
+  const type_t *a = value_type(then), *b = value_type(otherwise);
+  check_scalar(sema, exp->ternary.cond,
+               "used type '%s' where arithmetic or pointer type is required");
+  if (dcc_type_is_arithmetic(a) && dcc_type_is_arithmetic(b)) {
+    return dcc_type_common(a, b);
+  } else if (a == b) {
+    return a;
+  } else if (a->tag == TYPE_POINTER && b->tag == TYPE_POINTER) {
+    // the result points to a type qualified by both operands' qualifiers
+    type_qual_t qual = a->base->qual | b->base->qual;
+    if (is_null_pointer(otherwise) || is_null_pointer(then)) {
+      return is_null_pointer(otherwise) ? a : b;
+    } else if (a->base->tag == TYPE_VOID || b->base->tag == TYPE_VOID) {
+      return dcc_type_pointer(dcc_type_qualified(dcc_type_basic(TYPE_VOID), qual));
+    }
+    const type_t *composite = dcc_type_composite(a->base->unqual, b->base->unqual);
+    if (composite) {
+      return dcc_type_pointer(dcc_type_qualified(composite, qual));
+    }
+    type_diag(sema, DIAG_WARNING, exp->loc, "pointer type mismatch ('%s' and '%s')", a, b);
+    return a;
+  } else if ((a->tag == TYPE_POINTER && dcc_type_is_integer(b))
+             || (dcc_type_is_integer(a) && b->tag == TYPE_POINTER)) {
+    if (!is_null_pointer(a->tag == TYPE_POINTER ? otherwise : then)) {
+      type_diag(sema, DIAG_WARNING, exp->loc,
+                "pointer/integer type mismatch in conditional expression ('%s' and '%s')",
+                a, b);
+    }
+    return a->tag == TYPE_POINTER ? a : b;
+  }
+  type_diag(sema, DIAG_ERROR, exp->loc, "incompatible operand types ('%s' and '%s')", a, b);
+  return dcc_type_basic(TYPE_INT);
+}
+
+static const type_t* check_member(sema_t *sema, exp_t *exp) {
+  const type_t *type = exp->child.lhs->type;
+  if (exp->tag == EXP_ARROW) {
+    type = value_type(exp->child.lhs);
+    if (type->tag != TYPE_POINTER) {
+      type_diag(sema, DIAG_ERROR, exp->loc, "member reference type '%s' is not a pointer",
+                type, 0);
+      return dcc_type_basic(TYPE_INT);
+    }
+    type = type->base;
+  }
+
+  if (type->tag != TYPE_STRUCT && type->tag != TYPE_UNION) {
+    type_diag(sema, DIAG_ERROR, exp->loc,
+              "member reference base type '%s' is not a structure or union", type, 0);
+    return dcc_type_basic(TYPE_INT);
+  } else if (!dcc_type_is_complete(type)) {
+    type_diag(sema, DIAG_ERROR, exp->loc, "incomplete definition of type '%s'", type, 0);
+    return dcc_type_basic(TYPE_INT);
+  }
+  ident_t *name = &exp->child.name;
+  const member_t *member = dcc_record_member(type->record, name->name);
+  if (!member) {
+    char *str = dcc_type_str(type);
+    error(sema, name, "no member named '%s' in '%s'", name->name->str, str);
+    free(str);
+    return dcc_type_basic(TYPE_INT);
+  }
+  return dcc_type_qualified(member->type, type->qual);
+}
+
+// long double is computed as a double, which is not how the ABI passes or
+// returns it, so it may not cross a call
+static void check_boundary(sema_t *sema, srcloc_t loc, const type_t *type, const char *as) {
+  if (type->unqual->tag == TYPE_LDOUBLE) {
+    error_at(sema, loc, "long double is not supported as %s", as);
+  }
+}
+
+static const type_t* check_call(sema_t *sema, exp_t *exp) {
+  const type_t *callee = value_type(exp->call.lhs);
+  if (callee->tag != TYPE_POINTER || callee->base->tag != TYPE_FUNCTION) {
+    type_diag(sema, DIAG_ERROR, exp->loc,
+              "called object type '%s' is not a function or function pointer", callee, 0);
+    return dcc_type_basic(TYPE_INT);
+  }
+
+  const type_t *func = callee->base;
+  exp_vec_t *args = exp->call.args;
+  // arguments to unprototyped and variadic functions are promoted instead
+  if (func->func.is_prototype) {
+    size_t count = func->func.count;
+    if (args->size < count || (args->size > count && !func->func.is_vararg)) {
+      error_at(sema, exp->loc, "too %s arguments to function call, expected %zu, have %zu",
+               args->size < count ? "few" : "many", count, args->size);
+    }
+    for (size_t i = 0; i < count && i < args->size; i++) {
+      check_assign(sema, func->func.params[i], args->data[i], "passing to parameter of type");
+    }
+  }
+  for (size_t i = 0; i < args->size; i++) {
+    const type_t *type = dcc_type_argument(func, i, value_type(args->data[i]));
+    check_boundary(sema, args->data[i]->loc, type, "an argument");
+  }
+  check_boundary(sema, exp->loc, func->func.ret, "a return type");
+  return func->func.ret->unqual;
+}
+
+// A va_list is an array of the struct <stdarg.h> names __va_list_tag, and so
+// a pointer to it as an operand
+static void check_va_list(sema_t *sema, exp_t *exp) {
+  const type_t *type = value_type(exp);
+  if (type->tag != TYPE_POINTER || type->base->tag != TYPE_STRUCT
+      || !type->base->record->tag || strcmp(type->base->record->tag->name->str, "__va_list_tag")) {
+    type_diag(sema, DIAG_ERROR, exp->loc, "operand of type '%s' is not a va_list", exp->type, 0);
+  }
+}
+
+static const type_t* check_builtin(sema_t *sema, exp_t *exp) {
+  if (exp->tag == EXP_VA_END) {
+    check_va_list(sema, exp->unary);
+    return dcc_type_basic(TYPE_VOID);
+  } else if (exp->tag != EXP_VA_ARG) {
+    check_va_list(sema, exp->binary.lhs);
+    if (exp->tag == EXP_VA_COPY) {
+      check_va_list(sema, exp->binary.rhs);
+    } else if (!sema->is_vararg) {
+      error_at(sema, exp->loc, "'va_start' used in function with fixed arguments");
+    }
+    return dcc_type_basic(TYPE_VOID);
+  }
+
+  check_va_list(sema, exp->cast.value);
+  const type_t *type = exp->cast.type->type;
+  if (!dcc_type_is_complete(type) || type->tag == TYPE_ARRAY || type->tag == TYPE_FUNCTION) {
+    type_diag(sema, DIAG_ERROR, exp->loc, "second argument to 'va_arg' is of incomplete or "
+              "array type '%s'", type, 0);
+    return dcc_type_basic(TYPE_INT);
+  }
+  check_boundary(sema, exp->loc, type, "an argument");
+  return type->unqual;
+}
+
+// The type of `exp`, whose operands are typed already
+static const type_t* check_exp(sema_t *sema, exp_t *exp) {
+  const type_t *type;
+  switch (exp->tag) {
+  case EXP_IDENT: {
+    symbol_t *symbol = exp->ident.symbol;
+    if (symbol && symbol->tag != SYM_TYPEDEF && symbol->type) {
+      return symbol->type;
+    }
+    return dcc_type_basic(TYPE_INT);
+  }
+  case EXP_STRING: {
+    size_t size;
+    if (dcc_strlit_prefix(exp->string) > LITERAL_UTF8) {
+      error_at(sema, exp->loc, "wide string literals are not supported");
+    }
+    dcc_strlit_bytes(exp->string, &size);
+    return dcc_type_array(dcc_type_basic(TYPE_CHAR), size + 1);
+  }
+  case EXP_CONSTANT:
+    return dcc_constant_type(exp->constant);
+  case EXP_UNKNOWN:
+    return dcc_type_basic(TYPE_INT);
+  case EXP_SIZEOFEXP:
+    check_sizeof(sema, exp, exp->unary->type);
+    return dcc_type_basic(TYPE_ULONG); // size_t
+  case EXP_SIZEOFTYPE:
+    check_sizeof(sema, exp, exp->cast.type->type);
+    return dcc_type_basic(TYPE_ULONG);
+  case EXP_CAST:
+    type = exp->cast.type->type;
+    if (type->tag != TYPE_VOID && !dcc_type_is_scalar(type)) {
+      type_diag(sema, DIAG_ERROR, exp->loc,
+                "used type '%s' where arithmetic or pointer type is required", type, 0);
+      return dcc_type_basic(TYPE_INT);
+    } else if (type->tag != TYPE_VOID) {
+      check_scalar(sema, exp->cast.value,
+                   "operand of type '%s' where arithmetic or pointer type is required");
+    }
+    return type->unqual;
+  case EXP_STRUCT:
+    return exp->struct_init.tname->type;
+  case EXP_ADDRESSOF:
+    type = exp->unary->type;
+    if (!is_lvalue(exp->unary) && type->tag != TYPE_FUNCTION) {
+      type_diag(sema, DIAG_ERROR, exp->loc,
+                "cannot take the address of an rvalue of type '%s'", type, 0);
+    }
+    return dcc_type_pointer(type);
+  case EXP_DEREFERENCE:
+    type = value_type(exp->unary);
+    if (type->tag != TYPE_POINTER) {
+      type_diag(sema, DIAG_ERROR, exp->loc, "indirection requires pointer operand ('%s' invalid)",
+                type, 0);
+      return dcc_type_basic(TYPE_INT);
+    }
+    return type->base;
+  case EXP_NEGATE:
+  case EXP_BITNOT:
+    type = value_type(exp->unary);
+    if (exp->tag == EXP_NEGATE ? !dcc_type_is_arithmetic(type) : !dcc_type_is_integer(type)) {
+      type_diag(sema, DIAG_ERROR, exp->loc, "invalid argument type '%s' to unary expression",
+                type, 0);
+      return dcc_type_basic(TYPE_INT);
+    }
+    return dcc_type_promote(type);
+  case EXP_LOGICNOT:
+    check_scalar(sema, exp->unary, "invalid argument type '%s' to unary expression");
+    return dcc_type_basic(TYPE_INT);
+  case EXP_PREINCREMENT:
+  case EXP_PREDECREMENT:
+  case EXP_POSTINCREMENT:
+  case EXP_POSTDECREMENT:
+    check_modifiable(sema, exp->unary);
+    type = value_type(exp->unary);
+    if (type->tag == TYPE_POINTER) {
+      check_pointer_arith(sema, exp->loc, type);
+    } else if (!dcc_type_is_arithmetic(type)) {
+      bool increment = exp->tag == EXP_PREINCREMENT || exp->tag == EXP_POSTINCREMENT;
+      type_diag(sema, DIAG_ERROR, exp->loc, increment ? "cannot increment value of type '%s'"
+                : "cannot decrement value of type '%s'", type, 0);
+    }
+    return type;
+  case EXP_INDEX: {
+    const type_t *lhs = value_type(exp->binary.lhs), *rhs = value_type(exp->binary.rhs);
+    if (rhs->tag == TYPE_POINTER) {
+      const type_t *swap = lhs;
+      lhs = rhs;
+      rhs = swap;
+    }
+    if (lhs->tag != TYPE_POINTER) {
+      error_at(sema, exp->loc, "subscripted value is not an array or pointer");
+      return dcc_type_basic(TYPE_INT);
+    } else if (!dcc_type_is_integer(rhs)) {
+      error_at(sema, exp->loc, "array subscript is not an integer");
+    }
+    check_pointer_arith(sema, exp->loc, lhs);
+    return lhs->base;
+  }
+  case EXP_CALL:
+    return check_call(sema, exp);
+  case EXP_VA_START:
+  case EXP_VA_ARG:
+  case EXP_VA_COPY:
+  case EXP_VA_END:
+    return check_builtin(sema, exp);
+  case EXP_DOT:
+  case EXP_ARROW:
+    return check_member(sema, exp);
+  case EXP_ASSIGN:
+    return check_assignment(sema, exp);
+  case EXP_TERNARY:
+    return check_ternary(sema, exp);
+  case EXP_LIST:
+    return value_type(exp->list.data[exp->list.size - 1]);
+  case EXP_LOGICAND:
+  case EXP_LOGICOR:
+    check_scalar(sema, exp->binary.lhs, "invalid operand type '%s' to logical expression");
+    check_scalar(sema, exp->binary.rhs, "invalid operand type '%s' to logical expression");
+    return dcc_type_basic(TYPE_INT);
+  default:
+    return check_binary(sema, exp->tag, exp->binary.lhs, exp->binary.rhs, exp->loc);
+  }
+}
+
+static void resolve_exp(sema_t *sema, exp_t *exp) {
+  switch (exp->tag) {
+  case EXP_IDENT:
+    resolve_ident(sema, &exp->ident);
+    break;
+  case EXP_STRING:
+  case EXP_CONSTANT:
+  case EXP_UNKNOWN:
+    break;
+  case EXP_ADDRESSOF:
+  case EXP_DEREFERENCE:
+  case EXP_BITNOT:
+  case EXP_LOGICNOT:
+  case EXP_NEGATE:
+  case EXP_PREINCREMENT:
+  case EXP_PREDECREMENT:
+  case EXP_POSTINCREMENT:
+  case EXP_POSTDECREMENT:
+  case EXP_SIZEOFEXP:
+  case EXP_VA_END:
+    resolve_exp(sema, exp->unary);
+    break;
+  case EXP_SIZEOFTYPE:
+    resolve_type_name(sema, exp->cast.type);
+    break;
+  case EXP_CAST:
+  case EXP_VA_ARG:
+    resolve_type_name(sema, exp->cast.type);
+    resolve_exp(sema, exp->cast.value);
+    break;
+  case EXP_TERNARY:
+    resolve_exp(sema, exp->ternary.cond);
+    resolve_exp(sema, exp->ternary.true_exp);
+    resolve_exp(sema, exp->ternary.false_exp);
+    break;
+  case EXP_ASSIGN:
+    resolve_exp(sema, exp->assignment.lhs);
+    resolve_exp(sema, exp->assignment.rhs);
+    break;
+  case EXP_LIST:
+    for (size_t i = 0; i < exp->list.size; i++) {
+      resolve_exp(sema, exp->list.data[i]);
+    }
+    break;
+  case EXP_DOT:
+  case EXP_ARROW:
+    // the member is looked up once the type of lhs is known
+    resolve_exp(sema, exp->child.lhs);
+    break;
+  case EXP_CALL:
+    if (exp->call.lhs->tag == EXP_IDENT) {
+      resolve_callee(sema, &exp->call.lhs->ident);
+      exp->call.lhs->type = check_exp(sema, exp->call.lhs);
+    } else {
+      resolve_exp(sema, exp->call.lhs);
+    }
+    for (size_t i = 0; i < exp->call.args->size; i++) {
+      resolve_exp(sema, exp->call.args->data[i]);
+    }
+    break;
+  case EXP_STRUCT: {
+    type_name_t *tname = exp->struct_init.tname;
+    resolve_type_name(sema, tname);
+    resolve_initializations(sema, exp->struct_init.inits);
+    initializer_t init = { .tag = INIT_LIST, .inits = exp->struct_init.inits };
+    tname->type = check_initializer(sema, tname->type, &init);
+    break;
+  }
+  default:
+    // every remaining tag is a binary operator
+    resolve_exp(sema, exp->binary.lhs);
+    resolve_exp(sema, exp->binary.rhs);
+    break;
+  }
+  exp->type = check_exp(sema, exp);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Statements
+////////////////////////////////////////////////////////////////////////////////
+
+static void resolve_stmt(sema_t *sema, stmt_t *stmt);
+
+static void resolve_items(sema_t *sema, block_item_vec_t *items) {
+  for (size_t i = 0; i < items->size; i++) {
+    block_item_t *item = items->data[i];
+    if (item->tag == AST_DECLARATION) {
+      resolve_decl(sema, item->declaration);
+    } else {
+      resolve_stmt(sema, item->statement);
+    }
+  }
+}
+
+static void stmt_error(sema_t *sema, stmt_t *stmt, const char *message) {
+  dcc_diag(sema->diags, DIAG_ERROR, stmt->loc, 1, "%s", message);
+}
+
+#define SCALAR_CONDITION "statement requires expression of scalar type ('%s' invalid)"
+
+// A case label's value is converted to the promoted type of its switch
+static void case_value(sema_t *sema, stmt_t *stmt) {
+  intval_t value;
+  exp_t *exp = stmt->stmt_case.exp;
+  if (!dcc_consteval(sema->eval, exp, &value)) {
+    return;
+  }
+  if (sema->switch_state && sema->switch_state->type) {
+    value = dcc_intval_convert(value, sema->switch_state->type);
+    case_label_vec_t *cases = &sema->switch_state->cases;
+    case_label_t label = { value.bits, cases->size, exp->loc };
+    case_label_vec_push(cases, label);
+  }
+  stmt->stmt_case.value = value.bits;
+}
+
+// Orders cases by value, and those with the same value as they appear
+static int compare_cases(const void *a, const void *b) {
+  const case_label_t *x = a, *y = b;
+  if (x->value != y->value) {
+    return x->value < y->value ? -1 : 1;
+  }
+  return x->order < y->order ? -1 : x->order > y->order;
+}
+
+// stdspec.6.8.4.2 No two case labels of a switch may have the same value
+static void check_cases(sema_t *sema, switch_state_t *state) {
+  case_label_vec_t *cases = &state->cases;
+  qsort(cases->data, cases->size, sizeof(case_label_t), compare_cases);
+  for (size_t i = 1; i < cases->size; i++) {
+    uint64_t value = cases->data[i].value;
+    if (value == cases->data[i - 1].value) {
+      char str[24];
+      sprintf(str, dcc_type_is_signed(state->type) ? "%" PRId64 : "%" PRIu64, value);
+      dcc_diag(sema->diags, DIAG_ERROR, cases->data[i].loc, 1, "duplicate case value '%s'", str);
+    }
+  }
+}
+
+static void check_return(sema_t *sema, stmt_t *stmt) {
+  if (!sema->ret) {
+    return;
+  } else if (!stmt->exp) {
+    if (sema->ret->tag != TYPE_VOID) {
+      dcc_diag(sema->diags, DIAG_WARNING, stmt->loc, 1,
+               "non-void function should return a value");
+    }
+  } else if (sema->ret->tag == TYPE_VOID) {
+    if (value_type(stmt->exp)->tag != TYPE_VOID) {
+      error_at(sema, stmt->exp->loc, "void function should not return a value");
+    }
+  } else {
+    check_assign(sema, sema->ret, stmt->exp, "returning");
+  }
+}
+
+static void resolve_stmt(sema_t *sema, stmt_t *stmt) {
+  switch (stmt->tag) {
+  case STMT_CASE:
+    if (!sema->switches) {
+      stmt_error(sema, stmt, "'case' statement not in switch statement");
+    }
+    resolve_exp(sema, stmt->stmt_case.exp);
+    case_value(sema, stmt);
+    resolve_stmt(sema, stmt->stmt_case.stmt);
+    break;
+  case STMT_DEFAULT:
+    if (!sema->switches) {
+      stmt_error(sema, stmt, "'default' statement not in switch statement");
+    } else if (sema->switch_state->has_default) {
+      stmt_error(sema, stmt, "multiple default labels in one switch");
+    } else {
+      sema->switch_state->has_default = true;
+    }
+    resolve_stmt(sema, stmt->stmt);
+    break;
+  case STMT_LABEL: {
+    ident_t *ident = &stmt->stmt_label.ident;
+    symbol_t *symbol = dcc_scope_lookup(&sema->labels, ident->name);
+    if (symbol) {
+      ident->symbol = symbol;
+      error(sema, ident, "redefinition of label '%s'", ident->name->str);
+    } else {
+      symbol = new_symbol(sema, SYM_LABEL, ident, dcc_scope_depth(&sema->labels));
+      symbol->defined = true;
+      symbol->stmt = stmt;
+      dcc_scope_bind(&sema->labels, ident->name, symbol);
+    }
+    resolve_stmt(sema, stmt->stmt_label.stmt);
+    break;
+  }
+  case STMT_COMPOUND:
+    enter_scope(sema);
+    resolve_items(sema, &stmt->stmt_compound);
+    leave_scope(sema);
+    break;
+  case STMT_EXP:
+    if (stmt->exp) {
+      resolve_exp(sema, stmt->exp);
+    }
+    break;
+  case STMT_RETURN:
+    if (stmt->exp) {
+      resolve_exp(sema, stmt->exp);
+    }
+    check_return(sema, stmt);
+    break;
+  case STMT_IF:
+    resolve_exp(sema, stmt->stmt_select.exp);
+    check_scalar(sema, stmt->stmt_select.exp, SCALAR_CONDITION);
+    resolve_stmt(sema, stmt->stmt_select.primary);
+    if (stmt->stmt_select.secondary) {
+      resolve_stmt(sema, stmt->stmt_select.secondary);
+    }
+    break;
+  case STMT_SWITCH: {
+    exp_t *exp = stmt->stmt_select.exp;
+    resolve_exp(sema, exp);
+    switch_state_t *outer = sema->switch_state, state;
+    state.type = dcc_type_promote(value_type(exp));
+    state.cases = case_label_vec_new();
+    state.has_default = false;
+    if (!dcc_type_is_integer(state.type)) {
+      type_diag(sema, DIAG_ERROR, exp->loc,
+                "statement requires expression of integer type ('%s' invalid)",
+                state.type, 0);
+      state.type = 0;
+    }
+    sema->switch_state = &state;
+    sema->switches++;
+    resolve_stmt(sema, stmt->stmt_select.primary);
+    sema->switches--;
+    sema->switch_state = outer;
+    check_cases(sema, &state);
+    case_label_vec_free(&state.cases);
+    break;
+  }
+  case STMT_DO:
+  case STMT_WHILE:
+    resolve_exp(sema, stmt->stmt_whiledo.exp);
+    check_scalar(sema, stmt->stmt_whiledo.exp, SCALAR_CONDITION);
+    sema->loops++;
+    resolve_stmt(sema, stmt->stmt_whiledo.stmt);
+    sema->loops--;
+    break;
+  case STMT_FOR:
+    enter_scope(sema);
+    if (stmt->stmt_for.decl) {
+      resolve_decl(sema, stmt->stmt_for.decl);
+    }
+    exp_t *exps[] = { stmt->stmt_for.exp1, stmt->stmt_for.exp2, stmt->stmt_for.exp3 };
+    for (int i = 0; i < 3; i++) {
+      if (exps[i]) {
+        resolve_exp(sema, exps[i]);
+      }
+    }
+    if (exps[1]) {
+      check_scalar(sema, exps[1], SCALAR_CONDITION);
+    }
+    sema->loops++;
+    resolve_stmt(sema, stmt->stmt_for.stmt);
+    sema->loops--;
+    leave_scope(sema);
+    break;
+  case STMT_GOTO:
+    // labels may follow their gotos
+    stmt_vec_push(&sema->gotos, stmt);
+    break;
+  case STMT_CONTINUE:
+    if (!sema->loops) {
+      stmt_error(sema, stmt, "'continue' statement not in loop statement");
+    }
+    break;
+  case STMT_BREAK:
+    if (!sema->loops && !sema->switches) {
+      stmt_error(sema, stmt, "'break' statement not in loop or switch statement");
+    }
+    break;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// External definitions
+////////////////////////////////////////////////////////////////////////////////
+
+static void resolve_function(sema_t *sema, func_def_t *func) {
+  direct_decltor_t *params = dcc_decltor_func(func->declarator);
+  if (!params) {
+    error(sema, dcc_decltor_ident(func->declarator), "expected a function declarator");
+    return;
+  }
+
+  decl_spec_t *specs = func->specifiers;
+  resolve_type_specs(sema, &specs->type_specs, false);
+  const type_t *ret = specs_type(sema, &specs->type_specs, specs->type_qual, specs->loc);
+  resolve_decltor(sema, func->declarator, params);
+  symbol_t *symbol = declare(sema, specs, func->declarator, SYM_FUNCTION);
+  define(sema, symbol, specs, func->declarator);
+
+  // parameters share the outermost block scope of the body, and the function's
+  // type is known once they are resolved
+  enter_scope(sema);
+  dcc_scope_enter(&sema->labels);
+  resolve_params(sema, params);
+  ident_t *ident = dcc_decltor_ident(func->declarator);
+  const type_t *type = decltor_type(sema, func->declarator, ret, ident->loc);
+  if (symbol) {
+    set_type(sema, symbol, type, ident);
+  }
+  if (type->tag == TYPE_FUNCTION) {
+    check_boundary(sema, ident->loc, type->func.ret, "a return type");
+    for (size_t i = 0; i < type->func.count; i++) {
+      check_boundary(sema, ident->loc, type->func.params[i], "a parameter type");
+    }
+  }
+  sema->ret = type->tag == TYPE_FUNCTION ? type->func.ret : 0;
+  sema->is_vararg = type->tag == TYPE_FUNCTION && type->func.is_vararg;
+  resolve_items(sema, &func->compound->stmt_compound);
+  sema->ret = 0;
+  sema->is_vararg = false;
+
+  for (size_t i = 0; i < sema->gotos.size; i++) {
+    ident_t *label = &sema->gotos.data[i]->label;
+    label->symbol = dcc_scope_lookup(&sema->labels, label->name);
+    if (!label->symbol) {
+      error(sema, label, "use of undeclared label '%s'", label->name->str);
+    }
+  }
+  sema->gotos.size = 0;
+  dcc_scope_leave(&sema->labels);
+  leave_scope(sema);
+}
+
+void dcc_sema(sema_t *sema, external_decl_vec_t *unit) {
+  enter_scope(sema);
+  for (size_t i = 0; i < unit->size; i++) {
+    external_decl_t *decl = unit->data[i];
+    if (decl->tag == AST_EXT_FUNCTION) {
+      resolve_function(sema, decl->function);
+    } else {
+      resolve_decl(sema, decl->declaration);
+    }
+  }
+  leave_scope(sema);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Globals
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  sema_global_func_t visit;
+  void *ctx;
+} globals_t;
+
+static void global_decl(globals_t *globals, decl_t *decl, bool is_file_scope) {
+  storage_spec_t storage = decl->specifiers->storage;
+  if ((storage & AST_STORAGE_TYPEDEF)
+      || (!is_file_scope && !(storage & (AST_STORAGE_STATIC | AST_STORAGE_EXTERN)))) {
+    return;
+  }
+  for (size_t i = 0; i < decl->init_decltors.size; i++) {
+    init_decltor_t *init_decltor = decl->init_decltors.data[i];
+    ident_t *ident = dcc_decltor_ident(init_decltor->declarator);
+    if (ident && ident->symbol
+        && (ident->symbol->tag == SYM_OBJECT || ident->symbol->tag == SYM_FUNCTION)) {
+      globals->visit(globals->ctx, ident->symbol, decl->specifiers, init_decltor->initializer,
+                     0, is_file_scope);
+    }
+  }
+}
+
+// Find the block scope statics and externs in a function body
+static void global_stmt(globals_t *globals, stmt_t *stmt) {
+  switch (stmt->tag) {
+  case STMT_CASE:
+    global_stmt(globals, stmt->stmt_case.stmt);
+    break;
+  case STMT_DEFAULT:
+    global_stmt(globals, stmt->stmt);
+    break;
+  case STMT_LABEL:
+    global_stmt(globals, stmt->stmt_label.stmt);
+    break;
+  case STMT_COMPOUND:
+    for (size_t i = 0; i < stmt->stmt_compound.size; i++) {
+      block_item_t *item = stmt->stmt_compound.data[i];
+      if (item->tag == AST_DECLARATION) {
+        global_decl(globals, item->declaration, false);
+      } else {
+        global_stmt(globals, item->statement);
+      }
+    }
+    break;
+  case STMT_IF:
+    global_stmt(globals, stmt->stmt_select.primary);
+    if (stmt->stmt_select.secondary) {
+      global_stmt(globals, stmt->stmt_select.secondary);
+    }
+    break;
+  case STMT_SWITCH:
+  case STMT_DO:
+  case STMT_WHILE:
+    global_stmt(globals, stmt->stmt_whiledo.stmt);
+    break;
+  case STMT_FOR:
+    if (stmt->stmt_for.decl) {
+      global_decl(globals, stmt->stmt_for.decl, false);
+    }
+    global_stmt(globals, stmt->stmt_for.stmt);
+    break;
+  default:
+    break;
+  }
+}
+
+void dcc_sema_globals(external_decl_vec_t *unit, sema_global_func_t visit, void *ctx) {
+  globals_t globals = { visit, ctx };
+  for (size_t i = 0; i < unit->size; i++) {
+    external_decl_t *decl = unit->data[i];
+    if (decl->tag == AST_EXT_DECLARATION) {
+      global_decl(&globals, decl->declaration, true);
+      continue;
+    }
+    func_def_t *def = decl->function;
+    visit(ctx, dcc_decltor_ident(def->declarator)->symbol, def->specifiers, 0, def, true);
+    global_stmt(&globals, def->compound);
+  }
+}
@@ -0,0 +1,83 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Semantic analysis. Walks a parsed translation unit with one scoped table per
+  C namespace (ordinary identifiers, tags, labels) and binds every ident_t in
+  the AST to the symbol it declares or refers to, reporting undeclared and
+  conflicting names as it goes. Every symbol is also given its canonical type,
+  which redeclarations refine to their composite, and every expression its
+  type, checking the constraints C puts on operands, assignments, calls and
+  conditions. Members are found through the types of their containers.
+  Every declaration of an entity with linkage, whatever scope it is in, binds
+  to one symbol, so later passes tell objects and functions apart by symbol.
+*/
+
+#pragma once
+
+#include "diag.h"
+#include "parse.h"
+#include "type.h"
+
+typedef struct symbol {
+  enum symbol_tag {
+    SYM_OBJECT,
+    SYM_FUNCTION,
+    SYM_TYPEDEF,
+    SYM_ENUM_CONST,
+    SYM_STRUCT,
+    SYM_UNION,
+    SYM_ENUM,
+    SYM_LABEL,
+  } tag;
+  const name_t *name;
+  srcloc_t loc; // of the identifier that first declared it
+  int depth; // scope depth it was declared at, 1 being file scope
+  bool defined; // has a function body, member list or labeled statement
+  const type_t *type; // declared type, or the type a tag names; null for labels
+  union {
+    struct {
+      decl_spec_t *specs; // null for an implicit or identifier-list declaration
+      decltor_t *decltor;
+    } decl; // objects, functions and typedefs, as last declared
+    enumtor_t *enumtor;
+    type_spec_t *spec; // tags, defining if `defined`
+    stmt_t *stmt; // labels
+  };
+} symbol_t;
+
+typedef struct sema sema_t;
+
+// Symbols bound into the AST are owned by the returned sema_t
+sema_t* dcc_sema_new(diag_vec_t *diags);
+void dcc_sema_free(sema_t *sema);
+
+// Resolve the names in a translation unit and type its expressions, recording
+// errors in the sema's diags
+void dcc_sema(sema_t *sema, external_decl_vec_t *unit);
+
+// Called for a declaration of an object or function that lives outside any
+// call: one at file scope, or a static or extern one in a block. `def` is set
+// for a function definition, and `init` for an object's initializer.
+typedef void (*sema_global_func_t)(void *ctx, symbol_t *symbol, const decl_spec_t *specs,
+                                   initializer_t *init, func_def_t *def, bool is_file_scope);
+
+// Call `visit` for each such declaration of a resolved translation unit, in
+// source order, descending into function bodies for their block scope statics
+// and externs
+void dcc_sema_globals(external_decl_vec_t *unit, sema_global_func_t visit, void *ctx);
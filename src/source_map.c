@@ -0,0 +1,144 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "dcc.h"
+#include "source_map.h"
+
+typedef source_file_t* source_file_ptr_t;
+DECLARE_VEC(source_file_ptr_t, source_file_vec);
+DEFINE_VEC2(source_file_ptr_t, source_file_vec);
+
+// Files are appended in location order, so `files` is sorted by base
+static source_file_vec_t files;
+static srcloc_t next_base;
+
+// Record the start of every line. Newlines are found sixteen bytes at a time
+// where SSE2 is available; the tail (or everything, elsewhere) uses memchr.
+static void index_lines(source_file_t *file) {
+  const char *text = file->text, *p = text, *end = text + file->size;
+  uint32_vec_push(&file->lines, 0);
+
+#ifdef __SSE2__
+  const __m128i newline = _mm_set1_epi8('\n');
+  for (; end - p >= 16; p += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+    unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+    while (mask) {
+      uint32_vec_push(&file->lines, p - text + __builtin_ctz(mask) + 1);
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  while (p < end && (p = memchr(p, '\n', end - p))) {
+    p++;
+    uint32_vec_push(&file->lines, p - text);
+  }
+}
+
+const source_file_t* dcc_source_add(const char *path, const char *text, size_t size) {
+  if (size >= UINT32_MAX - next_base) {
+    dcc_ice("source location space exhausted by %s\n", path);
+  }
+
+  source_file_t *file = dcc_malloc(sizeof *file);
+  file->path = dcc_malloc(strlen(path) + 1);
+  strcpy(file->path, path);
+  file->text = text;
+  file->size = size;
+  file->base = next_base;
+  file->lines = uint32_vec_new();
+  index_lines(file);
+
+  // reserve one location past the end for the file's EOF token
+  next_base += size + 1;
+  source_file_vec_push(&files, file);
+  return file;
+}
+
+size_t dcc_source_count(void) {
+  return files.size;
+}
+
+const source_file_t* dcc_source_at(size_t index) {
+  dcc_assert(index < files.size);
+  return files.data[index];
+}
+
+const source_file_t* dcc_source_file(srcloc_t loc) {
+  dcc_assert(files.size > 0 && loc < next_base);
+
+  // lookups tend to come in runs from the same file
+  static const source_file_t *last;
+  if (last && loc - last->base <= last->size) {
+    return last;
+  }
+
+  // last file whose base is <= loc
+  size_t lo = 0, hi = files.size;
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (files.data[mid]->base <= loc) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return last = files.data[lo];
+}
+
+srcpos_t dcc_source_pos(srcloc_t loc) {
+  const source_file_t *file = dcc_source_file(loc);
+  uint32_t offset = loc - file->base;
+
+  // last line starting at or before offset
+  size_t lo = 0, hi = file->lines.size;
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (file->lines.data[mid] <= offset) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+
+  srcpos_t pos = { file, lo + 1, offset - file->lines.data[lo] + 1 };
+  return pos;
+}
+
+const char* dcc_source_text(srcloc_t loc) {
+  const source_file_t *file = dcc_source_file(loc);
+  return file->text + (loc - file->base);
+}
+
+const char* dcc_source_line(srcloc_t loc, size_t *len) {
+  srcpos_t pos = dcc_source_pos(loc);
+  const source_file_t *file = pos.file;
+  const char *begin = file->text + file->lines.data[pos.line - 1];
+  const char *end = pos.line < file->lines.size
+    ? file->text + file->lines.data[pos.line] - 1
+    : file->text + file->size;
+  *len = end - begin;
+  return begin;
+}
@@ -0,0 +1,61 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Source map. Every file handed to the compiler occupies a disjoint range of a
+  single 32-bit location space, so a srcloc_t alone identifies the file and the
+  byte within it. Line starts are indexed up front so that resolving a location
+  to (file, line, column) is a pair of binary searches.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vec_types.h"
+
+typedef uint32_t srcloc_t;
+
+typedef struct source_file {
+  char *path;
+  const char *text; // null terminated
+  size_t size;
+  srcloc_t base; // location of text[0]; text[size] is at base + size
+  uint32_vec_t lines; // offset of the first byte of each line
+} source_file_t;
+
+typedef struct {
+  const source_file_t *file;
+  uint32_t line, column; // 1-based, column counted in bytes
+} srcpos_t;
+
+// Register `text` (which must stay alive and be null terminated at
+// text[size]) and assign it a range of locations.
+const source_file_t* dcc_source_add(const char *path, const char *text, size_t size);
+
+// Every file added so far, in location order
+size_t dcc_source_count(void);
+const source_file_t* dcc_source_at(size_t index);
+
+const source_file_t* dcc_source_file(srcloc_t loc);
+srcpos_t dcc_source_pos(srcloc_t loc);
+const char* dcc_source_text(srcloc_t loc);
+
+// Return the text of the line containing `loc` and store its length in `len`
+const char* dcc_source_line(srcloc_t loc, size_t *len);
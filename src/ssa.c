@@ -0,0 +1,434 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "ssa.h"
+
+////
+// Dominators
+
+static uint32_t intersect(const ir_block_t *blocks, uint32_t a, uint32_t b) {
+  while (a != b) {
+    while (a > b) {
+      a = blocks[a].idom;
+    }
+    while (b > a) {
+      b = blocks[b].idom;
+    }
+  }
+  return a;
+}
+
+void dcc_ir_dominators(ir_func_t *func) {
+  ir_block_t *blocks = func->blocks.data;
+  uint32_t n = func->blocks.size;
+  blocks[0].idom = 0;
+  for (uint32_t b = 1; b < n; b++) {
+    blocks[b].idom = IR_NONE;
+  }
+
+  // blocks are numbered in reverse postorder, so a block's dominators all
+  // have smaller numbers and the first processed predecessor is one before it
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (uint32_t b = 1; b < n; b++) {
+      uint32_t idom = IR_NONE;
+      for (size_t k = 0; k < blocks[b].preds.size; k++) {
+        uint32_t pred = blocks[b].preds.data[k];
+        if (blocks[pred].idom == IR_NONE) {
+          continue;
+        }
+        idom = idom == IR_NONE ? pred : intersect(blocks, pred, idom);
+      }
+      if (blocks[b].idom != idom) {
+        blocks[b].idom = idom;
+        changed = true;
+      }
+    }
+  }
+
+  // number a preorder walk of the tree, whose children are found through a
+  // counting sort of the blocks by idom
+  uint32_t *start = dcc_calloc(n + 1, sizeof(uint32_t));
+  uint32_t *children = dcc_malloc(n * sizeof(uint32_t));
+  for (uint32_t b = 1; b < n; b++) {
+    start[blocks[b].idom + 1]++;
+  }
+  for (uint32_t b = 0; b < n; b++) {
+    start[b + 1] += start[b];
+  }
+  uint32_t *fill = dcc_malloc((n + 1) * sizeof(uint32_t));
+  memcpy(fill, start, (n + 1) * sizeof(uint32_t));
+  for (uint32_t b = 1; b < n; b++) {
+    children[fill[blocks[b].idom]++] = b;
+  }
+
+  // each block is pushed twice: once to enter it, and once, marked by the
+  // high bit, to close its interval after its subtree
+  uint32_t counter = 0, depth = 0;
+  uint32_t *marks = dcc_malloc(2 * n * sizeof(uint32_t));
+  marks[depth++] = 0;
+  while (depth) {
+    uint32_t top = marks[--depth];
+    if (top & 0x80000000u) {
+      blocks[top & 0x7fffffffu].dom_exit = counter - 1;
+      continue;
+    }
+    blocks[top].dom_enter = counter++;
+    marks[depth++] = top | 0x80000000u;
+    for (uint32_t c = start[top]; c < start[top + 1]; c++) {
+      marks[depth++] = children[c];
+    }
+  }
+
+  free(start);
+  free(children);
+  free(fill);
+  free(marks);
+}
+
+bool dcc_ir_dominates(const ir_func_t *func, uint32_t a, uint32_t b) {
+  const ir_block_t *x = &func->blocks.data[a], *y = &func->blocks.data[b];
+  return x->dom_enter <= y->dom_enter && y->dom_exit <= x->dom_exit;
+}
+
+////
+// Construction
+
+typedef struct {
+  ir_func_t *func;
+  uint32_t base; // the first phi placed; those after it are ours
+  uint32_vec_t phi_vars; // the variable of each of our phis
+  uint32_vec_t *block_phis; // our phis in each block
+  uint32_vec_t *stacks; // the current value of each variable
+  uint32_vec_t log; // variables pushed, to pop on leaving a block
+  ir_ref_t *map; // the value read by each IR_GET
+  ir_ref_t undefs[IR_F64 + 1];
+  uint32_vec_t new_undefs;
+} ssa_t;
+
+// Group (variable, block) pairs by variable, in compressed rows
+static uint32_t* bucket(const uint32_vec_t *vars, const uint32_vec_t *blocks,
+                        uint32_t var_count, uint32_t **rows) {
+  uint32_t *start = dcc_calloc(var_count + 1, sizeof(uint32_t));
+  for (size_t i = 0; i < vars->size; i++) {
+    start[vars->data[i] + 1]++;
+  }
+  for (uint32_t v = 0; v < var_count; v++) {
+    start[v + 1] += start[v];
+  }
+  uint32_t *fill = dcc_malloc((var_count + 1) * sizeof(uint32_t));
+  memcpy(fill, start, (var_count + 1) * sizeof(uint32_t));
+  *rows = dcc_malloc((vars->size + 1) * sizeof(uint32_t));
+  for (size_t i = 0; i < vars->size; i++) {
+    (*rows)[fill[vars->data[i]]++] = blocks->data[i];
+  }
+  free(fill);
+  return start;
+}
+
+static void place_phis(ssa_t *ssa) {
+  ir_func_t *func = ssa->func;
+  ir_block_t *blocks = func->blocks.data;
+  uint32_t n = func->blocks.size, var_count = func->vars.size;
+
+  // dominance frontiers: walk up from each predecessor of a join point
+  uint32_vec_t *frontiers = dcc_calloc(n, sizeof(uint32_vec_t));
+  for (uint32_t b = 0; b < n; b++) {
+    if (blocks[b].preds.size < 2) {
+      continue;
+    }
+    for (size_t k = 0; k < blocks[b].preds.size; k++) {
+      uint32_t runner = blocks[b].preds.data[k];
+      while (runner != blocks[b].idom) {
+        uint32_vec_t *frontier = &frontiers[runner];
+        if (!frontier->size || frontier->data[frontier->size - 1] != b) {
+          uint32_vec_push(frontier, b);
+        }
+        runner = blocks[runner].idom;
+      }
+    }
+  }
+
+  // the blocks that define each variable, and those that read it before
+  // defining it
+  uint32_vec_t def_vars = uint32_vec_new(), def_blocks = uint32_vec_new();
+  uint32_vec_t use_vars = uint32_vec_new(), use_blocks = uint32_vec_new();
+  uint32_t *defined = dcc_calloc(var_count, sizeof(uint32_t));
+  uint32_t *used = dcc_calloc(var_count, sizeof(uint32_t));
+  for (uint32_t b = 0; b < n; b++) {
+    for (size_t k = 0; k < blocks[b].instrs.size; k++) {
+      const ir_instr_t *instr = &func->instrs.data[blocks[b].instrs.data[k]];
+      uint32_t var = instr->imm;
+      if (instr->op == IR_GET && defined[var] != b + 1 && used[var] != b + 1) {
+        used[var] = b + 1;
+        uint32_vec_push(&use_vars, var);
+        uint32_vec_push(&use_blocks, b);
+      } else if (instr->op == IR_SET && defined[var] != b + 1) {
+        defined[var] = b + 1;
+        uint32_vec_push(&def_vars, var);
+        uint32_vec_push(&def_blocks, b);
+      }
+    }
+  }
+  uint32_t *defs, *uses;
+  uint32_t *def_start = bucket(&def_vars, &def_blocks, var_count, &defs);
+  uint32_t *use_start = bucket(&use_vars, &use_blocks, var_count, &uses);
+
+  // per-block marks, stamped with the variable + 1 so they never need clearing
+  uint32_t *def_mark = dcc_calloc(n, sizeof(uint32_t));
+  uint32_t *live_mark = dcc_calloc(n, sizeof(uint32_t));
+  uint32_t *phi_mark = dcc_calloc(n, sizeof(uint32_t));
+  uint32_vec_t work = uint32_vec_new();
+  for (uint32_t var = 0; var < var_count; var++) {
+    uint32_t stamp = var + 1;
+    // a variable never read across blocks needs no phis
+    if (use_start[var] == use_start[var + 1]) {
+      continue;
+    }
+    for (uint32_t d = def_start[var]; d < def_start[var + 1]; d++) {
+      def_mark[defs[d]] = stamp;
+    }
+
+    // live-in blocks, spreading backwards from upward-exposed uses
+    work.size = 0;
+    for (uint32_t u = use_start[var]; u < use_start[var + 1]; u++) {
+      live_mark[uses[u]] = stamp;
+      uint32_vec_push(&work, uses[u]);
+    }
+    while (work.size) {
+      uint32_t b = uint32_vec_pop(&work);
+      for (size_t k = 0; k < blocks[b].preds.size; k++) {
+        uint32_t pred = blocks[b].preds.data[k];
+        if (live_mark[pred] != stamp && def_mark[pred] != stamp) {
+          live_mark[pred] = stamp;
+          uint32_vec_push(&work, pred);
+        }
+      }
+    }
+
+    // the iterated dominance frontier of the definitions, where live
+    work.size = 0;
+    for (uint32_t d = def_start[var]; d < def_start[var + 1]; d++) {
+      uint32_vec_push(&work, defs[d]);
+    }
+    while (work.size) {
+      uint32_t b = uint32_vec_pop(&work);
+      for (size_t k = 0; k < frontiers[b].size; k++) {
+        uint32_t join = frontiers[b].data[k];
+        if (phi_mark[join] == stamp || live_mark[join] != stamp) {
+          continue;
+        }
+        phi_mark[join] = stamp;
+        ir_ref_t phi = dcc_ir_insert(func, join, 0, IR_PHI, func->vars.data[var].kind,
+                                     blocks[join].preds.size, 0);
+        func->instrs.data[phi].flags = func->vars.data[var].flags;
+        uint32_vec_push(&ssa->phi_vars, var);
+        uint32_vec_push(&ssa->block_phis[join], phi);
+        if (def_mark[join] != stamp) {
+          def_mark[join] = stamp;
+          uint32_vec_push(&work, join);
+        }
+      }
+    }
+  }
+
+  for (uint32_t b = 0; b < n; b++) {
+    uint32_vec_free(&frontiers[b]);
+  }
+  free(frontiers);
+  uint32_vec_free(&def_vars);
+  uint32_vec_free(&def_blocks);
+  uint32_vec_free(&use_vars);
+  uint32_vec_free(&use_blocks);
+  uint32_vec_free(&work);
+  free(defined);
+  free(used);
+  free(defs);
+  free(uses);
+  free(def_start);
+  free(use_start);
+  free(def_mark);
+  free(live_mark);
+  free(phi_mark);
+}
+
+static ir_ref_t current(ssa_t *ssa, uint32_t var) {
+  uint32_vec_t *stack = &ssa->stacks[var];
+  if (stack->size) {
+    return stack->data[stack->size - 1];
+  }
+  // read before any definition: the entry gets the undef once renaming is done
+  ir_kind_t kind = ssa->func->vars.data[var].kind;
+  if (ssa->undefs[kind] == IR_NONE) {
+    ir_instr_t instr = { IR_UNDEF, kind, 0, 0, 0, 0, { 0 } };
+    ir_instr_vec_push(&ssa->func->instrs, instr);
+    ssa->undefs[kind] = ssa->func->instrs.size - 1;
+    uint32_vec_push(&ssa->new_undefs, ssa->undefs[kind]);
+  }
+  return ssa->undefs[kind];
+}
+
+static ir_ref_t resolve(const ssa_t *ssa, ir_ref_t ref) {
+  return ssa->map[ref] != IR_NONE ? ssa->map[ref] : ref;
+}
+
+static void push(ssa_t *ssa, uint32_t var, ir_ref_t value) {
+  uint32_vec_push(&ssa->stacks[var], value);
+  uint32_vec_push(&ssa->log, var);
+}
+
+static void rename_block(ssa_t *ssa, uint32_t b) {
+  ir_func_t *func = ssa->func;
+  ir_block_t *block = &func->blocks.data[b];
+  for (size_t k = 0; k < block->instrs.size; k++) {
+    ir_ref_t ref = block->instrs.data[k];
+    ir_instr_t *instr = &func->instrs.data[ref];
+    if (instr->op == IR_PHI && ref >= ssa->base) {
+      push(ssa, ssa->phi_vars.data[ref - ssa->base], ref);
+    } else if (instr->op == IR_GET) {
+      // current() may add an undef, moving the instructions
+      ir_ref_t value = current(ssa, instr->imm);
+      ssa->map[ref] = value;
+      func->instrs.data[ref].op = IR_NOP;
+    } else if (instr->op == IR_SET) {
+      ir_ref_t value = resolve(ssa, instr->args[0]);
+      func->instrs.data[value].flags |= func->vars.data[instr->imm].flags;
+      push(ssa, instr->imm, value);
+      instr->op = IR_NOP;
+      instr->count = 0;
+    }
+  }
+
+  for (size_t s = 0; s < block->succs.size; s++) {
+    ir_block_t *succ = &func->blocks.data[block->succs.data[s]];
+    uint32_vec_t *phis = &ssa->block_phis[block->succs.data[s]];
+    for (size_t p = 0; p < succ->preds.size; p++) {
+      if (succ->preds.data[p] != b) {
+        continue;
+      }
+      for (size_t k = 0; k < phis->size; k++) {
+        ir_ref_t phi = phis->data[k];
+        func->instrs.data[phi].args[p] = current(ssa, ssa->phi_vars.data[phi - ssa->base]);
+      }
+    }
+  }
+}
+
+static void rename_vars(ssa_t *ssa) {
+  ir_func_t *func = ssa->func;
+  uint32_t n = func->blocks.size;
+  ssa->map = dcc_malloc(func->instrs.size * sizeof(ir_ref_t));
+  for (size_t i = 0; i < func->instrs.size; i++) {
+    ssa->map[i] = IR_NONE;
+  }
+
+  // a preorder walk of the dominator tree, as in dcc_ir_dominators()
+  uint32_t *start = dcc_calloc(n + 1, sizeof(uint32_t));
+  uint32_t *children = dcc_malloc(n * sizeof(uint32_t));
+  for (uint32_t b = 1; b < n; b++) {
+    start[func->blocks.data[b].idom + 1]++;
+  }
+  for (uint32_t b = 0; b < n; b++) {
+    start[b + 1] += start[b];
+  }
+  uint32_t *fill = dcc_malloc((n + 1) * sizeof(uint32_t));
+  memcpy(fill, start, (n + 1) * sizeof(uint32_t));
+  for (uint32_t b = 1; b < n; b++) {
+    children[fill[func->blocks.data[b].idom]++] = b;
+  }
+
+  // the high bit marks leaving a block, which pops what it pushed
+  uint32_t *marks = dcc_malloc(2 * n * sizeof(uint32_t));
+  uint32_t *log_size = dcc_malloc(n * sizeof(uint32_t));
+  uint32_t depth = 0;
+  marks[depth++] = 0;
+  while (depth) {
+    uint32_t top = marks[--depth];
+    if (top & 0x80000000u) {
+      uint32_t b = top & 0x7fffffffu;
+      while (ssa->log.size > log_size[b]) {
+        uint32_vec_pop(&ssa->stacks[uint32_vec_pop(&ssa->log)]);
+      }
+      continue;
+    }
+    log_size[top] = ssa->log.size;
+    rename_block(ssa, top);
+    marks[depth++] = top | 0x80000000u;
+    for (uint32_t c = start[top]; c < start[top + 1]; c++) {
+      marks[depth++] = children[c];
+    }
+  }
+
+  for (size_t i = 0; i < func->instrs.size; i++) {
+    ir_instr_t *instr = &func->instrs.data[i];
+    for (uint32_t k = 0; k < instr->count; k++) {
+      if (instr->args[k] < ssa->base) {
+        instr->args[k] = resolve(ssa, instr->args[k]);
+      }
+    }
+  }
+  for (size_t i = 0; i < ssa->new_undefs.size; i++) {
+    uint32_vec_push(&func->blocks.data[0].instrs, 0);
+    uint32_vec_t *instrs = &func->blocks.data[0].instrs;
+    memmove(&instrs->data[1], &instrs->data[0], (instrs->size - 1) * sizeof(uint32_t));
+    instrs->data[0] = ssa->new_undefs.data[i];
+  }
+
+  free(start);
+  free(children);
+  free(fill);
+  free(marks);
+  free(log_size);
+}
+
+void dcc_ir_ssa(ir_func_t *func) {
+  dcc_ir_compact(func);
+  dcc_ir_dominators(func);
+
+  if (func->vars.size) {
+    uint32_t n = func->blocks.size;
+    ssa_t ssa = { func, func->instrs.size, uint32_vec_new(),
+                  dcc_calloc(n, sizeof(uint32_vec_t)),
+                  dcc_calloc(func->vars.size, sizeof(uint32_vec_t)),
+                  uint32_vec_new(), 0, { 0 }, uint32_vec_new() };
+    for (int k = 0; k <= IR_F64; k++) {
+      ssa.undefs[k] = IR_NONE;
+    }
+    place_phis(&ssa);
+    rename_vars(&ssa);
+
+    for (uint32_t b = 0; b < n; b++) {
+      uint32_vec_free(&ssa.block_phis[b]);
+    }
+    for (size_t v = 0; v < func->vars.size; v++) {
+      uint32_vec_free(&ssa.stacks[v]);
+    }
+    free(ssa.block_phis);
+    free(ssa.stacks);
+    free(ssa.map);
+    uint32_vec_free(&ssa.phi_vars);
+    uint32_vec_free(&ssa.log);
+    uint32_vec_free(&ssa.new_undefs);
+    func->vars.size = 0;
+  }
+
+  dcc_ir_compact(func);
+  dcc_ir_dominators(func);
+}
@@ -0,0 +1,39 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+  SSA construction. Dominators come from the iterative algorithm of Cooper,
+  Harvey and Kennedy, which over blocks numbered in reverse postorder settles
+  in a couple of passes and beats Lengauer-Tarjan on graphs of the size
+  functions have. Phis for the variables lowering reads and writes through
+  IR_GET and IR_SET are placed on the iterated dominance frontier of their
+  definitions, pruned to the blocks where the variable is live, and renamed
+  in one walk of the dominator tree.
+*/
+
+#pragma once
+
+#include "ir.h"
+
+// Set the idom and dominator tree intervals of the blocks of a compacted
+// function
+void dcc_ir_dominators(ir_func_t *func);
+bool dcc_ir_dominates(const ir_func_t *func, uint32_t a, uint32_t b);
+
+// Replace the function's variables by values and phis, leaving it compacted
+// with its dominators computed
+void dcc_ir_ssa(ir_func_t *func);
@@ -0,0 +1,184 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <string.h>
+
+#include "dcc.h"
+#include "strlit.h"
+
+strlit_t* dcc_strlit_new(const strlit_piece_t *pieces, uint32_t count) {
+  strlit_t *lit = dcc_malloc(sizeof *lit + count * sizeof *pieces);
+  lit->bytes = 0;
+  lit->size = 0;
+  lit->count = count;
+  memcpy(lit->pieces, pieces, count * sizeof *pieces);
+  return lit;
+}
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  } else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  } else if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+literal_prefix_t dcc_literal_prefix(const char **spelling) {
+  const char *s = *spelling;
+  literal_prefix_t prefix = LITERAL_PLAIN;
+  if (s[0] == 'u' && s[1] == '8') {
+    prefix = LITERAL_UTF8;
+  } else if (s[0] == 'L') {
+    prefix = LITERAL_WIDE;
+  } else if (s[0] == 'u') {
+    prefix = LITERAL_UTF16;
+  } else if (s[0] == 'U') {
+    prefix = LITERAL_UTF32;
+  }
+  *spelling = s + (prefix == LITERAL_UTF8 ? 2 : prefix != LITERAL_PLAIN);
+  return prefix;
+}
+
+// One character of source text, which is UTF-8, as a code point
+static uint32_t decode_utf8(const char **p) {
+  const unsigned char *s = (const unsigned char*)*p;
+  int extra = s[0] >= 0xf0 ? 3 : s[0] >= 0xe0 ? 2 : s[0] >= 0xc0 ? 1 : 0;
+  uint32_t value = extra ? s[0] & (0x3f >> extra) : s[0];
+  int i = 1;
+  for (; i <= extra && (s[i] & 0xc0) == 0x80; i++) {
+    value = (value << 6) | (s[i] & 0x3f);
+  }
+  *p += i;
+  return value;
+}
+
+// stdspec.6.4.4.4 Characters of a prefixed literal are not truncated to a
+// byte, and may also be universal character names
+static uint32_t decode(const char **p, bool wide) {
+  const char *s = *p;
+  if (*s != '\\') {
+    if (wide) {
+      return decode_utf8(p);
+    }
+    *p = s + 1;
+    return (unsigned char)*s;
+  }
+
+  s++;
+  uint32_t value;
+  if (wide && (*s == 'u' || *s == 'U')) {
+    int digits = *s++ == 'u' ? 4 : 8;
+    value = 0;
+    for (int digit; digits-- > 0 && (digit = hex_value(*s)) >= 0; s++) {
+      value = (value << 4) | digit;
+    }
+    *p = s;
+    return value;
+  }
+  switch (*s) {
+  case 'a': value = '\a'; s++; break;
+  case 'b': value = '\b'; s++; break;
+  case 'f': value = '\f'; s++; break;
+  case 'n': value = '\n'; s++; break;
+  case 'r': value = '\r'; s++; break;
+  case 't': value = '\t'; s++; break;
+  case 'v': value = '\v'; s++; break;
+  case '\\': case '\'': case '"': case '?':
+    value = *s++;
+    break;
+  case 'x':
+    s++;
+    value = 0;
+    for (int digit; (digit = hex_value(*s)) >= 0; s++) {
+      value = (value << 4) | digit;
+    }
+    break;
+  default:
+    if (*s >= '0' && *s <= '7') {
+      value = 0;
+      for (int i = 0; i < 3 && *s >= '0' && *s <= '7'; i++, s++) {
+        value = (value << 3) | (*s - '0');
+      }
+    } else {
+      // unknown escape, keep the character as-is
+      value = (unsigned char)*s++;
+    }
+  }
+
+  *p = s;
+  return wide ? value : value & 0xff;
+}
+
+int dcc_decode_char(const char **p) {
+  return decode(p, false);
+}
+
+uint32_t dcc_decode_wide_char(const char **p) {
+  return decode(p, true);
+}
+
+literal_prefix_t dcc_strlit_prefix(const strlit_t *lit) {
+  literal_prefix_t prefix = LITERAL_PLAIN;
+  for (uint32_t i = 0; i < lit->count; i++) {
+    const char *spelling = dcc_source_text(lit->pieces[i].loc);
+    literal_prefix_t piece = dcc_literal_prefix(&spelling);
+    prefix = piece != LITERAL_PLAIN ? piece : prefix;
+  }
+  return prefix;
+}
+
+const char* dcc_strlit_bytes(strlit_t *lit, size_t *size) {
+  if (!lit->bytes) {
+    // decoding never lengthens a literal
+    size_t capacity = 1;
+    for (uint32_t i = 0; i < lit->count; i++) {
+      capacity += lit->pieces[i].len;
+    }
+
+    char *out = dcc_malloc(capacity);
+    size_t n = 0;
+    for (uint32_t i = 0; i < lit->count; i++) {
+      const char *spelling = dcc_source_text(lit->pieces[i].loc), *s = spelling;
+      dcc_literal_prefix(&s);
+      const char *end = spelling + lit->pieces[i].len - 1;
+      s++;
+      while (s < end) {
+        // line splices inside literals denote nothing
+        if (s[0] == '\\' && s[1] == '\n') {
+          s += 2;
+        } else if (s[0] == '\\' && s[1] == '\r' && s[2] == '\n') {
+          s += 3;
+        } else {
+          out[n++] = dcc_decode_char(&s);
+        }
+      }
+    }
+    out[n] = 0;
+
+    lit->bytes = out;
+    lit->size = n;
+  }
+
+  if (size) {
+    *size = lit->size;
+  }
+  return lit->bytes;
+}
@@ -0,0 +1,69 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  String literals. The tokenizer records only where a literal is spelled; the
+  bytes it denotes are decoded the first time someone asks for them and cached.
+  Adjacent literals ("a" "b") share one strlit_t which lists every piece, so
+  concatenation never copies the source either.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "source_map.h"
+
+// The encoding prefix a string or character literal is spelled with
+typedef enum {
+  LITERAL_PLAIN,
+  LITERAL_UTF8, // u8, of strings only
+  LITERAL_WIDE, // L, of wchar_t
+  LITERAL_UTF16, // u, of char16_t
+  LITERAL_UTF32, // U, of char32_t
+} literal_prefix_t;
+
+// The prefix of the literal spelled at *spelling, advancing it to the quote
+literal_prefix_t dcc_literal_prefix(const char **spelling);
+
+typedef struct {
+  srcloc_t loc; // of the prefix, if any, or else the opening quote
+  uint32_t len; // including the prefix and both quotes
+} strlit_piece_t;
+
+typedef struct strlit {
+  char *bytes; // decoded and null terminated, null until first requested
+  size_t size; // not counting the terminator
+  uint32_t count;
+  strlit_piece_t pieces[];
+} strlit_t;
+
+strlit_t* dcc_strlit_new(const strlit_piece_t *pieces, uint32_t count);
+
+// The prefix of the literal, that of any of its pieces which has one
+literal_prefix_t dcc_strlit_prefix(const strlit_t *lit);
+
+// Decoded contents of the literal, excluding the implicit terminator
+const char* dcc_strlit_bytes(strlit_t *lit, size_t *size);
+
+// Decode one (possibly escaped) character of a literal body, advancing *p
+int dcc_decode_char(const char **p);
+// Likewise for a prefixed character constant, whose source character may take
+// several bytes of UTF-8 and whose escapes are not truncated to a byte
+uint32_t dcc_decode_wide_char(const char **p);
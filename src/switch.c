@@ -0,0 +1,205 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "dcc.h"
+#include "switch.h"
+
+DEFINE_VEC2(switch_case_t, switch_case_vec);
+DEFINE_VEC2(switch_cluster_t, switch_cluster_vec);
+DEFINE_VEC2(switch_node_t, switch_node_vec);
+
+static int compare_signed(const void *a, const void *b) {
+  const switch_case_t *x = a, *y = b;
+  if (x->value != y->value) {
+    return x->value < y->value ? -1 : 1;
+  }
+  return x->target < y->target ? -1 : x->target > y->target;
+}
+
+static int compare_unsigned(const void *a, const void *b) {
+  const switch_case_t *x = a, *y = b;
+  if (x->value != y->value) {
+    return (uint64_t)x->value < (uint64_t)y->value ? -1 : 1;
+  }
+  return x->target < y->target ? -1 : x->target > y->target;
+}
+
+// The number of values from the first of `count` sorted cases to the last,
+// which wraps to zero for the whole 64-bit range
+static uint64_t range_of(const switch_case_t *cases, uint32_t count) {
+  return (uint64_t)cases[count - 1].value - (uint64_t)cases[0].value + 1;
+}
+
+static bool is_dense(const switch_case_t *cases, uint32_t count) {
+  uint64_t range = range_of(cases, count);
+  return range && range <= SWITCH_TABLE_MAX
+    && (uint64_t)count * 100 >= range * SWITCH_TABLE_DENSITY;
+}
+
+// The number of targets of `count` cases that fit in one range of masks, or
+// zero if they do not
+static uint32_t bit_targets(const switch_case_t *cases, uint32_t count) {
+  uint64_t range = range_of(cases, count);
+  if (!range || range > SWITCH_BITS_MAX) {
+    return 0;
+  }
+  uint32_t targets[SWITCH_BITS_TARGETS], n = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t t = 0;
+    while (t < n && targets[t] != cases[i].target) {
+      t++;
+    }
+    if (t == n) {
+      if (n == SWITCH_BITS_TARGETS) {
+        return 0;
+      }
+      targets[n++] = cases[i].target;
+    }
+  }
+  return n;
+}
+
+// A bit test pays when it replaces enough compares and branches
+static bool bits_pay(uint32_t targets, uint32_t count) {
+  return (targets == 1 && count >= 3) || (targets == 2 && count >= 5)
+    || (targets == 3 && count >= 6);
+}
+
+// Group the cases of a bit test by target, each as a mask of their values
+static void group_masks(switch_cluster_t *cluster, const switch_case_t *cases) {
+  uint64_t done = 0; // cases already in a mask
+  cluster->masks = 0;
+  for (uint32_t i = 0; i < cluster->count; i++) {
+    if (done & (uint64_t)1 << i) {
+      continue;
+    }
+    switch_mask_t *mask = &cluster->mask[cluster->masks++];
+    mask->mask = 0;
+    mask->target = cases[i].target;
+    for (uint32_t j = i; j < cluster->count; j++) {
+      if (cases[j].target == cases[i].target) {
+        mask->mask |= (uint64_t)1 << ((uint64_t)cases[j].value - (uint64_t)cluster->low);
+        done |= (uint64_t)1 << j;
+      }
+    }
+  }
+}
+
+static switch_cluster_vec_t partition(switch_case_vec_t *cases, bool is_signed) {
+  switch_cluster_vec_t clusters = switch_cluster_vec_new();
+  if (!cases->size) {
+    return clusters;
+  }
+  qsort(cases->data, cases->size, sizeof(switch_case_t),
+        is_signed ? compare_signed : compare_unsigned);
+  uint32_t n = cases->size;
+  const switch_case_t *c = cases->data;
+  for (uint32_t i = 1; i < n; i++) {
+    if (c[i].value == c[i - 1].value) {
+      dcc_ice("duplicate case value %" PRId64 " reached the switch planner\n", c[i].value);
+    }
+  }
+
+  // the fewest clusters that cover the cases from each one on, and the kind
+  // and last case of the first of them, preferring cheaper kinds on ties
+  uint32_t *fewest = dcc_malloc((n + 1) * sizeof(uint32_t));
+  uint32_t *last = dcc_malloc(n * sizeof(uint32_t));
+  uint8_t *tags = dcc_malloc(n);
+  fewest[n] = 0;
+  // the farthest case a table from case i can reach, which falls with i
+  uint32_t reach = n - 1;
+  for (uint32_t i = n; i-- > 0;) {
+    fewest[i] = 1 + fewest[i + 1];
+    last[i] = i;
+    tags[i] = SWITCH_CASE;
+    // (a range that wrapped to zero is the largest of all)
+    while (reach > i && range_of(c + i, reach - i + 1) - 1 >= SWITCH_TABLE_MAX) {
+      reach--;
+    }
+    // planning stays linear in the cases by only trying the clusters that end
+    // within a window of case i, and the longest table
+    for (uint32_t j = i + 1; j <= reach; j++) {
+      if (j - i == SWITCH_WINDOW) {
+        j = reach;
+      }
+      uint32_t count = j - i + 1, cost = 1 + fewest[j + 1];
+      enum switch_cluster_tag tag = SWITCH_CASE;
+      uint32_t targets = bit_targets(c + i, count);
+      if (targets && bits_pay(targets, count)) {
+        tag = SWITCH_BITS;
+      } else if (count >= SWITCH_TABLE_MIN && is_dense(c + i, count)) {
+        tag = SWITCH_TABLE;
+      }
+      if (tag != SWITCH_CASE && (cost < fewest[i] || (cost == fewest[i] && tag <= tags[i]))) {
+        fewest[i] = cost;
+        last[i] = j;
+        tags[i] = tag;
+      }
+    }
+  }
+  for (uint32_t i = 0; i < n; i = last[i] + 1) {
+    switch_cluster_t cluster = { 0 };
+    cluster.tag = tags[i];
+    cluster.first = i;
+    cluster.count = last[i] - i + 1;
+    cluster.low = c[i].value;
+    cluster.range = range_of(c + i, cluster.count);
+    if (cluster.tag == SWITCH_BITS) {
+      group_masks(&cluster, c + i);
+    }
+    switch_cluster_vec_push(&clusters, cluster);
+  }
+  free(fewest);
+  free(last);
+  free(tags);
+  return clusters;
+}
+
+// Add the node that searches `count` clusters from `first`, returning its index
+static uint32_t search(switch_plan_t *plan, uint32_t first, uint32_t count) {
+  uint32_t index = plan->nodes.size;
+  switch_node_t node = { false, 0, 0, 0, first, count };
+  switch_node_vec_push(&plan->nodes, node);
+  if (count > SWITCH_LINEAR) {
+    uint32_t half = count / 2;
+    uint32_t left = search(plan, first, half);
+    uint32_t right = search(plan, first + half, count - half);
+    switch_node_t *split = &plan->nodes.data[index];
+    split->is_split = true;
+    split->pivot = plan->clusters.data[first + half].low;
+    split->left = left;
+    split->right = right;
+  }
+  return index;
+}
+
+switch_plan_t dcc_switch_plan(switch_case_vec_t *cases, bool is_signed) {
+  switch_plan_t plan = { partition(cases, is_signed), switch_node_vec_new() };
+  if (plan.clusters.size) {
+    search(&plan, 0, plan.clusters.size);
+  }
+  return plan;
+}
+
+void dcc_switch_plan_free(switch_plan_t *plan) {
+  switch_cluster_vec_free(&plan->clusters);
+  switch_node_vec_free(&plan->nodes);
+}
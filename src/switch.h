@@ -0,0 +1,89 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Planning the dispatch of a switch statement. The case values are sorted and
+  split into clusters, each of which a backend tests in one step: a single
+  value, a jump table over a dense range, or a bit test, where the position of
+  the value in a range of fewer than 64 selects a bit in one mask per target.
+  The clusters are then searched by binary search on their lowest values, and
+  those under a small subtree tested in turn. Backends only emit the compares
+  and branches the plan spells out.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "vec.h"
+
+#define SWITCH_TABLE_MIN 4 // cases worth a table
+#define SWITCH_TABLE_DENSITY 40 // percent of table entries that must be cases
+#define SWITCH_TABLE_MAX 65536 // entries
+#define SWITCH_WINDOW 256 // cases a cluster may end within, besides the farthest
+#define SWITCH_BITS_MAX 64 // the width of a range tested with masks
+#define SWITCH_BITS_TARGETS 3 // masks in one bit test
+#define SWITCH_LINEAR 3 // clusters tested in turn rather than searched
+
+typedef struct {
+  int64_t value; // sign or zero extended, as the switch's type is signed
+  uint32_t target; // the backend's name for where it goes
+} switch_case_t;
+DECLARE_VEC(switch_case_t, switch_case_vec);
+
+// The values of a bit test that go to one target, as bits above the lowest
+typedef struct {
+  uint64_t mask;
+  uint32_t target;
+} switch_mask_t;
+
+typedef struct {
+  enum switch_cluster_tag { // cheapest first
+    SWITCH_BITS,
+    SWITCH_TABLE,
+    SWITCH_CASE,
+  } tag;
+  uint32_t first, count; // of the sorted cases it covers
+  int64_t low; // the value of its first case
+  uint64_t range; // of values from `low` to its last case
+  uint32_t masks; // of a bit test, in the order of their first cases
+  switch_mask_t mask[SWITCH_BITS_TARGETS];
+} switch_cluster_t;
+DECLARE_VEC(switch_cluster_t, switch_cluster_vec);
+
+// A node of the search over clusters. A split goes on to `left` for values
+// below `pivot` and to `right` for the rest; any other node tests its clusters
+// in turn.
+typedef struct {
+  bool is_split;
+  int64_t pivot;
+  uint32_t left, right; // nodes of a split
+  uint32_t first, count; // clusters of a leaf
+} switch_node_t;
+DECLARE_VEC(switch_node_t, switch_node_vec);
+
+typedef struct {
+  switch_cluster_vec_t clusters;
+  switch_node_vec_t nodes; // the first is the root, unless there are no cases
+} switch_plan_t;
+
+// Sort `cases` by value, partition them into clusters, in order, and build the
+// search over them. The values are distinct, as dcc_sema() checks.
+switch_plan_t dcc_switch_plan(switch_case_vec_t *cases, bool is_signed);
+void dcc_switch_plan_free(switch_plan_t *plan);
@@ -18,31 +18,213 @@
 #include <ctype.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "vec.h"
 #include "dcc.h"
+#include "diag.h"
+#include "strlit.h"
 #include "tokenize.h"
 
-static void free_token(token_t *token) {
-  if (token->tag == TOKEN_IDENT) {
-    free(token->val.string);
-  }
-}
-DEFINE_VEC3(token_t, token_vec, free_token);
+DEFINE_VEC2(token_t, token_vec);
 
 static bool starts_ident(char c) {
   return isalpha(c) || c == '_';
 }
 
-static const char* word_end(const char *input) {
-  for (char c = *input; c && (isalnum(c) || c == '_'); input++, c = *input) {}
-  return input;
-}
-
 static const char* malformed_token_end(const char* input ) {
   for (char c = *input; c && !isspace(c); input++, c = *input) {}
   return input;
 }
 
+// Find the first of `a`, `b`, `c` or null at or after p. With SSE2 the input is
+// read in aligned sixteen-byte blocks, which cannot cross into an unmapped page
+// past the terminator. AddressSanitizer would still report the bytes read past
+// the end of the buffer, so the function is left uninstrumented rather than
+// padding every buffer that reaches dcc_source_add().
+#ifdef __GNUC__
+__attribute__((no_sanitize_address))
+#endif
+static const char* scan_for(const char *p, char a, char b, char c) {
+#ifdef __SSE2__
+  const __m128i as = _mm_set1_epi8(a);
+  const __m128i bs = _mm_set1_epi8(b);
+  const __m128i cs = _mm_set1_epi8(c);
+  const __m128i zeros = _mm_setzero_si128();
+
+  size_t misalign = (uintptr_t)p & 15;
+  const char *block = p - misalign;
+  unsigned ignore = (1u << misalign) - 1; // bytes before p
+  for (;; block += 16, ignore = 0) {
+    __m128i v = _mm_load_si128((const __m128i*)block);
+    __m128i hits = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(v, as), _mm_cmpeq_epi8(v, bs)),
+      _mm_or_si128(_mm_cmpeq_epi8(v, cs), _mm_cmpeq_epi8(v, zeros)));
+    unsigned mask = _mm_movemask_epi8(hits) & ~ignore;
+    if (mask) {
+      return block + __builtin_ctz(mask);
+    }
+  }
+#else
+  while (*p && *p != a && *p != b && *p != c) {
+    p++;
+  }
+  return p;
+#endif
+}
+
+// stdspec.5.1.1.2 translation phase 2: a backslash immediately followed by a
+// newline is deleted. The buffer is never rewritten; instead scanners step over
+// splices wherever they may appear, and token spans keep covering the raw text.
+static int splice_len(const char *p) {
+  if (p[0] == '\\') {
+    if (p[1] == '\n') {
+      return 2;
+    } else if (p[1] == '\r' && p[2] == '\n') {
+      return 3;
+    }
+  }
+  return 0;
+}
+
+static const char* skip_splices(const char *p) {
+  for (int len; (len = splice_len(p)); p += len) {}
+  return p;
+}
+
+// Identifiers may be broken across lines by splices; a trailing splice is not
+// part of the word.
+static const char* word_end(const char *input) {
+  while (true) {
+    const char *p = skip_splices(input);
+    if (!(isalnum(*p) || *p == '_')) {
+      return input;
+    }
+    input = p + 1;
+  }
+}
+
+// Copy the spelling of a word without its splices, returning its length
+static size_t unsplice(const char *begin, const char *end, char *out) {
+  size_t len = 0;
+  for (const char *p = skip_splices(begin); p < end; p = skip_splices(p + 1)) {
+    out[len++] = *p;
+  }
+  return len;
+}
+
+// stdspec.6.4.9 Return the end of the comment starting at `begin`, if any. A
+// comment left open runs to the end of the input, and sets `unterminated`.
+static const char* comment_end(const char *begin, const char *end, bool *unterminated) {
+  const char *p = skip_splices(begin + 1);
+
+  if (*p == '*') {
+    for (p++; true; p++) {
+      p = scan_for(p, '*', '*', '*');
+      if (!*p) {
+        *unterminated = true;
+        return end;
+      }
+      const char *next = skip_splices(p + 1);
+      if (*next == '/') {
+        return next + 1;
+      }
+    }
+  } else if (*p == '/') {
+    // a newline preceded by a backslash continues the comment
+    for (p++; (p = memchr(p, '\n', end - p)); p++) {
+      if (p[-1] != '\\' && !(p[-1] == '\r' && p[-2] == '\\')) {
+        return p;
+      }
+    }
+    return end;
+  }
+  return 0;
+}
+
+// Return the end of the string or character literal whose opening quote is at
+// `begin`, skipping over escape sequences without decoding them, or null if it
+// is not terminated on the same line.
+static const char* literal_end(const char *begin) {
+  char quote = *begin;
+  const char *p = begin + 1;
+  while (true) {
+    p = scan_for(p, quote, '\\', '\n');
+    if (*p == quote) {
+      return p + 1;
+    } else if (*p == '\\' && p[1]) {
+      p += 2;
+    } else {
+      return 0; // unterminated
+    }
+  }
+}
+
+// The opening quote of the literal at `input`, after its prefix if it has one,
+// or null if no literal starts there
+static const char* literal_quote(const char *input) {
+  const char *quote = input;
+  if (*input == 'L' || *input == 'u' || *input == 'U') {
+    // u8 prefixes only strings
+    if (dcc_literal_prefix(&quote) == LITERAL_UTF8 && *quote != '"') {
+      return 0;
+    }
+  }
+  return *quote == '"' || *quote == '\'' ? quote : 0;
+}
+
+// stdspec.6.4.4.4 The value of a character constant, as the bits of one of its
+// type: int, or with a prefix wchar_t (int), char16_t or char32_t
+static uint64_t char_value(const char *input) {
+  const char *p = input;
+  literal_prefix_t prefix = dcc_literal_prefix(&p);
+  p++;
+  if (prefix == LITERAL_PLAIN) {
+    // TODO multi-character constants
+    return dcc_decode_char(&p);
+  }
+  uint32_t value = dcc_decode_wide_char(&p);
+  if (prefix == LITERAL_WIDE) {
+    return (uint64_t)(int64_t)(int32_t)value;
+  }
+  return prefix == LITERAL_UTF16 ? value & 0xffff : value;
+}
+
+// Skip the rest of a line that is not a directive, returning its newline.
+// Mostly this is a memchr; only a line with a slash in it needs a closer look,
+// since a comment may carry it on past the newline (as may a splice).
+static const char* skip_line(const char *p, const char *end) {
+  while (true) {
+    const char *newline = memchr(p, '\n', end - p);
+    if (!newline) {
+      return end;
+    }
+
+    const char *q = p, *skip, *resume = 0;
+    bool unterminated = false;
+    bool slash = memchr(p, '/', newline - p) != 0;
+    while (slash && !resume && (q = scan_for(q, '"', '\'', '/')) < newline) {
+      if ((*q == '/' && (skip = comment_end(q, end, &unterminated))) ||
+          (*q != '/' && (skip = literal_end(q)))) {
+        q = skip;
+        resume = q > newline ? q : 0;
+      } else {
+        q++;
+      }
+    }
+
+    if (resume) {
+      p = resume;
+    } else if (newline[-1] == '\\' || (newline[-1] == '\r' && newline[-2] == '\\')) {
+      p = newline + 1;
+    } else {
+      return newline;
+    }
+  }
+}
+
 static token_tag_t match_keyword(const char *input, int len) {
   static struct {
     char *value;
@@ -89,7 +271,7 @@ static token_tag_t match_keyword(const char *input, int len) {
   };
 
   for (int i = 0; KEYWORDS[i].value; i++) {
-    if (strncmp(input, KEYWORDS[i].value,len) == 0) {
+    if (strncmp(input, KEYWORDS[i].value, len) == 0 && !KEYWORDS[i].value[len]) {
       return KEYWORDS[i].tag;
     }
   }
@@ -103,7 +285,8 @@ static bool issymb(char c) {
     '*', '+', ',', '-', '.',
     '/', ':', ';', '<', '=',
     '>', '?', '[', ']', '^',
-    '{', '|', '}', '~',  0,
+    '{', '|', '}', '~', '#',
+    0,
   };
 
   for (int i = 0; C_SYMBOLS[i]; i++) {
@@ -114,41 +297,104 @@ static bool issymb(char c) {
   return false;
 }
 
-token_vec_t dcc_tokenize(const char *input) {
+// Suffixes of integer and floating constants (stdspec.6.4.4)
+static const char* number_suffix_end(const char *input, token_tag_t tag) {
+  const char *suffixes = tag == TOKEN_INTEGER ? "uUlL" : "fFlL";
+  while (*input && strchr(suffixes, *input)) {
+    input++;
+  }
+  return input;
+}
+
+static void push_token(token_vec_t *tokens, token_tag_t tag, srcloc_t loc,
+                       size_t len, token_val_t val, unsigned *flags) {
+  if (len >= 1 << 24) {
+    dcc_ice("token too long\n");
+  }
+  token_t token = {
+    .tag = tag,
+    .loc = loc,
+    .len = len,
+    .flags = *flags,
+    .hideset = 0,
+    .val = val,
+  };
+  token_vec_push(tokens, token);
+  *flags = 0;
+}
+
+static token_vec_t tokenize(const source_file_t *file, bool directives_only,
+                            diag_vec_t *diags) {
   token_vec_t tokens = token_vec_new();
+  const char *input = file->text, *start = input, *limit = input + file->size;
+  srcloc_t base = file->base;
+  unsigned flags = TOKEN_FLAG_BOL;
 
   for (char c = *input; c; c = *input) {
+    const char *skip, *quote;
+    bool unterminated = false;
     if (isspace(c)) {
+      flags |= c == '\n' ? TOKEN_FLAG_BOL | TOKEN_FLAG_SPACE : TOKEN_FLAG_SPACE;
       input++;
-    } else  if (starts_ident(c)) {
+    } else if (c == '\\' && splice_len(input)) {
+      input += splice_len(input);
+    } else if (c == '/' && (skip = comment_end(input, limit, &unterminated))) {
+      if (unterminated && diags) {
+        dcc_diag(diags, DIAG_ERROR, base + (input - start), 2, "unterminated comment");
+      }
+      flags |= TOKEN_FLAG_SPACE;
+      input = skip;
+    } else if (directives_only && flags & TOKEN_FLAG_BOL && c != '#') {
+      input = skip_line(input, limit);
+    } else if ((quote = literal_quote(input)) && *quote == '"' && (skip = literal_end(quote))) {
+      token_val_t val = { 0 };
+      push_token(&tokens, TOKEN_STRING, base + (input - start), skip - input, val, &flags);
+      input = skip;
+    } else if (quote && *quote == '\'' && (skip = literal_end(quote)) && skip - quote > 2) {
+      token_val_t val = { 0 };
+      val.integer = char_value(input);
+      push_token(&tokens, TOKEN_CHARACTER, base + (input - start), skip - input, val, &flags);
+      input = skip;
+    } else if (starts_ident(c)) {
       const char *begin = input, *end = word_end(input + 1);
       input = end;
 
-      token_tag_t tag = match_keyword(begin, end - begin);
+      // only words broken up by splices need their spelling cleaned up
+      const char *word = begin;
+      size_t len = end - begin;
+      char *unspliced = 0;
+      if (memchr(begin, '\\', len)) {
+        word = unspliced = dcc_malloc(len);
+        len = unsplice(begin, end, unspliced);
+      }
+
+      // keywords carry their name as well, since the preprocessor does not
+      // distinguish them from identifiers
+      token_tag_t tag = match_keyword(word, len);
       token_val_t val = { 0 };
+      val.name = dcc_intern(word, len);
 
       if (tag == TOKEN_UNKNOWN) {
         tag = TOKEN_IDENT;
-        val.string = dcc_malloc(end - begin + 1);
-        strncpy(val.string, begin, end-begin);
-        val.string[end-begin] = 0;
       }
+      free(unspliced);
 
-      token_t token = { tag, val, { begin, end } };
-      token_vec_push(&tokens, token);
+      push_token(&tokens, tag, base + (begin - start), end - begin, val, &flags);
     } else if (issymb(c)) {
       static char *C_SYMBOL1_STRS[] = {
         "[", "]", "(", ")", "{",
         "}", ".", "&", "*", "+",
         "-", "~", "!", "/", "%",
         "<", ">", "^", "|", "?",
-        ":", ";", "=", ",", 0,
+        ":", ";", "=", ",", "#",
+        0,
       };
       static char *C_SYMBOL2_STRS[] = {
         "->", "++", "--", "<<", ">>",
         ">=", "<=", "==", "!=", "&&",
         "||", "*=", "/=", "%=", "+=",
-        "-=", "&=", "^=", "|=", 0,
+        "-=", "&=", "^=", "|=", "##",
+        0,
       };
       static char *C_SYMBOL3_STRS[] = {
         "<<=", ">>=", "...", 0,
@@ -159,13 +405,14 @@ token_vec_t dcc_tokenize(const char *input) {
         TOKEN_PLUS, TOKEN_MINUS, TOKEN_SQUIGGLE, TOKEN_EXCLAIM, TOKEN_FORWARD,
         TOKEN_PERCENT, TOKEN_LESS, TOKEN_MORE, TOKEN_CARET, TOKEN_PIPE,
         TOKEN_QUEST, TOKEN_COLON, TOKEN_SEMI, TOKEN_EQUAL, TOKEN_COMMA,
+        TOKEN_HASH,
       };
       static token_tag_t C_SYMBOL2_TAGS[] = {
         TOKEN_ARROW, TOKEN_INCREMENT, TOKEN_DECREMENT, TOKEN_LEFT,
         TOKEN_RIGHT, TOKEN_MOREEQ, TOKEN_LESSEQ, TOKEN_EQEQ, TOKEN_NOTEQ,
         TOKEN_AMPAMP, TOKEN_PIPEPIPE, TOKEN_STAREQ, TOKEN_FORWARDEQ,
         TOKEN_PERCENTEQ, TOKEN_PLUSEQ, TOKEN_MINUSEQ, TOKEN_AMPEQ,
-        TOKEN_CARETEQ, TOKEN_PIPEEQ,
+        TOKEN_CARETEQ, TOKEN_PIPEEQ, TOKEN_HASHHASH,
       };
       static token_tag_t C_SYMBOL3_TAGS[] = {
         TOKEN_LEFTEQ, TOKEN_RIGHTEQ, TOKEN_ELLIPSE,
@@ -187,8 +434,8 @@ token_vec_t dcc_tokenize(const char *input) {
         for (int i = 0; symbols[i]; i++) {
           if (strncmp(input, symbols[i], l) == 0) {
             token_tag_t tag = C_SYMBOL_TAGS[l-1][i];
-            token_t token = { tag, { 0 }, { input, input + l}};
-            token_vec_push(&tokens, token);
+            token_val_t val = { 0 };
+            push_token(&tokens, tag, base + (input - start), l, val, &flags);
 
             input += l;
             goto matched;
@@ -201,50 +448,64 @@ token_vec_t dcc_tokenize(const char *input) {
       uint64_t integer;
       double floating;
 
+      // sscanf would measure the rest of the input on every call
       char *end = 0;
-      if (sscanf(input, "%lf", &floating)) {
-        double confirm = strtod(input, &end);
-        dcc_assert(floating == confirm);
-
+      floating = strtod(input, &end);
+      if (end > input) {
         // float may actually be decimal integer
         char *end2;
         token_tag_t tag = TOKEN_FLOATING;
         token_val_t val = { 0 };
-        if (sscanf(input, "%lli", &integer) && (strtoul(input, &end2, 0), end2 >= end)) {
+        integer = strtoull(input, &end2, 0);
+        if (end2 >= end) {
           tag = TOKEN_INTEGER;
           val.integer = integer;
         } else {
           val.floating = floating;
         }
 
-        token_t token = { tag, val, { input, end }};
-        token_vec_push(&tokens, token);
+        end = (char*)number_suffix_end(end, tag);
+        push_token(&tokens, tag, base + (input - start), end - input, val, &flags);
       } else {
         dcc_ice("malformed number %.*s\n", malformed_token_end(input + 1) - input, input);
         // TODO is this even necessary
       }
-      // TODO numeric suffixes
       input = end;
     } else {
-      dcc_ice("untokenizable character `%c`\n", c);
+      // stray characters are left for the parser (or a skipped conditional
+      // group) to reject, as are unterminated quotes
+      token_val_t val = { 0 };
+      push_token(&tokens, TOKEN_UNKNOWN, base + (input - start), 1, val, &flags);
+      input++;
     }
   }
 
-  token_t token = { TOKEN_EOF, { 0 }, { input, input }};
-  token_vec_push(&tokens, token);
+  token_val_t val = { 0 };
+  push_token(&tokens, TOKEN_EOF, base + (input - start), 0, val, &flags);
 
   return tokens;
 }
 
+token_vec_t dcc_tokenize(const source_file_t *file, diag_vec_t *diags) {
+  return tokenize(file, false, diags);
+}
+
+token_vec_t dcc_tokenize_directives(const source_file_t *file, diag_vec_t *diags) {
+  return tokenize(file, true, diags);
+}
+
 void dcc_log_tokens(const token_vec_t *tokens) {
   VEC_FOREACH(token_t, token, tokens) {
     char buffer[32];
-    char *extra = "<null>";
+    const char *extra = "<null>";
 
-    if (token.tag == TOKEN_IDENT || token.tag == TOKEN_STRING) {
-      extra = token.val.string;
+    if (token.tag == TOKEN_IDENT) {
+      extra = token.val.name->str;
     } else if (token.tag == TOKEN_INTEGER) {
-      snprintf(buffer, sizeof buffer, "%llu", token.val.integer);
+      snprintf(buffer, sizeof buffer, "%llu", (unsigned long long)token.val.integer);
+      extra = buffer;
+    } else if (token.tag == TOKEN_CHARACTER) {
+      snprintf(buffer, sizeof buffer, "%d", (int)token.val.integer);
       extra = buffer;
     } else if (token.tag == TOKEN_FLOATING) {
       snprintf(buffer, sizeof buffer, "%f", token.val.floating);
@@ -252,8 +513,8 @@ void dcc_log_tokens(const token_vec_t *tokens) {
     }
     dcc_log(LOG_TRACE, "%s \"%.*s\" extra=%s\n",
             dcc_token_tag_str(token.tag),
-            (int)(token.span.end - token.span.begin),
-            token.span.begin,
+            (int)token.len,
+            dcc_source_text(token.loc),
             extra);
   }
 }
@@ -266,6 +527,7 @@ char* dcc_token_tag_str(token_tag_t tag) {
     "TOKEN_STRING",
     "TOKEN_INTEGER",
     "TOKEN_REAL",
+    "TOKEN_CHARACTER",
     "TOKEN_KEYWORD_AUTO",
     "TOKEN_KEYWORD_BREAK",
     "TOKEN_KEYWORD_CASE",
@@ -349,6 +611,8 @@ char* dcc_token_tag_str(token_tag_t tag) {
     "TOKEN_LEFTEQ",
     "TOKEN_RIGHTEQ",
     "TOKEN_ELLIPSE",
+    "TOKEN_HASH",
+    "TOKEN_HASHHASH",
   };
 
   if (tag >= sizeof(STRINGS_OF_TOKENS) / sizeof(char*) ) {
@@ -23,7 +23,12 @@
 
 #pragma once
 
+#include <stdint.h>
 #include <stdlib.h>
+
+#include "diag.h"
+#include "intern.h"
+#include "source_map.h"
 #include "vec.h"
 
 typedef enum token_tag {
@@ -33,6 +38,7 @@ typedef enum token_tag {
   TOKEN_STRING,
   TOKEN_INTEGER,
   TOKEN_FLOATING,
+  TOKEN_CHARACTER,
   TOKEN_KEYWORD_AUTO,
   TOKEN_KEYWORD_BREAK,
   TOKEN_KEYWORD_CASE,
@@ -116,27 +122,43 @@ typedef enum token_tag {
   TOKEN_LEFTEQ,
   TOKEN_RIGHTEQ,
   TOKEN_ELLIPSE,
+  TOKEN_HASH,
+  TOKEN_HASHHASH,
 
   TOKEN_MAX,
 } token_tag_t;
 
+// TOKEN_STRING carries no value; its spelling is decoded on demand, see strlit.h
 typedef union {
-  uint64_t integer;
+  uint64_t integer; // also TOKEN_CHARACTER
   double floating;
-  char *string;
+  const name_t *name; // TOKEN_IDENT and keywords
 } token_val_t;
 
-typedef struct {
-  const char *begin, *end;
-} token_span_t;
+// Whitespace preceding a token, which only the preprocessor cares about
+enum token_flag {
+  TOKEN_FLAG_BOL = 1,   // first token on its line
+  TOKEN_FLAG_SPACE = 2, // preceded by whitespace or a comment
+};
 
+// Tokens refer to their spelling by location and length rather than by
+// pointer; see source_map.h. Unlike token_t pointers, locations remain
+// meaningful after the token vector is freed.
 typedef struct {
   token_tag_t tag;
+  srcloc_t loc;
+  unsigned len : 24;
+  unsigned flags : 8;
+  uint32_t hideset; // macros this token may not expand, see pp.c
   token_val_t val;
-  token_span_t span;
 } token_t;
 DECLARE_VEC(token_t, token_vec)
 
-token_vec_t dcc_tokenize(const char *input);
+// Lexical errors, such as an unterminated comment, go to `diags` if it is not
+// null
+token_vec_t dcc_tokenize(const source_file_t *file, diag_vec_t *diags);
+// Tokenize only the lines which start with `#`, for dependency scanning; the
+// others are skipped without being lexed
+token_vec_t dcc_tokenize_directives(const source_file_t *file, diag_vec_t *diags);
 void dcc_log_tokens(const token_vec_t *tokens);
 char* dcc_token_tag_str(token_tag_t tag);
@@ -0,0 +1,751 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "dcc.h"
+#include "sema.h"
+#include "type.h"
+
+DEFINE_VEC2(member_t, member_vec);
+
+// Types are carved out of large chunks rather than malloc'd one by one; like
+// names, they are never freed
+#define CHUNK_TYPES 512
+
+static struct {
+  const type_t **slots;
+  size_t size, capacity; // capacity is a power of two
+  type_t *chunk;
+  size_t chunk_left;
+} table;
+
+static uint32_t mix(uint32_t hash, uint64_t value) {
+  hash ^= (uint32_t)value ^ (uint32_t)(value >> 32);
+  hash *= 0x9e3779b1u;
+  return hash ^ (hash >> 15);
+}
+
+static uint32_t hash_type(const type_t *type) {
+  uint32_t hash = mix(type->tag, type->qual);
+  switch (type->tag) {
+  case TYPE_POINTER:
+    return mix(hash, (uintptr_t)type->base);
+  case TYPE_ARRAY:
+    return mix(mix(hash, (uintptr_t)type->array.elem), type->array.length);
+  case TYPE_FUNCTION:
+    hash = mix(hash, (uintptr_t)type->func.ret);
+    hash = mix(hash, type->func.count | (uint32_t)type->func.is_vararg << 30
+               | (uint32_t)type->func.is_prototype << 31);
+    for (uint32_t i = 0; i < type->func.count; i++) {
+      hash = mix(hash, (uintptr_t)type->func.params[i]);
+    }
+    return hash;
+  case TYPE_STRUCT:
+  case TYPE_UNION:
+  case TYPE_ENUM:
+    return mix(hash, (uintptr_t)type->record);
+  default:
+    return hash;
+  }
+}
+
+// Whether `a` and `b` would be the same type; their parts are interned already
+static bool same_type(const type_t *a, const type_t *b) {
+  if (a->tag != b->tag || a->qual != b->qual) {
+    return false;
+  }
+  switch (a->tag) {
+  case TYPE_POINTER:
+    return a->base == b->base;
+  case TYPE_ARRAY:
+    return a->array.elem == b->array.elem && a->array.length == b->array.length;
+  case TYPE_FUNCTION:
+    if (a->func.ret != b->func.ret || a->func.count != b->func.count
+        || a->func.is_vararg != b->func.is_vararg
+        || a->func.is_prototype != b->func.is_prototype) {
+      return false;
+    }
+    for (uint32_t i = 0; i < a->func.count; i++) {
+      if (a->func.params[i] != b->func.params[i]) {
+        return false;
+      }
+    }
+    return true;
+  case TYPE_STRUCT:
+  case TYPE_UNION:
+  case TYPE_ENUM:
+    return a->record == b->record;
+  default:
+    return true;
+  }
+}
+
+static void grow_table() {
+  size_t capacity = table.capacity ? table.capacity * 2 : 1024;
+  const type_t **slots = dcc_calloc(capacity, sizeof *slots);
+  for (size_t i = 0; i < table.capacity; i++) {
+    const type_t *type = table.slots[i];
+    if (!type) {
+      continue;
+    }
+    size_t j = type->hash & (capacity - 1);
+    while (slots[j]) {
+      j = (j + 1) & (capacity - 1);
+    }
+    slots[j] = type;
+  }
+  free(table.slots);
+  table.slots = slots;
+  table.capacity = capacity;
+}
+
+// The canonical type shaped like `proto`
+static const type_t* intern(type_t proto) {
+  // made first, since interning it may grow the table
+  proto.unqual = 0;
+  if (proto.qual) {
+    type_t unqual = proto;
+    unqual.qual = TYPE_QUAL_NONE;
+    proto.unqual = intern(unqual);
+  }
+
+  if ((table.size + 1) * 2 > table.capacity) {
+    grow_table();
+  }
+  proto.hash = hash_type(&proto);
+  size_t i = proto.hash & (table.capacity - 1);
+  for (const type_t *type; (type = table.slots[i]); i = (i + 1) & (table.capacity - 1)) {
+    if (type->hash == proto.hash && same_type(type, &proto)) {
+      return type;
+    }
+  }
+
+  if (!table.chunk_left) {
+    table.chunk = dcc_malloc(CHUNK_TYPES * sizeof(type_t));
+    table.chunk_left = CHUNK_TYPES;
+  }
+  type_t *type = table.chunk++;
+  table.chunk_left--;
+  *type = proto;
+  if (!type->unqual) {
+    type->unqual = type;
+  }
+  if (type->tag == TYPE_FUNCTION && type->func.count) {
+    size_t size = type->func.count * sizeof(const type_t*);
+    type->func.params = memcpy(dcc_malloc(size), proto.func.params, size);
+  }
+
+  table.slots[i] = type;
+  table.size++;
+  return type;
+}
+
+static type_t proto_type(enum type_tag tag) {
+  type_t proto;
+  memset(&proto, 0, sizeof proto);
+  proto.tag = tag;
+  return proto;
+}
+
+const type_t* dcc_type_basic(enum type_tag tag) {
+  static const type_t *basics[TYPE_LDOUBLE + 1];
+  dcc_assert(tag <= TYPE_LDOUBLE);
+  if (!basics[tag]) {
+    basics[tag] = intern(proto_type(tag));
+  }
+  return basics[tag];
+}
+
+const type_t* dcc_type_qualified(const type_t *type, type_qual_t qual) {
+  if ((type->qual | qual) == type->qual) {
+    return type;
+  }
+  // qualifying an array qualifies its elements
+  if (type->tag == TYPE_ARRAY) {
+    return dcc_type_array(dcc_type_qualified(type->array.elem, qual), type->array.length);
+  }
+  type_t proto = *type;
+  proto.qual |= qual;
+  return intern(proto);
+}
+
+const type_t* dcc_type_pointer(const type_t *base) {
+  type_t proto = proto_type(TYPE_POINTER);
+  proto.base = base;
+  return intern(proto);
+}
+
+const type_t* dcc_type_array(const type_t *elem, int64_t length) {
+  type_t proto = proto_type(TYPE_ARRAY);
+  proto.array.elem = elem;
+  proto.array.length = length < 0 ? ARRAY_LENGTH_UNKNOWN : length;
+  return intern(proto);
+}
+
+const type_t* dcc_type_function(const type_t *ret, const type_t **params, uint32_t count,
+                                bool is_vararg, bool is_prototype) {
+  type_t proto = proto_type(TYPE_FUNCTION);
+  proto.func.ret = ret;
+  proto.func.params = params;
+  proto.func.count = count;
+  proto.func.is_vararg = is_vararg;
+  proto.func.is_prototype = is_prototype;
+  return intern(proto);
+}
+
+const type_t* dcc_type_record(enum type_tag tag, struct symbol *symbol) {
+  dcc_assert(tag == TYPE_STRUCT || tag == TYPE_UNION || tag == TYPE_ENUM);
+  record_t *record = dcc_calloc(1, sizeof *record);
+  record->tag = symbol;
+  record->members = member_vec_new();
+  record->by_name = dcc_ptrmap_new();
+
+  type_t proto = proto_type(tag);
+  proto.record = record;
+  return intern(proto);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Layout
+////////////////////////////////////////////////////////////////////////////////
+
+uint64_t dcc_type_size(const type_t *type) {
+  switch (type->tag) {
+  case TYPE_VOID:
+  case TYPE_FUNCTION:
+    return 1; // as GNU C has it for pointer arithmetic
+  case TYPE_BOOL:
+  case TYPE_CHAR:
+  case TYPE_SCHAR:
+  case TYPE_UCHAR:
+    return 1;
+  case TYPE_SHORT:
+  case TYPE_USHORT:
+    return 2;
+  case TYPE_INT:
+  case TYPE_UINT:
+  case TYPE_FLOAT:
+  case TYPE_ENUM:
+    return 4;
+  case TYPE_LONG:
+  case TYPE_ULONG:
+  case TYPE_LLONG:
+  case TYPE_ULLONG:
+  case TYPE_DOUBLE:
+  case TYPE_POINTER:
+    return 8;
+  case TYPE_LDOUBLE:
+    return 16;
+  case TYPE_ARRAY:
+    return type->array.length < 0 ? 0 : type->array.length * dcc_type_size(type->array.elem);
+  case TYPE_STRUCT:
+  case TYPE_UNION:
+    return type->record->size;
+  }
+  return 0;
+}
+
+uint32_t dcc_type_align(const type_t *type) {
+  switch (type->tag) {
+  case TYPE_ARRAY:
+    return dcc_type_align(type->array.elem);
+  case TYPE_STRUCT:
+  case TYPE_UNION:
+    return type->record->align;
+  default:
+    return dcc_type_size(type);
+  }
+}
+
+static uint64_t round_up(uint64_t value, uint64_t align) {
+  return (value + align - 1) / align * align;
+}
+
+// System V layout. Bit-fields are packed into storage units of their declared
+// type and start a new unit rather than straddle one; an unnamed zero-width
+// bit-field closes the current unit.
+void dcc_record_complete(record_t *record, bool is_union, const member_t *members,
+                         size_t count) {
+  uint64_t bits = 0, size = 0;
+  uint32_t align = 1;
+  for (size_t i = 0; i < count; i++) {
+    member_t member = members[i];
+    uint64_t unit = dcc_type_size(member.type) * 8;
+    uint32_t member_align = dcc_type_align(member.type);
+    bool is_bitfield = member.bit_width || !member.name;
+
+    if (is_union) {
+      bits = 0;
+    }
+    if (is_bitfield) {
+      if (!member.bit_width || bits / unit != (bits + member.bit_width - 1) / unit) {
+        bits = round_up(bits, unit);
+      }
+      member.offset = bits / unit * (unit / 8);
+      member.bit_offset = bits - member.offset * 8;
+      bits += member.bit_width;
+    } else {
+      bits = round_up(bits, member_align * 8);
+      member.offset = bits / 8;
+      bits += dcc_type_size(member.type) * 8;
+    }
+    if (member.name || !is_bitfield) {
+      align = member_align > align ? member_align : align;
+    }
+    size = bits > size ? bits : size;
+
+    member_vec_push(&record->members, member);
+    if (member.name) {
+      dcc_ptrmap_put(&record->by_name, member.name,
+                     (void*)(uintptr_t)record->members.size);
+    }
+  }
+
+  record->size = round_up((size + 7) / 8, align);
+  record->align = align;
+  record->complete = true;
+}
+
+void dcc_enum_complete(record_t *record) {
+  record->size = record->align = 4;
+  record->complete = true;
+}
+
+const member_t* dcc_record_member(const record_t *record, const name_t *name) {
+  uintptr_t index = (uintptr_t)dcc_ptrmap_get(&record->by_name, name);
+  return index ? &record->members.data[index - 1] : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Classification
+////////////////////////////////////////////////////////////////////////////////
+
+bool dcc_type_is_integer(const type_t *type) {
+  return (type->tag >= TYPE_BOOL && type->tag <= TYPE_ULLONG) || type->tag == TYPE_ENUM;
+}
+
+bool dcc_type_is_arithmetic(const type_t *type) {
+  return dcc_type_is_integer(type) || dcc_type_is_float(type);
+}
+
+bool dcc_type_is_float(const type_t *type) {
+  return type->tag >= TYPE_FLOAT && type->tag <= TYPE_LDOUBLE;
+}
+
+bool dcc_type_is_record(const type_t *type) {
+  return type->tag == TYPE_STRUCT || type->tag == TYPE_UNION;
+}
+
+bool dcc_type_is_scalar(const type_t *type) {
+  return dcc_type_is_arithmetic(type) || type->tag == TYPE_POINTER;
+}
+
+bool dcc_type_is_signed(const type_t *type) {
+  switch (type->tag) {
+  case TYPE_CHAR:
+  case TYPE_SCHAR:
+  case TYPE_SHORT:
+  case TYPE_INT:
+  case TYPE_LONG:
+  case TYPE_LLONG:
+  case TYPE_ENUM:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool dcc_type_is_complete(const type_t *type) {
+  switch (type->tag) {
+  case TYPE_VOID:
+  case TYPE_FUNCTION:
+    return false;
+  case TYPE_ARRAY:
+    return type->array.length >= 0 && dcc_type_is_complete(type->array.elem);
+  case TYPE_STRUCT:
+  case TYPE_UNION:
+  case TYPE_ENUM:
+    return type->record->complete;
+  default:
+    return true;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Conversions
+////////////////////////////////////////////////////////////////////////////////
+
+// Integer conversion rank; the tags of unsigned types follow their signed ones
+static int rank(const type_t *type) {
+  switch (type->tag) {
+  case TYPE_BOOL:
+    return 0;
+  case TYPE_CHAR:
+  case TYPE_SCHAR:
+  case TYPE_UCHAR:
+    return 1;
+  case TYPE_SHORT:
+  case TYPE_USHORT:
+    return 2;
+  case TYPE_INT:
+  case TYPE_UINT:
+  case TYPE_ENUM:
+    return 3;
+  case TYPE_LONG:
+  case TYPE_ULONG:
+    return 4;
+  default:
+    return 5;
+  }
+}
+
+const type_t* dcc_type_decay(const type_t *type) {
+  if (type->tag == TYPE_ARRAY) {
+    return dcc_type_pointer(type->array.elem);
+  } else if (type->tag == TYPE_FUNCTION) {
+    return dcc_type_pointer(type);
+  }
+  return type;
+}
+
+const type_t* dcc_type_promote(const type_t *type) {
+  // every type of lower rank fits in an int
+  if (dcc_type_is_integer(type) && rank(type) <= 3 && type->unqual->tag != TYPE_UINT) {
+    return dcc_type_basic(TYPE_INT);
+  }
+  return type->unqual;
+}
+
+const type_t* dcc_type_common(const type_t *a, const type_t *b) {
+  if (a->tag == TYPE_LDOUBLE || b->tag == TYPE_LDOUBLE) {
+    return dcc_type_basic(TYPE_LDOUBLE);
+  } else if (a->tag == TYPE_DOUBLE || b->tag == TYPE_DOUBLE) {
+    return dcc_type_basic(TYPE_DOUBLE);
+  } else if (a->tag == TYPE_FLOAT || b->tag == TYPE_FLOAT) {
+    return dcc_type_basic(TYPE_FLOAT);
+  }
+
+  a = dcc_type_promote(a);
+  b = dcc_type_promote(b);
+  if (a == b) {
+    return a;
+  } else if (dcc_type_is_signed(a) == dcc_type_is_signed(b)) {
+    return rank(a) >= rank(b) ? a : b;
+  }
+  const type_t *sign = dcc_type_is_signed(a) ? a : b, *unsign = sign == a ? b : a;
+  if (rank(unsign) >= rank(sign)) {
+    return unsign;
+  } else if (dcc_type_size(sign) > dcc_type_size(unsign)) {
+    return sign; // it can represent every value of the unsigned type
+  }
+  return dcc_type_basic(sign->tag + 1);
+}
+
+const type_t* dcc_type_operation(enum exp_tag op, const type_t *lhs, const type_t *rhs) {
+  if (op == EXP_SHIFTLEFT || op == EXP_SHIFTRIGHT) {
+    return dcc_type_promote(lhs);
+  }
+  return dcc_type_common(lhs, rhs);
+}
+
+const type_t* dcc_type_comparison(const type_t *a, const type_t *b) {
+  if (dcc_type_is_arithmetic(a) && dcc_type_is_arithmetic(b)) {
+    return dcc_type_common(a, b);
+  }
+  return dcc_type_basic(TYPE_ULONG);
+}
+
+const type_t* dcc_type_argument(const type_t *func, size_t i, const type_t *type) {
+  if (func->func.is_prototype && i < func->func.count) {
+    return func->func.params[i]->unqual;
+  } else if (type->tag == TYPE_FLOAT) {
+    return dcc_type_basic(TYPE_DOUBLE);
+  }
+  return dcc_type_is_integer(type) ? dcc_type_promote(type) : type->unqual;
+}
+
+uint64_t dcc_type_step(const type_t *pointer) {
+  return dcc_type_size(pointer->base);
+}
+
+static bool classify_at(const type_t *type, uint64_t offset, abi_class_t classes[2]) {
+  type = type->unqual;
+  switch (type->tag) {
+  case TYPE_ARRAY: {
+    uint64_t size = dcc_type_size(type->array.elem);
+    for (int64_t i = 0; i < type->array.length; i++) {
+      if (!classify_at(type->array.elem, offset + i * size, classes)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  case TYPE_STRUCT:
+  case TYPE_UNION: {
+    member_vec_t *members = &type->record->members;
+    for (size_t i = 0; i < members->size; i++) {
+      const member_t *member = &members->data[i];
+      if (!classify_at(member->type, offset + member->offset, classes)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  case TYPE_LDOUBLE:
+    return false;
+  default: {
+    abi_class_t *class = &classes[offset / 8];
+    if (*class != CLASS_INTEGER) {
+      *class = dcc_type_is_float(type) ? CLASS_SSE : CLASS_INTEGER;
+    }
+    return true;
+  }
+  }
+}
+
+int dcc_type_classify(const type_t *type, abi_class_t classes[2]) {
+  uint64_t size = dcc_type_size(type);
+  classes[0] = classes[1] = CLASS_NONE;
+  if (size == 0 || size > 16 || !classify_at(type, 0, classes)) {
+    return 0;
+  }
+  int count = (size + 7) / 8;
+  for (int i = 0; i < count; i++) {
+    if (classes[i] == CLASS_NONE) {
+      classes[i] = CLASS_SSE;
+    }
+  }
+  return count;
+}
+
+int dcc_type_count_class(const abi_class_t classes[2], int count, abi_class_t class) {
+  int n = 0;
+  for (int i = 0; i < count; i++) {
+    n += classes[i] == class;
+  }
+  return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Compatibility
+////////////////////////////////////////////////////////////////////////////////
+
+// Enums are compatible with int, their underlying type
+static bool enum_and_int(const type_t *a, const type_t *b) {
+  return (a->tag == TYPE_ENUM && b->tag == TYPE_INT)
+    || (a->tag == TYPE_INT && b->tag == TYPE_ENUM);
+}
+
+bool dcc_type_compatible(const type_t *a, const type_t *b) {
+  return dcc_type_composite(a, b) != 0;
+}
+
+const type_t* dcc_type_composite(const type_t *a, const type_t *b) {
+  if (a == b) {
+    return a;
+  }
+  if (a->qual != b->qual) {
+    return 0;
+  }
+  if (enum_and_int(a, b)) {
+    return a->tag == TYPE_ENUM ? a : b;
+  }
+  if (a->tag != b->tag) {
+    return 0;
+  }
+
+  const type_t *composite;
+  switch (a->tag) {
+  case TYPE_POINTER:
+    composite = dcc_type_composite(a->base, b->base);
+    if (!composite) {
+      return 0;
+    }
+    composite = dcc_type_pointer(composite);
+    break;
+  case TYPE_ARRAY:
+    composite = dcc_type_composite(a->array.elem, b->array.elem);
+    if (!composite || (a->array.length >= 0 && b->array.length >= 0
+                       && a->array.length != b->array.length)) {
+      return 0;
+    }
+    composite = dcc_type_array(composite, a->array.length >= 0 ? a->array.length
+                               : b->array.length);
+    break;
+  case TYPE_FUNCTION: {
+    const type_t *ret = dcc_type_composite(a->func.ret, b->func.ret);
+    if (!ret) {
+      return 0;
+    }
+    // without a prototype, a declaration says nothing about the parameters
+    if (!a->func.is_prototype || !b->func.is_prototype) {
+      const type_t *proto = a->func.is_prototype ? a : b;
+      return dcc_type_function(ret, proto->func.params, proto->func.count,
+                               proto->func.is_vararg, proto->func.is_prototype);
+    }
+    if (a->func.count != b->func.count || a->func.is_vararg != b->func.is_vararg) {
+      return 0;
+    }
+    const type_t *params[a->func.count + 1];
+    for (uint32_t i = 0; i < a->func.count; i++) {
+      // parameter qualifiers are not part of the function type
+      params[i] = dcc_type_composite(a->func.params[i]->unqual, b->func.params[i]->unqual);
+      if (!params[i]) {
+        return 0;
+      }
+    }
+    return dcc_type_function(ret, params, a->func.count, a->func.is_vararg, true);
+  }
+  default:
+    // basic types are identical if compatible, and records are nominal
+    return 0;
+  }
+  return dcc_type_qualified(composite, a->qual);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Spelling
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  char *data;
+  size_t size, capacity;
+} buffer_t;
+
+static void append(buffer_t *buffer, const char *format, ...) {
+  va_list vlist;
+  va_start(vlist, format);
+  int len = vsnprintf(0, 0, format, vlist);
+  va_end(vlist);
+
+  if (buffer->size + len + 1 > buffer->capacity) {
+    buffer->capacity = 2 * (buffer->size + len + 1);
+    buffer->data = dcc_realloc(buffer->data, buffer->capacity);
+  }
+  va_start(vlist, format);
+  vsnprintf(buffer->data + buffer->size, len + 1, format, vlist);
+  va_end(vlist);
+  buffer->size += len;
+}
+
+static void append_quals(buffer_t *buffer, type_qual_t qual, const char *separator) {
+  static const struct { type_qual_t qual; const char *str; } QUALS[] = {
+    { TYPE_QUAL_CONST, "const" },
+    { TYPE_QUAL_VOLATILE, "volatile" },
+    { TYPE_QUAL_RESTRICT, "restrict" },
+  };
+  for (int i = 0; i < 3; i++) {
+    if (qual & QUALS[i].qual) {
+      append(buffer, "%s%s", QUALS[i].str, separator);
+    }
+  }
+}
+
+static bool wraps(const type_t *type) {
+  return type->tag == TYPE_ARRAY || type->tag == TYPE_FUNCTION;
+}
+
+// Declarators read inside out, so the base type and any pointers come before
+// the name and arrays and parameters after it
+static void spell_prefix(buffer_t *buffer, const type_t *type) {
+  static const char *BASIC[] = {
+    "void", "_Bool", "char", "signed char", "unsigned char", "short",
+    "unsigned short", "int", "unsigned int", "long", "unsigned long",
+    "long long", "unsigned long long", "float", "double", "long double",
+  };
+
+  switch (type->tag) {
+  case TYPE_POINTER:
+    spell_prefix(buffer, type->base);
+    char last = buffer->size ? buffer->data[buffer->size - 1] : '(';
+    append(buffer, "%s%s", last == '*' || last == '(' ? "" : " ",
+           wraps(type->base) ? "(*" : "*");
+    append_quals(buffer, type->qual, "");
+    break;
+  case TYPE_ARRAY:
+    spell_prefix(buffer, type->array.elem);
+    break;
+  case TYPE_FUNCTION:
+    spell_prefix(buffer, type->func.ret);
+    break;
+  case TYPE_STRUCT:
+  case TYPE_UNION:
+  case TYPE_ENUM: {
+    const char *kind = type->tag == TYPE_STRUCT ? "struct"
+      : type->tag == TYPE_UNION ? "union" : "enum";
+    const name_t *name = type->record->tag ? type->record->tag->name : 0;
+    append_quals(buffer, type->qual, " ");
+    append(buffer, "%s %s", kind, name ? name->str : "<anonymous>");
+    break;
+  }
+  default:
+    append_quals(buffer, type->qual, " ");
+    append(buffer, "%s", BASIC[type->tag]);
+    break;
+  }
+}
+
+static void spell_suffix(buffer_t *buffer, const type_t *type) {
+  switch (type->tag) {
+  case TYPE_POINTER:
+    if (wraps(type->base)) {
+      append(buffer, ")");
+    }
+    spell_suffix(buffer, type->base);
+    break;
+  case TYPE_ARRAY:
+    if (type->array.length < 0) {
+      append(buffer, "[]");
+    } else {
+      append(buffer, "[%lld]", (long long)type->array.length);
+    }
+    spell_suffix(buffer, type->array.elem);
+    break;
+  case TYPE_FUNCTION:
+    append(buffer, "(");
+    for (uint32_t i = 0; i < type->func.count; i++) {
+      char *param = dcc_type_str(type->func.params[i]);
+      append(buffer, "%s%s", i ? ", " : "", param);
+      free(param);
+    }
+    if (type->func.is_vararg) {
+      append(buffer, ", ...");
+    } else if (type->func.is_prototype && !type->func.count) {
+      append(buffer, "void");
+    }
+    append(buffer, ")");
+    spell_suffix(buffer, type->func.ret);
+    break;
+  default:
+    break;
+  }
+}
+
+char* dcc_type_str(const type_t *type) {
+  buffer_t buffer = { 0, 0, 0 };
+  spell_prefix(&buffer, type);
+  char last = buffer.data[buffer.size - 1];
+  if (wraps(type) && last != '*' && last != '(') {
+    append(&buffer, " ");
+  }
+  spell_suffix(&buffer, type);
+  return buffer.data;
+}
@@ -0,0 +1,168 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Canonical types. Every type is interned in a global hash-cons table, so two
+  types are identical exactly when their pointers are equal and compatibility
+  only needs a structural walk for the few cases C allows to differ (unknown
+  array lengths, unprototyped functions, enums). Structs, unions and enums are
+  nominal: each tag owns a record whose layout is computed once, when its
+  member list is complete. Types are never freed.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "intern.h"
+#include "parse.h"
+#include "ptrmap.h"
+
+typedef struct type type_t;
+
+typedef struct {
+  const name_t *name; // null for an unnamed bit-field
+  const type_t *type;
+  uint64_t offset; // in bytes, of the storage unit for a bit-field
+  uint8_t bit_offset, bit_width; // bit_width is zero unless a bit-field
+} member_t;
+DECLARE_VEC(member_t, member_vec);
+
+typedef struct record {
+  struct symbol *tag;
+  bool complete;
+  member_vec_t members;
+  ptrmap_t by_name; // name -> member_t index + 1
+  uint64_t size;
+  uint32_t align;
+} record_t;
+
+struct type {
+  enum type_tag {
+    TYPE_VOID,
+    TYPE_BOOL,
+    TYPE_CHAR,
+    TYPE_SCHAR,
+    TYPE_UCHAR,
+    TYPE_SHORT,
+    TYPE_USHORT,
+    TYPE_INT,
+    TYPE_UINT,
+    TYPE_LONG,
+    TYPE_ULONG,
+    TYPE_LLONG,
+    TYPE_ULLONG,
+    TYPE_FLOAT,
+    TYPE_DOUBLE,
+    TYPE_LDOUBLE,
+    TYPE_POINTER,
+    TYPE_ARRAY,
+    TYPE_FUNCTION,
+    TYPE_STRUCT,
+    TYPE_UNION,
+    TYPE_ENUM,
+  } tag;
+  type_qual_t qual;
+  const type_t *unqual; // this type without qualifiers, possibly itself
+  uint32_t hash;
+  union {
+    const type_t *base; // TYPE_POINTER
+    struct {
+      const type_t *elem;
+      int64_t length; // negative if unknown
+    } array;
+    struct {
+      const type_t *ret;
+      const type_t **params;
+      uint32_t count;
+      bool is_vararg;
+      bool is_prototype; // false for `()` and identifier lists
+    } func;
+    record_t *record; // TYPE_STRUCT, TYPE_UNION and TYPE_ENUM
+  };
+};
+
+#define ARRAY_LENGTH_UNKNOWN -1
+
+const type_t* dcc_type_basic(enum type_tag tag);
+const type_t* dcc_type_qualified(const type_t *type, type_qual_t qual);
+const type_t* dcc_type_pointer(const type_t *base);
+const type_t* dcc_type_array(const type_t *elem, int64_t length);
+const type_t* dcc_type_function(const type_t *ret, const type_t **params, uint32_t count,
+                                bool is_vararg, bool is_prototype);
+// A new, incomplete struct, union or enum type for the tag `tag`
+const type_t* dcc_type_record(enum type_tag tag, struct symbol *symbol);
+
+// Lay out a struct or union from its members, which are copied
+void dcc_record_complete(record_t *record, bool is_union, const member_t *members,
+                         size_t count);
+// An enum is complete once its enumerators are
+void dcc_enum_complete(record_t *record);
+const member_t* dcc_record_member(const record_t *record, const name_t *name);
+
+bool dcc_type_is_integer(const type_t *type);
+bool dcc_type_is_arithmetic(const type_t *type);
+bool dcc_type_is_scalar(const type_t *type);
+bool dcc_type_is_float(const type_t *type);
+// Structs and unions, but not the arrays C also counts as aggregates
+bool dcc_type_is_record(const type_t *type);
+// Plain char is signed, as in the System V ABI
+bool dcc_type_is_signed(const type_t *type);
+bool dcc_type_is_complete(const type_t *type);
+
+// Size and alignment in bytes; only meaningful for complete object types
+uint64_t dcc_type_size(const type_t *type);
+uint32_t dcc_type_align(const type_t *type);
+
+// The type of an array or function operand once it decays to a pointer
+const type_t* dcc_type_decay(const type_t *type);
+// The integer promotions, which leave other types unqualified but unchanged
+const type_t* dcc_type_promote(const type_t *type);
+// The common type of arithmetic operands under the usual arithmetic conversions
+const type_t* dcc_type_common(const type_t *a, const type_t *b);
+// The type `lhs op rhs` is computed in, once pointer arithmetic is set aside
+const type_t* dcc_type_operation(enum exp_tag op, const type_t *lhs, const type_t *rhs);
+// The type operands of a relational or equality operator are compared in,
+// where pointers compare as addresses
+const type_t* dcc_type_comparison(const type_t *a, const type_t *b);
+// The type argument `i` of type `type` is passed to the function type `func`
+// as, after the default argument promotions where there is no parameter
+const type_t* dcc_type_argument(const type_t *func, size_t i, const type_t *type);
+// The size pointer arithmetic on `pointer` steps by, where void and functions
+// count as one
+uint64_t dcc_type_step(const type_t *pointer);
+
+// System V classes of the eightbytes of an argument
+typedef enum abi_class {
+  CLASS_NONE,
+  CLASS_INTEGER,
+  CLASS_SSE,
+} abi_class_t;
+
+// The classes of the eightbytes of a struct or union, returning how many there
+// are, or zero if it is passed in memory
+int dcc_type_classify(const type_t *type, abi_class_t classes[2]);
+int dcc_type_count_class(const abi_class_t classes[2], int count, abi_class_t class);
+
+bool dcc_type_compatible(const type_t *a, const type_t *b);
+// The composite of two compatible types, or null if they are not compatible
+const type_t* dcc_type_composite(const type_t *a, const type_t *b);
+
+// Spell `type` as C would, for diagnostics. The string must be freed.
+char* dcc_type_str(const type_t *type);
@@ -51,14 +51,18 @@
     vec->data[vec->size++] = elem;                                        \
   }
 
-#define DEFINE_VEC_FREE(type, name, destructor) \
-  void name##_free(name##_t *vec) {             \
-    if (destructor) {                           \
-      VEC_FOREACH_PTR(type, elem, vec) {        \
-        (destructor)(elem);                     \
-      }                                         \
-    }                                           \
-    free(vec->data);                            \
+#define DEFINE_VEC_FREE(type, name)   \
+  void name##_free(name##_t *vec) {   \
+    free(vec->data);                  \
+  }
+
+// Likewise, calling `destructor` on a pointer to each element first
+#define DEFINE_VEC_FREE_WITH(type, name, destructor) \
+  void name##_free(name##_t *vec) {                  \
+    VEC_FOREACH_PTR(type, elem, vec) {               \
+      (destructor)(elem);                            \
+    }                                                \
+    free(vec->data);                                 \
   }
 
 #define DEFINE_VEC_LAST(type, name)                         \
@@ -72,14 +76,19 @@
     return vec->data[--vec->size]; \
   }
 
-#define DEFINE_VEC3(type, name, destructor) \
-  DEFINE_VEC_NEW(type, name)                \
-  DEFINE_VEC_PUSH(type, name)               \
-  DEFINE_VEC_FREE(type, name, destructor)   \
-  DEFINE_VEC_LAST(type, name)               \
+#define DEFINE_VEC3(type, name, destructor)    \
+  DEFINE_VEC_NEW(type, name)                   \
+  DEFINE_VEC_PUSH(type, name)                  \
+  DEFINE_VEC_FREE_WITH(type, name, destructor) \
+  DEFINE_VEC_LAST(type, name)                  \
   DEFINE_VEC_POP(type, name)
 
-#define DEFINE_VEC2(type, name) DEFINE_VEC3(type, name, (void(*)(type *))0)
+#define DEFINE_VEC2(type, name)  \
+  DEFINE_VEC_NEW(type, name)     \
+  DEFINE_VEC_PUSH(type, name)    \
+  DEFINE_VEC_FREE(type, name)    \
+  DEFINE_VEC_LAST(type, name)    \
+  DEFINE_VEC_POP(type, name)
 
 #define VEC_FOREACH(type, elem, vec) \
   int __i = 0;                       \
@@ -18,3 +18,5 @@
 #include "vec.h"
 #include "vec_types.h"
 DEFINE_VEC2(int, int_vec);
+DEFINE_VEC2(uint8_t, uint8_vec);
+DEFINE_VEC2(uint32_t, uint32_vec);
@@ -17,5 +17,9 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #include "vec.h"
 DECLARE_VEC(int, int_vec);
+DECLARE_VEC(uint8_t, uint8_vec);
+DECLARE_VEC(uint32_t, uint32_vec);
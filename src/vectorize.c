@@ -0,0 +1,579 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdlib.h>
+
+#include "alias.h"
+#include "loop.h"
+#include "ssa.h"
+#include "vectorize.h"
+
+#define VECTOR_SIZE 16
+
+// An induction variable: a phi of the header that steps by a constant
+typedef struct {
+  ir_ref_t phi, next;
+  ir_ref_t init; // from the preheader
+  int64_t step;
+  ir_ref_t vector; // the phi of the vector loop, if accesses go through it
+} vec_iv_t;
+DECLARE_VEC(vec_iv_t, vec_iv_vec);
+DEFINE_VEC2(vec_iv_t, vec_iv_vec);
+
+// A load or store through an induction variable, whose first address may be a
+// constant offset from its root
+typedef struct {
+  ir_ref_t ref;
+  uint32_t iv;
+  uint32_t position; // in the body
+  ir_ref_t root;
+  int64_t offset;
+  bool is_exact;
+} access_t;
+DECLARE_VEC(access_t, access_vec);
+DEFINE_VEC2(access_t, access_vec);
+
+typedef struct {
+  ir_func_t *func;
+  ir_loops_t *loops;
+  ir_alias_t alias;
+  uint32_t loop;
+  uint32_t preheader, header;
+  uint32_t pre, latch; // the indexes of the preheader and the latch among preds
+  ir_ref_t compare;
+  enum ir_op cond; // IR_SLT, IR_ULT or IR_NE, of the counter and the bound
+  uint32_t counter;
+  ir_ref_t bound;
+  ir_kind_t lane; // of every value the body computes
+  vec_iv_vec_t ivs;
+  access_vec_t accesses;
+  uint32_vec_t body; // the instructions to vectorize, in order
+  uint32_vec_t checks; // pairs of accesses that may overlap
+  uint32_t count; // instructions before vectorizing
+  bool *is_vectorized;
+  ir_ref_t *map; // the vector of each instruction of the body
+  ir_ref_t *splats; // the vector of each invariant value
+} vectorizer_t;
+
+static uint8_t lane_size(ir_kind_t kind) {
+  switch (kind) {
+  case IR_I8: return 1;
+  case IR_I16: return 2;
+  case IR_I32:
+  case IR_F32: return 4;
+  default: return 8;
+  }
+}
+
+static bool is_leaf(enum ir_op op) {
+  return op == IR_CONST || op == IR_FCONST || op == IR_GLOBAL || op == IR_STRING
+    || op == IR_SLOT;
+}
+
+static bool is_invariant(const vectorizer_t *v, ir_ref_t ref) {
+  const ir_instr_t *instr = &v->func->instrs.data[ref];
+  return is_leaf(instr->op) || !dcc_ir_in_loop(v->loops, v->loop, instr->block);
+}
+
+static uint32_t iv_of(const vectorizer_t *v, ir_ref_t phi) {
+  for (uint32_t i = 0; i < v->ivs.size; i++) {
+    if (v->ivs.data[i].phi == phi) {
+      return i;
+    }
+  }
+  return IR_NONE;
+}
+
+static bool is_iv_step(const vectorizer_t *v, ir_ref_t ref) {
+  for (uint32_t i = 0; i < v->ivs.size; i++) {
+    if (v->ivs.data[i].next == ref) {
+      return true;
+    }
+  }
+  return false;
+}
+
+////
+// Analysis
+
+// Whether the loop is a header that may exit, then a line of blocks back to it
+static bool is_counted(vectorizer_t *v) {
+  ir_func_t *func = v->func;
+  const ir_loop_t *loop = &v->loops->loops.data[v->loop];
+  if (!loop->is_innermost || loop->preheader == IR_NONE || loop->latches.size != 1) {
+    return false;
+  }
+  v->header = loop->header;
+  v->preheader = loop->preheader;
+  const ir_block_t *header = &func->blocks.data[v->header];
+  if (header->preds.size != 2) {
+    return false;
+  }
+  v->pre = header->preds.data[0] != v->preheader;
+  v->latch = !v->pre;
+  ir_ref_t br = dcc_ir_terminator(func, v->header);
+  if (func->instrs.data[br].op != IR_BR
+      || !dcc_ir_in_loop(v->loops, v->loop, header->succs.data[0])
+      || dcc_ir_in_loop(v->loops, v->loop, header->succs.data[1])) {
+    return false;
+  }
+  uint32_t count = 1;
+  for (uint32_t b = header->succs.data[0]; b != v->header; count++) {
+    ir_ref_t jmp = dcc_ir_terminator(func, b);
+    if (!dcc_ir_in_loop(v->loops, v->loop, b) || func->instrs.data[jmp].op != IR_JMP
+        || count > loop->blocks.size) {
+      return false;
+    }
+    b = func->blocks.data[b].succs.data[0];
+  }
+  if (count != loop->blocks.size) {
+    return false;
+  }
+  v->compare = func->instrs.data[br].args[0];
+  return func->instrs.data[v->compare].block == v->header;
+}
+
+// Whether every phi of the header is an induction variable, and the exit
+// compares one of them, the counter, with an invariant bound
+static bool find_ivs(vectorizer_t *v) {
+  ir_func_t *func = v->func;
+  const uint32_vec_t *instrs = &func->blocks.data[v->header].instrs;
+  for (size_t k = 0; k < instrs->size; k++) {
+    ir_ref_t ref = instrs->data[k];
+    const ir_instr_t *instr = &func->instrs.data[ref];
+    if (instr->op != IR_PHI) {
+      if (!is_leaf(instr->op) && ref != v->compare && !dcc_ir_is_terminator(instr->op)) {
+        return false;
+      }
+      continue;
+    } else if (instr->kind != IR_I32 && instr->kind != IR_I64) {
+      return false;
+    }
+    ir_ref_t next = instr->args[v->latch];
+    const ir_instr_t *add = &func->instrs.data[next];
+    if (add->op != IR_ADD || add->kind != instr->kind || is_invariant(v, next)) {
+      return false;
+    }
+    ir_ref_t step = add->args[0] == ref ? add->args[1] : add->args[1] == ref ? add->args[0]
+      : IR_NONE;
+    int64_t value;
+    if (step == IR_NONE || !is_invariant(v, step) || !dcc_ir_constant_value(func, step, &value)) {
+      return false;
+    }
+    vec_iv_t iv = { ref, next, instr->args[v->pre], value, IR_NONE };
+    vec_iv_vec_push(&v->ivs, iv);
+  }
+
+  const ir_instr_t *compare = &func->instrs.data[v->compare];
+  v->cond = compare->op;
+  v->counter = iv_of(v, compare->args[0]);
+  v->bound = compare->args[1];
+  if (v->cond == IR_SGT || v->cond == IR_UGT) {
+    v->cond = v->cond == IR_SGT ? IR_SLT : IR_ULT;
+    v->counter = iv_of(v, compare->args[1]);
+    v->bound = compare->args[0];
+  }
+  if ((v->cond != IR_SLT && v->cond != IR_ULT && v->cond != IR_NE)
+      || v->counter == IR_NONE || !is_invariant(v, v->bound)) {
+    return false;
+  }
+  int64_t step = v->ivs.data[v->counter].step;
+  return step > 0 && !(step & (step - 1)) && (v->cond != IR_NE || step == 1);
+}
+
+// Whether a kind of values may be the lanes of the body's vectors
+static bool set_lane(vectorizer_t *v, ir_kind_t kind) {
+  if (v->lane == IR_VOID) {
+    v->lane = kind;
+  }
+  return kind == v->lane && kind != IR_VOID && !dcc_ir_is_vector(kind);
+}
+
+// Whether an operation has a vector form for the lanes
+static bool has_vector_op(const vectorizer_t *v, const ir_instr_t *instr) {
+  bool is_float = v->lane == IR_F32 || v->lane == IR_F64;
+  uint8_t size = lane_size(v->lane);
+  switch (instr->op) {
+  case IR_ADD: case IR_SUB: case IR_AND: case IR_OR: case IR_XOR: case IR_NEG: case IR_NOT:
+    return !is_float;
+  case IR_MUL:
+    return size == 2 || (size == 4 && !is_float);
+  case IR_SHL: case IR_SHR: case IR_SAR: {
+    int64_t count;
+    bool has_shift = size == 2 || size == 4 || (size == 8 && instr->op != IR_SAR);
+    return !is_float && has_shift && is_invariant(v, instr->args[1])
+      && dcc_ir_constant_value(v->func, instr->args[1], &count) && count >= 0 && count < size * 8;
+  }
+  case IR_FADD: case IR_FSUB: case IR_FMUL: case IR_FDIV:
+    return is_float;
+  default:
+    return false;
+  }
+}
+
+static bool is_operand(const vectorizer_t *v, ir_ref_t ref) {
+  return v->is_vectorized[ref] || is_invariant(v, ref);
+}
+
+// Whether the body is loads, stores and arithmetic on one kind of lane,
+// addressed by induction variables that step by the size of a lane
+static bool find_body(vectorizer_t *v) {
+  ir_func_t *func = v->func;
+  bool has_store = false;
+  uint32_t b = func->blocks.data[v->header].succs.data[0];
+  for (; b != v->header; b = func->blocks.data[b].succs.data[0]) {
+    const uint32_vec_t *instrs = &func->blocks.data[b].instrs;
+    for (size_t k = 0; k < instrs->size; k++) {
+      ir_ref_t ref = instrs->data[k];
+      const ir_instr_t *instr = &func->instrs.data[ref];
+      if (dcc_ir_is_terminator(instr->op) || is_leaf(instr->op) || is_iv_step(v, ref)) {
+        continue;
+      }
+      bool is_store = instr->op == IR_STORE;
+      if (!set_lane(v, is_store ? func->instrs.data[instr->args[1]].kind : instr->kind)) {
+        return false;
+      }
+      if (instr->op == IR_LOAD || is_store) {
+        uint32_t iv = iv_of(v, instr->args[0]);
+        if ((instr->flags & IR_VOLATILE) || iv == IR_NONE
+            || func->instrs.data[instr->args[0]].kind != IR_I64
+            || v->ivs.data[iv].step != lane_size(v->lane)
+            || (is_store && !is_operand(v, instr->args[1]))) {
+          return false;
+        }
+        access_t access = { ref, iv, v->body.size };
+        access.is_exact = dcc_ir_alias_root(&v->alias, v->ivs.data[iv].init, &access.root,
+                                            &access.offset);
+        access_vec_push(&v->accesses, access);
+        has_store |= is_store;
+      } else if (has_vector_op(v, instr)) {
+        for (uint32_t a = 0; a < instr->count; a++) {
+          if (!is_operand(v, instr->args[a])) {
+            return false;
+          }
+        }
+      } else {
+        return false;
+      }
+      v->is_vectorized[ref] = true;
+      uint32_vec_push(&v->body, ref);
+    }
+  }
+  return has_store;
+}
+
+// Whether the induction variables are only used to address, count and step
+static bool has_simple_ivs(const vectorizer_t *v) {
+  const ir_func_t *func = v->func;
+  for (uint32_t i = 0; i < v->ivs.size; i++) {
+    const vec_iv_t *iv = &v->ivs.data[i];
+    for (uint32_t u = func->use_start[iv->phi]; u < func->use_start[iv->phi + 1]; u++) {
+      ir_use_t use = func->uses[u];
+      const ir_instr_t *user = &func->instrs.data[use.user];
+      bool addresses = (user->op == IR_LOAD || user->op == IR_STORE) && use.index == 0;
+      if (!is_invariant(v, use.user) && use.user != iv->next && !addresses
+          && !(use.user == v->compare && i == v->counter)) {
+        return false;
+      }
+    }
+    for (uint32_t u = func->use_start[iv->next]; u < func->use_start[iv->next + 1]; u++) {
+      ir_ref_t user = func->uses[u].user;
+      if (!is_invariant(v, user) && user != iv->phi) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Whether a vector of iterations may run at once, as far as a store and
+// another access to memory see: each pair either cannot overlap, or meets at
+// a distance that leaves the order of reads and writes alone, or is checked
+static bool has_safe_accesses(vectorizer_t *v) {
+  const ir_func_t *func = v->func;
+  for (uint32_t i = 0; i < v->accesses.size; i++) {
+    const access_t *store = &v->accesses.data[i];
+    if (func->instrs.data[store->ref].op != IR_STORE) {
+      continue;
+    }
+    for (uint32_t j = 0; j < v->accesses.size; j++) {
+      const access_t *other = &v->accesses.data[j];
+      bool other_stores = func->instrs.data[other->ref].op == IR_STORE;
+      if (j == i || store->iv == other->iv || (other_stores && j < i)) {
+        continue;
+      } else if (store->is_exact && other->is_exact
+                 && dcc_ir_same_root(func, store->root, other->root)) {
+        int64_t distance = other->offset - store->offset;
+        if (distance != 0 && distance > -VECTOR_SIZE && distance < VECTOR_SIZE
+            && (other_stores || distance < 0 || other->position > store->position)) {
+          return false;
+        }
+      } else if (dcc_ir_may_share(&v->alias, store->root, other->root)) {
+        uint32_vec_push(&v->checks, i);
+        uint32_vec_push(&v->checks, j);
+      }
+    }
+  }
+  return true;
+}
+
+////
+// Transformation
+
+// A new instruction at the end of the preheader
+static ir_ref_t emit(vectorizer_t *v, enum ir_op op, ir_kind_t kind, ir_ref_t a, ir_ref_t b) {
+  ir_ref_t args[] = { a, b };
+  uint32_t count = (a != IR_NONE) + (b != IR_NONE);
+  uint32_t position = v->func->blocks.data[v->preheader].instrs.size - 1;
+  return dcc_ir_insert(v->func, v->preheader, position, op, kind, count, args);
+}
+
+static ir_ref_t constant(vectorizer_t *v, ir_kind_t kind, int64_t value) {
+  ir_ref_t ref = emit(v, IR_CONST, kind, IR_NONE, IR_NONE);
+  v->func->instrs.data[ref].imm = value;
+  return ref;
+}
+
+// An invariant value as an operand in the preheader
+static ir_ref_t outside(vectorizer_t *v, ir_ref_t ref) {
+  ir_instr_t leaf = v->func->instrs.data[ref];
+  if (!dcc_ir_in_loop(v->loops, v->loop, leaf.block)) {
+    return ref;
+  }
+  ir_ref_t copy = constant(v, leaf.kind, 0);
+  ir_instr_t *instr = &v->func->instrs.data[copy];
+  instr->op = leaf.op;
+  if (leaf.op == IR_FCONST) {
+    instr->fimm = leaf.fimm;
+  } else if (leaf.op == IR_GLOBAL) {
+    instr->symbol = leaf.symbol;
+  } else if (leaf.op == IR_STRING) {
+    instr->string = leaf.string;
+  } else {
+    instr->imm = leaf.imm;
+  }
+  return copy;
+}
+
+// An invariant value in every lane, made once in the preheader
+static ir_ref_t splat(vectorizer_t *v, ir_ref_t ref) {
+  if (ref >= v->count) {
+    return emit(v, IR_SPLAT, dcc_ir_vector(v->lane), ref, IR_NONE);
+  } else if (v->splats[ref] == IR_NONE) {
+    ir_ref_t value = outside(v, ref);
+    v->splats[ref] = emit(v, IR_SPLAT, dcc_ir_vector(v->lane), value, IR_NONE);
+  }
+  return v->splats[ref];
+}
+
+static ir_ref_t operand(vectorizer_t *v, ir_ref_t ref) {
+  return v->is_vectorized[ref] ? v->map[ref] : splat(v, ref);
+}
+
+// The vector form of an instruction of the body, at the end of `block`
+static void vectorize_instr(vectorizer_t *v, uint32_t block, ir_ref_t ref) {
+  ir_func_t *func = v->func;
+  ir_instr_t instr = func->instrs.data[ref];
+  ir_kind_t vector = dcc_ir_vector(v->lane);
+  enum ir_op op = instr.op;
+  ir_ref_t args[2] = { IR_NONE, IR_NONE };
+  switch (op) {
+  case IR_LOAD:
+  case IR_STORE:
+    args[0] = v->ivs.data[iv_of(v, instr.args[0])].vector;
+    if (op == IR_STORE) {
+      args[1] = operand(v, instr.args[1]);
+      vector = IR_VOID;
+    }
+    break;
+  case IR_NEG:
+    op = IR_SUB;
+    args[0] = splat(v, constant(v, v->lane, 0));
+    args[1] = operand(v, instr.args[0]);
+    break;
+  case IR_NOT:
+    op = IR_XOR;
+    args[0] = operand(v, instr.args[0]);
+    args[1] = splat(v, constant(v, v->lane, -1));
+    break;
+  case IR_SHL:
+  case IR_SHR:
+  case IR_SAR: {
+    // the count as a constant the code generator can see
+    int64_t count;
+    dcc_ir_constant_value(func, instr.args[1], &count);
+    args[0] = operand(v, instr.args[0]);
+    args[1] = splat(v, constant(v, v->lane, count));
+    break;
+  }
+  default:
+    args[0] = operand(v, instr.args[0]);
+    args[1] = operand(v, instr.args[1]);
+    break;
+  }
+  uint32_t count = op == IR_LOAD ? 1 : 2;
+  v->map[ref] = dcc_ir_append(func, block, op, vector, count, args);
+}
+
+// The vector loop goes between the preheader and the header. It runs while a
+// whole vector of iterations is left, then a block after it hands the
+// induction variables on to the original loop, which does the rest.
+static void vectorize(vectorizer_t *v) {
+  ir_func_t *func = v->func;
+  vec_iv_t counter = v->ivs.data[v->counter];
+  ir_kind_t kind = func->instrs.data[counter.phi].kind;
+  uint8_t size = lane_size(v->lane);
+
+  // the iterations left, in whole vectors, and whether to run any
+  ir_ref_t bound = outside(v, v->bound);
+  ir_ref_t enter = emit(v, v->cond, IR_I32, counter.init, bound);
+  ir_ref_t trips = emit(v, IR_SUB, kind, bound, counter.init);
+  int shift = 0;
+  while ((INT64_C(1) << shift) < counter.step) {
+    shift++;
+  }
+  if (shift) {
+    trips = emit(v, IR_SHR, kind, trips, constant(v, kind, shift));
+  }
+  if (kind == IR_I32) {
+    trips = emit(v, IR_ZEXT, IR_I64, trips, IR_NONE);
+  }
+  uint32_t lanes = VECTOR_SIZE / size;
+  trips = emit(v, IR_AND, IR_I64, trips, constant(v, IR_I64, -(int64_t)lanes));
+  ir_ref_t zero = constant(v, IR_I64, 0);
+  enter = emit(v, IR_AND, IR_I32, enter, emit(v, IR_NE, IR_I32, trips, zero));
+  if (v->checks.size) {
+    ir_ref_t bytes = emit(v, IR_MUL, IR_I64, trips, constant(v, IR_I64, size));
+    for (uint32_t c = 0; c < v->checks.size; c += 2) {
+      ir_ref_t a = v->ivs.data[v->accesses.data[v->checks.data[c]].iv].init;
+      ir_ref_t b = v->ivs.data[v->accesses.data[v->checks.data[c + 1]].iv].init;
+      ir_ref_t below = emit(v, IR_ULE, IR_I32, emit(v, IR_ADD, IR_I64, a, bytes), b);
+      ir_ref_t above = emit(v, IR_ULE, IR_I32, emit(v, IR_ADD, IR_I64, b, bytes), a);
+      enter = emit(v, IR_AND, IR_I32, enter, emit(v, IR_OR, IR_I32, below, above));
+    }
+  }
+
+  // where each induction variable ends up after the vector loop
+  ir_ref_t *ends = dcc_malloc(v->ivs.size * sizeof(ir_ref_t));
+  for (uint32_t i = 0; i < v->ivs.size; i++) {
+    const vec_iv_t *iv = &v->ivs.data[i];
+    ir_kind_t iv_kind = func->instrs.data[iv->phi].kind;
+    ir_ref_t n = iv_kind == IR_I32 ? emit(v, IR_TRUNC, IR_I32, trips, IR_NONE) : trips;
+    ir_ref_t distance = iv->step == 1 ? n
+      : emit(v, IR_MUL, iv_kind, n, constant(v, iv_kind, iv->step));
+    ends[i] = emit(v, IR_ADD, iv_kind, iv->init, distance);
+  }
+  ir_ref_t stride = constant(v, IR_I64, VECTOR_SIZE), width = constant(v, IR_I64, lanes);
+
+  // the preheader now branches to the vector loop or past it
+  uint32_t loop = dcc_ir_block(func), after = dcc_ir_block(func);
+  ir_ref_t jmp = dcc_ir_terminator(func, v->preheader);
+  func->instrs.data[jmp].op = IR_NOP;
+  func->blocks.data[v->preheader].succs.size = 0;
+  dcc_ir_edge(func, v->preheader, loop);
+  dcc_ir_edge(func, v->preheader, after);
+  dcc_ir_append(func, v->preheader, IR_BR, IR_VOID, 1, &enter);
+
+  ir_ref_t args[] = { zero, zero };
+  ir_ref_t index = dcc_ir_append(func, loop, IR_PHI, IR_I64, 2, args);
+  for (uint32_t i = 0; i < v->ivs.size; i++) {
+    for (uint32_t a = 0; a < v->accesses.size; a++) {
+      if (v->accesses.data[a].iv == i && v->ivs.data[i].vector == IR_NONE) {
+        ir_ref_t init[] = { v->ivs.data[i].init, v->ivs.data[i].init };
+        v->ivs.data[i].vector = dcc_ir_append(func, loop, IR_PHI, IR_I64, 2, init);
+      }
+    }
+  }
+  for (uint32_t i = 0; i < v->body.size; i++) {
+    vectorize_instr(v, loop, v->body.data[i]);
+  }
+  ir_ref_t step[] = { index, width };
+  func->instrs.data[index].args[1] = dcc_ir_append(func, loop, IR_ADD, IR_I64, 2, step);
+  for (uint32_t i = 0; i < v->ivs.size; i++) {
+    ir_ref_t phi = v->ivs.data[i].vector;
+    if (phi != IR_NONE) {
+      ir_ref_t next[] = { phi, stride };
+      func->instrs.data[phi].args[1] = dcc_ir_append(func, loop, IR_ADD, IR_I64, 2, next);
+    }
+  }
+  ir_ref_t more[] = { func->instrs.data[index].args[1], trips };
+  ir_ref_t cond = dcc_ir_append(func, loop, IR_NE, IR_I32, 2, more);
+  dcc_ir_append(func, loop, IR_BR, IR_VOID, 1, &cond);
+  dcc_ir_edge(func, loop, loop);
+  dcc_ir_edge(func, loop, after);
+
+  // the original loop starts where the vector loop stopped
+  for (uint32_t i = 0; i < v->ivs.size; i++) {
+    const vec_iv_t *iv = &v->ivs.data[i];
+    ir_ref_t values[] = { iv->init, ends[i] };
+    ir_kind_t iv_kind = func->instrs.data[iv->phi].kind;
+    ir_ref_t phi = dcc_ir_append(func, after, IR_PHI, iv_kind, 2, values);
+    func->instrs.data[iv->phi].args[v->pre] = phi;
+  }
+  dcc_ir_append(func, after, IR_JMP, IR_VOID, 0, 0);
+  uint32_vec_push(&func->blocks.data[after].succs, v->header);
+  func->blocks.data[v->header].preds.data[v->pre] = after;
+  free(ends);
+}
+
+void dcc_vectorize(ir_func_t *func) {
+  ir_loops_t loops = dcc_ir_loops(func);
+  if (!loops.loops.size) {
+    dcc_ir_loops_free(&loops);
+    return;
+  }
+  dcc_ir_preheaders(func, &loops);
+  dcc_ir_uses(func);
+  vectorizer_t v = { func, &loops, dcc_ir_alias(func) };
+  v.count = func->instrs.size;
+  v.is_vectorized = dcc_malloc(v.count * sizeof(bool));
+  v.map = dcc_malloc(v.count * sizeof(ir_ref_t));
+  v.splats = dcc_malloc(v.count * sizeof(ir_ref_t));
+  bool changed = false;
+  for (uint32_t l = 0; l < loops.loops.size; l++) {
+    v.loop = l;
+    v.lane = IR_VOID;
+    v.ivs = vec_iv_vec_new();
+    v.accesses = access_vec_new();
+    v.body = uint32_vec_new();
+    v.checks = uint32_vec_new();
+    for (uint32_t ref = 0; ref < v.count; ref++) {
+      v.is_vectorized[ref] = false;
+      v.splats[ref] = IR_NONE;
+    }
+    if (is_counted(&v) && find_ivs(&v) && find_body(&v) && has_simple_ivs(&v)
+        && has_safe_accesses(&v)) {
+      vectorize(&v);
+      changed = true;
+    }
+    vec_iv_vec_free(&v.ivs);
+    access_vec_free(&v.accesses);
+    uint32_vec_free(&v.body);
+    uint32_vec_free(&v.checks);
+  }
+  free(v.is_vectorized);
+  free(v.map);
+  free(v.splats);
+  dcc_ir_alias_free(&v.alias);
+  dcc_ir_loops_free(&loops);
+  if (changed) {
+    dcc_ir_compact(func);
+    dcc_ir_dominators(func);
+    dcc_ir_verify(func);
+  }
+}
@@ -0,0 +1,38 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+/*
+  Loop vectorization for SSE2, which every x86-64 processor has. An innermost
+  counted loop whose body is one straight line of loads, arithmetic and stores
+  on elements of one kind, through pointers that step an element at a time as
+  strength reduction leaves a[i], gets a loop over 16-byte vectors ahead of it.
+  The original loop then runs the iterations left over, and all of them when
+  the vector loop is skipped.
+
+  Pointers into different objects never overlap, and neither do a restrict
+  parameter and any other pointer, since the loop stores through one of them.
+  Pointers from one base are checked at their constant distance, and others
+  are checked before entering the vector loop.
+*/
+
+#pragma once
+
+#include "ir.h"
+
+// Vectorize the innermost loops of a function dcc_loop_optimize() has run on
+void dcc_vectorize(ir_func_t *func);
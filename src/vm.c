@@ -0,0 +1,1898 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "init.h"
+#include "lower.h"
+#include "sema.h"
+#include "switch.h"
+#include "vm.h"
+
+// Every instruction names up to three registers, and an immediate that is a
+// constant, an offset, a size, a jump target or a function
+#define VM_OPS(X)                                                       \
+  X(MOV) X(CONST) X(CONST64) X(FRAME)                                   \
+  X(ADD) X(SUB) X(MUL) X(SDIV) X(UDIV) X(SREM) X(UREM)                  \
+  X(AND) X(OR) X(XOR) X(SHL) X(SAR) X(SHR)                              \
+  X(ADDI) X(MULI) X(SHLI) X(SARI) X(SHRI) X(NEG) X(NOT)                 \
+  X(EQ) X(NE) X(SLT) X(SLE) X(ULT) X(ULE)                               \
+  X(EXT8S) X(EXT8U) X(EXT16S) X(EXT16U) X(EXT32S) X(EXT32U) X(BOOL)     \
+  X(FADD) X(FSUB) X(FMUL) X(FDIV) X(FNEG)                               \
+  X(FEQ) X(FNE) X(FLT) X(FLE)                                           \
+  X(SITOF) X(UITOF) X(FTOSI) X(FTOUI) X(FROUND)                         \
+  X(LOAD8S) X(LOAD8U) X(LOAD16S) X(LOAD16U) X(LOAD32S) X(LOAD32U)       \
+  X(LOAD64) X(LOADF32)                                                  \
+  X(STORE8) X(STORE16) X(STORE32) X(STORE64) X(STOREF32)                \
+  X(COPY) X(ZERO)                                                       \
+  X(JMP) X(BRZ) X(BRNZ) X(SWITCH) X(CALL) X(CALLI) X(RET) X(RETVOID)
+
+enum vm_op {
+#define VM_ENUM(name) VM_##name,
+  VM_OPS(VM_ENUM)
+#undef VM_ENUM
+};
+
+typedef struct {
+  uint16_t op, a, b, c;
+  int32_t imm;
+} vm_instr_t;
+DECLARE_VEC(vm_instr_t, vm_instr_vec);
+DEFINE_VEC2(vm_instr_t, vm_instr_vec);
+
+DECLARE_VEC(uint64_t, vm_word_vec);
+DEFINE_VEC2(uint64_t, vm_word_vec);
+
+typedef struct {
+  const char *name;
+  bool is_defined;
+  vm_instr_vec_t code;
+  uint32_vec_t locs; // of each instruction
+  vm_word_vec_t constants; // too wide for an immediate
+  uint32_vec_t tables; // of VM_SWITCH: a size, then the target of each index
+  uint32_t param_count; // including the address an aggregate returns to
+  uint32_t reg_count;
+  uint32_t frame_size;
+} vm_func_t;
+typedef vm_func_t* vm_func_ptr_t;
+DECLARE_VEC(vm_func_ptr_t, vm_func_vec);
+DEFINE_VEC2(vm_func_ptr_t, vm_func_vec);
+
+// A function or object with static storage
+typedef struct {
+  symbol_t *symbol; // as defined, if it is
+  initializer_t *init;
+  func_def_t *def;
+  uint64_t address; // of an object, once laid out
+  uint32_t func; // index of a function + 1, or zero until referred to
+} vm_global_t;
+typedef vm_global_t* vm_global_ptr_t;
+DECLARE_VEC(vm_global_ptr_t, vm_global_vec);
+DEFINE_VEC2(vm_global_ptr_t, vm_global_vec);
+
+typedef struct {
+  vm_func_t *func;
+  const vm_instr_t *ret; // where the caller resumes
+  uint64_t base; // of the caller's registers
+  uint64_t fp, top; // of the caller's frame
+  uint16_t dst;
+} vm_frame_t;
+DECLARE_VEC(vm_frame_t, vm_frame_vec);
+DEFINE_VEC2(vm_frame_t, vm_frame_vec);
+
+// Addresses below this trap, so that null does
+#define VM_NULL_GUARD 16
+// Functions have addresses of their own, beyond any memory
+#define VM_FUNC_BASE ((uint64_t)1 << 62)
+#define VM_MEMORY_LIMIT ((uint64_t)1 << 28)
+#define VM_REG_LIMIT ((uint64_t)1 << 24)
+// Calls and backward jumps a run may take, so that a runaway program traps
+// within a couple of seconds
+#define VM_STEP_LIMIT ((uint64_t)1 << 28)
+
+struct vm {
+  diag_vec_t *diags;
+  arena_t arena;
+  uint8_t *memory;
+  uint64_t size; // of the static data, above which the stack grows
+  uint64_t capacity;
+  uint64_t *regs;
+  uint64_t reg_capacity;
+  vm_frame_vec_t frames;
+  vm_func_vec_t funcs;
+  ptrmap_t globals; // symbol -> vm_global_t
+  vm_global_vec_t objects; // in order of declaration
+  ptrmap_t strings; // strlit_t -> address
+};
+
+static const type_t* value_type(const exp_t *exp) {
+  return dcc_type_decay(exp->type)->unqual;
+}
+
+static uint64_t round_up(uint64_t n, uint64_t align) {
+  return (n + align - 1) / align * align;
+}
+
+static double to_double(uint64_t bits) {
+  double d;
+  memcpy(&d, &bits, sizeof d);
+  return d;
+}
+
+static uint64_t from_double(double d) {
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof bits);
+  return bits;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Memory
+////////////////////////////////////////////////////////////////////////////////
+
+// Make room for memory up to `top`, returning false if that is too much
+static bool reserve(vm_t *vm, uint64_t top) {
+  if (top > VM_MEMORY_LIMIT) {
+    return false;
+  } else if (top > vm->capacity) {
+    while (vm->capacity < top) {
+      vm->capacity *= 2;
+    }
+    vm->memory = dcc_realloc(vm->memory, vm->capacity);
+  }
+  return true;
+}
+
+// Zeroed static memory for an object, or zero if there is no room for it
+static uint64_t allocate(vm_t *vm, uint64_t size, uint32_t align) {
+  uint64_t address = round_up(vm->size, align ? align : 1);
+  if (size > VM_MEMORY_LIMIT || !reserve(vm, address + size)) {
+    return 0;
+  }
+  memset(vm->memory + vm->size, 0, address + size - vm->size);
+  vm->size = address + size;
+  return address;
+}
+
+static uint64_t string_address(vm_t *vm, strlit_t *string, srcloc_t loc) {
+  uint64_t address = (uintptr_t)dcc_ptrmap_get(&vm->strings, string);
+  if (!address) {
+    size_t size;
+    const char *bytes = dcc_strlit_bytes(string, &size);
+    address = allocate(vm, size + 1, 1);
+    if (!address) {
+      dcc_diag(vm->diags, DIAG_ERROR, loc, 1, "out of memory for string literal");
+      return 0;
+    }
+    memcpy(vm->memory + address, bytes, size);
+    dcc_ptrmap_put(&vm->strings, string, (void*)(uintptr_t)address);
+  }
+  return address;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Symbols
+////////////////////////////////////////////////////////////////////////////////
+
+static vm_global_t* new_global(vm_t *vm, symbol_t *symbol) {
+  vm_global_t *global = dcc_arena_alloc(&vm->arena, sizeof(vm_global_t));
+  global->symbol = symbol;
+  dcc_ptrmap_put(&vm->globals, symbol, global);
+  if (symbol->tag == SYM_OBJECT) {
+    vm_global_vec_push(&vm->objects, global);
+  }
+  return global;
+}
+
+// The global a symbol with linkage refers to, which sema has already merged
+// across every declaration of its name
+static vm_global_t* linked_global(vm_t *vm, symbol_t *symbol) {
+  vm_global_t *global = dcc_ptrmap_get(&vm->globals, symbol);
+  return global ? global : new_global(vm, symbol);
+}
+
+static void declare(void *ctx, symbol_t *symbol, const decl_spec_t *specs,
+                    initializer_t *init, func_def_t *def, bool is_file_scope) {
+  vm_t *vm = ctx;
+  // a block scope static has no linkage
+  vm_global_t *global = !is_file_scope && (specs->storage & AST_STORAGE_STATIC)
+    ? new_global(vm, symbol) : linked_global(vm, symbol);
+  if (def) {
+    global->symbol = symbol;
+    global->def = def;
+  } else if (init) {
+    global->symbol = symbol;
+    global->init = init;
+  }
+}
+
+static vm_func_t* new_func(vm_t *vm, const char *name) {
+  vm_func_t *func = dcc_arena_alloc(&vm->arena, sizeof(vm_func_t));
+  func->name = name;
+  func->code = vm_instr_vec_new();
+  func->locs = uint32_vec_new();
+  func->constants = vm_word_vec_new();
+  func->tables = uint32_vec_new();
+  vm_func_vec_push(&vm->funcs, func);
+  return func;
+}
+
+// The index of the function `symbol` refers to, which need not be defined
+static uint32_t func_index(vm_t *vm, symbol_t *symbol) {
+  vm_global_t *global = linked_global(vm, symbol);
+  if (!global->func) {
+    new_func(vm, symbol->name->str);
+    global->func = vm->funcs.size;
+  }
+  return global->func - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Compiling
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  enum {
+    LOCAL_REG,
+    LOCAL_FRAME,
+    LOCAL_INDIRECT, // an aggregate parameter, at the address in a register
+  } tag;
+  uint32_t index; // a register or frame offset
+} local_t;
+
+// The object an expression designates: a register, or memory at a constant
+// offset from the address in a register
+typedef struct {
+  const type_t *type;
+  bool is_reg;
+  uint16_t reg;
+  int32_t offset;
+  uint8_t bit_offset, bit_width; // bit_width is zero unless a bit-field
+} lvalue_t;
+
+typedef struct {
+  uint32_t jump;
+  symbol_t *label;
+} vm_goto_t;
+DECLARE_VEC(vm_goto_t, vm_goto_vec);
+DEFINE_VEC2(vm_goto_t, vm_goto_vec);
+
+typedef struct {
+  switch_case_vec_t cases; // targeting code
+  uint32_t default_target; // UINT32_MAX if there is no default label
+} vm_switch_t;
+
+typedef struct {
+  vm_t *vm;
+  vm_func_t *func;
+  ptrmap_t escaped; // locals whose address is taken
+  ptrmap_t locals; // symbol -> local_t
+  ptrmap_t labels; // symbol -> target + 1
+  vm_goto_vec_t gotos; // jumps to labels, resolved at the end
+  uint32_vec_t *breaks, *continues; // jumps out of the innermost loop
+  vm_switch_t *switch_;
+  const type_t *ret;
+  uint16_t sret; // register with the address an aggregate returns to
+  uint16_t va_area; // register with the address of the arguments past `...`
+  uint32_t regs; // registers in use
+  srcloc_t loc; // of what is being compiled
+  bool failed;
+} compiler_t;
+
+#define NO_REG UINT16_MAX
+
+static uint32_t here(compiler_t *c) {
+  return c->func->code.size;
+}
+
+static uint32_t emit(compiler_t *c, enum vm_op op, uint32_t a, uint32_t b, uint32_t cc,
+                     int32_t imm) {
+  vm_instr_t instr = { op, a, b, cc, imm };
+  vm_instr_vec_push(&c->func->code, instr);
+  uint32_vec_push(&c->func->locs, c->loc);
+  return here(c) - 1;
+}
+
+static uint16_t temp(compiler_t *c) {
+  if (c->regs >= NO_REG) {
+    if (!c->failed) {
+      dcc_diag(c->vm->diags, DIAG_ERROR, c->loc, 1, "function too large to interpret");
+    }
+    c->failed = true;
+    return 0;
+  }
+  if (++c->regs > c->func->reg_count) {
+    c->func->reg_count = c->regs;
+  }
+  return c->regs - 1;
+}
+
+static uint16_t constant(compiler_t *c, uint64_t value) {
+  uint16_t r = temp(c);
+  if ((int64_t)value == (int32_t)value) {
+    emit(c, VM_CONST, r, 0, 0, (int32_t)value);
+  } else {
+    vm_word_vec_push(&c->func->constants, value);
+    emit(c, VM_CONST64, r, 0, 0, c->func->constants.size - 1);
+  }
+  return r;
+}
+
+static uint16_t op1(compiler_t *c, enum vm_op op, uint16_t a, int32_t imm) {
+  uint16_t r = temp(c);
+  emit(c, op, r, a, 0, imm);
+  return r;
+}
+
+static uint16_t op2(compiler_t *c, enum vm_op op, uint16_t a, uint16_t b) {
+  uint16_t r = temp(c);
+  emit(c, op, r, a, b, 0);
+  return r;
+}
+
+// Frame memory for an object, which lives as long as the function
+static int32_t frame_alloc(compiler_t *c, const type_t *type) {
+  uint32_t align = dcc_type_align(type);
+  uint32_t offset = round_up(c->func->frame_size, align ? align : 1);
+  c->func->frame_size = offset + dcc_type_size(type);
+  return offset;
+}
+
+static uint16_t frame_address(compiler_t *c, int32_t offset) {
+  uint16_t r = temp(c);
+  emit(c, VM_FRAME, r, 0, 0, offset);
+  return r;
+}
+
+static void patch(compiler_t *c, uint32_t jump, uint32_t target) {
+  c->func->code.data[jump].imm = target;
+}
+
+static void patch_all(compiler_t *c, uint32_vec_t *jumps, uint32_t target) {
+  for (size_t i = 0; i < jumps->size; i++) {
+    patch(c, jumps->data[i], target);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Conversions and arithmetic
+////////////////////////////////////////////////////////////////////////////////
+
+// Bring a register holding the 64-bit result of an operation on `type` back
+// to a value of `type`, sign or zero extended from its width
+static uint16_t normalize(compiler_t *c, uint16_t value, const type_t *type) {
+  if (type->tag == TYPE_BOOL) {
+    return op1(c, VM_BOOL, value, 0);
+  } else if (type->tag == TYPE_FLOAT) {
+    return op1(c, VM_FROUND, value, 0);
+  } else if (dcc_type_is_float(type) || dcc_type_is_record(type) || type->tag == TYPE_VOID) {
+    return value;
+  }
+  static const enum vm_op EXTENDS[][2] = {
+    [1] = { VM_EXT8U, VM_EXT8S },
+    [2] = { VM_EXT16U, VM_EXT16S },
+    [4] = { VM_EXT32U, VM_EXT32S },
+  };
+  uint64_t size = dcc_type_size(type);
+  return size >= 8 ? value : op1(c, EXTENDS[size][dcc_type_is_signed(type)], value, 0);
+}
+
+static uint16_t convert(compiler_t *c, uint16_t value, const type_t *from, const type_t *to) {
+  if (to->tag == TYPE_VOID) {
+    return NO_REG;
+  } else if (dcc_type_is_record(to) || from == to) {
+    return value;
+  } else if (to->tag == TYPE_BOOL) {
+    if (dcc_type_is_float(from)) {
+      return op2(c, VM_FNE, value, constant(c, 0));
+    }
+    return from->tag == TYPE_BOOL ? value : op1(c, VM_BOOL, value, 0);
+  }
+
+  if (!dcc_type_is_float(from) && !dcc_type_is_float(to)) {
+    // every value of `from` may already be one of `to`
+    uint64_t fs = dcc_type_size(from), ts = dcc_type_size(to);
+    bool fsigned = dcc_type_is_signed(from), tsigned = dcc_type_is_signed(to);
+    if (ts == 8 || (ts > fs && (!fsigned || tsigned)) || (ts == fs && fsigned == tsigned)) {
+      return value;
+    }
+    return normalize(c, value, to);
+  } else if (!dcc_type_is_float(from)) {
+    value = op1(c, dcc_type_is_signed(from) ? VM_SITOF : VM_UITOF, value, 0);
+    return normalize(c, value, to);
+  } else if (!dcc_type_is_float(to)) {
+    value = op1(c, dcc_type_is_signed(to) ? VM_FTOSI : VM_FTOUI, value, 0);
+    return normalize(c, value, to);
+  }
+  return to->tag == TYPE_FLOAT && from->tag != TYPE_FLOAT ? normalize(c, value, to) : value;
+}
+
+// `a op b` for operands of arithmetic `type`
+static uint16_t arith(compiler_t *c, enum exp_tag op, uint16_t a, uint16_t b,
+                      const type_t *type) {
+  bool is_signed = dcc_type_is_signed(type);
+  enum vm_op vm_op;
+  if (dcc_type_is_float(type)) {
+    switch (op) {
+    case EXP_ADD: vm_op = VM_FADD; break;
+    case EXP_SUBTRACT: vm_op = VM_FSUB; break;
+    case EXP_MULTIPLY: vm_op = VM_FMUL; break;
+    case EXP_DIVIDE: vm_op = VM_FDIV; break;
+    default: dcc_ice("not a floating operator: %d", op); return NO_REG;
+    }
+    return normalize(c, op2(c, vm_op, a, b), type);
+  }
+
+  switch (op) {
+  case EXP_ADD: vm_op = VM_ADD; break;
+  case EXP_SUBTRACT: vm_op = VM_SUB; break;
+  case EXP_MULTIPLY: vm_op = VM_MUL; break;
+  case EXP_DIVIDE: vm_op = is_signed ? VM_SDIV : VM_UDIV; break;
+  case EXP_MODULO: vm_op = is_signed ? VM_SREM : VM_UREM; break;
+  case EXP_BITAND: vm_op = VM_AND; break;
+  case EXP_BITOR: vm_op = VM_OR; break;
+  case EXP_BITXOR: vm_op = VM_XOR; break;
+  case EXP_SHIFTLEFT: vm_op = VM_SHL; break;
+  case EXP_SHIFTRIGHT: vm_op = is_signed ? VM_SAR : VM_SHR; break;
+  default: dcc_ice("not an arithmetic operator: %d", op); return NO_REG;
+  }
+  return normalize(c, op2(c, vm_op, a, b), type);
+}
+
+static uint16_t pointer_add(compiler_t *c, uint16_t pointer, const type_t *type,
+                            uint16_t index, const type_t *index_type, bool subtract) {
+  index = convert(c, index, index_type, dcc_type_basic(TYPE_LONG));
+  uint64_t size = dcc_type_step(type);
+  if (size != 1) {
+    index = size <= INT32_MAX ? op1(c, VM_MULI, index, size)
+      : op2(c, VM_MUL, index, constant(c, size));
+  }
+  return op2(c, subtract ? VM_SUB : VM_ADD, pointer, index);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Objects
+////////////////////////////////////////////////////////////////////////////////
+
+static lvalue_t memory(const type_t *type, uint16_t address, int32_t offset) {
+  lvalue_t lvalue = { type, false, address, offset, 0, 0 };
+  return lvalue;
+}
+
+// The address of an object in memory, in a register
+static uint16_t address_of(compiler_t *c, const lvalue_t *lvalue) {
+  return lvalue->offset ? op1(c, VM_ADDI, lvalue->reg, lvalue->offset) : lvalue->reg;
+}
+
+static enum vm_op load_op(const type_t *type) {
+  if (dcc_type_is_float(type)) {
+    return type->tag == TYPE_FLOAT ? VM_LOADF32 : VM_LOAD64;
+  }
+  bool is_signed = dcc_type_is_signed(type);
+  switch (dcc_type_size(type)) {
+  case 1: return is_signed ? VM_LOAD8S : VM_LOAD8U;
+  case 2: return is_signed ? VM_LOAD16S : VM_LOAD16U;
+  case 4: return is_signed ? VM_LOAD32S : VM_LOAD32U;
+  default: return VM_LOAD64;
+  }
+}
+
+static enum vm_op store_op(const type_t *type) {
+  if (type->tag == TYPE_FLOAT) {
+    return VM_STOREF32;
+  }
+  switch (dcc_type_size(type)) {
+  case 1: return VM_STORE8;
+  case 2: return VM_STORE16;
+  case 4: return VM_STORE32;
+  default: return VM_STORE64;
+  }
+}
+
+// The value of a bit-field from the storage unit holding it
+static uint16_t extract(compiler_t *c, uint16_t unit, const lvalue_t *lvalue) {
+  if (dcc_type_is_signed(lvalue->type)) {
+    int left = 64 - lvalue->bit_offset - lvalue->bit_width;
+    return op1(c, VM_SARI, op1(c, VM_SHLI, unit, left), 64 - lvalue->bit_width);
+  }
+  uint64_t mask = lvalue->bit_width == 64 ? UINT64_MAX : (1ull << lvalue->bit_width) - 1;
+  return op2(c, VM_AND, op1(c, VM_SHRI, unit, lvalue->bit_offset), constant(c, mask));
+}
+
+// The value of a scalar object, or the address of any other
+static uint16_t load(compiler_t *c, const lvalue_t *lvalue) {
+  const type_t *type = lvalue->type;
+  if (lvalue->is_reg) {
+    return lvalue->reg;
+  } else if (!dcc_type_is_scalar(type)) {
+    return address_of(c, lvalue);
+  }
+  uint16_t value = op1(c, load_op(type), lvalue->reg, lvalue->offset);
+  return lvalue->bit_width ? extract(c, value, lvalue) : value;
+}
+
+// Store `value`, converted to the object's type already, and return the value
+// the object then has
+static uint16_t store(compiler_t *c, const lvalue_t *lvalue, uint16_t value) {
+  const type_t *type = lvalue->type;
+  if (lvalue->is_reg) {
+    emit(c, VM_MOV, lvalue->reg, value, 0, 0);
+    return value;
+  } else if (!dcc_type_is_scalar(type)) {
+    uint16_t address = address_of(c, lvalue);
+    emit(c, VM_COPY, address, value, 0, dcc_type_size(type));
+    return address;
+  }
+
+  uint16_t unit = value;
+  if (lvalue->bit_width) {
+    uint64_t mask = lvalue->bit_width == 64 ? UINT64_MAX : (1ull << lvalue->bit_width) - 1;
+    uint16_t old = op1(c, load_op(type), lvalue->reg, lvalue->offset);
+    old = op2(c, VM_AND, old, constant(c, ~(mask << lvalue->bit_offset)));
+    unit = op1(c, VM_SHLI, op2(c, VM_AND, value, constant(c, mask)), lvalue->bit_offset);
+    unit = op2(c, VM_OR, old, unit);
+  }
+  emit(c, store_op(type), lvalue->reg, unit, 0, lvalue->offset);
+  return lvalue->bit_width ? extract(c, unit, lvalue) : value;
+}
+
+static uint16_t rvalue(compiler_t *c, exp_t *exp);
+static lvalue_t lvalue(compiler_t *c, exp_t *exp);
+static void jump_if(compiler_t *c, exp_t *exp, bool when, uint32_vec_t *jumps);
+static void init_object(compiler_t *c, uint16_t address, const type_t *type,
+                        initializer_t *init);
+
+static lvalue_t member(compiler_t *c, exp_t *exp) {
+  const member_t *member;
+  lvalue_t object;
+  if (exp->tag == EXP_DOT) {
+    // a struct is always in memory, so nested members fold into one offset
+    lvalue_t outer = lvalue(c, exp->child.lhs);
+    member = dcc_record_member(exp->child.lhs->type->record, exp->child.name.name);
+    object = memory(exp->type, outer.reg, outer.offset + member->offset);
+  } else {
+    const type_t *record = value_type(exp->child.lhs)->base;
+    member = dcc_record_member(record->record, exp->child.name.name);
+    object = memory(exp->type, rvalue(c, exp->child.lhs), member->offset);
+  }
+  object.bit_offset = member->bit_offset;
+  object.bit_width = member->bit_width;
+  return object;
+}
+
+// The address of an object with static storage, laid out on first use, or
+// zero if there is no room for it
+static uint64_t global_address(vm_t *vm, symbol_t *symbol) {
+  vm_global_t *global = dcc_ptrmap_get(&vm->globals, symbol);
+  if (!global) {
+    global = linked_global(vm, symbol);
+  }
+  if (!global->address) {
+    const type_t *type = global->symbol->type;
+    uint64_t size = dcc_type_is_complete(type) ? dcc_type_size(type) : 0;
+    global->address = allocate(vm, size ? size : 1, dcc_type_align(type));
+    if (!global->address) {
+      dcc_diag(vm->diags, DIAG_ERROR, global->symbol->loc, 1, "out of memory for '%s'",
+               global->symbol->name->str);
+    }
+  }
+  return global->address;
+}
+
+static lvalue_t lvalue(compiler_t *c, exp_t *exp) {
+  switch (exp->tag) {
+  case EXP_IDENT: {
+    symbol_t *symbol = exp->ident.symbol;
+    local_t *local = dcc_ptrmap_get(&c->locals, symbol);
+    if (!local) {
+      uint64_t address = symbol->tag == SYM_FUNCTION
+        ? VM_FUNC_BASE + func_index(c->vm, symbol) : global_address(c->vm, symbol);
+      return memory(exp->type, constant(c, address), 0);
+    } else if (local->tag == LOCAL_REG) {
+      lvalue_t lvalue = { exp->type, true, local->index, 0, 0, 0 };
+      return lvalue;
+    }
+    return memory(exp->type, local->tag == LOCAL_FRAME
+                  ? frame_address(c, local->index) : local->index, 0);
+  }
+  case EXP_STRING: {
+    uint64_t address = string_address(c->vm, exp->string, c->loc);
+    c->failed |= !address;
+    return memory(exp->type, constant(c, address), 0);
+  }
+  case EXP_STRUCT: {
+    initializer_t init;
+    init.tag = INIT_LIST;
+    init.inits = exp->struct_init.inits;
+    uint16_t address = frame_address(c, frame_alloc(c, exp->type));
+    init_object(c, address, exp->type, &init);
+    return memory(exp->type, address, 0);
+  }
+  case EXP_DEREFERENCE:
+    return memory(exp->type, rvalue(c, exp->unary), 0);
+  case EXP_INDEX: {
+    exp_t *pointer = exp->binary.lhs, *index = exp->binary.rhs;
+    if (value_type(index)->tag == TYPE_POINTER) {
+      exp_t *swap = pointer;
+      pointer = index;
+      index = swap;
+    }
+    uint16_t base = rvalue(c, pointer);
+    // a constant index is an offset of the access
+    if (index->tag == EXP_CONSTANT && !dcc_type_is_float(value_type(index))) {
+      int64_t offset = (int64_t)index->constant->integer * (int64_t)dcc_type_step(value_type(pointer));
+      if (offset == (int32_t)offset) {
+        return memory(exp->type, base, offset);
+      }
+    }
+    uint16_t offset = rvalue(c, index);
+    return memory(exp->type, pointer_add(c, base, value_type(pointer), offset,
+                                         value_type(index), false), 0);
+  }
+  case EXP_DOT:
+  case EXP_ARROW:
+    return member(c, exp);
+  default:
+    // an aggregate rvalue, which lives in a temporary
+    dcc_assert(dcc_type_is_record(exp->type));
+    return memory(exp->type, rvalue(c, exp), 0);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Expressions
+////////////////////////////////////////////////////////////////////////////////
+
+// `old op operand` converted back to the type of `old`, for compound
+// assignments and increments
+static uint16_t combine(compiler_t *c, enum exp_tag op, uint16_t old, const type_t *type,
+                        uint16_t operand, const type_t *operand_type) {
+  if (type->tag == TYPE_POINTER) {
+    return pointer_add(c, old, type, operand, operand_type, op == EXP_SUBTRACT);
+  }
+  const type_t *common = dcc_type_operation(op, type, operand_type);
+  uint16_t a = convert(c, old, type, common);
+  uint16_t b = convert(c, operand, operand_type, common);
+  return convert(c, arith(c, op, a, b, common), common, type);
+}
+
+static uint16_t compare(compiler_t *c, exp_t *exp) {
+  exp_t *lhs = exp->binary.lhs, *rhs = exp->binary.rhs;
+  const type_t *a = value_type(lhs), *b = value_type(rhs);
+  uint16_t x = rvalue(c, lhs), y = rvalue(c, rhs);
+  const type_t *type = dcc_type_comparison(a, b);
+  x = convert(c, x, a, type);
+  y = convert(c, y, b, type);
+
+  // only less and less-or-equal exist, with their operands swapped for the rest
+  static const enum vm_op OPS[][3] = {
+    // floating, signed, unsigned
+    { VM_FLT, VM_SLT, VM_ULT },
+    { VM_FLE, VM_SLE, VM_ULE },
+    { VM_FEQ, VM_EQ, VM_EQ },
+    { VM_FNE, VM_NE, VM_NE },
+  };
+  int row;
+  bool swap = exp->tag == EXP_MORE || exp->tag == EXP_MOREEQ;
+  switch (exp->tag) {
+  case EXP_LESS: case EXP_MORE: row = 0; break;
+  case EXP_LESSEQ: case EXP_MOREEQ: row = 1; break;
+  case EXP_EQUAL: row = 2; break;
+  default: row = 3; break;
+  }
+  int column = dcc_type_is_float(type) ? 0 : dcc_type_is_signed(type) ? 1 : 2;
+  return swap ? op2(c, OPS[row][column], y, x) : op2(c, OPS[row][column], x, y);
+}
+
+static uint16_t binary(compiler_t *c, exp_t *exp) {
+  exp_t *lhs = exp->binary.lhs, *rhs = exp->binary.rhs;
+  const type_t *a = value_type(lhs), *b = value_type(rhs), *type = value_type(exp);
+  uint16_t x = rvalue(c, lhs), y = rvalue(c, rhs);
+  bool subtract = exp->tag == EXP_SUBTRACT;
+  if (a->tag == TYPE_POINTER && b->tag == TYPE_POINTER) {
+    uint16_t diff = op2(c, VM_SUB, x, y);
+    uint64_t size = dcc_type_step(a);
+    return size == 1 ? diff : op2(c, VM_SDIV, diff, constant(c, size));
+  } else if (a->tag == TYPE_POINTER) {
+    return pointer_add(c, x, a, y, b, subtract);
+  } else if (b->tag == TYPE_POINTER) {
+    return pointer_add(c, y, b, x, a, false);
+  }
+  const type_t *common = dcc_type_operation(exp->tag, a, b);
+  x = convert(c, x, a, common);
+  y = convert(c, y, b, common);
+  return convert(c, arith(c, exp->tag, x, y, common), common, type);
+}
+
+static uint16_t assign(compiler_t *c, exp_t *exp) {
+  exp_t *lhs = exp->assignment.lhs, *rhs = exp->assignment.rhs;
+  lvalue_t target = lvalue(c, lhs);
+  const type_t *type = value_type(lhs);
+  uint16_t value = rvalue(c, rhs);
+  enum exp_tag op = exp->assignment.operator;
+  if (op == EXP_EQUAL) {
+    value = convert(c, value, value_type(rhs), type);
+  } else {
+    value = combine(c, op, load(c, &target), type, value, value_type(rhs));
+  }
+  return store(c, &target, value);
+}
+
+static uint16_t increment(compiler_t *c, exp_t *exp) {
+  bool is_increment = exp->tag == EXP_PREINCREMENT || exp->tag == EXP_POSTINCREMENT;
+  bool is_prefix = exp->tag == EXP_PREINCREMENT || exp->tag == EXP_PREDECREMENT;
+  lvalue_t target = lvalue(c, exp->unary);
+  uint16_t old = load(c, &target);
+  if (!is_prefix && target.is_reg) {
+    // the register is about to change
+    old = op1(c, VM_MOV, old, 0);
+  }
+  uint16_t value = combine(c, is_increment ? EXP_ADD : EXP_SUBTRACT, old,
+                           value_type(exp->unary), constant(c, 1), dcc_type_basic(TYPE_INT));
+  value = store(c, &target, value);
+  return is_prefix ? value : old;
+}
+
+static uint16_t call(compiler_t *c, exp_t *exp) {
+  exp_t *callee = exp->call.lhs;
+  exp_vec_t *args = exp->call.args;
+  const type_t *func = value_type(callee)->base;
+  const type_t *ret = func->func.ret->unqual;
+  bool sret = dcc_type_is_record(ret);
+  bool direct = callee->tag == EXP_IDENT && callee->ident.symbol->tag == SYM_FUNCTION
+    && !dcc_ptrmap_get(&c->locals, callee->ident.symbol);
+
+  // a variadic function takes the arguments past its named ones laid out in
+  // the caller's frame, eight bytes apart, and their address after the rest
+  bool is_vararg = func->func.is_vararg;
+  size_t named = is_vararg ? func->func.count : args->size;
+  uint32_t count = sret + named + is_vararg;
+  uint16_t *values = dcc_malloc((count + 1) * sizeof(uint16_t));
+  values[0] = direct ? NO_REG : rvalue(c, callee);
+  if (sret) {
+    values[1] = frame_address(c, frame_alloc(c, ret));
+  }
+  uint16_t area = NO_REG;
+  int32_t offset = 0;
+  if (is_vararg) {
+    uint64_t size = 0;
+    for (size_t i = named; i < args->size; i++) {
+      const type_t *type = dcc_type_argument(func, i, value_type(args->data[i]));
+      size += round_up(dcc_type_size(type), 8);
+    }
+    area = frame_address(c, frame_alloc(c, dcc_type_array(dcc_type_basic(TYPE_LONG),
+                                                          size / 8)));
+    values[1 + sret + named] = area;
+  }
+  for (size_t i = 0; i < args->size; i++) {
+    exp_t *arg = args->data[i];
+    const type_t *type = dcc_type_argument(func, i, value_type(arg));
+    uint16_t value = convert(c, rvalue(c, arg), value_type(arg), type);
+    if (i >= named) {
+      lvalue_t target = memory(type, area, offset);
+      store(c, &target, value);
+      offset += round_up(dcc_type_size(type), 8);
+      continue;
+    } else if (dcc_type_is_record(type)) {
+      // the callee gets a copy of its own
+      uint16_t copy = frame_address(c, frame_alloc(c, type));
+      emit(c, VM_COPY, copy, value, 0, dcc_type_size(type));
+      value = copy;
+    }
+    values[1 + sret + i] = value;
+  }
+
+  // the callee and arguments go in consecutive registers
+  uint16_t first = temp(c);
+  for (uint32_t i = 0; i < count; i++) {
+    temp(c);
+  }
+  for (uint32_t i = direct; i <= count; i++) {
+    emit(c, VM_MOV, first + i, values[i], 0, 0);
+  }
+  free(values);
+  uint16_t result = temp(c);
+  if (direct) {
+    emit(c, VM_CALL, result, first + 1, count, func_index(c->vm, callee->ident.symbol));
+  } else {
+    emit(c, VM_CALLI, result, first, count, 0);
+  }
+  return ret->tag == TYPE_VOID ? NO_REG : result;
+}
+
+// The builtins of <stdarg.h>. Unlike compiled code, every argument past the
+// named ones is in the caller's area, so only the stack field of a va_list is
+// used.
+static uint16_t builtin(compiler_t *c, exp_t *exp) {
+  switch (exp->tag) {
+  case EXP_VA_START: {
+    uint16_t ap = rvalue(c, exp->binary.lhs);
+    emit(c, VM_STORE64, ap, c->va_area, 0, IR_VA_STACK);
+    break;
+  }
+  case EXP_VA_ARG: {
+    const type_t *type = value_type(exp);
+    uint16_t ap = rvalue(c, exp->cast.value);
+    uint16_t address = op1(c, VM_LOAD64, ap, IR_VA_STACK);
+    emit(c, VM_STORE64, ap, op1(c, VM_ADDI, address, round_up(dcc_type_size(type), 8)), 0,
+         IR_VA_STACK);
+    lvalue_t object = memory(type, address, 0);
+    return load(c, &object);
+  }
+  case EXP_VA_COPY: {
+    uint16_t to = rvalue(c, exp->binary.lhs), from = rvalue(c, exp->binary.rhs);
+    emit(c, VM_COPY, to, from, 0, IR_VA_LIST_SIZE);
+    break;
+  }
+  default:
+    rvalue(c, exp->unary);
+    break;
+  }
+  return NO_REG;
+}
+
+// The 0 or 1 of a logical expression
+static uint16_t logical(compiler_t *c, exp_t *exp) {
+  uint32_vec_t jumps = uint32_vec_new();
+  uint16_t result = temp(c);
+  emit(c, VM_CONST, result, 0, 0, 0);
+  jump_if(c, exp, false, &jumps);
+  emit(c, VM_CONST, result, 0, 0, 1);
+  patch_all(c, &jumps, here(c));
+  uint32_vec_free(&jumps);
+  return result;
+}
+
+static uint16_t ternary(compiler_t *c, exp_t *exp) {
+  const type_t *type = value_type(exp);
+  uint32_vec_t otherwise = uint32_vec_new();
+  uint16_t result = type->tag == TYPE_VOID ? NO_REG : temp(c);
+  jump_if(c, exp->ternary.cond, false, &otherwise);
+  uint16_t value = convert(c, rvalue(c, exp->ternary.true_exp),
+                           value_type(exp->ternary.true_exp), type);
+  if (result != NO_REG) {
+    emit(c, VM_MOV, result, value, 0, 0);
+  }
+  uint32_t join = emit(c, VM_JMP, 0, 0, 0, 0);
+  patch_all(c, &otherwise, here(c));
+  value = convert(c, rvalue(c, exp->ternary.false_exp), value_type(exp->ternary.false_exp),
+                  type);
+  if (result != NO_REG) {
+    emit(c, VM_MOV, result, value, 0, 0);
+  }
+  patch(c, join, here(c));
+  uint32_vec_free(&otherwise);
+  return result;
+}
+
+// The value of `exp` after decay, which is an address for an aggregate, or
+// NO_REG if it is void
+static uint16_t rvalue(compiler_t *c, exp_t *exp) {
+  const type_t *type = value_type(exp);
+  c->loc = exp->loc;
+  switch (exp->tag) {
+  case EXP_CONSTANT:
+    if (dcc_type_is_float(type)) {
+      double value = exp->constant->floating;
+      return constant(c, from_double(type->tag == TYPE_FLOAT ? (float)value : value));
+    }
+    return constant(c, exp->constant->integer);
+  case EXP_IDENT:
+    if (exp->ident.symbol->tag == SYM_ENUM_CONST) {
+      return constant(c, exp->ident.symbol->enumtor->value);
+    }
+    // fall through
+  case EXP_STRING:
+  case EXP_STRUCT:
+  case EXP_DEREFERENCE:
+  case EXP_INDEX:
+  case EXP_DOT:
+  case EXP_ARROW: {
+    lvalue_t object = lvalue(c, exp);
+    return load(c, &object);
+  }
+  case EXP_ADDRESSOF: {
+    lvalue_t object = lvalue(c, exp->unary);
+    dcc_assert(!object.is_reg);
+    return address_of(c, &object);
+  }
+  case EXP_SIZEOFEXP:
+    return constant(c, dcc_type_size(exp->unary->type));
+  case EXP_SIZEOFTYPE:
+    return constant(c, dcc_type_size(exp->cast.type->type));
+  case EXP_CAST: {
+    exp_t *value = exp->cast.value;
+    return convert(c, rvalue(c, value), value_type(value), type);
+  }
+  case EXP_NEGATE:
+  case EXP_BITNOT: {
+    uint16_t value = convert(c, rvalue(c, exp->unary), value_type(exp->unary), type);
+    enum vm_op op = exp->tag == EXP_BITNOT ? VM_NOT : dcc_type_is_float(type) ? VM_FNEG : VM_NEG;
+    return normalize(c, op1(c, op, value, 0), type);
+  }
+  case EXP_LOGICNOT: {
+    const type_t *operand = value_type(exp->unary);
+    uint16_t value = rvalue(c, exp->unary);
+    return op2(c, dcc_type_is_float(operand) ? VM_FEQ : VM_EQ, value, constant(c, 0));
+  }
+  case EXP_LOGICAND:
+  case EXP_LOGICOR:
+    return logical(c, exp);
+  case EXP_TERNARY:
+    return ternary(c, exp);
+  case EXP_ASSIGN:
+    return assign(c, exp);
+  case EXP_PREINCREMENT:
+  case EXP_PREDECREMENT:
+  case EXP_POSTINCREMENT:
+  case EXP_POSTDECREMENT:
+    return increment(c, exp);
+  case EXP_CALL:
+    return call(c, exp);
+  case EXP_VA_START:
+  case EXP_VA_ARG:
+  case EXP_VA_COPY:
+  case EXP_VA_END:
+    return builtin(c, exp);
+  case EXP_LIST:
+    for (size_t i = 0; i + 1 < exp->list.size; i++) {
+      rvalue(c, exp->list.data[i]);
+    }
+    return rvalue(c, exp->list.data[exp->list.size - 1]);
+  case EXP_LESS:
+  case EXP_MORE:
+  case EXP_LESSEQ:
+  case EXP_MOREEQ:
+  case EXP_EQUAL:
+  case EXP_NOTEQUAL:
+    return compare(c, exp);
+  case EXP_UNKNOWN:
+    dcc_ice("compiling an unknown expression");
+    return NO_REG;
+  default:
+    return binary(c, exp);
+  }
+}
+
+// Jump to a target added to `jumps` if `exp` is `when`, falling through
+// otherwise, without materializing the value of && and ||
+static void jump_if(compiler_t *c, exp_t *exp, bool when, uint32_vec_t *jumps) {
+  switch (exp->tag) {
+  case EXP_LOGICAND:
+  case EXP_LOGICOR: {
+    // `a && b` is false if either is, `a || b` true if either is
+    if ((exp->tag == EXP_LOGICAND) != when) {
+      jump_if(c, exp->binary.lhs, when, jumps);
+      jump_if(c, exp->binary.rhs, when, jumps);
+      return;
+    }
+    uint32_vec_t skip = uint32_vec_new();
+    jump_if(c, exp->binary.lhs, !when, &skip);
+    jump_if(c, exp->binary.rhs, when, jumps);
+    patch_all(c, &skip, here(c));
+    uint32_vec_free(&skip);
+    return;
+  }
+  case EXP_LOGICNOT:
+    jump_if(c, exp->unary, !when, jumps);
+    return;
+  case EXP_CONSTANT:
+    if (exp->constant->tag != CONSTANT_FLOAT) {
+      if (!exp->constant->integer == !when) {
+        uint32_vec_push(jumps, emit(c, VM_JMP, 0, 0, 0, 0));
+      }
+      return;
+    }
+    break;
+  default:
+    break;
+  }
+
+  const type_t *type = value_type(exp);
+  uint16_t value = rvalue(c, exp);
+  if (dcc_type_is_float(type)) {
+    value = op2(c, VM_FNE, value, constant(c, 0));
+  }
+  uint32_vec_push(jumps, emit(c, when ? VM_BRNZ : VM_BRZ, value, 0, 0, 0));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Declarations
+////////////////////////////////////////////////////////////////////////////////
+
+// Fill the object at `address` from `init`
+static void init_object(compiler_t *c, uint16_t address, const type_t *type,
+                        initializer_t *init) {
+  if (init->tag == INIT_EXP && type->tag != TYPE_ARRAY) {
+    lvalue_t target = memory(type, address, 0);
+    exp_t *exp = init->expression;
+    store(c, &target, convert(c, rvalue(c, exp), value_type(exp), type->unqual));
+    return;
+  }
+
+  emit(c, VM_ZERO, address, 0, 0, dcc_type_size(type));
+  int64_t length;
+  init_entry_vec_t entries = dcc_init_layout(type, init, 0, &length);
+  for (size_t i = 0; i < entries.size; i++) {
+    init_entry_t *entry = &entries.data[i];
+    exp_t *exp = entry->exp;
+    uint32_t mark = c->regs;
+    if (entry->type->tag == TYPE_ARRAY) {
+      uint16_t at = op1(c, VM_ADDI, address, entry->offset);
+      emit(c, VM_COPY, at, rvalue(c, exp), 0, dcc_init_string_size(entry));
+    } else {
+      lvalue_t target = memory(entry->type, address, entry->offset);
+      target.bit_offset = entry->bit_offset;
+      target.bit_width = entry->bit_width;
+      store(c, &target, convert(c, rvalue(c, exp), value_type(exp), entry->type->unqual));
+    }
+    c->regs = mark;
+  }
+  init_entry_vec_free(&entries);
+}
+
+static local_t* new_local(compiler_t *c, symbol_t *symbol) {
+  const type_t *type = symbol->type;
+  local_t *local = dcc_arena_alloc(&c->vm->arena, sizeof(local_t));
+  if (dcc_type_is_scalar(type) && !dcc_ptrmap_get(&c->escaped, symbol)) {
+    local->tag = LOCAL_REG;
+    local->index = temp(c);
+  } else {
+    local->tag = LOCAL_FRAME;
+    local->index = frame_alloc(c, type);
+  }
+  dcc_ptrmap_put(&c->locals, symbol, local);
+  return local;
+}
+
+static void compile_decl(compiler_t *c, decl_t *decl) {
+  // static and extern locals have static storage, which is laid out elsewhere
+  if (decl->specifiers->storage & (AST_STORAGE_TYPEDEF | AST_STORAGE_EXTERN
+                                   | AST_STORAGE_STATIC)) {
+    return;
+  }
+  for (size_t i = 0; i < decl->init_decltors.size; i++) {
+    init_decltor_t *init_decltor = decl->init_decltors.data[i];
+    ident_t *ident = dcc_decltor_ident(init_decltor->declarator);
+    symbol_t *symbol = ident ? ident->symbol : 0;
+    if (!symbol || symbol->tag != SYM_OBJECT) {
+      continue;
+    }
+    local_t *local = new_local(c, symbol);
+    initializer_t *init = init_decltor->initializer;
+    uint32_t mark = c->regs;
+    if (!init) {
+      continue;
+    } else if (local->tag == LOCAL_FRAME) {
+      init_object(c, frame_address(c, local->index), symbol->type, init);
+      c->regs = mark;
+      continue;
+    }
+
+    // a scalar may still be braced
+    while (init->tag == INIT_LIST) {
+      init = init->inits->data[0].initializer;
+    }
+    exp_t *exp = init->expression;
+    uint16_t value = convert(c, rvalue(c, exp), value_type(exp), symbol->type->unqual);
+    emit(c, VM_MOV, local->index, value, 0, 0);
+    c->regs = mark;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Statements
+////////////////////////////////////////////////////////////////////////////////
+
+static void compile_stmt(compiler_t *c, stmt_t *stmt);
+
+static void compile_items(compiler_t *c, block_item_vec_t *items) {
+  // the locals of a block are gone once it ends, and their registers with them
+  uint32_t outer = c->regs;
+  for (size_t i = 0; i < items->size; i++) {
+    block_item_t *item = items->data[i];
+    if (item->tag == AST_DECLARATION) {
+      compile_decl(c, item->declaration);
+    } else {
+      compile_stmt(c, item->statement);
+    }
+  }
+  c->regs = outer;
+}
+
+static void label_target(compiler_t *c, symbol_t *label) {
+  dcc_ptrmap_put(&c->labels, label, (void*)(uintptr_t)(here(c) + 1));
+}
+
+// Compile the body of a loop, whose breaks and continues are added to the
+// jumps given
+static void loop_body(compiler_t *c, stmt_t *body, uint32_vec_t *breaks,
+                      uint32_vec_t *continues) {
+  uint32_vec_t *outer_breaks = c->breaks, *outer_continues = c->continues;
+  c->breaks = breaks;
+  c->continues = continues;
+  compile_stmt(c, body);
+  c->breaks = outer_breaks;
+  c->continues = outer_continues;
+}
+
+// The value a function returns when control reaches its end
+static void return_default(compiler_t *c) {
+  if (c->ret->tag == TYPE_VOID) {
+    emit(c, VM_RETVOID, 0, 0, 0, 0);
+  } else {
+    // only main has a value to return; for any other function, using it is
+    // undefined
+    emit(c, VM_RET, constant(c, 0), 0, 0, 0);
+  }
+}
+
+// The dispatch of a switch on `value` by its plan
+typedef struct {
+  uint16_t value;
+  bool is_signed;
+  const switch_case_vec_t *cases;
+  const switch_plan_t *plan;
+  uint32_vec_t misses; // jumps to the default
+} vm_dispatch_t;
+
+// Test the value against one cluster, going on to the next instruction if it
+// misses
+static void compile_cluster(compiler_t *c, vm_dispatch_t *d, const switch_cluster_t *cluster) {
+  uint32_t mark = c->regs;
+  const switch_case_t *cases = d->cases->data + cluster->first;
+  int64_t low = cluster->low;
+  if (cluster->tag == SWITCH_CASE) {
+    uint16_t match = op2(c, VM_EQ, d->value, constant(c, low));
+    emit(c, VM_BRNZ, match, 0, 0, cases[0].target);
+    c->regs = mark;
+    return;
+  }
+
+  uint64_t range = cluster->range;
+  uint16_t index = low ? op2(c, VM_SUB, d->value, constant(c, low)) : d->value;
+  if (cluster->tag == SWITCH_TABLE) {
+    uint32_vec_t *tables = &c->func->tables;
+    emit(c, VM_SWITCH, index, 0, 0, tables->size);
+    uint32_vec_push(tables, range);
+    size_t base = tables->size;
+    for (uint64_t e = 0; e < range; e++) {
+      uint32_vec_push(tables, UINT32_MAX);
+    }
+    for (uint32_t i = 0; i < cluster->count; i++) {
+      tables->data[base + ((uint64_t)cases[i].value - (uint64_t)low)] = cases[i].target;
+    }
+    c->regs = mark;
+    return;
+  }
+
+  // a bit test: the index selects a bit of the mask of each target
+  uint16_t in_range = op2(c, VM_ULE, index, constant(c, range - 1));
+  uint32_t skip = emit(c, VM_BRZ, in_range, 0, 0, 0);
+  uint16_t bit = op2(c, VM_SHL, constant(c, 1), index);
+  for (uint32_t m = 0; m < cluster->masks; m++) {
+    const switch_mask_t *mask = &cluster->mask[m];
+    emit(c, VM_BRNZ, op2(c, VM_AND, bit, constant(c, mask->mask)), 0, 0, mask->target);
+  }
+  patch(c, skip, here(c));
+  c->regs = mark;
+}
+
+// Compile the search from `node` of the plan
+static void compile_search(compiler_t *c, vm_dispatch_t *d, uint32_t node) {
+  const switch_node_t *n = &d->plan->nodes.data[node];
+  if (!n->is_split) {
+    for (uint32_t i = 0; i < n->count; i++) {
+      compile_cluster(c, d, &d->plan->clusters.data[n->first + i]);
+    }
+    uint32_vec_push(&d->misses, emit(c, VM_JMP, 0, 0, 0, 0));
+    return;
+  }
+  uint32_t mark = c->regs;
+  uint16_t pivot = constant(c, n->pivot);
+  uint16_t less = op2(c, d->is_signed ? VM_SLT : VM_ULT, d->value, pivot);
+  uint32_t right = emit(c, VM_BRZ, less, 0, 0, 0);
+  c->regs = mark;
+  compile_search(c, d, n->left);
+  patch(c, right, here(c));
+  compile_search(c, d, n->right);
+}
+
+static void compile_switch(compiler_t *c, stmt_t *stmt) {
+  exp_t *exp = stmt->stmt_whiledo.exp;
+  const type_t *type = dcc_type_promote(value_type(exp));
+  uint16_t value = convert(c, rvalue(c, exp), value_type(exp), type);
+  uint32_t dispatch = emit(c, VM_JMP, 0, 0, 0, 0);
+
+  // the body reaches its cases, and only then is the dispatch known
+  vm_switch_t context = { switch_case_vec_new(), UINT32_MAX };
+  vm_switch_t *outer = c->switch_;
+  uint32_vec_t *outer_breaks = c->breaks;
+  uint32_vec_t breaks = uint32_vec_new();
+  c->switch_ = &context;
+  c->breaks = &breaks;
+  compile_stmt(c, stmt->stmt_whiledo.stmt);
+  uint32_vec_push(&breaks, emit(c, VM_JMP, 0, 0, 0, 0));
+  c->switch_ = outer;
+  c->breaks = outer_breaks;
+
+  patch(c, dispatch, here(c));
+  bool is_signed = dcc_type_is_signed(type);
+  switch_plan_t plan = dcc_switch_plan(&context.cases, is_signed);
+  vm_dispatch_t d = { value, is_signed, &context.cases, &plan, uint32_vec_new() };
+  if (plan.nodes.size) {
+    compile_search(c, &d, 0);
+  } else {
+    uint32_vec_push(&d.misses, emit(c, VM_JMP, 0, 0, 0, 0));
+  }
+  if (context.default_target != UINT32_MAX) {
+    patch_all(c, &d.misses, context.default_target);
+  } else {
+    for (size_t i = 0; i < d.misses.size; i++) {
+      uint32_vec_push(&breaks, d.misses.data[i]);
+    }
+  }
+  patch_all(c, &breaks, here(c));
+  uint32_vec_free(&breaks);
+  uint32_vec_free(&d.misses);
+  dcc_switch_plan_free(&plan);
+  switch_case_vec_free(&context.cases);
+}
+
+static void compile_stmt(compiler_t *c, stmt_t *stmt) {
+  uint32_t mark = c->regs;
+  c->loc = stmt->loc;
+  switch (stmt->tag) {
+  case STMT_CASE: {
+    switch_case_t case_ = { stmt->stmt_case.value, here(c) };
+    switch_case_vec_push(&c->switch_->cases, case_);
+    compile_stmt(c, stmt->stmt_case.stmt);
+    break;
+  }
+  case STMT_DEFAULT:
+    c->switch_->default_target = here(c);
+    compile_stmt(c, stmt->stmt);
+    break;
+  case STMT_LABEL:
+    label_target(c, stmt->stmt_label.ident.symbol);
+    compile_stmt(c, stmt->stmt_label.stmt);
+    break;
+  case STMT_COMPOUND:
+    compile_items(c, &stmt->stmt_compound);
+    break;
+  case STMT_EXP:
+    if (stmt->exp) {
+      rvalue(c, stmt->exp);
+    }
+    break;
+  case STMT_IF: {
+    uint32_vec_t otherwise = uint32_vec_new();
+    jump_if(c, stmt->stmt_select.exp, false, &otherwise);
+    c->regs = mark;
+    compile_stmt(c, stmt->stmt_select.primary);
+    if (stmt->stmt_select.secondary) {
+      uint32_t join = emit(c, VM_JMP, 0, 0, 0, 0);
+      patch_all(c, &otherwise, here(c));
+      compile_stmt(c, stmt->stmt_select.secondary);
+      patch(c, join, here(c));
+    } else {
+      patch_all(c, &otherwise, here(c));
+    }
+    uint32_vec_free(&otherwise);
+    break;
+  }
+  case STMT_SWITCH:
+    compile_switch(c, stmt);
+    break;
+  case STMT_WHILE:
+  case STMT_DO:
+  case STMT_FOR: {
+    // every loop is laid out with its test at the bottom:
+    //   [init] jmp test; body: ...; next: [step]; test: br body; exit:
+    uint32_vec_t breaks = uint32_vec_new(), continues = uint32_vec_new();
+    exp_t *test = stmt->tag == STMT_FOR ? stmt->stmt_for.exp2 : stmt->stmt_whiledo.exp;
+    stmt_t *body = stmt->tag == STMT_FOR ? stmt->stmt_for.stmt : stmt->stmt_whiledo.stmt;
+    if (stmt->tag == STMT_FOR && stmt->stmt_for.decl) {
+      compile_decl(c, stmt->stmt_for.decl);
+    } else if (stmt->tag == STMT_FOR && stmt->stmt_for.exp1) {
+      uint32_t outer = c->regs;
+      rvalue(c, stmt->stmt_for.exp1);
+      c->regs = outer;
+    }
+    uint32_t entry = stmt->tag == STMT_DO ? UINT32_MAX : emit(c, VM_JMP, 0, 0, 0, 0);
+    uint32_t start = here(c);
+    loop_body(c, body, &breaks, &continues);
+    patch_all(c, &continues, here(c));
+    if (stmt->tag == STMT_FOR && stmt->stmt_for.exp3) {
+      uint32_t outer = c->regs;
+      rvalue(c, stmt->stmt_for.exp3);
+      c->regs = outer;
+    }
+    if (entry != UINT32_MAX) {
+      patch(c, entry, here(c));
+    }
+    if (test) {
+      uint32_vec_t loop = uint32_vec_new();
+      jump_if(c, test, true, &loop);
+      patch_all(c, &loop, start);
+      uint32_vec_free(&loop);
+    } else {
+      emit(c, VM_JMP, 0, 0, 0, start);
+    }
+    patch_all(c, &breaks, here(c));
+    uint32_vec_free(&breaks);
+    uint32_vec_free(&continues);
+    break;
+  }
+  case STMT_GOTO: {
+    vm_goto_t jump = { emit(c, VM_JMP, 0, 0, 0, 0), stmt->label.symbol };
+    vm_goto_vec_push(&c->gotos, jump);
+    break;
+  }
+  case STMT_CONTINUE:
+    uint32_vec_push(c->continues, emit(c, VM_JMP, 0, 0, 0, 0));
+    break;
+  case STMT_BREAK:
+    uint32_vec_push(c->breaks, emit(c, VM_JMP, 0, 0, 0, 0));
+    break;
+  case STMT_RETURN: {
+    exp_t *exp = stmt->exp;
+    uint16_t value = exp ? rvalue(c, exp) : NO_REG;
+    if (value == NO_REG || c->ret->tag == TYPE_VOID) {
+      return_default(c);
+    } else if (c->sret != NO_REG) {
+      emit(c, VM_COPY, c->sret, value, 0, dcc_type_size(c->ret));
+      emit(c, VM_RET, c->sret, 0, 0, 0);
+    } else {
+      emit(c, VM_RET, convert(c, value, value_type(exp), c->ret), 0, 0, 0);
+    }
+    break;
+  }
+  }
+  // a for loop's declarations live only as long as the loop
+  c->regs = mark;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Functions
+////////////////////////////////////////////////////////////////////////////////
+
+static compiler_t compiler_new(vm_t *vm, vm_func_t *func, const type_t *ret) {
+  compiler_t c = {
+    vm, func, dcc_ptrmap_new(), dcc_ptrmap_new(), dcc_ptrmap_new(), vm_goto_vec_new(),
+    0, 0, 0, ret, NO_REG, NO_REG, 0, 0, false,
+  };
+  return c;
+}
+
+// Finish compiling a function, returning false if it cannot run
+static bool compiler_free(compiler_t *c) {
+  for (size_t i = 0; i < c->gotos.size; i++) {
+    vm_goto_t *jump = &c->gotos.data[i];
+    patch(c, jump->jump, (uintptr_t)dcc_ptrmap_get(&c->labels, jump->label) - 1);
+  }
+  dcc_ptrmap_free(&c->escaped);
+  dcc_ptrmap_free(&c->locals);
+  dcc_ptrmap_free(&c->labels);
+  vm_goto_vec_free(&c->gotos);
+  return !c->failed;
+}
+
+static void compile_param(compiler_t *c, uint16_t reg, symbol_t *symbol,
+                          const type_t *type) {
+  if (!symbol) {
+    return;
+  }
+  local_t *local = dcc_arena_alloc(&c->vm->arena, sizeof(local_t));
+  local->tag = LOCAL_REG;
+  local->index = reg;
+  if (dcc_type_is_record(type)) {
+    local->tag = LOCAL_INDIRECT;
+  } else if (dcc_ptrmap_get(&c->escaped, symbol)) {
+    local->tag = LOCAL_FRAME;
+    local->index = frame_alloc(c, type);
+    lvalue_t target = memory(type, frame_address(c, local->index), 0);
+    store(c, &target, reg);
+  } else if (dcc_type_size(type) < 8 || type->tag == TYPE_FLOAT) {
+    // an argument without a prototype comes promoted
+    emit(c, VM_MOV, reg, normalize(c, reg, type->unqual), 0, 0);
+  }
+  dcc_ptrmap_put(&c->locals, symbol, local);
+}
+
+static bool compile_function(vm_t *vm, func_def_t *def) {
+  symbol_t *symbol = dcc_decltor_ident(def->declarator)->symbol;
+  uint32_t index = func_index(vm, symbol);
+  vm_func_t *func = vm->funcs.data[index];
+  func->is_defined = true;
+  compiler_t c = compiler_new(vm, func, symbol->type->func.ret->unqual);
+  c.loc = symbol->loc;
+  dcc_find_escaped(def->compound, &c.escaped);
+
+  // the parameters arrive in the first registers, after the address an
+  // aggregate returns to
+  if (dcc_type_is_record(c.ret)) {
+    c.sret = temp(&c);
+  }
+  direct_decltor_t *params = dcc_decltor_func(def->declarator);
+  size_t count = params->tag == AST_DECLTOR_FUNC_IDENTS
+    ? (params->idents ? params->idents->size : 0)
+    : (params->params ? params->params->decls.size : 0);
+  if (params->tag == AST_DECLTOR_FUNC_TYPES && count
+      && params->params->decls.data[0]->type->tag == TYPE_VOID) {
+    count = 0;
+  }
+  uint16_t first = c.regs;
+  for (size_t i = 0; i < count; i++) {
+    temp(&c);
+  }
+  if (symbol->type->func.is_vararg) {
+    c.va_area = temp(&c);
+  }
+  func->param_count = c.regs;
+  for (size_t i = 0; i < count; i++) {
+    if (params->tag == AST_DECLTOR_FUNC_IDENTS) {
+      symbol_t *param = params->idents->data[i].symbol;
+      compile_param(&c, first + i, param, param->type);
+    } else {
+      param_decl_t *decl = params->params->decls.data[i];
+      ident_t *name = decl->decltor ? dcc_decltor_ident(decl->decltor) : 0;
+      compile_param(&c, first + i, name ? name->symbol : 0, decl->type);
+    }
+    c.regs = func->param_count;
+  }
+
+  compile_stmt(&c, def->compound);
+  return_default(&c);
+  return compiler_free(&c);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Running
+////////////////////////////////////////////////////////////////////////////////
+
+// Make room for registers up to `top`, returning false if that is too many
+static bool reserve_regs(vm_t *vm, uint64_t top) {
+  if (top > VM_REG_LIMIT) {
+    return false;
+  } else if (top > vm->reg_capacity) {
+    while (vm->reg_capacity < top) {
+      vm->reg_capacity *= 2;
+    }
+    vm->regs = dcc_realloc(vm->regs, vm->reg_capacity * sizeof(uint64_t));
+  }
+  return true;
+}
+
+static uint64_t float_to_signed(double d) {
+  // out of range is undefined, which here is what x86 gives
+  return d >= -0x1p63 && d < 0x1p63 ? (uint64_t)(int64_t)d : (uint64_t)1 << 63;
+}
+
+static uint64_t float_to_unsigned(double d) {
+  if (d >= 0x1p63 && d < 0x1p64) {
+    return (uint64_t)(d - 0x1p63) + ((uint64_t)1 << 63);
+  }
+  return float_to_signed(d);
+}
+
+#ifdef __GNUC__
+// threaded: each handler jumps straight to the next
+#define OP(name) op_##name:
+#define NEXT() goto *LABELS[pc->op]
+#define DISPATCH() NEXT();
+#define END_DISPATCH()
+#else
+#define OP(name) case VM_##name:
+#define NEXT() goto dispatch
+#define DISPATCH() dispatch: switch (pc->op) {
+#define END_DISPATCH() }
+#endif
+
+#define BINARY(name, expr)                      \
+  OP(name) {                                    \
+    uint64_t x = r[pc->b], y = r[pc->c];        \
+    r[pc->a] = (expr);                          \
+    pc++;                                       \
+    NEXT();                                     \
+  }
+#define FBINARY(name, expr)                                 \
+  OP(name) {                                                \
+    double x = to_double(r[pc->b]), y = to_double(r[pc->c]); \
+    r[pc->a] = (expr);                                      \
+    pc++;                                                   \
+    NEXT();                                                 \
+  }
+#define UNARY(name, expr)                       \
+  OP(name) {                                    \
+    uint64_t x = r[pc->b];                      \
+    r[pc->a] = (expr);                          \
+    pc++;                                       \
+    NEXT();                                     \
+  }
+// Whether `size` bytes at `at` are all memory the program may touch
+#define CHECK(at, size)                                                 \
+  if ((at) < VM_NULL_GUARD || (at) > limit || limit - (at) < (size)) {  \
+    error = "memory access out of bounds";                             \
+    goto trap;                                                          \
+  }
+#define LOAD(name, type, convert)               \
+  OP(name) {                                    \
+    uint64_t at = r[pc->b] + pc->imm;           \
+    type x;                                     \
+    CHECK(at, sizeof x);                        \
+    memcpy(&x, vm->memory + at, sizeof x);      \
+    r[pc->a] = (convert);                       \
+    pc++;                                       \
+    NEXT();                                     \
+  }
+#define STORE(name, type, convert)              \
+  OP(name) {                                    \
+    uint64_t at = r[pc->a] + pc->imm;           \
+    type x = (convert);                         \
+    CHECK(at, sizeof x);                        \
+    memcpy(vm->memory + at, &x, sizeof x);      \
+    pc++;                                       \
+    NEXT();                                     \
+  }
+// Count a step, trapping once there have been too many
+#define STEP()                                  \
+  if (++steps > VM_STEP_LIMIT) {                \
+    error = "step limit exceeded";              \
+    goto trap;                                  \
+  }
+
+// Call `entry` with the given arguments in fresh registers and frame
+static bool run(vm_t *vm, vm_func_t *entry, const uint64_t *args, uint32_t count,
+                uint64_t *result) {
+#ifdef __GNUC__
+  static const void *LABELS[] = {
+#define VM_LABEL(name) &&op_##name,
+    VM_OPS(VM_LABEL)
+#undef VM_LABEL
+  };
+#endif
+  vm_func_t *func = entry, *callee;
+  const vm_instr_t *pc = func->code.data;
+  const char *error = 0, *name = 0;
+  uint64_t base = 0, fp = round_up(vm->size, 16), limit = fp + func->frame_size;
+  uint64_t steps = 0, arg;
+  vm_frame_vec_t *frames = &vm->frames;
+  frames->size = 0;
+  if (!reserve_regs(vm, func->reg_count) || !reserve(vm, limit)) {
+    error = "stack overflow";
+    goto trap;
+  }
+  uint64_t *r = vm->regs;
+  memset(r, 0, func->param_count * sizeof(uint64_t));
+  for (uint32_t i = 0; i < count && i < func->param_count; i++) {
+    r[i] = args[i];
+  }
+
+  DISPATCH()
+  OP(MOV) r[pc->a] = r[pc->b]; pc++; NEXT();
+  OP(CONST) r[pc->a] = (int64_t)pc->imm; pc++; NEXT();
+  OP(CONST64) r[pc->a] = func->constants.data[pc->imm]; pc++; NEXT();
+  OP(FRAME) r[pc->a] = fp + pc->imm; pc++; NEXT();
+
+  BINARY(ADD, x + y)
+  BINARY(SUB, x - y)
+  BINARY(MUL, x * y)
+  OP(SDIV)
+  OP(SREM)
+  OP(UDIV)
+  OP(UREM) {
+    uint64_t x = r[pc->b], y = r[pc->c];
+    if (!y) {
+      error = "division by zero";
+      goto trap;
+    }
+    switch (pc->op) {
+    case VM_SDIV: x = y == UINT64_MAX ? -x : (uint64_t)((int64_t)x / (int64_t)y); break;
+    case VM_SREM: x = y == UINT64_MAX ? 0 : (uint64_t)((int64_t)x % (int64_t)y); break;
+    case VM_UDIV: x /= y; break;
+    default: x %= y; break;
+    }
+    r[pc->a] = x;
+    pc++;
+    NEXT();
+  }
+  BINARY(AND, x & y)
+  BINARY(OR, x | y)
+  BINARY(XOR, x ^ y)
+  BINARY(SHL, x << (y & 63))
+  BINARY(SAR, (uint64_t)((int64_t)x >> (y & 63)))
+  BINARY(SHR, x >> (y & 63))
+  UNARY(ADDI, x + (int64_t)pc->imm)
+  UNARY(MULI, x * (int64_t)pc->imm)
+  UNARY(SHLI, x << (pc->imm & 63))
+  UNARY(SARI, (uint64_t)((int64_t)x >> (pc->imm & 63)))
+  UNARY(SHRI, x >> (pc->imm & 63))
+  UNARY(NEG, -x)
+  UNARY(NOT, ~x)
+  BINARY(EQ, x == y)
+  BINARY(NE, x != y)
+  BINARY(SLT, (int64_t)x < (int64_t)y)
+  BINARY(SLE, (int64_t)x <= (int64_t)y)
+  BINARY(ULT, x < y)
+  BINARY(ULE, x <= y)
+  UNARY(EXT8S, (uint64_t)(int64_t)(int8_t)x)
+  UNARY(EXT8U, (uint8_t)x)
+  UNARY(EXT16S, (uint64_t)(int64_t)(int16_t)x)
+  UNARY(EXT16U, (uint16_t)x)
+  UNARY(EXT32S, (uint64_t)(int64_t)(int32_t)x)
+  UNARY(EXT32U, (uint32_t)x)
+  UNARY(BOOL, x != 0)
+
+  FBINARY(FADD, from_double(x + y))
+  FBINARY(FSUB, from_double(x - y))
+  FBINARY(FMUL, from_double(x * y))
+  FBINARY(FDIV, from_double(x / y))
+  UNARY(FNEG, from_double(-to_double(x)))
+  FBINARY(FEQ, x == y)
+  FBINARY(FNE, x != y)
+  FBINARY(FLT, x < y)
+  FBINARY(FLE, x <= y)
+  UNARY(SITOF, from_double((double)(int64_t)x))
+  UNARY(UITOF, from_double((double)x))
+  UNARY(FTOSI, float_to_signed(to_double(x)))
+  UNARY(FTOUI, float_to_unsigned(to_double(x)))
+  UNARY(FROUND, from_double((float)to_double(x)))
+
+  LOAD(LOAD8S, int8_t, (uint64_t)(int64_t)x)
+  LOAD(LOAD8U, uint8_t, x)
+  LOAD(LOAD16S, int16_t, (uint64_t)(int64_t)x)
+  LOAD(LOAD16U, uint16_t, x)
+  LOAD(LOAD32S, int32_t, (uint64_t)(int64_t)x)
+  LOAD(LOAD32U, uint32_t, x)
+  LOAD(LOAD64, uint64_t, x)
+  LOAD(LOADF32, float, from_double(x))
+  STORE(STORE8, uint8_t, r[pc->b])
+  STORE(STORE16, uint16_t, r[pc->b])
+  STORE(STORE32, uint32_t, r[pc->b])
+  STORE(STORE64, uint64_t, r[pc->b])
+  STORE(STOREF32, float, to_double(r[pc->b]))
+  OP(COPY) {
+    uint64_t to = r[pc->a], from = r[pc->b], size = (uint32_t)pc->imm;
+    CHECK(to, size);
+    CHECK(from, size);
+    memmove(vm->memory + to, vm->memory + from, size);
+    pc++;
+    NEXT();
+  }
+  OP(ZERO) {
+    uint64_t to = r[pc->a], size = (uint32_t)pc->imm;
+    CHECK(to, size);
+    memset(vm->memory + to, 0, size);
+    pc++;
+    NEXT();
+  }
+
+  OP(JMP) {
+    const vm_instr_t *target = func->code.data + pc->imm;
+    if (target <= pc) {
+      STEP();
+    }
+    pc = target;
+    NEXT();
+  }
+  OP(BRZ)
+  OP(BRNZ) {
+    if (!r[pc->a] == (pc->op == VM_BRZ)) {
+      const vm_instr_t *target = func->code.data + pc->imm;
+      if (target <= pc) {
+        STEP();
+      }
+      pc = target;
+    } else {
+      pc++;
+    }
+    NEXT();
+  }
+  OP(SWITCH) {
+    const uint32_t *table = func->tables.data + pc->imm;
+    uint64_t index = r[pc->a];
+    if (index < table[0] && table[1 + index] != UINT32_MAX) {
+      const vm_instr_t *target = func->code.data + table[1 + index];
+      if (target <= pc) {
+        STEP();
+      }
+      pc = target;
+    } else {
+      pc++;
+    }
+    NEXT();
+  }
+  OP(CALL)
+    callee = vm->funcs.data[pc->imm];
+    arg = pc->b;
+    goto call;
+  OP(CALLI) {
+    uint64_t index = r[pc->b] - VM_FUNC_BASE;
+    if (index >= vm->funcs.size) {
+      error = "call through an invalid function pointer";
+      goto trap;
+    }
+    callee = vm->funcs.data[index];
+    arg = pc->b + 1;
+    goto call;
+  }
+call: {
+    STEP();
+    if (!callee->is_defined) {
+      name = callee->name;
+      error = "call to undefined function";
+      goto trap;
+    }
+    vm_frame_t frame = { func, pc + 1, base, fp, limit, pc->a };
+    vm_frame_vec_push(frames, frame);
+    uint64_t callee_base = base + func->reg_count;
+    uint64_t callee_fp = round_up(limit, 16);
+    if (!reserve_regs(vm, callee_base + callee->reg_count)
+        || !reserve(vm, callee_fp + callee->frame_size)) {
+      error = "stack overflow";
+      goto trap;
+    }
+    r = vm->regs + callee_base;
+    uint32_t passed = pc->c < callee->param_count ? pc->c : callee->param_count;
+    memcpy(r, vm->regs + base + arg, passed * sizeof(uint64_t));
+    memset(r + passed, 0, (callee->param_count - passed) * sizeof(uint64_t));
+    func = callee;
+    base = callee_base;
+    fp = callee_fp;
+    limit = fp + func->frame_size;
+    pc = func->code.data;
+    NEXT();
+  }
+  OP(RET)
+  OP(RETVOID) {
+    uint64_t value = pc->op == VM_RET ? r[pc->a] : 0;
+    if (!frames->size) {
+      *result = value;
+      return true;
+    }
+    vm_frame_t frame = vm_frame_vec_pop(frames);
+    func = frame.func;
+    pc = frame.ret;
+    base = frame.base;
+    fp = frame.fp;
+    limit = frame.top;
+    r = vm->regs + base;
+    r[frame.dst] = value;
+    NEXT();
+  }
+  END_DISPATCH()
+
+trap:
+  if (name) {
+    dcc_diag(vm->diags, DIAG_ERROR, func->locs.data[pc - func->code.data], 1, "%s '%s'",
+             error, name);
+  } else if (func->locs.size) {
+    dcc_diag(vm->diags, DIAG_ERROR, func->locs.data[pc - func->code.data], 1, "%s", error);
+  }
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Interface
+////////////////////////////////////////////////////////////////////////////////
+
+vm_t* dcc_vm_new(diag_vec_t *diags) {
+  vm_t *vm = dcc_calloc(1, sizeof(vm_t));
+  vm->diags = diags;
+  vm->arena = dcc_arena_new();
+  vm->capacity = 4096;
+  vm->memory = dcc_calloc(vm->capacity, 1);
+  vm->size = VM_NULL_GUARD;
+  vm->reg_capacity = 256;
+  vm->regs = dcc_calloc(vm->reg_capacity, sizeof(uint64_t));
+  vm->frames = vm_frame_vec_new();
+  vm->funcs = vm_func_vec_new();
+  vm->globals = dcc_ptrmap_new();
+  vm->objects = vm_global_vec_new();
+  vm->strings = dcc_ptrmap_new();
+  return vm;
+}
+
+void dcc_vm_free(vm_t *vm) {
+  for (size_t i = 0; i < vm->funcs.size; i++) {
+    vm_func_t *func = vm->funcs.data[i];
+    vm_instr_vec_free(&func->code);
+    uint32_vec_free(&func->locs);
+    vm_word_vec_free(&func->constants);
+    uint32_vec_free(&func->tables);
+  }
+  vm_func_vec_free(&vm->funcs);
+  vm_frame_vec_free(&vm->frames);
+  vm_global_vec_free(&vm->objects);
+  dcc_ptrmap_free(&vm->globals);
+  dcc_ptrmap_free(&vm->strings);
+  dcc_arena_free(&vm->arena);
+  free(vm->memory);
+  free(vm->regs);
+  free(vm);
+}
+
+bool dcc_vm_load(vm_t *vm, external_decl_vec_t *unit) {
+  dcc_sema_globals(unit, declare, vm);
+  // every object is laid out before any code refers to it
+  bool ok = true;
+  for (size_t i = 0; i < vm->objects.size; i++) {
+    ok = global_address(vm, vm->objects.data[i]->symbol) && ok;
+  }
+  if (!ok) {
+    return false;
+  }
+
+  for (size_t i = 0; i < unit->size; i++) {
+    if (unit->data[i]->tag == AST_EXT_FUNCTION) {
+      ok = compile_function(vm, unit->data[i]->function) && ok;
+    }
+  }
+
+  // the initializers of every object run once, before anything else
+  vm_func_t *init = new_func(vm, "<init>");
+  init->is_defined = true;
+  compiler_t c = compiler_new(vm, init, dcc_type_basic(TYPE_VOID));
+  for (size_t i = 0; i < vm->objects.size; i++) {
+    vm_global_t *global = vm->objects.data[i];
+    if (global->init) {
+      c.loc = global->symbol->loc;
+      init_object(&c, constant(&c, global->address), global->symbol->type, global->init);
+      c.regs = 0;
+    }
+  }
+  emit(&c, VM_RETVOID, 0, 0, 0, 0);
+  uint64_t result;
+  return compiler_free(&c) && ok && run(vm, init, 0, 0, &result);
+}
+
+static vm_func_t* find_func(vm_t *vm, const char *name) {
+  for (size_t i = 0; i < vm->funcs.size; i++) {
+    if (vm->funcs.data[i]->is_defined && strcmp(vm->funcs.data[i]->name, name) == 0) {
+      return vm->funcs.data[i];
+    }
+  }
+  return 0;
+}
+
+bool dcc_vm_main(vm_t *vm, int argc, char **argv, int *status) {
+  vm_func_t *func = find_func(vm, "main");
+  if (!func) {
+    return false;
+  }
+  uint64_t args[] = { argc, allocate(vm, (argc + 1) * 8, 8) };
+  for (int i = 0; i < argc && args[1]; i++) {
+    size_t len = strlen(argv[i]);
+    uint64_t address = allocate(vm, len + 1, 1);
+    if (!address) {
+      args[1] = 0;
+      break;
+    }
+    memcpy(vm->memory + address, argv[i], len);
+    memcpy(vm->memory + args[1] + 8 * i, &address, 8);
+  }
+  if (!args[1]) {
+    dcc_diag(vm->diags, DIAG_ERROR, func->locs.data[0], 1, "out of memory for arguments");
+    return false;
+  }
+  uint64_t result;
+  if (!run(vm, func, args, 2, &result)) {
+    return false;
+  }
+  *status = (int)result;
+  return true;
+}
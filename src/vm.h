@@ -0,0 +1,47 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+  A bytecode interpreter for checked translation units, which -interpret uses
+  to run programs without a native backend. Functions are compiled
+  straight from the AST into a compact register bytecode, which an
+  interpreter loop runs with threaded dispatch where the compiler has
+  computed gotos. Every object lives in the VM's own memory: pointers are
+  offsets into it, checked on each access, and functions have addresses of
+  their own beyond it, so evaluating code can trap but never crash dcc.
+  Floating values are kept as doubles, including long double.
+*/
+
+#pragma once
+
+#include "diag.h"
+#include "parse.h"
+
+typedef struct vm vm_t;
+
+// Run-time errors are reported to `diags` at the code that traps
+vm_t* dcc_vm_new(diag_vec_t *diags);
+void dcc_vm_free(vm_t *vm);
+
+// Compile the functions of a checked unit and lay out its objects, running
+// their initializers. Returns false if any of it cannot be compiled or an
+// initializer traps. The unit must outlive the VM.
+bool dcc_vm_load(vm_t *vm, external_decl_vec_t *unit);
+
+// Call main with `argv` copied into VM memory, setting *status to what it
+// returns
+bool dcc_vm_main(vm_t *vm, int argc, char **argv, int *status);
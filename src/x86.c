@@ -0,0 +1,1656 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "init.h"
+#include "regalloc.h"
+#include "x86.h"
+
+// A function or object with static storage
+typedef struct {
+  symbol_t *symbol; // as defined, if it is
+  const char *name;
+  initializer_t *init;
+  bool is_static; // internal linkage, or none for a block scope static
+  bool is_external; // a function with an external definition, if defined
+  bool is_defined;
+  uint32_t asm_symbol; // UINT32_MAX until referred to
+} global_t;
+typedef global_t* global_ptr_t;
+DECLARE_VEC(global_ptr_t, global_vec);
+DEFINE_VEC2(global_ptr_t, global_vec);
+
+typedef strlit_t* strlit_ptr_t;
+DECLARE_VEC(strlit_ptr_t, strlit_vec);
+DEFINE_VEC2(strlit_ptr_t, strlit_vec);
+
+typedef struct {
+  uint64_t offset;
+  uint32_t symbol;
+  int64_t addend;
+} data_reloc_t;
+DECLARE_VEC(data_reloc_t, data_reloc_vec);
+DEFINE_VEC2(data_reloc_t, data_reloc_vec);
+
+// A branch to a block with phis, which goes through a stub that moves their
+// operands
+typedef struct {
+  uint32_t label;
+  uint32_t from, to;
+} edge_t;
+DECLARE_VEC(edge_t, edge_vec);
+DEFINE_VEC2(edge_t, edge_vec);
+
+// The entries of a jump table are offsets of their labels from the table
+typedef struct {
+  uint32_t symbol;
+  uint32_t size;
+  uint32_t *labels;
+} jump_table_t;
+DECLARE_VEC(jump_table_t, jump_table_vec);
+DEFINE_VEC2(jump_table_t, jump_table_vec);
+
+typedef struct {
+  asm_t *as;
+  diag_vec_t *diags;
+  arena_t arena;
+  ptrmap_t globals; // symbol -> global_t
+  global_vec_t objects; // in order of declaration
+  ptrmap_t strings; // strlit_t -> asm symbol + 1
+  strlit_vec_t string_order;
+  uint32_t statics; // block scope statics named so far
+  jump_table_vec_t tables; // emitted with the strings
+
+  // the function being generated
+  ir_func_t *func;
+  uint8_t *regs; // of each value, or REGALLOC_SPILL
+  int32_t *homes; // frame offset of each spilled value
+  uint32_t saved; // mask of the callee-saved registers used
+  int32_t saves[16]; // where they are saved
+  int32_t *slots;
+  int32_t *areas; // of each aggregate parameter passed in registers
+  int32_t sret; // where the address of an aggregate return value is kept
+  int32_t scratch; // for aggregates moving through registers
+  // of a variadic function: where the argument registers are saved, and where
+  // va_start begins in them and on the stack
+  int32_t va_save, va_stack;
+  uint32_t va_gp, va_fp;
+  uint32_t frame;
+  uint32_t *labels; // of each block
+  edge_vec_t edges;
+} gen_t;
+
+static const asm_reg_t INT_ARGS[] = { ASM_RDI, ASM_RSI, ASM_RDX, ASM_RCX, ASM_R8, ASM_R9 };
+#define INT_ARG_COUNT 6
+#define SSE_ARG_COUNT 8
+
+// The registers values may live in: everything but the scratch registers rax,
+// rcx, rdx, rsi, rdi, r11, xmm0 and xmm1, with those that need no saving
+// first. There are no callee-saved xmm registers.
+#define BIT(r) (1u << (r))
+static const uint8_t INT_REGS[] = {
+  ASM_R10, ASM_R8, ASM_R9, ASM_RBX, ASM_R12, ASM_R13, ASM_R14, ASM_R15,
+};
+static const uint8_t FLOAT_REGS[] = {
+  ASM_XMM0 + 8, ASM_XMM0 + 9, ASM_XMM0 + 10, ASM_XMM0 + 11, ASM_XMM0 + 12,
+  ASM_XMM0 + 13, ASM_XMM0 + 14, ASM_XMM15, ASM_XMM0 + 2, ASM_XMM0 + 3,
+  ASM_XMM0 + 4, ASM_XMM0 + 5, ASM_XMM0 + 6, ASM_XMM0 + 7,
+};
+static const regalloc_target_t TARGET = {
+  { INT_REGS, sizeof(INT_REGS), BIT(ASM_RBX) | BIT(ASM_R12) | BIT(ASM_R13)
+    | BIT(ASM_R14) | BIT(ASM_R15), BIT(ASM_R8) | BIT(ASM_R9) },
+  { FLOAT_REGS, sizeof(FLOAT_REGS), 0, BIT(ASM_XMM0 + 2) | BIT(ASM_XMM0 + 3)
+    | BIT(ASM_XMM0 + 4) | BIT(ASM_XMM0 + 5) | BIT(ASM_XMM0 + 6) | BIT(ASM_XMM0 + 7) },
+};
+
+static const type_t* value_type(const exp_t *exp) {
+  return dcc_type_decay(exp->type)->unqual;
+}
+
+static uint64_t round_up(uint64_t n, uint64_t align) {
+  return (n + align - 1) / align * align;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Symbols
+////////////////////////////////////////////////////////////////////////////////
+
+static global_t* new_global(gen_t *gen, symbol_t *symbol, const char *name) {
+  global_t *global = dcc_arena_alloc(&gen->arena, sizeof(global_t));
+  global->symbol = symbol;
+  global->name = name;
+  global->asm_symbol = UINT32_MAX;
+  dcc_ptrmap_put(&gen->globals, symbol, global);
+  if (symbol->tag == SYM_OBJECT) {
+    global_vec_push(&gen->objects, global);
+  }
+  return global;
+}
+
+// The global a symbol with linkage refers to, which sema has already merged
+// across every declaration of its name
+static global_t* linked_global(gen_t *gen, symbol_t *symbol) {
+  global_t *global = dcc_ptrmap_get(&gen->globals, symbol);
+  return global ? global : new_global(gen, symbol, symbol->name->str);
+}
+
+static void declare(void *ctx, symbol_t *symbol, const decl_spec_t *specs,
+                    initializer_t *init, func_def_t *def, bool is_file_scope) {
+  gen_t *gen = ctx;
+  storage_spec_t storage = specs->storage;
+  global_t *global;
+  if (!is_file_scope && (storage & AST_STORAGE_STATIC)) {
+    // no linkage, so a name of its own
+    size_t len = symbol->name->len + 12;
+    char *name = dcc_arena_alloc(&gen->arena, len);
+    snprintf(name, len, "%s.%" PRIu32, symbol->name->str, ++gen->statics);
+    global = new_global(gen, symbol, name);
+  } else {
+    global = linked_global(gen, symbol);
+  }
+  if (storage & AST_STORAGE_STATIC) {
+    global->is_static = true;
+  }
+
+  if (symbol->tag == SYM_FUNCTION) {
+    // C99 inline definitions are only external if some declaration says so
+    if (specs->func_spec != AST_FUNC_SPEC_INLINE || (storage & AST_STORAGE_EXTERN)) {
+      global->is_external = true;
+    }
+    if (def) {
+      global->symbol = symbol;
+      global->is_defined = true;
+    }
+  } else if (init || !(storage & AST_STORAGE_EXTERN)) {
+    global->symbol = symbol;
+    global->is_defined = true;
+    global->init = init ? init : global->init;
+  }
+}
+
+static uint32_t global_symbol(gen_t *gen, symbol_t *symbol) {
+  global_t *global = dcc_ptrmap_get(&gen->globals, symbol);
+  if (!global) {
+    // an implicitly declared function
+    global = linked_global(gen, symbol);
+  }
+  if (global->asm_symbol == UINT32_MAX) {
+    enum asm_symbol_type type = !global->is_defined ? ASM_NOTYPE
+      : symbol->tag == SYM_FUNCTION ? ASM_FUNC : ASM_OBJECT;
+    bool is_global = !global->is_static
+      && (symbol->tag != SYM_FUNCTION || global->is_external || !global->is_defined);
+    global->asm_symbol = dcc_asm_symbol(gen->as, global->name, type, is_global);
+  }
+  return global->asm_symbol;
+}
+
+static bool is_defined(gen_t *gen, symbol_t *symbol) {
+  global_t *global = dcc_ptrmap_get(&gen->globals, symbol);
+  return global && global->is_defined;
+}
+
+static uint32_t string_symbol(gen_t *gen, strlit_t *string) {
+  uintptr_t symbol = (uintptr_t)dcc_ptrmap_get(&gen->strings, string);
+  if (!symbol) {
+    symbol = dcc_asm_temp(gen->as) + 1;
+    dcc_ptrmap_put(&gen->strings, string, (void*)symbol);
+    strlit_vec_push(&gen->string_order, string);
+  }
+  return symbol - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Instructions
+////////////////////////////////////////////////////////////////////////////////
+
+static uint8_t kind_size(ir_kind_t kind) {
+  switch (kind) {
+  case IR_I8: return 1;
+  case IR_I16: return 2;
+  case IR_I32:
+  case IR_F32: return 4;
+  default: return dcc_ir_is_vector(kind) ? 16 : 8;
+  }
+}
+
+static bool is_float_kind(ir_kind_t kind) {
+  return kind == IR_F32 || kind == IR_F64;
+}
+
+static ir_kind_t kind_of(gen_t *gen, ir_ref_t ref) {
+  return gen->func->instrs.data[ref].kind;
+}
+
+static void op(gen_t *gen, enum asm_op op, uint8_t size, asm_operand_t src,
+               asm_operand_t dst) {
+  dcc_asm_instr(gen->as, op, size, src, dst);
+}
+
+static asm_operand_t reg(asm_reg_t reg, uint8_t size) {
+  return dcc_asm_reg(reg, size);
+}
+
+static asm_operand_t xmm(int n) {
+  return dcc_asm_reg(ASM_XMM0 + n, 16);
+}
+
+static asm_operand_t frame(int32_t offset) {
+  return dcc_asm_mem(ASM_RBP, offset);
+}
+
+// Where a value lives, as an operand of `size` bytes if it is in a general
+// register
+static asm_operand_t home_as(gen_t *gen, ir_ref_t ref, uint8_t size) {
+  uint8_t r = gen->regs[ref];
+  if (r == REGALLOC_SPILL) {
+    return frame(gen->homes[ref]);
+  }
+  return r >= ASM_XMM0 ? xmm(r - ASM_XMM0) : reg(r, size);
+}
+
+static asm_operand_t home(gen_t *gen, ir_ref_t ref) {
+  return home_as(gen, ref, kind_size(kind_of(gen, ref)));
+}
+
+// The register a value lives in, or `scratch` if it was spilled
+static asm_reg_t home_reg(gen_t *gen, ir_ref_t ref, asm_reg_t scratch) {
+  return gen->regs[ref] == REGALLOC_SPILL ? scratch : gen->regs[ref];
+}
+
+// The memory a value of pointer type points to
+static asm_operand_t pointee(gen_t *gen, ir_ref_t ref, asm_reg_t scratch) {
+  asm_reg_t r = home_reg(gen, ref, scratch);
+  if (r == scratch) {
+    op(gen, ASM_MOV, 8, home(gen, ref), reg(r, 8));
+  }
+  return dcc_asm_mem(r, 0);
+}
+
+static asm_operand_t imm(int64_t value) {
+  return dcc_asm_imm(value);
+}
+
+static asm_operand_t target(uint32_t symbol) {
+  return dcc_asm_target(symbol, ASM_DIRECT);
+}
+
+static void move_imm(gen_t *gen, asm_reg_t r, uint64_t value) {
+  if ((int64_t)value == (int32_t)value) {
+    op(gen, ASM_MOV, 8, imm((int64_t)value), reg(r, 8));
+  } else {
+    op(gen, ASM_MOVABS, 8, imm((int64_t)value), reg(r, 8));
+  }
+}
+
+// Load a value into a general register, extended to `size` bytes
+static void extend(gen_t *gen, ir_ref_t ref, asm_reg_t r, uint8_t size, bool is_signed) {
+  uint8_t from = kind_size(kind_of(gen, ref));
+  enum asm_op o = ASM_MOV;
+  if (from == 1) {
+    o = is_signed ? ASM_MOVSB : ASM_MOVZB;
+  } else if (from == 2) {
+    o = is_signed ? ASM_MOVSW : ASM_MOVZW;
+  } else if (from == 4 && size == 8 && is_signed) {
+    o = ASM_MOVSL;
+  } else {
+    // a 32-bit move clears the upper half
+    size = from;
+  }
+  op(gen, o, size, home(gen, ref), reg(r, size));
+}
+
+// Load a value into a general register, extended to at least 32 bits
+static void load(gen_t *gen, ir_ref_t ref, asm_reg_t r, bool is_signed) {
+  uint8_t size = kind_size(kind_of(gen, ref));
+  extend(gen, ref, r, size < 4 ? 4 : size, is_signed);
+}
+
+static void store(gen_t *gen, ir_ref_t ref, asm_reg_t r) {
+  uint8_t size = kind_size(kind_of(gen, ref));
+  if (gen->regs[ref] != r) {
+    op(gen, ASM_MOV, size, reg(r, size), home(gen, ref));
+  }
+}
+
+// Floats move between registers whole, since movss and movsd only write the
+// low lane and so would wait on whatever last wrote the rest
+static enum asm_op float_move(enum asm_op o, asm_operand_t src, asm_operand_t dst) {
+  return src.tag == ASM_REG && dst.tag == ASM_REG ? ASM_MOVUPS : o;
+}
+
+static void load_float(gen_t *gen, ir_ref_t ref, int n) {
+  bool is_double = kind_of(gen, ref) == IR_F64;
+  asm_operand_t from = home(gen, ref);
+  op(gen, float_move(is_double ? ASM_MOVSD : ASM_MOVSS, from, xmm(n)), 0, from, xmm(n));
+}
+
+static void store_float(gen_t *gen, ir_ref_t ref, int n) {
+  bool is_double = kind_of(gen, ref) == IR_F64;
+  if (gen->regs[ref] != ASM_XMM0 + n) {
+    asm_operand_t to = home(gen, ref);
+    op(gen, float_move(is_double ? ASM_MOVSD : ASM_MOVSS, xmm(n), to), 0, xmm(n), to);
+  }
+}
+
+// Vectors move whole, unaligned, through xmm0 and xmm1
+static void load_vector(gen_t *gen, ir_ref_t ref, int n) {
+  op(gen, ASM_MOVUPS, 16, home(gen, ref), xmm(n));
+}
+
+static void store_vector(gen_t *gen, ir_ref_t ref, int n) {
+  if (gen->regs[ref] != ASM_XMM0 + n) {
+    op(gen, ASM_MOVUPS, 16, xmm(n), home(gen, ref));
+  }
+}
+
+static void constant(gen_t *gen, ir_ref_t ref, uint64_t bits) {
+  uint8_t size = kind_size(kind_of(gen, ref));
+  int64_t value = size == 1 ? (int8_t)bits : size == 2 ? (int16_t)bits
+    : size == 4 ? (int32_t)bits : (int64_t)bits;
+  if (is_float_kind(kind_of(gen, ref)) && gen->regs[ref] != REGALLOC_SPILL) {
+    // xmm registers take no immediates
+    move_imm(gen, ASM_RAX, bits);
+    op(gen, ASM_MOVQ, size, reg(ASM_RAX, size), home(gen, ref));
+  } else if (value == (int32_t)value) {
+    op(gen, ASM_MOV, size, imm(value), home(gen, ref));
+  } else {
+    op(gen, ASM_MOVABS, 8, imm(value), reg(ASM_RAX, 8));
+    store(gen, ref, ASM_RAX);
+  }
+}
+
+// The address of a global into a register
+static void global_address(gen_t *gen, symbol_t *symbol, asm_reg_t r) {
+  uint32_t sym = global_symbol(gen, symbol);
+  if (is_defined(gen, symbol)) {
+    op(gen, ASM_LEA, 8, dcc_asm_rip(sym, 0, ASM_DIRECT), reg(r, 8));
+  } else {
+    // it may live in a shared object
+    op(gen, ASM_MOV, 8, dcc_asm_rip(sym, 0, ASM_GOT), reg(r, 8));
+  }
+}
+
+// Copy `size` bytes from the address in rsi to the address in rdi
+static void copy(gen_t *gen, uint64_t size) {
+  move_imm(gen, ASM_RCX, size);
+  op(gen, ASM_REP_MOVSB, 0, ASM_NO_OPERAND, ASM_NO_OPERAND);
+}
+
+static asm_cond_t int_cond(enum ir_op o) {
+  switch (o) {
+  case IR_EQ: return ASM_CC_E;
+  case IR_NE: return ASM_CC_NE;
+  case IR_SLT: return ASM_CC_L;
+  case IR_SLE: return ASM_CC_LE;
+  case IR_SGT: return ASM_CC_G;
+  case IR_SGE: return ASM_CC_GE;
+  case IR_ULT: return ASM_CC_B;
+  case IR_ULE: return ASM_CC_BE;
+  case IR_UGT: return ASM_CC_A;
+  default: return ASM_CC_AE;
+  }
+}
+
+static void compare(gen_t *gen, ir_ref_t ref, ir_instr_t *instr) {
+  ir_ref_t a = instr->args[0], b = instr->args[1];
+  ir_kind_t kind = kind_of(gen, a);
+  asm_operand_t al = reg(ASM_RAX, 1);
+  if (is_float_kind(kind)) {
+    load_float(gen, a, 0);
+    load_float(gen, b, 1);
+    // ucomis sets CF and ZF as an unsigned compare, and PF too if unordered;
+    // less-than is greater-than with the operands swapped
+    bool swap = instr->op == IR_FLT || instr->op == IR_FLE;
+    op(gen, ASM_UCOMIS, kind_size(kind), xmm(swap ? 0 : 1), xmm(swap ? 1 : 0));
+    switch (instr->op) {
+    case IR_FEQ:
+    case IR_FNE: {
+      bool eq = instr->op == IR_FEQ;
+      dcc_asm_cond(gen->as, ASM_SETCC, eq ? ASM_CC_E : ASM_CC_NE, al);
+      dcc_asm_cond(gen->as, ASM_SETCC, eq ? ASM_CC_NP : ASM_CC_P, reg(ASM_RCX, 1));
+      op(gen, eq ? ASM_AND : ASM_OR, 1, reg(ASM_RCX, 1), al);
+      break;
+    }
+    case IR_FLT:
+    case IR_FGT:
+      dcc_asm_cond(gen->as, ASM_SETCC, ASM_CC_A, al);
+      break;
+    default:
+      dcc_asm_cond(gen->as, ASM_SETCC, ASM_CC_AE, al);
+      break;
+    }
+  } else {
+    bool is_signed = instr->op >= IR_SLT && instr->op <= IR_SGE;
+    uint8_t size = kind_size(kind) == 8 ? 8 : 4;
+    load(gen, a, ASM_RAX, is_signed);
+    load(gen, b, ASM_RCX, is_signed);
+    op(gen, ASM_CMP, size, reg(ASM_RCX, size), reg(ASM_RAX, size));
+    dcc_asm_cond(gen->as, ASM_SETCC, int_cond(instr->op), al);
+  }
+  op(gen, ASM_MOVZB, 4, al, reg(ASM_RAX, 4));
+  store(gen, ref, ASM_RAX);
+}
+
+// Conversions between integers and floating types the hardware lacks
+static void unsigned_to_float(gen_t *gen, ir_ref_t ref, ir_ref_t value) {
+  bool is_double = kind_of(gen, ref) == IR_F64;
+  enum asm_op cvt = is_double ? ASM_CVTSI2SD : ASM_CVTSI2SS;
+  uint32_t halve = dcc_asm_temp(gen->as), done = dcc_asm_temp(gen->as);
+  extend(gen, value, ASM_RAX, 8, false);
+  op(gen, ASM_TEST, 8, reg(ASM_RAX, 8), reg(ASM_RAX, 8));
+  dcc_asm_cond(gen->as, ASM_JCC, ASM_CC_S, target(halve));
+  op(gen, cvt, 8, reg(ASM_RAX, 8), xmm(0));
+  op(gen, ASM_JMP, 0, ASM_NO_OPERAND, target(done));
+  // too big for a signed conversion: halve it, keeping the low bit for
+  // rounding, and double the result
+  dcc_asm_label(gen->as, halve);
+  op(gen, ASM_MOV, 8, reg(ASM_RAX, 8), reg(ASM_RCX, 8));
+  op(gen, ASM_SHR, 8, imm(1), reg(ASM_RCX, 8));
+  op(gen, ASM_AND, 4, imm(1), reg(ASM_RAX, 4));
+  op(gen, ASM_OR, 8, reg(ASM_RAX, 8), reg(ASM_RCX, 8));
+  op(gen, cvt, 8, reg(ASM_RCX, 8), xmm(0));
+  op(gen, ASM_ADDS, is_double ? 8 : 4, xmm(0), xmm(0));
+  dcc_asm_label(gen->as, done);
+  store_float(gen, ref, 0);
+}
+
+static void float_to_unsigned(gen_t *gen, ir_ref_t ref, ir_ref_t value) {
+  bool is_double = kind_of(gen, value) == IR_F64;
+  enum asm_op cvt = is_double ? ASM_CVTTSD2SI : ASM_CVTTSS2SI;
+  uint8_t size = is_double ? 8 : 4;
+  uint32_t big = dcc_asm_temp(gen->as), done = dcc_asm_temp(gen->as);
+  load_float(gen, value, 0);
+  // 2^63 as a double or a float
+  move_imm(gen, ASM_RAX, is_double ? 0x43e0000000000000 : 0x5f000000);
+  op(gen, ASM_MOVQ, size, reg(ASM_RAX, size), xmm(1));
+  op(gen, ASM_UCOMIS, size, xmm(1), xmm(0));
+  dcc_asm_cond(gen->as, ASM_JCC, ASM_CC_AE, target(big));
+  op(gen, cvt, 8, xmm(0), reg(ASM_RAX, 8));
+  op(gen, ASM_JMP, 0, ASM_NO_OPERAND, target(done));
+  dcc_asm_label(gen->as, big);
+  op(gen, ASM_SUBS, size, xmm(1), xmm(0));
+  op(gen, cvt, 8, xmm(0), reg(ASM_RAX, 8));
+  op(gen, ASM_BTC, 8, imm(63), reg(ASM_RAX, 8));
+  dcc_asm_label(gen->as, done);
+  store(gen, ref, ASM_RAX);
+}
+
+static void convert(gen_t *gen, ir_ref_t ref, ir_instr_t *instr) {
+  ir_ref_t value = instr->args[0];
+  ir_kind_t from = kind_of(gen, value), to = instr->kind;
+  uint8_t size = kind_size(to), from_size = kind_size(from);
+  switch (instr->op) {
+  case IR_SEXT:
+  case IR_ZEXT:
+    extend(gen, value, ASM_RAX, size < 4 ? 4 : size, instr->op == IR_SEXT);
+    store(gen, ref, ASM_RAX);
+    break;
+  case IR_TRUNC:
+    // the low bytes come first
+    load(gen, value, ASM_RAX, false);
+    store(gen, ref, ASM_RAX);
+    break;
+  case IR_SITOF:
+    extend(gen, value, ASM_RAX, from_size, true);
+    op(gen, to == IR_F64 ? ASM_CVTSI2SD : ASM_CVTSI2SS, from_size,
+       reg(ASM_RAX, from_size), xmm(0));
+    store_float(gen, ref, 0);
+    break;
+  case IR_UITOF:
+    unsigned_to_float(gen, ref, value);
+    break;
+  case IR_FTOSI:
+    load_float(gen, value, 0);
+    op(gen, from == IR_F64 ? ASM_CVTTSD2SI : ASM_CVTTSS2SI, size, xmm(0),
+       reg(ASM_RAX, size));
+    store(gen, ref, ASM_RAX);
+    break;
+  case IR_FTOUI:
+    float_to_unsigned(gen, ref, value);
+    break;
+  default:
+    load_float(gen, value, 0);
+    op(gen, to == IR_F64 ? ASM_CVTSS2SD : ASM_CVTSD2SS, 0, xmm(0), xmm(0));
+    store_float(gen, ref, 0);
+    break;
+  }
+}
+
+// The product of the 32-bit lanes of xmm0 and xmm1 into xmm0, which SSE2 only
+// has for the even lanes, through the scratch area
+static void multiply_lanes(gen_t *gen, ir_instr_t *instr) {
+  asm_operand_t scratch = frame(gen->scratch);
+  op(gen, ASM_PMULUDQ, 16, xmm(1), xmm(0));
+  op(gen, ASM_PSHUFD, 16, imm(0x08), xmm(0));
+  op(gen, ASM_MOVUPS, 16, xmm(0), scratch);
+  load_vector(gen, instr->args[0], 0);
+  load_vector(gen, instr->args[1], 1);
+  op(gen, ASM_PSHUFD, 16, imm(0xf5), xmm(0));
+  op(gen, ASM_PSHUFD, 16, imm(0xf5), xmm(1));
+  op(gen, ASM_PMULUDQ, 16, xmm(1), xmm(0));
+  op(gen, ASM_PSHUFD, 16, imm(0x08), xmm(0));
+  op(gen, ASM_MOVUPS, 16, scratch, xmm(1));
+  op(gen, ASM_PUNPCKL, 4, xmm(0), xmm(1));
+  op(gen, ASM_MOVUPS, 16, xmm(1), xmm(0));
+}
+
+static void vector_arith(gen_t *gen, ir_ref_t ref, ir_instr_t *instr) {
+  ir_kind_t lane = dcc_ir_lane(instr->kind);
+  uint8_t size = kind_size(lane);
+  enum ir_op o = instr->op;
+  load_vector(gen, instr->args[0], 0);
+  if (o == IR_SHL || o == IR_SAR || o == IR_SHR) {
+    const ir_instr_t *count = &gen->func->instrs.data[instr->args[1]];
+    dcc_assert(count->op == IR_SPLAT);
+    int64_t bits = gen->func->instrs.data[count->args[0]].imm;
+    enum asm_op shift = o == IR_SHL ? ASM_PSLL : o == IR_SAR ? ASM_PSRA : ASM_PSRL;
+    op(gen, shift, size, imm(bits), xmm(0));
+    store_vector(gen, ref, 0);
+    return;
+  }
+  load_vector(gen, instr->args[1], 1);
+  switch (o) {
+  case IR_ADD: op(gen, ASM_PADD, size, xmm(1), xmm(0)); break;
+  case IR_SUB: op(gen, ASM_PSUB, size, xmm(1), xmm(0)); break;
+  case IR_MUL:
+    if (size == 2) {
+      op(gen, ASM_PMULLW, 16, xmm(1), xmm(0));
+    } else {
+      multiply_lanes(gen, instr);
+    }
+    break;
+  case IR_AND: op(gen, ASM_PAND, 16, xmm(1), xmm(0)); break;
+  case IR_OR: op(gen, ASM_POR, 16, xmm(1), xmm(0)); break;
+  case IR_XOR: op(gen, ASM_PXOR, 16, xmm(1), xmm(0)); break;
+  case IR_FADD: op(gen, ASM_ADDP, size, xmm(1), xmm(0)); break;
+  case IR_FSUB: op(gen, ASM_SUBP, size, xmm(1), xmm(0)); break;
+  case IR_FMUL: op(gen, ASM_MULP, size, xmm(1), xmm(0)); break;
+  case IR_FDIV: op(gen, ASM_DIVP, size, xmm(1), xmm(0)); break;
+  default:
+    dcc_ice("cannot generate vector %s", dcc_ir_op_str(o));
+  }
+  store_vector(gen, ref, 0);
+}
+
+// A scalar in every lane: into the low lane of xmm0, then doubled up until it
+// fills the register
+static void splat(gen_t *gen, ir_ref_t ref, ir_instr_t *instr) {
+  ir_ref_t value = instr->args[0];
+  ir_kind_t lane = kind_of(gen, value);
+  uint8_t size = kind_size(lane);
+  if (is_float_kind(lane)) {
+    load_float(gen, value, 0);
+  } else {
+    load(gen, value, ASM_RAX, false);
+    op(gen, ASM_MOVQ, size == 8 ? 8 : 4, reg(ASM_RAX, size == 8 ? 8 : 4), xmm(0));
+  }
+  if (size == 8) {
+    op(gen, ASM_PUNPCKL, 8, xmm(0), xmm(0));
+  } else {
+    for (uint8_t width = size; width < 4; width *= 2) {
+      op(gen, ASM_PUNPCKL, width, xmm(0), xmm(0));
+    }
+    op(gen, ASM_PSHUFD, 16, imm(0), xmm(0));
+  }
+  store_vector(gen, ref, 0);
+}
+
+static void arith(gen_t *gen, ir_ref_t ref, ir_instr_t *instr) {
+  ir_kind_t kind = instr->kind;
+  if (dcc_ir_is_vector(kind)) {
+    vector_arith(gen, ref, instr);
+    return;
+  }
+  uint8_t size = kind_size(kind) == 8 ? 8 : 4;
+  asm_operand_t rax = reg(ASM_RAX, size), rcx = reg(ASM_RCX, size);
+  enum ir_op o = instr->op;
+  if (o >= IR_FADD && o <= IR_FDIV) {
+    static const enum asm_op OPS[] = { ASM_ADDS, ASM_SUBS, ASM_MULS, ASM_DIVS };
+    load_float(gen, instr->args[0], 0);
+    load_float(gen, instr->args[1], 1);
+    op(gen, OPS[o - IR_FADD], kind_size(kind), xmm(1), xmm(0));
+    store_float(gen, ref, 0);
+    return;
+  } else if (o == IR_FNEG) {
+    // flip the sign bit
+    size = kind_size(kind);
+    load_float(gen, instr->args[0], 0);
+    op(gen, ASM_MOVQ, size, xmm(0), reg(ASM_RAX, size));
+    if (size == 8) {
+      op(gen, ASM_BTC, 8, imm(63), reg(ASM_RAX, 8));
+    } else {
+      op(gen, ASM_XOR, 4, imm(INT32_MIN), reg(ASM_RAX, 4));
+    }
+    op(gen, ASM_MOVQ, size, reg(ASM_RAX, size), xmm(0));
+    store_float(gen, ref, 0);
+    return;
+  }
+
+  bool is_signed = o == IR_SDIV || o == IR_SREM || o == IR_SAR;
+  load(gen, instr->args[0], ASM_RAX, is_signed);
+  if (instr->count > 1) {
+    load(gen, instr->args[1], ASM_RCX, is_signed);
+  }
+  switch (o) {
+  case IR_ADD: op(gen, ASM_ADD, size, rcx, rax); break;
+  case IR_SUB: op(gen, ASM_SUB, size, rcx, rax); break;
+  case IR_MUL: op(gen, ASM_IMUL, size, rcx, rax); break;
+  case IR_AND: op(gen, ASM_AND, size, rcx, rax); break;
+  case IR_OR: op(gen, ASM_OR, size, rcx, rax); break;
+  case IR_XOR: op(gen, ASM_XOR, size, rcx, rax); break;
+  case IR_SHL: op(gen, ASM_SHL, size, reg(ASM_RCX, 1), rax); break;
+  case IR_SAR: op(gen, ASM_SAR, size, reg(ASM_RCX, 1), rax); break;
+  case IR_SHR: op(gen, ASM_SHR, size, reg(ASM_RCX, 1), rax); break;
+  case IR_NEG: op(gen, ASM_NEG, size, ASM_NO_OPERAND, rax); break;
+  case IR_NOT: op(gen, ASM_NOT, size, ASM_NO_OPERAND, rax); break;
+  default:
+    if (is_signed) {
+      op(gen, ASM_CQO, size, ASM_NO_OPERAND, ASM_NO_OPERAND);
+    } else {
+      op(gen, ASM_XOR, 4, reg(ASM_RDX, 4), reg(ASM_RDX, 4));
+    }
+    op(gen, is_signed ? ASM_IDIV : ASM_DIV, size, ASM_NO_OPERAND, rcx);
+    if (o == IR_SREM || o == IR_UREM) {
+      op(gen, ASM_MOV, size, reg(ASM_RDX, size), rax);
+    }
+    break;
+  }
+  store(gen, ref, ASM_RAX);
+}
+
+static void call(gen_t *gen, ir_ref_t ref) {
+  ir_instr_t *instr = &gen->func->instrs.data[ref];
+  const ir_call_t *info = instr->call;
+  const type_t *ret = info->func->func.ret->unqual;
+  bool sret = dcc_type_is_record(ret);
+  abi_class_t ret_classes[2];
+  int ret_count = sret ? dcc_type_classify(ret, ret_classes) : 0;
+  uint32_t first = 1 + sret, count = instr->count - first;
+
+  // where each argument goes: registers for each eightbyte, or the stack
+  typedef struct {
+    int8_t regs[2];
+    int64_t offset; // on the stack, if not in registers
+    int32_t scratch;
+  } place_t;
+  place_t *places = dcc_malloc((count + 1) * sizeof(place_t));
+  int ints = sret && !ret_count, sses = 0, aggregates = 0;
+  uint64_t stack = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    const type_t *type = info->args[i]->unqual;
+    place_t *place = &places[i];
+    place->regs[0] = place->regs[1] = -1;
+    place->offset = -1;
+    if (dcc_type_is_record(type)) {
+      abi_class_t classes[2];
+      int n = dcc_type_classify(type, classes);
+      int need_int = dcc_type_count_class(classes, n, CLASS_INTEGER);
+      int need_sse = dcc_type_count_class(classes, n, CLASS_SSE);
+      if (n && ints + need_int <= INT_ARG_COUNT && sses + need_sse <= SSE_ARG_COUNT) {
+        for (int j = 0; j < n; j++) {
+          place->regs[j] = classes[j] == CLASS_INTEGER ? INT_ARGS[ints++]
+            : ASM_XMM0 + sses++;
+        }
+        place->scratch = gen->scratch + 16 * aggregates++;
+      } else {
+        place->offset = stack;
+        stack += round_up(dcc_type_size(type), 8);
+      }
+    } else if (dcc_type_is_float(type)) {
+      if (sses < SSE_ARG_COUNT) {
+        place->regs[0] = ASM_XMM0 + sses++;
+      } else {
+        place->offset = stack;
+        stack += 8;
+      }
+    } else if (ints < INT_ARG_COUNT) {
+      place->regs[0] = INT_ARGS[ints++];
+    } else {
+      place->offset = stack;
+      stack += 8;
+    }
+  }
+  stack = round_up(stack, 16);
+  if (stack) {
+    op(gen, ASM_SUB, 8, imm(stack), reg(ASM_RSP, 8));
+  }
+
+  // copying aggregates uses argument registers, so they are filled last
+  for (uint32_t i = 0; i < count; i++) {
+    const type_t *type = info->args[i]->unqual;
+    ir_ref_t arg = instr->args[first + i];
+    place_t *place = &places[i];
+    if (!dcc_type_is_record(type) && place->offset >= 0 && dcc_type_is_float(type)) {
+      load_float(gen, arg, 0);
+      op(gen, kind_of(gen, arg) == IR_F64 ? ASM_MOVSD : ASM_MOVSS, 0, xmm(0),
+         dcc_asm_mem(ASM_RSP, place->offset));
+    } else if (!dcc_type_is_record(type) && place->offset >= 0) {
+      extend(gen, arg, ASM_RAX, 8, dcc_type_is_signed(type));
+      op(gen, ASM_MOV, 8, reg(ASM_RAX, 8), dcc_asm_mem(ASM_RSP, place->offset));
+    } else if (dcc_type_is_record(type)) {
+      op(gen, ASM_MOV, 8, home(gen, arg), reg(ASM_RSI, 8));
+      op(gen, ASM_LEA, 8, place->offset >= 0 ? dcc_asm_mem(ASM_RSP, place->offset)
+         : frame(place->scratch), reg(ASM_RDI, 8));
+      copy(gen, dcc_type_size(type));
+    }
+  }
+  if (sret && !ret_count) {
+    op(gen, ASM_MOV, 8, home(gen, instr->args[1]), reg(ASM_RDI, 8));
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    const type_t *type = info->args[i]->unqual;
+    ir_ref_t arg = instr->args[first + i];
+    place_t *place = &places[i];
+    for (int j = 0; j < 2 && place->regs[j] >= 0; j++) {
+      asm_reg_t r = place->regs[j];
+      if (dcc_type_is_record(type)) {
+        asm_operand_t eightbyte = frame(place->scratch + 8 * j);
+        op(gen, r >= ASM_XMM0 ? ASM_MOVSD : ASM_MOV, 8, eightbyte,
+           r >= ASM_XMM0 ? xmm(r - ASM_XMM0) : reg(r, 8));
+      } else if (r >= ASM_XMM0) {
+        load_float(gen, arg, r - ASM_XMM0);
+      } else {
+        // narrow arguments are extended, as compilers expect
+        uint8_t size = kind_size(kind_of(gen, arg));
+        extend(gen, arg, r, size < 4 ? 4 : size, dcc_type_is_signed(type));
+      }
+    }
+  }
+
+  // variadic callees are told how many vector registers hold arguments
+  ir_instr_t *callee = &gen->func->instrs.data[instr->args[0]];
+  if (callee->op == IR_GLOBAL && callee->symbol->tag == SYM_FUNCTION) {
+    bool defined = is_defined(gen, callee->symbol);
+    op(gen, ASM_MOV, 4, imm(sses), reg(ASM_RAX, 4));
+    op(gen, ASM_CALL, 0, ASM_NO_OPERAND,
+       dcc_asm_target(global_symbol(gen, callee->symbol), defined ? ASM_DIRECT : ASM_PLT));
+  } else {
+    op(gen, ASM_MOV, 8, home(gen, instr->args[0]), reg(ASM_R11, 8));
+    op(gen, ASM_MOV, 4, imm(sses), reg(ASM_RAX, 4));
+    op(gen, ASM_CALL, 0, ASM_NO_OPERAND, reg(ASM_R11, 8));
+  }
+  if (stack) {
+    op(gen, ASM_ADD, 8, imm(stack), reg(ASM_RSP, 8));
+  }
+  free(places);
+
+  if (ret_count) {
+    // eightbytes come back in rax and rdx, or xmm0 and xmm1
+    int ints = 0, sses = 0;
+    for (int j = 0; j < ret_count; j++) {
+      asm_operand_t eightbyte = frame(gen->scratch + 8 * j);
+      if (ret_classes[j] == CLASS_INTEGER) {
+        op(gen, ASM_MOV, 8, reg(ints++ ? ASM_RDX : ASM_RAX, 8), eightbyte);
+      } else {
+        op(gen, ASM_MOVSD, 8, xmm(sses++), eightbyte);
+      }
+    }
+    op(gen, ASM_LEA, 8, frame(gen->scratch), reg(ASM_RSI, 8));
+    op(gen, ASM_MOV, 8, home(gen, instr->args[1]), reg(ASM_RDI, 8));
+    copy(gen, dcc_type_size(ret));
+  } else if (is_float_kind(instr->kind)) {
+    store_float(gen, ref, 0);
+  } else if (instr->kind != IR_VOID) {
+    store(gen, ref, ASM_RAX);
+  }
+}
+
+static void instr(gen_t *gen, ir_ref_t ref) {
+  ir_instr_t *instr = &gen->func->instrs.data[ref];
+  switch ((enum ir_op)instr->op) {
+  case IR_NOP:
+  case IR_UNDEF:
+  case IR_PARAM:
+  case IR_PHI:
+    break;
+  case IR_CONST:
+    constant(gen, ref, instr->imm);
+    break;
+  case IR_FCONST: {
+    uint64_t bits;
+    if (instr->kind == IR_F32) {
+      float f = instr->fimm;
+      uint32_t bits32;
+      memcpy(&bits32, &f, 4);
+      bits = bits32;
+    } else {
+      memcpy(&bits, &instr->fimm, 8);
+    }
+    constant(gen, ref, bits);
+    break;
+  }
+  case IR_GLOBAL: {
+    asm_reg_t r = home_reg(gen, ref, ASM_RAX);
+    global_address(gen, instr->symbol, r);
+    store(gen, ref, r);
+    break;
+  }
+  case IR_STRING: {
+    asm_reg_t r = home_reg(gen, ref, ASM_RAX);
+    op(gen, ASM_LEA, 8, dcc_asm_rip(string_symbol(gen, instr->string), 0, ASM_DIRECT),
+       reg(r, 8));
+    store(gen, ref, r);
+    break;
+  }
+  case IR_SLOT: {
+    asm_reg_t r = home_reg(gen, ref, ASM_RAX);
+    op(gen, ASM_LEA, 8, frame(gen->slots[instr->imm]), reg(r, 8));
+    store(gen, ref, r);
+    break;
+  }
+  case IR_VARARGS:
+    if (instr->imm == IR_VA_GP || instr->imm == IR_VA_FP) {
+      constant(gen, ref, instr->imm == IR_VA_GP ? gen->va_gp : gen->va_fp);
+    } else {
+      asm_reg_t r = home_reg(gen, ref, ASM_RAX);
+      int32_t at = instr->imm == IR_VA_STACK ? gen->va_stack : gen->va_save;
+      op(gen, ASM_LEA, 8, frame(at), reg(r, 8));
+      store(gen, ref, r);
+    }
+    break;
+  case IR_ADD: case IR_SUB: case IR_MUL: case IR_SDIV: case IR_UDIV: case IR_SREM:
+  case IR_UREM: case IR_AND: case IR_OR: case IR_XOR: case IR_SHL: case IR_SAR:
+  case IR_SHR: case IR_NEG: case IR_NOT: case IR_FADD: case IR_FSUB: case IR_FMUL:
+  case IR_FDIV: case IR_FNEG:
+    arith(gen, ref, instr);
+    break;
+  case IR_EQ: case IR_NE: case IR_SLT: case IR_SLE: case IR_SGT: case IR_SGE:
+  case IR_ULT: case IR_ULE: case IR_UGT: case IR_UGE: case IR_FEQ: case IR_FNE:
+  case IR_FLT: case IR_FLE: case IR_FGT: case IR_FGE:
+    compare(gen, ref, instr);
+    break;
+  case IR_SEXT: case IR_ZEXT: case IR_TRUNC: case IR_SITOF: case IR_UITOF:
+  case IR_FTOSI: case IR_FTOUI: case IR_FCONV:
+    convert(gen, ref, instr);
+    break;
+  case IR_SPLAT:
+    splat(gen, ref, instr);
+    break;
+  case IR_LOAD: {
+    uint8_t size = kind_size(instr->kind);
+    asm_operand_t from = pointee(gen, instr->args[0], ASM_RAX);
+    if (dcc_ir_is_vector(instr->kind)) {
+      op(gen, ASM_MOVUPS, 16, from, xmm(0));
+      store_vector(gen, ref, 0);
+    } else if (is_float_kind(instr->kind)) {
+      op(gen, instr->kind == IR_F64 ? ASM_MOVSD : ASM_MOVSS, 0, from, xmm(0));
+      store_float(gen, ref, 0);
+    } else {
+      asm_reg_t r = home_reg(gen, ref, ASM_RCX);
+      op(gen, ASM_MOV, size, from, reg(r, size));
+      store(gen, ref, r);
+    }
+    break;
+  }
+  case IR_STORE: {
+    ir_ref_t value = instr->args[1];
+    ir_kind_t kind = kind_of(gen, value);
+    uint8_t size = kind_size(kind);
+    asm_operand_t to = pointee(gen, instr->args[0], ASM_RAX), from = home(gen, value);
+    if (dcc_ir_is_vector(kind)) {
+      if (from.tag == ASM_MEM) {
+        op(gen, ASM_MOVUPS, 16, from, xmm(0));
+        from = xmm(0);
+      }
+      op(gen, ASM_MOVUPS, 16, from, to);
+    } else if (is_float_kind(kind)) {
+      enum asm_op o = kind == IR_F64 ? ASM_MOVSD : ASM_MOVSS;
+      if (from.tag == ASM_MEM) {
+        op(gen, o, 0, from, xmm(0));
+        from = xmm(0);
+      }
+      op(gen, o, 0, from, to);
+    } else {
+      if (from.tag == ASM_MEM) {
+        op(gen, ASM_MOV, size, from, reg(ASM_RCX, size));
+        from = reg(ASM_RCX, size);
+      }
+      op(gen, ASM_MOV, size, from, to);
+    }
+    break;
+  }
+  case IR_MEMCPY:
+    op(gen, ASM_MOV, 8, home(gen, instr->args[0]), reg(ASM_RDI, 8));
+    op(gen, ASM_MOV, 8, home(gen, instr->args[1]), reg(ASM_RSI, 8));
+    copy(gen, instr->imm);
+    break;
+  case IR_MEMZERO:
+    op(gen, ASM_MOV, 8, home(gen, instr->args[0]), reg(ASM_RDI, 8));
+    op(gen, ASM_XOR, 4, reg(ASM_RAX, 4), reg(ASM_RAX, 4));
+    move_imm(gen, ASM_RCX, instr->imm);
+    op(gen, ASM_REP_STOSB, 0, ASM_NO_OPERAND, ASM_NO_OPERAND);
+    break;
+  case IR_CALL:
+    call(gen, ref);
+    break;
+  default:
+    dcc_ice("cannot generate %s", dcc_ir_op_str(instr->op));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Functions
+////////////////////////////////////////////////////////////////////////////////
+
+static int32_t allocate(gen_t *gen, uint64_t size, uint32_t align) {
+  gen->frame = round_up(gen->frame + (size ? size : 1), align ? align : 1);
+  return -(int32_t)gen->frame;
+}
+
+// Give every value a register or a place in the frame, and every slot,
+// parameter area and saved register a place too
+static void layout(gen_t *gen) {
+  ir_func_t *func = gen->func;
+  size_t count = func->instrs.size;
+  gen->frame = 0;
+  gen->regs = dcc_regalloc(func, &TARGET);
+  gen->homes = dcc_malloc((count + 1) * sizeof(int32_t));
+  gen->slots = dcc_malloc((func->slots.size + 1) * sizeof(int32_t));
+  gen->areas = dcc_malloc((func->param_count + 1) * sizeof(int32_t));
+
+  uint32_t aggregates = 0;
+  gen->saved = 0;
+  for (ir_ref_t ref = 0; ref < count; ref++) {
+    ir_instr_t *instr = &func->instrs.data[ref];
+    if (dcc_ir_is_vector(instr->kind) && gen->regs[ref] == REGALLOC_SPILL) {
+      gen->homes[ref] = allocate(gen, 16, 16);
+    } else if (instr->kind != IR_VOID && gen->regs[ref] == REGALLOC_SPILL) {
+      gen->homes[ref] = allocate(gen, 8, 8);
+    } else if (instr->kind != IR_VOID) {
+      gen->saved |= BIT(gen->regs[ref]) & TARGET.ints.callee_saved;
+    }
+    if (instr->op == IR_CALL) {
+      const type_t *func_type = instr->call->func;
+      uint32_t first = 1 + dcc_type_is_record(func_type->func.ret->unqual), n = 0;
+      for (uint32_t i = 0; i < instr->count - first; i++) {
+        n += dcc_type_is_record(instr->call->args[i]->unqual);
+      }
+      aggregates = n > aggregates ? n : aggregates;
+    }
+  }
+  for (size_t i = 0; i < func->slots.size; i++) {
+    gen->slots[i] = allocate(gen, func->slots.data[i].size, func->slots.data[i].align);
+  }
+  for (uint32_t i = 0; i < func->param_count; i++) {
+    gen->areas[i] = dcc_type_is_record(func->params[i]->unqual) ? allocate(gen, 16, 8) : 0;
+  }
+  for (int r = 0; r < 16; r++) {
+    if (gen->saved & BIT(r)) {
+      gen->saves[r] = allocate(gen, 8, 8);
+    }
+  }
+  gen->sret = allocate(gen, 8, 8);
+  if (func->symbol->type->func.is_vararg) {
+    gen->va_save = allocate(gen, 8 * INT_ARG_COUNT + 16 * SSE_ARG_COUNT, 16);
+  }
+  gen->scratch = allocate(gen, 16 * (aggregates + 1), 16);
+  gen->frame = round_up(gen->frame, 16);
+}
+
+// Store the incoming arguments to the homes of their IR_PARAMs
+static void prologue(gen_t *gen) {
+  ir_func_t *func = gen->func;
+  const type_t *ret = func->symbol->type->func.ret->unqual;
+  abi_class_t classes[2];
+  int ints = 0, sses = 0;
+  int64_t stack = 16;
+  bool is_vararg = func->symbol->type->func.is_vararg;
+  for (int i = 0; is_vararg && i < INT_ARG_COUNT; i++) {
+    op(gen, ASM_MOV, 8, reg(INT_ARGS[i], 8), frame(gen->va_save + 8 * i));
+  }
+  for (int i = 0; is_vararg && i < SSE_ARG_COUNT; i++) {
+    op(gen, ASM_MOVSD, 8, xmm(i), frame(gen->va_save + 8 * INT_ARG_COUNT + 16 * i));
+  }
+  if (dcc_type_is_record(ret) && !dcc_type_classify(ret, classes)) {
+    op(gen, ASM_MOV, 8, reg(ASM_RDI, 8), frame(gen->sret));
+    ints++;
+  }
+
+  ir_ref_t *params = dcc_malloc((func->param_count + 1) * sizeof(ir_ref_t));
+  for (uint32_t i = 0; i < func->param_count; i++) {
+    params[i] = IR_NONE;
+  }
+  for (ir_ref_t ref = 0; ref < func->instrs.size; ref++) {
+    ir_instr_t *instr = &func->instrs.data[ref];
+    if (instr->op == IR_PARAM) {
+      params[instr->imm] = ref;
+    }
+  }
+
+  for (uint32_t i = 0; i < func->param_count; i++) {
+    const type_t *type = func->params[i]->unqual;
+    ir_ref_t ref = params[i];
+    if (dcc_type_is_record(type)) {
+      int n = dcc_type_classify(type, classes);
+      int need_int = dcc_type_count_class(classes, n, CLASS_INTEGER);
+      int need_sse = dcc_type_count_class(classes, n, CLASS_SSE);
+      if (n && ints + need_int <= INT_ARG_COUNT && sses + need_sse <= SSE_ARG_COUNT) {
+        for (int j = 0; j < n; j++) {
+          asm_operand_t eightbyte = frame(gen->areas[i] + 8 * j);
+          if (classes[j] == CLASS_INTEGER) {
+            op(gen, ASM_MOV, 8, reg(INT_ARGS[ints++], 8), eightbyte);
+          } else {
+            op(gen, ASM_MOVSD, 8, xmm(sses++), eightbyte);
+          }
+        }
+        op(gen, ASM_LEA, 8, frame(gen->areas[i]), reg(ASM_RAX, 8));
+      } else {
+        op(gen, ASM_LEA, 8, frame(stack), reg(ASM_RAX, 8));
+        stack += round_up(dcc_type_size(type), 8);
+      }
+      if (ref != IR_NONE) {
+        store(gen, ref, ASM_RAX);
+      }
+      continue;
+    }
+
+    bool in_sse = dcc_type_is_float(type) && sses < SSE_ARG_COUNT;
+    bool in_int = !dcc_type_is_float(type) && ints < INT_ARG_COUNT;
+    if (ref == IR_NONE) {
+      sses += in_sse;
+      ints += in_int;
+      stack += in_sse || in_int ? 0 : 8;
+    } else if (in_sse) {
+      store_float(gen, ref, sses++);
+    } else if (in_int) {
+      store(gen, ref, INT_ARGS[ints++]);
+    } else if (dcc_type_is_float(type)) {
+      op(gen, kind_of(gen, ref) == IR_F64 ? ASM_MOVSD : ASM_MOVSS, 0, frame(stack), xmm(0));
+      store_float(gen, ref, 0);
+      stack += 8;
+    } else {
+      op(gen, ASM_MOV, 8, frame(stack), reg(ASM_RAX, 8));
+      store(gen, ref, ASM_RAX);
+      stack += 8;
+    }
+  }
+  gen->va_gp = 8 * ints;
+  gen->va_fp = 8 * INT_ARG_COUNT + 16 * sses;
+  gen->va_stack = stack;
+  free(params);
+}
+
+static void epilogue(gen_t *gen, ir_instr_t *instr) {
+  const type_t *ret = gen->func->symbol->type->func.ret->unqual;
+  if (instr->count && dcc_type_is_record(ret)) {
+    abi_class_t classes[2];
+    int n = dcc_type_classify(ret, classes);
+    op(gen, ASM_MOV, 8, home(gen, instr->args[0]), reg(ASM_RSI, 8));
+    if (!n) {
+      // copy it out to the caller's memory, returning the address
+      op(gen, ASM_MOV, 8, frame(gen->sret), reg(ASM_RDI, 8));
+      copy(gen, dcc_type_size(ret));
+      op(gen, ASM_MOV, 8, frame(gen->sret), reg(ASM_RAX, 8));
+    } else {
+      op(gen, ASM_LEA, 8, frame(gen->scratch), reg(ASM_RDI, 8));
+      copy(gen, dcc_type_size(ret));
+      int ints = 0, sses = 0;
+      for (int j = 0; j < n; j++) {
+        asm_operand_t eightbyte = frame(gen->scratch + 8 * j);
+        if (classes[j] == CLASS_INTEGER) {
+          op(gen, ASM_MOV, 8, eightbyte, reg(ints++ ? ASM_RDX : ASM_RAX, 8));
+        } else {
+          op(gen, ASM_MOVSD, 8, eightbyte, xmm(sses++));
+        }
+      }
+    }
+  } else if (instr->count && is_float_kind(kind_of(gen, instr->args[0]))) {
+    load_float(gen, instr->args[0], 0);
+  } else if (instr->count) {
+    load(gen, instr->args[0], ASM_RAX, dcc_type_is_signed(ret));
+  }
+  for (int r = 0; r < 16; r++) {
+    if (gen->saved & BIT(r)) {
+      op(gen, ASM_MOV, 8, frame(gen->saves[r]), reg(r, 8));
+    }
+  }
+  op(gen, ASM_LEAVE, 0, ASM_NO_OPERAND, ASM_NO_OPERAND);
+  op(gen, ASM_RET, 0, ASM_NO_OPERAND, ASM_NO_OPERAND);
+}
+
+typedef struct {
+  asm_operand_t dst, src;
+  enum asm_op op; // ASM_MOV, ASM_MOVSD or ASM_MOVUPS
+} move_t;
+
+static bool same_place(asm_operand_t a, asm_operand_t b) {
+  return a.tag == b.tag && a.reg == b.reg && (a.tag != ASM_MEM || a.value == b.value);
+}
+
+static void move(gen_t *gen, asm_operand_t src, asm_operand_t dst, enum asm_op o) {
+  if (src.tag == ASM_MEM && dst.tag == ASM_MEM) {
+    asm_operand_t via = o != ASM_MOV ? xmm(1) : reg(ASM_RCX, 8);
+    op(gen, o, 8, src, via);
+    src = via;
+  }
+  op(gen, o == ASM_MOVSD ? float_move(o, src, dst) : o, 8, src, dst);
+}
+
+static bool has_phis(gen_t *gen, uint32_t b) {
+  ir_block_t *block = &gen->func->blocks.data[b];
+  return gen->func->instrs.data[block->instrs.data[0]].op == IR_PHI;
+}
+
+// Move the operands of the phis of `to` for its edge from `from` into their
+// homes, all at once: a move waits until nothing else reads its destination,
+// and a cycle is broken by moving one value aside to rax or xmm0
+static void phi_moves(gen_t *gen, uint32_t from, uint32_t to) {
+  ir_func_t *func = gen->func;
+  ir_block_t *block = &func->blocks.data[to];
+  uint32_t pred = 0;
+  while (block->preds.data[pred] != from) {
+    pred++;
+  }
+  move_t *moves = dcc_malloc(block->instrs.size * sizeof(move_t));
+  uint32_t count = 0;
+  for (size_t k = 0; k < block->instrs.size; k++) {
+    ir_instr_t *phi = &func->instrs.data[block->instrs.data[k]];
+    if (phi->op != IR_PHI) {
+      break;
+    }
+    move_t *m = &moves[count];
+    m->dst = home_as(gen, block->instrs.data[k], 8);
+    m->src = home_as(gen, phi->args[pred], 8);
+    m->op = dcc_ir_is_vector(phi->kind) ? ASM_MOVUPS
+      : is_float_kind(phi->kind) ? ASM_MOVSD : ASM_MOV;
+    count += !same_place(m->dst, m->src);
+  }
+
+  while (count) {
+    uint32_t i = 0, j = 0;
+    for (i = 0; i < count; i++) {
+      for (j = 0; j < count && (j == i || !same_place(moves[j].src, moves[i].dst)); j++) {
+      }
+      if (j == count) {
+        break;
+      }
+    }
+    if (i < count) {
+      move(gen, moves[i].src, moves[i].dst, moves[i].op);
+      moves[i] = moves[--count];
+      continue;
+    }
+    asm_operand_t aside = moves[0].op != ASM_MOV ? xmm(0) : reg(ASM_RAX, 8);
+    move(gen, moves[0].dst, aside, moves[0].op);
+    for (j = 1; j < count; j++) {
+      if (same_place(moves[j].src, moves[0].dst)) {
+        moves[j].src = aside;
+      }
+    }
+  }
+  free(moves);
+}
+
+// The label a branch from `from` to `to` goes to: a stub that moves the
+// operands of the phis of `to`, if it has any
+static uint32_t edge_label(gen_t *gen, uint32_t from, uint32_t to) {
+  if (!has_phis(gen, to)) {
+    return gen->labels[to];
+  }
+  edge_t edge = { dcc_asm_temp(gen->as), from, to };
+  edge_vec_push(&gen->edges, edge);
+  return edge.label;
+}
+
+// Continue from the end of `from` to `to`
+static void jump(gen_t *gen, uint32_t from, uint32_t to) {
+  if (has_phis(gen, to)) {
+    phi_moves(gen, from, to);
+  }
+  if (to != from + 1) {
+    op(gen, ASM_JMP, 0, ASM_NO_OPERAND, target(gen->labels[to]));
+  }
+}
+
+static void terminator(gen_t *gen, uint32_t b, ir_ref_t ref) {
+  ir_func_t *func = gen->func;
+  ir_instr_t *instr = &func->instrs.data[ref];
+  uint32_vec_t *succs = &func->blocks.data[b].succs;
+  switch (instr->op) {
+  case IR_JMP:
+    jump(gen, b, succs->data[0]);
+    break;
+  case IR_BR: {
+    // branch to one successor, through a stub if it has phis, and go on to
+    // the other, falling through if it is next
+    ir_ref_t cond = instr->args[0];
+    uint8_t size = kind_size(kind_of(gen, cond));
+    bool invert = succs->data[0] == b + 1;
+    uint32_t label = edge_label(gen, b, succs->data[invert]);
+    op(gen, ASM_CMP, size, imm(0), home(gen, cond));
+    dcc_asm_cond(gen->as, ASM_JCC, invert ? ASM_CC_E : ASM_CC_NE, target(label));
+    jump(gen, b, succs->data[!invert]);
+    break;
+  }
+  case IR_SWITCH: {
+    // check the bounds, then add the entry's offset to the table's address
+    uint32_t *labels = dcc_malloc(succs->size * sizeof(uint32_t));
+    for (size_t s = 0; s < succs->size; s++) {
+      labels[s] = edge_label(gen, b, succs->data[s]);
+    }
+    const ir_table_t *table = instr->table;
+    jump_table_t jumps = { dcc_asm_temp(gen->as), table->size,
+                           dcc_arena_alloc(&gen->arena, table->size * sizeof(uint32_t)) };
+    for (uint32_t e = 0; e < table->size; e++) {
+      jumps.labels[e] = labels[table->succs[e]];
+    }
+    jump_table_vec_push(&gen->tables, jumps);
+
+    ir_ref_t index = instr->args[0];
+    uint8_t size = kind_size(kind_of(gen, index)) < 8 ? 4 : 8;
+    load(gen, index, ASM_RAX, false);
+    op(gen, ASM_CMP, size, imm(table->size), reg(ASM_RAX, size));
+    dcc_asm_cond(gen->as, ASM_JCC, ASM_CC_AE, target(labels[0]));
+    op(gen, ASM_LEA, 8, dcc_asm_rip(jumps.symbol, 0, ASM_DIRECT), reg(ASM_RCX, 8));
+    op(gen, ASM_SHL, 8, imm(2), reg(ASM_RAX, 8));
+    op(gen, ASM_ADD, 8, reg(ASM_RCX, 8), reg(ASM_RAX, 8));
+    op(gen, ASM_MOVSL, 8, dcc_asm_mem(ASM_RAX, 0), reg(ASM_RAX, 8));
+    op(gen, ASM_ADD, 8, reg(ASM_RCX, 8), reg(ASM_RAX, 8));
+    op(gen, ASM_JMP, 0, ASM_NO_OPERAND, reg(ASM_RAX, 8));
+    free(labels);
+    break;
+  }
+  default:
+    epilogue(gen, instr);
+    break;
+  }
+}
+
+static void gen_function(gen_t *gen, ir_func_t *func) {
+  gen->func = func;
+  layout(gen);
+  gen->labels = dcc_malloc(func->blocks.size * sizeof(uint32_t));
+  for (size_t b = 0; b < func->blocks.size; b++) {
+    gen->labels[b] = dcc_asm_temp(gen->as);
+  }
+
+  uint32_t symbol = global_symbol(gen, func->symbol);
+  dcc_asm_align(gen->as, 16);
+  dcc_asm_label(gen->as, symbol);
+  op(gen, ASM_PUSH, 8, ASM_NO_OPERAND, reg(ASM_RBP, 8));
+  op(gen, ASM_MOV, 8, reg(ASM_RSP, 8), reg(ASM_RBP, 8));
+  op(gen, ASM_SUB, 8, imm(gen->frame), reg(ASM_RSP, 8));
+  for (int r = 0; r < 16; r++) {
+    if (gen->saved & BIT(r)) {
+      op(gen, ASM_MOV, 8, reg(r, 8), frame(gen->saves[r]));
+    }
+  }
+  prologue(gen);
+
+  for (uint32_t b = 0; b < func->blocks.size; b++) {
+    dcc_asm_label(gen->as, gen->labels[b]);
+    uint32_vec_t *instrs = &func->blocks.data[b].instrs;
+    for (size_t i = 0; i < instrs->size; i++) {
+      ir_ref_t ref = instrs->data[i];
+      ir_instr_t *ir = &func->instrs.data[ref];
+      if (dcc_ir_is_terminator(ir->op)) {
+        terminator(gen, b, ref);
+      } else {
+        instr(gen, ref);
+      }
+    }
+  }
+  for (size_t i = 0; i < gen->edges.size; i++) {
+    edge_t *edge = &gen->edges.data[i];
+    dcc_asm_label(gen->as, edge->label);
+    phi_moves(gen, edge->from, edge->to);
+    op(gen, ASM_JMP, 0, ASM_NO_OPERAND, target(gen->labels[edge->to]));
+  }
+  gen->edges.size = 0;
+  dcc_asm_end(gen->as, symbol);
+
+  free(gen->regs);
+  free(gen->homes);
+  free(gen->slots);
+  free(gen->areas);
+  free(gen->labels);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Static data
+////////////////////////////////////////////////////////////////////////////////
+
+// The value of a constant expression with static storage in mind: a number,
+// or the address of a symbol plus an offset
+typedef struct {
+  enum {
+    STATIC_INT,
+    STATIC_FLOAT,
+    STATIC_ADDRESS,
+  } tag;
+  uint64_t bits; // STATIC_INT, extended from the type's width, or the offset
+  double f;
+  uint32_t symbol;
+} static_value_t;
+
+static uint64_t normalize(uint64_t bits, const type_t *type) {
+  uint64_t size = dcc_type_size(type);
+  if (type->tag == TYPE_BOOL) {
+    return bits != 0;
+  } else if (size >= 8) {
+    return bits;
+  }
+  uint64_t sign = (uint64_t)1 << (size * 8 - 1);
+  bits &= (sign << 1) - 1;
+  return dcc_type_is_signed(type) && (bits & sign) ? bits | ~((sign << 1) - 1) : bits;
+}
+
+static bool convert_static(static_value_t *value, const type_t *from, const type_t *to) {
+  if (dcc_type_is_float(to)) {
+    if (value->tag == STATIC_ADDRESS) {
+      return false;
+    } else if (value->tag == STATIC_INT) {
+      value->f = dcc_type_is_signed(from) ? (double)(int64_t)value->bits : (double)value->bits;
+    }
+    value->tag = STATIC_FLOAT;
+    value->f = to->tag == TYPE_FLOAT ? (float)value->f : value->f;
+  } else if (value->tag == STATIC_FLOAT) {
+    value->tag = STATIC_INT;
+    if (to->tag == TYPE_BOOL) {
+      value->bits = value->f != 0;
+    } else {
+      value->bits = dcc_type_is_signed(to) ? (uint64_t)(int64_t)value->f : (uint64_t)value->f;
+    }
+    value->bits = normalize(value->bits, to);
+  } else if (value->tag == STATIC_INT) {
+    value->bits = normalize(value->bits, to);
+  } else if (dcc_type_size(to) != 8) {
+    // an address only fits a pointer
+    return false;
+  }
+  return true;
+}
+
+static bool static_value(gen_t *gen, exp_t *exp, static_value_t *value);
+
+static bool static_address(gen_t *gen, exp_t *exp, static_value_t *value) {
+  value->tag = STATIC_ADDRESS;
+  value->bits = 0;
+  switch (exp->tag) {
+  case EXP_IDENT: {
+    symbol_t *symbol = exp->ident.symbol;
+    if (!dcc_ptrmap_get(&gen->globals, symbol) && symbol->tag != SYM_FUNCTION) {
+      return false;
+    }
+    value->symbol = global_symbol(gen, symbol);
+    return true;
+  }
+  case EXP_STRING:
+    value->symbol = string_symbol(gen, exp->string);
+    return true;
+  case EXP_DOT:
+  case EXP_ARROW: {
+    const type_t *record = exp->tag == EXP_ARROW ? value_type(exp->child.lhs)->base
+      : exp->child.lhs->type;
+    bool ok = exp->tag == EXP_ARROW ? static_value(gen, exp->child.lhs, value)
+      : static_address(gen, exp->child.lhs, value);
+    if (!ok || value->tag != STATIC_ADDRESS) {
+      return false;
+    }
+    value->bits += dcc_record_member(record->record, exp->child.name.name)->offset;
+    return true;
+  }
+  case EXP_INDEX: {
+    exp_t *pointer = exp->binary.lhs, *index = exp->binary.rhs;
+    if (value_type(index)->tag == TYPE_POINTER) {
+      exp_t *swap = pointer;
+      pointer = index;
+      index = swap;
+    }
+    static_value_t offset;
+    if (!static_value(gen, pointer, value) || value->tag != STATIC_ADDRESS
+        || !static_value(gen, index, &offset) || offset.tag != STATIC_INT) {
+      return false;
+    }
+    value->bits += offset.bits * dcc_type_size(value_type(pointer)->base);
+    return true;
+  }
+  case EXP_DEREFERENCE:
+    return static_value(gen, exp->unary, value) && value->tag == STATIC_ADDRESS;
+  default:
+    return false;
+  }
+}
+
+static bool static_value(gen_t *gen, exp_t *exp, static_value_t *value) {
+  const type_t *type = value_type(exp);
+  if (exp->type->tag == TYPE_ARRAY || exp->type->tag == TYPE_FUNCTION) {
+    // designators decay to their address
+    return static_address(gen, exp, value);
+  }
+
+  static_value_t rhs;
+  switch (exp->tag) {
+  case EXP_CONSTANT:
+    if (dcc_type_is_float(type)) {
+      value->tag = STATIC_FLOAT;
+      value->f = type->tag == TYPE_FLOAT ? (float)exp->constant->floating
+        : exp->constant->floating;
+    } else {
+      value->tag = STATIC_INT;
+      value->bits = normalize(exp->constant->integer, type);
+    }
+    return true;
+  case EXP_ADDRESSOF:
+    return static_address(gen, exp->unary, value);
+  case EXP_CAST:
+    return type->tag != TYPE_VOID && static_value(gen, exp->cast.value, value)
+      && convert_static(value, value_type(exp->cast.value), type);
+  case EXP_NEGATE:
+    if (!static_value(gen, exp->unary, value) || value->tag == STATIC_ADDRESS
+        || !convert_static(value, value_type(exp->unary), type)) {
+      return false;
+    }
+    value->f = -value->f;
+    value->bits = normalize(-value->bits, type);
+    return true;
+  case EXP_ADD:
+  case EXP_SUBTRACT:
+  case EXP_MULTIPLY:
+  case EXP_DIVIDE: {
+    exp_t *lhs = exp->binary.lhs, *other = exp->binary.rhs;
+    if (!static_value(gen, lhs, value) || !static_value(gen, other, &rhs)) {
+      return false;
+    }
+    if (value->tag == STATIC_INT && rhs.tag == STATIC_ADDRESS && exp->tag == EXP_ADD) {
+      static_value_t swap = *value;
+      *value = rhs;
+      rhs = swap;
+      exp_t *swap_exp = lhs;
+      lhs = other;
+      other = swap_exp;
+    }
+    if (value->tag == STATIC_ADDRESS) {
+      // pointer arithmetic, in units of the pointed to type
+      if (rhs.tag != STATIC_INT || exp->tag == EXP_MULTIPLY || exp->tag == EXP_DIVIDE) {
+        return false;
+      }
+      uint64_t step = dcc_type_size(value_type(lhs)->base) * rhs.bits;
+      value->bits += exp->tag == EXP_ADD ? step : -step;
+      return true;
+    } else if (!dcc_type_is_float(type) || rhs.tag == STATIC_ADDRESS
+               || !convert_static(value, value_type(lhs), type)
+               || !convert_static(&rhs, value_type(other), type)) {
+      // integer arithmetic was already folded
+      return false;
+    }
+    switch (exp->tag) {
+    case EXP_ADD: value->f += rhs.f; break;
+    case EXP_SUBTRACT: value->f -= rhs.f; break;
+    case EXP_MULTIPLY: value->f *= rhs.f; break;
+    default: value->f /= rhs.f; break;
+    }
+    return convert_static(value, type, type);
+  }
+  default:
+    return false;
+  }
+}
+
+static void write_bytes(uint8_t *buffer, uint64_t bits, uint64_t size) {
+  for (uint64_t i = 0; i < size && i < 8; i++) {
+    buffer[i] = bits >> (8 * i);
+  }
+}
+
+static uint64_t read_bytes(const uint8_t *buffer, uint64_t size) {
+  uint64_t bits = 0;
+  for (uint64_t i = 0; i < size && i < 8; i++) {
+    bits |= (uint64_t)buffer[i] << (8 * i);
+  }
+  return bits;
+}
+
+static void init_entry(gen_t *gen, uint8_t *buffer, data_reloc_vec_t *relocs,
+                       const init_entry_t *entry) {
+  const type_t *type = entry->type->unqual;
+  uint64_t size = dcc_type_size(type);
+  exp_t *exp = entry->exp;
+
+  // a later entry replaces any address it overlaps
+  for (size_t i = 0; i < relocs->size; i++) {
+    if (relocs->data[i].offset + 8 > entry->offset
+        && relocs->data[i].offset < entry->offset + size) {
+      relocs->data[i--] = relocs->data[--relocs->size];
+    }
+  }
+
+  if (type->tag == TYPE_ARRAY && exp->tag == EXP_STRING) {
+    size_t len;
+    const char *bytes = dcc_strlit_bytes(exp->string, &len);
+    memcpy(buffer + entry->offset, bytes, dcc_init_string_size(entry));
+    return;
+  }
+  static_value_t value;
+  if (!dcc_type_is_scalar(type) || !static_value(gen, exp, &value)
+      || !convert_static(&value, value_type(exp), type)) {
+    dcc_diag(gen->diags, DIAG_ERROR, exp->loc, 1,
+             "initializer element is not a compile-time constant");
+    return;
+  }
+
+  uint8_t *at = buffer + entry->offset;
+  if (value.tag == STATIC_ADDRESS) {
+    data_reloc_t reloc = { entry->offset, value.symbol, value.bits };
+    data_reloc_vec_push(relocs, reloc);
+    memset(at, 0, 8);
+  } else if (value.tag == STATIC_FLOAT) {
+    if (type->tag == TYPE_FLOAT) {
+      float f = value.f;
+      memcpy(at, &f, 4);
+    } else {
+      memcpy(at, &value.f, 8);
+    }
+  } else if (entry->bit_width) {
+    uint64_t mask = (entry->bit_width < 64 ? ((uint64_t)1 << entry->bit_width) : 0) - 1;
+    uint64_t unit = read_bytes(at, size) & ~(mask << entry->bit_offset);
+    write_bytes(at, unit | (value.bits & mask) << entry->bit_offset, size);
+  } else {
+    write_bytes(at, value.bits, size);
+  }
+}
+
+static int compare_relocs(const void *a, const void *b) {
+  const data_reloc_t *x = a, *y = b;
+  return x->offset < y->offset ? -1 : x->offset > y->offset;
+}
+
+static void gen_object(gen_t *gen, global_t *global) {
+  const type_t *type = global->symbol->type;
+  uint64_t size = dcc_type_size(type);
+  uint32_t symbol = global_symbol(gen, global->symbol);
+  dcc_asm_section(gen->as, global->init ? ASM_DATA : ASM_BSS);
+  dcc_asm_align(gen->as, dcc_type_align(type));
+  dcc_asm_label(gen->as, symbol);
+  if (!global->init) {
+    dcc_asm_zero(gen->as, size);
+    dcc_asm_end(gen->as, symbol);
+    return;
+  }
+
+  int64_t length;
+  init_entry_vec_t entries = dcc_init_layout(type, global->init, 0, &length);
+  uint8_t *buffer = dcc_calloc(size + 1, 1);
+  data_reloc_vec_t relocs = data_reloc_vec_new();
+  for (size_t i = 0; i < entries.size; i++) {
+    init_entry(gen, buffer, &relocs, &entries.data[i]);
+  }
+  if (relocs.size) {
+    qsort(relocs.data, relocs.size, sizeof(data_reloc_t), compare_relocs);
+  }
+
+  uint64_t at = 0;
+  for (size_t i = 0; i < relocs.size; i++) {
+    data_reloc_t *reloc = &relocs.data[i];
+    dcc_asm_bytes(gen->as, buffer + at, reloc->offset - at);
+    dcc_asm_address(gen->as, reloc->symbol, reloc->addend);
+    at = reloc->offset + 8;
+  }
+  dcc_asm_bytes(gen->as, buffer + at, size - at);
+  dcc_asm_end(gen->as, symbol);
+
+  data_reloc_vec_free(&relocs);
+  init_entry_vec_free(&entries);
+  free(buffer);
+}
+
+void dcc_x86_gen(asm_t *as, external_decl_vec_t *unit, ir_func_vec_t *funcs,
+                 diag_vec_t *diags) {
+  gen_t gen = {
+    as, diags, dcc_arena_new(), dcc_ptrmap_new(), global_vec_new(),
+    dcc_ptrmap_new(), strlit_vec_new(), 0, jump_table_vec_new(),
+  };
+
+  dcc_sema_globals(unit, declare, &gen);
+
+  dcc_asm_section(as, ASM_TEXT);
+  for (size_t i = 0; i < funcs->size; i++) {
+    gen_function(&gen, funcs->data[i]);
+  }
+  for (size_t i = 0; i < gen.objects.size; i++) {
+    if (gen.objects.data[i]->is_defined) {
+      gen_object(&gen, gen.objects.data[i]);
+    }
+  }
+  if (gen.string_order.size || gen.tables.size) {
+    dcc_asm_section(as, ASM_RODATA);
+  }
+  for (size_t i = 0; i < gen.string_order.size; i++) {
+    size_t len;
+    const char *bytes = dcc_strlit_bytes(gen.string_order.data[i], &len);
+    dcc_asm_label(as, string_symbol(&gen, gen.string_order.data[i]));
+    dcc_asm_bytes(as, bytes, len + 1);
+  }
+  for (size_t i = 0; i < gen.tables.size; i++) {
+    jump_table_t *table = &gen.tables.data[i];
+    dcc_asm_align(as, 4);
+    dcc_asm_label(as, table->symbol);
+    for (uint32_t e = 0; e < table->size; e++) {
+      dcc_asm_offset(as, table->labels[e], 4 * (int64_t)e);
+    }
+  }
+
+  dcc_arena_free(&gen.arena);
+  dcc_ptrmap_free(&gen.globals);
+  global_vec_free(&gen.objects);
+  dcc_ptrmap_free(&gen.strings);
+  strlit_vec_free(&gen.string_order);
+  edge_vec_free(&gen.edges);
+  jump_table_vec_free(&gen.tables);
+}
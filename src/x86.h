@@ -0,0 +1,37 @@
+/*
+  Copyright (C) 2018  Jason Priest
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+  x86-64 code generation for the System V ABI. Every function's IR becomes
+  instructions in an asm_t, and every object with static storage the unit
+  defines becomes data laid out from its initializer. Each IR value has a home
+  in a register picked by dcc_regalloc(), or in the frame if it was spilled;
+  instructions load their operands into fixed scratch registers, which are
+  never allocated, and store their result back to its home.
+*/
+
+#pragma once
+
+#include "asm.h"
+#include "diag.h"
+#include "ir.h"
+#include "parse.h"
+
+// Generate `funcs`, lowered from `unit`, and the objects `unit` defines into
+// `as`. Static initializers that are not constant are reported to `diags`.
+void dcc_x86_gen(asm_t *as, external_decl_vec_t *unit, ir_func_vec_t *funcs,
+                 diag_vec_t *diags);
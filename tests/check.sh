@@ -0,0 +1,96 @@
+#!/bin/sh
+# Compile each test program with dcc in every mode, link the assembly and
+# objects with the system compiler, and compare what the programs print and
+# return with their .expected files. Programs under interpret/ call nothing
+# outside themselves, so they also go through the sandboxed -interpret.
+# Programs under errors/ must be rejected, with the diagnostics expected, and
+# those under deps/ give the Make rules expected of -MM and -M. Programs under
+# pch/ are run with their header precompiled, then with the header touched and
+# with the precompiled header truncated, which must both be refused.
+#
+# usage: tests/check.sh [program.c...]
+
+DCC=${DCC:-./dcc}
+LINK=${LINK:-cc}
+tests=$(dirname "$0")
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT INT TERM
+
+if [ $# -eq 0 ]; then
+  set -- "$tests"/programs/*.c "$tests"/interpret/*.c "$tests"/errors/*.c "$tests"/deps/*.c \
+    "$tests"/pch/*.c
+fi
+
+passed=0
+failed=0
+
+# Run a command, keeping what it prints followed by its exit status
+record() {
+  "$@" > "$tmp/out" 2>&1
+  echo "exit $?" >> "$tmp/out"
+}
+
+# Both rules for a program, each on one line, with the directory of the
+# program and the one of dcc's own headers left out
+rules() {
+  include=$(cd "$tests/.." && pwd)/include/
+  { $DCC -MM "$1" && $DCC -M "$1"; } |
+    sed -e :a -e '/\\$/{N;s/ *\\\n */ /;ba' -e '}' |
+    sed -e "s| $(dirname "$1")/| |g" -e "s|$include|include/|g"
+}
+
+# Run a program with its header precompiled, then check that a precompiled
+# header whose source changed and one cut short are refused
+pch() {
+  cp "${1%.c}.h" "$tmp/$name.h" && $DCC --emit-pch "$tmp/$name.h" -o "$tmp/$name.pch" || return
+  $DCC -include-pch "$tmp/$name.pch" -run "$1"
+  echo "exit $?"
+  touch -t 200001010000 "$tmp/$name.h"
+  $DCC -include-pch "$tmp/$name.pch" -run "$1"
+  echo "exit $?"
+  cp "${1%.c}.h" "$tmp/$name.h" && $DCC --emit-pch "$tmp/$name.h" -o "$tmp/$name.pch" || return
+  head -c 256 "$tmp/$name.pch" > "$tmp/$name.part"
+  $DCC -include-pch "$tmp/$name.part" -run "$1"
+}
+
+for src in "$@"; do
+  name=$(basename "$src" .c)
+  modes="-S -c -run"
+  case $src in
+    */interpret/*) modes="$modes -interpret" ;;
+    */errors/*) modes="-error" ;;
+    */deps/*) modes="-M" ;;
+    */pch/*) modes="-pch" ;;
+  esac
+
+  for mode in $modes; do
+    rm -f "$tmp/out" "$tmp/$name" "$tmp/$name.s" "$tmp/$name.o"
+    case $mode in
+      -S) $DCC -S "$src" -o "$tmp/$name.s" && $LINK "$tmp/$name.s" -o "$tmp/$name" -lm ;;
+      -c) $DCC -c "$src" -o "$tmp/$name.o" && $LINK "$tmp/$name.o" -o "$tmp/$name" -lm ;;
+    esac
+    case $mode in
+      -S|-c) [ -x "$tmp/$name" ] && record "$tmp/$name" ;;
+      -M) record rules "$src" ;;
+      -pch)
+        record pch "$src"
+        sed "s|$tmp/||g" "$tmp/out" > "$tmp/pch.out" && mv "$tmp/pch.out" "$tmp/out" ;;
+      -error)
+        record $DCC -S "$src" -o "$tmp/$name.s"
+        sed "s|^$(dirname "$src")/||" "$tmp/out" > "$tmp/diags" && mv "$tmp/diags" "$tmp/out" ;;
+      -run) record $DCC -run -lm "$src" ;;
+      *) record $DCC $mode "$src" ;;
+    esac
+
+    if [ -f "$tmp/out" ] && cmp -s "$tmp/out" "${src%.c}.expected"; then
+      passed=$((passed + 1))
+    else
+      failed=$((failed + 1))
+      echo "FAIL: $src ($mode)"
+      [ -f "$tmp/out" ] && diff "${src%.c}.expected" "$tmp/out" | head -10
+    fi
+  done
+done
+
+echo "$passed passed, $failed failed"
+[ $failed -eq 0 ]
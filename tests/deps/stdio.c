@@ -0,0 +1,6 @@
+#include <stdio.h>
+#include "local.h"
+
+int main(void) {
+  return printf("%d\n", LOCAL) < 0;
+}
@@ -0,0 +1,39 @@
+enum { THREE = 3 };
+
+int classify(int x, unsigned char c, unsigned u) {
+  switch (x) {
+  case 1:
+  case THREE:
+    return 1;
+  case 1 + 2:
+    return 2;
+  case -1:
+  case 0xffffffff:
+    break;
+  default:
+    break;
+  default:
+    return 3;
+  }
+  switch (c) {
+  case 1:
+  case 257:
+    break;
+  }
+  switch (u) {
+  case -1:
+  case 4294967295u:
+    break;
+  }
+  switch (x) {
+  case 1:
+    switch (c) {
+    case 1:
+    default:
+      break;
+    }
+  default:
+    break;
+  }
+  return 0;
+}
@@ -0,0 +1,29 @@
+int total(int n) {
+  int sum = 0
+  sum++;
+  for (int i = 0; i < n; i++) {
+    sum += (i * 2;
+  }
+  if (sum > 10 {
+    sum = 10;
+  }
+  return sum;
+}
+
+int table[] = { 1, 2, };
+int broken = { 1 + };
+int missing = 2 *
+
+struct point {
+  int x;
+  int 3;
+};
+
+int after(void) {
+  int x = total(4);
+  return x +
+}
+
+int main(void) {
+  return total(3);
+}
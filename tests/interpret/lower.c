@@ -0,0 +1,27 @@
+struct P { int x, y; unsigned b : 3; int s : 5; };
+int g;
+int sum(int *a, int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++)
+    s += a[i];
+  return s;
+}
+int fact(int n) { return n <= 1 ? 1 : n * fact(n - 1); }
+int sw(int x) {
+  switch (x) { case 1: return 10; case 2: x++; case 3: return x; default: break; }
+  return -1;
+}
+struct P mk(int a) { struct P p = { a, a + 1 }; p.b = 5; p.s = -3; return p; }
+int addr(void) { int v = 3; int *p = &v; *p = 4; return v && g || !v; }
+double fl(float f, long l) { return f * l + 0.5; }
+int main(void) {
+  int a[4] = {1, 2, 3};
+  char s[] = "hi";
+  struct P p = mk(2);
+  goto end;
+  g = 5;
+end:
+  while (g < 10) { g++; if (g == 7) continue; if (g == 8) break; }
+  do g--; while (g > 3);
+  return sum(a, 3) + fact(4) + sw(2) + p.s + s[0] + addr() + (int)fl(1.5f, 2);
+}
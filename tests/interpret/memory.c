@@ -0,0 +1,59 @@
+typedef unsigned long size_t;
+struct node { int value; struct node *next; };
+struct pair { long a; double b; char tag[5]; };
+static struct node nodes[4] = { { 1, &nodes[1] }, { 2, &nodes[2] }, { 3, &nodes[3] }, { 4, 0 } };
+static int grid[3][4] = { [1] = { 5, 6 }, [2][3] = 7 };
+static char name[] = "dcc";
+static int (*ops[2])(int, int);
+static int add(int a, int b) { return a + b; }
+static int sub(int a, int b) { return a - b; }
+static unsigned hash(const char *s) {
+  unsigned h = 2166136261u;
+  while (*s) { h ^= (unsigned char)*s++; h *= 16777619u; }
+  return h;
+}
+static int counter(void) { static int n = 100; return n++; }
+static struct pair make(long a, double b) {
+  struct pair p = { a, b, "abcd" };
+  p.tag[0] = 'z';
+  return p;
+}
+static void sort(int *a, int n) {
+  for (int i = 1; i < n; i++) {
+    int v = a[i], j = i - 1;
+    while (j >= 0 && a[j] > v) { a[j + 1] = a[j]; j--; }
+    a[j + 1] = v;
+  }
+}
+int main(void) {
+  unsigned acc = 0;
+  struct node *n;
+  for (n = nodes; n; n = n->next) acc = acc * 31 + n->value;
+  for (int i = 0; i < 3; i++) for (int j = 0; j < 4; j++) acc = acc * 7 + grid[i][j];
+  acc += hash(name) + hash("hello world");
+  ops[0] = add; ops[1] = sub;
+  acc += ops[0](5, 3) * ops[1](5, 3);
+  counter(); counter();
+  acc += counter();
+  struct pair p = make(-5, 2.75);
+  acc += p.a * 3 + (int)(p.b * 4) + p.tag[0] + p.tag[3];
+  int arr[] = { 9, -2, 7, 3, 3, 0, 12, -8 };
+  sort(arr, 8);
+  for (int i = 0; i < 8; i++) acc = acc * 3 + arr[i];
+  int *lo = &arr[1], *hi = &arr[6];
+  acc += (hi - lo) * 1000;
+  short sh = 30000; sh += 30000; acc += sh;
+  signed char sc = -128; sc--; acc += sc;
+  unsigned short us = 65535; us++; acc += us + 1;
+  long long ll = -1; ll = (unsigned)ll; acc += (unsigned)(ll >> 16);
+  acc += (unsigned)(1.0e10 / 3) ;
+  double x = 1; for (int i = 0; i < 20; i++) x = x * 1.5 - 0.25;
+  acc += (unsigned)x;
+  float f = 16777217.0f; acc += (unsigned)f;
+  acc += (int)(-3.7 * 2);
+  int *cl = (int[]){ 4, 5, 6 }; acc += cl[2];
+  struct node tmp = { .next = 0, .value = 77 }; acc += tmp.value;
+  acc += (acc & 1 ? 11 : 13);
+  acc ^= acc >> 7;
+  return acc & 0xff;
+}
@@ -0,0 +1,67 @@
+struct point { int x, y; };
+struct bits { unsigned a : 3; int b : 5; unsigned c : 7; };
+static int table[] = { 3, 1, 4, 1, 5, 9, 2, 6 };
+static const char *greeting = "hello";
+int counter;
+int fib(int n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }
+struct point add(struct point a, struct point b) {
+  struct point r = { a.x + b.x, a.y + b.y };
+  return r;
+}
+static int apply(int (*f)(int), int v) { return f(v); }
+static int twice(int v) { return 2 * v; }
+int check(int got, int want) {
+  counter++;
+  if (got != want) return counter;
+  return 0;
+}
+int main(int argc, char **argv) {
+  int bad = 0, i, sum = 0;
+  unsigned char uc = 250;
+  short s = -3;
+  long long big = 1LL << 40;
+  double d = 2.5;
+  float f = 1.25f;
+  struct point p = { 1, 2 }, q = { 10, 20 }, r;
+  struct bits b;
+  char buf[16];
+  int *ptr = table;
+  for (i = 0; i < 8; i++) sum += table[i];
+  bad = bad ? bad : check(sum, 31);
+  bad = bad ? bad : check(fib(15), 610);
+  r = add(p, q);
+  bad = bad ? bad : check(r.x * 100 + r.y, 1122);
+  uc += 10;
+  bad = bad ? bad : check(uc, 4);
+  bad = bad ? bad : check(s * 7, -21);
+  bad = bad ? bad : check((int)(big >> 38), 4);
+  bad = bad ? bad : check((int)(d * 4), 10);
+  bad = bad ? bad : check((int)(f * 8), 10);
+  b.a = 9; b.b = -5; b.c = 100;
+  bad = bad ? bad : check(b.a + b.b * 1000 + b.c * 10, 1 - 5000 + 1000);
+  bad = bad ? bad : check(apply(twice, 21), 42);
+  bad = bad ? bad : check(greeting[1], 'e');
+  bad = bad ? bad : check(*(ptr + 5) + ptr[2], 13);
+  for (i = 0; i < 5; i++) buf[i] = 'a' + i;
+  buf[5] = 0;
+  i = 0;
+  while (buf[i]) i++;
+  bad = bad ? bad : check(i, 5);
+  do { i--; } while (i > 2);
+  bad = bad ? bad : check(i, 2);
+  switch (i) { case 1: i = 10; break; case 2: i = 20; case 3: i++; break; default: i = 0; }
+  bad = bad ? bad : check(i, 21);
+  i = 0;
+again:
+  if (++i < 4) goto again;
+  bad = bad ? bad : check(i, 4);
+  bad = bad ? bad : check((i > 3 && sum == 31) || fib(30), 1);
+  bad = bad ? bad : check(-7 / 2 * 10 + -7 % 2, -31);
+  bad = bad ? bad : check((unsigned)-1 / 2 > 5, 1);
+  bad = bad ? bad : check(argc, 3);
+  bad = bad ? bad : check(argv[2][0], 'y');
+  bad = bad ? bad : check(sizeof(struct point), 8);
+  for (i = 0, sum = 0; i < 10; i++) { if (i == 3) continue; if (i == 7) break; sum += i; }
+  bad = bad ? bad : check(sum, 0+1+2+4+5+6);
+  return bad;
+}
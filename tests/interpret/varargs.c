@@ -0,0 +1,70 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <limits.h>
+#include <stdbool.h>
+
+struct pair { double x, y; };
+struct big { long a, b, c; };
+int counter;
+int check(long got, long want) {
+  counter++;
+  if (got != want) return counter;
+  return 0;
+}
+static long sum(int n, ...) {
+  va_list ap, copy;
+  va_start(ap, n);
+  va_copy(copy, ap);
+  long total = 0;
+  for (int i = 0; i < n; i++) total += va_arg(ap, int);
+  for (int i = 0; i < n; i++) total += va_arg(copy, int);
+  va_end(copy);
+  va_end(ap);
+  return total;
+}
+static double mixed(const char *kinds, ...) {
+  va_list ap;
+  va_start(ap, kinds);
+  double total = 0;
+  for (; *kinds; kinds++) {
+    if (*kinds == 'i') {
+      total += va_arg(ap, int);
+    } else if (*kinds == 'l') {
+      total += va_arg(ap, long);
+    } else if (*kinds == 'd') {
+      total += va_arg(ap, double);
+    } else if (*kinds == 'p') {
+      struct pair p = va_arg(ap, struct pair);
+      total += p.x * p.y;
+    } else if (*kinds == 'b') {
+      struct big b = va_arg(ap, struct big);
+      total += b.a + b.b + b.c;
+    }
+  }
+  va_end(ap);
+  return total;
+}
+static long forward(va_list ap) { return va_arg(ap, long) * va_arg(ap, long); }
+static long outer(int n, ...) {
+  va_list ap;
+  va_start(ap, n);
+  long product = forward(ap);
+  va_end(ap);
+  return product + n;
+}
+int main(void) {
+  int bad = 0;
+  struct pair p = { 2, 3 };
+  struct big b = { 1, 2, 3 };
+  bool yes = true;
+  bad = bad ? bad : check(sum(0), 0);
+  bad = bad ? bad : check(sum(3, 1, 2, 3), 12);
+  bad = bad ? bad : check(sum(12, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12), 156);
+  bad = bad ? bad : check(mixed("idpbl", 1, 2.5, p, b, 40L) * 2, 111);
+  bad = bad ? bad : check(mixed("dddddddddd", 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0, 10.0), 55);
+  bad = bad ? bad : check(mixed("iiiiiiibp", 1, 2, 3, 4, 5, 6, 7, b, p), 40);
+  bad = bad ? bad : check(outer(4, 6L, 7L), 46);
+  bad = bad ? bad : check(offsetof(struct big, c) + yes, 17);
+  bad = bad ? bad : check(INT_MAX + (long)INT_MIN + CHAR_BIT, 7);
+  return bad;
+}
@@ -0,0 +1,10 @@
+// Everything past <stdio.h> comes from prelude.h, precompiled
+#include <stdio.h>
+
+int main(void) {
+  point_t a = { 3, 4 }, b = { SQUARE(2), -1 };
+#ifdef PRELUDE_H
+  printf("%s %d %d\n", GREETING, dot(a, b), SQUARE(a.x + 1));
+#endif
+  return dot(a, a) - 25;
+}
@@ -0,0 +1,13 @@
+#ifndef PRELUDE_H
+#define PRELUDE_H
+
+#define SQUARE(x) ((x) * (x))
+#define GREETING "hello"
+
+typedef struct { int x, y; } point_t;
+
+static inline int dot(point_t a, point_t b) {
+  return a.x * b.x + a.y * b.y;
+}
+
+#endif
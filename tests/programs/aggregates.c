@@ -0,0 +1,36 @@
+#include "decls.h"
+struct fi { float f; int i; };
+union u { double d; long l; };
+struct ch { char a, b, c; };
+struct arr { short s[5]; };
+struct fi mkfi(float f, int i) { struct fi r; r.f = f; r.i = i; return r; }
+union u mku(long l) { union u r; r.l = l; return r; }
+struct ch mkch(char a) { struct ch c = { a, a + 1, a + 2 }; return c; }
+struct arr mkarr(short k) { struct arr a; for (int i = 0; i < 5; i++) a.s[i] = k * i; return a; }
+int take(struct fi a, union u b, struct ch c, struct arr d, int x1, int x2, int x3, int x4, struct fi e) {
+  return (int)a.f + a.i + (int)(b.l & 0xff) + c.a + c.c + d.s[4] + x1 + x2 + x3 + x4 + e.i;
+}
+static inline int sq(int x) { return x * x; }
+inline int cube(int x) { return x * x * x; }
+extern int cube(int);
+int old(int a, long b) { return a + (int)b; }
+static int helper(int x) { return x + 1; }
+int (*table[])(int) = { helper, sq, cube };
+static const char *const words[] = { "zero", "one", "two" };
+int counter;
+void bump(void) { counter++; }
+int main(void) {
+  struct fi a = mkfi(2.5f, 3);
+  union u b = mku(0x1234);
+  struct ch c = mkch('A');
+  struct arr d = mkarr(3);
+  printf("%d\n", take(a, b, c, d, 1, 2, 3, 4, mkfi(1, 100)));
+  printf("%d %d %d %d\n", table[0](1), table[1](5), table[2](3), old(2, 40L));
+  for (int i = 0; i < 3; i++) puts(words[i]);
+  void (*f)(void) = bump;
+  f(); f(); (*f)();
+  int (*p)(const char *) = puts;
+  p("via pointer");
+  printf("%d %.3f %.3f %.3f %.3f %.3f %.3f %.3f %.3f %.3f %.3f %d\n", counter, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0, 10.0, 11);
+  return counter;
+}
@@ -0,0 +1,222 @@
+#include "decls.h"
+#include <setjmp.h>
+
+struct node { int value; struct node *next; long weight; };
+union pun { int i; float f; unsigned char b[4]; };
+struct bits { short lo : 5; int hi : 20; unsigned char c; };
+
+static int twice(int *p, int *q) {
+  // p and q may be the same
+  int a = *p;
+  *q = a + 1;
+  return *p + a;
+}
+
+static int restricted(int a[restrict], int *b) {
+  int x = a[0];
+  *b = 7;
+  return a[0] + x;
+}
+
+static long kinds(int *p, long *q) {
+  int a = *p;
+  *q = 5;
+  return *p + a;
+}
+
+static int chars(int *p, char *c) {
+  int a = *p;
+  *c = 1;
+  return *p + a;
+}
+
+static float punned(union pun *u, int v) {
+  float before = u->f;
+  u->i = v;
+  return u->f + before;
+}
+
+static float punned2(union pun *u, union pun *w, int v) {
+  float before = u->f;
+  w->i = v;
+  return u->f + before;
+}
+
+static int bitfields(struct bits *s, struct bits *t) {
+  int a = s->lo;
+  t->hi = 12345;
+  return s->lo + a + t->hi;
+}
+
+static int sink;
+static int *leaked;
+static void touch(void) { if (leaked) *leaked += 100; sink++; }
+
+static int locals(void) {
+  int a[4] = { 1, 2, 3, 4 };
+  int s = a[1];
+  touch();
+  s += a[1];
+  int b[2] = { 5, 6 };
+  leaked = &b[1];
+  int t = b[1];
+  touch();
+  t += b[1];
+  leaked = 0;
+  return s * 1000 + t;
+}
+
+static int global_arr[8];
+static int globals(int *p) {
+  int a = global_arr[2];
+  *p = 9;
+  int b = global_arr[2];
+  touch();
+  return a + b + global_arr[2] + sink;
+}
+
+static int loops(struct node *n) {
+  int total = 0;
+  for (; n; n = n->next) {
+    total += n->value * 2 + n->value;
+    n->value++;
+    total += n->value;
+  }
+  return total;
+}
+
+static int merge(int *p, int c) {
+  int a = *p;
+  if (c) {
+    *p = a + 1;
+  } else {
+    a += 10;
+  }
+  return *p + a;
+}
+
+static int merge2(int *p, int *q, int c) {
+  int a = *p;
+  if (c) {
+    *q = 3;
+  }
+  return *p + a;
+}
+
+static int through_memcpy(struct node *n, struct node *m) {
+  int a = n->value;
+  *m = *n;
+  m->value = 40;
+  return n->value + a + m->value;
+}
+
+static jmp_buf jb;
+static int jumps(void) {
+  int x[1];
+  x[0] = 1;
+  if (setjmp(jb) == 0) {
+    touch();
+    longjmp(jb, 1);
+  }
+  return x[0];
+}
+
+static int escaped_param(int *restrict p, int **out) {
+  *out = p;
+  int a = *p;
+  **out = 11;
+  return *p + a;
+}
+
+static int self_loop(int *p, int n) {
+  int s = 0;
+  int a = *p;
+  for (int i = 0; i < n; i++) {
+    s += *p;
+    p[i & 1] = i;
+  }
+  return s + a + *p;
+}
+
+static int ptr_diff(void) {
+  int a[10];
+  for (int i = 0; i < 10; i++) a[i] = i;
+  int *e = a + 10;
+  int s = 0;
+  for (int *q = a; q != e; q++) s += *q;
+  return s + (int)(e - a);
+}
+
+
+struct vec { int n; int *data; };
+static int shrink(struct vec *v) {
+  int s = 0;
+  for (int i = 0; i < v->n; i++) { s += v->data[i]; v->n--; }
+  return s;
+}
+static int through(struct vec *v, int *alias) {
+  int s = 0;
+  for (int i = 0; i < v->n; i++) { s += i; *alias = 2; }
+  return s;
+}
+static int *target;
+static void bump(void) { *target -= 2; }
+static void (*fp)(void) = bump;
+static int calls(struct vec *v) {
+  int s = 0;
+  target = &v->n;
+  for (int i = 0; i < v->n; i++) { s += i; fp(); }
+  return s;
+}
+static int guarded(struct vec *v) {
+  int s = 0;
+  while (v && v->n > 0) { s += v->n; v = v->n > 3 ? v : 0; if (v) v->n--; }
+  return s;
+}
+static int untyped(struct vec *v, double *d) {
+  int s = 0;
+  for (int i = 0; i < v->n; i++) { s += i; d[i] = i; }
+  return s;
+}
+int main(void) {
+  int x = 3, y = 4, r;
+  r = twice(&x, &x); printf("%d ", r);
+  r = twice(&x, &y); printf("%d %d %d\n", r, x, y);
+  int arr[2] = { 10, 20 };
+  r = restricted(arr, &arr[1]); printf("%d %d\n", r, arr[1]);
+  long l = 2; int i = 6;
+  long k = kinds(&i, &l); printf("%ld ", k);
+  r = chars(&i, (char *)&i); printf("%d\n", r);
+  union pun u; u.f = 1.5f;
+  printf("%f\n", punned(&u, 0x40000000));
+  u.f = 1.5f;
+  printf("%f\n", punned2(&u, &u, 0x40400000));
+  struct bits b = { 3, 7, 9 };
+  r = bitfields(&b, &b); printf("%d %d\n", r, b.lo);
+  printf("%d\n", locals());
+  r = globals(&global_arr[2]); printf("%d ", r);
+  r = globals(&x); printf("%d\n", r);
+  struct node n3 = { 3, 0, 1 }, n2 = { 2, &n3, 1 }, n1 = { 1, &n2, 1 };
+  r = loops(&n1); printf("%d ", r);
+  r = loops(&n1); printf("%d\n", r);
+  r = merge(&x, 1); printf("%d ", r);
+  r = merge(&x, 0); printf("%d\n", r);
+  r = merge2(&x, &x, 1); printf("%d ", r);
+  r = merge2(&x, &y, 1); printf("%d\n", r);
+  r = through_memcpy(&n1, &n1); printf("%d ", r);
+  r = through_memcpy(&n1, &n2); printf("%d\n", r);
+  printf("%d\n", jumps());
+  int *out;
+  printf("%d\n", escaped_param(&x, &out));
+  int pp[2] = { 5, 5 };
+  printf("%d\n", self_loop(pp, 10));
+  printf("%d\n", ptr_diff());
+  int buf[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+  struct vec v = { 8, buf };
+  r = shrink(&v); printf("%d %d\n", r, v.n);
+  v.n = 8; r = through(&v, &v.n); printf("%d %d\n", r, v.n);
+  v.n = 8; r = calls(&v); printf("%d %d\n", r, v.n);
+  v.n = 5; r = guarded(&v); printf("%d ", r); r = guarded(0); printf("%d\n", r);
+  double dd[8]; v.n = 8; r = untyped(&v, dd); printf("%d %f\n", r, dd[7]);
+  return 0;
+}
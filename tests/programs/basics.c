@@ -0,0 +1,96 @@
+#include "decls.h"
+
+struct small { int a; int b; };
+struct mixed { double d; int i; };
+struct flt { float x, y, z; };
+struct big { long a, b, c; char s[9]; };
+struct bits { unsigned a : 3; signed b : 4; unsigned c : 20; };
+
+int g1 = 42;
+int *pg = &g1;
+const char *msg = "hello";
+char arr[] = "world";
+int tab[5] = { 1, 2, [4] = 9 };
+struct small sg = { 7, 8 };
+struct big bg = { 1, 2, 3, "abcdefgh" };
+double dv = 1.5 * 2;
+float fv = -0.25f;
+long lv = -5;
+unsigned long long ull = 18446744073709551615ULL;
+int *ptab = &tab[2];
+struct { const char *name; int v; } names[] = { { "one", 1 }, { "two", 2 } };
+static int hidden = 3;
+struct bits bf = { 5, -3, 1000 };
+void (*fp)(void);
+char *strs[] = { "a", "bb", 0 };
+
+struct small mk_small(int a, int b) { struct small s = { a, b }; return s; }
+struct mixed mk_mixed(double d, int i) { struct mixed m; m.d = d; m.i = i; return m; }
+struct flt mk_flt(float x) { struct flt f = { x, x * 2, x * 3 }; return f; }
+struct big mk_big(long x) { struct big b = { x, x + 1, x + 2, "xyz" }; return b; }
+int sum_small(struct small s) { return s.a + s.b; }
+double sum_mixed(struct mixed m) { return m.d + m.i; }
+float sum_flt(struct flt f) { return f.x + f.y + f.z; }
+long sum_big(struct big b) { return b.a + b.b + b.c + strlen(b.s); }
+long many(long a, long b, long c, long d, long e, long f, long g, long h, double x, struct big bb) {
+  return a + b + c + d + e + f + g * 10 + h * 100 + (long)x + bb.a;
+}
+double fmany(double a, double b, double c, double d, double e, double f, double g, double h, double i, float j) {
+  return a + b + c + d + e + f + g + h + i * 100 + j;
+}
+static int counter(void) { static int n = 10; return n++; }
+int cmp(const void *a, const void *b) { return *(const int *)a - *(const int *)b; }
+int fib(int n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }
+
+int main(void) {
+  printf("%d %d %s %s %d %d %d\n", g1, *pg, msg, arr, tab[0], tab[4], *ptab);
+  printf("%d %d %ld %ld %s\n", sg.a, sg.b, bg.a, bg.c, bg.s);
+  printf("%f %f %ld %llu\n", dv, fv, lv, ull);
+  printf("%s %d %s %d %d\n", names[0].name, names[0].v, names[1].name, names[1].v, hidden);
+  printf("%u %d %u\n", bf.a, bf.b, bf.c);
+  printf("%s %s %p\n", strs[0], strs[1], (void *)strs[2]);
+  struct small s = mk_small(3, 4);
+  struct mixed m = mk_mixed(2.5, 3);
+  struct flt f = mk_flt(1.5f);
+  struct big b = mk_big(100);
+  printf("%d %d %f %d %f %f %f %ld %s\n", s.a, s.b, m.d, m.i, f.x, f.y, f.z, b.c, b.s);
+  printf("%d %f %f %ld\n", sum_small(s), sum_mixed(m), sum_flt(f), sum_big(b));
+  printf("%ld\n", many(1, 2, 3, 4, 5, 6, 7, 8, 9.75, b));
+  printf("%f\n", fmany(1, 2, 3, 4, 5, 6, 7, 8, 9, 10.5f));
+  counter(); counter();
+  printf("%d\n", counter());
+  int v[] = { 5, 3, 9, 1, 7 };
+  qsort(v, 5, sizeof v[0], cmp);
+  for (int i = 0; i < 5; i++) printf("%d ", v[i]);
+  printf("\n%d\n", fib(20));
+  unsigned u = 4000000000u;
+  double du = u;
+  unsigned long long big = 18000000000000000000ULL;
+  double dbig = big;
+  unsigned long long back = (unsigned long long)dbig;
+  float fl = 3.7f;
+  int fi = (int)fl;
+  unsigned char uc = 200;
+  signed char sc = -100;
+  short sh = -30000;
+  unsigned short us = 60000;
+  printf("%f %f %llu %d %d %d %d %d\n", du, dbig, back, fi, uc + 100, sc - 100, sh, us);
+  printf("%d %d %d %d\n", -7 / 2, -7 % 2, 7u / 2, (int)(-7u % 3));
+  printf("%d %d %lld %d\n", 1 << 10, -16 >> 2, (long long)1 << 40, (unsigned)0x80000000 >> 31);
+  double a = 0.1, c = 0.2;
+  printf("%d %d %d %d %d %d\n", a < c, a > c, a <= c, a >= c, a == c, a != c);
+  double nan = 0.0 / 0.0;
+  printf("%d %d %d %d\n", nan == nan, nan != nan, nan < 1, nan >= 1);
+  _Bool bb = 5;
+  printf("%d %d\n", bb, !bb);
+  char buf[32];
+  sprintf(buf, "%d-%s", 12, "x");
+  puts(buf);
+  int x = 3;
+  switch (x) { case 1: puts("one"); break; case 3: puts("three"); default: puts("dflt"); }
+  int (*pf)(int) = fib;
+  printf("%d\n", pf(10));
+  long double ld = 2.5;
+  printf("%d\n", (int)(ld * 2));
+  return 0;
+}
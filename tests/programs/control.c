@@ -0,0 +1,70 @@
+#include "decls.h"
+/* control flow heavy code, phis and loops */
+int collatz(long n) { int steps = 0; while (n != 1) { n = n % 2 ? 3 * n + 1 : n / 2; steps++; } return steps; }
+int primes(int limit) {
+  char *sieve = malloc(limit + 1);
+  memset(sieve, 1, limit + 1);
+  int count = 0;
+  for (int i = 2; i <= limit; i++) {
+    if (!sieve[i]) continue;
+    count++;
+    for (int j = i * 2; j <= limit; j += i) sieve[j] = 0;
+  }
+  free(sieve);
+  return count;
+}
+void swap_loop(int n) {
+  int a = 1, b = 2;
+  for (int i = 0; i < n; i++) { int t = a; a = b; b = t; }
+  printf("%d %d\n", a, b);
+}
+unsigned hash(const char *s) { unsigned h = 5381; while (*s) h = h * 33 ^ (unsigned char)*s++; return h; }
+int classify(int c) {
+  switch (c) {
+  case 'a': case 'e': case 'i': case 'o': case 'u': return 1;
+  case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9': return 2;
+  case -5: return 3;
+  case 1000000: return 4;
+  default: return 0;
+  }
+}
+struct list { int v; struct list *next; };
+int nested(int n) {
+  int total = 0;
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < i; j++) {
+      if ((i + j) % 3 == 0) continue;
+      if (j > 7) break;
+      total += i * j;
+    }
+  return total;
+}
+long long mul64(long long a, long long b) { return a * b; }
+unsigned long long udiv(unsigned long long a, unsigned long long b) { return a / b + a % b; }
+double dot(const double *a, const double *b, int n) { double s = 0; for (int i = 0; i < n; i++) s += a[i] * b[i]; return s; }
+int matrix[4][4];
+int main(void) {
+  printf("%d %d\n", collatz(27), primes(10000));
+  swap_loop(7);
+  printf("%u %u\n", hash("hello"), hash(""));
+  const char *str = "aeXz09-";
+  int counts[5] = { 0 };
+  for (const char *p = str; *p; p++) counts[classify(*p)]++;
+  counts[classify(-5)]++; counts[classify(1000000)]++;
+  printf("%d %d %d %d %d\n", counts[0], counts[1], counts[2], counts[3], counts[4]);
+  printf("%d\n", nested(50));
+  printf("%lld %llu\n", mul64(123456789, -987654321), udiv(18446744073709551615ULL, 1000));
+  double a[] = { 1, 2, 3, 4 }, b[] = { 0.5, 0.25, 0.125, 2 };
+  printf("%g\n", dot(a, b, 4));
+  for (int i = 0; i < 4; i++) for (int j = 0; j < 4; j++) matrix[i][j] = i * j;
+  int tr = 0; for (int i = 0; i < 4; i++) tr += matrix[i][i];
+  printf("%d\n", tr);
+  struct list nodes[3] = { { 1, &nodes[1] }, { 2, &nodes[2] }, { 3, 0 } };
+  int s = 0; for (struct list *l = nodes; l; l = l->next) s += l->v;
+  int x = 5, y = 0;
+  y = x++ + ++x; x -= 2; x *= 3; x /= 2; x %= 4; x <<= 3; x >>= 1; x |= 1; x &= 7; x ^= 2;
+  printf("%d %d %d\n", s, x, y);
+  int k = 0; int r = (k++ && k++) || (k++, 1);
+  printf("%d %d %d\n", k, r, k > 1 ? 10 : 20);
+  return s;
+}
@@ -0,0 +1,9 @@
+typedef unsigned long size_t;
+int printf(const char *, ...);
+int sprintf(char *, const char *, ...);
+int puts(const char *);
+void qsort(void *, size_t, size_t, int (*)(const void *, const void *));
+size_t strlen(const char *);
+void *malloc(size_t);
+void free(void *);
+void *memset(void *, int, size_t);
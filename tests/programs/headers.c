@@ -0,0 +1,48 @@
+#include <float.h>
+#include <iso646.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct entry { const char *name; int value; };
+
+static int by_name(const void *a, const void *b) {
+  return strcmp(((const struct entry*)a)->name, ((const struct entry*)b)->name);
+}
+
+// Formats through the C library's v* functions, which take our va_list
+static int say(char *buf, size_t size, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(buf, size, fmt, ap);
+  va_end(ap);
+  fputs(buf, stdout);
+  return n;
+}
+
+int main(void) {
+  char buf[64];
+  struct entry entries[] = { { "pear", 3 }, { "apple", 1 }, { "fig", 2 } };
+  bool sorted = true;
+
+  strcpy(buf, "hello");
+  strcat(buf, ", world");
+  printf("%s %zu %d\n", buf, strlen(buf), memcmp(buf, "hello", 5));
+  qsort(entries, 3, sizeof *entries, by_name);
+  for (size_t i = 0; i < 3; i++) {
+    printf("%s=%d%c", entries[i].name, entries[i].value, i < 2 ? ' ' : '\n');
+    sorted = sorted && (i == 0 || by_name(&entries[i - 1], &entries[i]) < 0);
+  }
+  printf("%d %zu %d %ld %u\n", sorted, offsetof(struct entry, value), INT_MIN, LONG_MAX, UCHAR_MAX);
+  int n = say(buf, sizeof buf, "%s %d %.2f %c %lu\n", "say", -42, 2.5, 'x', ULONG_MAX);
+  printf("%d\n", n);
+  float f = FLT_MAX;
+  printf("%d %d %d %d %d %d\n", FLT_EVAL_METHOD, FLT_RADIX, FLT_MANT_DIG, DBL_MANT_DIG, LDBL_MANT_DIG, DBL_DIG);
+  printf("%g %g %g %g %g\n", f, FLT_EPSILON, DBL_MIN, DBL_MAX, DBL_EPSILON);
+  printf("%d %d\n", DBL_TRUE_MIN > 0 and not (FLT_MIN == 0), compl 0 bitand 6 xor 3);
+  return NULL == 0 ? 0 : 1;
+}
@@ -0,0 +1,45 @@
+#include "decls.h"
+
+struct vec { double x, y, z; };
+struct big { long a[6]; };
+
+static inline double dot(struct vec a, struct vec b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static inline struct vec scale(struct vec v, double k) { v.x *= k; v.y *= k; v.z *= k; return v; }
+static inline struct big bump(struct big b) { for (int i = 0; i < 6; i++) b.a[i]++; return b; }
+static int sq(int x) { return x * x; }
+static int absval(int x) { if (x < 0) return -x; return x; }
+static inline int clamp(int x, int lo, int hi) { return x < lo ? lo : x > hi ? hi : x; }
+static int fact(int n) { return n <= 1 ? 1 : n * fact(n - 1); }
+static int even(int n);
+static int odd(int n) { return n == 0 ? 0 : even(n - 1); }
+static int even(int n) { return n == 0 ? 1 : odd(n - 1); }
+static inline int noreturn_path(int x) { if (x > 100) for (;;) {} return x; }
+static inline void touch(int *p) { *p += 1; }
+static int counter(void) { static int n; return ++n; }
+static inline int loops(int n) { int s = 0; for (int i = 0; i < n; i++) s += sq(i); return s; }
+int missing_ret(int x) { if (x) return 1; }
+static inline int uses_missing(int x) { return missing_ret(x); }
+static inline int sum3(int a, int b, int c) { return a + b + c; }
+static int big(int x) {
+  int s = 0;
+  for (int i = 0; i < x; i++) { s += i * 3; s ^= s >> 2; s += i % 7; s -= i / 3; s |= i & 1; s += sq(i); }
+  for (int i = 0; i < x; i++) { s += i * 5; s ^= s >> 3; s += i % 5; s -= i / 7; s |= i & 2; }
+  return s;
+}
+
+int main(void) {
+  struct vec a = { 1, 2, 3 }, b = { 4, 5, 6 };
+  struct vec c = scale(a, 2);
+  printf("%.1f %.1f %.1f %.1f\n", dot(a, b), c.x, c.y, a.x);
+  struct big g = { { 1, 2, 3, 4, 5, 6 } };
+  struct big h = bump(g);
+  printf("%ld %ld\n", g.a[0], h.a[5]);
+  int t = 0;
+  for (int i = -5; i < 5; i++) t += sq(i) + absval(i) + clamp(i * 3, -4, 7);
+  printf("%d %d %d %d\n", t, fact(6), odd(7), even(10));
+  int v = 5;
+  touch(&v); touch(&v);
+  printf("%d %d %d %d\n", v, noreturn_path(9), counter() + counter(), loops(10));
+  printf("%d %d %d\n", uses_missing(1), sum3(1, 2, 3), big(50));
+  return 0;
+}
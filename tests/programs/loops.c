@@ -0,0 +1,156 @@
+#include "decls.h"
+
+static int a[1000];
+static long b[64][64];
+static short sh[300];
+
+static long strided(int *p, int n, int stride) {
+  long s = 0;
+  for (int i = 0; i < n; i++)
+    s += p[i * stride] * (stride + 3);
+  return s;
+}
+
+static long down(int n) {
+  long s = 0;
+  for (int i = n - 1; i >= 0; i--)
+    s += a[i] * i + a[2 * i + 1];
+  return s;
+}
+
+static unsigned uloop(unsigned n, unsigned k) {
+  unsigned s = 0;
+  for (unsigned i = 0; i < n; i += 3)
+    s += i * k + (i << 2);
+  return s;
+}
+
+static long matmul(int n) {
+  static long c[64][64];
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++) {
+      long t = 0;
+      for (int k = 0; k < n; k++)
+        t += b[i][k] * b[k][j];
+      c[i][j] = t;
+    }
+  long s = 0;
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++)
+      s ^= c[i][j] + i * j;
+  return s;
+}
+
+static int whiles(int n, int m) {
+  int i = 0, s = 0;
+  while (i < n) {
+    if (a[i] % 7 == 3) { i += 2; continue; }
+    s += a[i] * m * 5;
+    if (s > 100000000) break;
+    i++;
+  }
+  int j = 0;
+  do {
+    s += j * m;
+    j++;
+  } while (j < m);
+  return s;
+}
+
+static int exits(int n, int key) {
+  for (int i = 0; i < n; i++) {
+    if (a[i * 3 % 1000] == key) return i;
+    if (i * 7 > 5000) return -i;
+  }
+  return -1;
+}
+
+static int with_switch(int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++) {
+    switch (i & 7) {
+    case 0: s += i * 3; break;
+    case 1: s -= i; break;
+    case 2: case 3: s ^= i * 11; break;
+    case 5: s += sh[i % 300]; break;
+    default: s += 1;
+    }
+  }
+  return s;
+}
+
+static int divs(int n, int d) {
+  int s = 0;
+  for (int i = 0; i < n; i++) {
+    if (d) s += i / d;
+    s += i / 3 + i % 5 + (n * 9) / 4;
+  }
+  return s;
+}
+
+static long narrow(int n) {
+  long s = 0;
+  for (short i = 0; i < n; i++)
+    s += sh[i] * 5 + i * 2;
+  for (unsigned char c = 250; c != 4; c++)
+    s += c * 3;
+  return s;
+}
+
+static long wrapping(unsigned n) {
+  long s = 0;
+  for (unsigned i = 4000000000u; i != 4000000000u + n; i++)
+    s += (long)(i * 2u);
+  for (int i = 0; i < 10; i++)
+    s += (long)(unsigned)(i * 100000000) * 3;
+  return s;
+}
+
+static double fl(int n, double x) {
+  double s = 0;
+  for (int i = 0; i < n; i++)
+    s += x * 2.5 + i * (x + 1);
+  return s;
+}
+
+static int nested_early(int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++) {
+    for (int j = i; j < n; j += 2) {
+      s += a[j] * i;
+      if (s < 0) goto out;
+    }
+  }
+out:
+  return s;
+}
+
+static long ptrs(int *p, int *end) {
+  long s = 0;
+  while (p < end) {
+    s += *p * 2;
+    p += 3;
+  }
+  return s;
+}
+
+int main(void) {
+  for (int i = 0; i < 1000; i++) a[i] = (i * 37 + 11) % 101 - 50;
+  for (int i = 0; i < 64; i++)
+    for (int j = 0; j < 64; j++) b[i][j] = (i * 7 + j * 13) % 17 - 8;
+  for (int i = 0; i < 300; i++) sh[i] = (short)(i * 1234);
+  printf("%ld %ld %ld\n", strided(a, 100, 7), strided(a, 0, 3), strided(a + 999, 10, -5));
+  printf("%ld %ld\n", down(400), down(0));
+  printf("%u %u\n", uloop(1000, 77), uloop(0, 1));
+  printf("%ld %ld\n", matmul(64), matmul(5));
+  printf("%d %d\n", whiles(1000, 9), whiles(3, 1));
+  printf("%d %d %d\n", exits(1000, a[500]), exits(1000, 12345), exits(0, 1));
+  printf("%d\n", with_switch(1000));
+  printf("%d %d\n", divs(100, 7), divs(50, 0));
+  printf("%ld\n", narrow(299));
+  printf("%ld\n", wrapping(1000));
+  printf("%f\n", fl(100, 1.5));
+  printf("%d\n", nested_early(300));
+  printf("%ld\n", ptrs(a, a + 1000));
+  return 0;
+}
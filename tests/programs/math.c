@@ -0,0 +1,10 @@
+#include <math.h>
+#include <stdio.h>
+
+// Calls into the math library, which -run loads for -lm as the linker does
+int main(void) {
+  volatile double x = 2.0;
+  printf("%.6f %.6f %.1f %.6f\n", sqrt(x), pow(x, 10), floor(-x / 3), atan2(1, x));
+  printf("%.6f %.6f %d\n", exp(log(x * 5)), fabs(-x) + fmod(7.5, x), (int)round(hypot(3, 4)));
+  return 0;
+}
@@ -0,0 +1,113 @@
+#include "decls.h"
+struct bits { unsigned a : 3, b : 5; int c; };
+struct mix { char c; short s; int i; long l; double d; float f; };
+struct inner { int x, y; };
+struct outer { struct inner in; int z[2]; };
+
+static void bump(int *p) { (*p)++; }
+static int get(const struct inner *p) { return p->x * 10 + p->y; }
+
+static int bitfields(int n) {
+  struct bits b = { 1, 2, 3 };
+  for (int i = 0; i < n; i++) { b.a += i; b.b ^= i; b.c += b.a; }
+  return b.a * 1000 + b.b * 100 + b.c;
+}
+static long mixed(int n) {
+  struct mix m = { 'a', -3 };
+  for (int i = 0; i < n; i++) {
+    m.c++; m.s -= 7; m.i += m.s; m.l = m.l * 3 + m.c; m.d += 0.5; m.f *= 1.5f;
+  }
+  return m.c + m.s + m.i + m.l + (long)m.d + (long)m.f;
+}
+static int nested(int n) {
+  struct outer o = { { n, 2 }, { 3 } };
+  bump(&o.in.x);
+  bump(&o.z[1]);
+  if (n > 3) o.in.y = 9; else o.z[0] = 4;
+  return get(&o.in) + o.z[0] * 7 + o.z[1];
+}
+static int copied(int n) {
+  struct inner a = { n, n + 1 }, b;
+  b = a;
+  b.x++;
+  return b.x + a.y;
+}
+static int strings(int n) {
+  char s[8] = "hey";
+  s[1] = 'a' + n;
+  return s[0] + s[1] + s[2] + s[3];
+}
+static int compares(int n) {
+  int x = n, y = n;
+  int *p = n & 1 ? &x : &y;
+  *p += 5;
+  return x * 3 + y + (&x == &y);
+}
+static int chosen(int n) {
+  int x = 1, y = 2;
+  return (&x != &y) + x + y + n;
+}
+static int partial(int n) {
+  int a[4];
+  a[0] = n; a[3] = n * 2;
+  for (int i = 0; i < 3; i++) a[0] += a[3];
+  return a[0];
+}
+static int loops(int n) {
+  int acc[2] = { 0, 1 };
+  int i = 0;
+again:
+  acc[i & 1] += i;
+  if (++i < n) goto again;
+  return acc[0] * 100 + acc[1];
+}
+static double floats(int n) {
+  double v[3] = { 0 };
+  float w[2] = { 1.0f };
+  for (int i = 0; i < n; i++) { v[0] += i; v[2] -= v[0]; w[1] += w[0]; }
+  return v[0] + v[1] + v[2] + w[1];
+}
+static int shorts(int n) {
+  union { short s[2]; int i; } u = { { 1, 2 } };
+  u.s[0] += n;
+  return u.s[0] + u.s[1] + (u.i != 0);
+}
+static int chars(int n) {
+  unsigned char c[3] = { 250, 3 };
+  signed char d = -n;
+  for (int i = 0; i < n; i++) { c[0]++; c[2] -= c[1]; }
+  return c[0] + c[1] + c[2] + d;
+}
+static int undefined_but_unused(int n) {
+  int a[2];
+  if (n > 100) a[1] = 3;
+  a[0] = n;
+  return a[0];
+}
+static int big(int n) {
+  int a[20] = { 0 };
+  for (int i = 0; i < 20; i++) a[i] = i * n;
+  int b[20] = { 0 };
+  b[0] = 1; b[5] = 2; b[19] = n;
+  return a[7] + b[0] + b[5] + b[19] + b[3];
+}
+
+int main(void) {
+  for (int n = 0; n < 8; n++) {
+    printf("%d ", bitfields(n));
+    printf("%ld ", mixed(n));
+    printf("%d ", nested(n));
+    printf("%d ", copied(n));
+    printf("%d ", strings(n));
+    printf("%d ", compares(n));
+    printf("%d ", chosen(n));
+    printf("%d ", partial(n));
+    printf("%d ", loops(n + 1));
+    printf("%f ", floats(n));
+    printf("%d ", shorts(n));
+    printf("%d ", chars(n));
+    printf("%d ", undefined_but_unused(n));
+    printf("%d\n", big(n));
+  }
+  return 0;
+}
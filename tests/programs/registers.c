@@ -0,0 +1,80 @@
+#include "decls.h"
+
+static double fsum(double a, double b, double c, double d, double e, double f,
+                   double g, double h, double i, double j, float k, double l) {
+  return a + 2*b + 3*c + 4*d + 5*e + 6*f + 7*g + 8*h + 9*i + 10*j + 11*k + 12*l;
+}
+
+static long isum(long a, long b, long c, long d, long e, long f, long g, long h, char i) {
+  return a + 2*b + 3*c + 4*d + 5*e + 6*f + 7*g + 8*h + 9*i;
+}
+
+static long pressure(long x) {
+  long a = x + 1, b = x * 3, c = x - 7, d = x ^ 5, e = x << 2, f = x / 3, g = x % 11;
+  long h = a * b, i = c * d, j = e + f, k = g - a, l = b + c, m = d * e, n = f - g;
+  long o = h + i, p = j + k, q = l + m, r = n + o, s = p + q, t = r * s;
+  for (int z = 0; z < 3; z++) {
+    long u = a + b + c + d + e + f + g + h + i + j + k + l + m + n + o + p + q + r + s + t;
+    a += u & 7; b ^= u; c -= z; t += a * b;
+  }
+  return a + b + c + d + e + f + g + h + i + j + k + l + m + n + o + p + q + r + s + t;
+}
+
+static int swaps(int n) {
+  int a = 1, b = 2, c = 3;
+  for (int i = 0; i < n; i++) {
+    int t = a; a = b; b = c; c = t;
+    if (i & 1) { int u = a; a = b; b = u; }
+  }
+  return a * 100 + b * 10 + c;
+}
+
+static int lost_copy(int n) {
+  int i = 0, t;
+  for (;;) { t = i; i = i + 1; if (t > n) break; }
+  return t * 1000 + i;
+}
+
+static double fpress(double x) {
+  double a = x + 1, b = x * 2, c = x - 3, d = x / 4, e = a * b, f = c * d, g = e - f;
+  double h = a + c, i = b + d, j = e + g, k = f * h, l = i - j, m = k + l, n = m * a;
+  double r = 0;
+  for (int z = 0; z < 4; z++) {
+    r += a + b + c + d + e + f + g + h + i + j + k + l + m + n;
+    r += fsum(a, b, c, d, e, f, g, h, i, j, (float)k, l);
+    a = -a;
+  }
+  return r + a + b + c + d + e + f + g + h + i + j + k + l + m + n;
+}
+
+static int calls_across(int x) {
+  register int keep = x * 7;
+  int other = x + 3;
+  char buf[32];
+  sprintf(buf, "%d", keep);
+  int len = strlen(buf);
+  return keep + other + len + (int)isum(1, 2, 3, 4, 5, 6, 7, 8, (char)x);
+}
+
+static unsigned char narrow(unsigned char a, signed char b, short c, unsigned short d) {
+  unsigned char r = a + b;
+  short s = c * d;
+  return r ^ (unsigned char)s;
+}
+
+static float fneg(float x, double y) { return -x * (float)-y; }
+
+int main(void) {
+  printf("%ld\n", pressure(12345));
+  printf("%d %d %d\n", swaps(7), swaps(8), swaps(100));
+  printf("%d\n", lost_copy(10));
+  printf("%.6f\n", fpress(1.5));
+  printf("%d\n", calls_across(42));
+  printf("%d %d\n", narrow(200, -3, 300, 40000), narrow(5, 5, -1, 1));
+  printf("%.3f %.3f\n", fneg(2.5f, 3.0), fsum(1,2,3,4,5,6,7,8,9,10,11,12));
+  unsigned long big = 18000000000000000000ul;
+  double db = big;
+  unsigned long back = db;
+  printf("%.1f %lu\n", db, back);
+  return 0;
+}
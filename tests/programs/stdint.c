@@ -0,0 +1,29 @@
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <wchar.h>
+
+// glibc's <bits/wchar.h> tests the sign of wchar_t with L'\0' - 1 in #if
+#if L'\0' - 1 > 0
+#error wchar_t should be signed
+#endif
+
+int main(void) {
+  int8_t i8 = INT8_MIN;
+  uint16_t u16 = UINT16_MAX;
+  int32_t i32 = INT32_MIN;
+  uint64_t u64 = UINT64_MAX;
+  intptr_t ip = -1;
+  uintmax_t um = UINTMAX_MAX / 3;
+  int_fast16_t fast = INT_FAST16_MAX;
+  printf("%" PRId8 " %" PRIu16 " %" PRId32 " %" PRIu64 "\n", i8, u16, i32, u64);
+  printf("%" PRIdPTR " %" PRIuMAX " %" PRIdFAST16 " %" PRIx64 "\n", ip, um, fast, UINT64_C(0xdeadbeef));
+  printf("%zu %zu %zu\n", sizeof(int_least8_t), sizeof(uint_fast32_t), sizeof(wchar_t));
+
+  // prefixed character constants have the values and types of wchar_t,
+  // char16_t and char32_t
+  printf("%d %d %u %u\n", L'A', L'\xffffffff', u'\xffff', U'\U0001F600');
+  printf("%zu %zu %zu %d %d\n", sizeof L'a', sizeof u'a', sizeof U'a', u'\xffff' > 0, L'é');
+  printf("%s\n", u8"prefixed");
+  return 0;
+}
@@ -0,0 +1,177 @@
+#include "decls.h"
+
+static int dense(int x) {
+  switch (x) {
+  case 0: return 10;
+  case 1: return 11;
+  case 2: return 12;
+  case 4: return 14;
+  case 5: return 15;
+  case 7: return 17;
+  default: return -1;
+  }
+}
+
+static int negative(int x) {
+  int r = 0;
+  switch (x) {
+  case -3: r += 1;
+  case -2: r += 2; break;
+  case -1: r += 4;
+  case 0: r += 8;
+  case 1: r += 16; break;
+  case 2: r = 99;
+  }
+  return r;
+}
+
+static int space(char c) {
+  switch (c) {
+  case ' ': case '\t': case '\n': case '\r': case '\v': case '\f':
+    return 1;
+  case '0': case '2': case '4': case '6': case '8':
+    return 2;
+  case '1': case '3': case '5':
+    return 3;
+  }
+  return 0;
+}
+
+static unsigned wide(unsigned x) {
+  switch (x) {
+  case 0u: return 1;
+  case 1u: return 2;
+  case 2u: return 3;
+  case 3u: return 4;
+  case 0x7fffffffu: return 5;
+  case 0x80000000u: return 6;
+  case 0xfffffffeu: return 7;
+  case 0xffffffffu: return 8;
+  case 1000: return 9;
+  case 2000: return 10;
+  case 3000: return 11;
+  case 4000: return 12;
+  case 5000: return 13;
+  }
+  return 0;
+}
+
+static long long big(long long x) {
+  switch (x) {
+  case -9223372036854775807LL - 1: return 1;
+  case -5: return 2;
+  case 100000000000LL: return 3;
+  case 100000000001LL: return 4;
+  case 100000000002LL: return 5;
+  case 100000000003LL: return 6;
+  case 100000000005LL: return 7;
+  case 9223372036854775807LL: return 8;
+  case 7: return 9;
+  case 9: return 10;
+  }
+  return 0;
+}
+
+static unsigned long long ubig(unsigned long long x) {
+  switch (x) {
+  case 0: return 1;
+  case 18446744073709551615ULL: return 2;
+  case 9223372036854775808ULL: return 3;
+  case 5: return 4;
+  }
+  return 0;
+}
+
+// a decoder over a few hundred opcodes
+static int decode(int op, int acc) {
+  switch (op) {
+#define OP(n) case n: acc = acc * 3 + n; break;
+#define OP10(n) OP(n##0) OP(n##1) OP(n##2) OP(n##3) OP(n##4) OP(n##5) OP(n##6) OP(n##7) OP(n##8) OP(n##9)
+  OP10(10) OP10(11) OP10(12) OP10(13) OP10(14) OP10(15) OP10(16) OP10(17) OP10(18) OP10(19)
+  OP10(20) OP10(21) OP10(22) OP10(23) OP10(24) OP10(25) OP10(26) OP10(27) OP10(28) OP10(29)
+  OP10(40) OP10(41) OP10(42)
+  OP(1000) OP(2000) OP(3000) OP(4000) OP(5000) OP(6000) OP(7000) OP(8000)
+  case 9999: return -acc;
+  default: acc ^= op;
+  }
+  return acc;
+}
+
+static int sparse(int x) {
+  switch (x) {
+  case 1: return 1; case 100: return 2; case 1000: return 3; case 5000: return 4;
+  case 7777: return 5; case 12345: return 6; case -4000: return 7; case -70000: return 8;
+  case 400000: return 9; case 2000000000: return 10; case -2000000000: return 11;
+  }
+  return 0;
+}
+
+// values merge in phis at the exit and at fallthrough targets
+static int merge(int x, int y) {
+  int a = y, b = 0;
+  switch (x & 15) {
+  case 0: a = 5;
+  case 1: b = a + 1; break;
+  case 2: a = b + 7;
+  case 3: b = 3; a++;
+  case 4: break;
+  case 5: a = a * 2; b = a - 1; break;
+  case 6: case 7: return a - b;
+  default: a = -a;
+  }
+  return a * 100 + b;
+}
+
+static int nested(int x, int y) {
+  switch (x) {
+  case 0:
+    switch (y) { case 0: return 1; case 1: return 2; case 2: return 3; case 3: return 4; }
+    return 5;
+  case 1: return 6;
+  case 2: return 7;
+  case 3: return 8;
+  }
+  return 9;
+}
+
+static int empty(int x) {
+  switch (x) { }
+  switch (x) { default: x++; }
+  return x;
+}
+
+int main(void) {
+  long sum = 0;
+  for (int i = -10; i < 20; i++) {
+    printf("%d:%d,%d,%d,%d ", i, dense(i), negative(i), merge(i, i * 3), nested(i % 4, i % 5));
+  }
+  printf("\n");
+  for (int c = 0; c < 128; c++) {
+    sum = sum * 7 + space(c);
+  }
+  printf("%ld\n", sum);
+  unsigned us[] = { 0, 1, 2, 3, 4, 0x7fffffff, 0x80000000, 0xfffffffe, 0xffffffff, 999,
+                    1000, 2000, 2500, 3000, 4000, 5000, 5001 };
+  for (int i = 0; i < 17; i++) {
+    printf("%u ", wide(us[i]));
+  }
+  printf("\n");
+  long long ls[] = { -9223372036854775807LL - 1, -5, -4, 100000000000LL, 100000000003LL,
+                     100000000004LL, 100000000005LL, 9223372036854775807LL, 7, 8, 9 };
+  for (int i = 0; i < 11; i++) {
+    printf("%lld ", big(ls[i]));
+  }
+  printf("%llu %llu %llu %llu %llu\n", ubig(0), ubig(-1), ubig(9223372036854775808ULL), ubig(5), ubig(6));
+  int acc = 1;
+  for (int i = 0; i < 10000; i++) {
+    acc = decode(i, acc) & 0xffffff;
+  }
+  printf("%d\n", acc);
+  int xs[] = { 0, 1, 100, 1000, 5000, 7777, 12345, -4000, -70000, 400000, 2000000000,
+               -2000000000, 2, -1 };
+  for (int i = 0; i < 14; i++) {
+    printf("%d ", sparse(xs[i]));
+  }
+  printf("%d %d\n", empty(3), empty(-1));
+  return 0;
+}
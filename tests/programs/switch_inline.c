@@ -0,0 +1,11 @@
+#include "decls.h"
+static inline int kind(int c) {
+  switch (c) { case 0: return 3; case 1: return 5; case 2: return 7; case 3: return 9; case 5: return 1; }
+  return 0;
+}
+int main(void) {
+  int s = 0;
+  for (int i = -2; i < 8; i++) s = s * 3 + kind(i) + kind(i + 1);
+  printf("%d\n", s);
+  return 0;
+}
@@ -0,0 +1,141 @@
+#include "decls.h"
+
+#define N 1003
+static int ia[N + 40], ib[N + 40], ic[N + 40];
+static long la[N], lb[N], lc[N];
+static float fa[N], fb[N], fc[N];
+static double da[N], db[N], dc[N];
+static short sa[N], sb[N];
+static unsigned char ca[N], cb[N];
+
+static void add_r(int *restrict c, const int *restrict a, const int *restrict b, int n) {
+  for (int i = 0; i < n; i++) c[i] = a[i] + b[i];
+}
+static void mul_plain(int *c, const int *a, const int *b, int n) {
+  for (int i = 0; i < n; i++) c[i] = a[i] * b[i] - 7;
+}
+static void ops(int *c, const int *a, int n, int k) {
+  for (int i = 0; i < n; i++) c[i] = ((a[i] << 3) ^ k) + (a[i] >> 2) - ((unsigned)a[i] >> 5) + -a[i] + ~a[i] | (a[i] & 0x55);
+}
+static void longs(long *c, const long *a, const long *b, long n) {
+  for (long i = 0; i < n; i++) c[i] = (a[i] + b[i]) ^ (a[i] << 7) ^ ((unsigned long)b[i] >> 3);
+}
+static void floats(float *restrict c, const float *restrict a, const float *restrict b, int n, float s) {
+  for (int i = 0; i < n; i++) c[i] = a[i] * s + b[i] / (a[i] + 1.5f) - 2.0f;
+}
+static void fsimple(float *c, const float *a, const float *b, int n, float s) {
+  for (int i = 0; i < n; i++) c[i] = a[i] * s - b[i];
+}
+static void doubles2(double *c, const double *a, int n, double s) {
+  for (int i = 0; i < n; i++) c[i] = a[i] / s + a[i] * 0.5;
+}
+static void doubles(double *c, const double *a, const double *b, unsigned n, double s) {
+  for (unsigned i = 0; i < n; i++) c[i] = a[i] * s - b[i] * b[i] + 0.25;
+}
+static void copy_bytes(unsigned char *restrict d, const unsigned char *restrict s, int n) {
+  for (int i = 0; i < n; i++) d[i] = s[i];
+}
+static void copy_shorts(short *d, const short *s, int n) {
+  for (int i = 0; i != n; i++) d[i] = s[i];
+}
+static void fill(int *p, int *end, int v) {
+  while (p < end) *p++ = v;
+}
+// overlapping: must not change behavior
+static void shift_fwd(int *a, int n) {
+  for (int i = 0; i < n; i++) a[i + 1] = a[i] + 1;
+}
+static void shift_back(int *a, int n) {
+  for (int i = 0; i < n; i++) a[i] = a[i + 1] * 2;
+}
+static void far(int *a, int n) {
+  for (int i = 0; i < n; i++) a[i + 4] = a[i] + 3;
+}
+static void far2(int *a, int n) {
+  for (int i = 0; i < n; i++) a[i + 9] = a[i] - 1;
+}
+static void inplace(int *a, int n) {
+  for (int i = 0; i < n; i++) a[i] = a[i] * 3 + 1;
+}
+static void from(int start, int n) {
+  for (int i = start; i < n; i++) ic[i] = ia[i] + ib[i];
+}
+static int outside_use(int n) {
+  int i;
+  for (i = 0; i < n; i++) ic[i] = ia[i] - 1;
+  return i;
+}
+static void down(int n) {
+  for (int i = n - 1; i >= 0; i--) ic[i] = ia[i] + 2;
+}
+static void stride2(int n) {
+  for (int i = 0; i < n; i += 2) ic[i] = ia[i] + 2;
+}
+static void uses_i(int n) {
+  for (int i = 0; i < n; i++) ic[i] = ia[i] + i;
+}
+static void twod(int m[8][13]) {
+  for (int r = 0; r < 8; r++)
+    for (int c = 0; c < 13; c++) m[r][c] = r * 100 + c + m[r][c];
+}
+static void cond(int n) {
+  for (int i = 0; i < n; i++) if (ia[i] > 0) ic[i] = ia[i];
+}
+static void gt(int n) {
+  for (int i = 0; n > i; i++) ic[i] = ib[i] * ia[i];
+}
+
+static unsigned hash_i(const int *p, int n) { unsigned h = 7; for (int i = 0; i < n; i++) h = h * 31 + (unsigned)p[i]; return h; }
+static unsigned hash_l(const long *p, int n) { unsigned h = 7; for (int i = 0; i < n; i++) h = h * 31 + (unsigned)(p[i] ^ (p[i] >> 32)); return h; }
+static double sum_f(const float *p, int n) { double s = 0; for (int i = 0; i < n; i++) s += p[i] * (i % 7 + 1); return s; }
+static double sum_d(const double *p, int n) { double s = 0; for (int i = 0; i < n; i++) s += p[i] * (i % 5 + 1); return s; }
+
+static void reset(void) {
+  for (int i = 0; i < N + 40; i++) { ia[i] = (i * 37 + 11) % 101 - 50; ib[i] = (i * 13) % 29 - 3; ic[i] = -1; }
+}
+
+int main(void) {
+  reset();
+  for (int i = 0; i < N; i++) {
+    la[i] = (long)i * 123456789 - 5; lb[i] = i * 77 - 999;
+    fa[i] = i * 0.5f - 20; fb[i] = i * 0.25f + 1;
+    da[i] = i * 1.25 - 7; db[i] = i * 0.125;
+    sa[i] = (short)(i * 301); ca[i] = (unsigned char)(i * 7);
+  }
+  for (int n = 0; n < 12; n++) { reset(); add_r(ic, ia, ib, n); printf("%u ", hash_i(ic, 16)); }
+  printf("\n");
+  reset(); add_r(ic, ia, ib, N); printf("%u\n", hash_i(ic, N));
+  reset(); mul_plain(ic, ia, ib, N); printf("%u\n", hash_i(ic, N));
+  reset(); mul_plain(ia + 1, ia, ib, 100); printf("%u\n", hash_i(ia, N));
+  reset(); mul_plain(ia, ia + 1, ib, 100); printf("%u\n", hash_i(ia, N));
+  reset(); ops(ic, ia, N, 0x1234); printf("%u\n", hash_i(ic, N));
+  longs(lc, la, lb, N); printf("%u\n", hash_l(lc, N));
+  longs(la + 1, la, lb, 50); printf("%u\n", hash_l(la, N));
+  floats(fc, fa, fb, N, 3.5f); printf("%f\n", sum_f(fc, N));
+  fsimple(fc, fa, fb, N, 0.75f); printf("%f\n", sum_f(fc, N));
+  fsimple(fa + 1, fa, fb, 99, 0.75f); printf("%f\n", sum_f(fa, N));
+  doubles2(dc, da, N, 3.0); printf("%f\n", sum_d(dc, N));
+  doubles(dc, da, db, N, -1.5); printf("%f\n", sum_d(dc, N));
+  doubles(dc, da, db, 3, -1.5); printf("%f\n", sum_d(dc, N));
+  copy_bytes(cb, ca, N); { unsigned h = 0; for (int i = 0; i < N; i++) h = h * 3 + cb[i]; printf("%u\n", h); }
+  copy_shorts(sb, sa, N); { unsigned h = 0; for (int i = 0; i < N; i++) h = h * 3 + sb[i]; printf("%u\n", h); }
+  copy_shorts(sa + 2, sa, 500); { unsigned h = 0; for (int i = 0; i < N; i++) h = h * 3 + sa[i]; printf("%u\n", h); }
+  reset(); fill(ic + 3, ic + 900, 42); printf("%u\n", hash_i(ic, N));
+  reset(); fill(ic + 3, ic + 3, 42); printf("%u\n", hash_i(ic, N));
+  reset(); shift_fwd(ia, 100); printf("%u\n", hash_i(ia, N));
+  reset(); shift_back(ia, 100); printf("%u\n", hash_i(ia, N));
+  reset(); far(ia, 100); printf("%u\n", hash_i(ia, N));
+  reset(); far2(ia, 100); printf("%u\n", hash_i(ia, N));
+  reset(); inplace(ia, N); printf("%u\n", hash_i(ia, N));
+  reset(); from(5, N); printf("%u\n", hash_i(ic, N));
+  reset(); from(N, 5); printf("%u\n", hash_i(ic, N));
+  reset(); from(-3, -1); printf("%u\n", hash_i(ic, N));
+  reset(); printf("%d ", outside_use(N)); printf("%d ", outside_use(0)); printf("%d\n", outside_use(-5));
+  reset(); down(N); printf("%u\n", hash_i(ic, N));
+  reset(); stride2(N); printf("%u\n", hash_i(ic, N));
+  reset(); uses_i(N); printf("%u\n", hash_i(ic, N));
+  { static int m[8][13]; twod(m); printf("%u\n", hash_i(&m[0][0], 8 * 13)); }
+  reset(); cond(N); printf("%u\n", hash_i(ic, N));
+  reset(); gt(N); printf("%u\n", hash_i(ic, N));
+  return 0;
+}